@@ -0,0 +1,142 @@
+// Audio-only room playback through the native mixer
+//
+// Every participant's Opus track feeds one NativeAudioMixer instead of getting
+// its own MoqMediaPipeline and player; a single audio-only NativeMediaPlayer
+// plays the mix.
+
+import 'dart:async';
+import 'dart:typed_data';
+import 'package:logger/logger.dart';
+import '../moq/client/moq_client.dart';
+import '../moq/packager/moq_mi_packager.dart';
+import '../moq/protocol/moq_messages.dart';
+import '../services/native_audio_mixer.dart';
+import '../services/native_media_player.dart';
+
+/// Plays many subscribed audio tracks as one mixed stream
+class MoQAudioRoom {
+  final Logger _logger;
+  final NativeAudioMixer _mixer;
+  final NativeMediaPlayer _player;
+
+  // Mixer track IDs are local: a subscription's request ID changes when a
+  // lost session is recovered
+  final Map<MoQSubscription, int> _trackIds = {};
+  final Map<int, StreamSubscription<MoQObject>> _listeners = {};
+  final Map<int, String> _trackNames = {};
+  int _nextTrackId = 1;
+  final _speakerController = StreamController<List<ActiveSpeaker>>.broadcast();
+  Timer? _pollTimer;
+  List<ActiveSpeaker> _speakers = const [];
+
+  MoQAudioRoom._(this._mixer, this._player, this._logger);
+
+  /// Create a room mixing the [topK] loudest participants
+  ///
+  /// Returns null if the native mixer or player is not available.
+  static MoQAudioRoom? create({int topK = 3, int workers = 1, Logger? logger}) {
+    final mixer = NativeAudioMixer.create(topK: topK, workers: workers);
+    if (mixer == null) return null;
+
+    final player = NativeMediaPlayer.createWithOutput(VideoOutputMode.none);
+    if (player == null) {
+      mixer.dispose();
+      return null;
+    }
+    if (!mixer.attachPlayer(player)) {
+      player.dispose();
+      mixer.dispose();
+      return null;
+    }
+    player.play();
+
+    final room = MoQAudioRoom._(mixer, player, logger ?? Logger());
+    room._pollTimer = Timer.periodic(
+      const Duration(milliseconds: 100),
+      (_) => room._poll(),
+    );
+    return room;
+  }
+
+  /// Active speakers whenever the set changes, loudest first
+  Stream<List<ActiveSpeaker>> get speakerChanges => _speakerController.stream;
+
+  List<ActiveSpeaker> get activeSpeakers => _speakers;
+
+  /// Track name of a participant, by the ID used in [activeSpeakers]
+  String? trackNameOf(int trackId) => _trackNames[trackId];
+
+  AudioMixerStats get stats => _mixer.getStats();
+
+  int get participantCount => _listeners.length;
+
+  /// Mix an Opus audio subscription (LOC or MoQ-MI packaging)
+  bool addParticipant(MoQSubscription subscription) {
+    if (_trackIds.containsKey(subscription)) return false;
+    final trackId = _nextTrackId++;
+    if (!_mixer.addTrack(trackId)) return false;
+    _trackIds[subscription] = trackId;
+    _trackNames[trackId] = String.fromCharCodes(subscription.trackName);
+    _listeners[trackId] = subscription.objectStream.listen(
+      (object) => _onObject(trackId, object),
+    );
+    return true;
+  }
+
+  Future<void> removeParticipant(MoQSubscription subscription) async {
+    final trackId = _trackIds.remove(subscription);
+    if (trackId == null) return;
+    await _listeners.remove(trackId)?.cancel();
+    _trackNames.remove(trackId);
+    _mixer.removeTrack(trackId);
+  }
+
+  Future<void> dispose() async {
+    _pollTimer?.cancel();
+    _pollTimer = null;
+    for (final listener in _listeners.values) {
+      await listener.cancel();
+    }
+    _listeners.clear();
+    _trackIds.clear();
+    _mixer.dispose();
+    _player.dispose();
+    await _speakerController.close();
+  }
+
+  void _onObject(int trackId, MoQObject object) {
+    final payload = object.payload;
+    if (payload == null || payload.isEmpty) return;
+
+    int? audioLevel;
+    Uint8List packet = payload;
+    for (final header in object.extensionHeaders) {
+      if (header.type == locAudioLevelExtension && header.intValue != null) {
+        audioLevel = header.intValue! & 0x7F;
+      } else if (header.type == MoqMiExtensionHeaders.mediaType) {
+        // MoQ-MI: the Opus bitstream follows its extension headers
+        final data = MoqMiPackager.parseExtensionHeaders(
+          object.extensionHeaders,
+          payload,
+        );
+        if (data == null || !data.isOpus) return;
+        packet = data.data;
+      }
+    }
+
+    if (!_mixer.pushPacket(trackId, packet, audioLevel: audioLevel)) {
+      _logger.w('Dropped audio packet for track $trackId');
+    }
+  }
+
+  void _poll() {
+    _player.processEvents();
+    final speakers = _mixer.activeSpeakers;
+    var changed = speakers.length != _speakers.length;
+    for (var i = 0; !changed && i < speakers.length; i++) {
+      changed = speakers[i].trackId != _speakers[i].trackId;
+    }
+    _speakers = speakers;
+    if (changed) _speakerController.add(speakers);
+  }
+}
@@ -0,0 +1,184 @@
+// Monitoring-wall playback through the native grid decoder
+//
+// Every subscribed video track feeds one NativeGridDecoder instead of getting
+// its own MoQVideoPlayer; the decoded tiles are shown as a single image.
+
+import 'dart:async';
+import 'dart:ui' as ui;
+import 'package:flutter/material.dart';
+import 'package:logger/logger.dart';
+import '../moq/client/moq_client.dart';
+import '../moq/media/moq_media_decoder.dart';
+import '../moq/protocol/moq_messages.dart';
+import '../services/native_grid_decoder.dart';
+
+/// Decodes many subscribed video tracks into one tiled image
+class MoQVideoGrid {
+  final Logger _logger;
+  final NativeGridDecoder _decoder;
+
+  // Stream IDs are local: a subscription's request ID changes when a lost
+  // session is recovered
+  final Map<MoQSubscription, int> _streamIds = {};
+  final Map<int, int> _tiles = {};
+  final Map<int, StreamSubscription<MoQObject>> _listeners = {};
+  int _nextStreamId = 1;
+  Timer? _refreshTimer;
+  bool _converting = false;
+
+  /// Latest atlas image; replaced whenever a tile changes
+  final ValueNotifier<ui.Image?> image = ValueNotifier(null);
+
+  MoQVideoGrid._(this._decoder, this._logger);
+
+  /// Create a [columns] x [rows] grid of [tileWidth] x [tileHeight] tiles
+  ///
+  /// Returns null if the native grid decoder is not available.
+  static MoQVideoGrid? create({
+    required int columns,
+    required int rows,
+    int tileWidth = 320,
+    int tileHeight = 180,
+    int workers = 0,
+    Duration refreshInterval = const Duration(milliseconds: 33),
+    Logger? logger,
+  }) {
+    final decoder = NativeGridDecoder.create(
+      columns: columns,
+      rows: rows,
+      tileWidth: tileWidth,
+      tileHeight: tileHeight,
+      workers: workers,
+    );
+    if (decoder == null) return null;
+
+    final grid = MoQVideoGrid._(decoder, logger ?? Logger());
+    grid._refreshTimer = Timer.periodic(refreshInterval, (_) => grid._refresh());
+    return grid;
+  }
+
+  int get columns => _decoder.columns;
+  int get rows => _decoder.rows;
+  int get streamCount => _listeners.length;
+
+  /// Tile of a subscription, or null if it is not shown
+  int? tileOf(MoQSubscription subscription) {
+    final streamId = _streamIds[subscription];
+    return streamId == null ? null : _tiles[streamId];
+  }
+
+  GridDecoderStats get stats => _decoder.getStats();
+
+  /// Show an H.264 (MoQ-MI) subscription in the first free tile
+  ///
+  /// Returns the tile index, or null if the grid is full.
+  int? addStream(MoQSubscription subscription) {
+    if (_streamIds.containsKey(subscription)) return tileOf(subscription);
+    final used = _tiles.values.toSet();
+    int? tile;
+    for (var i = 0; i < columns * rows; i++) {
+      if (!used.contains(i)) {
+        tile = i;
+        break;
+      }
+    }
+    if (tile == null) return null;
+
+    final streamId = _nextStreamId++;
+    if (!_decoder.addStream(streamId, tile)) return null;
+    _streamIds[subscription] = streamId;
+    _tiles[streamId] = tile;
+
+    final mediaDecoder = MoqMediaDecoder();
+    _listeners[streamId] = subscription.objectStream.listen(
+      (object) => _onObject(streamId, mediaDecoder, object),
+    );
+    return tile;
+  }
+
+  Future<void> removeStream(MoQSubscription subscription) async {
+    final streamId = _streamIds.remove(subscription);
+    if (streamId == null) return;
+    await _listeners.remove(streamId)?.cancel();
+    _tiles.remove(streamId);
+    _decoder.removeStream(streamId);
+  }
+
+  Future<void> dispose() async {
+    _refreshTimer?.cancel();
+    _refreshTimer = null;
+    for (final listener in _listeners.values) {
+      await listener.cancel();
+    }
+    _listeners.clear();
+    _streamIds.clear();
+    _tiles.clear();
+    _decoder.dispose();
+    image.value?.dispose();
+    image.dispose();
+  }
+
+  void _onObject(int streamId, MoqMediaDecoder mediaDecoder, MoQObject object) {
+    final frame = mediaDecoder.decode(object);
+    if (frame == null || frame.type != MediaFrameType.videoH264) return;
+
+    final codecConfig = frame.codecConfig;
+    if (codecConfig != null && codecConfig.isNotEmpty) {
+      _decoder.setAvcc(streamId, codecConfig);
+    }
+    if (!_decoder.push(streamId, frame.data,
+        ptsUs: frame.ptsUs, keyframe: frame.isKeyframe)) {
+      _logger.w('Dropped video frame for grid stream $streamId');
+    }
+  }
+
+  void _refresh() {
+    // Skip a refresh while the previous image is still being uploaded
+    if (_converting) return;
+    final pixels = _decoder.readAtlas();
+    if (pixels == null) return;
+
+    _converting = true;
+    ui.decodeImageFromPixels(
+      pixels,
+      _decoder.width,
+      _decoder.height,
+      ui.PixelFormat.rgba8888,
+      (decoded) {
+        _converting = false;
+        if (_refreshTimer == null) {
+          decoded.dispose();
+          return;
+        }
+        final previous = image.value;
+        image.value = decoded;
+        previous?.dispose();
+      },
+    );
+  }
+}
+
+/// Shows a [MoQVideoGrid]'s tiles
+class MoQVideoGridView extends StatelessWidget {
+  final MoQVideoGrid grid;
+  final BoxFit fit;
+
+  const MoQVideoGridView({
+    super.key,
+    required this.grid,
+    this.fit = BoxFit.contain,
+  });
+
+  @override
+  Widget build(BuildContext context) {
+    return ValueListenableBuilder<ui.Image?>(
+      valueListenable: grid.image,
+      builder: (context, image, _) {
+        if (image == null) {
+          return const ColoredBox(color: Colors.black);
+        }
+        return RawImage(image: image, fit: fit, filterQuality: FilterQuality.low);
+      },
+    );
+  }
+}
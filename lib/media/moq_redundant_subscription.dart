@@ -0,0 +1,193 @@
+// Redundant multi-relay subscription
+//
+// Subscribes to the same track through several relays and merges the copies
+// natively (NativeRedundantTrack): whichever relay delivers an object first
+// feeds the sinks, so a stall or loss burst on one path is covered by the
+// others. A path the merger demotes for lagging behind is moved to standby
+// subscriber priority, and back when it is promoted again.
+
+import 'dart:async';
+import 'dart:typed_data';
+import 'package:logger/logger.dart';
+import '../moq/client/moq_client.dart';
+import '../moq/protocol/moq_messages.dart';
+import '../services/native_redundant_track.dart';
+
+/// Tuning for [MoQRedundantSubscription]
+class RedundantSubscriptionOptions {
+  /// Subscriber priority of paths in use (lower is more important)
+  final int activePriority;
+
+  /// Subscriber priority of demoted paths, so their relays only spend spare
+  /// capacity on them
+  final int standbyPriority;
+
+  /// Smoothed arrival delay behind the best path that demotes a path
+  final Duration demoteLag;
+
+  /// Replay cache of the merged track, so sinks attached later start at the
+  /// newest group
+  final int replayCacheBytes;
+
+  /// How often path events are collected
+  final Duration eventInterval;
+
+  const RedundantSubscriptionOptions({
+    this.activePriority = 32,
+    this.standbyPriority = 224,
+    this.demoteLag = const Duration(milliseconds: 40),
+    this.replayCacheBytes = 0,
+    this.eventInterval = const Duration(milliseconds: 250),
+  });
+}
+
+/// One relay's subscription feeding a redundant track
+class RedundantPath {
+  final MoQClient client;
+  final MoQSubscription subscription;
+  final int trackAlias;
+
+  /// Index in the native track, for [MoQRedundantSubscription.pathStats]
+  final int index;
+
+  bool _demoted = false;
+
+  RedundantPath._(this.client, this.subscription, this.trackAlias, this.index);
+
+  /// Lagging behind the best path; subscribed at standby priority
+  bool get demoted => _demoted;
+}
+
+/// A track subscribed through several relays, played once
+class MoQRedundantSubscription {
+  static final Logger _logger = Logger();
+
+  final RedundantSubscriptionOptions options;
+  final NativeRedundantTrack _track;
+  final List<RedundantPath> _paths = [];
+  final _eventController = StreamController<RedundantPathEvent>.broadcast();
+  Timer? _eventTimer;
+
+  MoQRedundantSubscription._(this._track, this.options);
+
+  /// Paths in use; a client whose transport could not route the track is
+  /// left out
+  List<RedundantPath> get paths => List.unmodifiable(_paths);
+
+  /// Demotions and promotions of paths
+  Stream<RedundantPathEvent> get events => _eventController.stream;
+
+  /// Subscribe to [trackName] on every client and merge the subscriptions
+  ///
+  /// [track] is 0 for video and 1 for audio. All clients must have
+  /// negotiated the same MoQ version. Returns null if the native library is
+  /// not available or no client could be routed.
+  static Future<MoQRedundantSubscription?> open(
+    List<MoQClient> clients,
+    List<Uint8List> trackNamespace,
+    Uint8List trackName, {
+    required int track,
+    RedundantSubscriptionOptions options = const RedundantSubscriptionOptions(),
+  }) async {
+    if (clients.isEmpty || !NativeRedundantTrack.isAvailable) return null;
+    final version = clients.first.selectedVersion;
+    if (clients.any((c) => c.selectedVersion != version)) {
+      throw ArgumentError('Relays negotiated different MoQ versions');
+    }
+    final native = NativeRedundantTrack.create(
+      track: track,
+      version: version,
+      replayCacheBytes: options.replayCacheBytes,
+      demoteLag: options.demoteLag,
+    );
+    if (native == null) return null;
+
+    final redundant = MoQRedundantSubscription._(native, options);
+    for (final client in clients) {
+      try {
+        await redundant._addPath(client, trackNamespace, trackName);
+      } catch (e) {
+        _logger.w('Could not subscribe through a relay: $e');
+      }
+    }
+    if (redundant._paths.isEmpty) {
+      await redundant.close();
+      return null;
+    }
+    redundant._eventTimer = Timer.periodic(
+      options.eventInterval,
+      (_) => redundant._processEvents(),
+    );
+    return redundant;
+  }
+
+  Future<void> _addPath(
+    MoQClient client,
+    List<Uint8List> trackNamespace,
+    Uint8List trackName,
+  ) async {
+    final result = await client.subscribe(
+      trackNamespace,
+      trackName,
+      filterType: FilterType.largestObject,
+      subscriberPriority: options.activePriority,
+    );
+    final subscription = result.subscription;
+
+    final alias = result.trackAlias.toInt();
+    final index = client.transport.routeTrackToRedundant(alias, _track.trackId);
+    if (index == null) {
+      await client.unsubscribe(subscription.id);
+      throw StateError('Transport cannot route the track natively');
+    }
+    _paths.add(RedundantPath._(client, subscription, alias, index));
+  }
+
+  /// Play the merged track through a native sink (NativePlaybackSink.sinkId)
+  bool attachSink(int sinkId) => _track.attachSink(sinkId);
+
+  /// Arrival counters of a path
+  RedundantPathStats? pathStats(RedundantPath path) =>
+      _track.getPathStats(path.index);
+
+  Future<void> _processEvents() async {
+    for (final event in _track.pollEvents()) {
+      final path = _paths.where((p) => p.index == event.path).firstOrNull;
+      if (path == null) continue;
+      path._demoted = event.demoted;
+      _logger.i(
+        'Relay path ${event.path} ${event.demoted ? 'demoted' : 'promoted'}',
+      );
+      _eventController.add(event);
+      if (!path.client.isConnected) continue;
+      try {
+        await path.client.updateSubscription(
+          path.subscription.id,
+          subscriberPriority: event.demoted
+              ? options.standbyPriority
+              : options.activePriority,
+        );
+      } catch (e) {
+        _logger.w('Failed to update path priority: $e');
+      }
+    }
+  }
+
+  /// Unsubscribe every path and release the native track
+  Future<void> close() async {
+    _eventTimer?.cancel();
+    _eventTimer = null;
+    for (final path in _paths) {
+      path.client.transport.unrouteTrack(path.trackAlias);
+      if (!path.client.isConnected) continue;
+      try {
+        await path.client.unsubscribe(path.subscription.id);
+      } catch (e) {
+        _logger.w('Failed to unsubscribe: $e');
+      }
+    }
+    _paths.clear();
+    _track.dispose();
+    await _eventController.close();
+  }
+}
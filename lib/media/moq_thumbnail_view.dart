@@ -0,0 +1,74 @@
+// Preview tile for a publisher's thumbnail track
+//
+// Shows the newest JPEG of a subscribed thumbnail track (see
+// MoQCatalog.thumbnailTrackFor). A wall of these costs a few kB/s per stream
+// and no video decoders.
+
+import 'dart:async';
+import 'dart:typed_data';
+import 'package:flutter/material.dart';
+import '../moq/client/moq_client.dart';
+import '../moq/protocol/moq_messages.dart';
+
+/// Shows the latest thumbnail of a subscribed thumbnail track
+class MoQThumbnailView extends StatefulWidget {
+  final MoQSubscription subscription;
+  final BoxFit fit;
+
+  const MoQThumbnailView({
+    super.key,
+    required this.subscription,
+    this.fit = BoxFit.cover,
+  });
+
+  @override
+  State<MoQThumbnailView> createState() => _MoQThumbnailViewState();
+}
+
+class _MoQThumbnailViewState extends State<MoQThumbnailView> {
+  StreamSubscription<MoQObject>? _listener;
+  Uint8List? _jpeg;
+
+  @override
+  void initState() {
+    super.initState();
+    _listen();
+  }
+
+  @override
+  void didUpdateWidget(MoQThumbnailView oldWidget) {
+    super.didUpdateWidget(oldWidget);
+    if (oldWidget.subscription != widget.subscription) {
+      _listener?.cancel();
+      _listen();
+    }
+  }
+
+  void _listen() {
+    _listener = widget.subscription.objectStream.listen((object) {
+      final payload = object.payload;
+      if (object.status != ObjectStatus.normal || payload == null) return;
+      if (mounted) setState(() => _jpeg = payload);
+    });
+  }
+
+  @override
+  void dispose() {
+    _listener?.cancel();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final jpeg = _jpeg;
+    if (jpeg == null) {
+      return const ColoredBox(color: Colors.black);
+    }
+    return Image.memory(
+      jpeg,
+      fit: widget.fit,
+      gaplessPlayback: true,
+      filterQuality: FilterQuality.low,
+    );
+  }
+}
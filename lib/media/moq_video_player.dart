@@ -141,13 +141,19 @@ class MoQVideoPlayer {
   int get audioSegmentsWritten => _playbackPipeline?.audioSegmentsWritten ?? 0;
 
   /// Initialize the player with MoQ subscriptions
-  Future<void> initialize(List<MoQSubscription> subscriptions) async {
+  Future<void> initialize(List<MoQSubscription> subscriptions) =>
+      initializeStreams(
+        subscriptions.map((subscription) => subscription.objectStream).toList(),
+      );
+
+  /// Initialize the player with object streams (e.g. filtered subscriptions)
+  Future<void> initializeStreams(List<Stream<MoQObject>> objectStreams) async {
     if (_isInitialized) {
       _logger.w('Player already initialized');
       return;
     }
 
-    _logger.i('Initializing player with ${subscriptions.length} subscriptions');
+    _logger.i('Initializing player with ${objectStreams.length} object streams');
 
     // Create and initialize the playback pipeline
     _playbackPipeline = StreamingPlaybackPipeline();
@@ -158,9 +164,9 @@ class MoQVideoPlayer {
       _handleVideoReady,
     );
 
-    // Subscribe to incoming objects from all subscriptions
-    for (final subscription in subscriptions) {
-      final sub = subscription.objectStream.listen(
+    // Subscribe to incoming objects from all streams
+    for (final objectStream in objectStreams) {
+      final sub = objectStream.listen(
         _handleMediaObject,
         onError: (error) => _logger.e('Object stream error: $error'),
         onDone: () => _logger.i('Object stream closed'),
@@ -0,0 +1,102 @@
+import 'dart:async';
+
+import 'package:logger/logger.dart';
+
+import '../moq/client/moq_client.dart';
+import '../moq/client/moq_zapping.dart';
+import 'moq_video_player.dart';
+
+/// Channel-switching player with warm standby decoders
+///
+/// Every channel held by the [MoQZappingController] (the watched one and the
+/// warm standbys) gets its own [MoQVideoPlayer], fed from the channel's object
+/// stream, so its decoder is already running when the viewer switches to it.
+/// Standby players are muted; switching is a priority flip plus a swap of which
+/// player's controller is displayed.
+class MoQZappingPlayer {
+  final MoQZappingController zapping;
+  final Logger _logger;
+
+  final Map<String, MoQVideoPlayer> _players = {};
+  final _activeController = StreamController<MoQVideoPlayer>.broadcast();
+  MoQVideoPlayer? _activePlayer;
+
+  MoQZappingPlayer({
+    required MoQClient client,
+    ZappingOptions options = const ZappingOptions(),
+    Logger? logger,
+  }) : zapping = MoQZappingController(
+         client: client,
+         options: options,
+         logger: logger,
+       ),
+       _logger = logger ?? Logger();
+
+  /// Player currently on screen
+  MoQVideoPlayer? get activePlayer => _activePlayer;
+
+  /// Emits the new on-screen player after each switch
+  Stream<MoQVideoPlayer> get activePlayerChanges => _activeController.stream;
+
+  /// Switch to [channel] and keep [likelyNext] warm
+  Future<MoQVideoPlayer> tune(
+    ZapChannel channel, {
+    List<ZapChannel> likelyNext = const [],
+  }) async {
+    final handle = await zapping.tune(channel);
+    final player = await _playerFor(handle);
+
+    final previous = _activePlayer;
+    if (!identical(previous, player)) {
+      await player.setVolume(1.0);
+      await previous?.setVolume(0.0);
+      _activePlayer = player;
+      _activeController.add(player);
+    }
+
+    await zapping.setStandby(likelyNext);
+    await _syncPlayers();
+    return player;
+  }
+
+  Future<void> dispose() async {
+    for (final player in _players.values) {
+      await player.dispose();
+    }
+    _players.clear();
+    _activePlayer = null;
+    await zapping.close();
+    await _activeController.close();
+  }
+
+  Future<MoQVideoPlayer> _playerFor(ZapChannelHandle handle) async {
+    final existing = _players[handle.channel.id];
+    if (existing != null) return existing;
+
+    final player = MoQVideoPlayer(logger: _logger);
+    _players[handle.channel.id] = player;
+    await player.initializeStreams([handle.objectStream]);
+    if (!handle.isActive) {
+      await player.setVolume(0.0);
+    }
+    await player.play();
+    return player;
+  }
+
+  // Start decoders for new standby channels and stop those that were released
+  Future<void> _syncPlayers() async {
+    final channelIds = <String>{
+      if (zapping.active != null) zapping.active!.channel.id,
+      ...zapping.standby.map((handle) => handle.channel.id),
+    };
+
+    for (final id in _players.keys.toList()) {
+      if (!channelIds.contains(id)) {
+        await _players.remove(id)!.dispose();
+      }
+    }
+    for (final handle in zapping.standby) {
+      await _playerFor(handle);
+    }
+  }
+}
@@ -5,25 +5,46 @@
 // the MoQ transport to mpv's ring buffer.
 
 import 'dart:async';
+import 'dart:convert';
 import 'dart:io';
+import 'dart:typed_data';
 import 'package:fixnum/fixnum.dart';
 import 'package:flutter/foundation.dart';
 import 'package:logger/logger.dart';
+import '../moq/catalog/moq_catalog.dart';
+import '../moq/catalog/moq_catalog_subscriber.dart';
 import '../moq/protocol/moq_messages.dart';
 import '../moq/client/moq_client.dart';
 import '../moq/media/moq_media_decoder.dart';
 import '../moq/media/streaming_playback.dart';
 import '../services/native_media_player.dart';
+import '../services/native_playback_sink.dart';
 
 /// Native MoQ video player using Rust buffer-based playback
 ///
 /// This player writes fMP4 data directly to an in-memory ring buffer
 /// instead of files, providing the most efficient path for live streaming.
+///
+/// With [nativeDataPlane], subscribed tracks are routed to a
+/// [NativePlaybackSink] once they are attached: their subgroup streams are
+/// deframed and muxed on the transport's reader tasks and never reach Dart.
+/// Objects already on their way through Dart are handed over to the sink, so
+/// the switch loses nothing. Falls back to the Dart path when the transport or
+/// library cannot route natively. Routed tracks keep a native replay cache of
+/// [replayCacheBytes], so another player attaching to the same subscription
+/// starts at the newest group's keyframe.
 class NativeMoQPlayer {
   final Logger _logger;
 
+  /// Play routed tracks without copying media through Dart
+  final bool nativeDataPlane;
+
+  /// Bound of each routed track's replay cache (0 disables it)
+  final int replayCacheBytes;
+
   // Native player instance
   NativeMediaPlayer? _nativePlayer;
+  NativePlaybackSink? _sink;
 
   // Media decoder and muxers
   final MoqMediaDecoder _mediaDecoder = MoqMediaDecoder();
@@ -51,10 +72,28 @@ class NativeMoQPlayer {
   bool _foundValidVideoStart = false;
   int _skippedVideoFrames = 0;
 
+  // (client, track alias) of tracks routed to the sink
+  final List<(MoQClient, int)> _routedTracks = [];
+
   // Event processing timer
   Timer? _eventTimer;
 
-  NativeMoQPlayer({Logger? logger}) : _logger = logger ?? Logger();
+  // Startup timing, on the same origin as the native player's milestones
+  final Stopwatch _startupClock = Stopwatch();
+  Duration? _subscribeSentAt;
+  Duration _playerCreatedAt = Duration.zero;
+  Duration? _firstObjectAt;
+  Duration? _firstKeyframeAt;
+  bool _preparedFromCatalog = false;
+
+  // Catalog tracks by name, from prepareFromCatalog()
+  final Map<String, CatalogTrack> _catalogTracks = {};
+
+  NativeMoQPlayer({
+    Logger? logger,
+    this.nativeDataPlane = false,
+    this.replayCacheBytes = 16 << 20,
+  }) : _logger = logger ?? Logger();
 
   /// Check if native player is available on this platform
   static bool get isAvailable {
@@ -90,16 +129,137 @@ class NativeMoQPlayer {
 
     _logger.i('Initializing native player with ${subscriptions.length} subscriptions');
 
-    // Create native player
+    // Create native player, unless prepareFromCatalog() already did
+    if (_nativePlayer == null) {
+      _startupClock
+        ..reset()
+        ..start();
+      _createNativePlayer(outputMode);
+      _createMuxers(null);
+      _createSink(null);
+    }
+
+    // Subscribe to incoming objects
+    for (final subscription in subscriptions) {
+      _routeToSink(subscription);
+      final sub = subscription.objectStream.listen(
+        _handleMediaObject,
+        onError: (error) => _logger.e('Object stream error: $error'),
+        onDone: () => _logger.i('Object stream closed'),
+      );
+      _objectSubscriptions.add(sub);
+    }
+
+    _eventTimer ??= _startEventTimer();
+
+    _isInitialized = true;
+    _logger.i('Native player initialized');
+  }
+
+  /// Build the player and decoder from catalog metadata before any media arrives
+  ///
+  /// mpv is created and told the container up front so it skips format probing.
+  /// When the video track carries init data (an AVC decoder configuration record,
+  /// or a CMAF init segment containing one), the init segment is written and
+  /// playback started right away, so the demuxer is open and waiting by the time
+  /// the first keyframe arrives. Otherwise the init segment is still built from
+  /// the first keyframe, as in [initialize]. Call [initialize] afterwards to
+  /// attach the subscriptions.
+  void prepareFromCatalog(
+    List<CatalogTrack> tracks, {
+    VideoOutputMode outputMode = VideoOutputMode.window,
+  }) {
+    if (_nativePlayer != null) {
+      _logger.w('Player already created');
+      return;
+    }
+
+    if (!_startupClock.isRunning) {
+      _startupClock.start();
+    }
+    _createNativePlayer(outputMode);
+    _nativePlayer!.setStreamHints(format: 'mp4');
+
+    for (final track in tracks) {
+      _catalogTracks[track.name] = track;
+    }
+    final video = tracks.where((track) => track.role == 'video').firstOrNull;
+    _createMuxers(video);
+    _createSink(video);
+
+    final config = video != null ? _catalogAvcConfig(video) : null;
+    if (config != null) {
+      _videoMuxer!.setAvcDecoderConfig(config);
+      _hasWrittenInit = true;
+      if (_sink != null) {
+        _sink!.setCodecConfig(config);
+      } else {
+        _writeToBuffer(_videoMuxer!.initSegment!);
+      }
+      _startPlayback();
+      _logger.i(
+        'Pre-initialized player from catalog for ${video!.name} '
+        '(${_videoMuxer!.codecString})',
+      );
+    } else {
+      _logger.i('Catalog has no video init data, decoder waits for first keyframe');
+    }
+
+    _eventTimer ??= _startEventTimer();
+    _preparedFromCatalog = true;
+  }
+
+  /// Subscribe the catalog's media tracks and play them
+  ///
+  /// The player is built from catalog metadata while the SUBSCRIBEs are in
+  /// flight instead of after the first objects arrive.
+  Future<CatalogPlaybackSession> playCatalog(
+    MoQCatalogSubscriber subscriber,
+    List<Uint8List> trackNamespace, {
+    String? videoTrackName,
+    String? audioTrackName,
+    VideoOutputMode outputMode = VideoOutputMode.window,
+  }) async {
+    final catalog = await subscriber.subscribeCatalog(trackNamespace);
+    final tracks = subscriber.selectMediaTracks(
+      catalog,
+      videoTrackName: videoTrackName,
+      audioTrackName: audioTrackName,
+    );
+
+    _startupClock
+      ..reset()
+      ..start();
+    final sessionFuture = subscriber.subscribePlaybackTracks(
+      trackNamespace,
+      videoTrackName: videoTrackName,
+      audioTrackName: audioTrackName,
+      includeTimelines: false,
+    );
+
+    // Let the first SUBSCRIBE go out before blocking on mpv setup
+    await Future<void>.delayed(Duration.zero);
+    _subscribeSentAt = _startupClock.elapsed;
+    prepareFromCatalog(tracks, outputMode: outputMode);
+
+    final session = await sessionFuture;
+    await initialize(session.mediaSubscriptions, outputMode: outputMode);
+    return session;
+  }
+
+  void _createNativePlayer(VideoOutputMode outputMode) {
+    _playerCreatedAt = _startupClock.elapsed;
     _nativePlayer = NativeMediaPlayer.createWithOutput(outputMode);
     if (_nativePlayer == null) {
       throw StateError('Failed to create native media player - is libmpv installed?');
     }
+  }
 
+  void _createMuxers(CatalogTrack? video) {
     // Create muxers for fMP4 output
     _videoMuxer = AvccFmp4Muxer(
-      width: 1920,
-      height: 1080,
+      width: video?.selectionParams?.width ?? 1920,
+      height: video?.selectionParams?.height ?? 1080,
       timescale: 90000,
       trackId: 1,
     );
@@ -108,24 +268,152 @@ class NativeMoQPlayer {
       channels: 2,
       trackId: 2,
     );
+  }
 
-    // Subscribe to incoming objects
-    for (final subscription in subscriptions) {
-      final sub = subscription.objectStream.listen(
-        _handleMediaObject,
-        onError: (error) => _logger.e('Object stream error: $error'),
-        onDone: () => _logger.i('Object stream closed'),
-      );
-      _objectSubscriptions.add(sub);
+  /// Create the playback sink when [nativeDataPlane] is set
+  void _createSink(CatalogTrack? video) {
+    if (!nativeDataPlane || _sink != null || _nativePlayer == null) return;
+    _sink = NativePlaybackSink.create(
+      _nativePlayer!,
+      packaging: PlaybackSinkPackaging.moqMi,
+      width: video?.selectionParams?.width ?? 1920,
+      height: video?.selectionParams?.height ?? 1080,
+    );
+    if (_sink == null) {
+      _logger.w('Native data plane not available, muxing in Dart');
+    }
+  }
+
+  /// Route a subscription's new streams to the sink
+  ///
+  /// Encrypted tracks stay on the Dart path, which decrypts them, as do
+  /// catalog tracks the sink cannot depacketize. Without a catalog the role
+  /// is taken from the track name, as on the Dart path.
+  void _routeToSink(MoQSubscription subscription) {
+    final alias = subscription.assignedTrackAlias;
+    if (_sink == null || alias == null) return;
+
+    final trackName = String.fromCharCodes(subscription.trackName);
+    final client = subscription.client;
+    if (client.objectEncryption?.isProtected(
+          subscription.trackNamespace,
+          subscription.trackName,
+        ) ??
+        false) {
+      _logger.i('$trackName is encrypted, muxing in Dart');
+      return;
+    }
+
+    final catalogTrack = _catalogTracks[trackName];
+    final PlaybackSinkTrack track;
+    if (catalogTrack != null) {
+      if (catalogTrack.packaging != null && catalogTrack.packaging != 'loc') {
+        _logger.i(
+          '$trackName is packaged as ${catalogTrack.packaging}, muxing in Dart',
+        );
+        return;
+      }
+      switch (catalogTrack.role) {
+        case 'video':
+          track = PlaybackSinkTrack.video;
+        case 'audio':
+          track = PlaybackSinkTrack.audio;
+        default:
+          return;
+      }
+    } else {
+      track = trackName.contains('video')
+          ? PlaybackSinkTrack.video
+          : PlaybackSinkTrack.audio;
+    }
+
+    final routed = client.transport.routeTrackToNative(
+      alias.toInt(),
+      _sink!.sinkId,
+      track: track.value,
+      version: client.selectedVersion,
+      replayCacheBytes: replayCacheBytes,
+    );
+    if (routed) {
+      _routedTracks.add((client, alias.toInt()));
+      _logger.i('Routed $trackName (alias $alias) to native playback');
+    } else {
+      _logger.w('Transport cannot route $trackName natively, muxing in Dart');
     }
+  }
 
-    // Start event processing timer
-    _eventTimer = Timer.periodic(const Duration(milliseconds: 50), (_) {
-      _nativePlayer?.processEvents();
+  Timer _startEventTimer() {
+    // Poll quickly until the first frame so startup milestones are timed
+    // accurately, then fall back to the normal rate
+    return Timer.periodic(const Duration(milliseconds: 10), (timer) {
+      _processEvents();
+      if (_nativePlayer?.getStartupTiming().firstFrame != null) {
+        timer.cancel();
+        _eventTimer = Timer.periodic(const Duration(milliseconds: 50), (_) {
+          _processEvents();
+        });
+      }
     });
+  }
 
-    _isInitialized = true;
-    _logger.i('Native player initialized');
+  void _processEvents() {
+    _nativePlayer?.processEvents();
+    final sink = _sink;
+    if (sink == null) return;
+
+    for (final event in sink.pollEvents()) {
+      switch (event.type) {
+        case PlaybackSinkEventType.initWritten:
+          _hasWrittenInit = true;
+        case PlaybackSinkEventType.firstKeyframe:
+          _firstKeyframeAt ??= _startupClock.elapsed;
+        case PlaybackSinkEventType.endOfTrack:
+          _logger.i('Received end of track ${event.value} on native data plane');
+        case PlaybackSinkEventType.streamError:
+          _logger.w('Native data plane dropped a broken stream');
+        case PlaybackSinkEventType.bufferOverflow:
+          _logger.w('Buffer full: dropped ${event.value} bytes');
+      }
+    }
+    // Auto-start playback once data is flowing, as on the Dart path
+    if (!_isPlaying && _hasWrittenInit && bytesWrittenToBuffer > 1024) {
+      _startPlayback();
+    }
+  }
+
+  /// AVC decoder configuration from a catalog track's init data
+  ///
+  /// Accepts either the bare record or an init segment containing an avcC box.
+  static Uint8List? _catalogAvcConfig(CatalogTrack track) {
+    final initData = track.initData;
+    if (initData == null || initData.isEmpty) return null;
+
+    final Uint8List bytes;
+    try {
+      bytes = base64.decode(initData);
+    } on FormatException {
+      return null;
+    }
+
+    // configurationVersion is always 1
+    if (bytes.length >= 7 && bytes[0] == 1) {
+      return bytes;
+    }
+
+    // Search the init segment for the avcC box
+    for (var i = 4; i + 4 <= bytes.length; i++) {
+      if (bytes[i] == 0x61 &&
+          bytes[i + 1] == 0x76 &&
+          bytes[i + 2] == 0x63 &&
+          bytes[i + 3] == 0x43) {
+        final size = ByteData.sublistView(bytes, i - 4, i).getUint32(0);
+        final end = i - 4 + size;
+        if (size > 8 && end <= bytes.length) {
+          return Uint8List.sublistView(bytes, i + 4, end);
+        }
+      }
+    }
+    return null;
   }
 
   void _handleMediaObject(MoQObject object) {
@@ -144,6 +432,11 @@ class NativeMoQPlayer {
       return;
     }
 
+    _firstObjectAt ??= _startupClock.elapsed;
+    if (_sink != null) {
+      _handOverToSink(object, isVideo);
+      return;
+    }
     _objectsReceived++;
     _bytesReceived += object.payload!.length;
 
@@ -172,6 +465,25 @@ class NativeMoQPlayer {
     }
   }
 
+  /// Pass an object that came through Dart to the native data plane, which
+  /// applies its own group tracking
+  void _handOverToSink(MoQObject object, bool isVideo) {
+    final frame = _mediaDecoder.decode(object);
+    if (frame == null) {
+      debugPrint('NativeMoQPlayer: Failed to decode frame');
+      return;
+    }
+    _sink!.pushFrame(
+      track: isVideo ? PlaybackSinkTrack.video : PlaybackSinkTrack.audio,
+      groupId: object.groupId.toInt(),
+      objectId: object.objectId.toInt(),
+      data: frame.data,
+      duration: frame.duration.toInt(),
+      timebase: frame.timebase.toInt(),
+      config: frame.codecConfig,
+    );
+  }
+
   /// Handle video group tracking for mid-stream join detection
   /// Returns true if the frame should be processed, false if it should be skipped
   bool _handleVideoGroupTracking(MoQObject object) {
@@ -251,6 +563,9 @@ class NativeMoQPlayer {
     }
 
     if (_videoMuxer!.isInitReady) {
+      if (_firstKeyframeAt == null && frame.isKeyframe) {
+        _firstKeyframeAt = _startupClock.elapsed;
+      }
       // Create and write media segment
       final mediaSegment = _videoMuxer!.createMediaSegment(frame);
       _writeToBuffer(mediaSegment);
@@ -313,7 +628,7 @@ class NativeMoQPlayer {
     }
 
     // Don't call native play() until we have data - mpv would block waiting
-    if (_hasWrittenInit && _bytesWrittenToBuffer > 1024) {
+    if (_hasWrittenInit && bytesWrittenToBuffer > 1024) {
       _startPlayback();
     } else {
       _logger.i('Waiting for media data before starting playback (will auto-start)');
@@ -341,30 +656,59 @@ class NativeMoQPlayer {
   /// Get buffer statistics
   MediaPlayerStats? getStats() => _nativePlayer?.getStats();
 
+  /// Time-to-first-frame breakdown (null before the player is created)
+  PlaybackStartupReport? get startupReport {
+    final native = _nativePlayer?.getStartupTiming();
+    if (native == null) return null;
+    return PlaybackStartupReport(
+      preparedFromCatalog: _preparedFromCatalog,
+      subscribeSent: _subscribeSentAt,
+      playerCreated: _playerCreatedAt,
+      firstObject: _firstObjectAt,
+      firstKeyframeWritten: _firstKeyframeAt,
+      native: native,
+    );
+  }
+
   /// Check if initialized
   bool get isInitialized => _isInitialized;
 
   /// Check if playing
   bool get isPlaying => _nativePlayer?.isPlaying ?? false;
 
+  /// Native data plane counters (null on the Dart path)
+  PlaybackSinkStats? get dataPlaneStats => _sink?.getStats();
+
   /// Get statistics
-  int get objectsReceived => _objectsReceived;
-  int get bytesReceived => _bytesReceived;
-  int get bytesWrittenToBuffer => _bytesWrittenToBuffer;
-  int get videoFramesReceived => _videoFramesReceived;
-  int get audioFramesReceived => _audioFramesReceived;
+  int get objectsReceived => dataPlaneStats?.objects ?? _objectsReceived;
+  int get bytesReceived => dataPlaneStats?.payloadBytes ?? _bytesReceived;
+  int get bytesWrittenToBuffer =>
+      dataPlaneStats?.bytesWritten ?? _bytesWrittenToBuffer;
+  int get videoFramesReceived =>
+      dataPlaneStats?.videoFrames ?? _videoFramesReceived;
+  int get audioFramesReceived =>
+      dataPlaneStats?.audioFrames ?? _audioFramesReceived;
 
   /// Dispose resources
   Future<void> dispose() async {
     _logger.i('Disposing native player');
 
     _eventTimer?.cancel();
+    _eventTimer = null;
 
     for (final sub in _objectSubscriptions) {
       await sub.cancel();
     }
     _objectSubscriptions.clear();
 
+    // Send the tracks back to Dart before the sink goes away
+    for (final (client, alias) in _routedTracks) {
+      client.transport.unrouteTrack(alias);
+    }
+    _routedTracks.clear();
+    _sink?.dispose();
+    _sink = null;
+
     _nativePlayer?.dispose();
     _nativePlayer = null;
 
@@ -374,6 +718,14 @@ class NativeMoQPlayer {
     _isInitialized = false;
     _isPlaying = false;
     _hasWrittenInit = false;
+    _preparedFromCatalog = false;
+    _catalogTracks.clear();
+    _startupClock
+      ..stop()
+      ..reset();
+    _subscribeSentAt = null;
+    _firstObjectAt = null;
+    _firstKeyframeAt = null;
 
     // Reset group tracking state
     _currentVideoGroupId = null;
@@ -382,3 +734,43 @@ class NativeMoQPlayer {
     _skippedVideoFrames = 0;
   }
 }
+
+/// Time-to-first-frame breakdown for a native playback session
+///
+/// Durations are measured from the start of [NativeMoQPlayer.playCatalog], or
+/// from player creation when [NativeMoQPlayer.initialize] was used directly.
+/// [native] milestones are relative to [playerCreated].
+class PlaybackStartupReport {
+  final bool preparedFromCatalog;
+  final Duration? subscribeSent;
+  final Duration playerCreated;
+  final Duration? firstObject;
+  final Duration? firstKeyframeWritten;
+  final MediaPlayerStartupTiming native;
+
+  const PlaybackStartupReport({
+    required this.preparedFromCatalog,
+    this.subscribeSent,
+    this.playerCreated = Duration.zero,
+    this.firstObject,
+    this.firstKeyframeWritten,
+    required this.native,
+  });
+
+  /// First frame on screen, on the same origin as [firstObject]
+  Duration? get firstFrame =>
+      native.firstFrame != null ? playerCreated + native.firstFrame! : null;
+
+  /// Time from the first object arriving to the first frame on screen
+  Duration? get firstObjectToFirstFrame =>
+      firstObject != null && firstFrame != null
+      ? firstFrame! - firstObject!
+      : null;
+
+  @override
+  String toString() =>
+      'PlaybackStartupReport(catalog: $preparedFromCatalog, '
+      'subscribe: $subscribeSent, playerCreated: $playerCreated, '
+      'firstObject: $firstObject, '
+      'firstKeyframe: $firstKeyframeWritten, native: $native)';
+}
@@ -0,0 +1,438 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:logger/logger.dart';
+
+import '../client/moq_client.dart';
+import '../protocol/moq_messages.dart';
+import '../transport/moq_transport.dart';
+import 'moq_catalog.dart';
+
+/// Why the ABR controller changed rendition
+enum AbrSwitchReason {
+  /// Goodput fell below the current rendition's bitrate
+  congestion,
+
+  /// Measured capacity leaves headroom for the next rendition up
+  headroom,
+
+  /// Requested through [MoQAbrController.switchTo]
+  manual,
+}
+
+/// A rendition change made by [MoQAbrController]
+class AbrDecision {
+  final CatalogTrack from;
+  final CatalogTrack to;
+  final AbrSwitchReason reason;
+  final BandwidthEstimate? estimate;
+
+  /// Group at which the new rendition took over (null until the cutover)
+  final Int64? switchGroup;
+  final DateTime timestamp;
+
+  AbrDecision({
+    required this.from,
+    required this.to,
+    required this.reason,
+    this.estimate,
+    this.switchGroup,
+    DateTime? timestamp,
+  }) : timestamp = timestamp ?? DateTime.now();
+
+  @override
+  String toString() =>
+      'AbrDecision(${from.name} -> ${to.name}, $reason, '
+      'goodput: ${estimate?.goodputBps}, capacity: ${estimate?.capacityBps})';
+}
+
+/// Snapshot of the controller state, emitted on every evaluation
+class AbrMetrics {
+  final CatalogTrack current;
+  final CatalogTrack? pending;
+  final BandwidthEstimate? estimate;
+  final int upSwitches;
+  final int downSwitches;
+
+  const AbrMetrics({
+    required this.current,
+    this.pending,
+    this.estimate,
+    this.upSwitches = 0,
+    this.downSwitches = 0,
+  });
+
+  int get switchCount => upSwitches + downSwitches;
+}
+
+/// Tuning for [MoQAbrController]
+class AbrOptions {
+  /// How often the bandwidth estimate is sampled
+  final Duration pollInterval;
+
+  /// Time after a switch before the new rendition's goodput is trusted
+  /// (the native goodput window is 2 seconds)
+  final Duration warmup;
+
+  /// Switch down when goodput stays below this fraction of the current bitrate
+  final double downSwitchRatio;
+
+  /// How long goodput must stay low before switching down
+  final Duration downSwitchHold;
+
+  /// Fraction of the measured capacity a higher rendition may use
+  final double upSwitchHeadroom;
+
+  /// How long capacity must stay high before switching up
+  final Duration upSwitchHold;
+
+  /// Longest time the old rendition is kept after the new one delivered its
+  /// first group, if the old one never reaches that group
+  final Duration cutoverTimeout;
+
+  const AbrOptions({
+    this.pollInterval = const Duration(milliseconds: 500),
+    this.warmup = const Duration(seconds: 2),
+    this.downSwitchRatio = 0.85,
+    this.downSwitchHold = const Duration(seconds: 1),
+    this.upSwitchHeadroom = 0.8,
+    this.upSwitchHold = const Duration(seconds: 4),
+    this.cutoverTimeout = const Duration(seconds: 1),
+  });
+}
+
+/// Receiver-driven rendition switching between catalog tracks
+///
+/// Renditions are the video tracks of one alt group, ordered by their catalog
+/// bitrate. The controller samples the transport's per-track bandwidth estimate
+/// and switches make-before-break: the new rendition is subscribed from its next
+/// group start while the old one keeps playing, then the old one is dropped at
+/// the first group the new one delivered. Renditions of an alt group share group
+/// numbering, so the cutover lands on a keyframe of the new track.
+class MoQAbrController {
+  final MoQClient _client;
+  final List<Uint8List> _trackNamespace;
+  final List<CatalogTrack> renditions;
+  final AbrOptions options;
+  final Logger _logger;
+
+  final _objectController = StreamController<MoQObject>.broadcast();
+  final _decisionController = StreamController<AbrDecision>.broadcast();
+  final _metricsController = StreamController<AbrMetrics>.broadcast();
+
+  late CatalogTrack _current;
+  MoQSubscription? _active;
+  StreamSubscription<MoQObject>? _activeListener;
+  DateTime _activeSince = DateTime.now();
+
+  _PendingSwitch? _pending;
+
+  Timer? _pollTimer;
+  BandwidthEstimate? _lastEstimate;
+  DateTime? _belowSince;
+  DateTime? _aboveSince;
+  int _upSwitches = 0;
+  int _downSwitches = 0;
+  bool _closed = false;
+
+  MoQAbrController({
+    required MoQClient client,
+    required List<Uint8List> trackNamespace,
+    required List<CatalogTrack> renditions,
+    this.options = const AbrOptions(),
+    Logger? logger,
+  }) : _client = client,
+       _trackNamespace = trackNamespace,
+       renditions = List.unmodifiable(
+         [...renditions]..sort((a, b) => _bitrate(a).compareTo(_bitrate(b))),
+       ),
+       _logger = logger ?? Logger() {
+    if (this.renditions.isEmpty) {
+      throw ArgumentError('At least one rendition is required');
+    }
+  }
+
+  /// Video renditions in a catalog that carry a bitrate, lowest first
+  ///
+  /// When [altGroup] is null the alt group of the first such track is used.
+  static List<CatalogTrack> videoRenditions(
+    MoQCatalog catalog, {
+    int? altGroup,
+  }) {
+    final candidates = catalog.tracks
+        .where(
+          (track) =>
+              track.role == 'video' && track.selectionParams?.bitrate != null,
+        )
+        .toList();
+    if (candidates.isEmpty) return [];
+
+    final group = altGroup ?? candidates.first.altGroup;
+    return candidates.where((track) => track.altGroup == group).toList()
+      ..sort((a, b) => _bitrate(a).compareTo(_bitrate(b)));
+  }
+
+  /// Objects of whichever rendition is currently playing
+  Stream<MoQObject> get objectStream => _objectController.stream;
+
+  /// Rendition changes, emitted at cutover
+  Stream<AbrDecision> get decisions => _decisionController.stream;
+
+  /// Estimates and controller state, emitted on every evaluation
+  Stream<AbrMetrics> get metricsStream => _metricsController.stream;
+
+  CatalogTrack get currentRendition => _current;
+
+  AbrMetrics get metrics => AbrMetrics(
+    current: _current,
+    pending: _pending?.track,
+    estimate: _lastEstimate,
+    upSwitches: _upSwitches,
+    downSwitches: _downSwitches,
+  );
+
+  /// Subscribe the initial rendition and start adapting
+  ///
+  /// Starts at [initialTrackName] if given, otherwise at the lowest rendition so
+  /// the first frame arrives as soon as possible.
+  Future<void> start({
+    String? initialTrackName,
+    FilterType filterType = FilterType.largestObject,
+  }) async {
+    _current = initialTrackName == null
+        ? renditions.first
+        : renditions.firstWhere((track) => track.name == initialTrackName);
+    _setActive(await _subscribe(_current, filterType));
+    _pollTimer = Timer.periodic(options.pollInterval, (_) => _evaluate());
+  }
+
+  /// Switch to [track] regardless of the estimate
+  Future<void> switchTo(CatalogTrack track) =>
+      _beginSwitch(track, AbrSwitchReason.manual);
+
+  Future<void> close() async {
+    if (_closed) return;
+    _closed = true;
+    _pollTimer?.cancel();
+    _pollTimer = null;
+
+    final pending = _pending;
+    _pending = null;
+    if (pending != null) {
+      await pending.dispose();
+      if (pending.subscription != null) {
+        await _unsubscribe(pending.subscription!);
+      }
+    }
+
+    await _activeListener?.cancel();
+    _activeListener = null;
+    if (_active != null) {
+      await _unsubscribe(_active!);
+      _active = null;
+    }
+
+    await _objectController.close();
+    await _decisionController.close();
+    await _metricsController.close();
+  }
+
+  void _evaluate() {
+    if (_closed || _active == null) return;
+
+    final alias = _active!.assignedTrackAlias;
+    final estimate = alias == null
+        ? null
+        : _client.transport.bandwidthEstimate(alias.toInt());
+    _lastEstimate = estimate;
+    _metricsController.add(metrics);
+
+    if (estimate == null || _pending != null) return;
+    final now = DateTime.now();
+    if (now.difference(_activeSince) < options.warmup) return;
+
+    final index = renditions.indexOf(_current);
+    final bitrate = _bitrate(_current);
+
+    if (index > 0 && estimate.goodputBps < bitrate * options.downSwitchRatio) {
+      _aboveSince = null;
+      _belowSince ??= now;
+      if (now.difference(_belowSince!) >= options.downSwitchHold) {
+        // Drop straight to the rendition the delivered rate can sustain
+        final usable = estimate.goodputBps * options.upSwitchHeadroom;
+        final target = renditions
+            .take(index)
+            .lastWhere(
+              (track) => _bitrate(track) <= usable,
+              orElse: () => renditions.first,
+            );
+        unawaited(_beginSwitch(target, AbrSwitchReason.congestion, estimate));
+      }
+      return;
+    }
+    _belowSince = null;
+
+    if (index < renditions.length - 1 &&
+        estimate.capacityBps * options.upSwitchHeadroom >=
+            _bitrate(renditions[index + 1])) {
+      _aboveSince ??= now;
+      if (now.difference(_aboveSince!) >= options.upSwitchHold) {
+        // One step at a time: capacity samples come from short bursts
+        unawaited(
+          _beginSwitch(
+            renditions[index + 1],
+            AbrSwitchReason.headroom,
+            estimate,
+          ),
+        );
+      }
+    } else {
+      _aboveSince = null;
+    }
+  }
+
+  Future<void> _beginSwitch(
+    CatalogTrack target,
+    AbrSwitchReason reason, [
+    BandwidthEstimate? estimate,
+  ]) async {
+    if (_closed || _pending != null || target.name == _current.name) return;
+
+    _logger.i('ABR switching ${_current.name} -> ${target.name} ($reason)');
+    final pending = _PendingSwitch(target, reason, estimate);
+    _pending = pending;
+    _belowSince = null;
+    _aboveSince = null;
+
+    try {
+      pending.subscription = await _subscribe(
+        target,
+        FilterType.nextGroupStart,
+      );
+    } catch (e) {
+      _logger.w('ABR switch to ${target.name} failed: $e');
+      if (identical(_pending, pending)) _pending = null;
+      return;
+    }
+    if (_closed || !identical(_pending, pending)) {
+      await _unsubscribe(pending.subscription!);
+      return;
+    }
+
+    pending.listener = pending.subscription!.objectStream.listen((object) {
+      if (!identical(_pending, pending)) return;
+      if (pending.switchGroup == null) {
+        pending.switchGroup = object.groupId;
+        pending.timeout = Timer(options.cutoverTimeout, () {
+          if (identical(_pending, pending)) _cutover(pending);
+        });
+      }
+      pending.buffered.add(object);
+    });
+  }
+
+  void _onActiveObject(MoQObject object) {
+    final pending = _pending;
+    if (pending != null && pending.switchGroup != null) {
+      if (object.groupId >= pending.switchGroup!) {
+        // The old rendition reached the group the new one starts with
+        _cutover(pending);
+        return;
+      }
+    }
+    _objectController.add(object);
+  }
+
+  Future<void> _cutover(_PendingSwitch pending) async {
+    _pending = null;
+    pending.timeout?.cancel();
+    final oldListener = _activeListener;
+    final oldSubscription = _active;
+    _activeListener = null;
+
+    final previous = _current;
+    _current = pending.track;
+    for (final object in pending.buffered) {
+      _objectController.add(object);
+    }
+    pending.buffered.clear();
+    _setActive(pending.subscription!);
+
+    if (_bitrate(pending.track) > _bitrate(previous)) {
+      _upSwitches++;
+    } else {
+      _downSwitches++;
+    }
+    _decisionController.add(
+      AbrDecision(
+        from: previous,
+        to: pending.track,
+        reason: pending.reason,
+        estimate: pending.estimate,
+        switchGroup: pending.switchGroup,
+      ),
+    );
+
+    await pending.listener?.cancel();
+    await oldListener?.cancel();
+    if (oldSubscription != null) {
+      await _unsubscribe(oldSubscription);
+    }
+  }
+
+  void _setActive(MoQSubscription subscription) {
+    _active = subscription;
+    _activeSince = DateTime.now();
+    _activeListener = subscription.objectStream.listen(
+      _onActiveObject,
+      onError: (Object error, StackTrace stackTrace) {
+        _logger.e('Rendition stream error: $error');
+      },
+    );
+  }
+
+  Future<MoQSubscription> _subscribe(
+    CatalogTrack track,
+    FilterType filterType,
+  ) async {
+    final result = await _client.subscribe(
+      _trackNamespace,
+      Uint8List.fromList(track.name.codeUnits),
+      filterType: filterType,
+      groupOrder: GroupOrder.ascending,
+    );
+    return result.subscription;
+  }
+
+  Future<void> _unsubscribe(MoQSubscription subscription) async {
+    if (!_client.isConnected) return;
+    try {
+      await _client.unsubscribe(subscription.id);
+    } catch (e) {
+      _logger.w('Failed to unsubscribe rendition: $e');
+    }
+  }
+
+  static int _bitrate(CatalogTrack track) =>
+      track.selectionParams?.bitrate ?? 0;
+}
+
+class _PendingSwitch {
+  final CatalogTrack track;
+  final AbrSwitchReason reason;
+  final BandwidthEstimate? estimate;
+  MoQSubscription? subscription;
+  StreamSubscription<MoQObject>? listener;
+  Timer? timeout;
+  Int64? switchGroup;
+  final List<MoQObject> buffered = [];
+
+  _PendingSwitch(this.track, this.reason, this.estimate);
+
+  Future<void> dispose() async {
+    timeout?.cancel();
+    await listener?.cancel();
+    buffered.clear();
+  }
+}
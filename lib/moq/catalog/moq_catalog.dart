@@ -18,6 +18,9 @@ class MoQCatalog {
   /// Legacy track name accepted on input for compatibility only.
   static const String legacyCatalogTrackName = '.catalog';
 
+  /// Role of low-rate JPEG preview tracks that accompany a video track.
+  static const String thumbnailRole = 'thumbnail';
+
   MoQCatalog({
     this.version = 1,
     this.format,
@@ -112,6 +115,18 @@ class MoQCatalog {
   static MoQCatalog fromBytes(Uint8List bytes) {
     return fromJson(utf8.decode(bytes));
   }
+
+  /// Thumbnail track previewing [videoTrackName], if the publisher emits one
+  CatalogTrack? thumbnailTrackFor(String videoTrackName) {
+    for (final track in tracks) {
+      if (track.role == thumbnailRole &&
+          (track.parentName == videoTrackName ||
+              (track.depends?.contains(videoTrackName) ?? false))) {
+        return track;
+      }
+    }
+    return null;
+  }
 }
 
 /// Legacy common-track fields retained for backward-compatible parsing.
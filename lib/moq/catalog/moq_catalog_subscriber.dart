@@ -5,6 +5,7 @@ import 'package:logger/logger.dart';
 
 import '../client/moq_client.dart';
 import '../protocol/moq_messages.dart';
+import 'moq_abr_controller.dart';
 import 'moq_catalog.dart';
 import 'moq_timeline.dart';
 
@@ -118,7 +119,7 @@ class MoQCatalogSubscriber {
     GroupOrder groupOrder = GroupOrder.descending,
   }) async {
     final catalog = await subscribeCatalog(trackNamespace);
-    final mediaTracks = _selectMediaTracks(
+    final mediaTracks = selectMediaTracks(
       catalog,
       videoTrackName: videoTrackName,
       audioTrackName: audioTrackName,
@@ -170,6 +171,37 @@ class MoQCatalogSubscriber {
     );
   }
 
+  /// Play the catalog's video renditions with receiver-driven rendition switching
+  ///
+  /// Unlike [subscribePlaybackTracks], the video track is not fixed: the returned
+  /// controller moves between the renditions of [altGroup] as the estimated
+  /// bandwidth changes.
+  Future<MoQAbrController> subscribeAdaptiveVideo(
+    List<Uint8List> trackNamespace, {
+    int? altGroup,
+    String? initialTrackName,
+    AbrOptions options = const AbrOptions(),
+  }) async {
+    final catalog = await subscribeCatalog(trackNamespace);
+    final renditions = MoQAbrController.videoRenditions(
+      catalog,
+      altGroup: altGroup,
+    );
+    if (renditions.isEmpty) {
+      throw StateError('Catalog does not contain video renditions with bitrates');
+    }
+
+    final controller = MoQAbrController(
+      client: _client,
+      trackNamespace: trackNamespace,
+      renditions: renditions,
+      options: options,
+      logger: _logger,
+    );
+    await controller.start(initialTrackName: initialTrackName);
+    return controller;
+  }
+
   Future<void> dispose({bool unsubscribeCatalog = true}) async {
     await _catalogObjectSubscription?.cancel();
     _catalogObjectSubscription = null;
@@ -206,7 +238,11 @@ class MoQCatalogSubscriber {
     }
   }
 
-  List<CatalogTrack> _selectMediaTracks(
+  /// Media tracks [subscribePlaybackTracks] would play from [catalog]
+  ///
+  /// Lets a player prepare its decoders from catalog metadata before the
+  /// subscriptions are established.
+  List<CatalogTrack> selectMediaTracks(
     MoQCatalog catalog, {
     String? videoTrackName,
     String? audioTrackName,
@@ -283,18 +319,13 @@ class MoQCatalogSubscriber {
     FilterType filterType = FilterType.largestObject,
     GroupOrder groupOrder = GroupOrder.descending,
   }) async {
-    final previousIds = _client.subscriptions.keys.toSet();
-    await _client.subscribe(
+    final result = await _client.subscribe(
       trackNamespace,
       trackName,
       filterType: filterType,
       groupOrder: groupOrder,
     );
-    final newIds = _client.subscriptions.keys.toSet().difference(previousIds);
-    if (newIds.length != 1) {
-      throw StateError('Could not resolve new subscription for track');
-    }
-    return _client.subscriptions[newIds.single]!;
+    return result.subscription;
   }
 
   void _listenToTimelineTrack(
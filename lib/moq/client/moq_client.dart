@@ -6,6 +6,7 @@ import '../protocol/moq_messages.dart';
 import '../protocol/moq_data_parser.dart';
 import '../transport/moq_transport.dart';
 import '../packager/moq_mi_packager.dart';
+import 'moq_object_encryption.dart';
 import 'replay_stream.dart';
 
 /// Session termination error codes per draft-ietf-moq-transport-14/16 Section 3.4
@@ -67,6 +68,13 @@ class MoQClient {
   final _dataStreamParsers = <int, MoQDataStreamParser>{};
   final _outgoingStreamObjects = <int, Int64>{};
   final _outgoingStreamHasExtensions = <int, bool>{};
+  final _outgoingStreamGroups = <int, ({Int64 trackAlias, Int64 groupId})>{};
+
+  /// End-to-end payload encryption (null sends and accepts everything in the clear)
+  MoQObjectEncryption? objectEncryption;
+
+  // Objects parsed from one data stream chunk, opened as one batch
+  List<(MoQSubscription, MoQObject)>? _objectBatch;
 
   // Data stream subscription
   StreamSubscription<DataStreamChunk>? _dataStreamSubscription;
@@ -82,6 +90,22 @@ class MoQClient {
   final _connectionStateController = StreamController<bool>.broadcast();
   final _goawayController = StreamController<GoawayEvent>.broadcast();
 
+  // Session recovery (null disables automatic recovery)
+  final SessionRecoveryOptions? _recovery;
+  final _recoveryController =
+      StreamController<SessionRecoveryEvent>.broadcast();
+  StreamSubscription<bool>? _transportStateSubscription;
+  ({
+    String host,
+    int port,
+    List<int>? supportedVersions,
+    int? targetVersion,
+    Map<String, String>? options,
+  })?
+  _lastConnect;
+  bool _isRecovering = false;
+  int _sessionEpoch = 0; // Bumped by disconnect() to cancel recovery
+
   // Setup parameters received from server
   final List<KeyValuePair> _serverSetupParameters = [];
   int _maxSubscriptionId = 0;
@@ -100,9 +124,13 @@ class MoQClient {
   /// Get the underlying transport (for advanced usage)
   MoQTransport get transport => _transport;
 
-  MoQClient({required MoQTransport transport, Logger? logger})
-    : _transport = transport,
-      _logger = logger ?? Logger();
+  MoQClient({
+    required MoQTransport transport,
+    Logger? logger,
+    SessionRecoveryOptions? recovery,
+  }) : _transport = transport,
+       _logger = logger ?? Logger(),
+       _recovery = recovery;
 
   /// Connection state
   bool get isConnected => _isConnected;
@@ -153,6 +181,17 @@ class MoQClient {
   /// reconnect to the new URI if provided.
   Stream<GoawayEvent> get goawayEvents => _goawayController.stream;
 
+  /// Stream of session recovery progress
+  ///
+  /// Only emits when the client was created with [SessionRecoveryOptions].
+  /// [SessionRecoveryPhase.trackResumed] events carry the outage-to-first-object
+  /// time for each restored subscription.
+  Stream<SessionRecoveryEvent> get recoveryEvents =>
+      _recoveryController.stream;
+
+  /// Whether the client is re-establishing a lost session
+  bool get isRecovering => _isRecovering;
+
   /// Connect to a MoQ server
   Future<void> connect(
     String host,
@@ -168,9 +207,6 @@ class MoQClient {
 
     _logger.i('Connecting to $host:$port');
 
-    // Setup completer for waiting on SERVER_SETUP
-    _setupCompleter = Completer<void>();
-
     // Listen for incoming control data
     try {
       _transport.incomingData.listen(
@@ -214,12 +250,50 @@ class MoQClient {
       );
     } catch (e) {
       _logger.e('Failed to listen to transport: $e');
-      _setupCompleter!.completeError(
-        MoQException(errorCode: -1, reason: 'Failed to listen: $e'),
-      );
       rethrow;
     }
 
+    await _performSetup(
+      host,
+      port,
+      supportedVersions: supportedVersions,
+      targetVersion: targetVersion,
+      options: options,
+    );
+
+    _isConnected = true;
+    _connectionStateController.add(true);
+    _logger.i('Connected successfully (version: $_selectedVersion)');
+
+    _lastConnect = (
+      host: host,
+      port: port,
+      supportedVersions: supportedVersions,
+      targetVersion: targetVersion,
+      options: options,
+    );
+    if (_recovery != null) {
+      _transportStateSubscription ??= _transport.connectionStateStream.listen(
+        (connected) {
+          if (!connected && _isConnected && !_isRecovering) {
+            unawaited(_recoverSession());
+          }
+        },
+      );
+    }
+  }
+
+  /// Connect the transport and exchange CLIENT_SETUP / SERVER_SETUP
+  Future<void> _performSetup(
+    String host,
+    int port, {
+    List<int>? supportedVersions,
+    int? targetVersion,
+    Map<String, String>? options,
+  }) async {
+    // Setup completer for waiting on SERVER_SETUP
+    _setupCompleter = Completer<void>();
+
     // Draft versions use 0xff000000 + draft number format per spec section 9.3.1
     // Draft-14 = 0xff00000E (confirmed by moqt.js reference implementation)
     // Draft-16: version is negotiated via ALPN/subprotocol before CLIENT_SETUP.
@@ -228,6 +302,7 @@ class MoQClient {
     // Connect to transport
     try {
       final transportOptions = <String, String>{
+        ...?_recovery?.transportOptions,
         ...?options,
         'moq_version': '$effectiveVersion',
       };
@@ -272,21 +347,175 @@ class MoQClient {
       );
     } catch (e) {
       _logger.e('Setup failed: $e');
-      await disconnect();
+      if (_isRecovering) {
+        await _transport.disconnect();
+      } else {
+        await disconnect();
+      }
       rethrow;
     }
+  }
 
-    _isConnected = true;
-    _connectionStateController.add(true);
-    _logger.i('Connected successfully (version: $_selectedVersion)');
+  /// Re-establish the session after transport loss, keeping subscriptions alive
+  ///
+  /// Subscription objects and their object streams stay open so players and
+  /// decoders remain initialized; only the per-session wire state (request IDs,
+  /// track aliases, data stream parsers) is rebuilt on the new connection.
+  Future<void> _recoverSession() async {
+    final recovery = _recovery!;
+    final params = _lastConnect!;
+    final epoch = _sessionEpoch;
+    final lostAt = DateTime.now();
+
+    _isRecovering = true;
+    _isConnected = false;
+    _connectionStateController.add(false);
+    _logger.w(
+      'Connection lost, recovering ${_subscriptions.length} subscriptions',
+    );
+    _recoveryController.add(
+      SessionRecoveryEvent(phase: SessionRecoveryPhase.connectionLost),
+    );
+
+    // Wire state belongs to the dead session
+    _dataStreamParsers.clear();
+    _controlBuffer.clear();
+    _trackAliases.clear();
+    _nextRequestId = Int64(0);
+
+    var backoff = recovery.initialBackoff;
+    Object? lastError;
+    for (var attempt = 1; attempt <= recovery.maxAttempts; attempt++) {
+      try {
+        await _transport.disconnect();
+        await _performSetup(
+          params.host,
+          params.port,
+          supportedVersions: params.supportedVersions,
+          targetVersion: params.targetVersion,
+          options: params.options,
+        );
+        if (epoch != _sessionEpoch) {
+          // disconnect() was called while reconnecting
+          await _transport.disconnect();
+          return;
+        }
+
+        _isRecovering = false;
+        _isConnected = true;
+        _connectionStateController.add(true);
+        _logger.i(
+          'Session recovered after ${DateTime.now().difference(lostAt).inMilliseconds}ms '
+          '(attempt $attempt)',
+        );
+        _recoveryController.add(
+          SessionRecoveryEvent(
+            phase: SessionRecoveryPhase.reconnected,
+            attempt: attempt,
+            outage: DateTime.now().difference(lostAt),
+          ),
+        );
+        await _replaySubscriptions(lostAt);
+        return;
+      } catch (e) {
+        if (epoch != _sessionEpoch) return;
+        lastError = e;
+        _logger.w('Recovery attempt $attempt failed: $e');
+        if (attempt == recovery.maxAttempts) break;
+        await Future<void>.delayed(backoff);
+        if (epoch != _sessionEpoch) return;
+        backoff = backoff * 2 > recovery.maxBackoff
+            ? recovery.maxBackoff
+            : backoff * 2;
+      }
+    }
+
+    _logger.e('Session recovery failed after ${recovery.maxAttempts} attempts');
+    _isRecovering = false;
+    _recoveryController.add(
+      SessionRecoveryEvent(
+        phase: SessionRecoveryPhase.failed,
+        attempt: recovery.maxAttempts,
+        error: lastError,
+      ),
+    );
+    for (final sub in _subscriptions.values) {
+      await sub.close();
+    }
+    _subscriptions.clear();
+  }
+
+  /// Re-issue SUBSCRIBE for every active subscription on the new session
+  Future<void> _replaySubscriptions(DateTime lostAt) async {
+    final filterType = _recovery!.resubscribeFilter;
+    for (final subscription in _subscriptions.values.toList()) {
+      _subscriptions.remove(subscription.id);
+      if (!subscription.isActive) continue;
+
+      final requestId = _getNextRequestId();
+      subscription._rebind(requestId, lostAt);
+      _subscriptions[requestId] = subscription;
+
+      final trackNameStr = String.fromCharCodes(subscription.trackName);
+      _logger.i('Restoring subscription to $trackNameStr (request $requestId)');
+
+      final subscribeMessage = SubscribeMessage(
+        requestId: requestId,
+        trackNamespace: subscription.trackNamespace,
+        trackName: subscription.trackName,
+        subscriberPriority: subscription.priority,
+        groupOrder: subscription.groupOrder,
+        forward: subscription.forward ? 1 : 0,
+        filterType: filterType,
+      );
+      await _transport.send(
+        subscribeMessage.serialize(version: _selectedVersion),
+      );
+
+      unawaited(
+        subscription.waitForResponse().then(
+          (_) {},
+          onError: (Object e) {
+            _logger.e('Failed to restore subscription to $trackNameStr: $e');
+            subscription.close();
+          },
+        ),
+      );
+    }
+  }
+
+  /// Report the first object delivered to a subscription after recovery
+  void _noteObjectDelivered(MoQSubscription subscription) {
+    final lostAt = subscription._recoveringSince;
+    if (lostAt == null) return;
+    subscription._recoveringSince = null;
+
+    final outage = DateTime.now().difference(lostAt);
+    _logger.i(
+      'Track ${String.fromCharCodes(subscription.trackName)} resumed '
+      '${outage.inMilliseconds}ms after connection loss',
+    );
+    _recoveryController.add(
+      SessionRecoveryEvent(
+        phase: SessionRecoveryPhase.trackResumed,
+        outage: outage,
+        trackName: subscription.trackName,
+      ),
+    );
   }
 
   /// Disconnect from the server
   Future<void> disconnect() async {
-    if (!_isConnected) return;
+    if (!_isConnected && !_isRecovering) return;
 
     _logger.i('Disconnecting');
 
+    // Stop watching for loss and cancel any recovery in progress
+    _sessionEpoch++;
+    _isRecovering = false;
+    await _transportStateSubscription?.cancel();
+    _transportStateSubscription = null;
+
     // Complete setup completer if still pending
     if (_setupCompleter != null && !_setupCompleter!.isCompleted) {
       _setupCompleter!.completeError(
@@ -363,6 +592,9 @@ class MoQClient {
       trackNamespace: trackNamespace,
       trackName: trackName,
     );
+    subscription.priority = subscriberPriority;
+    subscription.groupOrder = groupOrder;
+    subscription.forward = forward;
 
     _subscriptions[requestId] = subscription;
 
@@ -816,6 +1048,7 @@ class MoQClient {
     );
     _outgoingStreamObjects.remove(streamId);
     _outgoingStreamHasExtensions[streamId] = false;
+    _outgoingStreamGroups[streamId] = (trackAlias: trackAlias, groupId: groupId);
     _logger.d('Wrote subgroup header to stream $streamId');
   }
 
@@ -833,7 +1066,7 @@ class MoQClient {
     final data = _serializeStreamObject(
       streamId,
       objectId: objectId,
-      payload: payload,
+      payload: _sealPayload(streamId, objectId, payload),
       status: status,
       extensionHeaders: const [],
     );
@@ -873,6 +1106,7 @@ class MoQClient {
     );
     _outgoingStreamObjects.remove(streamId);
     _outgoingStreamHasExtensions[streamId] = extensionHeaders.isNotEmpty;
+    _outgoingStreamGroups[streamId] = (trackAlias: trackAlias, groupId: groupId);
     _logger.d(
       'Wrote subgroup header with ${extensionHeaders.length} extension headers to stream $streamId',
     );
@@ -896,7 +1130,7 @@ class MoQClient {
     final data = _serializeStreamObject(
       streamId,
       objectId: objectId,
-      payload: payload,
+      payload: _sealPayload(streamId, objectId, payload),
       status: status,
       extensionHeaders: extensionHeaders,
     );
@@ -915,9 +1149,27 @@ class MoQClient {
     await _transport.streamFinish(streamId);
     _outgoingStreamObjects.remove(streamId);
     _outgoingStreamHasExtensions.remove(streamId);
+    _outgoingStreamGroups.remove(streamId);
     _logger.d('Finished data stream $streamId');
   }
 
+  // Encrypt an outgoing payload if its track is protected
+  Uint8List _sealPayload(int streamId, Int64 objectId, Uint8List payload) {
+    final encryption = objectEncryption;
+    final stream = _outgoingStreamGroups[streamId];
+    if (encryption == null || stream == null) return payload;
+    final sealed = encryption.seal(
+      stream.trackAlias,
+      stream.groupId,
+      objectId,
+      payload,
+    );
+    if (sealed == null) {
+      throw StateError('Failed to encrypt object $objectId on stream $streamId');
+    }
+    return sealed;
+  }
+
   Uint8List _serializeStreamObject(
     int streamId, {
     required Int64 objectId,
@@ -1111,8 +1363,15 @@ class MoQClient {
 
     // If we have a header and objects, deliver them
     if (parser.hasHeader) {
-      for (final obj in objects) {
-        _deliverObject(parser.header!, obj);
+      _objectBatch = [];
+      try {
+        for (final obj in objects) {
+          _deliverObject(parser.header!, obj);
+        }
+      } finally {
+        final batch = _objectBatch!;
+        _objectBatch = null;
+        _emitObjects(batch);
       }
     }
 
@@ -1225,7 +1484,7 @@ class MoQClient {
       extensionHeaders: datagram.extensionHeaders,
       payload: datagram.payload,
     );
-    targetSubscription._objectController.add(moqObject);
+    _emitObject(targetSubscription, moqObject);
     _logger.d(
       'Delivered ${isVideo
           ? "video"
@@ -1320,7 +1579,7 @@ class MoQClient {
       extensionHeaders: obj.extensionHeaders,
       payload: obj.payload,
     );
-    targetSubscription._objectController.add(moqObject);
+    _emitObject(targetSubscription, moqObject);
     _logger.d(
       'Delivered ${isVideo
           ? "video"
@@ -1330,6 +1589,76 @@ class MoQClient {
     );
   }
 
+  /// Hand an object to its subscription, batching while a chunk is parsed
+  void _emitObject(MoQSubscription subscription, MoQObject object) {
+    final batch = _objectBatch;
+    if (batch != null) {
+      batch.add((subscription, object));
+    } else {
+      _emitObjects([(subscription, object)]);
+    }
+  }
+
+  /// Decrypt objects of protected tracks in one batch, then deliver in order
+  void _emitObjects(List<(MoQSubscription, MoQObject)> objects) {
+    final encryption = objectEncryption;
+    final opened = <int, Uint8List?>{};
+    if (encryption != null) {
+      final indices = <int>[];
+      final payloads = <ObjectPayload>[];
+      for (var i = 0; i < objects.length; i++) {
+        final (subscription, object) = objects[i];
+        final payload = object.payload;
+        if (payload == null || payload.isEmpty) continue;
+        final keyId = encryption.expectedKeyId(
+          subscription.trackNamespace,
+          subscription.trackName,
+        );
+        if (keyId == null) continue;
+        indices.add(i);
+        payloads.add(
+          ObjectPayload(
+            groupId: object.groupId,
+            objectId: object.objectId,
+            payload: payload,
+            keyId: keyId,
+          ),
+        );
+      }
+      final results = encryption.open(payloads);
+      for (var i = 0; i < indices.length; i++) {
+        opened[indices[i]] = results[i];
+      }
+    }
+
+    for (var i = 0; i < objects.length; i++) {
+      var (subscription, object) = objects[i];
+      if (opened.containsKey(i)) {
+        final payload = opened[i];
+        if (payload == null) {
+          _logger.w(
+            'Dropped object ${object.groupId}/${object.objectId} that failed to decrypt',
+          );
+          continue;
+        }
+        object = MoQObject(
+          trackNamespace: object.trackNamespace,
+          trackName: object.trackName,
+          groupId: object.groupId,
+          subgroupId: object.subgroupId,
+          objectId: object.objectId,
+          publisherPriority: object.publisherPriority,
+          forwardingPreference: object.forwardingPreference,
+          status: object.status,
+          extensionHeaders: object.extensionHeaders,
+          payload: payload,
+        );
+      }
+      subscription._objectController.add(object);
+      _noteObjectDelivered(subscription);
+    }
+  }
+
   /// Compare two byte arrays for equality
   bool _bytesEqual(Uint8List a, Uint8List b) {
     if (a.length != b.length) return false;
@@ -2057,6 +2386,7 @@ class MoQClient {
     _incomingPublishController.close();
     _incomingSubscribeController.close();
     _goawayController.close();
+    _recoveryController.close();
     // Note: transport is NOT disposed here - it's owned by the provider
     // and managed by Riverpod's lifecycle (ref.onDispose in the transport provider)
   }
@@ -2064,6 +2394,8 @@ class MoQClient {
 
 /// Subscription result
 class SubscribeResult {
+  /// The subscription that was accepted
+  final MoQSubscription subscription;
   final Int64 trackAlias;
   final Int64 expires;
   final GroupOrder groupOrder;
@@ -2071,6 +2403,7 @@ class SubscribeResult {
   final Location? largestLocation;
 
   const SubscribeResult({
+    required this.subscription,
     required this.trackAlias,
     required this.expires,
     required this.groupOrder,
@@ -2082,22 +2415,25 @@ class SubscribeResult {
 /// Active subscription
 class MoQSubscription {
   final MoQClient client;
-  final Int64 id;
+  Int64 _id;
   final List<Uint8List> trackNamespace;
   final Uint8List trackName;
 
   /// Track alias assigned by server in SUBSCRIBE_OK
   Int64? assignedTrackAlias;
 
-  final Completer<SubscribeResult> _responseCompleter =
-      Completer<SubscribeResult>();
+  Completer<SubscribeResult> _responseCompleter = Completer<SubscribeResult>();
 
   // Current subscription state
   Location currentStart = Location.zero();
   Int64 currentEndGroup = Int64(0);
   int priority = 128;
+  GroupOrder groupOrder = GroupOrder.none;
   bool forward = true;
 
+  // Time the connection was lost, until the first object arrives after recovery
+  DateTime? _recoveringSince;
+
   /// Replay stream controller that buffers objects for late-joining listeners.
   /// Buffer size of 60 ensures we capture at least one GOP worth of video frames
   /// plus audio frames, preventing keyframe loss during player initialization.
@@ -2106,10 +2442,21 @@ class MoQSubscription {
 
   MoQSubscription({
     required this.client,
-    required this.id,
+    required Int64 id,
     required this.trackNamespace,
     required this.trackName,
-  });
+  }) : _id = id;
+
+  /// Request ID of this subscription (changes when a lost session is recovered)
+  Int64 get id => _id;
+
+  /// Move this subscription onto a recovered session
+  void _rebind(Int64 requestId, DateTime lostAt) {
+    _id = requestId;
+    assignedTrackAlias = null;
+    _recoveringSince = lostAt;
+    _responseCompleter = Completer<SubscribeResult>();
+  }
 
   /// Wait for SUBSCRIBE_OK response
   Future<SubscribeResult> waitForResponse() => _responseCompleter.future;
@@ -2126,6 +2473,7 @@ class MoQSubscription {
 
     _responseCompleter.complete(
       SubscribeResult(
+        subscription: this,
         trackAlias: trackAlias,
         expires: expires,
         groupOrder: groupOrder,
@@ -2439,6 +2787,93 @@ class GoawayEvent {
   bool get hasMigrationUri => newUri != null && newUri!.isNotEmpty;
 }
 
+/// Session recovery settings for [MoQClient]
+///
+/// When set, a lost connection is re-established in the background and every
+/// active subscription is re-subscribed on the new session.
+class SessionRecoveryOptions {
+  /// Reconnect attempts before giving up and closing subscriptions
+  final int maxAttempts;
+
+  /// Delay after the first failed attempt, doubled after each further failure
+  final Duration initialBackoff;
+
+  /// Upper bound for the delay between attempts
+  final Duration maxBackoff;
+
+  /// Filter for the replayed SUBSCRIBEs. [FilterType.nextGroupStart] resumes
+  /// on a group boundary so a warm decoder restarts on a keyframe.
+  final FilterType resubscribeFilter;
+
+  /// QUIC idle timeout
+  final Duration idleTimeout;
+
+  /// Keep-alive interval; must be below [idleTimeout]
+  final Duration keepAliveInterval;
+
+  /// PTOs without inbound packets before the path is declared lost
+  /// (0 waits for the idle timeout). Only the raw QUIC transport tracks
+  /// this; WebTransport sessions always wait for the idle timeout.
+  final int lossPtoCount;
+
+  const SessionRecoveryOptions({
+    this.maxAttempts = 10,
+    this.initialBackoff = const Duration(milliseconds: 100),
+    this.maxBackoff = const Duration(seconds: 5),
+    this.resubscribeFilter = FilterType.nextGroupStart,
+    this.idleTimeout = const Duration(seconds: 10),
+    this.keepAliveInterval = const Duration(milliseconds: 500),
+    this.lossPtoCount = 3,
+  });
+
+  /// Loss detection thresholds passed to the transport on connect
+  Map<String, String> get transportOptions => {
+    'idle_timeout_ms': '${idleTimeout.inMilliseconds}',
+    'keep_alive_ms': '${keepAliveInterval.inMilliseconds}',
+    'loss_pto_count': '$lossPtoCount',
+  };
+}
+
+/// Session recovery progress
+enum SessionRecoveryPhase {
+  /// Transport loss detected; subscriptions are kept open
+  connectionLost,
+
+  /// New session established; SUBSCRIBEs are being replayed
+  reconnected,
+
+  /// First object received on a restored subscription
+  trackResumed,
+
+  /// All attempts failed; subscriptions have been closed
+  failed,
+}
+
+/// Session recovery event
+class SessionRecoveryEvent {
+  final SessionRecoveryPhase phase;
+
+  /// Reconnect attempt that succeeded or failed last
+  final int attempt;
+
+  /// Time since the connection was lost
+  final Duration? outage;
+
+  /// Restored track (for [SessionRecoveryPhase.trackResumed])
+  final Uint8List? trackName;
+
+  /// Last reconnect error (for [SessionRecoveryPhase.failed])
+  final Object? error;
+
+  SessionRecoveryEvent({
+    required this.phase,
+    this.attempt = 0,
+    this.outage,
+    this.trackName,
+    this.error,
+  });
+}
+
 /// Subgroup header message for data streams
 ///
 /// Per draft-ietf-moq-transport-14, each subgroup stream starts with:
@@ -0,0 +1,171 @@
+import 'dart:typed_data';
+import 'package:fixnum/fixnum.dart';
+
+/// Payload of one object together with its location
+class ObjectPayload {
+  final Int64 groupId;
+  final Int64 objectId;
+  final Uint8List payload;
+
+  /// Key ID the object's track expects, when opening
+  final int keyId;
+
+  const ObjectPayload({
+    required this.groupId,
+    required this.objectId,
+    required this.payload,
+    this.keyId = 0,
+  });
+}
+
+/// Full track name a key ID is bound to
+///
+/// Every namespace element and the track name, each prefixed with its
+/// 32-bit big-endian length.
+Uint8List encodeFullTrackName(
+  List<Uint8List> trackNamespace,
+  Uint8List trackName,
+) {
+  final builder = BytesBuilder(copy: false);
+  for (final element in [...trackNamespace, trackName]) {
+    builder.add(
+      (ByteData(4)..setUint32(0, element.length)).buffer.asUint8List(),
+    );
+    builder.add(element);
+  }
+  return builder.toBytes();
+}
+
+/// AEAD backend for end-to-end object encryption
+///
+/// Implementations bind each key ID to one full track name and each
+/// ciphertext to the object's group and object IDs, so objects cannot be
+/// moved or replayed elsewhere in the track or onto another track.
+abstract class ObjectCipher {
+  /// Encrypt payloads with [keyId]; null entries failed
+  List<Uint8List?> sealBatch(int keyId, List<ObjectPayload> objects);
+
+  /// Decrypt payloads with their [ObjectPayload.keyId]; null entries failed
+  /// authentication or were sealed with another key
+  List<Uint8List?> openBatch(List<ObjectPayload> objects);
+}
+
+/// End-to-end encryption of object payloads, per track
+///
+/// Payloads of protected tracks are sealed as they are packetized and opened
+/// as they are parsed, so relays only forward ciphertext. Extension headers
+/// stay in the clear for routing.
+///
+/// Nonces come from the group and object IDs, which start over when a
+/// publisher restarts: install a fresh base key (or use new key IDs) for
+/// every publishing session.
+class MoQObjectEncryption {
+  final ObjectCipher cipher;
+
+  // Outgoing track alias -> key ID
+  final _outgoing = <Int64, int>{};
+
+  // Full names ("namespace/.../track") of subscribed tracks that must
+  // decrypt -> expected key ID
+  final _incoming = <String, int>{};
+
+  int _sealed = 0;
+  int _opened = 0;
+  int _failures = 0;
+
+  MoQObjectEncryption({required this.cipher});
+
+  /// Encrypt everything published on [trackAlias] with [keyId]
+  ///
+  /// Throws [ArgumentError] if [keyId] already protects another track.
+  void protectOutgoing(Int64 trackAlias, int keyId) {
+    for (final entry in _outgoing.entries) {
+      if (entry.value == keyId && entry.key != trackAlias) {
+        throw ArgumentError.value(
+          keyId,
+          'keyId',
+          'Already protects track alias ${entry.key}',
+        );
+      }
+    }
+    _outgoing[trackAlias] = keyId;
+  }
+
+  void unprotectOutgoing(Int64 trackAlias) => _outgoing.remove(trackAlias);
+
+  /// Key ID used for [trackAlias], or null if it is sent in the clear
+  int? keyIdFor(Int64 trackAlias) => _outgoing[trackAlias];
+
+  /// Require objects of a subscribed track to be encrypted with [keyId]
+  ///
+  /// Objects that fail to decrypt are dropped, as are unencrypted ones and
+  /// ones sealed with another key ID.
+  void expectProtected(
+    List<Uint8List> trackNamespace,
+    Uint8List trackName,
+    int keyId,
+  ) {
+    _incoming[_fullName(trackNamespace, trackName)] = keyId;
+  }
+
+  void stopExpectingProtected(
+    List<Uint8List> trackNamespace,
+    Uint8List trackName,
+  ) {
+    _incoming.remove(_fullName(trackNamespace, trackName));
+  }
+
+  bool isProtected(List<Uint8List> trackNamespace, Uint8List trackName) =>
+      expectedKeyId(trackNamespace, trackName) != null;
+
+  /// Key ID a subscribed track must be sealed with, or null if it is clear
+  int? expectedKeyId(List<Uint8List> trackNamespace, Uint8List trackName) =>
+      _incoming.isEmpty
+          ? null
+          : _incoming[_fullName(trackNamespace, trackName)];
+
+  /// Objects sealed, opened, and dropped because they failed to open
+  int get sealedCount => _sealed;
+  int get openedCount => _opened;
+  int get failureCount => _failures;
+
+  /// Seal one outgoing payload; returns it unchanged for clear tracks
+  Uint8List? seal(
+    Int64 trackAlias,
+    Int64 groupId,
+    Int64 objectId,
+    Uint8List payload,
+  ) {
+    final keyId = _outgoing[trackAlias];
+    if (keyId == null || payload.isEmpty) return payload;
+    final sealed = cipher.sealBatch(keyId, [
+      ObjectPayload(groupId: groupId, objectId: objectId, payload: payload),
+    ]).single;
+    if (sealed == null) {
+      _failures++;
+    } else {
+      _sealed++;
+    }
+    return sealed;
+  }
+
+  /// Open received payloads in one batch; null entries are to be dropped
+  List<Uint8List?> open(List<ObjectPayload> objects) {
+    if (objects.isEmpty) return const [];
+    final opened = cipher.openBatch(objects);
+    for (final payload in opened) {
+      if (payload == null) {
+        _failures++;
+      } else {
+        _opened++;
+      }
+    }
+    return opened;
+  }
+
+  static String _fullName(List<Uint8List> trackNamespace, Uint8List trackName) =>
+      [
+        ...trackNamespace.map(String.fromCharCodes),
+        String.fromCharCodes(trackName),
+      ].join('/');
+}
@@ -0,0 +1,440 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:logger/logger.dart';
+
+import '../protocol/moq_messages.dart';
+import 'moq_client.dart';
+import 'replay_stream.dart';
+
+/// A channel that can be tuned: the tracks of one broadcast
+class ZapChannel {
+  final String id;
+  final List<Uint8List> trackNamespace;
+
+  /// Tracks to subscribe; the first one (video) defines decodable group starts
+  final List<Uint8List> trackNames;
+
+  ZapChannel({
+    required this.id,
+    required this.trackNamespace,
+    required this.trackNames,
+  }) {
+    if (trackNames.isEmpty) {
+      throw ArgumentError('A channel needs at least one track');
+    }
+  }
+
+  /// Channel for a single-element namespace with the given track names
+  factory ZapChannel.named(String namespace, List<String> trackNames) {
+    return ZapChannel(
+      id: namespace,
+      trackNamespace: [Uint8List.fromList(namespace.codeUnits)],
+      trackNames: trackNames
+          .map((name) => Uint8List.fromList(name.codeUnits))
+          .toList(),
+    );
+  }
+}
+
+/// Tuning for [MoQZappingController]
+class ZappingOptions {
+  /// How many likely-next channels to keep warm
+  final int standbyCount;
+
+  /// Subscriber priority of the channel being watched (lower is more important)
+  final int activePriority;
+
+  /// Subscriber priority of warm standby channels, so the relay only spends
+  /// spare capacity on them
+  final int standbyPriority;
+
+  const ZappingOptions({
+    this.standbyCount = 2,
+    this.activePriority = 32,
+    this.standbyPriority = 224,
+  });
+}
+
+/// A completed channel change
+class ZapSwitchEvent {
+  final String channelId;
+
+  /// The channel was warm, so no SUBSCRIBE was needed
+  final bool warm;
+
+  /// Time from [MoQZappingController.tune] until a group start of the new
+  /// channel was available to its decoder
+  final Duration latency;
+
+  const ZapSwitchEvent({
+    required this.channelId,
+    required this.warm,
+    required this.latency,
+  });
+
+  @override
+  String toString() =>
+      'ZapSwitchEvent($channelId, warm: $warm, '
+      'latency: ${latency.inMicroseconds / 1000}ms)';
+}
+
+/// Zapping statistics
+class ZappingMetrics {
+  final int warmSwitches;
+  final int coldSwitches;
+  final ZapSwitchEvent? lastSwitch;
+
+  /// Payload bytes received on channels while they were on standby
+  final int standbyBytes;
+
+  /// Average standby receive rate across all standby channels
+  final int standbyBitrate;
+
+  /// Objects dropped on standby because a newer group had already started
+  final int staleObjectsDropped;
+
+  const ZappingMetrics({
+    required this.warmSwitches,
+    required this.coldSwitches,
+    this.lastSwitch,
+    required this.standbyBytes,
+    required this.standbyBitrate,
+    required this.staleObjectsDropped,
+  });
+}
+
+/// The subscriptions of one tuned or warm channel
+///
+/// [objectStream] replays its buffer to late listeners, so a decoder attached
+/// to a standby channel is primed with the latest group. The buffer holds the
+/// latest group of each track, however many objects it has.
+class ZapChannelHandle {
+  final ZapChannel channel;
+  final List<MoQSubscription> subscriptions;
+  final ReplayStreamController<MoQObject> _objectController;
+  final List<StreamSubscription<MoQObject>> _listeners = [];
+
+  bool _active;
+  final Stopwatch _standbyClock = Stopwatch();
+  int _standbyBytes = 0;
+  int _staleDropped = 0;
+
+  // Latest group seen per track, and whether the primary track's latest group
+  // was received from its start
+  final Map<String, Int64> _latestGroup = {};
+  bool _hasGroupStart = false;
+  Completer<void> _groupStart = Completer<void>();
+
+  ZapChannelHandle._(
+    this.channel,
+    this.subscriptions, {
+    required bool active,
+  }) : _active = active,
+       // Bounded by group in _onObject, not by object count
+       _objectController = ReplayStreamController<MoQObject>(bufferSize: null) {
+    if (!active) _standbyClock.start();
+    for (final subscription in subscriptions) {
+      _listeners.add(subscription.objectStream.listen(_onObject));
+    }
+  }
+
+  /// Objects of this channel; only the latest group of each track is replayed
+  Stream<MoQObject> get objectStream => _objectController.stream;
+
+  bool get isActive => _active;
+
+  /// The primary track's current group was received from its first object
+  bool get hasGroupStart => _hasGroupStart;
+
+  int get standbyBytes => _standbyBytes;
+  Duration get standbyTime => _standbyClock.elapsed;
+
+  void _onObject(MoQObject object) {
+    final track = String.fromCharCodes(object.trackName);
+    final latest = _latestGroup[track];
+
+    if (!_active && latest != null && object.groupId < latest) {
+      // A newer group already started; the decoder will never need this one
+      _staleDropped++;
+      return;
+    }
+
+    if (latest == null || object.groupId > latest) {
+      _latestGroup[track] = object.groupId;
+      if (latest != null) {
+        // Replay only this track's new group to a decoder attached later
+        _objectController.removeBufferedWhere(
+          (o) =>
+              o.groupId < object.groupId &&
+              String.fromCharCodes(o.trackName) == track,
+        );
+      }
+      if (_isPrimary(object)) {
+        _hasGroupStart = object.objectId == Int64.ZERO;
+        if (_hasGroupStart && !_groupStart.isCompleted) {
+          _groupStart.complete();
+        }
+      }
+    }
+
+    if (!_active) {
+      _standbyBytes += object.payload?.length ?? 0;
+    }
+    _objectController.add(object);
+  }
+
+  bool _isPrimary(MoQObject object) {
+    final primary = channel.trackNames.first;
+    if (object.trackName.length != primary.length) return false;
+    for (var i = 0; i < primary.length; i++) {
+      if (object.trackName[i] != primary[i]) return false;
+    }
+    return true;
+  }
+
+  /// Completes once a group of the primary track is available from its start
+  Future<void> get _decodable {
+    if (_hasGroupStart) return Future.value();
+    if (_groupStart.isCompleted) _groupStart = Completer<void>();
+    return _groupStart.future;
+  }
+
+  void _setActive(bool active) {
+    if (_active == active) return;
+    _active = active;
+    if (active) {
+      _standbyClock.stop();
+    } else {
+      _standbyClock.start();
+    }
+  }
+
+  Future<void> _close() async {
+    _standbyClock.stop();
+    for (final listener in _listeners) {
+      await listener.cancel();
+    }
+    _listeners.clear();
+    await _objectController.close();
+  }
+}
+
+/// Warm-standby subscriptions for instant channel switching
+///
+/// The watched channel is subscribed at high priority. The channels the viewer
+/// is most likely to switch to next are kept subscribed at low priority with
+/// newest-first group order, and only their latest group is kept, so a decoder
+/// attached to them stays primed on a recent keyframe. Tuning to a warm channel
+/// is a SUBSCRIBE_UPDATE priority flip rather than a new SUBSCRIBE and keyframe
+/// wait; the previously watched channel drops to standby.
+class MoQZappingController {
+  final MoQClient _client;
+  final ZappingOptions options;
+  final Logger _logger;
+
+  final Map<String, ZapChannelHandle> _handles = {};
+  ZapChannelHandle? _active;
+
+  final _switchController = StreamController<ZapSwitchEvent>.broadcast();
+  int _warmSwitches = 0;
+  int _coldSwitches = 0;
+  ZapSwitchEvent? _lastSwitch;
+
+  // Totals of channels that have already been released
+  int _releasedStandbyBytes = 0;
+  Duration _releasedStandbyTime = Duration.zero;
+  int _releasedStaleDropped = 0;
+
+  MoQZappingController({
+    required MoQClient client,
+    this.options = const ZappingOptions(),
+    Logger? logger,
+  }) : _client = client,
+       _logger = logger ?? Logger();
+
+  /// Completed channel changes
+  Stream<ZapSwitchEvent> get switches => _switchController.stream;
+
+  /// Channel being watched
+  ZapChannelHandle? get active => _active;
+
+  /// Channels kept warm, not including the active one
+  List<ZapChannelHandle> get standby =>
+      _handles.values.where((handle) => !handle.isActive).toList();
+
+  ZapChannelHandle? handleFor(String channelId) => _handles[channelId];
+
+  ZappingMetrics get metrics {
+    var standbyBytes = _releasedStandbyBytes;
+    var standbyTime = _releasedStandbyTime;
+    var staleDropped = _releasedStaleDropped;
+    for (final handle in _handles.values) {
+      standbyBytes += handle.standbyBytes;
+      standbyTime += handle.standbyTime;
+      staleDropped += handle._staleDropped;
+    }
+    final seconds = standbyTime.inMicroseconds / 1e6;
+    return ZappingMetrics(
+      warmSwitches: _warmSwitches,
+      coldSwitches: _coldSwitches,
+      lastSwitch: _lastSwitch,
+      standbyBytes: standbyBytes,
+      standbyBitrate: seconds > 0 ? (standbyBytes * 8 / seconds).round() : 0,
+      staleObjectsDropped: staleDropped,
+    );
+  }
+
+  /// Switch to [channel]
+  ///
+  /// Completes when a group start of the channel is available to its decoder.
+  Future<ZapChannelHandle> tune(ZapChannel channel) async {
+    final clock = Stopwatch()..start();
+    final previous = _active;
+    if (previous?.channel.id == channel.id) return previous!;
+
+    var handle = _handles[channel.id];
+    final warm = handle != null;
+    if (handle != null) {
+      // Priority flip: the relay now favours this channel's objects
+      handle._setActive(true);
+      for (final subscription in handle.subscriptions) {
+        await _client.updateSubscription(
+          subscription.id,
+          subscriberPriority: options.activePriority,
+        );
+      }
+    } else {
+      handle = await _open(channel, active: true);
+    }
+    _active = handle;
+
+    if (previous != null) {
+      previous._setActive(false);
+      for (final subscription in previous.subscriptions) {
+        await _client.updateSubscription(
+          subscription.id,
+          subscriberPriority: options.standbyPriority,
+        );
+      }
+    }
+
+    await handle._decodable;
+    clock.stop();
+
+    final event = ZapSwitchEvent(
+      channelId: channel.id,
+      warm: warm,
+      latency: clock.elapsed,
+    );
+    if (warm) {
+      _warmSwitches++;
+    } else {
+      _coldSwitches++;
+    }
+    _lastSwitch = event;
+    _switchController.add(event);
+    _logger.i('Tuned to ${channel.id}: $event');
+
+    await _releaseExcessStandby();
+    return handle;
+  }
+
+  /// Keep the most likely next channels warm, in order of likelihood
+  ///
+  /// Up to [ZappingOptions.standbyCount] channels are subscribed at standby
+  /// priority. Warm channels that are no longer listed are released.
+  Future<void> setStandby(List<ZapChannel> likelyNext) async {
+    final wanted = likelyNext
+        .where((channel) => channel.id != _active?.channel.id)
+        .take(options.standbyCount)
+        .toList();
+
+    final wantedIds = wanted.map((channel) => channel.id).toSet();
+    for (final handle in standby) {
+      if (!wantedIds.contains(handle.channel.id)) {
+        await _release(handle);
+      }
+    }
+
+    for (final channel in wanted) {
+      if (_handles.containsKey(channel.id)) continue;
+      try {
+        await _open(channel, active: false);
+      } catch (e) {
+        _logger.w('Could not warm ${channel.id}: $e');
+      }
+    }
+  }
+
+  Future<void> close() async {
+    for (final handle in _handles.values.toList()) {
+      await _release(handle);
+    }
+    _active = null;
+    await _switchController.close();
+  }
+
+  Future<ZapChannelHandle> _open(
+    ZapChannel channel, {
+    required bool active,
+  }) async {
+    final subscriptions = <MoQSubscription>[];
+    try {
+      for (final trackName in channel.trackNames) {
+        final result = await _client.subscribe(
+          channel.trackNamespace,
+          trackName,
+          filterType: FilterType.largestObject,
+          subscriberPriority: active
+              ? options.activePriority
+              : options.standbyPriority,
+          groupOrder: GroupOrder.descending,
+        );
+        subscriptions.add(result.subscription);
+      }
+    } catch (_) {
+      for (final subscription in subscriptions) {
+        await _unsubscribe(subscription);
+      }
+      rethrow;
+    }
+
+    final handle = ZapChannelHandle._(
+      channel,
+      subscriptions,
+      active: active,
+    );
+    _handles[channel.id] = handle;
+    return handle;
+  }
+
+  // Release the oldest standby channels beyond the configured count
+  Future<void> _releaseExcessStandby() async {
+    final standby = this.standby;
+    for (var i = 0; i < standby.length - options.standbyCount; i++) {
+      await _release(standby[i]);
+    }
+  }
+
+  Future<void> _release(ZapChannelHandle handle) async {
+    _handles.remove(handle.channel.id);
+    _releasedStandbyBytes += handle.standbyBytes;
+    _releasedStandbyTime += handle.standbyTime;
+    _releasedStaleDropped += handle._staleDropped;
+    await handle._close();
+    for (final subscription in handle.subscriptions) {
+      await _unsubscribe(subscription);
+    }
+  }
+
+  Future<void> _unsubscribe(MoQSubscription subscription) async {
+    if (!_client.isConnected) return;
+    try {
+      await _client.unsubscribe(subscription.id);
+    } catch (e) {
+      _logger.w('Failed to unsubscribe: $e');
+    }
+  }
+}
@@ -1,6 +1,8 @@
 import 'dart:async';
 import 'dart:collection';
-import 'package:flutter/foundation.dart';
+import 'package:logger/logger.dart';
+
+final Logger _logger = Logger();
 
 /// A stream controller that replays buffered events to new listeners.
 ///
@@ -11,7 +13,7 @@ import 'package:flutter/foundation.dart';
 /// Useful for live streaming scenarios where the first keyframe must
 /// not be missed even if the player initializes slightly late.
 class ReplayStreamController<T> {
-  final int _bufferSize;
+  final int? _bufferSize;
   final Queue<T> _buffer = Queue<T>();
   final StreamController<T> _controller;
   final List<_ReplaySubscription<T>> _subscriptions = [];
@@ -21,8 +23,10 @@ class ReplayStreamController<T> {
   ///
   /// [bufferSize] controls how many events to keep in the replay buffer.
   /// For video streams, this should be large enough to capture at least
-  /// one GOP (group of pictures) worth of data.
-  ReplayStreamController({int bufferSize = 60})
+  /// one GOP (group of pictures) worth of data. A null [bufferSize] keeps
+  /// every event until [removeBufferedWhere] drops it, for owners that bound
+  /// the buffer by group rather than by count.
+  ReplayStreamController({int? bufferSize = 60})
       : _bufferSize = bufferSize,
         _controller = StreamController<T>.broadcast(sync: true);
 
@@ -35,8 +39,11 @@ class ReplayStreamController<T> {
 
     // Add to replay buffer
     _buffer.addLast(event);
-    while (_buffer.length > _bufferSize) {
-      _buffer.removeFirst();
+    final bufferSize = _bufferSize;
+    if (bufferSize != null) {
+      while (_buffer.length > bufferSize) {
+        _buffer.removeFirst();
+      }
     }
 
     // Deliver to current listeners
@@ -51,6 +58,11 @@ class ReplayStreamController<T> {
     return _ReplayStream<T>(this);
   }
 
+  /// Drop buffered events that new listeners no longer need
+  void removeBufferedWhere(bool Function(T event) test) {
+    _buffer.removeWhere(test);
+  }
+
   /// Get the number of buffered events
   int get bufferedCount => _buffer.length;
 
@@ -133,7 +145,7 @@ class _ReplaySubscription<T> implements StreamSubscription<T> {
     // First, replay all buffered events
     final buffered = _parent._buffer.toList();
     if (buffered.isNotEmpty) {
-      debugPrint('ReplayStream: Replaying ${buffered.length} buffered events to new listener');
+      _logger.d('ReplayStream: Replaying ${buffered.length} buffered events to new listener');
     }
     for (final event in buffered) {
       if (_isCanceled) return;
@@ -144,7 +156,7 @@ class _ReplaySubscription<T> implements StreamSubscription<T> {
       }
     }
     if (buffered.isNotEmpty) {
-      debugPrint('ReplayStream: Finished replaying ${buffered.length} events, switching to live');
+      _logger.d('ReplayStream: Finished replaying ${buffered.length} events, switching to live');
     }
 
     // Then subscribe to live events
@@ -21,12 +21,28 @@ class OpusEncoderConfig {
   /// Application type: 'voip', 'audio', or 'lowdelay'
   final String application;
 
+  /// Suppress silent frames (voice-activity gate plus Opus DTX)
+  ///
+  /// Only frames with voice, the hangover after it and sparse comfort-noise
+  /// updates are emitted, so timestamps have gaps. Leave off for packaging
+  /// that needs a continuous timeline (CMAF).
+  final bool dtx;
+
+  /// How long frames keep flowing after speech stops
+  final int vadHangoverMs;
+
+  /// Spacing of comfort-noise frames emitted during silence
+  final int comfortNoiseIntervalMs;
+
   const OpusEncoderConfig({
     this.sampleRate = 48000,
     this.channels = 2,
     this.bitrate = 128000,
     this.frameDurationMs = 20,
     this.application = 'audio',
+    this.dtx = false,
+    this.vadHangoverMs = 300,
+    this.comfortNoiseIntervalMs = 400,
   });
 
   /// Samples per frame based on duration and sample rate
@@ -50,11 +66,23 @@ class OpusFrame {
   /// Sequence number
   final int sequenceNumber;
 
+  /// RFC 6464 audio level in -dBov (0 = loudest, 127 = silence), if measured
+  final int? audioLevel;
+
+  /// Whether the frame contains speech (only meaningful with [audioLevel])
+  final bool voiceActivity;
+
+  /// Comfort-noise update sent during silence
+  final bool isComfortNoise;
+
   OpusFrame({
     required this.data,
     required this.timestampMs,
     required this.durationMs,
     required this.sequenceNumber,
+    this.audioLevel,
+    this.voiceActivity = false,
+    this.isComfortNoise = false,
   });
 }
 
@@ -4,6 +4,7 @@ import 'dart:typed_data';
 import 'package:flutter/foundation.dart';
 import 'package:camera/camera.dart';
 import 'package:logger/logger.dart';
+import '../../services/native_mjpeg_decoder.dart';
 import 'audio_capture.dart';
 import 'linux_capture.dart';
 import 'native_capture_channel.dart';
@@ -31,12 +32,17 @@ class VideoFrame {
 /// Camera capture configuration
 class CaptureConfig {
   final ResolutionPreset resolution;
+
+  /// Target capture rate; cameras are switched to a compressed mode when
+  /// that is the only way to reach it
+  final int frameRate;
   final bool enableAudio;
   final int audioSampleRate;
   final int audioChannels;
 
   const CaptureConfig({
     this.resolution = ResolutionPreset.high,
+    this.frameRate = 30,
     this.enableAudio = true,
     this.audioSampleRate = 48000,
     this.audioChannels = 2,
@@ -287,6 +293,11 @@ class NativeVideoCapture implements VideoCapture {
   StreamSubscription<NativeVideoFrame>? _videoSubscription;
   bool _nativeAvailable = true;
 
+  // Decodes 'mjpeg' frames, sent when the camera only reaches the rate in
+  // its compressed mode
+  NativeMjpegDecoder? _mjpegDecoder;
+  Timer? _mjpegPollTimer;
+
   // Audio capture (using native channel as well)
   final _audioController = StreamController<AudioSamples>.broadcast();
   StreamSubscription<NativeAudioSamples>? _audioSubscription;
@@ -347,7 +358,7 @@ class NativeVideoCapture implements VideoCapture {
       await _nativeChannel!.initializeVideo(
         width: width,
         height: height,
-        frameRate: 30,
+        frameRate: config.frameRate,
         cameraId: cameraId,
       );
 
@@ -442,6 +453,11 @@ class NativeVideoCapture implements VideoCapture {
       return;
     }
 
+    if (nativeFrame.format == 'mjpeg') {
+      _onMjpegFrame(nativeFrame);
+      return;
+    }
+
     final frame = VideoFrame(
       data: nativeFrame.data,
       width: nativeFrame.width,
@@ -453,6 +469,32 @@ class NativeVideoCapture implements VideoCapture {
     _videoFrameController.add(frame);
   }
 
+  void _onMjpegFrame(NativeVideoFrame nativeFrame) {
+    if (_mjpegDecoder == null) {
+      _mjpegDecoder = NativeMjpegDecoder.create();
+      if (_mjpegDecoder == null) {
+        _logger.e('Camera delivers MJPEG but the native decoder is unavailable');
+        return;
+      }
+      _mjpegPollTimer = Timer.periodic(const Duration(milliseconds: 5), (_) {
+        final decoder = _mjpegDecoder;
+        if (decoder == null || !_isCapturing) return;
+        for (var f = decoder.pull(); f != null; f = decoder.pull()) {
+          _videoFrameController.add(
+            VideoFrame(
+              data: f.data,
+              width: f.width,
+              height: f.height,
+              timestampMs: f.timestampMs,
+              format: 'yuv420p',
+            ),
+          );
+        }
+      });
+    }
+    _mjpegDecoder!.push(nativeFrame.data, nativeFrame.timestampMs);
+  }
+
   void _onAudioSamples(NativeAudioSamples nativeSamples) {
     if (!_isCapturing) return;
 
@@ -479,6 +521,11 @@ class NativeVideoCapture implements VideoCapture {
     await _audioSubscription?.cancel();
     _audioSubscription = null;
 
+    _mjpegPollTimer?.cancel();
+    _mjpegPollTimer = null;
+    _mjpegDecoder?.dispose();
+    _mjpegDecoder = null;
+
     if (_nativeChannel != null) {
       try {
         await _nativeChannel!.stopVideoCapture();
@@ -0,0 +1,107 @@
+/// One capture mode a camera offers (pixel format, size and frame rate)
+class CameraMode {
+  /// FourCC of the pixel format, e.g. 'MJPG', 'YUYV', 'NV12'
+  final String fourcc;
+  final int width;
+  final int height;
+  final double frameRate;
+  final bool compressed;
+
+  const CameraMode({
+    required this.fourcc,
+    required this.width,
+    required this.height,
+    required this.frameRate,
+    required this.compressed,
+  });
+
+  /// Build from a little-endian FourCC code as used by V4L2
+  factory CameraMode.fromFourccCode({
+    required int code,
+    required int width,
+    required int height,
+    required double frameRate,
+    required bool compressed,
+  }) {
+    final fourcc = String.fromCharCodes([
+      code & 0xFF,
+      (code >> 8) & 0xFF,
+      (code >> 16) & 0xFF,
+      (code >> 24) & 0xFF,
+    ]).trim();
+    return CameraMode(
+      fourcc: fourcc,
+      width: width,
+      height: height,
+      frameRate: frameRate,
+      compressed: compressed,
+    );
+  }
+
+  bool get isMjpeg => fourcc == 'MJPG' || fourcc == 'JPEG';
+
+  /// ffmpeg `-input_format` name for V4L2, or null if unsupported
+  String? get ffmpegInputFormat => switch (fourcc) {
+    'MJPG' || 'JPEG' => 'mjpeg',
+    'YUYV' => 'yuyv422',
+    'NV12' => 'nv12',
+    'YU12' => 'yuv420p',
+    _ => null,
+  };
+
+  @override
+  String toString() =>
+      '$fourcc ${width}x$height@${frameRate.toStringAsFixed(frameRate % 1 == 0 ? 0 : 2)}';
+}
+
+/// Picks the capture mode for a requested size and frame rate
+///
+/// Raw formats win when they reach the rate, since they need no decode.
+/// MJPEG is chosen when it is the only way to the rate, which is the case for
+/// most USB 2.0 cameras above 480p.
+class CameraModeSelector {
+  // Rates within this margin count as reaching the target (29.97 vs 30)
+  static const double _rateTolerance = 0.5;
+
+  static CameraMode? select(
+    List<CameraMode> modes, {
+    required int width,
+    required int height,
+    required double frameRate,
+  }) {
+    final usable = modes.where((m) => m.ffmpegInputFormat != null).toList();
+    if (usable.isEmpty) return null;
+
+    // Exact size, else the smallest size covering the request, else the
+    // largest size offered
+    final bySize = [...usable]
+      ..sort((a, b) => (a.width * a.height).compareTo(b.width * b.height));
+    final candidate = bySize.firstWhere(
+      (m) => m.width >= width && m.height >= height,
+      orElse: () => bySize.last,
+    );
+    final size = usable.any((m) => m.width == width && m.height == height)
+        ? (width, height)
+        : (candidate.width, candidate.height);
+    final atSize = usable
+        .where((m) => m.width == size.$1 && m.height == size.$2)
+        .toList();
+
+    bool reaches(CameraMode m) => m.frameRate >= frameRate - _rateTolerance;
+    CameraMode fastest(Iterable<CameraMode> candidates) => candidates.reduce(
+      (a, b) => b.frameRate > a.frameRate ? b : a,
+    );
+
+    final raw = atSize.where((m) => !m.compressed && reaches(m));
+    if (raw.isNotEmpty) return fastest(raw);
+    final mjpeg = atSize.where((m) => m.isMjpeg && reaches(m));
+    if (mjpeg.isNotEmpty) return fastest(mjpeg);
+
+    // Nothing reaches the rate: take the fastest, raw on a tie
+    final best = fastest(atSize);
+    final rawBest = atSize.where(
+      (m) => !m.compressed && m.frameRate == best.frameRate,
+    );
+    return rawBest.isNotEmpty ? rawBest.first : best;
+  }
+}
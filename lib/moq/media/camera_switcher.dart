@@ -0,0 +1,230 @@
+import 'dart:async';
+import 'camera_capture.dart' show VideoFrame;
+
+/// A running camera as seen by [CameraSwitcher]
+abstract class CameraFeed {
+  /// Frames in capture order; timestamps may be on any clock
+  Stream<VideoFrame> get frames;
+
+  Future<void> stop();
+}
+
+/// Opens and starts the feed for a device
+typedef CameraFeedOpener = Future<CameraFeed> Function(String device);
+
+/// Switches cameras make-before-break
+///
+/// The new camera is opened while the current one keeps delivering frames.
+/// Once the new camera has produced [warmupFrames] frames (the first ones
+/// are often dark while exposure settles), output cuts over to it between
+/// two frames and the old camera is stopped. Timestamps continue one frame
+/// interval after the last one sent, so the encoder timeline has no jump or
+/// gap whatever clock the new feed uses.
+class CameraSwitcher {
+  final CameraFeedOpener _open;
+
+  /// Frames of the new camera dropped before cutting over
+  final int warmupFrames;
+
+  /// Give up on a camera that delivers nothing for this long; the current
+  /// camera stays on
+  final Duration switchTimeout;
+
+  /// Spacing used to continue timestamps across a switch
+  final int frameRate;
+
+  final _frames = StreamController<VideoFrame>.broadcast();
+  _FeedState? _active;
+  _FeedState? _incoming;
+  Completer<void>? _switchDone;
+
+  // Output clock: last timestamp sent and when it was sent
+  int _lastTimestampMs = -1;
+  final Stopwatch _clock = Stopwatch()..start();
+  int _lastSentUs = 0;
+  Duration? _lastSwitchGap;
+
+  CameraSwitcher(
+    this._open, {
+    this.warmupFrames = 2,
+    this.switchTimeout = const Duration(seconds: 3),
+    this.frameRate = 30,
+  });
+
+  /// Frames of whichever camera is current
+  Stream<VideoFrame> get frames => _frames.stream;
+
+  /// Device currently delivering frames
+  String? get device => _active?.device;
+
+  /// Feed currently delivering frames
+  CameraFeed? get feed => _active?.feed;
+
+  /// Whether a switch is in progress
+  bool get isSwitching => _switchDone != null;
+
+  /// Time between the last frame of the old camera and the first frame of
+  /// the new one in the most recent switch
+  Duration? get lastSwitchGap => _lastSwitchGap;
+
+  /// Start capturing from [device]
+  Future<void> start(String device) async {
+    if (_active != null) {
+      throw StateError('Camera already started');
+    }
+    final feed = await _open(device);
+    final state = _FeedState(device, feed);
+    _lastTimestampMs = -1;
+    _active = state;
+    state.subscription = feed.frames.listen((frame) => _onFrame(state, frame));
+  }
+
+  /// Switch to [device] without stopping the current camera first
+  ///
+  /// Completes once output has cut over. Throws if the new camera cannot be
+  /// opened or delivers no frames within [switchTimeout]; the current
+  /// camera keeps running in that case.
+  Future<void> switchTo(String device) async {
+    if (_active == null) {
+      throw StateError('Camera not started');
+    }
+    // Set before the new camera is opened, so a second call made while it
+    // opens is refused too
+    if (_switchDone != null) {
+      throw StateError('Camera switch already in progress');
+    }
+    if (device == _active!.device) return;
+
+    final done = Completer<void>();
+    _switchDone = done;
+    final CameraFeed feed;
+    try {
+      feed = await _open(device);
+    } catch (_) {
+      _switchDone = null;
+      rethrow;
+    }
+    if (_active == null) {
+      // Stopped while the camera was opening
+      _switchDone = null;
+      await feed.stop();
+      throw StateError('Camera stopped during switch');
+    }
+
+    final incoming = _FeedState(device, feed);
+    _incoming = incoming;
+    incoming.subscription = feed.frames.listen(
+      (frame) => _onFrame(incoming, frame),
+      onError: (Object e) => _abandonSwitch(incoming, e),
+      onDone: () => _abandonSwitch(
+        incoming,
+        StateError('Camera $device stopped before delivering frames'),
+      ),
+    );
+
+    try {
+      await done.future.timeout(switchTimeout);
+    } on TimeoutException {
+      _abandonSwitch(
+        incoming,
+        TimeoutException('No frames from $device', switchTimeout),
+      );
+      await done.future;
+    }
+  }
+
+  void _onFrame(_FeedState feed, VideoFrame frame) {
+    if (identical(feed, _incoming)) {
+      if (++feed.seen <= warmupFrames) return;
+      _cutOver(feed, frame);
+      return;
+    }
+    // Frames of a camera being replaced that were already in flight
+    if (!identical(feed, _active)) return;
+    _emit(feed, frame);
+  }
+
+  void _cutOver(_FeedState incoming, VideoFrame frame) {
+    final old = _active;
+    _active = incoming;
+    _incoming = null;
+
+    // Continue one frame after the last timestamp sent
+    final intervalMs = 1000 ~/ (frameRate < 1 ? 1 : frameRate);
+    incoming.offsetMs = _lastTimestampMs < 0
+        ? 0
+        : _lastTimestampMs + intervalMs - frame.timestampMs;
+    final hadOutput = _lastTimestampMs >= 0;
+    final previousSentUs = _lastSentUs;
+    _emit(incoming, frame);
+    if (hadOutput) {
+      _lastSwitchGap = Duration(microseconds: _lastSentUs - previousSentUs);
+    }
+
+    if (old != null) {
+      old.subscription?.cancel();
+      unawaited(old.feed.stop().catchError((_) {}));
+    }
+    final done = _switchDone;
+    _switchDone = null;
+    done?.complete();
+  }
+
+  void _abandonSwitch(_FeedState incoming, Object error) {
+    if (!identical(incoming, _incoming)) return;
+    _incoming = null;
+    incoming.subscription?.cancel();
+    unawaited(incoming.feed.stop().catchError((_) {}));
+    final done = _switchDone;
+    _switchDone = null;
+    if (done != null && !done.isCompleted) done.completeError(error);
+  }
+
+  void _emit(_FeedState feed, VideoFrame frame) {
+    if (_frames.isClosed) return;
+    var timestampMs = frame.timestampMs + feed.offsetMs;
+    if (timestampMs <= _lastTimestampMs) timestampMs = _lastTimestampMs + 1;
+    _lastTimestampMs = timestampMs;
+    _lastSentUs = _clock.elapsedMicroseconds;
+    _frames.add(
+      timestampMs == frame.timestampMs
+          ? frame
+          : VideoFrame(
+              data: frame.data,
+              width: frame.width,
+              height: frame.height,
+              timestampMs: timestampMs,
+              format: frame.format,
+            ),
+    );
+  }
+
+  /// Stop the current camera and any switch in progress
+  Future<void> stop() async {
+    final incoming = _incoming;
+    if (incoming != null) {
+      _abandonSwitch(incoming, StateError('Camera stopped during switch'));
+    }
+    final active = _active;
+    _active = null;
+    if (active != null) {
+      await active.subscription?.cancel();
+      await active.feed.stop();
+    }
+  }
+
+  Future<void> dispose() async {
+    await stop();
+    await _frames.close();
+  }
+}
+
+class _FeedState {
+  final String device;
+  final CameraFeed feed;
+  StreamSubscription<VideoFrame>? subscription;
+  int seen = 0;
+  int offsetMs = 0;
+
+  _FeedState(this.device, this.feed);
+}
@@ -1,5 +1,6 @@
 import 'dart:convert';
 import 'dart:typed_data';
+import '../../../services/native_h264_bitstream.dart';
 import 'fmp4_boxes.dart';
 
 /// H.264 video muxer for fragmented MP4 (fMP4/CMAF)
@@ -7,6 +8,9 @@ import 'fmp4_boxes.dart';
 /// Creates init segments (ftyp+moov) and media segments (moof+mdat)
 /// from H.264 NAL units in Annex B format.
 class H264Fmp4Muxer {
+  // SIMD start-code scanner shared by all muxers; null falls back to Dart
+  static final NativeH264Bitstream? _bitstream = NativeH264Bitstream.create();
+
   final int width;
   final int height;
   final int frameRate;
@@ -164,6 +168,9 @@ class H264Fmp4Muxer {
 
   // Extract NAL units from Annex B bitstream
   List<Uint8List> _extractNalUnits(Uint8List data) {
+    final native = _bitstream?.splitNalUnits(data);
+    if (native != null) return native;
+
     final nalUnits = <Uint8List>[];
     int start = -1;
 
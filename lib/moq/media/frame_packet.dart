@@ -0,0 +1,96 @@
+import 'dart:typed_data';
+
+/// Capture frame received on a binary channel
+///
+/// A packed 32-byte little-endian header followed by the payload (layout in
+/// windows/runner/frame_packet.h). Fields are read from the message in
+/// place and [payload] is a view, so receiving a frame allocates nothing
+/// but this wrapper.
+class FramePacket {
+  static const int headerSize = 32;
+  static const int version = 1;
+
+  static const int kindVideo = 0;
+  static const int kindAudio = 1;
+
+  static const int formatUnknown = 0;
+  static const int formatBgra = 1;
+  static const int formatMjpeg = 2;
+  static const int formatI420 = 3;
+  static const int formatPcm = 4;
+
+  final ByteData _message;
+
+  FramePacket._(this._message);
+
+  /// Wrap [message], or null if it is not a complete packet of this version
+  static FramePacket? parse(ByteData message) {
+    if (message.lengthInBytes < headerSize || message.getUint8(0) != version) {
+      return null;
+    }
+    final packet = FramePacket._(message);
+    if (packet.payloadLength > message.lengthInBytes - headerSize) return null;
+    return packet;
+  }
+
+  int get kind => _message.getUint8(1);
+  int get formatCode => _message.getUint8(2);
+
+  /// Format name, as in NativeVideoFrame.format
+  String get format => switch (formatCode) {
+    formatBgra => 'bgra',
+    formatMjpeg => 'mjpeg',
+    formatI420 => 'yuv420p',
+    formatPcm => 'pcm',
+    _ => 'unknown',
+  };
+
+  int get width => _message.getUint32(4, Endian.little);
+  int get height => _message.getUint32(8, Endian.little);
+
+  /// Bytes per row; 0 for compressed formats
+  int get stride => _message.getUint32(12, Endian.little);
+
+  /// Audio packets reuse the size fields
+  int get sampleRate => width;
+  int get channels => height;
+  int get bitsPerSample => stride;
+
+  int get timestampMs => _message.getInt64(16, Endian.little);
+
+  /// Per-channel counter; a jump means the platform dropped packets
+  int get sequence => _message.getUint32(24, Endian.little);
+
+  int get payloadLength => _message.getUint32(28, Endian.little);
+
+  Uint8List get payload => _message.buffer.asUint8List(
+    _message.offsetInBytes + headerSize,
+    payloadLength,
+  );
+
+  /// Build a packet (the platform side does this natively)
+  static Uint8List encode({
+    required int kind,
+    required int format,
+    required int width,
+    required int height,
+    required int stride,
+    required int timestampMs,
+    required int sequence,
+    required Uint8List payload,
+  }) {
+    final packet = Uint8List(headerSize + payload.length);
+    ByteData.sublistView(packet, 0, headerSize)
+      ..setUint8(0, version)
+      ..setUint8(1, kind)
+      ..setUint8(2, format)
+      ..setUint32(4, width, Endian.little)
+      ..setUint32(8, height, Endian.little)
+      ..setUint32(12, stride, Endian.little)
+      ..setInt64(16, timestampMs, Endian.little)
+      ..setUint32(24, sequence, Endian.little)
+      ..setUint32(28, payload.length, Endian.little);
+    packet.setRange(headerSize, packet.length, payload);
+    return packet;
+  }
+}
@@ -4,7 +4,11 @@ import 'dart:ui' as ui;
 import 'package:camera/camera.dart' show ResolutionPreset;
 import 'package:flutter/foundation.dart';
 import 'package:logger/logger.dart';
+import '../../services/native_device_monitor.dart';
+import '../../services/native_mjpeg_decoder.dart';
 import 'camera_capture.dart';
+import 'camera_mode.dart';
+import 'camera_switcher.dart';
 import 'audio_capture.dart';
 
 /// Converts YUV420P frame data to RGBA for display
@@ -203,6 +207,11 @@ class PreviewFrame {
   }
 }
 
+/// A capture that renders its own RGBA preview frames
+abstract class PreviewFrameSource {
+  Stream<PreviewFrame> get previewFrames;
+}
+
 /// Information about a V4L2 camera device
 class LinuxCameraInfo {
   final String devicePath;
@@ -226,7 +235,7 @@ class LinuxCameraInfo {
 /// Captures raw video frames from a webcam using FFmpeg's v4l2 input.
 /// Outputs YUV420P frames suitable for H.264 encoding.
 /// Also provides RGBA preview frames for UI display.
-class LinuxVideoCapture implements VideoCapture {
+class LinuxVideoCapture implements VideoCapture, PreviewFrameSource {
   final CaptureConfig config;
   final Logger _logger;
 
@@ -235,14 +244,13 @@ class LinuxVideoCapture implements VideoCapture {
   bool _isCapturing = false;
   int _startTimeMs = 0;
 
-  // FFmpeg process for video capture
-  Process? _ffmpegProcess;
+  // One FFmpeg process per camera; two run side by side while switching
+  CameraSwitcher? _switcher;
+  StreamSubscription<VideoFrame>? _frameSubscription;
   String _selectedDevice = '/dev/video0';
 
-  // Frame buffer for parsing FFmpeg output
-  Uint8List? _frameBuffer;
-  int _frameBufferOffset = 0;
-  int _expectedFrameSize = 0;
+  // Camera mode picked from the device's advertised modes (null = unknown)
+  CameraMode? _mode;
 
   // Preview frame generation
   int _frameCount = 0;
@@ -263,6 +271,7 @@ class LinuxVideoCapture implements VideoCapture {
   Stream<VideoFrame> get videoFrames => _videoFrameController.stream;
 
   /// Stream of RGBA preview frames for UI display
+  @override
   Stream<PreviewFrame> get previewFrames => _previewFrameController.stream;
 
   @override
@@ -272,9 +281,25 @@ class LinuxVideoCapture implements VideoCapture {
   bool get isCapturing => _isCapturing;
 
   /// Get list of available V4L2 video devices
+  ///
+  /// Served from the native device monitor's cache when it is available;
+  /// otherwise every node is queried with v4l2-ctl.
   static Future<List<LinuxCameraInfo>> getAvailableCameras({
     Logger? logger,
   }) async {
+    final monitor = NativeDeviceMonitor.instance;
+    if (monitor != null) {
+      return [
+        for (final device in monitor.devices)
+          LinuxCameraInfo(
+            devicePath: device.path,
+            name: device.name,
+            driver: device.driver,
+            busInfo: device.busInfo,
+          ),
+      ];
+    }
+
     final cameras = <LinuxCameraInfo>[];
     final log = logger ?? Logger();
 
@@ -340,18 +365,17 @@ class LinuxVideoCapture implements VideoCapture {
     return cameras;
   }
 
+  /// Cameras plugged in or removed, when the native device monitor is
+  /// available
+  static Stream<VideoDeviceChange>? get deviceChanges =>
+      NativeDeviceMonitor.instance?.changes;
+
   /// Initialize video capture with optional device selection
   Future<void> initialize({String? devicePath}) async {
     if (devicePath != null) {
       _selectedDevice = devicePath;
     }
 
-    // Calculate expected frame size for YUV420P
-    final (width, height) = _resolutionFromPreset(config.resolution);
-    _expectedFrameSize = width * height * 3 ~/ 2; // YUV420P: Y + U/4 + V/4
-    _frameBuffer = Uint8List(_expectedFrameSize);
-    _frameBufferOffset = 0;
-
     // Check if FFmpeg is available
     try {
       final result = await Process.run('which', ['ffmpeg']);
@@ -378,6 +402,8 @@ class LinuxVideoCapture implements VideoCapture {
       }
     }
 
+    _selectMode();
+
     // Initialize audio capture if enabled
     if (config.enableAudio) {
       _audioCapture = AudioCapture(
@@ -394,15 +420,42 @@ class LinuxVideoCapture implements VideoCapture {
   }
 
   /// Select a specific camera device
+  ///
+  /// While capturing, the new camera is started next to the current one and
+  /// output cuts over once it delivers frames, so the stream never stalls.
+  /// Throws if the new camera fails; the current one keeps capturing then.
   Future<void> selectCamera(String devicePath) async {
-    if (_isCapturing) {
-      throw StateError('Cannot change camera while capturing');
+    final switcher = _switcher;
+    if (_isCapturing && switcher != null) {
+      await switcher.switchTo(devicePath);
+      _selectedDevice = devicePath;
+      _mode = (switcher.feed as _V4l2Feed?)?.mode;
+      _logger.i(
+        'Switched camera to $devicePath, '
+        'gap ${switcher.lastSwitchGap?.inMilliseconds ?? 0}ms',
+      );
+      return;
     }
     _selectedDevice = devicePath;
+    _selectMode();
     _logger.i('Selected camera: $devicePath');
   }
 
-  (int, int) _resolutionFromPreset(ResolutionPreset preset) {
+  void _selectMode() {
+    _mode = _V4l2Feed.pickMode(_selectedDevice, config);
+    if (_mode != null) {
+      _logger.i('Camera mode for $_selectedDevice: $_mode');
+    }
+  }
+
+  /// Mode the camera is captured in, if it could be enumerated
+  CameraMode? get mode => _mode;
+
+  /// MJPEG decoder counters (null unless decoding natively)
+  MjpegDecoderStats? get mjpegStats =>
+      (_switcher?.feed as _V4l2Feed?)?.mjpegStats;
+
+  static (int, int) _resolutionFromPreset(ResolutionPreset preset) {
     switch (preset) {
       case ResolutionPreset.low:
         return (320, 240);
@@ -428,45 +481,300 @@ class LinuxVideoCapture implements VideoCapture {
 
     _isCapturing = true;
     _startTimeMs = DateTime.now().millisecondsSinceEpoch;
-    _frameBufferOffset = 0;
 
-    final (width, height) = _resolutionFromPreset(config.resolution);
+    // Every feed stamps frames against the same start time
+    final startTimeMs = _startTimeMs;
+    final switcher = CameraSwitcher(
+      (device) => _V4l2Feed.open(
+        device,
+        config: config,
+        startTimeMs: startTimeMs,
+        logger: _logger,
+        onEnded: _onFeedEnded,
+      ),
+      frameRate: config.frameRate,
+    );
+    _switcher = switcher;
+    _frameSubscription = switcher.frames.listen(_emitFrame);
 
     try {
-      // Start FFmpeg to capture from V4L2 and output raw YUV420P frames
+      await switcher.start(_selectedDevice);
+      _mode = (switcher.feed as _V4l2Feed?)?.mode;
+
+      // Start audio capture if enabled
+      if (config.enableAudio && _audioCapture != null) {
+        await _audioCapture!.startCapture();
+        _logger.i('Linux audio capture started');
+      }
+    } catch (e) {
+      _isCapturing = false;
+      await _frameSubscription?.cancel();
+      _frameSubscription = null;
+      _switcher = null;
+      await switcher.dispose();
+      _logger.e('Failed to start Linux video capture: $e');
+      rethrow;
+    }
+  }
+
+  void _onFeedEnded(_V4l2Feed feed) {
+    // Only the camera in use ending stops the capture
+    if (_isCapturing && identical(_switcher?.feed, feed)) {
+      _isCapturing = false;
+    }
+  }
+
+  void _emitFrame(VideoFrame frame) {
+    if (!_isCapturing) return;
+    _videoFrameController.add(frame);
+
+    // Generate preview frame every Nth frame (to reduce CPU load)
+    _frameCount++;
+    if (_frameCount % _previewFrameInterval == 0 && !_isConvertingPreview) {
+      _isConvertingPreview = true;
+      final width = frame.width;
+      final height = frame.height;
+      final timestampMs = frame.timestampMs;
+      final (previewWidth, previewHeight) = _previewDimensions(width, height);
+      // Convert directly to a lower-resolution preview in an isolate.
+      Yuv420ToRgbaConverter.convertPreviewAsync(
+            frame.data,
+            width,
+            height,
+            previewWidth,
+            previewHeight,
+          )
+          .then((rgbaData) {
+            if (_isCapturing && !_previewFrameController.isClosed) {
+              _previewFrameController.add(
+                PreviewFrame(
+                  rgbaData: rgbaData,
+                  width: previewWidth,
+                  height: previewHeight,
+                  timestampMs: timestampMs,
+                ),
+              );
+            }
+            _isConvertingPreview = false;
+          })
+          .catchError((e) {
+            _logger.w('Preview frame conversion failed: $e');
+            _isConvertingPreview = false;
+          });
+    }
+  }
+
+  (int, int) _previewDimensions(int sourceWidth, int sourceHeight) {
+    var previewWidth = sourceWidth;
+    var previewHeight = sourceHeight;
+
+    if (previewWidth > _previewMaxWidth) {
+      previewHeight = (previewHeight * _previewMaxWidth ~/ previewWidth);
+      previewWidth = _previewMaxWidth;
+    }
+
+    if (previewHeight > _previewMaxHeight) {
+      previewWidth = (previewWidth * _previewMaxHeight ~/ previewHeight);
+      previewHeight = _previewMaxHeight;
+    }
+
+    if (previewWidth.isOdd) {
+      previewWidth -= 1;
+    }
+    if (previewHeight.isOdd) {
+      previewHeight -= 1;
+    }
+
+    previewWidth = previewWidth.clamp(2, sourceWidth);
+    previewHeight = previewHeight.clamp(2, sourceHeight);
+    return (previewWidth, previewHeight);
+  }
+
+  @override
+  Future<void> stopCapture() async {
+    if (!_isCapturing) return;
+
+    _isCapturing = false;
+
+    // Stop FFmpeg
+    await _frameSubscription?.cancel();
+    _frameSubscription = null;
+    final switcher = _switcher;
+    _switcher = null;
+    await switcher?.dispose();
+
+    // Stop audio capture
+    if (_audioCapture != null) {
+      await _audioCapture!.stopCapture();
+    }
+
+    _logger.i('Linux video capture stopped');
+  }
+
+  @override
+  void dispose() {
+    stopCapture();
+    _audioCapture?.dispose();
+    _videoFrameController.close();
+    _previewFrameController.close();
+  }
+
+  /// Get the audio capture instance (for direct access)
+  AudioCapture? get audioCapture => _audioCapture;
+}
+
+/// One FFmpeg process capturing a V4L2 device
+class _V4l2Feed implements CameraFeed {
+  final String device;
+
+  /// Mode the device is captured in (null = unknown)
+  final CameraMode? mode;
+  final int width;
+  final int height;
+  final int _startTimeMs;
+  final Logger _logger;
+  final void Function(_V4l2Feed feed)? _onEnded;
+
+  final _frames = StreamController<VideoFrame>.broadcast();
+  Process? _process;
+  bool _running = false;
+
+  // Frame buffer for parsing FFmpeg output
+  final Uint8List _frameBuffer;
+  int _frameBufferOffset = 0;
+
+  // MJPEG path: FFmpeg copies the camera's JPEGs, decoded natively to I420
+  NativeMjpegDecoder? _mjpegDecoder;
+  Timer? _mjpegPollTimer;
+  Uint8List _jpegBuffer = Uint8List(0);
+  int _jpegLength = 0;
+  int _jpegScanOffset = 0;
+
+  _V4l2Feed._(
+    this.device,
+    this.mode,
+    this.width,
+    this.height,
+    this._startTimeMs,
+    this._logger,
+    this._onEnded,
+  ) : // Frame size for YUV420P: Y + U/4 + V/4
+      _frameBuffer = Uint8List(width * height * 3 ~/ 2);
+
+  /// Pick the device mode for the configured size and rate
+  ///
+  /// Raw modes are used when they reach the rate. Otherwise MJPEG is used,
+  /// which is how most USB 2.0 cameras get 30fps and more above 480p.
+  static CameraMode? pickMode(String device, CaptureConfig config) {
+    final (width, height) = LinuxVideoCapture._resolutionFromPreset(
+      config.resolution,
+    );
+    final modes = NativeMjpegDecoder.enumerateV4l2Modes(device);
+    return modes == null
+        ? null
+        : CameraModeSelector.select(
+            modes,
+            width: width,
+            height: height,
+            frameRate: config.frameRate.toDouble(),
+          );
+  }
+
+  /// Start capturing [device]
+  static Future<_V4l2Feed> open(
+    String device, {
+    required CaptureConfig config,
+    required int startTimeMs,
+    required Logger logger,
+    void Function(_V4l2Feed feed)? onEnded,
+  }) async {
+    final mode = pickMode(device, config);
+    final (width, height) = LinuxVideoCapture._resolutionFromPreset(
+      config.resolution,
+    );
+    final feed = _V4l2Feed._(
+      device,
+      mode,
+      mode?.width ?? width,
+      mode?.height ?? height,
+      startTimeMs,
+      logger,
+      onEnded,
+    );
+    await feed._start(config.frameRate);
+    return feed;
+  }
+
+  @override
+  Stream<VideoFrame> get frames => _frames.stream;
+
+  /// MJPEG decoder counters (null unless decoding natively)
+  MjpegDecoderStats? get mjpegStats => _mjpegDecoder?.getStats();
+
+  Future<void> _start(int targetFrameRate) async {
+    _running = true;
+    final mode = this.mode;
+    final frameRate = mode != null
+        ? mode.frameRate.round().clamp(1, targetFrameRate)
+        : targetFrameRate;
+
+    // Copy MJPEG out of FFmpeg untouched and decode it natively: libjpeg-turbo
+    // decodes straight into YUV planes, skipping FFmpeg's RGB round trip
+    if (mode != null && mode.isMjpeg) {
+      _mjpegDecoder = NativeMjpegDecoder.create();
+    }
+    final decodeNatively = _mjpegDecoder != null;
+
+    try {
+      // Start FFmpeg to capture from V4L2
       // -f v4l2: input format
       // -video_size: resolution
       // -framerate: frame rate
+      // -input_format: camera pixel format (mode selected in initialize)
       // -i: input device
-      // -f rawvideo: output format
-      // -pix_fmt yuv420p: pixel format
-      // -: output to stdout
-      _ffmpegProcess = await Process.start('ffmpeg', [
+      // Output is either the camera's JPEGs (-c:v copy -f mjpeg) or raw
+      // YUV420P frames (-f rawvideo -pix_fmt yuv420p), written to stdout
+      _process = await Process.start('ffmpeg', [
         '-f', 'v4l2',
         '-video_size', '${width}x$height',
-        '-framerate', '30',
-        '-input_format', 'mjpeg', // Many webcams support MJPEG well
-        '-i', _selectedDevice,
-        '-f', 'rawvideo',
-        '-pix_fmt', 'yuv420p',
+        '-framerate', '$frameRate',
+        '-input_format', mode?.ffmpegInputFormat ?? 'mjpeg',
+        '-i', device,
+        if (decodeNatively) ...[
+          '-c:v', 'copy',
+          '-f', 'mjpeg',
+        ] else ...[
+          '-f', 'rawvideo',
+          '-pix_fmt', 'yuv420p',
+        ],
         '-',
       ]);
 
+      if (decodeNatively) {
+        _mjpegPollTimer = Timer.periodic(
+          const Duration(milliseconds: 5),
+          (_) => _pollDecodedFrames(),
+        );
+      }
+
       // Read video data from stdout
-      _ffmpegProcess!.stdout.listen(
-        (List<int> data) => _onVideoData(Uint8List.fromList(data)),
+      _process!.stdout.listen(
+        (List<int> data) => decodeNatively
+            ? _onJpegData(Uint8List.fromList(data))
+            : _onVideoData(Uint8List.fromList(data)),
         onError: (error) {
           _logger.e('FFmpeg video stream error: $error');
         },
         onDone: () {
           _logger.i('FFmpeg video stream ended');
-          if (_isCapturing) {
-            _isCapturing = false;
+          if (_running) {
+            _running = false;
+            _onEnded?.call(this);
           }
         },
       );
 
-      _ffmpegProcess!.stderr.listen((data) {
+      _process!.stderr.listen((data) {
         final message = String.fromCharCodes(data);
         // FFmpeg outputs progress to stderr, filter out noise
         if (message.contains('Error') || message.contains('error')) {
@@ -474,30 +782,27 @@ class LinuxVideoCapture implements VideoCapture {
         }
       });
 
-      _logger.i('Linux video capture started: $width x $height @ 30fps');
-
-      // Start audio capture if enabled
-      if (config.enableAudio && _audioCapture != null) {
-        await _audioCapture!.startCapture();
-        _logger.i('Linux audio capture started');
-      }
+      _logger.i(
+        'Linux video capture started: $device $width x $height @ ${frameRate}fps'
+        '${decodeNatively ? ' (native MJPEG decode)' : ''}',
+      );
     } catch (e) {
-      _isCapturing = false;
-      _logger.e('Failed to start Linux video capture: $e');
+      _running = false;
+      _stopMjpegDecoder();
       rethrow;
     }
   }
 
   void _onVideoData(Uint8List data) {
-    if (!_isCapturing) return;
+    if (!_running) return;
 
     // Accumulate data into frame buffer
     int dataOffset = 0;
     while (dataOffset < data.length) {
-      final remaining = _expectedFrameSize - _frameBufferOffset;
+      final remaining = _frameBuffer.length - _frameBufferOffset;
       final toCopy = (data.length - dataOffset).clamp(0, remaining);
 
-      _frameBuffer!.setRange(
+      _frameBuffer.setRange(
         _frameBufferOffset,
         _frameBufferOffset + toCopy,
         data,
@@ -508,57 +813,10 @@ class LinuxVideoCapture implements VideoCapture {
       dataOffset += toCopy;
 
       // If we have a complete frame, emit it
-      if (_frameBufferOffset >= _expectedFrameSize) {
+      if (_frameBufferOffset >= _frameBuffer.length) {
         final timestampMs =
             DateTime.now().millisecondsSinceEpoch - _startTimeMs;
-        final (width, height) = _resolutionFromPreset(config.resolution);
-
-        final frameData = Uint8List.fromList(_frameBuffer!);
-
-        final frame = VideoFrame(
-          data: frameData,
-          width: width,
-          height: height,
-          timestampMs: timestampMs,
-          format: 'yuv420p',
-        );
-
-        _videoFrameController.add(frame);
-
-        // Generate preview frame every Nth frame (to reduce CPU load)
-        _frameCount++;
-        if (_frameCount % _previewFrameInterval == 0 && !_isConvertingPreview) {
-          _isConvertingPreview = true;
-          final (previewWidth, previewHeight) = _previewDimensions(
-            width,
-            height,
-          );
-          // Convert directly to a lower-resolution preview in an isolate.
-          Yuv420ToRgbaConverter.convertPreviewAsync(
-                frameData,
-                width,
-                height,
-                previewWidth,
-                previewHeight,
-              )
-              .then((rgbaData) {
-                if (_isCapturing && !_previewFrameController.isClosed) {
-                  _previewFrameController.add(
-                    PreviewFrame(
-                      rgbaData: rgbaData,
-                      width: previewWidth,
-                      height: previewHeight,
-                      timestampMs: timestampMs,
-                    ),
-                  );
-                }
-                _isConvertingPreview = false;
-              })
-              .catchError((e) {
-                _logger.w('Preview frame conversion failed: $e');
-                _isConvertingPreview = false;
-              });
-        }
+        _addFrame(Uint8List.fromList(_frameBuffer), width, height, timestampMs);
 
         // Reset buffer for next frame
         _frameBufferOffset = 0;
@@ -566,67 +824,91 @@ class LinuxVideoCapture implements VideoCapture {
     }
   }
 
-  (int, int) _previewDimensions(int sourceWidth, int sourceHeight) {
-    var previewWidth = sourceWidth;
-    var previewHeight = sourceHeight;
+  /// Split FFmpeg's MJPEG stream into JPEGs and queue them for decoding
+  void _onJpegData(Uint8List data) {
+    if (!_running) return;
 
-    if (previewWidth > _previewMaxWidth) {
-      previewHeight = (previewHeight * _previewMaxWidth ~/ previewWidth);
-      previewWidth = _previewMaxWidth;
+    if (_jpegLength + data.length > _jpegBuffer.length) {
+      final grown = Uint8List((_jpegLength + data.length) * 2);
+      grown.setRange(0, _jpegLength, _jpegBuffer);
+      _jpegBuffer = grown;
     }
+    _jpegBuffer.setRange(_jpegLength, _jpegLength + data.length, data);
+    _jpegLength += data.length;
 
-    if (previewHeight > _previewMaxHeight) {
-      previewWidth = (previewWidth * _previewMaxHeight ~/ previewHeight);
-      previewHeight = _previewMaxHeight;
+    // Entropy-coded data stuffs 0xFF as FF 00, so FF D9 only ends an image
+    var frameStart = 0;
+    for (var i = _jpegScanOffset; i + 1 < _jpegLength; i++) {
+      if (_jpegBuffer[i] == 0xFF && _jpegBuffer[i + 1] == 0xD9) {
+        final timestampMs =
+            DateTime.now().millisecondsSinceEpoch - _startTimeMs;
+        _mjpegDecoder?.push(
+          Uint8List.sublistView(_jpegBuffer, frameStart, i + 2),
+          timestampMs,
+        );
+        frameStart = i + 2;
+        i++;
+      }
     }
 
-    if (previewWidth.isOdd) {
-      previewWidth -= 1;
+    // Keep the unfinished image at the front of the buffer
+    if (frameStart > 0) {
+      _jpegBuffer.setRange(0, _jpegLength - frameStart, _jpegBuffer, frameStart);
+      _jpegLength -= frameStart;
     }
-    if (previewHeight.isOdd) {
-      previewHeight -= 1;
+    _jpegScanOffset = _jpegLength > 0 ? _jpegLength - 1 : 0;
+  }
+
+  void _pollDecodedFrames() {
+    final decoder = _mjpegDecoder;
+    if (decoder == null || !_running) return;
+    for (var frame = decoder.pull(); frame != null; frame = decoder.pull()) {
+      _addFrame(frame.data, frame.width, frame.height, frame.timestampMs);
     }
+  }
 
-    previewWidth = previewWidth.clamp(2, sourceWidth);
-    previewHeight = previewHeight.clamp(2, sourceHeight);
-    return (previewWidth, previewHeight);
+  void _stopMjpegDecoder() {
+    _mjpegPollTimer?.cancel();
+    _mjpegPollTimer = null;
+    final decoder = _mjpegDecoder;
+    _mjpegDecoder = null;
+    if (decoder != null) {
+      _logger.i('MJPEG decode: ${decoder.getStats()}');
+      decoder.dispose();
+    }
   }
 
-  @override
-  Future<void> stopCapture() async {
-    if (!_isCapturing) return;
+  void _addFrame(Uint8List frameData, int width, int height, int timestampMs) {
+    if (_frames.isClosed) return;
+    _frames.add(
+      VideoFrame(
+        data: frameData,
+        width: width,
+        height: height,
+        timestampMs: timestampMs,
+        format: 'yuv420p',
+      ),
+    );
+  }
 
-    _isCapturing = false;
+  @override
+  Future<void> stop() async {
+    _running = false;
 
     // Stop FFmpeg
-    if (_ffmpegProcess != null) {
-      _ffmpegProcess!.kill(ProcessSignal.sigterm);
-      await _ffmpegProcess!.exitCode.timeout(
+    final process = _process;
+    _process = null;
+    if (process != null) {
+      process.kill(ProcessSignal.sigterm);
+      await process.exitCode.timeout(
         const Duration(seconds: 2),
         onTimeout: () {
-          _ffmpegProcess!.kill(ProcessSignal.sigkill);
+          process.kill(ProcessSignal.sigkill);
           return -1;
         },
       );
-      _ffmpegProcess = null;
     }
-
-    // Stop audio capture
-    if (_audioCapture != null) {
-      await _audioCapture!.stopCapture();
-    }
-
-    _logger.i('Linux video capture stopped');
-  }
-
-  @override
-  void dispose() {
-    stopCapture();
-    _audioCapture?.dispose();
-    _videoFrameController.close();
-    _previewFrameController.close();
+    _stopMjpegDecoder();
+    await _frames.close();
   }
-
-  /// Get the audio capture instance (for direct access)
-  AudioCapture? get audioCapture => _audioCapture;
 }
@@ -0,0 +1,316 @@
+import 'dart:async';
+import 'dart:isolate';
+import 'dart:typed_data';
+import 'package:logger/logger.dart';
+import '../../services/native_screen_capture.dart';
+import 'camera_capture.dart';
+import 'linux_capture.dart';
+
+/// Screen capture configuration
+class ScreenCaptureConfig {
+  /// Output size (0 = native screen size)
+  final int width;
+  final int height;
+
+  /// Grab rate
+  final int frameRate;
+
+  /// Rate at which an unchanged screen is re-sent
+  ///
+  /// The encoder turns a repeated frame into a skip frame of a few bytes,
+  /// which keeps the GOP cadence (and so join time) bounded while a slide is
+  /// static. 0 sends changed frames only.
+  final int idleFrameRate;
+
+  /// X display (null = $DISPLAY)
+  final String? display;
+
+  /// X window to capture (0 = whole screen)
+  final int windowId;
+
+  const ScreenCaptureConfig({
+    this.width = 0,
+    this.height = 0,
+    this.frameRate = 30,
+    this.idleFrameRate = 5,
+    this.display,
+    this.windowId = 0,
+  });
+}
+
+/// Linux screen capture with damage-aware frame delivery
+///
+/// Grabs the screen through the native X11 capture on a worker isolate.
+/// Frames are only delivered when something changed (plus the idle repeats
+/// configured in [ScreenCaptureConfig.idleFrameRate]), so a static screen
+/// costs almost no conversion or encoding work.
+class LinuxScreenCapture implements VideoCapture, PreviewFrameSource {
+  final ScreenCaptureConfig config;
+  final Logger _logger;
+
+  final _videoFrameController = StreamController<VideoFrame>.broadcast();
+  final _previewFrameController = StreamController<PreviewFrame>.broadcast();
+  bool _isCapturing = false;
+  int _startTimeMs = 0;
+
+  Isolate? _worker;
+  ReceivePort? _receivePort;
+  SendPort? _workerPort;
+  int _width = 0;
+  int _height = 0;
+  Uint8List? _lastFrame;
+  ScreenCaptureStats? _stats;
+
+  // Preview frame generation
+  static const int _previewMaxWidth = 640;
+  bool _isConvertingPreview = false;
+
+  LinuxScreenCapture({ScreenCaptureConfig? config, Logger? logger})
+    : config = config ?? const ScreenCaptureConfig(),
+      _logger = logger ?? Logger();
+
+  /// Whether screen capture can be used on this system
+  static bool get isAvailable => NativeScreenCapture.isAvailable;
+
+  @override
+  Stream<VideoFrame> get videoFrames => _videoFrameController.stream;
+
+  @override
+  Stream<PreviewFrame> get previewFrames => _previewFrameController.stream;
+
+  @override
+  Stream<AudioSamples>? get audioSamples => null;
+
+  @override
+  bool get isCapturing => _isCapturing;
+
+  /// Output frame size, known once capture has started
+  int get width => _width;
+  int get height => _height;
+
+  /// Latest capture counters (refreshed about once a second)
+  ScreenCaptureStats? get stats => _stats;
+
+  @override
+  Future<void> startCapture() async {
+    if (_isCapturing) {
+      _logger.w('Already capturing');
+      return;
+    }
+
+    final receivePort = ReceivePort();
+    final ready = Completer<void>();
+    _receivePort = receivePort;
+    receivePort.listen((message) => _onWorkerMessage(message, ready));
+
+    _worker = await Isolate.spawn(
+      _screenCaptureWorker,
+      _WorkerArgs(receivePort.sendPort, config),
+      debugName: 'screen-capture',
+    );
+    try {
+      await ready.future.timeout(const Duration(seconds: 5));
+    } catch (e) {
+      await _shutdownWorker();
+      _logger.e('Failed to start screen capture: $e');
+      rethrow;
+    }
+
+    _isCapturing = true;
+    _startTimeMs = DateTime.now().millisecondsSinceEpoch;
+    _logger.i(
+      'Screen capture started: $_width x $_height @ ${config.frameRate}fps',
+    );
+  }
+
+  void _onWorkerMessage(dynamic message, Completer<void> ready) {
+    final parts = message as List;
+    switch (parts[0] as String) {
+      case 'ready':
+        _workerPort = parts[1] as SendPort;
+        _width = parts[2] as int;
+        _height = parts[3] as int;
+        ready.complete();
+      case 'frame':
+        final data = (parts[1] as TransferableTypedData)
+            .materialize()
+            .asUint8List();
+        _lastFrame = data;
+        _emit(data, preview: true);
+      case 'repeat':
+        final data = _lastFrame;
+        if (data != null) _emit(data, preview: false);
+      case 'stats':
+        _stats = ScreenCaptureStats.fromValues((parts[1] as List).cast<int>());
+      case 'error':
+        final error = parts[1] as String;
+        if (!ready.isCompleted) {
+          ready.completeError(StateError(error));
+        } else {
+          _logger.e('Screen capture stopped: $error');
+          unawaited(stopCapture());
+        }
+    }
+  }
+
+  void _emit(Uint8List data, {required bool preview}) {
+    if (!_isCapturing || _videoFrameController.isClosed) return;
+    final timestampMs = DateTime.now().millisecondsSinceEpoch - _startTimeMs;
+    _videoFrameController.add(
+      VideoFrame(
+        data: data,
+        width: _width,
+        height: _height,
+        timestampMs: timestampMs,
+        format: 'yuv420p',
+      ),
+    );
+
+    if (!preview || _isConvertingPreview) return;
+    _isConvertingPreview = true;
+    final previewWidth = (_width.clamp(2, _previewMaxWidth)) & ~1;
+    final previewHeight = (_height * previewWidth ~/ _width).clamp(2, _height) & ~1;
+    Yuv420ToRgbaConverter.convertPreviewAsync(
+          data,
+          _width,
+          _height,
+          previewWidth,
+          previewHeight,
+        )
+        .then((rgbaData) {
+          if (_isCapturing && !_previewFrameController.isClosed) {
+            _previewFrameController.add(
+              PreviewFrame(
+                rgbaData: rgbaData,
+                width: previewWidth,
+                height: previewHeight,
+                timestampMs: timestampMs,
+              ),
+            );
+          }
+          _isConvertingPreview = false;
+        })
+        .catchError((e) {
+          _logger.w('Preview frame conversion failed: $e');
+          _isConvertingPreview = false;
+        });
+  }
+
+  @override
+  Future<void> stopCapture() async {
+    if (!_isCapturing) return;
+    _isCapturing = false;
+    await _shutdownWorker();
+    _logger.i('Screen capture stopped${_stats != null ? ': $_stats' : ''}');
+  }
+
+  Future<void> _shutdownWorker() async {
+    final worker = _worker;
+    _worker = null;
+    if (worker != null) {
+      final exited = ReceivePort();
+      worker.addOnExitListener(exited.sendPort);
+      _workerPort?.send('stop');
+      await exited.first.timeout(
+        const Duration(seconds: 1),
+        onTimeout: () => worker.kill(priority: Isolate.immediate),
+      );
+      exited.close();
+    }
+    _workerPort = null;
+    _receivePort?.close();
+    _receivePort = null;
+  }
+
+  @override
+  void dispose() {
+    stopCapture();
+    _videoFrameController.close();
+    _previewFrameController.close();
+  }
+}
+
+class _WorkerArgs {
+  final SendPort sendPort;
+  final ScreenCaptureConfig config;
+
+  _WorkerArgs(this.sendPort, this.config);
+}
+
+// Grabs on a timer and only ships changed frames to the main isolate
+void _screenCaptureWorker(_WorkerArgs args) {
+  final config = args.config;
+  final capture = NativeScreenCapture.open(
+    display: config.display,
+    windowId: config.windowId,
+    width: config.width,
+    height: config.height,
+  );
+  if (capture == null) {
+    args.sendPort.send(['error', 'Screen capture unavailable (needs X11 with MIT-SHM)']);
+    return;
+  }
+
+  final commands = ReceivePort();
+  final idleInterval = config.idleFrameRate > 0
+      ? Duration(microseconds: 1000000 ~/ config.idleFrameRate)
+      : null;
+  final sinceSent = Stopwatch()..start();
+  final sinceStats = Stopwatch()..start();
+  Timer? timer;
+
+  void stop() {
+    timer?.cancel();
+    commands.close();
+    capture.close();
+    Isolate.exit();
+  }
+
+  commands.listen((message) {
+    if (message == 'stop') stop();
+  });
+  args.sendPort.send(['ready', commands.sendPort, capture.width, capture.height]);
+
+  timer = Timer.periodic(
+    Duration(microseconds: 1000000 ~/ config.frameRate.clamp(1, 120)),
+    (_) {
+      switch (capture.grab()) {
+        case ScreenGrabResult.changed:
+          args.sendPort.send([
+            'frame',
+            TransferableTypedData.fromList([capture.frame]),
+          ]);
+          sinceSent.reset();
+        case ScreenGrabResult.unchanged:
+          if (idleInterval != null && sinceSent.elapsed >= idleInterval) {
+            args.sendPort.send(['repeat']);
+            sinceSent.reset();
+          }
+        case ScreenGrabResult.lost:
+          args.sendPort.send(['error', 'Captured window was resized or closed']);
+          stop();
+        case ScreenGrabResult.error:
+          args.sendPort.send(['error', 'Screen grab failed']);
+          stop();
+      }
+
+      if (sinceStats.elapsedMilliseconds >= 1000) {
+        final stats = capture.getStats();
+        if (stats != null) {
+          args.sendPort.send([
+            'stats',
+            [
+              stats.frames,
+              stats.changedFrames,
+              stats.dirtyTiles,
+              stats.tilesPerFrame,
+              stats.grabUs,
+              stats.processUs,
+            ],
+          ]);
+        }
+        sinceStats.reset();
+      }
+    },
+  );
+}
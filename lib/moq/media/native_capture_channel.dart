@@ -2,6 +2,8 @@ import 'dart:async';
 import 'package:flutter/services.dart';
 import 'package:logger/logger.dart';
 
+import 'frame_packet.dart';
+
 /// Platform channel interface for native audio/video capture on Android, macOS, iOS, and Windows
 class NativeCaptureChannel {
   static const MethodChannel _methodChannel = MethodChannel(
@@ -13,6 +15,13 @@ class NativeCaptureChannel {
   static const EventChannel _videoEventChannel = EventChannel(
     'com.moq_flutter/video_frames',
   );
+  static const EventChannel _deviceEventChannel = EventChannel(
+    'com.moq_flutter/device_changes',
+  );
+
+  // Binary frame channels (Windows); see frame_packet.dart
+  static const String _audioPacketChannel = 'com.moq_flutter/audio_packets';
+  static const String _videoPacketChannel = 'com.moq_flutter/video_packets';
 
   final Logger _logger;
 
@@ -30,6 +39,16 @@ class NativeCaptureChannel {
   bool _audioCapturing = false;
   bool _videoCapturing = false;
 
+  // Whether the platform sends frames as packed binary messages; null until
+  // asked
+  bool? _binaryTransport;
+  bool _audioBinary = false;
+  bool _videoBinary = false;
+  int? _audioSequence;
+  int? _videoSequence;
+  int _audioPacketsLost = 0;
+  int _videoPacketsLost = 0;
+
   NativeCaptureChannel({Logger? logger}) : _logger = logger ?? Logger();
 
   /// Stream of audio samples from native capture
@@ -38,6 +57,27 @@ class NativeCaptureChannel {
   /// Stream of video frames from native capture
   Stream<NativeVideoFrame> get videoStream => _videoController.stream;
 
+  /// Packets the platform dropped on the binary channels, from sequence gaps
+  int get audioPacketsLost => _audioPacketsLost;
+  int get videoPacketsLost => _videoPacketsLost;
+
+  /// Cameras or microphones plugged in or removed (Windows)
+  ///
+  /// Each event carries the full camera list, so listeners don't need to
+  /// call [getAvailableCameras] again.
+  Stream<NativeDeviceChange> get deviceChanges => _deviceEventChannel
+      .receiveBroadcastStream()
+      .where((data) => data is Map)
+      .map(
+        (data) => NativeDeviceChange.fromMap(Map<String, dynamic>.from(data)),
+      )
+      .handleError((Object e) {
+        // Platforms without the channel just never report changes
+        if (e is! MissingPluginException) {
+          _logger.e('Device change stream error: $e');
+        }
+      });
+
   /// Whether audio is currently capturing
   bool get isAudioCapturing => _audioCapturing;
 
@@ -80,15 +120,20 @@ class NativeCaptureChannel {
     }
 
     try {
-      // Start listening to audio event channel
-      _audioSubscription = _audioEventChannel.receiveBroadcastStream().listen(
-        _onAudioData,
-        onError: _onAudioError,
-      );
-
-      await _methodChannel.invokeMethod('startAudioCapture');
+      _audioBinary = await _useBinaryTransport();
+      if (_audioBinary) {
+        _audioSequence = null;
+        _messenger.setMessageHandler(_audioPacketChannel, _onAudioPacket);
+      } else {
+        // Start listening to audio event channel
+        _audioSubscription = _audioEventChannel
+            .receiveBroadcastStream()
+            .listen(_onAudioData, onError: _onAudioError);
+      }
+
+      final result = await _methodChannel.invokeMethod('startAudioCapture');
       _audioCapturing = true;
-      _logger.i('Native audio capture started');
+      _logger.i('Native audio capture started${_elapsed(result)}');
     } on PlatformException catch (e) {
       _logger.e('Failed to start audio capture: ${e.message}');
       rethrow;
@@ -103,6 +148,10 @@ class NativeCaptureChannel {
       await _methodChannel.invokeMethod('stopAudioCapture');
       await _audioSubscription?.cancel();
       _audioSubscription = null;
+      if (_audioBinary) {
+        _messenger.setMessageHandler(_audioPacketChannel, null);
+        _audioBinary = false;
+      }
       _audioCapturing = false;
       _logger.i('Native audio capture stopped');
     } on PlatformException catch (e) {
@@ -195,15 +244,20 @@ class NativeCaptureChannel {
     }
 
     try {
-      // Start listening to video event channel
-      _videoSubscription = _videoEventChannel.receiveBroadcastStream().listen(
-        _onVideoData,
-        onError: _onVideoError,
-      );
-
-      await _methodChannel.invokeMethod('startVideoCapture');
+      _videoBinary = await _useBinaryTransport();
+      if (_videoBinary) {
+        _videoSequence = null;
+        _messenger.setMessageHandler(_videoPacketChannel, _onVideoPacket);
+      } else {
+        // Start listening to video event channel
+        _videoSubscription = _videoEventChannel
+            .receiveBroadcastStream()
+            .listen(_onVideoData, onError: _onVideoError);
+      }
+
+      final result = await _methodChannel.invokeMethod('startVideoCapture');
       _videoCapturing = true;
-      _logger.i('Native video capture started');
+      _logger.i('Native video capture started${_elapsed(result)}');
     } on PlatformException catch (e) {
       _logger.e('Failed to start video capture: ${e.message}');
       rethrow;
@@ -218,6 +272,10 @@ class NativeCaptureChannel {
       await _methodChannel.invokeMethod('stopVideoCapture');
       await _videoSubscription?.cancel();
       _videoSubscription = null;
+      if (_videoBinary) {
+        _messenger.setMessageHandler(_videoPacketChannel, null);
+        _videoBinary = false;
+      }
       _videoCapturing = false;
       _logger.i('Native video capture stopped');
     } on PlatformException catch (e) {
@@ -244,6 +302,74 @@ class NativeCaptureChannel {
     _logger.e('Video stream error: $error');
   }
 
+  // ============ Binary frames ============
+
+  BinaryMessenger get _messenger =>
+      ServicesBinding.instance.defaultBinaryMessenger;
+
+  /// Ask the platform for packed binary frames instead of per-frame maps.
+  /// Platforms without it keep using the event channels.
+  Future<bool> _useBinaryTransport() async {
+    if (_binaryTransport != null) return _binaryTransport!;
+    try {
+      final result = await _methodChannel.invokeMethod('setFrameTransport', {
+        'binary': true,
+      });
+      _binaryTransport = result == true;
+    } on MissingPluginException {
+      _binaryTransport = false;
+    } on PlatformException {
+      _binaryTransport = false;
+    }
+    if (_binaryTransport!) _logger.i('Native capture using binary frames');
+    return _binaryTransport!;
+  }
+
+  Future<ByteData?> _onAudioPacket(ByteData? message) async {
+    final packet = message == null ? null : FramePacket.parse(message);
+    if (packet == null || packet.kind != FramePacket.kindAudio) {
+      _logger.w('Invalid audio packet');
+      return null;
+    }
+    if (_audioSequence != null) {
+      _audioPacketsLost += (packet.sequence - _audioSequence! - 1) & 0xFFFFFFFF;
+    }
+    _audioSequence = packet.sequence;
+    _audioController.add(
+      NativeAudioSamples(
+        data: packet.payload,
+        sampleRate: packet.sampleRate,
+        channels: packet.channels,
+        bitsPerSample: packet.bitsPerSample,
+        timestampMs: packet.timestampMs,
+      ),
+    );
+    return null;
+  }
+
+  Future<ByteData?> _onVideoPacket(ByteData? message) async {
+    final packet = message == null ? null : FramePacket.parse(message);
+    if (packet == null || packet.kind != FramePacket.kindVideo) {
+      _logger.w('Invalid video packet');
+      return null;
+    }
+    if (_videoSequence != null) {
+      _videoPacketsLost += (packet.sequence - _videoSequence! - 1) & 0xFFFFFFFF;
+    }
+    _videoSequence = packet.sequence;
+    _videoController.add(
+      NativeVideoFrame(
+        data: packet.payload,
+        width: packet.width,
+        height: packet.height,
+        format: packet.format,
+        timestampMs: packet.timestampMs,
+        bytesPerRow: packet.stride,
+      ),
+    );
+    return null;
+  }
+
   // ============ Permissions ============
 
   /// Check if camera permission is granted
@@ -294,6 +420,14 @@ class NativeCaptureChannel {
     }
   }
 
+  /// Setup time reported by platforms that open devices off the platform
+  /// thread (Windows)
+  static String _elapsed(Object? result) {
+    if (result is! Map) return '';
+    final elapsedMs = result['elapsedMs'];
+    return elapsedMs is num ? ' in ${elapsedMs.toStringAsFixed(1)}ms' : '';
+  }
+
   /// Dispose resources
   void dispose() {
     stopAudioCapture();
@@ -420,3 +554,41 @@ class NativeCameraInfo {
   String toString() =>
       'NativeCameraInfo(id: $id, name: $name, position: $position)';
 }
+
+/// Device hot-plug event from the platform channel
+class NativeDeviceChange {
+  /// Cameras present after the change
+  final List<NativeCameraInfo> cameras;
+
+  /// IDs of cameras that appeared
+  final List<String> added;
+
+  /// IDs of cameras that went away
+  final List<String> removed;
+
+  /// Whether a microphone is present after the change
+  final bool hasMicrophone;
+
+  NativeDeviceChange({
+    required this.cameras,
+    required this.added,
+    required this.removed,
+    required this.hasMicrophone,
+  });
+
+  factory NativeDeviceChange.fromMap(Map<String, dynamic> map) {
+    return NativeDeviceChange(
+      cameras: (map['cameras'] as List? ?? const [])
+          .map((c) => NativeCameraInfo.fromMap(Map<String, dynamic>.from(c)))
+          .toList(),
+      added: (map['added'] as List? ?? const []).cast<String>(),
+      removed: (map['removed'] as List? ?? const []).cast<String>(),
+      hasMicrophone: map['hasMicrophone'] as bool? ?? false,
+    );
+  }
+
+  @override
+  String toString() =>
+      'NativeDeviceChange(added: $added, removed: $removed, '
+      'cameras: ${cameras.length}, hasMicrophone: $hasMicrophone)';
+}
@@ -5,6 +5,7 @@ import 'dart:typed_data';
 import 'package:logger/logger.dart';
 import 'package:opus_dart/opus_dart.dart' as opus_dart;
 import 'package:opus_flutter/opus_flutter.dart' as opus_flutter;
+import '../../services/native_vad.dart';
 import 'audio_capture.dart';
 import 'audio_encoder.dart';
 
@@ -16,6 +17,7 @@ class NativeOpusEncoder {
   final Logger _logger;
 
   opus_dart.SimpleOpusEncoder? _encoder;
+  NativeVoiceActivityDetector? _vad;
   final _frameController = StreamController<OpusFrame>.broadcast();
   bool _isRunning = false;
 
@@ -37,6 +39,12 @@ class NativeOpusEncoder {
   /// Whether the encoder is running
   bool get isRunning => _isRunning;
 
+  /// Silence suppression counters (null unless [OpusEncoderConfig.dtx])
+  VadStats? get vadStats => _vad?.getStats();
+
+  // OPUS_SET_DTX_REQUEST from opus_defines.h
+  static const int _opusSetDtxRequest = 4016;
+
   /// Initialize the native opus library. Safe to call multiple times.
   /// On Android/iOS/Windows, uses opus_flutter plugin.
   /// On macOS/Linux, loads the system-installed libopus directly.
@@ -106,6 +114,21 @@ class NativeOpusEncoder {
       application: opus_dart.Application.audio,
     );
 
+    if (config.dtx) {
+      _vad = NativeVoiceActivityDetector.create(
+        sampleRate: config.sampleRate,
+        channels: config.channels,
+        hangoverMs: config.vadHangoverMs,
+        comfortNoiseIntervalMs: config.comfortNoiseIntervalMs,
+      );
+      if (_vad == null) {
+        _logger.w('Native VAD unavailable, publishing silence at full rate');
+      } else {
+        // Frames coded during silence shrink to comfort-noise updates
+        _encoder!.encoderCtl(request: _opusSetDtxRequest, value: 1);
+      }
+    }
+
     _isRunning = true;
     _sequenceNumber = 0;
     _currentTimestampMs = 0;
@@ -146,16 +169,24 @@ class NativeOpusEncoder {
       );
 
       try {
+        // Every frame is encoded, sent or not, so the encoder's state stays
+        // continuous when speech resumes
+        final vad = _vad?.process(int16Data);
         final encoded = _encoder!.encode(input: int16Data);
 
-        _frameController.add(
-          OpusFrame(
-            data: encoded,
-            timestampMs: _currentTimestampMs,
-            durationMs: config.frameDurationMs,
-            sequenceNumber: _sequenceNumber++,
-          ),
-        );
+        if (vad == null || vad.decision != VadDecision.suppress) {
+          _frameController.add(
+            OpusFrame(
+              data: encoded,
+              timestampMs: _currentTimestampMs,
+              durationMs: config.frameDurationMs,
+              sequenceNumber: _sequenceNumber++,
+              audioLevel: vad?.level,
+              voiceActivity: vad?.voiceActivity ?? false,
+              isComfortNoise: vad?.decision == VadDecision.comfortNoise,
+            ),
+          );
+        }
 
         _currentTimestampMs += config.frameDurationMs;
       } catch (e) {
@@ -184,6 +215,13 @@ class NativeOpusEncoder {
     _encoder?.destroy();
     _encoder = null;
 
+    final vad = _vad;
+    _vad = null;
+    if (vad != null) {
+      _logger.i('Silence suppression: ${vad.getStats()}');
+      vad.dispose();
+    }
+
     _logger.i('Native Opus encoder stopped');
   }
 
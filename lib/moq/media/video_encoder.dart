@@ -3,6 +3,8 @@ import 'dart:io';
 import 'dart:typed_data';
 import 'package:logger/logger.dart';
 
+import '../../services/native_h264_bitstream.dart';
+
 /// H.264 encoder configuration
 class H264EncoderConfig {
   /// Output width
@@ -122,6 +124,9 @@ class H264Encoder {
   // Output buffer for parsing NAL units
   final _outputBuffer = BytesBuilder();
 
+  // SIMD start-code scanner shared by all encoders; null falls back to Dart
+  static final NativeH264Bitstream? _bitstream = NativeH264Bitstream.create();
+
   // SPS/PPS data for decoder initialization
   Uint8List? _spsData;
   Uint8List? _ppsData;
@@ -260,34 +265,44 @@ class H264Encoder {
     final nalUnits = <Uint8List>[];
     int start = -1;
 
-    for (var i = 0; i < buffer.length - 3; i++) {
-      bool isStartCode = false;
-      int startCodeLen = 0;
-
-      // Check for 4-byte start code
-      if (i + 3 < buffer.length &&
-          buffer[i] == 0x00 &&
-          buffer[i + 1] == 0x00 &&
-          buffer[i + 2] == 0x00 &&
-          buffer[i + 3] == 0x01) {
-        isStartCode = true;
-        startCodeLen = 4;
-      }
-      // Check for 3-byte start code
-      else if (buffer[i] == 0x00 &&
-          buffer[i + 1] == 0x00 &&
-          buffer[i + 2] == 0x01) {
-        isStartCode = true;
-        startCodeLen = 3;
+    final codes = _bitstream?.startCodes(buffer);
+    if (codes != null) {
+      for (final code in codes) {
+        if (start >= 0) {
+          nalUnits.add(Uint8List.sublistView(buffer, start, code.offset));
+        }
+        start = code.offset;
       }
+    } else {
+      for (var i = 0; i < buffer.length - 3; i++) {
+        bool isStartCode = false;
+        int startCodeLen = 0;
+
+        // Check for 4-byte start code
+        if (i + 3 < buffer.length &&
+            buffer[i] == 0x00 &&
+            buffer[i + 1] == 0x00 &&
+            buffer[i + 2] == 0x00 &&
+            buffer[i + 3] == 0x01) {
+          isStartCode = true;
+          startCodeLen = 4;
+        }
+        // Check for 3-byte start code
+        else if (buffer[i] == 0x00 &&
+            buffer[i + 1] == 0x00 &&
+            buffer[i + 2] == 0x01) {
+          isStartCode = true;
+          startCodeLen = 3;
+        }
 
-      if (isStartCode) {
-        if (start >= 0) {
-          // Extract previous NAL unit
-          nalUnits.add(Uint8List.sublistView(buffer, start, i));
+        if (isStartCode) {
+          if (start >= 0) {
+            // Extract previous NAL unit
+            nalUnits.add(Uint8List.sublistView(buffer, start, i));
+          }
+          start = i;
+          i += startCodeLen - 1;
         }
-        start = i;
-        i += startCodeLen - 1;
       }
     }
 
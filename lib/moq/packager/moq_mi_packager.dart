@@ -1,7 +1,10 @@
+import 'dart:typed_data';
 import 'package:fixnum/fixnum.dart';
-import 'package:flutter/foundation.dart';
+import 'package:logger/logger.dart';
 import '../protocol/moq_messages.dart';
 
+final Logger _logger = Logger();
+
 /// MoQ Media Interop (moq-mi) Packager
 ///
 /// Implements draft-cenzano-moq-media-interop-03 for LOC-based
@@ -35,6 +38,19 @@ class MoqMiExtensionHeaders {
   static const int videoH264AvccMetadata = 0x15;
 }
 
+/// LOC Audio Level header extension: RFC 6464 layout, voice activity in the
+/// top bit and the level in -dBov in the low seven bits
+const int locAudioLevelExtension = 0x06;
+
+/// Build a LOC Audio Level extension header
+///
+/// [level] is in -dBov (0 = loudest, 127 = silence).
+KeyValuePair locAudioLevelHeader(int level, {required bool voiceActivity}) =>
+    KeyValuePair.varint(
+      locAudioLevelExtension,
+      (voiceActivity ? 0x80 : 0) | level.clamp(0, 127),
+    );
+
 /// Media Type Values for MOQ_EXT_HEADER_TYPE_MOQMI_MEDIA_TYPE (0x0A)
 enum MoqMiMediaType {
   /// H.264 video in AVCC format (4-byte length prefix NALUs)
@@ -439,7 +455,7 @@ class MoqMiPackager {
     // Debug: log all received extension headers
     final headerInfo = extensionHeaders.map((h) =>
         '0x${h.type.toRadixString(16)}:${h.value?.length ?? 0}b').join(', ');
-    debugPrint('MoqMiPackager: Extension headers: [$headerInfo], payload: ${payload.length}b');
+    _logger.d('MoqMiPackager: Extension headers: [$headerInfo], payload: ${payload.length}b');
 
     MoqMiMediaType? mediaType;
     VideoH264AvccMetadata? videoMetadata;
@@ -455,7 +471,7 @@ class MoqMiPackager {
             final typeValue = header.value![0];
             mediaType = MoqMiMediaType.fromValue(typeValue);
             if (mediaType == null) {
-              debugPrint('MoqMiPackager: Unknown media type value: 0x${typeValue.toRadixString(16)}');
+              _logger.d('MoqMiPackager: Unknown media type value: 0x${typeValue.toRadixString(16)}');
             }
           }
           break;
@@ -464,7 +480,7 @@ class MoqMiPackager {
           try {
             videoMetadata = VideoH264AvccMetadata.fromBytes(header.value!);
           } catch (e) {
-            debugPrint('MoqMiPackager: Failed to parse video metadata: $e');
+            _logger.d('MoqMiPackager: Failed to parse video metadata: $e');
           }
           break;
 
@@ -477,25 +493,25 @@ class MoqMiPackager {
           try {
             audioMetadata = AudioMetadata.fromBytes(header.value!);
           } catch (e) {
-            debugPrint('MoqMiPackager: Failed to parse audio metadata: $e');
+            _logger.d('MoqMiPackager: Failed to parse audio metadata: $e');
           }
           break;
       }
     }
 
     if (mediaType == null) {
-      debugPrint('MoqMiPackager: No media type header (0x0A) found');
+      _logger.d('MoqMiPackager: No media type header (0x0A) found');
       return null;
     }
 
     if (mediaType == MoqMiMediaType.videoH264Avcc) {
       if (videoMetadata == null) {
-        debugPrint('MoqMiPackager: Video media type but missing video metadata header (0x15)');
+        _logger.d('MoqMiPackager: Video media type but missing video metadata header (0x15)');
         return null;
       }
       // Log extradata presence for debugging
       if (avcDecoderConfig != null) {
-        debugPrint('MoqMiPackager: Video has extradata (${avcDecoderConfig.length} bytes)');
+        _logger.d('MoqMiPackager: Video has extradata (${avcDecoderConfig.length} bytes)');
       }
       return MoqMiData(
         mediaType: mediaType,
@@ -514,7 +530,7 @@ class MoqMiPackager {
         mediaType == MoqMiMediaType.audioAacLcMpeg4) {
       if (audioMetadata == null) {
         final expectedHeader = mediaType == MoqMiMediaType.audioOpusBitstream ? '0x0F' : '0x13';
-        debugPrint('MoqMiPackager: Audio media type but missing audio metadata header ($expectedHeader)');
+        _logger.d('MoqMiPackager: Audio media type but missing audio metadata header ($expectedHeader)');
         return null;
       }
       return MoqMiData(
@@ -530,7 +546,7 @@ class MoqMiPackager {
       );
     }
 
-    debugPrint('MoqMiPackager: Unhandled media type: $mediaType');
+    _logger.d('MoqMiPackager: Unhandled media type: $mediaType');
     return null;
   }
 
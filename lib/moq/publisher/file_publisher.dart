@@ -0,0 +1,614 @@
+import 'dart:async';
+import 'dart:math';
+import 'dart:typed_data';
+import 'package:logger/logger.dart';
+import '../client/moq_client.dart';
+import 'cmaf_publisher.dart';
+import 'moq_publisher.dart';
+
+/// Packaging used by [FilePublisher]
+enum FilePackaging { cmaf, loc }
+
+enum FileTrackKind { video, audio, other }
+
+/// A track of a media file
+class FileMediaTrack {
+  final int index;
+  final FileTrackKind kind;
+
+  /// Sample entry type, e.g. `avc1`, `mp4a`, `Opus`
+  final String fourcc;
+  final int width;
+  final int height;
+  final int sampleRate;
+  final int channels;
+
+  /// `avcC` body for H.264, AudioSpecificConfig for AAC, `dOps` for Opus
+  final Uint8List codecConfig;
+  final int sampleCount;
+  final int durationUs;
+
+  const FileMediaTrack({
+    required this.index,
+    required this.kind,
+    required this.fourcc,
+    this.width = 0,
+    this.height = 0,
+    this.sampleRate = 0,
+    this.channels = 0,
+    required this.codecConfig,
+    required this.sampleCount,
+    required this.durationUs,
+  });
+
+  bool get isH264 => fourcc == 'avc1' || fourcc == 'avc3';
+  bool get isAac => fourcc == 'mp4a';
+  bool get isOpus => fourcc == 'Opus';
+
+  /// Codec string for the catalog, e.g. `avc1.64001f` or `mp4a.40.2`
+  String get codec {
+    if (isH264 && codecConfig.length >= 4) {
+      String hex(int b) => b.toRadixString(16).padLeft(2, '0');
+      return 'avc1.${hex(codecConfig[1])}${hex(codecConfig[2])}'
+          '${hex(codecConfig[3])}';
+    }
+    if (isAac && codecConfig.isNotEmpty) {
+      return 'mp4a.40.${codecConfig[0] >> 3}';
+    }
+    if (isOpus) return 'opus';
+    return fourcc;
+  }
+
+  @override
+  String toString() => kind == FileTrackKind.video
+      ? 'FileMediaTrack($index: $codec ${width}x$height, $sampleCount samples)'
+      : 'FileMediaTrack($index: $codec ${sampleRate}Hz ${channels}ch, '
+            '$sampleCount samples)';
+}
+
+/// One sample of a track; [data] is a view of the file, not a copy
+class FileMediaSample {
+  final int dtsUs;
+  final int ptsUs;
+  final bool isKeyframe;
+  final Uint8List data;
+
+  const FileMediaSample({
+    required this.dtsUs,
+    required this.ptsUs,
+    required this.isKeyframe,
+    required this.data,
+  });
+}
+
+/// Demuxed media file (see NativeMp4Source)
+abstract class FileMediaSource {
+  List<FileMediaTrack> get tracks;
+
+  /// Sample [index] of track [track], in decode order
+  FileMediaSample sample(int track, int index);
+}
+
+/// Send-side figures for one reporting interval
+class FilePublisherStats {
+  final Duration elapsed;
+
+  /// Totals since the start
+  final int objects;
+  final int bytes;
+
+  /// Completed passes over the file
+  final int loops;
+
+  /// Rates over the interval
+  final double objectsPerSecond;
+  final double bitsPerSecond;
+
+  /// Time spent handing each object to the transport, over the interval
+  final int sendLatencyP50Us;
+  final int sendLatencyP99Us;
+  final int sendLatencyMaxUs;
+
+  /// Worst delay behind the media clock over the interval; anything above a
+  /// frame interval means the sender cannot keep up with the chosen speed
+  final int maxLatenessUs;
+
+  const FilePublisherStats({
+    required this.elapsed,
+    required this.objects,
+    required this.bytes,
+    required this.loops,
+    required this.objectsPerSecond,
+    required this.bitsPerSecond,
+    required this.sendLatencyP50Us,
+    required this.sendLatencyP99Us,
+    required this.sendLatencyMaxUs,
+    required this.maxLatenessUs,
+  });
+
+  @override
+  String toString() =>
+      'FilePublisherStats(${elapsed.inSeconds}s, $objects objects, '
+      'loops: $loops, ${objectsPerSecond.toStringAsFixed(1)} obj/s, '
+      '${(bitsPerSecond / 1e6).toStringAsFixed(2)} Mbps, send p50 '
+      '${sendLatencyP50Us}us p99 ${sendLatencyP99Us}us max '
+      '${sendLatencyMaxUs}us, late ${maxLatenessUs}us)';
+}
+
+/// Publishes a media file as if it were a live source
+///
+/// Samples from the first H.264 and first audio track are interleaved in
+/// decode order and sent when the wall clock reaches their decode time
+/// divided by [speed] (`speed <= 0` sends as fast as the transport takes
+/// them). With [loop] the file restarts at its end, which with [duration]
+/// makes a soak test of fixed length. Video is converted from AVCC to
+/// Annex-B, as the live encoders produce; audio payloads go out as views of
+/// the file.
+class FilePublisher {
+  final MoQClient _client;
+  final FileMediaSource _source;
+  final FilePackaging packaging;
+  final double speed;
+  final bool loop;
+  final Duration? duration;
+  final Duration reportInterval;
+  final Logger _logger;
+
+  final _statsController = StreamController<FilePublisherStats>.broadcast();
+  bool _stopped = false;
+
+  CmafPublisher? _cmaf;
+  MoQPublisher? _loc;
+  FileMediaTrack? _video;
+  FileMediaTrack? _audio;
+  _AvcConfig? _avc;
+
+  FilePublisher({
+    required MoQClient client,
+    required FileMediaSource source,
+    this.packaging = FilePackaging.cmaf,
+    this.speed = 1.0,
+    this.loop = false,
+    this.duration,
+    this.reportInterval = const Duration(seconds: 10),
+    Logger? logger,
+  }) : _client = client,
+       _source = source,
+       _logger = logger ?? Logger();
+
+  /// Figures every [reportInterval], and once more when publishing ends
+  Stream<FilePublisherStats> get stats => _statsController.stream;
+
+  String get videoTrackName =>
+      packaging == FilePackaging.cmaf ? '1.m4s' : 'video';
+  String get audioTrackName =>
+      packaging == FilePackaging.cmaf ? '2.m4s' : 'audio';
+
+  /// Announce [namespace] and publish until the file ends, [duration]
+  /// passes or [stop] is called
+  ///
+  /// Returns the figures for the whole run.
+  Future<FilePublisherStats> run(List<String> namespace) async {
+    _pickTracks();
+    await _setUpTracks(namespace);
+    try {
+      return await _publishLoop();
+    } finally {
+      await _cmaf?.stop(reason: 'File publisher finished');
+      await _loc?.stop(reason: 'File publisher finished');
+      await _statsController.close();
+    }
+  }
+
+  /// Stop after the object being sent
+  void stop() => _stopped = true;
+
+  void _pickTracks() {
+    for (final track in _source.tracks) {
+      if (track.sampleCount == 0) continue;
+      if (track.kind == FileTrackKind.video && _video == null) {
+        if (track.isH264) {
+          _video = track;
+        } else {
+          _logger.w('Skipping ${track.codec} video track: only H.264 is sent');
+        }
+      } else if (track.kind == FileTrackKind.audio && _audio == null) {
+        if (packaging == FilePackaging.cmaf && !track.isOpus) {
+          // CmafPublisher only muxes Opus audio
+          _logger.w('Skipping ${track.codec} audio track: CMAF carries Opus');
+        } else if (track.isAac || track.isOpus) {
+          _audio = track;
+        } else {
+          _logger.w('Skipping ${track.codec} audio track');
+        }
+      }
+    }
+    if (_video == null && _audio == null) {
+      throw StateError('No H.264, AAC or Opus track to publish');
+    }
+    if (_video != null) {
+      _avc = _AvcConfig.parse(_video!.codecConfig);
+      if (_avc == null) {
+        throw StateError('Video track has no usable avcC');
+      }
+    }
+  }
+
+  Future<void> _setUpTracks(List<String> namespace) async {
+    final video = _video;
+    final audio = _audio;
+    final frameRate = video == null || video.durationUs <= 0
+        ? 30
+        : (video.sampleCount * 1e6 / video.durationUs).round();
+
+    switch (packaging) {
+      case FilePackaging.cmaf:
+        final cmaf = _cmaf = CmafPublisher(client: _client, logger: _logger);
+        if (video != null) {
+          cmaf.configureVideoTrack(
+            videoTrackName,
+            width: video.width,
+            height: video.height,
+            frameRate: frameRate,
+            codec: video.codec,
+          );
+        }
+        if (audio != null) {
+          cmaf.configureAudioTrack(
+            audioTrackName,
+            sampleRate: audio.sampleRate,
+            channels: audio.channels,
+            priority: 200,
+            codec: audio.codec,
+          );
+        }
+        await cmaf.announce(namespace, initTrackName: '0.mp4');
+        if (audio != null) {
+          await cmaf.addAudioTrack(
+            audioTrackName,
+            sampleRate: audio.sampleRate,
+            channels: audio.channels,
+            priority: 200,
+          );
+        }
+        if (video != null) {
+          await cmaf.addVideoTrack(
+            videoTrackName,
+            width: video.width,
+            height: video.height,
+            frameRate: frameRate,
+          );
+          await cmaf.setVideoCodecConfig(
+            videoTrackName,
+            sps: _avc!.sps.first,
+            pps: _avc!.pps.first,
+          );
+        }
+        if (audio != null) await cmaf.setAudioReady(audioTrackName);
+
+      case FilePackaging.loc:
+        final loc = _loc = MoQPublisher(client: _client, logger: _logger);
+        await loc.announce(namespace);
+        if (video != null) {
+          await loc.addVideoTrack(
+            videoTrackName,
+            codec: video.codec,
+            width: video.width,
+            height: video.height,
+            framerate: frameRate,
+          );
+          await loc.setTrackInitData(videoTrackName, video.codecConfig);
+        }
+        if (audio != null) {
+          await loc.addAudioTrack(
+            audioTrackName,
+            priority: 200,
+            codec: audio.codec,
+            samplerate: audio.sampleRate,
+            channelConfig: audio.channels == 1 ? 'mono' : 'stereo',
+          );
+        }
+    }
+  }
+
+  Future<FilePublisherStats> _publishLoop() async {
+    final tracks = [if (_video != null) _video!, if (_audio != null) _audio!];
+    final indices = List.filled(tracks.length, 0);
+    final next = [
+      for (final track in tracks) _source.sample(track.index, 0),
+    ];
+    final lastDurationUs = List.filled(tracks.length, 0);
+
+    final firstDtsUs = next.map((s) => s.dtsUs).reduce(min);
+    final loopDurationUs = _loopDuration(tracks, firstDtsUs);
+    var loopOffsetUs = 0;
+    var loops = 0;
+
+    final clock = Stopwatch()..start();
+    final interval = _LatencyHistogram();
+    final total = _LatencyHistogram();
+    var objects = 0;
+    var bytes = 0;
+    var intervalObjects = 0;
+    var intervalBytes = 0;
+    var intervalLateness = 0;
+    var runLateness = 0;
+    var intervalStartUs = 0;
+
+    FilePublisherStats report(
+      _LatencyHistogram latency,
+      int periodUs,
+      int periodObjects,
+      int periodBytes,
+      int lateness,
+    ) {
+      final seconds = max(periodUs, 1) / 1e6;
+      return FilePublisherStats(
+        elapsed: clock.elapsed,
+        objects: objects,
+        bytes: bytes,
+        loops: loops,
+        objectsPerSecond: periodObjects / seconds,
+        bitsPerSecond: periodBytes * 8 / seconds,
+        sendLatencyP50Us: latency.percentile(0.5),
+        sendLatencyP99Us: latency.percentile(0.99),
+        sendLatencyMaxUs: latency.max,
+        maxLatenessUs: lateness,
+      );
+    }
+
+    while (!_stopped) {
+      // Track whose next sample decodes first
+      var t = -1;
+      for (var i = 0; i < tracks.length; i++) {
+        if (indices[i] >= tracks[i].sampleCount) continue;
+        if (t < 0 || next[i].dtsUs < next[t].dtsUs) t = i;
+      }
+      if (t < 0) {
+        if (!loop) break;
+        loops++;
+        loopOffsetUs += loopDurationUs;
+        for (var i = 0; i < tracks.length; i++) {
+          indices[i] = 0;
+          next[i] = _source.sample(tracks[i].index, 0);
+        }
+        continue;
+      }
+
+      final sample = next[t];
+      final index = ++indices[t];
+      if (index < tracks[t].sampleCount) {
+        next[t] = _source.sample(tracks[t].index, index);
+        lastDurationUs[t] = next[t].dtsUs - sample.dtsUs;
+      }
+
+      final mediaUs = sample.dtsUs - firstDtsUs + loopOffsetUs;
+      if (speed > 0) {
+        final waitUs = (mediaUs / speed).round() - clock.elapsedMicroseconds;
+        if (waitUs > 0) {
+          await Future.delayed(Duration(microseconds: waitUs));
+        } else {
+          intervalLateness = max(intervalLateness, -waitUs);
+        }
+      }
+      if (duration != null && clock.elapsed >= duration!) break;
+
+      final sendStartUs = clock.elapsedMicroseconds;
+      final sent = tracks[t] == _video
+          ? await _publishVideo(sample, lastDurationUs[t])
+          : await _publishAudio(sample);
+      final latencyUs = clock.elapsedMicroseconds - sendStartUs;
+      interval.record(latencyUs);
+      total.record(latencyUs);
+      objects++;
+      bytes += sent;
+      intervalObjects++;
+      intervalBytes += sent;
+
+      final nowUs = clock.elapsedMicroseconds;
+      if (nowUs - intervalStartUs >= reportInterval.inMicroseconds) {
+        final stats = report(
+          interval,
+          nowUs - intervalStartUs,
+          intervalObjects,
+          intervalBytes,
+          intervalLateness,
+        );
+        _logger.d(stats.toString());
+        _statsController.add(stats);
+        runLateness = max(runLateness, intervalLateness);
+        interval.clear();
+        intervalObjects = 0;
+        intervalBytes = 0;
+        intervalLateness = 0;
+        intervalStartUs = nowUs;
+      }
+    }
+
+    runLateness = max(runLateness, intervalLateness);
+    final summary = report(
+      total,
+      clock.elapsedMicroseconds,
+      objects,
+      bytes,
+      runLateness,
+    );
+    _logger.i('File publisher done: $summary');
+    _statsController.add(summary);
+    return summary;
+  }
+
+  /// Length of one pass over the file, so looped timestamps keep advancing
+  int _loopDuration(List<FileMediaTrack> tracks, int firstDtsUs) {
+    var end = 0;
+    for (final track in tracks) {
+      final count = track.sampleCount;
+      final last = _source.sample(track.index, count - 1).dtsUs;
+      final step = count > 1
+          ? last - _source.sample(track.index, count - 2).dtsUs
+          : 0;
+      end = max(end, last + step - firstDtsUs);
+    }
+    return max(end, 1);
+  }
+
+  /// Returns the payload size sent
+  Future<int> _publishVideo(FileMediaSample sample, int durationUs) async {
+    // For LOC the parameter sets go in-band on keyframes, as the live
+    // encoders send them, so subscribers can join at any group; the CMAF
+    // init segment carries them instead
+    final frame = _avc!.toAnnexB(
+      sample.data,
+      parameterSets: packaging == FilePackaging.loc && sample.isKeyframe,
+    );
+    switch (packaging) {
+      case FilePackaging.cmaf:
+        await _cmaf!.publishVideoFrame(
+          videoTrackName,
+          frame,
+          isKeyframe: sample.isKeyframe,
+          durationMs: durationUs > 0 ? (durationUs / 1000).round() : null,
+        );
+      case FilePackaging.loc:
+        await _loc!.publishFrame(
+          videoTrackName,
+          frame,
+          newGroup: sample.isKeyframe,
+        );
+    }
+    return frame.length;
+  }
+
+  Future<int> _publishAudio(FileMediaSample sample) async {
+    switch (packaging) {
+      case FilePackaging.cmaf:
+        await _cmaf!.publishAudioFrame(audioTrackName, sample.data);
+      case FilePackaging.loc:
+        await _loc!.publishFrame(audioTrackName, sample.data, newGroup: true);
+    }
+    return sample.data.length;
+  }
+}
+
+/// H.264 decoder configuration record (`avcC`)
+class _AvcConfig {
+  static final _startCode = Uint8List.fromList([0, 0, 0, 1]);
+
+  final int lengthSize;
+  final List<Uint8List> sps;
+  final List<Uint8List> pps;
+
+  _AvcConfig(this.lengthSize, this.sps, this.pps);
+
+  static _AvcConfig? parse(Uint8List avcC) {
+    if (avcC.length < 7) return null;
+    var pos = 6;
+    List<Uint8List>? sets(int count) {
+      final out = <Uint8List>[];
+      for (var i = 0; i < count; i++) {
+        if (pos + 2 > avcC.length) return null;
+        final len = (avcC[pos] << 8) | avcC[pos + 1];
+        pos += 2;
+        if (pos + len > avcC.length) return null;
+        out.add(Uint8List.sublistView(avcC, pos, pos + len));
+        pos += len;
+      }
+      return out;
+    }
+
+    final sps = sets(avcC[5] & 0x1F);
+    if (sps == null || pos >= avcC.length) return null;
+    final pps = sets(avcC[pos++]);
+    if (pps == null || sps.isEmpty || pps.isEmpty) return null;
+    return _AvcConfig((avcC[4] & 0x03) + 1, sps, pps);
+  }
+
+  /// Copy a length-prefixed sample to a new Annex-B buffer, optionally led
+  /// by the SPS and PPS
+  Uint8List toAnnexB(Uint8List sample, {bool parameterSets = false}) {
+    final nals = <(int, int)>[];
+    var size = 0;
+    if (parameterSets) {
+      for (final set in [...sps, ...pps]) {
+        size += 4 + set.length;
+      }
+    }
+    var pos = 0;
+    while (pos + lengthSize <= sample.length) {
+      var len = 0;
+      for (var i = 0; i < lengthSize; i++) {
+        len = (len << 8) | sample[pos + i];
+      }
+      pos += lengthSize;
+      if (len > sample.length - pos) break;
+      nals.add((pos, len));
+      size += 4 + len;
+      pos += len;
+    }
+
+    final out = Uint8List(size);
+    var at = 0;
+    void put(Uint8List data, int start, int len) {
+      out.setAll(at, _startCode);
+      out.setRange(at + 4, at + 4 + len, data, start);
+      at += 4 + len;
+    }
+
+    if (parameterSets) {
+      for (final set in [...sps, ...pps]) {
+        put(set, 0, set.length);
+      }
+    }
+    for (final (start, len) in nals) {
+      put(sample, start, len);
+    }
+    return out;
+  }
+}
+
+/// Log-scale latency histogram (about 12% resolution) so percentiles over a
+/// 24-hour run take constant memory
+class _LatencyHistogram {
+  static const int _subBits = 3;
+  final _counts = List.filled(64 << _subBits, 0);
+  int _count = 0;
+  int max = 0;
+
+  static int _bucket(int value) {
+    if (value < (1 << _subBits)) return value;
+    final exponent = value.bitLength - 1 - _subBits;
+    final mantissa = (value >> exponent) & ((1 << _subBits) - 1);
+    return ((exponent + 1) << _subBits) + mantissa;
+  }
+
+  static int _upperBound(int bucket) {
+    if (bucket < (1 << _subBits)) return bucket;
+    final exponent = (bucket >> _subBits) - 1;
+    final mantissa = (bucket & ((1 << _subBits) - 1)) | (1 << _subBits);
+    return ((mantissa + 1) << exponent) - 1;
+  }
+
+  void record(int value) {
+    if (value < 0) value = 0;
+    _counts[_bucket(value)]++;
+    _count++;
+    if (value > max) max = value;
+  }
+
+  int percentile(double p) {
+    if (_count == 0) return 0;
+    final rank = (p * _count).ceil().clamp(1, _count);
+    var seen = 0;
+    for (var i = 0; i < _counts.length; i++) {
+      seen += _counts[i];
+      if (seen >= rank) return _upperBound(i) < max ? _upperBound(i) : max;
+    }
+    return max;
+  }
+
+  void clear() {
+    _counts.fillRange(0, _counts.length, 0);
+    _count = 0;
+    max = 0;
+  }
+}
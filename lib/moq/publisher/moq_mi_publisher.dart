@@ -4,6 +4,7 @@ import 'package:logger/logger.dart';
 import '../client/moq_client.dart';
 import '../packager/moq_mi_packager.dart';
 import '../protocol/moq_messages.dart';
+import '../../services/native_publish_pipeline.dart';
 
 /// MoQ Media Interop Publisher
 ///
@@ -33,6 +34,9 @@ class MoqMiPublisher {
   Int64 _videoObjectId = Int64.ZERO;
   bool _waitingForKeyframe = true;
 
+  // Publishes the video track natively instead of publishVideoFrame
+  NativePublishPipeline? _nativeVideo;
+
   // Audio stream state (group per frame in moq-mi)
   Int64 _audioGroupId = Int64.ZERO;
 
@@ -97,6 +101,80 @@ class MoqMiPublisher {
   /// Get audio track name
   String get audioTrackName => moqMiGetTrackName(_trackPrefix ?? '', true);
 
+  /// Encrypt video and audio payloads end to end
+  ///
+  /// Requires [MoQClient.objectEncryption] and a prior [announce]. Each track
+  /// needs its own key ID, installed for that track's full name with a base
+  /// key fresh to this session; the moq-mi extension headers stay in the
+  /// clear. Throws [ArgumentError] if a key ID is already in use by another
+  /// track.
+  void encryptTracks({required int videoKeyId, required int audioKeyId}) {
+    final encryption = _client.objectEncryption;
+    if (encryption == null) {
+      throw StateError('Client has no object encryption configured');
+    }
+    if (!_isAnnounced) {
+      throw StateError('Must announce namespace before encrypting tracks');
+    }
+    if (videoKeyId == audioKeyId) {
+      throw ArgumentError('Video and audio need separate key IDs');
+    }
+    if (_nativeVideo != null) {
+      throw StateError('Video is published natively and cannot be encrypted');
+    }
+    encryption.protectOutgoing(_videoTrackAlias!, videoKeyId);
+    encryption.protectOutgoing(_audioTrackAlias!, audioKeyId);
+  }
+
+  /// The native pipeline publishing video, if [startNativeVideo] was called
+  NativePublishPipeline? get nativeVideo => _nativeVideo;
+
+  /// Hand the video track to a native publish pipeline
+  ///
+  /// Capture, encoding, packaging and sending then run natively; feed it with
+  /// [NativePublishPipeline.attachScreenCapture] or
+  /// [NativePublishPipeline.pushFrame] instead of [publishVideoFrame]. Returns
+  /// null if native publishing is not available, or if the video track is
+  /// encrypted (the native pipeline sends without sealing), in which case the
+  /// Dart path keeps working.
+  NativePublishPipeline? startNativeVideo({
+    required int width,
+    required int height,
+    int frameRate = 30,
+    int bitrate = 2000000,
+    int gopSize = 30,
+  }) {
+    if (!_isAnnounced) {
+      throw StateError('Must announce namespace before publishing');
+    }
+    if (_nativeVideo != null) return _nativeVideo;
+    if (_client.objectEncryption?.keyIdFor(_videoTrackAlias!) != null) {
+      _logger.w('Video track is encrypted; keeping the Dart publish path');
+      return null;
+    }
+
+    final pipeline = NativePublishPipeline.create(
+      _client.transport,
+      trackAlias: _videoTrackAlias!.toInt(),
+      priority: _videoPriority,
+      version: _client.selectedVersion,
+    );
+    if (pipeline == null) return null;
+    if (!pipeline.start(
+      width: width,
+      height: height,
+      frameRate: frameRate,
+      bitrate: bitrate,
+      gopSize: gopSize,
+    )) {
+      pipeline.dispose();
+      return null;
+    }
+    _nativeVideo = pipeline;
+    _logger.i('Publishing video natively: ${width}x$height @ $frameRate fps');
+    return pipeline;
+  }
+
   /// Publish a video frame (H.264 AVCC format)
   ///
   /// [payload]: H.264 AVCC payload (4-byte length prefix NALUs)
@@ -118,6 +196,9 @@ class MoqMiPublisher {
     if (!_isAnnounced) {
       throw StateError('Must announce namespace before publishing');
     }
+    if (_nativeVideo != null) {
+      throw StateError('Video is published by the native pipeline');
+    }
 
     final actualDts = dts ?? pts;
     final actualTimebase = timebase ?? Int64(1000000); // microseconds
@@ -216,6 +297,9 @@ class MoqMiPublisher {
   /// [numChannels]: Number of audio channels
   /// [duration]: Frame duration in microseconds
   /// [timebase]: Timebase (default: 1000000 for microseconds)
+  /// [audioLevel]: RFC 6464 level in -dBov, sent as the LOC audio level
+  /// extension so subscribers can pick active speakers without decoding
+  /// [voiceActivity]: Whether the frame contains speech
   Future<void> publishOpusFrame({
     required Uint8List payload,
     required Int64 pts,
@@ -223,6 +307,8 @@ class MoqMiPublisher {
     required int numChannels,
     Int64? duration,
     Int64? timebase,
+    int? audioLevel,
+    bool voiceActivity = false,
   }) async {
     if (!_isAnnounced) {
       throw StateError('Must announce namespace before publishing');
@@ -243,6 +329,11 @@ class MoqMiPublisher {
       numChannels: numChannels,
       duration: actualDuration,
     );
+    if (audioLevel != null) {
+      extensionHeaders.add(
+        locAudioLevelHeader(audioLevel, voiceActivity: voiceActivity),
+      );
+    }
 
     // Open stream, write header, object, close - one group per frame
     final streamId = await _client.openDataStream();
@@ -256,11 +347,12 @@ class MoqMiPublisher {
       extensionHeaders: extensionHeaders,
     );
 
-    await _client.writeObject(
+    await _client.writeObjectWithExtensions(
       streamId,
       objectId: Int64.ZERO,
       payload: payload,
       status: ObjectStatus.normal,
+      extensionHeaders: extensionHeaders,
     );
 
     await _client.finishDataStream(streamId);
@@ -330,6 +422,10 @@ class MoqMiPublisher {
 
   /// Stop publishing
   Future<void> stop({String reason = 'Publisher stopped'}) async {
+    // Flushes the encoder and finishes the native video stream
+    _nativeVideo?.dispose();
+    _nativeVideo = null;
+
     // Close video stream if active
     if (_videoStreamId != null) {
       try {
@@ -1,4 +1,5 @@
 import 'dart:async';
+import 'dart:convert';
 import 'dart:math';
 import 'dart:typed_data';
 import 'package:fixnum/fixnum.dart';
@@ -191,6 +192,24 @@ class MoQPublisher {
     return alias;
   }
 
+  /// Encrypt a track's object payloads end to end with [keyId]
+  ///
+  /// Requires [MoQClient.objectEncryption]; the catalog stays in the clear.
+  /// [keyId] must be installed for this track's full name with a base key
+  /// fresh to this session, and not protect any other track (throws
+  /// [ArgumentError]).
+  void encryptTrack(String trackName, int keyId) {
+    final encryption = _client.objectEncryption;
+    if (encryption == null) {
+      throw StateError('Client has no object encryption configured');
+    }
+    final track = _tracks[trackName];
+    if (track == null) {
+      throw ArgumentError('Track not found: $trackName');
+    }
+    encryption.protectOutgoing(track.alias, keyId);
+  }
+
   /// Add a video track with codec/resolution info
   ///
   /// Returns the track alias assigned to this track.
@@ -235,6 +254,24 @@ class MoQPublisher {
     return alias;
   }
 
+  /// Advertise a track's decoder configuration in the catalog
+  ///
+  /// For LOC video this is the AVC decoder configuration record, which lets
+  /// subscribers set up their decoder before the first keyframe arrives. The
+  /// catalog is republished only when the data changes.
+  Future<void> setTrackInitData(String trackName, Uint8List initData) async {
+    final index = _catalogTracks.indexWhere((track) => track.name == trackName);
+    if (index < 0) {
+      throw StateError('Track $trackName is not in the catalog');
+    }
+
+    final encoded = base64.encode(initData);
+    if (_catalogTracks[index].initData == encoded) return;
+
+    _catalogTracks[index] = _catalogTracks[index].copyWith(initData: encoded);
+    await updateCatalog();
+  }
+
   /// Add an audio track with codec/sample rate info
   ///
   /// Returns the track alias assigned to this track.
@@ -277,6 +314,47 @@ class MoQPublisher {
     return alias;
   }
 
+  /// Add a thumbnail track previewing [videoTrackName]
+  ///
+  /// Each thumbnail is a standalone JPEG in its own group, so a subscriber
+  /// starting at the latest group gets a picture immediately. The track is
+  /// listed with role 'thumbnail' and depends on the video track; players
+  /// ignore it and preview grids subscribe to it instead of the video.
+  Future<Int64> addThumbnailTrack(
+    String trackName, {
+    required String videoTrackName,
+    int priority = 220,
+    int? width,
+    int? height,
+    bool updateCatalogNow = true,
+  }) async {
+    final alias = addTrack(trackName, priority: priority);
+
+    _catalogTracks.add(
+      CatalogTrack(
+        name: trackName,
+        namespace: _namespaceStr,
+        packaging: 'loc',
+        isLive: true,
+        role: MoQCatalog.thumbnailRole,
+        parentName: videoTrackName,
+        depends: [videoTrackName],
+        selectionParams: SelectionParams(
+          codec: 'jpeg',
+          mimeType: 'image/jpeg',
+          width: width,
+          height: height,
+        ),
+      ),
+    );
+
+    if (updateCatalogNow) {
+      await updateCatalog();
+    }
+
+    return alias;
+  }
+
   /// Start a new group for a track
   ///
   /// Returns the group ID.
@@ -298,7 +376,13 @@ class MoQPublisher {
   /// Open a subgroup stream for publishing
   ///
   /// Returns the stream ID.
-  Future<int> openSubgroup(String trackName, {Int64? subgroupId}) async {
+  ///
+  /// Pass [extensionHeaders] when objects on this subgroup carry extensions.
+  Future<int> openSubgroup(
+    String trackName, {
+    Int64? subgroupId,
+    List<KeyValuePair> extensionHeaders = const [],
+  }) async {
     final track = _tracks[trackName];
     if (track == null) {
       throw ArgumentError('Track not found: $trackName');
@@ -308,13 +392,24 @@ class MoQPublisher {
     final subgroup = subgroupId ?? Int64(0);
 
     // Write subgroup header
-    await _client.writeSubgroupHeader(
-      streamId,
-      trackAlias: track.alias,
-      groupId: track.currentGroupId,
-      subgroupId: subgroup,
-      publisherPriority: track.priority,
-    );
+    if (extensionHeaders.isEmpty) {
+      await _client.writeSubgroupHeader(
+        streamId,
+        trackAlias: track.alias,
+        groupId: track.currentGroupId,
+        subgroupId: subgroup,
+        publisherPriority: track.priority,
+      );
+    } else {
+      await _client.writeSubgroupHeaderWithExtensions(
+        streamId,
+        trackAlias: track.alias,
+        groupId: track.currentGroupId,
+        subgroupId: subgroup,
+        publisherPriority: track.priority,
+        extensionHeaders: extensionHeaders,
+      );
+    }
 
     _activeStreams[streamId] = track;
     _logger.d(
@@ -331,6 +426,7 @@ class MoQPublisher {
     int streamId,
     Uint8List payload, {
     ObjectStatus status = ObjectStatus.normal,
+    List<KeyValuePair> extensionHeaders = const [],
   }) async {
     final track = _activeStreams[streamId];
     if (track == null) {
@@ -340,12 +436,22 @@ class MoQPublisher {
     final objectId = track.currentObjectId;
     track.currentObjectId += Int64(1);
 
-    await _client.writeObject(
-      streamId,
-      objectId: objectId,
-      payload: payload,
-      status: status,
-    );
+    if (extensionHeaders.isEmpty) {
+      await _client.writeObject(
+        streamId,
+        objectId: objectId,
+        payload: payload,
+        status: status,
+      );
+    } else {
+      await _client.writeObjectWithExtensions(
+        streamId,
+        objectId: objectId,
+        payload: payload,
+        status: status,
+        extensionHeaders: extensionHeaders,
+      );
+    }
 
     _logger.d(
       'Published object $objectId (${payload.length} bytes) to stream $streamId',
@@ -358,11 +464,13 @@ class MoQPublisher {
   ///
   /// Handles group/subgroup management automatically.
   /// Set `newGroup` to true to start a new group (e.g., for keyframes).
+  /// [extensionHeaders] are attached to the object (e.g. the LOC audio level).
   Future<Int64> publishFrame(
     String trackName,
     Uint8List frameData, {
     bool newGroup = false,
     bool isEndOfGroup = false,
+    List<KeyValuePair> extensionHeaders = const [],
   }) async {
     final track = _tracks[trackName];
     if (track == null) {
@@ -375,9 +483,17 @@ class MoQPublisher {
       startGroup(trackName);
     }
 
-    final streamId = await openSubgroup(trackName);
+    final streamId = await openSubgroup(
+      trackName,
+      extensionHeaders: extensionHeaders,
+    );
     final status = isEndOfGroup ? ObjectStatus.endOfGroup : ObjectStatus.normal;
-    final objectId = await publishObject(streamId, frameData, status: status);
+    final objectId = await publishObject(
+      streamId,
+      frameData,
+      status: status,
+      extensionHeaders: extensionHeaders,
+    );
     final now = DateTime.now().millisecondsSinceEpoch;
     await _publishMediaTimelineEntry(
       trackName,
@@ -0,0 +1,178 @@
+import 'dart:async';
+import 'dart:typed_data';
+import 'package:logger/logger.dart';
+import '../../services/native_thumbnail_encoder.dart';
+import 'moq_publisher.dart';
+
+/// Thumbnail track settings
+class ThumbnailTrackConfig {
+  /// Thumbnails fit within this box, keeping the capture's aspect ratio
+  final int maxWidth;
+  final int maxHeight;
+
+  /// JPEG quality, 1-100
+  final int quality;
+
+  /// Time between thumbnails
+  final Duration interval;
+
+  /// Also take a thumbnail at every video keyframe (still at most one per
+  /// [minKeyframeInterval])
+  final bool onKeyframe;
+  final Duration minKeyframeInterval;
+
+  const ThumbnailTrackConfig({
+    this.maxWidth = 160,
+    this.maxHeight = 90,
+    this.quality = 70,
+    this.interval = const Duration(seconds: 2),
+    this.onKeyframe = false,
+    this.minKeyframeInterval = const Duration(milliseconds: 500),
+  });
+}
+
+/// Decides which capture frames become thumbnails
+class ThumbnailSchedule {
+  final ThumbnailTrackConfig config;
+  int? _lastCaptureMs;
+  bool _keyframePending = false;
+
+  ThumbnailSchedule(this.config);
+
+  /// Note that the encoder produced a keyframe
+  void keyframe() {
+    if (config.onKeyframe) _keyframePending = true;
+  }
+
+  /// Whether the capture frame at [timestampMs] should be thumbnailed
+  bool shouldCapture(int timestampMs) {
+    final last = _lastCaptureMs;
+    final elapsed = last == null ? null : timestampMs - last;
+    // A backwards clock (capture restart) counts as due
+    final due =
+        elapsed == null ||
+        elapsed < 0 ||
+        elapsed >= config.interval.inMilliseconds ||
+        (_keyframePending &&
+            elapsed >= config.minKeyframeInterval.inMilliseconds);
+    if (due) {
+      _lastCaptureMs = timestampMs;
+      _keyframePending = false;
+    }
+    return due;
+  }
+}
+
+/// Publishes a low-rate JPEG preview track next to a LOC video track
+///
+/// Capture frames are offered with [addFrame]; the few that are due are
+/// scaled and encoded natively off the capture thread and published one
+/// JPEG per group.
+class ThumbnailTrackPublisher {
+  final MoQPublisher _publisher;
+  final NativeThumbnailEncoder _encoder;
+  final ThumbnailSchedule _schedule;
+  final Logger _logger;
+  final String trackName;
+  Timer? _pollTimer;
+  bool _publishing = false;
+  int _published = 0;
+
+  ThumbnailTrackPublisher._(
+    this._publisher,
+    this._encoder,
+    this._schedule,
+    this.trackName,
+    this._logger,
+  );
+
+  /// Add the thumbnail track for [videoTrackName] to [publisher]'s catalog
+  ///
+  /// Returns null if the native encoder is not available.
+  static Future<ThumbnailTrackPublisher?> create(
+    MoQPublisher publisher, {
+    required String videoTrackName,
+    String? trackName,
+    int? captureWidth,
+    int? captureHeight,
+    ThumbnailTrackConfig config = const ThumbnailTrackConfig(),
+    Logger? logger,
+  }) async {
+    final encoder = NativeThumbnailEncoder.create(
+      maxWidth: config.maxWidth,
+      maxHeight: config.maxHeight,
+      quality: config.quality,
+    );
+    if (encoder == null) return null;
+
+    final name = trackName ?? '$videoTrackName.thumbnail';
+    final (width, height) = captureWidth != null && captureHeight != null
+        ? _fit(captureWidth, captureHeight, config.maxWidth, config.maxHeight)
+        : (null, null);
+    await publisher.addThumbnailTrack(
+      name,
+      videoTrackName: videoTrackName,
+      width: width,
+      height: height,
+    );
+
+    final thumbnails = ThumbnailTrackPublisher._(
+      publisher,
+      encoder,
+      ThumbnailSchedule(config),
+      name,
+      logger ?? Logger(),
+    );
+    thumbnails._pollTimer = Timer.periodic(
+      const Duration(milliseconds: 50),
+      (_) => thumbnails._poll(),
+    );
+    return thumbnails;
+  }
+
+  /// Thumbnails published so far
+  int get publishedCount => _published;
+
+  ThumbnailEncoderStats? get stats => _encoder.getStats();
+
+  /// Note a video keyframe (used when [ThumbnailTrackConfig.onKeyframe])
+  void keyframe() => _schedule.keyframe();
+
+  /// Offer a capture frame; only frames that are due get copied and encoded
+  void addFrame(Uint8List i420, int width, int height, int timestampMs) {
+    if (!_schedule.shouldCapture(timestampMs)) return;
+    _encoder.push(i420, width, height, timestampMs);
+  }
+
+  Future<void> _poll() async {
+    if (_publishing) return;
+    final thumbnail = _encoder.pull();
+    if (thumbnail == null) return;
+
+    _publishing = true;
+    try {
+      await _publisher.publishFrame(trackName, thumbnail.jpeg, newGroup: true);
+      _published++;
+    } catch (e) {
+      _logger.w('Error publishing thumbnail: $e');
+    } finally {
+      _publishing = false;
+    }
+  }
+
+  void dispose() {
+    _pollTimer?.cancel();
+    _pollTimer = null;
+    _encoder.dispose();
+  }
+
+  // Mirrors fit_size in thumbnail.rs, so the catalog matches the JPEGs
+  static (int, int) _fit(int width, int height, int maxWidth, int maxHeight) {
+    if (maxWidth > width) maxWidth = width;
+    if (maxHeight > height) maxHeight = height;
+    final (w, h) = width * maxHeight > height * maxWidth
+        ? (maxWidth, (height * maxWidth + width ~/ 2) ~/ width)
+        : ((width * maxHeight + height ~/ 2) ~/ height, maxHeight);
+    return ((w & ~1) < 2 ? 2 : w & ~1, (h & ~1) < 2 ? 2 : h & ~1);
+  }
+}
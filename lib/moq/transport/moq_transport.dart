@@ -71,9 +71,64 @@ abstract class MoQTransport {
   /// Get the underlying transport statistics
   MoQTransportStats get stats;
 
+  /// Bandwidth estimate for a subscribed track, measured natively from the
+  /// arrival of its subgroup stream data.
+  /// Returns null if nothing has been received for [trackAlias].
+  BandwidthEstimate? bandwidthEstimate(int trackAlias);
+
+  /// Play a subscribed track through a native playback sink (see
+  /// NativePlaybackSink): subgroup streams of [trackAlias] that start from now
+  /// on are deframed and written to the player natively and no longer appear
+  /// on [incomingDataStreams]. [track] is 0 for video and 1 for audio,
+  /// [version] the negotiated MoQ version.
+  /// A sink routed to a track that is already routed joins the sinks on it.
+  /// With [replayCacheBytes] the track keeps its newest group, up to that
+  /// many bytes, so such a sink starts at the group's keyframe at once.
+  /// Returns false if native routing is not available.
+  bool routeTrackToNative(
+    int trackAlias,
+    int sinkId, {
+    required int track,
+    required int version,
+    int replayCacheBytes = 0,
+  });
+
+  /// Feed a subscribed track into a native redundant track (see
+  /// NativeRedundantTrack) as one of its paths: like [routeTrackToNative],
+  /// but only the first copy of each object across all paths is played.
+  /// Returns the path index, or null if native routing is not available or
+  /// the redundant track has no free path.
+  int? routeTrackToRedundant(int trackAlias, int redundantId);
+
+  /// Send new streams of [trackAlias] to [incomingDataStreams] again
+  void unrouteTrack(int trackAlias);
+
+  /// Create a native publish pipeline (see NativePublishPipeline) that sends
+  /// [trackAlias] as moq-mi video on its own subgroup streams with publisher
+  /// [priority]; [version] is the negotiated MoQ version.
+  /// Returns the pipeline ID, or null if native publishing is not available.
+  int? createPublishPipeline(
+    int trackAlias, {
+    required int priority,
+    required int version,
+  });
+
   void dispose();
 }
 
+/// Per-track bandwidth estimate
+class BandwidthEstimate {
+  /// Bits per second delivered over the last 2 seconds (follows the media rate
+  /// while the link keeps up)
+  final int goodputBps;
+
+  /// Smoothed bits per second measured while the sender was bursting, i.e. what
+  /// the path can carry (0 until a large enough burst has been observed)
+  final int capacityBps;
+
+  const BandwidthEstimate({required this.goodputBps, required this.capacityBps});
+}
+
 /// Transport statistics
 class MoQTransportStats {
   final int bytesSent;
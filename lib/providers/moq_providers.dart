@@ -29,6 +29,16 @@ enum PackagingFormat {
   final String description;
 }
 
+/// Video source enum
+enum VideoSource {
+  camera('Camera', 'Webcam or built-in camera'),
+  screen('Screen', 'Desktop capture; only changed frames are encoded (Linux/X11)');
+
+  const VideoSource(this.label, this.description);
+  final String label;
+  final String description;
+}
+
 /// Video resolution enum with recommended bitrates (in kbps)
 enum VideoResolution {
   r360p(640, 360, '360p', 800),
@@ -120,6 +130,24 @@ final videoResolutionProvider = NotifierProvider<VideoResolutionNotifier, VideoR
   VideoResolutionNotifier.new,
 );
 
+/// Video source provider (defaults to camera)
+class VideoSourceNotifier extends Notifier<VideoSource> {
+  @override
+  VideoSource build() {
+    final settings = ref.watch(settingsServiceProvider);
+    return settings.videoSource;
+  }
+
+  void setSource(VideoSource source) {
+    state = source;
+    ref.read(settingsServiceProvider).setVideoSource(source);
+  }
+}
+
+final videoSourceProvider = NotifierProvider<VideoSourceNotifier, VideoSource>(
+  VideoSourceNotifier.new,
+);
+
 /// Theme mode provider (defaults to system)
 class ThemeModeNotifier extends Notifier<ThemeMode> {
   @override
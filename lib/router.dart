@@ -20,6 +20,8 @@ final appRouter = GoRouter(
         return ViewerScreen(
           namespace: extra['namespace'] as String? ?? '',
           trackName: extra['trackName'] as String? ?? '',
+          audioTrackName: extra['audioTrackName'] as String? ?? '',
+          channels: (extra['channels'] as List?)?.cast<String>() ?? const [],
           videoTrackAlias: extra['videoTrackAlias'] as String? ?? '',
           audioTrackAlias: extra['audioTrackAlias'] as String? ?? '',
           useCatalogPlayback: extra['useCatalogPlayback'] as bool? ?? true,
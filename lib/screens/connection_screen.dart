@@ -162,7 +162,21 @@ class _ConnectionScreenState extends ConsumerState<ConnectionScreen> {
         String videoTrackAlias = '';
         String audioTrackAlias = '';
 
-        if (_subscriberPlaybackMode == SubscriberPlaybackMode.directTracks) {
+        // A comma-separated namespace list opens the viewer in zapping mode,
+        // which manages its own subscriptions per channel
+        final channels = namespace
+            .split(',')
+            .map((channel) => channel.trim())
+            .where((channel) => channel.isNotEmpty)
+            .toList();
+        final zapping =
+            channels.length > 1 &&
+            _subscriberPlaybackMode == SubscriberPlaybackMode.directTracks;
+
+        if (zapping) {
+          _setStatus('Connected. Tuning ${channels.first}...');
+        } else if (_subscriberPlaybackMode ==
+            SubscriberPlaybackMode.directTracks) {
           final namespaceBytes = [Uint8List.fromList(namespace.codeUnits)];
 
           _setStatus('Subscribing to $namespace/$videoTrackName...');
@@ -194,10 +208,12 @@ class _ConnectionScreenState extends ConsumerState<ConnectionScreen> {
           context.go(
             '/viewer',
             extra: {
-              'namespace': namespace,
+              'namespace': zapping ? channels.first : namespace,
               'trackName': videoTrackName,
+              'audioTrackName': audioTrackName,
               'videoTrackAlias': videoTrackAlias,
               'audioTrackAlias': audioTrackAlias,
+              if (zapping) 'channels': channels,
               'useCatalogPlayback':
                   _subscriberPlaybackMode == SubscriberPlaybackMode.catalog,
             },
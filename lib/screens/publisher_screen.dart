@@ -14,10 +14,13 @@ import '../moq/media/native_opus_encoder.dart';
 import '../moq/media/native_h264_encoder.dart';
 import '../moq/media/camera_capture.dart';
 import '../moq/media/linux_capture.dart';
+import '../moq/media/linux_screen_capture.dart';
 import '../moq/media/video_encoder.dart';
+import '../moq/packager/moq_mi_packager.dart';
 import '../moq/publisher/cmaf_publisher.dart';
 import '../moq/publisher/moq_publisher.dart';
 import '../moq/publisher/moq_mi_publisher.dart';
+import '../moq/publisher/thumbnail_publisher.dart';
 import '../providers/moq_providers.dart';
 import '../widgets/connection_status_card.dart';
 import '../widgets/video_preview.dart';
@@ -44,9 +47,11 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
   // Publishing state
   PackagingFormat _packagingFormat = PackagingFormat.moqMi;
   VideoResolution _resolution = VideoResolution.r720p;
+  VideoSource _videoSource = VideoSource.camera;
   CmafPublisher? _cmafPublisher;
   MoQPublisher? _locPublisher;
   MoqMiPublisher? _moqMiPublisher;
+  ThumbnailTrackPublisher? _thumbnailPublisher;
   bool _isPublishing = false;
   bool _isStopping = false;
   bool _isAudioMuted = false;
@@ -103,6 +108,7 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
     _publishedAudioFrames = 0;
     _packagingFormat = ref.read(packagingFormatProvider);
     _resolution = ref.read(videoResolutionProvider);
+    _videoSource = ref.read(videoSourceProvider);
     if (mounted) setState(() {});
 
     try {
@@ -197,6 +203,18 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
             channelConfig: 'stereo',
           );
 
+          // Preview grids subscribe to a small JPEG track instead of the
+          // video; it is fed from raw capture frames (desktop only)
+          if (!Platform.isAndroid) {
+            _thumbnailPublisher = await ThumbnailTrackPublisher.create(
+              _locPublisher!,
+              videoTrackName: videoTrackName,
+              captureWidth: _resolution.width,
+              captureHeight: _resolution.height,
+              logger: _logger,
+            );
+          }
+
         case PackagingFormat.moqMi:
           // Create MoQ-MI publisher
           _moqMiPublisher = MoqMiPublisher(client: client, logger: _logger);
@@ -268,6 +286,16 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
           logger: _logger,
         );
         await _nativeH264Encoder!.start();
+      } else if (Platform.isLinux && _videoSource == VideoSource.screen) {
+        // Unchanged screens are re-sent at the idle rate only; x264 codes
+        // those repeats as skip frames
+        _videoCapture = LinuxScreenCapture(
+          config: ScreenCaptureConfig(
+            width: _resolution.width,
+            height: _resolution.height,
+          ),
+          logger: _logger,
+        );
       } else if (Platform.isLinux) {
         final linuxCapture = LinuxVideoCapture(
           config: CaptureConfig(
@@ -331,6 +359,14 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
           videoFrame,
         ) {
           _h264Encoder?.addFrame(videoFrame.data, videoFrame.timestampMs);
+          if (!_isVideoMuted && videoFrame.format == 'yuv420p') {
+            _thumbnailPublisher?.addFrame(
+              videoFrame.data,
+              videoFrame.width,
+              videoFrame.height,
+              videoFrame.timestampMs,
+            );
+          }
         });
 
         _h264FrameSubscription = _h264Encoder!.frames.listen((h264Frame) async {
@@ -360,8 +396,8 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
       await _videoCapture!.startCapture();
 
       // Linux preview
-      if (_videoCapture is LinuxVideoCapture) {
-        _previewFrameSubscription = (_videoCapture as LinuxVideoCapture)
+      if (_videoCapture is PreviewFrameSource) {
+        _previewFrameSubscription = (_videoCapture as PreviewFrameSource)
             .previewFrames
             .listen((previewFrame) async {
               try {
@@ -392,12 +428,15 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
     );
     await _audioCapture!.initialize();
 
-    const encoderConfig = OpusEncoderConfig(
+    // Silent frames are suppressed except for CMAF, whose fragments need a
+    // continuous timeline
+    final encoderConfig = OpusEncoderConfig(
       sampleRate: 48000,
       channels: 2,
       bitrate: 128000,
       frameDurationMs: 20,
       application: 'audio',
+      dtx: _packagingFormat != PackagingFormat.cmaf,
     );
 
     // Use native Opus encoder on all platforms (FFI to libopus)
@@ -437,6 +476,13 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
             audioTrackName,
             opusFrame.data,
             newGroup: true,
+            extensionHeaders: [
+              if (opusFrame.audioLevel != null)
+                locAudioLevelHeader(
+                  opusFrame.audioLevel!,
+                  voiceActivity: opusFrame.voiceActivity,
+                ),
+            ],
           );
 
         case PackagingFormat.moqMi:
@@ -447,6 +493,8 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
             pts: ptsUs,
             sampleRate: 48000,
             numChannels: 2,
+            audioLevel: opusFrame.audioLevel,
+            voiceActivity: opusFrame.voiceActivity,
           );
       }
 
@@ -506,6 +554,7 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
             frameData,
             newGroup: isKeyframe,
           );
+          if (isKeyframe) _thumbnailPublisher?.keyframe();
 
         case PackagingFormat.moqMi:
           if (_moqMiPublisher == null) return;
@@ -595,6 +644,9 @@ class _PublisherScreenState extends ConsumerState<PublisherScreen> {
       _nativeOpusEncoder = null;
     }
 
+    _thumbnailPublisher?.dispose();
+    _thumbnailPublisher = null;
+
     // Stop publisher (whichever is active)
     if (_cmafPublisher != null) {
       await _cmafPublisher!.stop();
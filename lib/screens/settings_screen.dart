@@ -100,6 +100,31 @@ class _SettingsScreenState extends ConsumerState<SettingsScreen> {
           ),
           const Divider(),
 
+          // Video Source section
+          _buildSectionHeader(context, 'Video Source'),
+          ...VideoSource.values.map((source) {
+            final currentSource = ref.watch(videoSourceProvider);
+            final isSelected = currentSource == source;
+            return RadioListTile<VideoSource>(
+              value: source,
+              groupValue: currentSource,
+              onChanged: (value) {
+                if (value != null) {
+                  ref.read(videoSourceProvider.notifier).setSource(value);
+                }
+              },
+              title: Text(source.label),
+              subtitle: Text(source.description),
+              secondary: Icon(
+                isSelected ? Icons.check_circle : Icons.circle_outlined,
+                color: isSelected
+                    ? Theme.of(context).colorScheme.primary
+                    : null,
+              ),
+            );
+          }),
+          const Divider(),
+
           // Video Quality section
           _buildSectionHeader(context, 'Video Resolution'),
           ...VideoResolution.values.map((resolution) {
@@ -7,6 +7,8 @@ import 'package:media_kit_video/media_kit_video.dart';
 import '../providers/moq_providers.dart';
 import '../widgets/connection_status_card.dart';
 import '../media/moq_video_player.dart';
+import '../media/moq_zapping_player.dart';
+import '../moq/client/moq_zapping.dart';
 import '../media/native_moq_player.dart';
 import '../services/native_media_player.dart';
 
@@ -14,6 +16,10 @@ import '../services/native_media_player.dart';
 class ViewerScreen extends ConsumerStatefulWidget {
   final String namespace;
   final String trackName;
+  final String audioTrackName;
+
+  /// Namespaces to zap between; more than one enables zapping mode
+  final List<String> channels;
   final String videoTrackAlias;
   final String audioTrackAlias;
   final bool useCatalogPlayback;
@@ -22,6 +28,8 @@ class ViewerScreen extends ConsumerStatefulWidget {
     super.key,
     required this.namespace,
     required this.trackName,
+    this.audioTrackName = '',
+    this.channels = const [],
     required this.videoTrackAlias,
     required this.audioTrackAlias,
     this.useCatalogPlayback = true,
@@ -36,6 +44,9 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
   MoQVideoPlayer? _videoPlayer;
   NativeMoQPlayer? _nativePlayer;
   MoQStreamPlayer? _streamPlayer;
+  MoQZappingPlayer? _zappingPlayer;
+  int _channelIndex = 0;
+  bool _isTuning = false;
   bool _useNativePlayer = false;
   bool _isInitializing = true;
   String? _errorMessage;
@@ -62,7 +73,12 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
   void dispose() {
     _statsTimer?.cancel();
     _streamPlayer?.dispose();
-    _videoPlayer?.dispose();
+    if (_zappingPlayer != null) {
+      // Owns the video players of all warm channels
+      _zappingPlayer!.dispose();
+    } else {
+      _videoPlayer?.dispose();
+    }
     _nativePlayer?.dispose();
     super.dispose();
   }
@@ -78,6 +94,22 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
         'subscriptions=${client.subscriptions.length})',
       );
 
+      if (_isZapping) {
+        _useNativePlayer = false;
+        _zappingPlayer = MoQZappingPlayer(client: client);
+        await _tune(_channelIndex);
+
+        _statsTimer = Timer.periodic(const Duration(milliseconds: 500), (_) {
+          _updateStats();
+        });
+
+        setState(() {
+          _statusMessage = 'Waiting for keyframe...';
+          _isInitializing = false;
+        });
+        return;
+      }
+
       if (widget.useCatalogPlayback) {
         _useNativePlayer = false;
         _streamPlayer = MoQStreamPlayer(client: client);
@@ -170,6 +202,49 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
     }
   }
 
+  bool get _isZapping => widget.channels.length > 1;
+
+  ZapChannel _channelAt(int index) {
+    final count = widget.channels.length;
+    return ZapChannel.named(widget.channels[index % count], [
+      widget.trackName,
+      if (widget.audioTrackName.isNotEmpty) widget.audioTrackName,
+    ]);
+  }
+
+  // Tune a channel and keep both neighbours warm for the next switch
+  Future<void> _tune(int index) async {
+    final count = widget.channels.length;
+    final target = (index % count + count) % count;
+    final player = await _zappingPlayer!.tune(
+      _channelAt(target),
+      likelyNext: [_channelAt(target + 1), _channelAt(target + count - 1)],
+    );
+    _channelIndex = target;
+    _videoPlayer = player;
+  }
+
+  Future<void> _zap(int step) async {
+    if (_zappingPlayer == null || _isTuning) return;
+    setState(() => _isTuning = true);
+    try {
+      await _tune(_channelIndex + step);
+      final lastSwitch = _zappingPlayer!.zapping.metrics.lastSwitch;
+      if (lastSwitch != null) {
+        debugPrint('ViewerScreen: $lastSwitch');
+      }
+    } catch (e) {
+      debugPrint('ViewerScreen: Channel switch failed: $e');
+      if (mounted) {
+        ScaffoldMessenger.of(
+          context,
+        ).showSnackBar(SnackBar(content: Text('Channel switch failed: $e')));
+      }
+    } finally {
+      if (mounted) setState(() => _isTuning = false);
+    }
+  }
+
   void _updateStats() {
     if (!mounted) return;
 
@@ -216,7 +291,12 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
       _statsTimer?.cancel();
       await _streamPlayer?.dispose();
       _streamPlayer = null;
-      await _videoPlayer?.dispose();
+      if (_zappingPlayer != null) {
+        await _zappingPlayer!.dispose();
+        _zappingPlayer = null;
+      } else {
+        await _videoPlayer?.dispose();
+      }
       _videoPlayer = null;
       await _nativePlayer?.dispose();
       _nativePlayer = null;
@@ -236,6 +316,12 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
     }
   }
 
+  String _formatSwitch(ZapSwitchEvent? event) {
+    if (event == null) return '-';
+    final millis = (event.latency.inMicroseconds / 1000).toStringAsFixed(1);
+    return '$millis ms (${event.warm ? 'warm' : 'cold'})';
+  }
+
   String _formatBytes(int bytes) {
     if (bytes < 1024) return '$bytes B';
     if (bytes < 1024 * 1024) return '${(bytes / 1024).toStringAsFixed(1)} KB';
@@ -259,11 +345,28 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
 
     return Scaffold(
       appBar: AppBar(
-        title: const Text('Stream Viewer', style: TextStyle(fontSize: 18)),
+        title: Text(
+          _isZapping ? widget.channels[_channelIndex] : 'Stream Viewer',
+          style: const TextStyle(fontSize: 18),
+        ),
         leading: IconButton(
           icon: const Icon(Icons.arrow_back),
           onPressed: _disconnect,
         ),
+        actions: [
+          if (_isZapping) ...[
+            IconButton(
+              icon: const Icon(Icons.skip_previous),
+              tooltip: 'Previous channel',
+              onPressed: _isTuning ? null : () => _zap(-1),
+            ),
+            IconButton(
+              icon: const Icon(Icons.skip_next),
+              tooltip: 'Next channel',
+              onPressed: _isTuning ? null : () => _zap(1),
+            ),
+          ],
+        ],
       ),
       body: Column(
         children: [
@@ -329,6 +432,18 @@ class _ViewerScreenState extends ConsumerState<ViewerScreen> {
                               'Data Received',
                               _formatBytes(_totalBytesReceived),
                             ),
+                            if (_zappingPlayer != null) ...[
+                              _buildStatsRow(
+                                'Last Switch',
+                                _formatSwitch(
+                                  _zappingPlayer!.zapping.metrics.lastSwitch,
+                                ),
+                              ),
+                              _buildStatsRow(
+                                'Standby Cost',
+                                '${_formatBytes(_zappingPlayer!.zapping.metrics.standbyBitrate ~/ 8)}/s',
+                              ),
+                            ],
                           ],
                         ),
                       ),
@@ -0,0 +1,331 @@
+// Native Audio Mixer FFI bindings
+//
+// Decodes many Opus tracks in Rust, picks the top-K active speakers and mixes
+// them into a single 48kHz stereo stream.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+import 'native_media_player.dart';
+
+// FFI function signatures
+typedef AudioMixerCreateNative = Uint64 Function(Int32 topK, Int32 workers);
+typedef AudioMixerCreate = int Function(int topK, int workers);
+
+typedef AudioMixerDestroyNative = Void Function(Uint64 mixerId);
+typedef AudioMixerDestroy = void Function(int mixerId);
+
+typedef AudioMixerAddTrackNative = Int32 Function(
+    Uint64 mixerId, Uint64 trackId);
+typedef AudioMixerAddTrack = int Function(int mixerId, int trackId);
+
+typedef AudioMixerRemoveTrackNative = Int32 Function(
+    Uint64 mixerId, Uint64 trackId);
+typedef AudioMixerRemoveTrack = int Function(int mixerId, int trackId);
+
+typedef AudioMixerPushPacketNative = Int32 Function(Uint64 mixerId,
+    Uint64 trackId, Pointer<Uint8> data, IntPtr len, Int32 audioLevel);
+typedef AudioMixerPushPacket = int Function(
+    int mixerId, int trackId, Pointer<Uint8> data, int len, int audioLevel);
+
+typedef AudioMixerAttachPlayerNative = Int32 Function(
+    Uint64 mixerId, Uint64 playerId);
+typedef AudioMixerAttachPlayer = int Function(int mixerId, int playerId);
+
+typedef AudioMixerGetActiveSpeakersNative = Int32 Function(Uint64 mixerId,
+    Pointer<Uint64> outTrackIds, Pointer<Float> outLevels, IntPtr len);
+typedef AudioMixerGetActiveSpeakers = int Function(int mixerId,
+    Pointer<Uint64> outTrackIds, Pointer<Float> outLevels, int len);
+
+typedef AudioMixerGetStatsNative = Int32 Function(
+    Uint64 mixerId, Pointer<Uint64> outStats, IntPtr len);
+typedef AudioMixerGetStats = int Function(
+    int mixerId, Pointer<Uint64> outStats, int len);
+
+/// Native multi-party audio mixer with active-speaker selection
+///
+/// Tracks are fed Opus packets as they arrive; the mixer decodes them on a
+/// worker pool, mixes only the [topK] loudest and plays the result through an
+/// attached [NativeMediaPlayer].
+class NativeAudioMixer {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static AudioMixerCreate? _create;
+  static AudioMixerDestroy? _destroy;
+  static AudioMixerAddTrack? _addTrack;
+  static AudioMixerRemoveTrack? _removeTrack;
+  static AudioMixerPushPacket? _pushPacket;
+  static AudioMixerAttachPlayer? _attachPlayer;
+  static AudioMixerGetActiveSpeakers? _getActiveSpeakers;
+  static AudioMixerGetStats? _getStats;
+
+  /// Mixer instance ID
+  final int _mixerId;
+  final int topK;
+  bool _disposed = false;
+
+  // Reused packet buffer, grown on demand
+  Pointer<Uint8> _packet = nullptr;
+  int _packetCapacity = 0;
+
+  NativeAudioMixer._(this._mixerId, this.topK);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<AudioMixerCreateNative>>('audio_mixer_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<AudioMixerDestroyNative>>(
+              'audio_mixer_destroy')
+          .asFunction();
+
+      _addTrack = _lib!
+          .lookup<NativeFunction<AudioMixerAddTrackNative>>(
+              'audio_mixer_add_track')
+          .asFunction();
+
+      _removeTrack = _lib!
+          .lookup<NativeFunction<AudioMixerRemoveTrackNative>>(
+              'audio_mixer_remove_track')
+          .asFunction();
+
+      _pushPacket = _lib!
+          .lookup<NativeFunction<AudioMixerPushPacketNative>>(
+              'audio_mixer_push_packet')
+          .asFunction();
+
+      _attachPlayer = _lib!
+          .lookup<NativeFunction<AudioMixerAttachPlayerNative>>(
+              'audio_mixer_attach_player')
+          .asFunction();
+
+      _getActiveSpeakers = _lib!
+          .lookup<NativeFunction<AudioMixerGetActiveSpeakersNative>>(
+              'audio_mixer_get_active_speakers')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<AudioMixerGetStatsNative>>(
+              'audio_mixer_get_stats')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native audio mixer library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native audio mixer: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native mixer is available (built with `audio-mixer`)
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a mixer that mixes the [topK] loudest tracks
+  ///
+  /// [workers] decode threads are used per 20ms tick; one is enough for
+  /// around a hundred speech tracks.
+  ///
+  /// Returns null if the native mixer is not available
+  static NativeAudioMixer? create({int topK = 3, int workers = 1}) {
+    try {
+      _initLib();
+
+      final mixerId = _create!(topK, workers);
+      if (mixerId == 0) {
+        _logger.e('Failed to create native audio mixer');
+        return null;
+      }
+
+      _logger.i('Created native audio mixer: $mixerId');
+      return NativeAudioMixer._(mixerId, topK);
+    } catch (e) {
+      _logger.e('Failed to create native audio mixer: $e');
+      return null;
+    }
+  }
+
+  /// Add an Opus track
+  bool addTrack(int trackId) {
+    if (_disposed) return false;
+    return _addTrack!(_mixerId, trackId) == 0;
+  }
+
+  /// Remove a track
+  bool removeTrack(int trackId) {
+    if (_disposed) return false;
+    return _removeTrack!(_mixerId, trackId) == 0;
+  }
+
+  /// Queue an Opus packet for [trackId]
+  ///
+  /// [audioLevel] is the sender-reported level in -dBov (0-127); tracks whose
+  /// packets carry one are only decoded while they are active speakers.
+  bool pushPacket(int trackId, Uint8List packet, {int? audioLevel}) {
+    if (_disposed || packet.isEmpty) return false;
+
+    if (packet.length > _packetCapacity) {
+      if (_packet != nullptr) calloc.free(_packet);
+      _packetCapacity = packet.length * 2;
+      _packet = calloc<Uint8>(_packetCapacity);
+    }
+    _packet.asTypedList(packet.length).setAll(0, packet);
+    return _pushPacket!(
+          _mixerId,
+          trackId,
+          _packet,
+          packet.length,
+          audioLevel ?? -1,
+        ) ==
+        0;
+  }
+
+  /// Play the mix through [player] in real time
+  ///
+  /// Switches the player to raw PCM input, so call before [NativeMediaPlayer.play].
+  bool attachPlayer(NativeMediaPlayer player) {
+    if (_disposed) return false;
+    return _attachPlayer!(_mixerId, player.playerId) == 0;
+  }
+
+  /// Current speakers, loudest first
+  List<ActiveSpeaker> get activeSpeakers {
+    if (_disposed) return const [];
+
+    final ids = calloc<Uint64>(topK);
+    final levels = calloc<Float>(topK);
+    try {
+      final count = _getActiveSpeakers!(_mixerId, ids, levels, topK);
+      return [
+        for (var i = 0; i < count; i++)
+          ActiveSpeaker(trackId: ids[i], levelDb: levels[i]),
+      ];
+    } finally {
+      calloc.free(ids);
+      calloc.free(levels);
+    }
+  }
+
+  /// Get mixing statistics
+  AudioMixerStats getStats() {
+    if (_disposed) return AudioMixerStats.fromValues(const []);
+
+    final out = calloc<Uint64>(AudioMixerStats.valueCount);
+    try {
+      final count = _getStats!(_mixerId, out, AudioMixerStats.valueCount);
+      if (count <= 0) return AudioMixerStats.fromValues(const []);
+      return AudioMixerStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Dispose the mixer
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_mixerId);
+    if (_packet != nullptr) {
+      calloc.free(_packet);
+      _packet = nullptr;
+    }
+    _logger.i('Disposed native audio mixer: $_mixerId');
+  }
+}
+
+/// A track currently being mixed
+class ActiveSpeaker {
+  final int trackId;
+
+  /// Smoothed level in dBFS
+  final double levelDb;
+
+  const ActiveSpeaker({required this.trackId, required this.levelDb});
+
+  @override
+  String toString() =>
+      'ActiveSpeaker($trackId, ${levelDb.toStringAsFixed(1)} dBFS)';
+}
+
+/// Audio mixer statistics
+class AudioMixerStats {
+  static const int valueCount = 8;
+
+  final int ticks;
+  final Duration lastTick;
+  final Duration maxTick;
+  final Duration totalTick;
+  final int packetsDecoded;
+
+  /// Packets of silent tracks dropped without decoding
+  final int packetsSkipped;
+  final int decodeErrors;
+  final int underruns;
+
+  const AudioMixerStats({
+    required this.ticks,
+    required this.lastTick,
+    required this.maxTick,
+    required this.totalTick,
+    required this.packetsDecoded,
+    required this.packetsSkipped,
+    required this.decodeErrors,
+    required this.underruns,
+  });
+
+  factory AudioMixerStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return AudioMixerStats(
+      ticks: at(0),
+      lastTick: Duration(microseconds: at(1)),
+      maxTick: Duration(microseconds: at(2)),
+      totalTick: Duration(microseconds: at(3)),
+      packetsDecoded: at(4),
+      packetsSkipped: at(5),
+      decodeErrors: at(6),
+      underruns: at(7),
+    );
+  }
+
+  /// Share of one core spent mixing, relative to the 20ms tick
+  double get coreLoad => ticks == 0
+      ? 0
+      : totalTick.inMicroseconds / (ticks * 20000);
+
+  @override
+  String toString() =>
+      'AudioMixerStats(ticks: $ticks, load: ${(coreLoad * 100).toStringAsFixed(1)}%, '
+      'max tick: ${maxTick.inMicroseconds}us, decoded: $packetsDecoded, '
+      'skipped: $packetsSkipped, errors: $decodeErrors, underruns: $underruns)';
+}
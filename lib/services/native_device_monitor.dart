@@ -0,0 +1,259 @@
+// Native video device monitor FFI bindings (Linux)
+//
+// Keeps the V4L2 camera list cached natively and current through hot-plug,
+// so listing cameras no longer runs v4l2-ctl per device node.
+
+import 'dart:async';
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:io';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+/// One capture device (mirrors `VideoDeviceInfo` in device_monitor.rs)
+final class NativeVideoDevice extends Struct {
+  @Array(32)
+  external Array<Uint8> path;
+
+  @Array(32)
+  external Array<Uint8> name;
+
+  @Array(16)
+  external Array<Uint8> driver;
+
+  @Array(32)
+  external Array<Uint8> busInfo;
+
+  @Uint32()
+  external int capabilities;
+}
+
+// FFI function signatures
+typedef VideoDeviceMonitorStartNative = Int32 Function();
+typedef VideoDeviceMonitorStart = int Function();
+
+typedef VideoDeviceMonitorStopNative = Void Function();
+typedef VideoDeviceMonitorStop = void Function();
+
+typedef VideoDeviceGenerationNative = Uint64 Function();
+typedef VideoDeviceGeneration = int Function();
+
+typedef VideoDeviceListNative = Int32 Function(
+    Pointer<NativeVideoDevice> outDevices, IntPtr capacity);
+typedef VideoDeviceList = int Function(
+    Pointer<NativeVideoDevice> outDevices, int capacity);
+
+typedef VideoDevicePollEventNative = Int32 Function(
+    Pointer<NativeVideoDevice> outDevice);
+typedef VideoDevicePollEvent = int Function(
+    Pointer<NativeVideoDevice> outDevice);
+
+/// A V4L2 capture device
+class VideoDevice {
+  final String path;
+  final String name;
+  final String driver;
+  final String busInfo;
+
+  const VideoDevice({
+    required this.path,
+    required this.name,
+    required this.driver,
+    required this.busInfo,
+  });
+
+  factory VideoDevice._fromNative(NativeVideoDevice device) {
+    String text(Array<Uint8> bytes, int length) {
+      final out = <int>[];
+      for (var i = 0; i < length && bytes[i] != 0; i++) {
+        out.add(bytes[i]);
+      }
+      return utf8.decode(out, allowMalformed: true);
+    }
+
+    return VideoDevice(
+      path: text(device.path, 32),
+      name: text(device.name, 32),
+      driver: text(device.driver, 16),
+      busInfo: text(device.busInfo, 32),
+    );
+  }
+
+  @override
+  String toString() => '$name ($path)';
+}
+
+/// How the device list changed
+enum VideoDeviceChangeKind { added, removed }
+
+/// A hot-plug event
+class VideoDeviceChange {
+  final VideoDeviceChangeKind kind;
+  final VideoDevice device;
+
+  const VideoDeviceChange(this.kind, this.device);
+
+  @override
+  String toString() => 'VideoDeviceChange(${kind.name}: $device)';
+}
+
+/// Cached V4L2 device list with hot-plug events
+///
+/// The native side watches /dev; this class checks its generation counter
+/// on a timer and only copies the list when it changed.
+class NativeDeviceMonitor {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+  static NativeDeviceMonitor? _instance;
+
+  // FFI function pointers
+  static VideoDeviceMonitorStart? _start;
+  static VideoDeviceMonitorStop? _stop;
+  static VideoDeviceGeneration? _generation;
+  static VideoDeviceList? _list;
+  static VideoDevicePollEvent? _pollEvent;
+
+  final _changes = StreamController<VideoDeviceChange>.broadcast();
+  final Pointer<NativeVideoDevice> _event = calloc<NativeVideoDevice>();
+  List<VideoDevice> _devices = const [];
+  int _knownGeneration = 0;
+  Timer? _pollTimer;
+
+  NativeDeviceMonitor._();
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _start = _lib!
+          .lookup<NativeFunction<VideoDeviceMonitorStartNative>>(
+              'video_device_monitor_start')
+          .asFunction();
+
+      _stop = _lib!
+          .lookup<NativeFunction<VideoDeviceMonitorStopNative>>(
+              'video_device_monitor_stop')
+          .asFunction();
+
+      _generation = _lib!
+          .lookup<NativeFunction<VideoDeviceGenerationNative>>(
+              'video_device_generation')
+          .asFunction();
+
+      _list = _lib!
+          .lookup<NativeFunction<VideoDeviceListNative>>('video_device_list')
+          .asFunction();
+
+      _pollEvent = _lib!
+          .lookup<NativeFunction<VideoDevicePollEventNative>>(
+              'video_device_poll_event')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native device monitor library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native device monitor: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native device monitor is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// The shared monitor, started on first use
+  ///
+  /// Returns null if the native library is not available
+  static NativeDeviceMonitor? get instance {
+    if (_instance != null) return _instance;
+    try {
+      _initLib();
+      if (_start!() != 0) return null;
+      final monitor = NativeDeviceMonitor._();
+      monitor._refresh();
+      monitor._pollTimer = Timer.periodic(
+        const Duration(milliseconds: 250),
+        (_) => monitor._poll(),
+      );
+      _instance = monitor;
+      return monitor;
+    } catch (e) {
+      _logger.e('Failed to start native device monitor: $e');
+      return null;
+    }
+  }
+
+  /// Capture devices, ordered by node path
+  List<VideoDevice> get devices {
+    if (_generation!() != _knownGeneration) _poll();
+    return _devices;
+  }
+
+  /// Devices plugged in or removed
+  Stream<VideoDeviceChange> get changes => _changes.stream;
+
+  void _poll() {
+    if (_generation!() == _knownGeneration) return;
+    while (true) {
+      final result = _pollEvent!(_event);
+      if (result <= 0) break;
+      _changes.add(
+        VideoDeviceChange(
+          result == 1
+              ? VideoDeviceChangeKind.added
+              : VideoDeviceChangeKind.removed,
+          VideoDevice._fromNative(_event.ref),
+        ),
+      );
+    }
+    _refresh();
+  }
+
+  void _refresh() {
+    // Read the generation first: a change racing the copy is seen next poll
+    _knownGeneration = _generation!();
+    var capacity = 16;
+    while (true) {
+      final out = calloc<NativeVideoDevice>(capacity);
+      try {
+        final count = _list!(out, capacity);
+        if (count < 0) return;
+        if (count > capacity) {
+          capacity = count;
+          continue;
+        }
+        _devices = List.unmodifiable([
+          for (var i = 0; i < count; i++) VideoDevice._fromNative(out[i]),
+        ]);
+        return;
+      } finally {
+        calloc.free(out);
+      }
+    }
+  }
+
+  /// Stop monitoring
+  static void shutdown() {
+    final monitor = _instance;
+    if (monitor == null) return;
+    _instance = null;
+    monitor._pollTimer?.cancel();
+    monitor._changes.close();
+    calloc.free(monitor._event);
+    _stop!();
+  }
+}
@@ -0,0 +1,339 @@
+// Native Grid Decoder FFI bindings
+//
+// Decodes many H.264 streams on one shared work-stealing thread pool in Rust
+// and writes the pictures into tiles of a single RGBA texture atlas.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef GridDecoderCreateNative = Uint64 Function(Int32 workers,
+    Int32 tileWidth, Int32 tileHeight, Int32 columns, Int32 rows,
+    Int32 playoutDelayMs);
+typedef GridDecoderCreate = int Function(int workers, int tileWidth,
+    int tileHeight, int columns, int rows, int playoutDelayMs);
+
+typedef GridDecoderDestroyNative = Void Function(Uint64 gridId);
+typedef GridDecoderDestroy = void Function(int gridId);
+
+typedef GridDecoderAddStreamNative = Int32 Function(
+    Uint64 gridId, Uint64 streamId, Int32 tile);
+typedef GridDecoderAddStream = int Function(
+    int gridId, int streamId, int tile);
+
+typedef GridDecoderRemoveStreamNative = Int32 Function(
+    Uint64 gridId, Uint64 streamId);
+typedef GridDecoderRemoveStream = int Function(int gridId, int streamId);
+
+typedef GridDecoderSetAvccNative = Int32 Function(
+    Uint64 gridId, Uint64 streamId, Pointer<Uint8> data, IntPtr len);
+typedef GridDecoderSetAvcc = int Function(
+    int gridId, int streamId, Pointer<Uint8> data, int len);
+
+typedef GridDecoderPushNative = Int32 Function(Uint64 gridId, Uint64 streamId,
+    Pointer<Uint8> data, IntPtr len, Int64 ptsUs, Int32 keyframe);
+typedef GridDecoderPush = int Function(int gridId, int streamId,
+    Pointer<Uint8> data, int len, int ptsUs, int keyframe);
+
+typedef GridDecoderAtlasSizeNative = Int32 Function(
+    Uint64 gridId, Pointer<Uint32> outWidth, Pointer<Uint32> outHeight);
+typedef GridDecoderAtlasSize = int Function(
+    int gridId, Pointer<Uint32> outWidth, Pointer<Uint32> outHeight);
+
+typedef GridDecoderReadAtlasNative = Int32 Function(
+    Uint64 gridId, Pointer<Uint8> out, IntPtr len);
+typedef GridDecoderReadAtlas = int Function(
+    int gridId, Pointer<Uint8> out, int len);
+
+typedef GridDecoderGetStatsNative = Int32 Function(
+    Uint64 gridId, Uint64 streamId, Pointer<Uint64> outStats, IntPtr len);
+typedef GridDecoderGetStats = int Function(
+    int gridId, int streamId, Pointer<Uint64> outStats, int len);
+
+/// Native multi-stream decoder rendering into a shared texture atlas
+///
+/// Streams are decoded on a fixed pool of workers (one per core by default).
+/// Frames that would miss their display deadline are decoded without output
+/// or skipped up to the next keyframe.
+class NativeGridDecoder {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static GridDecoderCreate? _create;
+  static GridDecoderDestroy? _destroy;
+  static GridDecoderAddStream? _addStream;
+  static GridDecoderRemoveStream? _removeStream;
+  static GridDecoderSetAvcc? _setAvcc;
+  static GridDecoderPush? _push;
+  static GridDecoderAtlasSize? _atlasSize;
+  static GridDecoderReadAtlas? _readAtlas;
+  static GridDecoderGetStats? _getStats;
+
+  /// Grid instance ID
+  final int _gridId;
+  final int width;
+  final int height;
+  final int columns;
+  final int rows;
+  bool _disposed = false;
+
+  // Caller-side copy of the atlas; only changed tiles are rewritten
+  final Pointer<Uint8> _atlas;
+
+  // Reused access unit buffer, grown on demand
+  Pointer<Uint8> _data = nullptr;
+  int _dataCapacity = 0;
+
+  NativeGridDecoder._(
+      this._gridId, this.width, this.height, this.columns, this.rows)
+      : _atlas = calloc<Uint8>(width * height * 4);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<GridDecoderCreateNative>>(
+              'grid_decoder_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<GridDecoderDestroyNative>>(
+              'grid_decoder_destroy')
+          .asFunction();
+
+      _addStream = _lib!
+          .lookup<NativeFunction<GridDecoderAddStreamNative>>(
+              'grid_decoder_add_stream')
+          .asFunction();
+
+      _removeStream = _lib!
+          .lookup<NativeFunction<GridDecoderRemoveStreamNative>>(
+              'grid_decoder_remove_stream')
+          .asFunction();
+
+      _setAvcc = _lib!
+          .lookup<NativeFunction<GridDecoderSetAvccNative>>(
+              'grid_decoder_set_avcc')
+          .asFunction();
+
+      _push = _lib!
+          .lookup<NativeFunction<GridDecoderPushNative>>('grid_decoder_push')
+          .asFunction();
+
+      _atlasSize = _lib!
+          .lookup<NativeFunction<GridDecoderAtlasSizeNative>>(
+              'grid_decoder_atlas_size')
+          .asFunction();
+
+      _readAtlas = _lib!
+          .lookup<NativeFunction<GridDecoderReadAtlasNative>>(
+              'grid_decoder_read_atlas')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<GridDecoderGetStatsNative>>(
+              'grid_decoder_get_stats')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native grid decoder library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native grid decoder: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the grid decoder is available (built with `grid-decoder`)
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a decoder for a [columns] x [rows] grid of tiles
+  ///
+  /// [workers] of 0 uses one decode thread per core. [playoutDelay] is the
+  /// time from a stream's first frame to its display; frames that cannot be
+  /// decoded within it are dropped.
+  ///
+  /// Returns null if the grid decoder is not available
+  static NativeGridDecoder? create({
+    required int columns,
+    required int rows,
+    int tileWidth = 320,
+    int tileHeight = 180,
+    int workers = 0,
+    Duration playoutDelay = const Duration(milliseconds: 100),
+  }) {
+    try {
+      _initLib();
+
+      final gridId = _create!(workers, tileWidth, tileHeight, columns, rows,
+          playoutDelay.inMilliseconds);
+      if (gridId == 0) {
+        _logger.e('Failed to create native grid decoder');
+        return null;
+      }
+
+      final size = calloc<Uint32>(2);
+      try {
+        _atlasSize!(gridId, size, size + 1);
+        _logger.i('Created native grid decoder: $gridId '
+            '(${size[0]}x${size[1]} atlas)');
+        return NativeGridDecoder._(gridId, size[0], size[1], columns, rows);
+      } finally {
+        calloc.free(size);
+      }
+    } catch (e) {
+      _logger.e('Failed to create native grid decoder: $e');
+      return null;
+    }
+  }
+
+  /// Add a stream drawn into atlas [tile] (row-major)
+  bool addStream(int streamId, int tile) {
+    if (_disposed) return false;
+    return _addStream!(_gridId, streamId, tile) == 0;
+  }
+
+  /// Remove a stream
+  bool removeStream(int streamId) {
+    if (_disposed) return false;
+    return _removeStream!(_gridId, streamId) == 0;
+  }
+
+  /// Set a stream's avcC record; its SPS/PPS are sent ahead of keyframes
+  bool setAvcc(int streamId, Uint8List avcc) {
+    if (_disposed || avcc.isEmpty) return false;
+    return _setAvcc!(_gridId, streamId, _copyIn(avcc), avcc.length) == 0;
+  }
+
+  /// Queue an H.264 access unit (Annex-B or 4-byte AVCC)
+  bool push(int streamId, Uint8List accessUnit,
+      {required int ptsUs, bool keyframe = false}) {
+    if (_disposed || accessUnit.isEmpty) return false;
+    return _push!(_gridId, streamId, _copyIn(accessUnit), accessUnit.length,
+            ptsUs, keyframe ? 1 : 0) ==
+        0;
+  }
+
+  /// Refresh the atlas with tiles decoded since the last call
+  ///
+  /// Returns the full RGBA atlas, or null if no tile changed. The returned
+  /// view is only valid until the next call.
+  Uint8List? readAtlas() {
+    if (_disposed) return null;
+    final length = width * height * 4;
+    final updated = _readAtlas!(_gridId, _atlas, length);
+    if (updated <= 0) return null;
+    return _atlas.asTypedList(length);
+  }
+
+  /// Get decode statistics for one stream, or all streams
+  GridDecoderStats getStats({int? streamId}) {
+    if (_disposed) return GridDecoderStats.fromValues(const []);
+
+    final out = calloc<Uint64>(GridDecoderStats.valueCount);
+    try {
+      final count = _getStats!(
+          _gridId, streamId ?? 0, out, GridDecoderStats.valueCount);
+      if (count <= 0) return GridDecoderStats.fromValues(const []);
+      return GridDecoderStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Dispose the decoder and stop its workers
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_gridId);
+    calloc.free(_atlas);
+    if (_data != nullptr) {
+      calloc.free(_data);
+      _data = nullptr;
+    }
+    _logger.i('Disposed native grid decoder: $_gridId');
+  }
+
+  Pointer<Uint8> _copyIn(Uint8List bytes) {
+    if (bytes.length > _dataCapacity) {
+      if (_data != nullptr) calloc.free(_data);
+      _dataCapacity = bytes.length * 2;
+      _data = calloc<Uint8>(_dataCapacity);
+    }
+    _data.asTypedList(bytes.length).setAll(0, bytes);
+    return _data;
+  }
+}
+
+/// Grid decoder statistics
+class GridDecoderStats {
+  static const int valueCount = 5;
+
+  final int decoded;
+  final int displayed;
+
+  /// Frames decoded without output because their deadline had passed
+  final int droppedLate;
+
+  /// Frames discarded undecoded to catch up at a later keyframe
+  final int skippedToKeyframe;
+  final int decodeErrors;
+
+  const GridDecoderStats({
+    required this.decoded,
+    required this.displayed,
+    required this.droppedLate,
+    required this.skippedToKeyframe,
+    required this.decodeErrors,
+  });
+
+  factory GridDecoderStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return GridDecoderStats(
+      decoded: at(0),
+      displayed: at(1),
+      droppedLate: at(2),
+      skippedToKeyframe: at(3),
+      decodeErrors: at(4),
+    );
+  }
+
+  /// Share of received frames that were shown on time
+  double get onTimeRatio {
+    final total = decoded + skippedToKeyframe + decodeErrors;
+    return total == 0 ? 1 : displayed / total;
+  }
+
+  @override
+  String toString() =>
+      'GridDecoderStats(displayed: $displayed, decoded: $decoded, '
+      'late: $droppedLate, skipped: $skippedToKeyframe, errors: $decodeErrors, '
+      'on time: ${(onTimeRatio * 100).toStringAsFixed(1)}%)';
+}
@@ -0,0 +1,267 @@
+// Native H.264 bitstream toolkit FFI bindings
+//
+// SIMD start-code scanning, Annex-B to AVCC conversion and SPS/slice header
+// inspection for the publish path, replacing byte-at-a-time Dart loops.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef H264FindStartCodesNative = Int32 Function(Pointer<Uint8> data,
+    IntPtr len, Pointer<Uint32> outOffsets, Pointer<Uint8> outLengths,
+    IntPtr capacity);
+typedef H264FindStartCodes = int Function(Pointer<Uint8> data, int len,
+    Pointer<Uint32> outOffsets, Pointer<Uint8> outLengths, int capacity);
+
+typedef H264AnnexbToAvccNative = Int32 Function(
+    Pointer<Uint8> buf, IntPtr len, IntPtr capacity, Pointer<IntPtr> outLen);
+typedef H264AnnexbToAvcc = int Function(
+    Pointer<Uint8> buf, int len, int capacity, Pointer<IntPtr> outLen);
+
+typedef H264InspectNative = Int32 Function(
+    Pointer<Uint8> data, IntPtr dataLen, Pointer<Int32> out, IntPtr len);
+typedef H264Inspect = int Function(
+    Pointer<Uint8> data, int dataLen, Pointer<Int32> out, int len);
+
+/// What an H.264 access unit contains
+class H264AccessUnitInfo {
+  static const int valueCount = 9;
+
+  /// Contains an IDR slice
+  final bool keyframe;
+
+  /// Display size from an SPS in the access unit (0 without one)
+  final int width;
+  final int height;
+
+  final int profileIdc;
+  final int levelIdc;
+  final int nalCount;
+
+  /// Bit n set when a NAL unit of type n is present
+  final int nalTypes;
+
+  /// First slice's type (0 = P, 1 = B, 2 = I, 3 = SP, 4 = SI), null without
+  /// a slice
+  final int? sliceType;
+
+  /// First slice's frame_num, null unless the access unit carries its SPS
+  final int? frameNum;
+
+  const H264AccessUnitInfo({
+    required this.keyframe,
+    required this.width,
+    required this.height,
+    required this.profileIdc,
+    required this.levelIdc,
+    required this.nalCount,
+    required this.nalTypes,
+    this.sliceType,
+    this.frameNum,
+  });
+
+  factory H264AccessUnitInfo.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return H264AccessUnitInfo(
+      keyframe: at(0) == 1,
+      width: at(1),
+      height: at(2),
+      profileIdc: at(3),
+      levelIdc: at(4),
+      nalCount: at(5),
+      nalTypes: at(6),
+      sliceType: at(7) < 0 ? null : at(7),
+      frameNum: at(8) < 0 ? null : at(8),
+    );
+  }
+
+  /// Whether the access unit carries an SPS
+  bool get hasSps => nalTypes & (1 << 7) != 0;
+
+  @override
+  String toString() =>
+      'H264AccessUnitInfo(keyframe: $keyframe, ${width}x$height, '
+      'profile: $profileIdc, level: $levelIdc, nals: $nalCount)';
+}
+
+/// Native H.264 bitstream helpers
+///
+/// Each instance keeps its own native buffers, so use one per stream.
+class NativeH264Bitstream {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+  static bool _failed = false;
+
+  // FFI function pointers
+  static H264FindStartCodes? _findStartCodes;
+  static H264AnnexbToAvcc? _annexbToAvcc;
+  static H264Inspect? _inspect;
+
+  bool _disposed = false;
+
+  // Reused buffers, grown on demand
+  Pointer<Uint8> _data = nullptr;
+  int _dataCapacity = 0;
+  Pointer<Uint32> _offsets = nullptr;
+  Pointer<Uint8> _lengths = nullptr;
+  int _codeCapacity = 0;
+  final Pointer<IntPtr> _outLen = calloc<IntPtr>();
+  final Pointer<Int32> _info = calloc<Int32>(H264AccessUnitInfo.valueCount);
+
+  NativeH264Bitstream._();
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _findStartCodes = _lib!
+          .lookup<NativeFunction<H264FindStartCodesNative>>(
+              'h264_find_start_codes')
+          .asFunction();
+
+      _annexbToAvcc = _lib!
+          .lookup<NativeFunction<H264AnnexbToAvccNative>>(
+              'h264_annexb_to_avcc')
+          .asFunction();
+
+      _inspect = _lib!
+          .lookup<NativeFunction<H264InspectNative>>('h264_inspect')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native H.264 bitstream library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native H.264 bitstream library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native toolkit is available
+  ///
+  /// A failed load is not retried: muxers check this per stream and fall
+  /// back to Dart.
+  static bool get isAvailable {
+    if (_failed) return false;
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      _failed = true;
+      return false;
+    }
+  }
+
+  /// Create a toolkit instance, or null if the native library is not
+  /// available
+  static NativeH264Bitstream? create() {
+    if (!isAvailable) return null;
+    return NativeH264Bitstream._();
+  }
+
+  // Copy `data` into the native buffer, keeping `extra` bytes of room
+  Pointer<Uint8> _load(Uint8List data, [int extra = 0]) {
+    final needed = data.length + extra;
+    if (needed > _dataCapacity) {
+      if (_data != nullptr) calloc.free(_data);
+      _dataCapacity = needed + needed ~/ 2;
+      _data = calloc<Uint8>(_dataCapacity);
+    }
+    _data.asTypedList(data.length).setAll(0, data);
+    return _data;
+  }
+
+  /// Start codes of an Annex-B buffer as (offset, length 3 or 4)
+  List<({int offset, int length})>? startCodes(Uint8List data) {
+    if (_disposed) return null;
+    final ptr = _load(data);
+    var count = _findStartCodes!(ptr, data.length, _offsets, _lengths,
+        _codeCapacity);
+    if (count > _codeCapacity) {
+      if (_offsets != nullptr) calloc.free(_offsets);
+      if (_lengths != nullptr) calloc.free(_lengths);
+      _codeCapacity = count * 2;
+      _offsets = calloc<Uint32>(_codeCapacity);
+      _lengths = calloc<Uint8>(_codeCapacity);
+      count = _findStartCodes!(ptr, data.length, _offsets, _lengths,
+          _codeCapacity);
+    }
+    if (count < 0) return null;
+    return List.generate(
+      count,
+      (i) => (offset: _offsets[i], length: _lengths[i]),
+    );
+  }
+
+  /// NAL units of an Annex-B buffer, without start codes, as views of
+  /// [data]
+  List<Uint8List>? splitNalUnits(Uint8List data) {
+    final codes = startCodes(data);
+    if (codes == null) return null;
+    return [
+      for (var i = 0; i < codes.length; i++)
+        Uint8List.sublistView(
+          data,
+          codes[i].offset + codes[i].length,
+          i + 1 < codes.length ? codes[i + 1].offset : data.length,
+        ),
+    ];
+  }
+
+  /// Convert an Annex-B access unit to 4-byte length-prefixed NAL units
+  Uint8List? annexBToAvcc(Uint8List data) {
+    if (_disposed) return null;
+    // Each 3-byte start code grows the output by one byte
+    var ptr = _load(data, data.length ~/ 64 + 16);
+    var result = _annexbToAvcc!(ptr, data.length, _dataCapacity, _outLen);
+    if (result == -2) {
+      ptr = _load(data, _outLen.value - data.length);
+      result = _annexbToAvcc!(ptr, data.length, _dataCapacity, _outLen);
+    }
+    if (result != 0) return null;
+    return Uint8List.fromList(ptr.asTypedList(_outLen.value));
+  }
+
+  /// Keyframe, resolution and slice information for an access unit
+  H264AccessUnitInfo? inspect(Uint8List data) {
+    if (_disposed) return null;
+    final ptr = _load(data);
+    final count = _inspect!(
+        ptr, data.length, _info, H264AccessUnitInfo.valueCount);
+    if (count < 0) return null;
+    return H264AccessUnitInfo.fromValues(
+        List<int>.generate(count, (i) => _info[i]));
+  }
+
+  /// Free the native buffers
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    if (_data != nullptr) calloc.free(_data);
+    if (_offsets != nullptr) calloc.free(_offsets);
+    if (_lengths != nullptr) calloc.free(_lengths);
+    calloc.free(_outLen);
+    calloc.free(_info);
+    _data = nullptr;
+    _offsets = nullptr;
+    _lengths = nullptr;
+  }
+}
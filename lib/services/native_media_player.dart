@@ -71,6 +71,16 @@ typedef MediaPlayerGetStats = int Function(
 typedef MediaPlayerIsPlayingNative = Int32 Function(Uint64 playerId);
 typedef MediaPlayerIsPlaying = int Function(int playerId);
 
+typedef MediaPlayerSetStreamHintsNative = Int32 Function(
+    Uint64 playerId, Pointer<Utf8> format);
+typedef MediaPlayerSetStreamHints = int Function(
+    int playerId, Pointer<Utf8> format);
+
+typedef MediaPlayerGetStartupTimingNative = Int32 Function(
+    Uint64 playerId, Pointer<Uint64> outMicros, IntPtr len);
+typedef MediaPlayerGetStartupTiming = int Function(
+    int playerId, Pointer<Uint64> outMicros, int len);
+
 /// Native media player using libmpv with custom stream protocol
 ///
 /// This player reads media data from an in-memory ring buffer instead of files,
@@ -93,6 +103,8 @@ class NativeMediaPlayer {
   static MediaPlayerProcessEvents? _processEvents;
   static MediaPlayerGetStats? _getStats;
   static MediaPlayerIsPlaying? _isPlaying;
+  static MediaPlayerSetStreamHints? _setStreamHints;
+  static MediaPlayerGetStartupTiming? _getStartupTiming;
 
   /// Player instance ID
   final int _playerId;
@@ -100,6 +112,9 @@ class NativeMediaPlayer {
 
   NativeMediaPlayer._(this._playerId);
 
+  /// Native player ID, for attaching other native components
+  int get playerId => _playerId;
+
   /// Initialize the native library
   static void _initLib() {
     if (_initialized) return;
@@ -172,6 +187,16 @@ class NativeMediaPlayer {
               'media_player_is_playing')
           .asFunction();
 
+      _setStreamHints = _lib!
+          .lookup<NativeFunction<MediaPlayerSetStreamHintsNative>>(
+              'media_player_set_stream_hints')
+          .asFunction();
+
+      _getStartupTiming = _lib!
+          .lookup<NativeFunction<MediaPlayerGetStartupTimingNative>>(
+              'media_player_get_startup_timing')
+          .asFunction();
+
       _initialized = true;
       _logger.i('Native media player library initialized');
     } catch (e) {
@@ -312,6 +337,38 @@ class NativeMediaPlayer {
     }
   }
 
+  /// Tell the demuxer the container format up front so it skips probing
+  ///
+  /// Must be called before [play].
+  bool setStreamHints({String format = 'mp4'}) {
+    if (_disposed) return false;
+
+    final formatPtr = format.toNativeUtf8();
+    try {
+      return _setStreamHints!(_playerId, formatPtr) == 0;
+    } finally {
+      calloc.free(formatPtr);
+    }
+  }
+
+  /// Get the time-to-first-frame breakdown
+  MediaPlayerStartupTiming getStartupTiming() {
+    if (_disposed) return MediaPlayerStartupTiming.fromMicros(const []);
+
+    final out = calloc<Uint64>(MediaPlayerStartupTiming.phaseCount);
+    try {
+      final count = _getStartupTiming!(
+        _playerId,
+        out,
+        MediaPlayerStartupTiming.phaseCount,
+      );
+      if (count <= 0) return MediaPlayerStartupTiming.fromMicros(const []);
+      return MediaPlayerStartupTiming.fromMicros(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
   /// Check if currently playing
   bool get isPlaying {
     if (_disposed) return false;
@@ -343,3 +400,47 @@ class MediaPlayerStats {
   String toString() =>
       'MediaPlayerStats(buffered: $buffered, written: $written, read: $read)';
 }
+
+/// Native startup milestones, measured from player creation
+///
+/// A null phase has not been reached yet. [fileLoaded] and [firstFrame] come
+/// from mpv events and are only as precise as the processEvents() interval.
+class MediaPlayerStartupTiming {
+  static const int phaseCount = 6;
+
+  final Duration? mpvReady;
+  final Duration? loadRequested;
+  final Duration? firstWrite;
+  final Duration? firstRead;
+  final Duration? fileLoaded;
+  final Duration? firstFrame;
+
+  const MediaPlayerStartupTiming({
+    this.mpvReady,
+    this.loadRequested,
+    this.firstWrite,
+    this.firstRead,
+    this.fileLoaded,
+    this.firstFrame,
+  });
+
+  factory MediaPlayerStartupTiming.fromMicros(List<int> micros) {
+    Duration? phase(int index) => index < micros.length && micros[index] > 0
+        ? Duration(microseconds: micros[index])
+        : null;
+    return MediaPlayerStartupTiming(
+      mpvReady: phase(0),
+      loadRequested: phase(1),
+      firstWrite: phase(2),
+      firstRead: phase(3),
+      fileLoaded: phase(4),
+      firstFrame: phase(5),
+    );
+  }
+
+  @override
+  String toString() =>
+      'MediaPlayerStartupTiming(mpvReady: $mpvReady, load: $loadRequested, '
+      'firstWrite: $firstWrite, firstRead: $firstRead, '
+      'fileLoaded: $fileLoaded, firstFrame: $firstFrame)';
+}
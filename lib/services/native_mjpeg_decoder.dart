@@ -0,0 +1,320 @@
+// Native MJPEG Decoder FFI bindings
+//
+// Decodes camera JPEG frames with libjpeg-turbo on a native worker thread,
+// straight into I420, and enumerates V4L2 camera modes on Linux.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+import '../moq/media/camera_mode.dart';
+
+/// One V4L2 mode (mirrors `CameraMode` in mjpeg_decoder.rs)
+final class NativeCameraMode extends Struct {
+  @Uint32()
+  external int fourcc;
+
+  @Uint32()
+  external int width;
+
+  @Uint32()
+  external int height;
+
+  @Uint32()
+  external int intervalNum;
+
+  @Uint32()
+  external int intervalDen;
+
+  @Uint32()
+  external int compressed;
+}
+
+// FFI function signatures
+typedef MjpegDecoderCreateNative = Uint64 Function(
+    Int32 fastDct, Int32 fullRange);
+typedef MjpegDecoderCreate = int Function(int fastDct, int fullRange);
+
+typedef MjpegDecoderDestroyNative = Void Function(Uint64 decoderId);
+typedef MjpegDecoderDestroy = void Function(int decoderId);
+
+typedef MjpegDecoderPushNative = Int32 Function(
+    Uint64 decoderId, Pointer<Uint8> data, IntPtr len, Int64 timestampMs);
+typedef MjpegDecoderPush = int Function(
+    int decoderId, Pointer<Uint8> data, int len, int timestampMs);
+
+typedef MjpegDecoderPullNative = Int32 Function(
+    Uint64 decoderId, Pointer<Uint8> out, IntPtr len, Pointer<Int64> outInfo);
+typedef MjpegDecoderPull = int Function(
+    int decoderId, Pointer<Uint8> out, int len, Pointer<Int64> outInfo);
+
+typedef MjpegDecoderGetStatsNative = Int32 Function(
+    Uint64 decoderId, Pointer<Uint64> outStats, IntPtr len);
+typedef MjpegDecoderGetStats = int Function(
+    int decoderId, Pointer<Uint64> outStats, int len);
+
+typedef CameraEnumerateModesNative = Int32 Function(
+    Pointer<Utf8> device, Pointer<NativeCameraMode> outModes, IntPtr capacity);
+typedef CameraEnumerateModes = int Function(
+    Pointer<Utf8> device, Pointer<NativeCameraMode> outModes, int capacity);
+
+/// A decoded I420 frame
+class DecodedI420Frame {
+  final Uint8List data;
+  final int width;
+  final int height;
+  final int timestampMs;
+
+  const DecodedI420Frame({
+    required this.data,
+    required this.width,
+    required this.height,
+    required this.timestampMs,
+  });
+}
+
+/// Native MJPEG to I420 decoder
+///
+/// Frames are decoded on a native worker thread. When decoding falls behind,
+/// frames that were not yet started are replaced by newer ones.
+class NativeMjpegDecoder {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static MjpegDecoderCreate? _create;
+  static MjpegDecoderDestroy? _destroy;
+  static MjpegDecoderPush? _push;
+  static MjpegDecoderPull? _pull;
+  static MjpegDecoderGetStats? _getStats;
+  static CameraEnumerateModes? _enumerateModes;
+
+  /// Decoder ID
+  final int _decoderId;
+  bool _disposed = false;
+
+  // Reused input and output buffers, grown on demand
+  Pointer<Uint8> _input = nullptr;
+  int _inputCapacity = 0;
+  Pointer<Uint8> _output = nullptr;
+  int _outputCapacity = 0;
+  final Pointer<Int64> _info = calloc<Int64>(3);
+
+  NativeMjpegDecoder._(this._decoderId);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<MjpegDecoderCreateNative>>(
+              'mjpeg_decoder_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<MjpegDecoderDestroyNative>>(
+              'mjpeg_decoder_destroy')
+          .asFunction();
+
+      _push = _lib!
+          .lookup<NativeFunction<MjpegDecoderPushNative>>('mjpeg_decoder_push')
+          .asFunction();
+
+      _pull = _lib!
+          .lookup<NativeFunction<MjpegDecoderPullNative>>('mjpeg_decoder_pull')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<MjpegDecoderGetStatsNative>>(
+              'mjpeg_decoder_get_stats')
+          .asFunction();
+
+      _enumerateModes = _lib!
+          .lookup<NativeFunction<CameraEnumerateModesNative>>(
+              'camera_enumerate_modes')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native MJPEG decoder library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native MJPEG decoder: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native MJPEG decoder is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a decoder
+  ///
+  /// [fastDct] uses a faster, slightly less accurate inverse DCT.
+  /// [fullRange] keeps JPEG's full-range levels instead of mapping them to
+  /// the limited range encoders expect.
+  ///
+  /// Returns null if the native library is not available
+  static NativeMjpegDecoder? create({
+    bool fastDct = false,
+    bool fullRange = false,
+  }) {
+    try {
+      _initLib();
+      final decoderId = _create!(fastDct ? 1 : 0, fullRange ? 1 : 0);
+      if (decoderId == 0) return null;
+      return NativeMjpegDecoder._(decoderId);
+    } catch (e) {
+      _logger.e('Failed to create native MJPEG decoder: $e');
+      return null;
+    }
+  }
+
+  /// Capture modes of a V4L2 device, or null if they can't be enumerated
+  static List<CameraMode>? enumerateV4l2Modes(String devicePath) {
+    if (!isAvailable) return null;
+    const capacity = 256;
+    final device = devicePath.toNativeUtf8();
+    final modes = calloc<NativeCameraMode>(capacity);
+    try {
+      final count = _enumerateModes!(device, modes, capacity);
+      if (count < 0) return null;
+      return [
+        for (var i = 0; i < count && i < capacity; i++)
+          CameraMode.fromFourccCode(
+            code: modes[i].fourcc,
+            width: modes[i].width,
+            height: modes[i].height,
+            frameRate: modes[i].intervalNum == 0
+                ? 0
+                : modes[i].intervalDen / modes[i].intervalNum,
+            compressed: modes[i].compressed != 0,
+          ),
+      ];
+    } finally {
+      calloc.free(device);
+      calloc.free(modes);
+    }
+  }
+
+  /// Queue a JPEG frame for decoding
+  bool push(Uint8List jpeg, int timestampMs) {
+    if (_disposed || jpeg.isEmpty) return false;
+    if (jpeg.length > _inputCapacity) {
+      if (_input != nullptr) calloc.free(_input);
+      _inputCapacity = jpeg.length * 2;
+      _input = calloc<Uint8>(_inputCapacity);
+    }
+    _input.asTypedList(jpeg.length).setAll(0, jpeg);
+    return _push!(_decoderId, _input, jpeg.length, timestampMs) == 0;
+  }
+
+  /// Take the next decoded frame, if one is ready
+  DecodedI420Frame? pull() {
+    if (_disposed) return null;
+    var result = _pull!(_decoderId, _output, _outputCapacity, _info);
+    if (result == -2) {
+      // First frame, or the camera changed size: grow and retry
+      if (_output != nullptr) calloc.free(_output);
+      _outputCapacity = _i420Length(_info[0], _info[1]);
+      _output = calloc<Uint8>(_outputCapacity);
+      result = _pull!(_decoderId, _output, _outputCapacity, _info);
+    }
+    if (result != 1) return null;
+
+    final width = _info[0];
+    final height = _info[1];
+    return DecodedI420Frame(
+      data: Uint8List.fromList(_output.asTypedList(_i420Length(width, height))),
+      width: width,
+      height: height,
+      timestampMs: _info[2],
+    );
+  }
+
+  static int _i420Length(int width, int height) =>
+      width * height + 2 * ((width + 1) ~/ 2) * ((height + 1) ~/ 2);
+
+  /// Decoder counters
+  MjpegDecoderStats? getStats() {
+    if (_disposed) return null;
+    final values = calloc<Uint64>(MjpegDecoderStats.valueCount);
+    try {
+      final count =
+          _getStats!(_decoderId, values, MjpegDecoderStats.valueCount);
+      if (count < 0) return null;
+      return MjpegDecoderStats.fromValues(
+        List<int>.generate(count, (i) => values[i]),
+      );
+    } finally {
+      calloc.free(values);
+    }
+  }
+
+  /// Dispose the decoder and its worker thread
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_decoderId);
+    if (_input != nullptr) calloc.free(_input);
+    if (_output != nullptr) calloc.free(_output);
+    calloc.free(_info);
+    _input = nullptr;
+    _output = nullptr;
+  }
+}
+
+/// MJPEG decoder counters
+class MjpegDecoderStats {
+  static const int valueCount = 4;
+
+  final int decoded;
+
+  /// Frames replaced before decoding, or decoded but never pulled
+  final int dropped;
+  final int errors;
+  final int decodeUs;
+
+  const MjpegDecoderStats({
+    required this.decoded,
+    required this.dropped,
+    required this.errors,
+    required this.decodeUs,
+  });
+
+  factory MjpegDecoderStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return MjpegDecoderStats(
+      decoded: at(0),
+      dropped: at(1),
+      errors: at(2),
+      decodeUs: at(3),
+    );
+  }
+
+  /// Average decode time per frame in milliseconds
+  double get averageDecodeMs => decoded == 0 ? 0 : decodeUs / decoded / 1000;
+
+  @override
+  String toString() =>
+      'MjpegDecoderStats(decoded: $decoded, dropped: $dropped, '
+      'errors: $errors, avg: ${averageDecodeMs.toStringAsFixed(2)}ms)';
+}
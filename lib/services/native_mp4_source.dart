@@ -0,0 +1,241 @@
+// Native MP4 file source FFI bindings
+//
+// Memory-maps an MP4 file in Rust and exposes its sample tables; sample
+// payloads are read as views of the mapping, without copying.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+import '../moq/publisher/file_publisher.dart';
+
+// FFI function signatures
+typedef Mp4SourceOpenNative = Uint64 Function(Pointer<Utf8> path);
+typedef Mp4SourceOpen = int Function(Pointer<Utf8> path);
+
+typedef Mp4SourceCloseNative = Void Function(Uint64 sourceId);
+typedef Mp4SourceClose = void Function(int sourceId);
+
+typedef Mp4SourceDataNative = Pointer<Uint8> Function(
+    Uint64 sourceId, Pointer<IntPtr> outLen);
+typedef Mp4SourceData = Pointer<Uint8> Function(
+    int sourceId, Pointer<IntPtr> outLen);
+
+typedef Mp4SourceTrackCountNative = Int32 Function(Uint64 sourceId);
+typedef Mp4SourceTrackCount = int Function(int sourceId);
+
+typedef Mp4SourceTrackInfoNative = Int32 Function(
+    Uint64 sourceId, Int32 index, Pointer<Int64> out, IntPtr len);
+typedef Mp4SourceTrackInfo = int Function(
+    int sourceId, int index, Pointer<Int64> out, int len);
+
+typedef Mp4SourceTrackDataNative = Pointer<Uint8> Function(
+    Uint64 sourceId, Int32 index, Pointer<IntPtr> outLen);
+typedef Mp4SourceTrackData = Pointer<Uint8> Function(
+    int sourceId, int index, Pointer<IntPtr> outLen);
+
+/// MP4 file opened by the native demuxer
+///
+/// The file stays mapped until [close]; samples returned before then are
+/// views of the mapping and must not be used afterwards.
+class NativeMp4Source implements FileMediaSource {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static Mp4SourceOpen? _open;
+  static Mp4SourceClose? _close;
+  static Mp4SourceData? _data;
+  static Mp4SourceTrackCount? _trackCount;
+  static Mp4SourceTrackInfo? _trackInfo;
+  static Mp4SourceTrackData? _codecConfig;
+  static Mp4SourceTrackData? _samples;
+
+  // Layout of the native Mp4Sample record
+  static const int _trackInfoValues = 11;
+  static const int _sampleSize = 32;
+  static const int _sampleSync = 1;
+
+  final int _sourceId;
+  final Uint8List _bytes;
+  final List<FileMediaTrack> _tracks;
+  final List<ByteData> _sampleTables;
+  bool _closed = false;
+
+  NativeMp4Source._(
+    this._sourceId,
+    this._bytes,
+    this._tracks,
+    this._sampleTables,
+  );
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _open = _lib!
+          .lookup<NativeFunction<Mp4SourceOpenNative>>('mp4_source_open')
+          .asFunction();
+
+      _close = _lib!
+          .lookup<NativeFunction<Mp4SourceCloseNative>>('mp4_source_close')
+          .asFunction();
+
+      _data = _lib!
+          .lookup<NativeFunction<Mp4SourceDataNative>>('mp4_source_data')
+          .asFunction();
+
+      _trackCount = _lib!
+          .lookup<NativeFunction<Mp4SourceTrackCountNative>>(
+              'mp4_source_track_count')
+          .asFunction();
+
+      _trackInfo = _lib!
+          .lookup<NativeFunction<Mp4SourceTrackInfoNative>>(
+              'mp4_source_track_info')
+          .asFunction();
+
+      _codecConfig = _lib!
+          .lookup<NativeFunction<Mp4SourceTrackDataNative>>(
+              'mp4_source_codec_config')
+          .asFunction();
+
+      _samples = _lib!
+          .lookup<NativeFunction<Mp4SourceTrackDataNative>>(
+              'mp4_source_samples')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native MP4 source library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native MP4 source library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native demuxer is available (needs the `mp4-source`
+  /// feature)
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Map [path] and read its sample tables, or null if the library is not
+  /// available or the file cannot be parsed
+  static NativeMp4Source? open(String path) {
+    if (!isAvailable) return null;
+
+    final pathPtr = path.toNativeUtf8();
+    final sourceId = _open!(pathPtr);
+    calloc.free(pathPtr);
+    if (sourceId == 0) return null;
+
+    final outLen = calloc<IntPtr>();
+    final info = calloc<Int64>(_trackInfoValues);
+    try {
+      final base = _data!(sourceId, outLen);
+      final bytes = base.asTypedList(outLen.value);
+
+      final tracks = <FileMediaTrack>[];
+      final sampleTables = <ByteData>[];
+      final count = _trackCount!(sourceId);
+      for (var i = 0; i < count; i++) {
+        if (_trackInfo!(sourceId, i, info, _trackInfoValues) <
+            _trackInfoValues) {
+          throw StateError('No info for track $i');
+        }
+        final config = _codecConfig!(sourceId, i, outLen);
+        final configBytes = Uint8List.fromList(
+          outLen.value == 0 ? const [] : config.asTypedList(outLen.value),
+        );
+        final records = _samples!(sourceId, i, outLen);
+        final sampleCount = outLen.value;
+        sampleTables.add(
+          sampleCount == 0
+              ? ByteData(0)
+              : ByteData.sublistView(
+                  records.asTypedList(sampleCount * _sampleSize),
+                ),
+        );
+
+        final fourcc = info[2];
+        tracks.add(
+          FileMediaTrack(
+            index: i,
+            kind: switch (info[1]) {
+              0 => FileTrackKind.video,
+              1 => FileTrackKind.audio,
+              _ => FileTrackKind.other,
+            },
+            fourcc: String.fromCharCodes([
+              (fourcc >> 24) & 0xFF,
+              (fourcc >> 16) & 0xFF,
+              (fourcc >> 8) & 0xFF,
+              fourcc & 0xFF,
+            ]),
+            durationUs: info[4],
+            sampleCount: sampleCount,
+            width: info[6],
+            height: info[7],
+            sampleRate: info[8],
+            channels: info[9],
+            codecConfig: configBytes,
+          ),
+        );
+      }
+
+      final source = NativeMp4Source._(sourceId, bytes, tracks, sampleTables);
+      _logger.i('Opened $path: ${tracks.join(', ')}');
+      return source;
+    } catch (e) {
+      _logger.e('Failed to read MP4 source $path: $e');
+      _close!(sourceId);
+      return null;
+    } finally {
+      calloc.free(outLen);
+      calloc.free(info);
+    }
+  }
+
+  @override
+  List<FileMediaTrack> get tracks => _tracks;
+
+  @override
+  FileMediaSample sample(int track, int index) {
+    if (_closed) throw StateError('MP4 source is closed');
+    final table = _sampleTables[track];
+    final at = index * _sampleSize;
+    final offset = table.getUint64(at, Endian.host);
+    final size = table.getUint32(at + 8, Endian.host);
+    return FileMediaSample(
+      dtsUs: table.getInt64(at + 16, Endian.host),
+      ptsUs: table.getInt64(at + 24, Endian.host),
+      isKeyframe: table.getUint32(at + 12, Endian.host) & _sampleSync != 0,
+      data: Uint8List.sublistView(_bytes, offset, offset + size),
+    );
+  }
+
+  /// Unmap the file
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    _close!(_sourceId);
+  }
+}
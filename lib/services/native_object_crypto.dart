@@ -0,0 +1,287 @@
+// Native Object Crypto FFI bindings
+//
+// SFrame-style AES-GCM payload encryption in Rust, using the CPU's AES
+// instructions. Objects are sealed and opened in place, a batch per call.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+import '../moq/client/moq_object_encryption.dart';
+
+/// One object of a native batch (mirrors `CryptoObject` in object_crypto.rs)
+final class NativeCryptoObject extends Struct {
+  @Uint64()
+  external int groupId;
+
+  @Uint64()
+  external int objectId;
+
+  @Uint64()
+  external int keyId;
+
+  external Pointer<Uint8> data;
+
+  @Size()
+  external int len;
+
+  @Size()
+  external int capacity;
+
+  @Int32()
+  external int status;
+}
+
+// FFI function signatures
+typedef ObjectCryptoCreateNative = Uint64 Function();
+typedef ObjectCryptoCreate = int Function();
+
+typedef ObjectCryptoDestroyNative = Void Function(Uint64 cryptoId);
+typedef ObjectCryptoDestroy = void Function(int cryptoId);
+
+typedef ObjectCryptoMaxOverheadNative = Size Function();
+typedef ObjectCryptoMaxOverhead = int Function();
+
+typedef ObjectCryptoSetKeyNative = Int32 Function(Uint64 cryptoId,
+    Uint64 keyId, Pointer<Uint8> track, Size trackLen, Pointer<Uint8> baseKey,
+    Size len);
+typedef ObjectCryptoSetKey = int Function(int cryptoId, int keyId,
+    Pointer<Uint8> track, int trackLen, Pointer<Uint8> baseKey, int len);
+
+typedef ObjectCryptoRemoveKeyNative = Int32 Function(
+    Uint64 cryptoId, Uint64 keyId);
+typedef ObjectCryptoRemoveKey = int Function(int cryptoId, int keyId);
+
+typedef ObjectCryptoBatchNative = Int32 Function(
+    Uint64 cryptoId, Pointer<NativeCryptoObject> objects, Size count);
+typedef ObjectCryptoBatch = int Function(
+    int cryptoId, Pointer<NativeCryptoObject> objects, int count);
+
+/// Native end-to-end object encryption
+///
+/// Holds the base key of every key ID in use; per-track keys and nonce salts
+/// are derived natively, bound to the track's full name. Use with
+/// [MoQObjectEncryption].
+class NativeObjectCrypto implements ObjectCipher {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static ObjectCryptoCreate? _create;
+  static ObjectCryptoDestroy? _destroy;
+  static ObjectCryptoMaxOverhead? _maxOverhead;
+  static ObjectCryptoSetKey? _setKey;
+  static ObjectCryptoRemoveKey? _removeKey;
+  static ObjectCryptoBatch? _sealBatch;
+  static ObjectCryptoBatch? _openBatch;
+
+  /// Context ID
+  final int _cryptoId;
+  final int _overhead;
+  bool _disposed = false;
+
+  // Reused batch descriptors and payload arena, grown on demand
+  Pointer<NativeCryptoObject> _objects = nullptr;
+  int _objectCapacity = 0;
+  Pointer<Uint8> _arena = nullptr;
+  int _arenaCapacity = 0;
+
+  NativeObjectCrypto._(this._cryptoId, this._overhead);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<ObjectCryptoCreateNative>>(
+              'object_crypto_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<ObjectCryptoDestroyNative>>(
+              'object_crypto_destroy')
+          .asFunction();
+
+      _maxOverhead = _lib!
+          .lookup<NativeFunction<ObjectCryptoMaxOverheadNative>>(
+              'object_crypto_max_overhead')
+          .asFunction();
+
+      _setKey = _lib!
+          .lookup<NativeFunction<ObjectCryptoSetKeyNative>>(
+              'object_crypto_set_key')
+          .asFunction();
+
+      _removeKey = _lib!
+          .lookup<NativeFunction<ObjectCryptoRemoveKeyNative>>(
+              'object_crypto_remove_key')
+          .asFunction();
+
+      _sealBatch = _lib!
+          .lookup<NativeFunction<ObjectCryptoBatchNative>>(
+              'object_crypto_seal_batch')
+          .asFunction();
+
+      _openBatch = _lib!
+          .lookup<NativeFunction<ObjectCryptoBatchNative>>(
+              'object_crypto_open_batch')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native object crypto library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native object crypto: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if native object crypto is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create an encryption context
+  ///
+  /// Returns null if the native library is not available
+  static NativeObjectCrypto? create() {
+    try {
+      _initLib();
+      final cryptoId = _create!();
+      return NativeObjectCrypto._(cryptoId, _maxOverhead!());
+    } catch (e) {
+      _logger.e('Failed to create native object crypto: $e');
+      return null;
+    }
+  }
+
+  /// Install or rotate the base key of [keyId] for one track
+  ///
+  /// Fails if [keyId] is already bound to another track. Use a fresh base
+  /// key for every publishing session, as nonces follow the group IDs.
+  bool setKey(
+    int keyId,
+    List<Uint8List> trackNamespace,
+    Uint8List trackName,
+    Uint8List baseKey,
+  ) {
+    if (_disposed || baseKey.isEmpty) return false;
+    final fullName = encodeFullTrackName(trackNamespace, trackName);
+    final track = calloc<Uint8>(fullName.length);
+    final key = calloc<Uint8>(baseKey.length);
+    try {
+      track.asTypedList(fullName.length).setAll(0, fullName);
+      key.asTypedList(baseKey.length).setAll(0, baseKey);
+      return _setKey!(_cryptoId, keyId, track, fullName.length, key,
+              baseKey.length) ==
+          0;
+    } finally {
+      key.asTypedList(baseKey.length).fillRange(0, baseKey.length, 0);
+      calloc.free(key);
+      calloc.free(track);
+    }
+  }
+
+  /// Forget [keyId]
+  bool removeKey(int keyId) {
+    if (_disposed) return false;
+    return _removeKey!(_cryptoId, keyId) == 0;
+  }
+
+  @override
+  List<Uint8List?> sealBatch(int keyId, List<ObjectPayload> objects) =>
+      _run(objects, keyId, _sealBatch!);
+
+  @override
+  List<Uint8List?> openBatch(List<ObjectPayload> objects) =>
+      _run(objects, null, _openBatch!);
+
+  /// Dispose the context and its keys
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_cryptoId);
+    if (_objects != nullptr) calloc.free(_objects);
+    if (_arena != nullptr) calloc.free(_arena);
+    _objects = nullptr;
+    _arena = nullptr;
+  }
+
+  List<Uint8List?> _run(
+    List<ObjectPayload> objects,
+    int? keyId,
+    ObjectCryptoBatch batch,
+  ) {
+    if (_disposed) return List.filled(objects.length, null);
+    if (objects.isEmpty) return const [];
+
+    // Lay the payloads out back to back, each with room for the overhead
+    var arenaSize = 0;
+    for (final object in objects) {
+      arenaSize += object.payload.length + _overhead;
+    }
+    _reserve(objects.length, arenaSize);
+
+    var offset = 0;
+    for (var i = 0; i < objects.length; i++) {
+      final object = objects[i];
+      final capacity = object.payload.length + _overhead;
+      final data = _arena + offset;
+      data.asTypedList(object.payload.length).setAll(0, object.payload);
+      _objects[i]
+        ..groupId = object.groupId.toInt()
+        ..objectId = object.objectId.toInt()
+        ..keyId = keyId ?? object.keyId
+        ..data = data
+        ..len = object.payload.length
+        ..capacity = capacity
+        ..status = 0;
+      offset += capacity;
+    }
+
+    if (batch(_cryptoId, _objects, objects.length) < 0) {
+      return List.filled(objects.length, null);
+    }
+    return [
+      for (var i = 0; i < objects.length; i++)
+        _objects[i].status == 0
+            ? Uint8List.fromList(_objects[i].data.asTypedList(_objects[i].len))
+            : null,
+    ];
+  }
+
+  void _reserve(int count, int arenaSize) {
+    if (count > _objectCapacity) {
+      if (_objects != nullptr) calloc.free(_objects);
+      _objectCapacity = count * 2;
+      _objects = calloc<NativeCryptoObject>(_objectCapacity);
+    }
+    if (arenaSize > _arenaCapacity) {
+      if (_arena != nullptr) calloc.free(_arena);
+      _arenaCapacity = arenaSize * 2;
+      _arena = calloc<Uint8>(_arenaCapacity);
+    }
+  }
+}
@@ -0,0 +1,417 @@
+// Native playback sink FFI bindings
+//
+// A sink plays routed subscriptions without their media passing through Dart:
+// the transport reader tasks deframe the subgroup streams, mux moq-mi video to
+// fMP4 and write straight into a NativeMediaPlayer's buffer. Dart only routes
+// tracks (MoQTransport.routeTrackToNative), hands over objects that arrived
+// before the route existed, and polls events and counters.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+import 'native_media_player.dart';
+
+/// How objects on the routed tracks are packaged
+enum PlaybackSinkPackaging {
+  /// moq-mi / LOC: AVCC frames, muxed to fMP4 natively (video only)
+  moqMi(0),
+
+  /// CMAF: moof + mdat fragments of an init segment set by Dart
+  cmaf(1);
+
+  final int value;
+  const PlaybackSinkPackaging(this.value);
+}
+
+/// Role of a routed track
+enum PlaybackSinkTrack {
+  video(0),
+  audio(1);
+
+  final int value;
+  const PlaybackSinkTrack(this.value);
+}
+
+// FFI function signatures
+typedef MediaPlayerCreateSinkNative = Uint64 Function(
+    Uint64 playerId, Int32 packaging, Int32 width, Int32 height);
+typedef MediaPlayerCreateSink = int Function(
+    int playerId, int packaging, int width, int height);
+
+typedef PlaybackSinkDestroyNative = Void Function(Uint64 sinkId);
+typedef PlaybackSinkDestroy = void Function(int sinkId);
+
+typedef PlaybackSinkSetDataNative = Int32 Function(
+    Uint64 sinkId, Pointer<Uint8> data, IntPtr len);
+typedef PlaybackSinkSetData = int Function(
+    int sinkId, Pointer<Uint8> data, int len);
+
+typedef PlaybackSinkPushFrameNative = Int32 Function(
+  Uint64 sinkId,
+  Int32 track,
+  Uint64 groupId,
+  Uint64 objectId,
+  Int32 keyframe,
+  Uint64 duration,
+  Uint64 timebase,
+  Pointer<Uint8> config,
+  IntPtr configLen,
+  Pointer<Uint8> data,
+  IntPtr len,
+);
+typedef PlaybackSinkPushFrame = int Function(
+  int sinkId,
+  int track,
+  int groupId,
+  int objectId,
+  int keyframe,
+  int duration,
+  int timebase,
+  Pointer<Uint8> config,
+  int configLen,
+  Pointer<Uint8> data,
+  int len,
+);
+
+typedef PlaybackSinkGetStatsNative = Int32 Function(
+    Uint64 sinkId, Pointer<Uint64> out, IntPtr len);
+typedef PlaybackSinkGetStats = int Function(
+    int sinkId, Pointer<Uint64> out, int len);
+
+typedef PlaybackSinkPollEventNative = Int32 Function(
+    Uint64 sinkId, Pointer<Int32> outKind, Pointer<Uint64> outValue);
+typedef PlaybackSinkPollEvent = int Function(
+    int sinkId, Pointer<Int32> outKind, Pointer<Uint64> outValue);
+
+/// Native data plane feeding one [NativeMediaPlayer]
+class NativePlaybackSink {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static MediaPlayerCreateSink? _create;
+  static PlaybackSinkDestroy? _destroy;
+  static PlaybackSinkSetData? _setInitSegment;
+  static PlaybackSinkSetData? _setCodecConfig;
+  static PlaybackSinkPushFrame? _pushFrame;
+  static PlaybackSinkGetStats? _getStats;
+  static PlaybackSinkPollEvent? _pollEvent;
+
+  final int _sinkId;
+  final PlaybackSinkPackaging packaging;
+  bool _disposed = false;
+
+  NativePlaybackSink._(this._sinkId, this.packaging);
+
+  /// Native sink ID, passed to MoQTransport.routeTrackToNative
+  int get sinkId => _sinkId;
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<MediaPlayerCreateSinkNative>>(
+              'media_player_create_sink')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<PlaybackSinkDestroyNative>>(
+              'playback_sink_destroy')
+          .asFunction();
+
+      _setInitSegment = _lib!
+          .lookup<NativeFunction<PlaybackSinkSetDataNative>>(
+              'playback_sink_set_init_segment')
+          .asFunction();
+
+      _setCodecConfig = _lib!
+          .lookup<NativeFunction<PlaybackSinkSetDataNative>>(
+              'playback_sink_set_codec_config')
+          .asFunction();
+
+      _pushFrame = _lib!
+          .lookup<NativeFunction<PlaybackSinkPushFrameNative>>(
+              'playback_sink_push_frame')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<PlaybackSinkGetStatsNative>>(
+              'playback_sink_get_stats')
+          .asFunction();
+
+      _pollEvent = _lib!
+          .lookup<NativeFunction<PlaybackSinkPollEventNative>>(
+              'playback_sink_poll_event')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native playback sink library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native playback sink library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if playback sinks are available (needs the `media-player` feature)
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a sink writing into [player]'s buffer
+  ///
+  /// [width] and [height] go into the moq-mi init segment. Returns null if the
+  /// library or player is not available.
+  static NativePlaybackSink? create(
+    NativeMediaPlayer player, {
+    required PlaybackSinkPackaging packaging,
+    int width = 0,
+    int height = 0,
+  }) {
+    try {
+      _initLib();
+
+      final sinkId = _create!(player.playerId, packaging.value, width, height);
+      if (sinkId == 0) {
+        _logger.e('Failed to create playback sink');
+        return null;
+      }
+
+      _logger.i('Created playback sink $sinkId for player ${player.playerId}');
+      return NativePlaybackSink._(sinkId, packaging);
+    } catch (e) {
+      _logger.e('Failed to create playback sink: $e');
+      return null;
+    }
+  }
+
+  /// Write the init segment covering every routed track (CMAF)
+  bool setInitSegment(Uint8List init) => _setData(_setInitSegment!, init);
+
+  /// Write the moq-mi init segment from an AVC decoder configuration record,
+  /// e.g. from the catalog, before the first keyframe arrives
+  bool setCodecConfig(Uint8List avcc) => _setData(_setCodecConfig!, avcc);
+
+  bool _setData(PlaybackSinkSetData fn, Uint8List data) {
+    if (_disposed || data.isEmpty) return false;
+
+    final ptr = calloc<Uint8>(data.length);
+    try {
+      ptr.asTypedList(data.length).setAll(0, data);
+      return fn(_sinkId, ptr, data.length) == 0;
+    } finally {
+      calloc.free(ptr);
+    }
+  }
+
+  /// Hand over an object that reached Dart before its track was routed
+  ///
+  /// [keyframe] is detected from the data when null. [duration] and
+  /// [timebase] are the moq-mi frame duration; [config] is the AVC decoder
+  /// configuration carried by the object, if any.
+  bool pushFrame({
+    required PlaybackSinkTrack track,
+    required int groupId,
+    required int objectId,
+    required Uint8List data,
+    bool? keyframe,
+    int duration = 0,
+    int timebase = 0,
+    Uint8List? config,
+  }) {
+    if (_disposed || data.isEmpty) return false;
+
+    final configLen = config?.length ?? 0;
+    final ptr = calloc<Uint8>(data.length + configLen);
+    try {
+      final bytes = ptr.asTypedList(data.length + configLen);
+      bytes.setAll(0, data);
+      if (config != null) bytes.setAll(data.length, config);
+      return _pushFrame!(
+            _sinkId,
+            track.value,
+            groupId,
+            objectId,
+            keyframe == null ? -1 : (keyframe ? 1 : 0),
+            duration,
+            timebase,
+            configLen == 0 ? nullptr : ptr + data.length,
+            configLen,
+            ptr,
+            data.length,
+          ) ==
+          0;
+    } finally {
+      calloc.free(ptr);
+    }
+  }
+
+  /// Get the sink's counters
+  PlaybackSinkStats getStats() {
+    if (_disposed) return PlaybackSinkStats.fromValues(const []);
+
+    final out = calloc<Uint64>(PlaybackSinkStats.valueCount);
+    try {
+      final count = _getStats!(_sinkId, out, PlaybackSinkStats.valueCount);
+      if (count <= 0) return PlaybackSinkStats.fromValues(const []);
+      return PlaybackSinkStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Take all events raised since the last call
+  List<PlaybackSinkEvent> pollEvents() {
+    if (_disposed) return const [];
+
+    final kind = calloc<Int32>();
+    final value = calloc<Uint64>();
+    try {
+      final events = <PlaybackSinkEvent>[];
+      while (_pollEvent!(_sinkId, kind, value) == 1) {
+        final type = PlaybackSinkEventType.fromValue(kind.value);
+        if (type != null) events.add(PlaybackSinkEvent(type, value.value));
+      }
+      return events;
+    } finally {
+      calloc.free(kind);
+      calloc.free(value);
+    }
+  }
+
+  /// Release the sink; streams still routed to it are drained and discarded
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_sinkId);
+    _logger.i('Disposed playback sink: $_sinkId');
+  }
+}
+
+/// Kinds of [PlaybackSinkEvent]
+enum PlaybackSinkEventType {
+  /// An init segment was written; the player can start
+  initWritten(1),
+
+  /// The first keyframe was written; value is its group
+  firstKeyframe(2),
+
+  /// The publisher ended a track; value is the [PlaybackSinkTrack] index
+  endOfTrack(3),
+
+  /// A routed stream ended mid-object or had a bad header
+  streamError(4),
+
+  /// The player buffer was full; value is the bytes dropped
+  bufferOverflow(5);
+
+  final int value;
+  const PlaybackSinkEventType(this.value);
+
+  static PlaybackSinkEventType? fromValue(int value) {
+    for (final type in values) {
+      if (type.value == value) return type;
+    }
+    return null;
+  }
+}
+
+/// Something the sink reported
+class PlaybackSinkEvent {
+  final PlaybackSinkEventType type;
+  final int value;
+
+  const PlaybackSinkEvent(this.type, this.value);
+
+  @override
+  String toString() => 'PlaybackSinkEvent(${type.name}, $value)';
+}
+
+/// Playback sink counters
+class PlaybackSinkStats {
+  /// Number of values reported by playback_sink_get_stats
+  static const int valueCount = 12;
+
+  final int objects;
+  final int payloadBytes;
+  final int videoFrames;
+  final int audioFrames;
+  final int skippedFrames;
+  final int lateObjects;
+  final int bytesWritten;
+  final int bytesDropped;
+
+  /// Subgroup streams deframed natively
+  final int nativeStreams;
+
+  /// Objects handed over from Dart with [NativePlaybackSink.pushFrame]
+  final int handedOver;
+  final int streamErrors;
+
+  /// Objects replayed from the track's replay cache when the sink attached
+  final int replayed;
+
+  const PlaybackSinkStats({
+    this.objects = 0,
+    this.payloadBytes = 0,
+    this.videoFrames = 0,
+    this.audioFrames = 0,
+    this.skippedFrames = 0,
+    this.lateObjects = 0,
+    this.bytesWritten = 0,
+    this.bytesDropped = 0,
+    this.nativeStreams = 0,
+    this.handedOver = 0,
+    this.streamErrors = 0,
+    this.replayed = 0,
+  });
+
+  factory PlaybackSinkStats.fromValues(List<int> values) {
+    int at(int i) => i < values.length ? values[i] : 0;
+    return PlaybackSinkStats(
+      objects: at(0),
+      payloadBytes: at(1),
+      videoFrames: at(2),
+      audioFrames: at(3),
+      skippedFrames: at(4),
+      lateObjects: at(5),
+      bytesWritten: at(6),
+      bytesDropped: at(7),
+      nativeStreams: at(8),
+      handedOver: at(9),
+      streamErrors: at(10),
+      replayed: at(11),
+    );
+  }
+
+  @override
+  String toString() =>
+      'PlaybackSinkStats(objects: $objects, video: $videoFrames, '
+      'audio: $audioFrames, skipped: $skippedFrames, late: $lateObjects, '
+      'written: $bytesWritten, dropped: $bytesDropped, '
+      'native streams: $nativeStreams, handed over: $handedOver, '
+      'replayed: $replayed, errors: $streamErrors)';
+}
@@ -0,0 +1,316 @@
+// Native publish pipeline FFI bindings
+//
+// A pipeline publishes one moq-mi video track without its media passing
+// through Dart: frames from a native screen capture (or pushed as I420) are
+// encoded, packaged and sent on native threads, with bounded queues between
+// the stages. Dart creates it on a transport
+// (MoQTransport.createPublishPipeline), starts it and polls counters.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+import '../moq/transport/moq_transport.dart';
+
+// FFI function signatures
+typedef PublishPipelineStartNative = Int32 Function(Uint64 pipelineId,
+    Uint32 width, Uint32 height, Uint32 fps, Uint32 bitrate, Uint32 gop);
+typedef PublishPipelineStart = int Function(
+    int pipelineId, int width, int height, int fps, int bitrate, int gop);
+
+typedef PublishPipelinePushFrameNative = Int32 Function(
+    Uint64 pipelineId, Pointer<Uint8> data, IntPtr len);
+typedef PublishPipelinePushFrame = int Function(
+    int pipelineId, Pointer<Uint8> data, int len);
+
+typedef PublishPipelineAttachScreenCaptureNative = Int32 Function(
+    Uint64 pipelineId, Uint64 captureId);
+typedef PublishPipelineAttachScreenCapture = int Function(
+    int pipelineId, int captureId);
+
+typedef PublishPipelineGetStatsNative = Int32 Function(
+    Uint64 pipelineId, Pointer<Uint64> out, IntPtr len);
+typedef PublishPipelineGetStats = int Function(
+    int pipelineId, Pointer<Uint64> out, int len);
+
+typedef PublishPipelineDestroyNative = Void Function(Uint64 pipelineId);
+typedef PublishPipelineDestroy = void Function(int pipelineId);
+
+/// Native capture -> encode -> package -> send pipeline for one video track
+class NativePublishPipeline {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static PublishPipelineStart? _start;
+  static PublishPipelinePushFrame? _pushFrame;
+  static PublishPipelineAttachScreenCapture? _attachScreenCapture;
+  static PublishPipelineGetStats? _getStats;
+  static PublishPipelineDestroy? _destroy;
+
+  final int _pipelineId;
+  int _frameLength = 0;
+  Pointer<Uint8>? _frameBuffer;
+  bool _disposed = false;
+
+  NativePublishPipeline._(this._pipelineId);
+
+  /// Native pipeline ID
+  int get pipelineId => _pipelineId;
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _start = _lib!
+          .lookup<NativeFunction<PublishPipelineStartNative>>(
+              'publish_pipeline_start')
+          .asFunction();
+
+      _pushFrame = _lib!
+          .lookup<NativeFunction<PublishPipelinePushFrameNative>>(
+              'publish_pipeline_push_frame')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<PublishPipelineGetStatsNative>>(
+              'publish_pipeline_get_stats')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<PublishPipelineDestroyNative>>(
+              'publish_pipeline_destroy')
+          .asFunction();
+
+      // Only built with the screen-capture feature on Linux
+      if (_lib!.providesSymbol('publish_pipeline_attach_screen_capture')) {
+        _attachScreenCapture = _lib!
+            .lookup<NativeFunction<PublishPipelineAttachScreenCaptureNative>>(
+                'publish_pipeline_attach_screen_capture')
+            .asFunction();
+      }
+
+      _initialized = true;
+      _logger.i('Native publish pipeline library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native publish pipeline library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if native publishing is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a pipeline publishing [trackAlias] on [transport]
+  ///
+  /// Returns null if the library or transport does not support it.
+  static NativePublishPipeline? create(
+    MoQTransport transport, {
+    required int trackAlias,
+    required int priority,
+    required int version,
+  }) {
+    try {
+      _initLib();
+
+      final pipelineId = transport.createPublishPipeline(
+        trackAlias,
+        priority: priority,
+        version: version,
+      );
+      if (pipelineId == null) {
+        _logger.e('Failed to create publish pipeline');
+        return null;
+      }
+
+      _logger.i('Created publish pipeline $pipelineId for track $trackAlias');
+      return NativePublishPipeline._(pipelineId);
+    } catch (e) {
+      _logger.e('Failed to create publish pipeline: $e');
+      return null;
+    }
+  }
+
+  /// Start the encoder (ffmpeg with libx264) and the stage threads
+  ///
+  /// [width] and [height] must be even; [gopSize] frames make one group.
+  /// Returns false if the settings are invalid, the pipeline was already
+  /// started or the encoder could not be started.
+  bool start({
+    required int width,
+    required int height,
+    int frameRate = 30,
+    int bitrate = 2000000,
+    int gopSize = 30,
+  }) {
+    if (_disposed) return false;
+
+    final result =
+        _start!(_pipelineId, width, height, frameRate, bitrate, gopSize);
+    if (result != 0) {
+      _logger.e('Failed to start publish pipeline $_pipelineId: $result');
+      return false;
+    }
+    _frameLength = width * height * 3 ~/ 2;
+    return true;
+  }
+
+  /// Feed the pipeline from a native screen capture (NativeScreenCapture)
+  /// whose output size matches the pipeline's; Linux only
+  bool attachScreenCapture(int captureId) {
+    if (_disposed || _attachScreenCapture == null) return false;
+    return _attachScreenCapture!(_pipelineId, captureId) == 0;
+  }
+
+  /// Queue an I420 frame, e.g. from a platform camera
+  ///
+  /// Returns false if the pipeline is not running or the frame has the wrong
+  /// size. The oldest queued frame is dropped when the encoder falls behind.
+  bool pushFrame(Uint8List i420) {
+    if (_disposed || i420.length != _frameLength) return false;
+
+    final buffer = _frameBuffer ??= calloc<Uint8>(_frameLength);
+    buffer.asTypedList(_frameLength).setAll(0, i420);
+    return _pushFrame!(_pipelineId, buffer, _frameLength) == 0;
+  }
+
+  /// Get the pipeline's counters and stage latencies
+  PublishPipelineStats getStats() {
+    if (_disposed) return PublishPipelineStats.fromValues(const []);
+
+    final out = calloc<Uint64>(PublishPipelineStats.valueCount);
+    try {
+      final count =
+          _getStats!(_pipelineId, out, PublishPipelineStats.valueCount);
+      if (count <= 0) return PublishPipelineStats.fromValues(const []);
+      return PublishPipelineStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Stop the pipeline, flushing the encoder and finishing the open stream
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_pipelineId);
+    if (_frameBuffer != null) {
+      calloc.free(_frameBuffer!);
+      _frameBuffer = null;
+    }
+    _logger.i('Disposed publish pipeline: $_pipelineId');
+  }
+}
+
+/// p50 and p99 of one pipeline stage
+class StageLatency {
+  final Duration p50;
+  final Duration p99;
+
+  const StageLatency(this.p50, this.p99);
+
+  @override
+  String toString() =>
+      'p50 ${(p50.inMicroseconds / 1000).toStringAsFixed(2)} ms, '
+      'p99 ${(p99.inMicroseconds / 1000).toStringAsFixed(2)} ms';
+}
+
+/// Publish pipeline counters
+class PublishPipelineStats {
+  /// Number of values reported by publish_pipeline_get_stats
+  static const int valueCount = 18;
+
+  final int framesCaptured;
+
+  /// Frames dropped because the encoder fell behind
+  final int captureDropped;
+  final int framesEncoded;
+  final int framesSent;
+
+  /// Frames dropped because the transport fell behind (whole groups)
+  final int sendDropped;
+  final int bytesSent;
+  final int groups;
+  final int errors;
+
+  /// Capture until the encoder took the frame
+  final StageLatency queue;
+  final StageLatency encode;
+  final StageLatency package;
+
+  /// Packaged until the transport accepted the object
+  final StageLatency send;
+
+  /// Capture until the transport accepted the frame
+  final StageLatency total;
+
+  const PublishPipelineStats({
+    this.framesCaptured = 0,
+    this.captureDropped = 0,
+    this.framesEncoded = 0,
+    this.framesSent = 0,
+    this.sendDropped = 0,
+    this.bytesSent = 0,
+    this.groups = 0,
+    this.errors = 0,
+    this.queue = const StageLatency(Duration.zero, Duration.zero),
+    this.encode = const StageLatency(Duration.zero, Duration.zero),
+    this.package = const StageLatency(Duration.zero, Duration.zero),
+    this.send = const StageLatency(Duration.zero, Duration.zero),
+    this.total = const StageLatency(Duration.zero, Duration.zero),
+  });
+
+  factory PublishPipelineStats.fromValues(List<int> values) {
+    int at(int i) => i < values.length ? values[i] : 0;
+    StageLatency stage(int index) => StageLatency(
+          Duration(microseconds: at(8 + 2 * index)),
+          Duration(microseconds: at(9 + 2 * index)),
+        );
+    return PublishPipelineStats(
+      framesCaptured: at(0),
+      captureDropped: at(1),
+      framesEncoded: at(2),
+      framesSent: at(3),
+      sendDropped: at(4),
+      bytesSent: at(5),
+      groups: at(6),
+      errors: at(7),
+      queue: stage(0),
+      encode: stage(1),
+      package: stage(2),
+      send: stage(3),
+      total: stage(4),
+    );
+  }
+
+  @override
+  String toString() =>
+      'PublishPipelineStats(captured: $framesCaptured, '
+      'capture dropped: $captureDropped, encoded: $framesEncoded, '
+      'sent: $framesSent, send dropped: $sendDropped, bytes: $bytesSent, '
+      'groups: $groups, errors: $errors, capture to send: $total)';
+}
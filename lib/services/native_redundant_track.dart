@@ -0,0 +1,258 @@
+// Native redundant track FFI bindings
+//
+// A redundant track merges one track subscribed through several relays:
+// each subscription is routed into it as a path
+// (MoQTransport.routeTrackToRedundant), the first copy of every object is
+// played through the attached sinks and later copies are dropped. Per-path
+// arrival delay is measured against the first copy; a path that stays
+// behind the best one is reported as demoted, and as promoted once it
+// catches up again.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef RedundantTrackCreateNative = Uint64 Function(
+    Int32 track, Uint64 version, Uint64 replayBytes, Uint32 demoteLagMs);
+typedef RedundantTrackCreate = int Function(
+    int track, int version, int replayBytes, int demoteLagMs);
+
+typedef RedundantTrackAttachSinkNative = Int32 Function(
+    Uint64 trackId, Uint64 sinkId);
+typedef RedundantTrackAttachSink = int Function(int trackId, int sinkId);
+
+typedef RedundantTrackGetPathStatsNative = Int32 Function(
+    Uint64 trackId, Uint32 path, Pointer<Uint64> out, IntPtr len);
+typedef RedundantTrackGetPathStats = int Function(
+    int trackId, int path, Pointer<Uint64> out, int len);
+
+typedef RedundantTrackPollEventNative = Int32 Function(
+    Uint64 trackId, Pointer<Int32> outKind, Pointer<Uint32> outPath);
+typedef RedundantTrackPollEvent = int Function(
+    int trackId, Pointer<Int32> outKind, Pointer<Uint32> outPath);
+
+typedef RedundantTrackDestroyNative = Void Function(Uint64 trackId);
+typedef RedundantTrackDestroy = void Function(int trackId);
+
+/// A path changed role
+class RedundantPathEvent {
+  final int path;
+
+  /// True if the path fell behind, false if it caught up again
+  final bool demoted;
+
+  const RedundantPathEvent({required this.path, required this.demoted});
+
+  @override
+  String toString() =>
+      'RedundantPathEvent(path: $path, ${demoted ? 'demoted' : 'promoted'})';
+}
+
+/// One track merged from several relay subscriptions
+class NativeRedundantTrack {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static RedundantTrackCreate? _create;
+  static RedundantTrackAttachSink? _attachSink;
+  static RedundantTrackGetPathStats? _getPathStats;
+  static RedundantTrackPollEvent? _pollEvent;
+  static RedundantTrackDestroy? _destroy;
+
+  final int _trackId;
+  bool _disposed = false;
+
+  NativeRedundantTrack._(this._trackId);
+
+  /// Native track ID, passed to MoQTransport.routeTrackToRedundant
+  int get trackId => _trackId;
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<RedundantTrackCreateNative>>(
+              'redundant_track_create')
+          .asFunction();
+
+      _attachSink = _lib!
+          .lookup<NativeFunction<RedundantTrackAttachSinkNative>>(
+              'redundant_track_attach_sink')
+          .asFunction();
+
+      _getPathStats = _lib!
+          .lookup<NativeFunction<RedundantTrackGetPathStatsNative>>(
+              'redundant_track_get_path_stats')
+          .asFunction();
+
+      _pollEvent = _lib!
+          .lookup<NativeFunction<RedundantTrackPollEventNative>>(
+              'redundant_track_poll_event')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<RedundantTrackDestroyNative>>(
+              'redundant_track_destroy')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native redundant track library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native redundant track library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native library is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a redundant track
+  ///
+  /// [track] is 0 for video and 1 for audio, [version] the negotiated MoQ
+  /// version of every path. With [replayCacheBytes] a sink attached later
+  /// starts at the newest cached group. A path is demoted once its smoothed
+  /// arrival delay exceeds the best path's by [demoteLag].
+  /// Returns null on failure.
+  static NativeRedundantTrack? create({
+    required int track,
+    required int version,
+    int replayCacheBytes = 0,
+    Duration demoteLag = const Duration(milliseconds: 40),
+  }) {
+    _initLib();
+    final id =
+        _create!(track, version, replayCacheBytes, demoteLag.inMilliseconds);
+    if (id == 0) {
+      _logger.e('Failed to create redundant track');
+      return null;
+    }
+    return NativeRedundantTrack._(id);
+  }
+
+  /// Play the merged track through a native sink (NativePlaybackSink.sinkId)
+  bool attachSink(int sinkId) =>
+      !_disposed && _attachSink!(_trackId, sinkId) == 0;
+
+  /// Take the path events that happened since the last call
+  List<RedundantPathEvent> pollEvents() {
+    if (_disposed) return const [];
+    final kind = calloc<Int32>();
+    final path = calloc<Uint32>();
+    try {
+      final events = <RedundantPathEvent>[];
+      while (_pollEvent!(_trackId, kind, path) == 1) {
+        events.add(RedundantPathEvent(path: path.value, demoted: kind.value == 1));
+      }
+      return events;
+    } finally {
+      calloc.free(kind);
+      calloc.free(path);
+    }
+  }
+
+  /// Counters of one path; null if the path does not exist
+  RedundantPathStats? getPathStats(int path) {
+    if (_disposed) return null;
+    final out = calloc<Uint64>(RedundantPathStats.valueCount);
+    try {
+      final count =
+          _getPathStats!(_trackId, path, out, RedundantPathStats.valueCount);
+      if (count <= 0) return null;
+      return RedundantPathStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Destroy the track; unroute its paths first
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_trackId);
+  }
+}
+
+/// Arrival counters of one path of a redundant track
+class RedundantPathStats {
+  /// Number of values reported by redundant_track_get_path_stats
+  static const int valueCount = 9;
+
+  /// Objects received on the path
+  final int objects;
+
+  /// Objects this path delivered first
+  final int wins;
+  final int duplicates;
+
+  /// Objects the path had not delivered when they left the dedup window
+  final int missing;
+
+  /// Objects that arrived after leaving the dedup window
+  final int late;
+
+  /// Delay behind the first copy
+  final Duration lagP50;
+  final Duration lagP99;
+  final Duration lagSmoothed;
+  final bool demoted;
+
+  const RedundantPathStats({
+    this.objects = 0,
+    this.wins = 0,
+    this.duplicates = 0,
+    this.missing = 0,
+    this.late = 0,
+    this.lagP50 = Duration.zero,
+    this.lagP99 = Duration.zero,
+    this.lagSmoothed = Duration.zero,
+    this.demoted = false,
+  });
+
+  factory RedundantPathStats.fromValues(List<int> values) {
+    int at(int i) => i < values.length ? values[i] : 0;
+    return RedundantPathStats(
+      objects: at(0),
+      wins: at(1),
+      duplicates: at(2),
+      missing: at(3),
+      late: at(4),
+      lagP50: Duration(microseconds: at(5)),
+      lagP99: Duration(microseconds: at(6)),
+      lagSmoothed: Duration(microseconds: at(7)),
+      demoted: at(8) != 0,
+    );
+  }
+
+  @override
+  String toString() =>
+      'RedundantPathStats(objects: $objects, wins: $wins, missing: $missing, '
+      'lag p50: ${lagP50.inMicroseconds}µs, '
+      'p99: ${lagP99.inMicroseconds}µs${demoted ? ', demoted' : ''})';
+}
@@ -0,0 +1,252 @@
+// Native Screen Capture FFI bindings
+//
+// Grabs the X11 screen (or one window) through MIT-SHM in Rust, finds the
+// tiles that changed and converts only those into a persistent I420 frame.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef ScreenCaptureOpenNative = Uint64 Function(
+    Pointer<Utf8> display, Uint64 window, Int32 outWidth, Int32 outHeight);
+typedef ScreenCaptureOpen = int Function(
+    Pointer<Utf8> display, int window, int outWidth, int outHeight);
+
+typedef ScreenCaptureCloseNative = Void Function(Uint64 captureId);
+typedef ScreenCaptureClose = void Function(int captureId);
+
+typedef ScreenCaptureSizeNative = Int32 Function(
+    Uint64 captureId, Pointer<Int32> outWidth, Pointer<Int32> outHeight);
+typedef ScreenCaptureSize = int Function(
+    int captureId, Pointer<Int32> outWidth, Pointer<Int32> outHeight);
+
+typedef ScreenCaptureGrabNative = Int32 Function(
+    Uint64 captureId, Pointer<Uint8> out, IntPtr len);
+typedef ScreenCaptureGrab = int Function(
+    int captureId, Pointer<Uint8> out, int len);
+
+typedef ScreenCaptureGetStatsNative = Int32 Function(
+    Uint64 captureId, Pointer<Uint64> outStats, IntPtr len);
+typedef ScreenCaptureGetStats = int Function(
+    int captureId, Pointer<Uint64> outStats, int len);
+
+/// Result of [NativeScreenCapture.grab]
+enum ScreenGrabResult {
+  /// The screen changed; [NativeScreenCapture.frame] holds the new contents
+  changed,
+
+  /// Nothing changed since the previous grab
+  unchanged,
+
+  /// The captured window was resized or closed; reopen the capture
+  lost,
+
+  error,
+}
+
+/// Native X11 screen capture with damage detection
+///
+/// Only available on Linux builds with the `screen-capture` feature. Works on
+/// X11 sessions; under Wayland only X11 windows are visible to it.
+class NativeScreenCapture {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static ScreenCaptureOpen? _open;
+  static ScreenCaptureClose? _close;
+  static ScreenCaptureSize? _size;
+  static ScreenCaptureGrab? _grab;
+  static ScreenCaptureGetStats? _getStats;
+
+  /// Capture instance ID
+  final int _captureId;
+  final int width;
+  final int height;
+  final Pointer<Uint8> _buffer;
+  final int _bufferLength;
+  bool _closed = false;
+
+  NativeScreenCapture._(this._captureId, this.width, this.height)
+    : _bufferLength = width * height * 3 ~/ 2,
+      _buffer = calloc<Uint8>(width * height * 3 ~/ 2);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else {
+        throw UnsupportedError('Screen capture is only supported on Linux');
+      }
+
+      _open = _lib!
+          .lookup<NativeFunction<ScreenCaptureOpenNative>>(
+              'screen_capture_open')
+          .asFunction();
+
+      _close = _lib!
+          .lookup<NativeFunction<ScreenCaptureCloseNative>>(
+              'screen_capture_close')
+          .asFunction();
+
+      _size = _lib!
+          .lookup<NativeFunction<ScreenCaptureSizeNative>>(
+              'screen_capture_size')
+          .asFunction();
+
+      _grab = _lib!
+          .lookup<NativeFunction<ScreenCaptureGrabNative>>(
+              'screen_capture_grab')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<ScreenCaptureGetStatsNative>>(
+              'screen_capture_get_stats')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native screen capture library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native screen capture: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if native screen capture is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Open a capture of [windowId] (0 = whole screen) on [display] (null =
+  /// $DISPLAY), scaled to [width] x [height] (0 = capture size)
+  ///
+  /// Returns null if the library or the X server's MIT-SHM extension is not
+  /// available
+  static NativeScreenCapture? open({
+    String? display,
+    int windowId = 0,
+    int width = 0,
+    int height = 0,
+  }) {
+    try {
+      _initLib();
+      final displayName = display == null ? nullptr : display.toNativeUtf8();
+      final int captureId;
+      try {
+        captureId = _open!(displayName, windowId, width, height);
+      } finally {
+        if (displayName != nullptr) calloc.free(displayName);
+      }
+      if (captureId == 0) return null;
+
+      final outWidth = calloc<Int32>();
+      final outHeight = calloc<Int32>();
+      try {
+        _size!(captureId, outWidth, outHeight);
+        return NativeScreenCapture._(captureId, outWidth.value, outHeight.value);
+      } finally {
+        calloc.free(outWidth);
+        calloc.free(outHeight);
+      }
+    } catch (e) {
+      _logger.e('Failed to open native screen capture: $e');
+      return null;
+    }
+  }
+
+  /// The latest I420 frame (a view of native memory, valid until [close])
+  Uint8List get frame => _buffer.asTypedList(_bufferLength);
+
+  /// Grab the screen, updating [frame] if it changed
+  ScreenGrabResult grab() {
+    if (_closed) return ScreenGrabResult.error;
+    final result = _grab!(_captureId, _buffer, _bufferLength);
+    if (result == 1) return ScreenGrabResult.changed;
+    if (result == 0) return ScreenGrabResult.unchanged;
+    return result == -6 ? ScreenGrabResult.lost : ScreenGrabResult.error;
+  }
+
+  /// Capture counters
+  ScreenCaptureStats? getStats() {
+    if (_closed) return null;
+    final values = calloc<Uint64>(ScreenCaptureStats.valueCount);
+    try {
+      final count =
+          _getStats!(_captureId, values, ScreenCaptureStats.valueCount);
+      if (count < 0) return null;
+      return ScreenCaptureStats.fromValues(
+        List<int>.generate(count, (i) => values[i]),
+      );
+    } finally {
+      calloc.free(values);
+    }
+  }
+
+  /// Close the capture and release its buffers
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    _close!(_captureId);
+    calloc.free(_buffer);
+  }
+}
+
+/// Screen capture counters
+class ScreenCaptureStats {
+  static const int valueCount = 6;
+
+  final int frames;
+  final int changedFrames;
+
+  /// Dirty tiles summed over all frames
+  final int dirtyTiles;
+  final int tilesPerFrame;
+  final int grabUs;
+
+  /// Time spent detecting damage and converting
+  final int processUs;
+
+  const ScreenCaptureStats({
+    required this.frames,
+    required this.changedFrames,
+    required this.dirtyTiles,
+    required this.tilesPerFrame,
+    required this.grabUs,
+    required this.processUs,
+  });
+
+  factory ScreenCaptureStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return ScreenCaptureStats(
+      frames: at(0),
+      changedFrames: at(1),
+      dirtyTiles: at(2),
+      tilesPerFrame: at(3),
+      grabUs: at(4),
+      processUs: at(5),
+    );
+  }
+
+  /// Fraction of tiles that had to be converted
+  double get dirtyRatio =>
+      frames == 0 || tilesPerFrame == 0 ? 0 : dirtyTiles / (frames * tilesPerFrame);
+
+  @override
+  String toString() =>
+      'ScreenCaptureStats(frames: $frames, changed: $changedFrames, '
+      'dirty: ${(dirtyRatio * 100).toStringAsFixed(1)}%, '
+      'grab: ${frames == 0 ? 0 : grabUs ~/ frames}us, '
+      'process: ${frames == 0 ? 0 : processUs ~/ frames}us)';
+}
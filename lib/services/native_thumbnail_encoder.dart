@@ -0,0 +1,265 @@
+// Native thumbnail encoder FFI bindings
+//
+// Downscales I420 capture frames and compresses them to small JPEGs with
+// libjpeg-turbo on a native worker thread, for thumbnail tracks.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef ThumbnailEncoderCreateNative = Uint64 Function(
+    Uint32 maxWidth, Uint32 maxHeight, Int32 quality);
+typedef ThumbnailEncoderCreate = int Function(
+    int maxWidth, int maxHeight, int quality);
+
+typedef ThumbnailEncoderDestroyNative = Void Function(Uint64 encoderId);
+typedef ThumbnailEncoderDestroy = void Function(int encoderId);
+
+typedef ThumbnailEncoderPushNative = Int32 Function(Uint64 encoderId,
+    Pointer<Uint8> i420, IntPtr len, Uint32 width, Uint32 height,
+    Int64 timestampMs);
+typedef ThumbnailEncoderPush = int Function(int encoderId, Pointer<Uint8> i420,
+    int len, int width, int height, int timestampMs);
+
+typedef ThumbnailEncoderPullNative = Int32 Function(
+    Uint64 encoderId, Pointer<Uint8> out, IntPtr len, Pointer<Int64> outInfo);
+typedef ThumbnailEncoderPull = int Function(
+    int encoderId, Pointer<Uint8> out, int len, Pointer<Int64> outInfo);
+
+typedef ThumbnailEncoderGetStatsNative = Int32 Function(
+    Uint64 encoderId, Pointer<Uint64> outStats, IntPtr len);
+typedef ThumbnailEncoderGetStats = int Function(
+    int encoderId, Pointer<Uint64> outStats, int len);
+
+/// An encoded thumbnail
+class EncodedThumbnail {
+  final Uint8List jpeg;
+  final int width;
+  final int height;
+  final int timestampMs;
+
+  const EncodedThumbnail({
+    required this.jpeg,
+    required this.width,
+    required this.height,
+    required this.timestampMs,
+  });
+}
+
+/// Native I420 to JPEG thumbnail encoder
+///
+/// Frames are scaled and encoded on a native worker thread; only the newest
+/// pending frame and the newest finished thumbnail are kept.
+class NativeThumbnailEncoder {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static ThumbnailEncoderCreate? _create;
+  static ThumbnailEncoderDestroy? _destroy;
+  static ThumbnailEncoderPush? _push;
+  static ThumbnailEncoderPull? _pull;
+  static ThumbnailEncoderGetStats? _getStats;
+
+  /// Encoder ID
+  final int _encoderId;
+  bool _disposed = false;
+
+  // Reused input and output buffers, grown on demand
+  Pointer<Uint8> _input = nullptr;
+  int _inputCapacity = 0;
+  Pointer<Uint8> _output = nullptr;
+  int _outputCapacity = 0;
+  final Pointer<Int64> _info = calloc<Int64>(4);
+
+  NativeThumbnailEncoder._(this._encoderId);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<ThumbnailEncoderCreateNative>>(
+              'thumbnail_encoder_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<ThumbnailEncoderDestroyNative>>(
+              'thumbnail_encoder_destroy')
+          .asFunction();
+
+      _push = _lib!
+          .lookup<NativeFunction<ThumbnailEncoderPushNative>>(
+              'thumbnail_encoder_push')
+          .asFunction();
+
+      _pull = _lib!
+          .lookup<NativeFunction<ThumbnailEncoderPullNative>>(
+              'thumbnail_encoder_pull')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<ThumbnailEncoderGetStatsNative>>(
+              'thumbnail_encoder_get_stats')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native thumbnail encoder library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native thumbnail encoder: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native thumbnail encoder is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create an encoder producing thumbnails within [maxWidth] x [maxHeight]
+  /// (the frame's aspect ratio is kept)
+  ///
+  /// Returns null if the native library is not available
+  static NativeThumbnailEncoder? create({
+    int maxWidth = 160,
+    int maxHeight = 90,
+    int quality = 70,
+  }) {
+    try {
+      _initLib();
+      final encoderId = _create!(maxWidth, maxHeight, quality);
+      if (encoderId == 0) return null;
+      return NativeThumbnailEncoder._(encoderId);
+    } catch (e) {
+      _logger.e('Failed to create native thumbnail encoder: $e');
+      return null;
+    }
+  }
+
+  /// Queue an I420 frame, replacing one still waiting to be encoded
+  bool push(Uint8List i420, int width, int height, int timestampMs) {
+    if (_disposed || i420.isEmpty) return false;
+    if (i420.length > _inputCapacity) {
+      if (_input != nullptr) calloc.free(_input);
+      _inputCapacity = i420.length;
+      _input = calloc<Uint8>(_inputCapacity);
+    }
+    _input.asTypedList(i420.length).setAll(0, i420);
+    return _push!(_encoderId, _input, i420.length, width, height,
+            timestampMs) ==
+        0;
+  }
+
+  /// Take the finished thumbnail, if one is ready
+  EncodedThumbnail? pull() {
+    if (_disposed) return null;
+    var result = _pull!(_encoderId, _output, _outputCapacity, _info);
+    if (result == -2) {
+      if (_output != nullptr) calloc.free(_output);
+      _outputCapacity = _info[3] * 2;
+      _output = calloc<Uint8>(_outputCapacity);
+      result = _pull!(_encoderId, _output, _outputCapacity, _info);
+    }
+    if (result != 1) return null;
+
+    return EncodedThumbnail(
+      jpeg: Uint8List.fromList(_output.asTypedList(_info[3])),
+      width: _info[0],
+      height: _info[1],
+      timestampMs: _info[2],
+    );
+  }
+
+  /// Encoder counters
+  ThumbnailEncoderStats? getStats() {
+    if (_disposed) return null;
+    final values = calloc<Uint64>(ThumbnailEncoderStats.valueCount);
+    try {
+      final count =
+          _getStats!(_encoderId, values, ThumbnailEncoderStats.valueCount);
+      if (count < 0) return null;
+      return ThumbnailEncoderStats.fromValues(
+        List<int>.generate(count, (i) => values[i]),
+      );
+    } finally {
+      calloc.free(values);
+    }
+  }
+
+  /// Dispose the encoder and its worker thread
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_encoderId);
+    if (_input != nullptr) calloc.free(_input);
+    if (_output != nullptr) calloc.free(_output);
+    calloc.free(_info);
+    _input = nullptr;
+    _output = nullptr;
+  }
+}
+
+/// Thumbnail encoder counters
+class ThumbnailEncoderStats {
+  static const int valueCount = 6;
+
+  final int encoded;
+
+  /// Frames replaced before encoding, or encoded but never pulled
+  final int dropped;
+  final int errors;
+  final int scaleUs;
+  final int encodeUs;
+  final int bytes;
+
+  const ThumbnailEncoderStats({
+    required this.encoded,
+    required this.dropped,
+    required this.errors,
+    required this.scaleUs,
+    required this.encodeUs,
+    required this.bytes,
+  });
+
+  factory ThumbnailEncoderStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return ThumbnailEncoderStats(
+      encoded: at(0),
+      dropped: at(1),
+      errors: at(2),
+      scaleUs: at(3),
+      encodeUs: at(4),
+      bytes: at(5),
+    );
+  }
+
+  /// Average thumbnail size in bytes
+  int get averageBytes => encoded == 0 ? 0 : bytes ~/ encoded;
+
+  @override
+  String toString() =>
+      'ThumbnailEncoderStats(encoded: $encoded, dropped: $dropped, '
+      'errors: $errors, avg: $averageBytes B, '
+      'scale: ${encoded == 0 ? 0 : scaleUs ~/ encoded}us, '
+      'encode: ${encoded == 0 ? 0 : encodeUs ~/ encoded}us)';
+}
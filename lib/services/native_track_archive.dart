@@ -0,0 +1,453 @@
+// Native track archive FFI bindings
+//
+// An archive persists one track's objects in append-only segment files
+// under a directory, indexed by (group, object) and by the media times of
+// the track's SAP timeline. It outlives the subscription's replay buffer:
+// players seek back through it (DVR) and ranges are served from it like a
+// FETCH. Requires the `track-archive` feature.
+
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:fixnum/fixnum.dart';
+import 'package:logger/logger.dart';
+import '../moq/catalog/moq_timeline.dart';
+import '../moq/protocol/moq_messages.dart';
+import '../moq/protocol/moq_messages_data.dart';
+
+// FFI function signatures
+typedef TrackArchiveOpenNative = Uint64 Function(Pointer<Utf8> dir,
+    Uint64 segmentBytes, Uint64 maxBytes, Uint64 maxAgeMs);
+typedef TrackArchiveOpen = int Function(
+    Pointer<Utf8> dir, int segmentBytes, int maxBytes, int maxAgeMs);
+
+typedef TrackArchiveAppendNative = Int32 Function(Uint64 archiveId,
+    Uint64 group, Uint64 object, Uint8 flags, Pointer<Uint8> data, IntPtr len);
+typedef TrackArchiveAppend = int Function(int archiveId, int group, int object,
+    int flags, Pointer<Uint8> data, int len);
+
+typedef TrackArchiveMarkTimeNative = Int32 Function(Uint64 archiveId,
+    Uint64 group, Uint64 object, Uint64 timeMs, Uint8 sapType);
+typedef TrackArchiveMarkTime = int Function(
+    int archiveId, int group, int object, int timeMs, int sapType);
+
+typedef TrackArchiveReadNative = Int64 Function(Uint64 archiveId, Uint64 group,
+    Uint64 object, Pointer<Uint8> out, IntPtr cap);
+typedef TrackArchiveRead = int Function(
+    int archiveId, int group, int object, Pointer<Uint8> out, int cap);
+
+typedef TrackArchiveLocateNative = Int64 Function(
+    Uint64 archiveId,
+    Uint64 startGroup,
+    Uint64 startObject,
+    Uint64 endGroup,
+    Uint64 endObject,
+    Pointer<Uint64> out,
+    IntPtr cap);
+typedef TrackArchiveLocate = int Function(int archiveId, int startGroup,
+    int startObject, int endGroup, int endObject, Pointer<Uint64> out, int cap);
+
+typedef TrackArchiveSeekTimeNative = Int32 Function(
+    Uint64 archiveId, Uint64 timeMs, Pointer<Uint64> out);
+typedef TrackArchiveSeekTime = int Function(
+    int archiveId, int timeMs, Pointer<Uint64> out);
+
+typedef TrackArchiveFlushNative = Int32 Function(Uint64 archiveId);
+typedef TrackArchiveFlush = int Function(int archiveId);
+
+typedef TrackArchiveGetStatsNative = Int32 Function(
+    Uint64 archiveId, Pointer<Uint64> out, IntPtr len);
+typedef TrackArchiveGetStats = int Function(
+    int archiveId, Pointer<Uint64> out, int len);
+
+typedef TrackArchiveCloseNative = Void Function(Uint64 archiveId);
+typedef TrackArchiveClose = void Function(int archiveId);
+
+/// Object flag: the object starts a group
+const int archiveFlagKey = 1;
+
+/// Largest object ID, to fetch a group to its end
+final Int64 archiveEndOfGroup = Int64(-1);
+
+/// An object read back from an archive
+class ArchivedObject {
+  final Location location;
+  final bool isKey;
+  final Uint8List payload;
+
+  const ArchivedObject({
+    required this.location,
+    required this.isKey,
+    required this.payload,
+  });
+}
+
+/// Persistent, indexed archive of one track
+class NativeTrackArchive {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static TrackArchiveOpen? _open;
+  static TrackArchiveAppend? _append;
+  static TrackArchiveMarkTime? _markTime;
+  static TrackArchiveRead? _read;
+  static TrackArchiveLocate? _locate;
+  static TrackArchiveSeekTime? _seekTime;
+  static TrackArchiveFlush? _flush;
+  static TrackArchiveGetStats? _getStats;
+  static TrackArchiveClose? _close;
+
+  final int _archiveId;
+  Pointer<Uint8>? _buffer;
+  int _bufferLength = 0;
+  bool _closed = false;
+
+  NativeTrackArchive._(this._archiveId);
+
+  /// Native archive ID
+  int get archiveId => _archiveId;
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _open = _lib!
+          .lookup<NativeFunction<TrackArchiveOpenNative>>('track_archive_open')
+          .asFunction();
+
+      _append = _lib!
+          .lookup<NativeFunction<TrackArchiveAppendNative>>(
+              'track_archive_append')
+          .asFunction();
+
+      _markTime = _lib!
+          .lookup<NativeFunction<TrackArchiveMarkTimeNative>>(
+              'track_archive_mark_time')
+          .asFunction();
+
+      _read = _lib!
+          .lookup<NativeFunction<TrackArchiveReadNative>>('track_archive_read')
+          .asFunction();
+
+      _locate = _lib!
+          .lookup<NativeFunction<TrackArchiveLocateNative>>(
+              'track_archive_locate')
+          .asFunction();
+
+      _seekTime = _lib!
+          .lookup<NativeFunction<TrackArchiveSeekTimeNative>>(
+              'track_archive_seek_time')
+          .asFunction();
+
+      _flush = _lib!
+          .lookup<NativeFunction<TrackArchiveFlushNative>>(
+              'track_archive_flush')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<TrackArchiveGetStatsNative>>(
+              'track_archive_get_stats')
+          .asFunction();
+
+      _close = _lib!
+          .lookup<NativeFunction<TrackArchiveCloseNative>>(
+              'track_archive_close')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native track archive library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native track archive library: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the library was built with the track archive
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Open the archive in [directory], creating it if needed
+  ///
+  /// Whole segment files of [segmentBytes] are removed, oldest first, once
+  /// the archive exceeds [maxBytes] or their newest object is older than
+  /// [maxAge]. Zero means unbounded. Returns null on failure.
+  static NativeTrackArchive? open(
+    String directory, {
+    int segmentBytes = 64 << 20,
+    int maxBytes = 0,
+    Duration maxAge = Duration.zero,
+  }) {
+    try {
+      _initLib();
+
+      final dir = directory.toNativeUtf8();
+      try {
+        final archiveId =
+            _open!(dir, segmentBytes, maxBytes, maxAge.inMilliseconds);
+        if (archiveId == 0) {
+          _logger.e('Failed to open track archive $directory');
+          return null;
+        }
+        _logger.i('Opened track archive $archiveId: $directory');
+        return NativeTrackArchive._(archiveId);
+      } finally {
+        calloc.free(dir);
+      }
+    } catch (e) {
+      _logger.e('Failed to open track archive: $e');
+      return null;
+    }
+  }
+
+  Pointer<Uint8> _scratch(int length) {
+    if (_buffer == null || _bufferLength < length) {
+      if (_buffer != null) calloc.free(_buffer!);
+      _bufferLength = length < 64 * 1024 ? 64 * 1024 : length;
+      _buffer = calloc<Uint8>(_bufferLength);
+    }
+    return _buffer!;
+  }
+
+  /// Append an object's payload
+  bool append(Location location, Uint8List payload, {bool isKey = false}) {
+    if (_closed) return false;
+
+    final buffer = _scratch(payload.length);
+    buffer.asTypedList(payload.length).setAll(0, payload);
+    return _append!(
+          _archiveId,
+          location.group.toInt(),
+          location.object.toInt(),
+          isKey ? archiveFlagKey : 0,
+          buffer,
+          payload.length,
+        ) ==
+        0;
+  }
+
+  /// Record that the object at [location] is presented at [time]
+  ///
+  /// [sapType] 0 marks a plain object, 1 and up a random access point.
+  bool markTime(Location location, DateTime time, {int sapType = 1}) {
+    if (_closed) return false;
+    return _markTime!(
+          _archiveId,
+          location.group.toInt(),
+          location.object.toInt(),
+          time.millisecondsSinceEpoch,
+          sapType,
+        ) ==
+        0;
+  }
+
+  /// Archive a subscription's objects as they arrive
+  ///
+  /// Object 0 of each group is flagged as a key object.
+  StreamSubscription<MoQObject> recordObjects(Stream<MoQObject> objects) {
+    return objects.listen((object) {
+      final payload = object.payload;
+      if (!object.isNormal || payload == null) return;
+      append(object.location, payload, isKey: object.objectId == Int64.ZERO);
+    });
+  }
+
+  /// Index the track by the entries of its SAP timeline track
+  /// (`<track>.sap`, published by `CmafPublisher`)
+  StreamSubscription<MoQObject> recordSapTimeline(Stream<MoQObject> timeline) {
+    return timeline.listen((object) {
+      final payload = object.payload;
+      if (payload == null || payload.isEmpty) return;
+      try {
+        for (final entry in decodeEventTimeline(payload)) {
+          if (entry.indexRef != 'sap') continue;
+          final data = entry.data as Map<String, dynamic>;
+          final wallclock = data['wallclock'] as int?;
+          if (wallclock == null) continue;
+          markTime(
+            entry.location,
+            DateTime.fromMillisecondsSinceEpoch(wallclock),
+            sapType: data['type'] as int? ?? 0,
+          );
+        }
+      } catch (e) {
+        _logger.w('Ignoring malformed SAP timeline object: $e');
+      }
+    });
+  }
+
+  /// The random access point to start playback at [time], or null if
+  /// nothing archived is that old
+  Location? seek(DateTime time) {
+    if (_closed) return null;
+
+    final out = calloc<Uint64>(3);
+    try {
+      if (_seekTime!(_archiveId, time.millisecondsSinceEpoch, out) != 0) {
+        return null;
+      }
+      return Location(group: Int64(out[0]), object: Int64(out[1]));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Read one object's payload, or null if it is not archived
+  Uint8List? read(Location location) {
+    if (_closed) return null;
+
+    final group = location.group.toInt();
+    final object = location.object.toInt();
+    var length = _read!(_archiveId, group, object, _scratch(0), _bufferLength);
+    if (length < 0) return null;
+    if (length > _bufferLength) {
+      length = _read!(_archiveId, group, object, _scratch(length), length);
+      if (length < 0) return null;
+    }
+    return Uint8List.fromList(_buffer!.asTypedList(length));
+  }
+
+  /// Objects from [start] to [end] inclusive, in order, as a FETCH of the
+  /// range would return them; use [archiveEndOfGroup] as [end]'s object to
+  /// include the whole end group
+  List<ArchivedObject> fetch(Location start, Location end,
+      {int maxObjects = 4096}) {
+    if (_closed) return const [];
+
+    final out = calloc<Uint64>(maxObjects * 4);
+    try {
+      final total = _locate!(
+        _archiveId,
+        start.group.toInt(),
+        start.object.toInt(),
+        end.group.toInt(),
+        end.object.toInt(),
+        out,
+        maxObjects,
+      );
+      final count = total < maxObjects ? total : maxObjects;
+      final objects = <ArchivedObject>[];
+      for (var i = 0; i < count; i++) {
+        final location = Location(
+          group: Int64(out[i * 4]),
+          object: Int64(out[i * 4 + 1]),
+        );
+        final payload = read(location);
+        if (payload == null) continue;
+        objects.add(ArchivedObject(
+          location: location,
+          isKey: (out[i * 4 + 3] & archiveFlagKey) != 0,
+          payload: payload,
+        ));
+      }
+      return objects;
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Write buffered objects to disk
+  bool flush() => !_closed && _flush!(_archiveId) == 0;
+
+  /// Get the archive's counters
+  TrackArchiveStats getStats() {
+    if (_closed) return TrackArchiveStats.fromValues(const []);
+
+    final out = calloc<Uint64>(TrackArchiveStats.valueCount);
+    try {
+      final count =
+          _getStats!(_archiveId, out, TrackArchiveStats.valueCount);
+      if (count <= 0) return TrackArchiveStats.fromValues(const []);
+      return TrackArchiveStats.fromValues(out.asTypedList(count));
+    } finally {
+      calloc.free(out);
+    }
+  }
+
+  /// Close the archive; its files stay on disk for the next [open]
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    _close!(_archiveId);
+    if (_buffer != null) {
+      calloc.free(_buffer!);
+      _buffer = null;
+    }
+    _logger.i('Closed track archive: $_archiveId');
+  }
+}
+
+/// Track archive counters
+class TrackArchiveStats {
+  /// Number of values reported by track_archive_get_stats
+  static const int valueCount = 9;
+
+  final int objects;
+  final int timeMarks;
+  final int segments;
+  final int diskBytes;
+  final int appends;
+  final int appendedBytes;
+
+  /// Segments removed by retention
+  final int removedSegments;
+  final int oldestGroup;
+  final int newestGroup;
+
+  const TrackArchiveStats({
+    this.objects = 0,
+    this.timeMarks = 0,
+    this.segments = 0,
+    this.diskBytes = 0,
+    this.appends = 0,
+    this.appendedBytes = 0,
+    this.removedSegments = 0,
+    this.oldestGroup = 0,
+    this.newestGroup = 0,
+  });
+
+  factory TrackArchiveStats.fromValues(List<int> values) {
+    int at(int i) => i < values.length ? values[i] : 0;
+    return TrackArchiveStats(
+      objects: at(0),
+      timeMarks: at(1),
+      segments: at(2),
+      diskBytes: at(3),
+      appends: at(4),
+      appendedBytes: at(5),
+      removedSegments: at(6),
+      oldestGroup: at(7),
+      newestGroup: at(8),
+    );
+  }
+
+  @override
+  String toString() =>
+      'TrackArchiveStats(objects: $objects, time marks: $timeMarks, '
+      'segments: $segments, disk bytes: $diskBytes, '
+      'groups: $oldestGroup-$newestGroup, removed segments: $removedSegments)';
+}
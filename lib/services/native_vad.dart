@@ -0,0 +1,250 @@
+// Native voice-activity detection FFI bindings
+//
+// Gates the audio publish path on voice activity: silent frames are
+// suppressed apart from sparse comfort-noise updates, and every frame gets an
+// RFC 6464 audio level.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:logger/logger.dart';
+
+// FFI function signatures
+typedef VadCreateNative = Uint64 Function(
+    Uint32 sampleRate, Uint32 channels, Uint32 hangoverMs,
+    Uint32 comfortNoiseIntervalMs);
+typedef VadCreate = int Function(
+    int sampleRate, int channels, int hangoverMs, int comfortNoiseIntervalMs);
+
+typedef VadDestroyNative = Void Function(Uint64 detectorId);
+typedef VadDestroy = void Function(int detectorId);
+
+typedef VadProcessNative = Int32 Function(
+    Uint64 detectorId, Pointer<Int16> pcm, IntPtr len, Pointer<Uint8> outLevel);
+typedef VadProcess = int Function(
+    int detectorId, Pointer<Int16> pcm, int len, Pointer<Uint8> outLevel);
+
+typedef VadGetStatsNative = Int32 Function(
+    Uint64 detectorId, Pointer<Uint64> outStats, IntPtr len);
+typedef VadGetStats = int Function(
+    int detectorId, Pointer<Uint64> outStats, int len);
+
+/// What to do with an audio frame
+enum VadDecision {
+  /// Silence: don't publish
+  suppress,
+
+  /// Voice (or the hangover after it): publish
+  send,
+
+  /// Silence, but due for a comfort-noise update: publish
+  comfortNoise,
+}
+
+/// Gate result for one frame
+class VadResult {
+  final VadDecision decision;
+
+  /// RFC 6464 level in -dBov (0 = loudest, 127 = silence)
+  final int level;
+
+  /// Whether this frame itself contains speech (before the hangover)
+  final bool voiceActivity;
+
+  const VadResult({
+    required this.decision,
+    required this.level,
+    required this.voiceActivity,
+  });
+}
+
+/// Native voice-activity gate for one audio track
+class NativeVoiceActivityDetector {
+  static final Logger _logger = Logger();
+  static DynamicLibrary? _lib;
+  static bool _initialized = false;
+
+  // FFI function pointers
+  static VadCreate? _create;
+  static VadDestroy? _destroy;
+  static VadProcess? _process;
+  static VadGetStats? _getStats;
+
+  /// Detector ID
+  final int _detectorId;
+  bool _disposed = false;
+
+  // Reused PCM buffer, grown on demand
+  Pointer<Int16> _pcm = nullptr;
+  int _pcmCapacity = 0;
+  final Pointer<Uint8> _level = calloc<Uint8>();
+
+  NativeVoiceActivityDetector._(this._detectorId);
+
+  /// Initialize the native library
+  static void _initLib() {
+    if (_initialized) return;
+
+    try {
+      if (Platform.isLinux) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isMacOS) {
+        _lib = DynamicLibrary.open('libmoq_quic.dylib');
+      } else if (Platform.isWindows) {
+        _lib = DynamicLibrary.open('moq_quic.dll');
+      } else if (Platform.isAndroid) {
+        _lib = DynamicLibrary.open('libmoq_quic.so');
+      } else if (Platform.isIOS) {
+        _lib = DynamicLibrary.process();
+      } else {
+        throw UnsupportedError('Platform not supported');
+      }
+
+      _create = _lib!
+          .lookup<NativeFunction<VadCreateNative>>('vad_create')
+          .asFunction();
+
+      _destroy = _lib!
+          .lookup<NativeFunction<VadDestroyNative>>('vad_destroy')
+          .asFunction();
+
+      _process = _lib!
+          .lookup<NativeFunction<VadProcessNative>>('vad_process')
+          .asFunction();
+
+      _getStats = _lib!
+          .lookup<NativeFunction<VadGetStatsNative>>('vad_get_stats')
+          .asFunction();
+
+      _initialized = true;
+      _logger.i('Native VAD library initialized');
+    } catch (e) {
+      _logger.e('Failed to initialize native VAD: $e');
+      rethrow;
+    }
+  }
+
+  /// Check if the native VAD is available
+  static bool get isAvailable {
+    try {
+      _initLib();
+      return _initialized;
+    } catch (e) {
+      return false;
+    }
+  }
+
+  /// Create a detector
+  ///
+  /// [hangoverMs] keeps the gate open through pauses between words.
+  /// [comfortNoiseIntervalMs] spaces the frames still sent during silence
+  /// (0 suppresses silence entirely).
+  ///
+  /// Returns null if the native library is not available
+  static NativeVoiceActivityDetector? create({
+    required int sampleRate,
+    required int channels,
+    int hangoverMs = 300,
+    int comfortNoiseIntervalMs = 400,
+  }) {
+    try {
+      _initLib();
+      final detectorId = _create!(
+        sampleRate,
+        channels,
+        hangoverMs,
+        comfortNoiseIntervalMs,
+      );
+      if (detectorId == 0) return null;
+      return NativeVoiceActivityDetector._(detectorId);
+    } catch (e) {
+      _logger.e('Failed to create native VAD: $e');
+      return null;
+    }
+  }
+
+  /// Classify one frame of interleaved 16-bit PCM
+  VadResult? process(Int16List pcm) {
+    if (_disposed || pcm.isEmpty) return null;
+    if (pcm.length > _pcmCapacity) {
+      if (_pcm != nullptr) calloc.free(_pcm);
+      _pcmCapacity = pcm.length;
+      _pcm = calloc<Int16>(_pcmCapacity);
+    }
+    _pcm.asTypedList(pcm.length).setAll(0, pcm);
+
+    final result = _process!(_detectorId, _pcm, pcm.length, _level);
+    if (result < 0) return null;
+    return VadResult(
+      decision: switch (result) {
+        1 => VadDecision.send,
+        2 => VadDecision.comfortNoise,
+        _ => VadDecision.suppress,
+      },
+      level: _level.value & 0x7F,
+      voiceActivity: (_level.value & 0x80) != 0,
+    );
+  }
+
+  /// Gate counters
+  VadStats? getStats() {
+    if (_disposed) return null;
+    final values = calloc<Uint64>(VadStats.valueCount);
+    try {
+      final count = _getStats!(_detectorId, values, VadStats.valueCount);
+      if (count < 0) return null;
+      return VadStats.fromValues(List<int>.generate(count, (i) => values[i]));
+    } finally {
+      calloc.free(values);
+    }
+  }
+
+  /// Dispose the detector
+  void dispose() {
+    if (_disposed) return;
+    _disposed = true;
+    _destroy!(_detectorId);
+    if (_pcm != nullptr) calloc.free(_pcm);
+    calloc.free(_level);
+    _pcm = nullptr;
+  }
+}
+
+/// Voice-activity gate counters
+class VadStats {
+  static const int valueCount = 5;
+
+  final int frames;
+  final int speechFrames;
+  final int sentFrames;
+  final int comfortNoiseFrames;
+  final int suppressedFrames;
+
+  const VadStats({
+    required this.frames,
+    required this.speechFrames,
+    required this.sentFrames,
+    required this.comfortNoiseFrames,
+    required this.suppressedFrames,
+  });
+
+  factory VadStats.fromValues(List<int> values) {
+    int at(int index) => index < values.length ? values[index] : 0;
+    return VadStats(
+      frames: at(0),
+      speechFrames: at(1),
+      sentFrames: at(2),
+      comfortNoiseFrames: at(3),
+      suppressedFrames: at(4),
+    );
+  }
+
+  /// Share of frames not published
+  double get suppressedRatio => frames == 0 ? 0 : suppressedFrames / frames;
+
+  @override
+  String toString() =>
+      'VadStats(frames: $frames, speech: $speechFrames, sent: $sentFrames, '
+      'comfortNoise: $comfortNoiseFrames, suppressed: $suppressedFrames)';
+}
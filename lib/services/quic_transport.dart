@@ -53,8 +53,15 @@ class QuicTransport extends MoQTransport {
   _SendDatagramFunc? _moqQuicSendDatagram;
   _RecvDatagramFunc? _moqQuicRecvDatagram;
   _MaxDatagramSizeFunc? _moqQuicMaxDatagramSize;
+  _ConnectionStateFunc? _moqQuicConnectionState;
+  _BandwidthEstimateFunc? _moqQuicBandwidthEstimate;
+  _RouteTrackFunc? _moqQuicRouteTrack;
+  _RouteRedundantPathFunc? _moqQuicRouteRedundantPath;
+  _UnrouteTrackFunc? _moqQuicUnrouteTrack;
+  _PublishPipelineCreateFunc? _moqQuicPublishPipelineCreate;
 
   Timer? _pollTimer;
+  int _pollTicks = 0;
   bool _nativeLibraryLoaded = false;
 
   /// Whether the native QUIC library was loaded successfully.
@@ -81,6 +88,9 @@ class QuicTransport extends MoQTransport {
                 Uint8,
                 Uint32,
                 Pointer<Int8>,
+                Uint32,
+                Uint32,
+                Uint32,
                 Pointer<NativeUint64>,
               )
             >
@@ -184,6 +194,61 @@ class QuicTransport extends MoQTransport {
             'moq_quic_max_datagram_size',
           )
           .asFunction();
+      _moqQuicConnectionState = _nativeLib!
+          .lookup<NativeFunction<NativeInt32 Function(NativeUint64)>>(
+            'moq_quic_connection_state',
+          )
+          .asFunction();
+      _moqQuicBandwidthEstimate = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(
+                NativeUint64,
+                NativeUint64,
+                Pointer<NativeUint64>,
+                Pointer<NativeUint64>,
+              )
+            >
+          >('moq_quic_bandwidth_estimate')
+          .asFunction();
+      _moqQuicRouteTrack = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(
+                NativeUint64,
+                NativeUint64,
+                NativeUint64,
+                NativeInt32,
+                NativeUint64,
+                NativeUint64,
+              )
+            >
+          >('moq_quic_route_track')
+          .asFunction();
+      _moqQuicRouteRedundantPath = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(NativeUint64, NativeUint64, NativeUint64)
+            >
+          >('moq_quic_route_redundant_path')
+          .asFunction();
+      _moqQuicUnrouteTrack = _nativeLib!
+          .lookup<NativeFunction<NativeInt32 Function(NativeUint64, NativeUint64)>>(
+            'moq_quic_unroute_track',
+          )
+          .asFunction();
+      _moqQuicPublishPipelineCreate = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeUint64 Function(
+                NativeUint64,
+                NativeUint64,
+                Uint8,
+                NativeUint64,
+              )
+            >
+          >('moq_quic_publish_pipeline_create')
+          .asFunction();
 
       // Initialize the native library
       _moqQuicInit!();
@@ -347,12 +412,34 @@ class QuicTransport extends MoQTransport {
       final alpn = options?['moq_alpn'] ?? '';
       final alpnPtr = alpn.toNativeUtf8();
 
+      // Loss detection thresholds of this connection (defaults match the
+      // previous fixed settings)
+      var idleTimeoutMs =
+          int.tryParse(options?['idle_timeout_ms'] ?? '') ?? 10000;
+      var keepAliveMs = int.tryParse(options?['keep_alive_ms'] ?? '') ?? 4000;
+      var lossPtoCount = int.tryParse(options?['loss_pto_count'] ?? '') ?? 0;
+      if (idleTimeoutMs <= 0 ||
+          keepAliveMs <= 0 ||
+          keepAliveMs >= idleTimeoutMs ||
+          lossPtoCount < 0) {
+        _logger.w(
+          'Ignoring invalid liveness options: idle=$idleTimeoutMs ms, '
+          'keepAlive=$keepAliveMs ms',
+        );
+        idleTimeoutMs = 10000;
+        keepAliveMs = 4000;
+        lossPtoCount = 0;
+      }
+
       final result = _moqQuicConnect!(
         hostPtr.cast<Int8>(),
         port.toUnsigned(16),
         insecure,
         moqVersion,
         alpnPtr.cast<Int8>(),
+        idleTimeoutMs.toUnsigned(32),
+        keepAliveMs.toUnsigned(32),
+        lossPtoCount.toUnsigned(32),
         connectionIdPtr,
       );
 
@@ -639,6 +726,79 @@ class QuicTransport extends MoQTransport {
   @override
   MoQTransportStats get stats => _stats;
 
+  @override
+  BandwidthEstimate? bandwidthEstimate(int trackAlias) {
+    if (!_isConnected || _moqQuicBandwidthEstimate == null) return null;
+
+    final goodputPtr = calloc<Uint64>();
+    final capacityPtr = calloc<Uint64>();
+    try {
+      final result = _moqQuicBandwidthEstimate!(
+        _connectionId,
+        trackAlias,
+        goodputPtr,
+        capacityPtr,
+      );
+      if (result != 0) return null;
+      return BandwidthEstimate(
+        goodputBps: goodputPtr.value,
+        capacityBps: capacityPtr.value,
+      );
+    } finally {
+      calloc.free(goodputPtr);
+      calloc.free(capacityPtr);
+    }
+  }
+
+  @override
+  bool routeTrackToNative(
+    int trackAlias,
+    int sinkId, {
+    required int track,
+    required int version,
+    int replayCacheBytes = 0,
+  }) {
+    if (!_isConnected || _moqQuicRouteTrack == null) return false;
+    final result = _moqQuicRouteTrack!(
+      _connectionId,
+      trackAlias,
+      sinkId,
+      track,
+      version,
+      replayCacheBytes,
+    );
+    return result == 0;
+  }
+
+  @override
+  int? routeTrackToRedundant(int trackAlias, int redundantId) {
+    if (!_isConnected || _moqQuicRouteRedundantPath == null) return null;
+    final path = _moqQuicRouteRedundantPath!(_connectionId, trackAlias, redundantId);
+    return path < 0 ? null : path;
+  }
+
+  @override
+  void unrouteTrack(int trackAlias) {
+    if (!_isConnected || _moqQuicUnrouteTrack == null) return;
+    _moqQuicUnrouteTrack!(_connectionId, trackAlias);
+  }
+
+  @override
+  int? createPublishPipeline(
+    int trackAlias, {
+    required int priority,
+    required int version,
+  }) {
+    if (!_isConnected || _moqQuicPublishPipelineCreate == null) return null;
+    final pipelineId = _moqQuicPublishPipelineCreate!(
+      _connectionId,
+      trackAlias,
+      priority,
+      version,
+    );
+    return pipelineId == 0 ? null : pipelineId;
+  }
+
   void _startReceiving() {
     // Poll for incoming data every 5ms for lower latency
     _pollTimer = Timer.periodic(const Duration(milliseconds: 5), (_) {
@@ -672,12 +832,43 @@ class QuicTransport extends MoQTransport {
 
         // Poll datagrams
         _pollDatagrams();
+
+        // Check connection health every 100ms
+        if (++_pollTicks % 20 == 0) {
+          _checkConnectionState();
+        }
       } catch (e) {
         _logger.e('Receive error: $e');
       }
     });
   }
 
+  /// Detect a closed or stalled connection and report it as disconnected
+  ///
+  /// quinn only closes a connection once the idle timeout expires; the native
+  /// liveness tracker reports a dead path after a few PTOs so the client can
+  /// start recovering sooner.
+  void _checkConnectionState() {
+    if (_moqQuicConnectionState == null) return;
+
+    final state = _moqQuicConnectionState!(_connectionId);
+    if (state == 0) return;
+
+    _logger.w(
+      state == 1
+          ? 'QUIC connection $_connectionId stalled, treating as lost'
+          : 'QUIC connection $_connectionId lost (state $state)',
+    );
+    _stopReceiving();
+    if (state != -1) {
+      _moqQuicClose!(_connectionId);
+    }
+    _connectionId = -1;
+    _isConnected = false;
+    _knownDataStreams.clear();
+    _connectionStateController.add(false);
+  }
+
   void _pollDataStreams() {
     if (!_nativeLibraryLoaded || _moqQuicGetDataStreams == null) return;
 
@@ -844,6 +1035,9 @@ typedef _ConnectFunc =
       int insecure,
       int moqVersion,
       Pointer<Int8> alpn,
+      int idleTimeoutMs,
+      int keepAliveMs,
+      int lossPtoCount,
       Pointer<Uint64> outConnectionId,
     );
 typedef _SendFunc =
@@ -875,3 +1069,25 @@ typedef _SendDatagramFunc =
 typedef _RecvDatagramFunc =
     int Function(int connectionId, Pointer<Uint8> buffer, int bufferLen);
 typedef _MaxDatagramSizeFunc = int Function(int connectionId);
+typedef _ConnectionStateFunc = int Function(int connectionId);
+typedef _BandwidthEstimateFunc =
+    int Function(
+      int connectionId,
+      int trackAlias,
+      Pointer<Uint64> outGoodputBps,
+      Pointer<Uint64> outCapacityBps,
+    );
+typedef _RouteTrackFunc =
+    int Function(
+      int connectionId,
+      int trackAlias,
+      int sinkId,
+      int track,
+      int version,
+      int replayCacheBytes,
+    );
+typedef _RouteRedundantPathFunc =
+    int Function(int connectionId, int trackAlias, int redundantId);
+typedef _UnrouteTrackFunc = int Function(int connectionId, int trackAlias);
+typedef _PublishPipelineCreateFunc =
+    int Function(int connectionId, int trackAlias, int priority, int version);
@@ -13,6 +13,7 @@ class SettingsService {
   static const _keyVideoResolution = 'video_resolution';
   static const _keyPackagingFormat = 'packaging_format';
   static const _keyTransportType = 'transport_type';
+  static const _keyVideoSource = 'video_source';
 
   // Theme mode
   ThemeMode get themeMode {
@@ -40,6 +41,19 @@ class SettingsService {
     await _prefs.setString(_keyVideoResolution, resolution.name);
   }
 
+  // Video source
+  VideoSource get videoSource {
+    final value = _prefs.getString(_keyVideoSource);
+    return VideoSource.values.firstWhere(
+      (e) => e.name == value,
+      orElse: () => VideoSource.camera,
+    );
+  }
+
+  Future<void> setVideoSource(VideoSource source) async {
+    await _prefs.setString(_keyVideoSource, source.name);
+  }
+
   // Packaging format
   PackagingFormat get packagingFormat {
     final value = _prefs.getString(_keyPackagingFormat);
@@ -44,6 +44,7 @@ class WebTransportQuinnTransport extends MoQTransport {
   _SendFunc? _moqWtSend;
   _RecvFunc? _moqWtRecv;
   _RecvDataFunc? _moqWtRecvData;
+  _PeekDataFunc? _moqWtPeekData;
   _CloseFunc? _moqWtClose;
   _CleanupFunc? _moqWtCleanup;
   _GetLastErrorFunc? _moqWtGetLastError;
@@ -53,6 +54,11 @@ class WebTransportQuinnTransport extends MoQTransport {
   _SendDatagramFunc? _moqWtSendDatagram;
   _RecvDatagramFunc? _moqWtRecvDatagram;
   _MaxDatagramSizeFunc? _moqWtMaxDatagramSize;
+  _BandwidthEstimateFunc? _moqWtBandwidthEstimate;
+  _RouteTrackFunc? _moqWtRouteTrack;
+  _RouteRedundantPathFunc? _moqWtRouteRedundantPath;
+  _UnrouteTrackFunc? _moqWtUnrouteTrack;
+  _PublishPipelineCreateFunc? _moqWtPublishPipelineCreate;
 
   Timer? _pollTimer;
   bool _nativeLibraryLoaded = false;
@@ -115,6 +121,67 @@ class WebTransportQuinnTransport extends MoQTransport {
             >
           >('moq_webtransport_recv_data')
           .asFunction();
+      _moqWtPeekData = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt64 Function(
+                NativeUint64,
+                Pointer<NativeUint64>,
+                Pointer<NativeInt32>,
+              )
+            >
+          >('moq_webtransport_peek_data')
+          .asFunction();
+      _moqWtBandwidthEstimate = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(
+                NativeUint64,
+                NativeUint64,
+                Pointer<NativeUint64>,
+                Pointer<NativeUint64>,
+              )
+            >
+          >('moq_webtransport_bandwidth_estimate')
+          .asFunction();
+      _moqWtRouteTrack = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(
+                NativeUint64,
+                NativeUint64,
+                NativeUint64,
+                NativeInt32,
+                NativeUint64,
+                NativeUint64,
+              )
+            >
+          >('moq_webtransport_route_track')
+          .asFunction();
+      _moqWtRouteRedundantPath = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeInt32 Function(NativeUint64, NativeUint64, NativeUint64)
+            >
+          >('moq_webtransport_route_redundant_path')
+          .asFunction();
+      _moqWtUnrouteTrack = _nativeLib!
+          .lookup<NativeFunction<NativeInt32 Function(NativeUint64, NativeUint64)>>(
+            'moq_webtransport_unroute_track',
+          )
+          .asFunction();
+      _moqWtPublishPipelineCreate = _nativeLib!
+          .lookup<
+            NativeFunction<
+              NativeUint64 Function(
+                NativeUint64,
+                NativeUint64,
+                Uint8,
+                NativeUint64,
+              )
+            >
+          >('moq_webtransport_publish_pipeline_create')
+          .asFunction();
       _moqWtClose = _nativeLib!
           .lookup<NativeFunction<NativeInt32 Function(NativeUint64)>>(
             'moq_webtransport_close',
@@ -286,6 +353,80 @@ class WebTransportQuinnTransport extends MoQTransport {
     return size > 0 ? size : 0;
   }
 
+  @override
+  BandwidthEstimate? bandwidthEstimate(int trackAlias) {
+    if (!_isConnected || _sessionId < 0) return null;
+    if (_moqWtBandwidthEstimate == null) return null;
+
+    final goodputPtr = calloc<Uint64>();
+    final capacityPtr = calloc<Uint64>();
+    try {
+      final result = _moqWtBandwidthEstimate!(
+        _sessionId,
+        trackAlias,
+        goodputPtr,
+        capacityPtr,
+      );
+      if (result != 0) return null;
+      return BandwidthEstimate(
+        goodputBps: goodputPtr.value,
+        capacityBps: capacityPtr.value,
+      );
+    } finally {
+      calloc.free(goodputPtr);
+      calloc.free(capacityPtr);
+    }
+  }
+
+  @override
+  bool routeTrackToNative(
+    int trackAlias,
+    int sinkId, {
+    required int track,
+    required int version,
+    int replayCacheBytes = 0,
+  }) {
+    if (!isConnected || _moqWtRouteTrack == null) return false;
+    final result = _moqWtRouteTrack!(
+      _sessionId,
+      trackAlias,
+      sinkId,
+      track,
+      version,
+      replayCacheBytes,
+    );
+    return result == 0;
+  }
+
+  @override
+  int? routeTrackToRedundant(int trackAlias, int redundantId) {
+    if (!isConnected || _moqWtRouteRedundantPath == null) return null;
+    final path = _moqWtRouteRedundantPath!(_sessionId, trackAlias, redundantId);
+    return path < 0 ? null : path;
+  }
+
+  @override
+  void unrouteTrack(int trackAlias) {
+    if (!isConnected || _moqWtUnrouteTrack == null) return;
+    _moqWtUnrouteTrack!(_sessionId, trackAlias);
+  }
+
+  @override
+  int? createPublishPipeline(
+    int trackAlias, {
+    required int priority,
+    required int version,
+  }) {
+    if (!isConnected || _moqWtPublishPipelineCreate == null) return null;
+    final pipelineId = _moqWtPublishPipelineCreate!(
+      _sessionId,
+      trackAlias,
+      priority,
+      version,
+    );
+    return pipelineId == 0 ? null : pipelineId;
+  }
+
   @override
   Stream<bool> get connectionStateStream => _connectionStateController.stream;
 
@@ -322,6 +463,16 @@ class WebTransportQuinnTransport extends MoQTransport {
         _logger.w('Certificate verification DISABLED (insecure mode)');
       }
 
+      // Sessions have no native liveness tracker: a dead path is only
+      // reported once the QUIC idle timeout closes the session
+      final lossPtoCount = int.tryParse(options?['loss_pto_count'] ?? '') ?? 0;
+      if (lossPtoCount > 0) {
+        _logger.w(
+          'Fast loss detection is not available over WebTransport; '
+          'connection loss is reported when the session closes',
+        );
+      }
+
       // Convert host and path to native strings
       final hostPtr = host.toNativeUtf8();
       final pathPtr = path.toNativeUtf8();
@@ -650,72 +801,70 @@ class WebTransportQuinnTransport extends MoQTransport {
   }
 
   void _pollDataStreams() {
-    if (_moqWtRecvData == null) {
+    if (_moqWtRecvData == null || _moqWtPeekData == null) {
       return;
     }
 
+    final streamIdPtr = calloc<Uint64>();
+    final isCompletePtr = calloc<Int32>();
+
     try {
-      // Keep polling while there is data available
+      // Keep polling while there is data (or a FIN) pending
       while (true) {
-        // Allocate buffers for data stream reception
-        // Use larger buffer for media data
-        final buffer = calloc<Uint8>(65536);
-        final streamIdPtr = calloc<Uint64>();
-        final isCompletePtr = calloc<Int32>();
+        // Size the read from the pending chunk so it arrives in one piece;
+        // anything that does not fit stays queued natively for the next call
+        final pending = _moqWtPeekData!(_sessionId, streamIdPtr, isCompletePtr);
+        if (pending < 0 || (pending == 0 && isCompletePtr.value == 0)) {
+          break;
+        }
 
+        final bufferLen = pending > 0 ? pending : 1;
+        final buffer = calloc<Uint8>(bufferLen);
         final received = _moqWtRecvData!(
           _sessionId,
           streamIdPtr,
           buffer,
-          65536,
+          bufferLen,
           isCompletePtr,
         );
 
-        if (received > 0) {
-          final streamId = streamIdPtr.value;
-          final isComplete = isCompletePtr.value != 0;
+        final streamId = streamIdPtr.value;
+        final isComplete = isCompletePtr.value != 0;
+        if (received < 0 || (received == 0 && !isComplete)) {
+          calloc.free(buffer);
+          break;
+        }
 
-          // Copy received data
-          final data = Uint8List(received.toInt());
-          final nativeData = buffer.asTypedList(received.toInt());
-          data.setAll(0, nativeData);
+        // Copy received data
+        final data = Uint8List.fromList(buffer.asTypedList(received));
+        calloc.free(buffer);
 
+        if (received > 0) {
           _stats = _stats.copyWith(
-            bytesReceived: _stats.bytesReceived + received.toInt(),
+            bytesReceived: _stats.bytesReceived + received,
             packetsReceived: _stats.packetsReceived + 1,
             lastActivity: DateTime.now(),
           );
-
-          _logger.d(
-            'Received $received bytes on data stream $streamId (complete: $isComplete)',
-          );
-
-          // Emit as DataStreamChunk
-          _incomingDataStreamController.add(
-            DataStreamChunk(
-              streamId: streamId,
-              data: data,
-              isComplete: isComplete,
-            ),
-          );
-
-          calloc.free(buffer);
-          calloc.free(streamIdPtr);
-          calloc.free(isCompletePtr);
-
-          // Continue polling if we got data
-          continue;
         }
 
-        calloc.free(buffer);
-        calloc.free(streamIdPtr);
-        calloc.free(isCompletePtr);
+        _logger.d(
+          'Received $received bytes on data stream $streamId (complete: $isComplete)',
+        );
 
-        // No more data available, exit loop
-        break;
+        // Emit as DataStreamChunk
+        _incomingDataStreamController.add(
+          DataStreamChunk(
+            streamId: streamId,
+            data: data,
+            isComplete: isComplete,
+          ),
+        );
       }
     } catch (e) {
       _logger.e('Data stream receive error: $e');
+    } finally {
+      calloc.free(streamIdPtr);
+      calloc.free(isCompletePtr);
     }
   }
 
@@ -805,6 +954,12 @@ typedef _RecvDataFunc =
       int bufferLen,
       Pointer<Int32> outIsComplete,
     );
+typedef _PeekDataFunc =
+    int Function(
+      int sessionId,
+      Pointer<Uint64> outStreamId,
+      Pointer<Int32> outIsComplete,
+    );
 typedef _CloseFunc = int Function(int sessionId);
 typedef _CleanupFunc = void Function();
 typedef _GetLastErrorFunc = int Function(Pointer<Uint8> buffer, int bufferLen);
@@ -818,3 +973,24 @@ typedef _SendDatagramFunc =
 typedef _RecvDatagramFunc =
     int Function(int sessionId, Pointer<Uint8> buffer, int bufferLen);
 typedef _MaxDatagramSizeFunc = int Function(int sessionId);
+typedef _BandwidthEstimateFunc =
+    int Function(
+      int sessionId,
+      int trackAlias,
+      Pointer<Uint64> outGoodputBps,
+      Pointer<Uint64> outCapacityBps,
+    );
+typedef _RouteTrackFunc =
+    int Function(
+      int sessionId,
+      int trackAlias,
+      int sinkId,
+      int track,
+      int version,
+      int replayCacheBytes,
+    );
+typedef _RouteRedundantPathFunc =
+    int Function(int sessionId, int trackAlias, int redundantId);
+typedef _UnrouteTrackFunc = int Function(int sessionId, int trackAlias);
+typedef _PublishPipelineCreateFunc =
+    int Function(int sessionId, int trackAlias, int priority, int version);
@@ -32,8 +32,8 @@ class VideoPreview extends StatelessWidget {
       );
     }
 
-    // Linux capture with FFmpeg
-    if (videoCapture is LinuxVideoCapture) {
+    // Linux camera capture with FFmpeg, or screen capture
+    if (videoCapture is PreviewFrameSource) {
       final previewListenable = linuxPreviewImageListenable;
       return AspectRatio(
         aspectRatio: 16 / 9,
@@ -74,6 +74,9 @@ fn detect_mpv() -> bool {
 fn main() {
     // Detect mpv and provide build guidance
     let media_player_enabled = env::var("CARGO_FEATURE_MEDIA_PLAYER").is_ok();
+    let audio_mixer_enabled = env::var("CARGO_FEATURE_AUDIO_MIXER").is_ok();
+    let grid_decoder_enabled = env::var("CARGO_FEATURE_GRID_DECODER").is_ok();
+    let mjpeg_enabled = env::var("CARGO_FEATURE_MJPEG").is_ok();
     let mpv_available = detect_mpv();
 
     if media_player_enabled && !mpv_available {
@@ -150,8 +153,8 @@ fn main() {
         // macOS uses libc++
         println!("cargo:rustc-link-lib=c++");
 
-        // Add Homebrew library paths for mpv on macOS
-        if media_player_enabled {
+        // Add Homebrew library paths for mpv, opus and ffmpeg on macOS
+        if media_player_enabled || audio_mixer_enabled || grid_decoder_enabled {
             // Apple Silicon
             if std::path::Path::new("/opt/homebrew/lib").exists() {
                 println!("cargo:rustc-link-search=/opt/homebrew/lib");
@@ -161,6 +164,15 @@ fn main() {
                 println!("cargo:rustc-link-search=/usr/local/lib");
             }
         }
+
+        // Homebrew's jpeg-turbo is keg-only (it would shadow libjpeg)
+        if mjpeg_enabled {
+            for path in ["/opt/homebrew/opt/jpeg-turbo/lib", "/usr/local/opt/jpeg-turbo/lib"] {
+                if std::path::Path::new(path).exists() {
+                    println!("cargo:rustc-link-search={}", path);
+                }
+            }
+        }
     } else if target.contains("linux") {
         // Linux uses libstdc++
         println!("cargo:rustc-link-lib=stdc++");
@@ -0,0 +1,1160 @@
+// Multi-party audio mixer with active-speaker selection
+//
+// Audio-only rooms subscribe to one Opus track per participant. Instead of a
+// decode and playback path per subscription, every track feeds this mixer and
+// a single stereo stream leaves it.
+//
+// Architecture:
+// - Dart pushes Opus packets per track via FFI into an inbox (never blocks on a mix)
+// - Every 20ms tick drains the inbox, then decodes and measures each track on a
+//   small worker pool (scoped threads over track chunks)
+// - Only the top-K loudest tracks are mixed; when packets carry an audio level
+//   (RFC 6464 style, e.g. the LOC audio level extension) the other tracks are
+//   not decoded at all
+// - Mixing accumulates with SIMD lanes and soft-clips the sum
+// - The mixed stream is pulled via FFI or pushed by an output thread into a
+//   native media player configured for raw PCM
+
+use std::collections::{HashMap, VecDeque};
+use std::os::raw::{c_int, c_void};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::JoinHandle;
+use std::time::Instant;
+#[cfg(any(test, feature = "media-player"))]
+use std::time::Duration;
+
+/// Output sample rate
+pub const SAMPLE_RATE: u32 = 48_000;
+/// Output channels (interleaved stereo)
+pub const CHANNELS: usize = 2;
+/// Samples per channel in one 20ms mix tick
+pub const FRAME_SAMPLES: usize = 960;
+/// Interleaved samples in one mix tick
+pub const FRAME_LEN: usize = FRAME_SAMPLES * CHANNELS;
+
+// Largest Opus packet duration (120ms) in interleaved samples
+const MAX_PACKET_LEN: usize = 5760 * CHANNELS;
+
+// Levels below this are treated as silence
+const SILENCE_DB: f32 = -127.0;
+
+// Start of the soft-clip knee; the sum is linear below it and approaches full
+// scale asymptotically above it
+const CLIP_KNEE: f32 = 0.8;
+
+/// Decodes one track's packets into interleaved stereo at 48kHz
+pub trait FrameDecoder: Send {
+    /// Decode `packet` into `out`, returning samples per channel written
+    fn decode(&mut self, packet: &[u8], out: &mut [f32]) -> Result<usize, i32>;
+
+    /// Samples per channel `packet` decodes to, without decoding it
+    fn packet_samples(&self, packet: &[u8]) -> Result<usize, i32>;
+}
+
+/// Mixer tuning
+#[derive(Debug, Clone, Copy)]
+pub struct MixerConfig {
+    /// Number of simultaneous speakers mixed
+    pub top_k: usize,
+    /// Decode worker threads per tick (1 keeps everything on the mixing thread)
+    pub workers: usize,
+    /// Tracks quieter than this never take a speaker slot
+    pub gate_db: f32,
+    /// Bonus a current speaker gets when ranking, so slots don't flap between
+    /// speakers of similar loudness
+    pub hysteresis_db: f32,
+    /// Packets buffered per track before the oldest is dropped
+    pub max_queued_packets: usize,
+}
+
+impl Default for MixerConfig {
+    fn default() -> Self {
+        Self {
+            top_k: 3,
+            workers: 1,
+            gate_db: -50.0,
+            hysteresis_db: 3.0,
+            max_queued_packets: 10,
+        }
+    }
+}
+
+/// Mixer counters
+#[derive(Debug, Clone, Copy, Default)]
+pub struct MixerStats {
+    pub ticks: u64,
+    pub last_tick_us: u64,
+    pub max_tick_us: u64,
+    pub total_tick_us: u64,
+    pub packets_decoded: u64,
+    /// Packets of non-speaking tracks dropped without decoding
+    pub packets_skipped: u64,
+    pub decode_errors: u64,
+    /// Selected speakers that had less than a full tick of audio
+    pub underruns: u64,
+}
+
+struct Packet {
+    data: Vec<u8>,
+    /// Sender-reported level in dBFS
+    level_db: Option<f32>,
+}
+
+struct Track {
+    id: u64,
+    decoder: Box<dyn FrameDecoder>,
+    packets: VecDeque<Packet>,
+    /// Decoded, not yet mixed samples (interleaved)
+    pcm: Vec<f32>,
+    scratch: Vec<f32>,
+    /// Smoothed level used for ranking
+    level_db: f32,
+    selected: bool,
+    decoded: u64,
+    skipped: u64,
+    errors: u64,
+}
+
+impl Track {
+    fn new(id: u64, decoder: Box<dyn FrameDecoder>) -> Self {
+        Self {
+            id,
+            decoder,
+            packets: VecDeque::new(),
+            pcm: Vec::with_capacity(MAX_PACKET_LEN + FRAME_LEN),
+            scratch: vec![0.0; MAX_PACKET_LEN],
+            level_db: SILENCE_DB,
+            selected: false,
+            decoded: 0,
+            skipped: 0,
+            errors: 0,
+        }
+    }
+
+    fn decode_next(&mut self) -> bool {
+        let Some(packet) = self.packets.pop_front() else {
+            return false;
+        };
+        match self.decoder.decode(&packet.data, &mut self.scratch) {
+            Ok(samples) => {
+                let len = (samples * CHANNELS).min(self.scratch.len());
+                self.pcm.extend_from_slice(&self.scratch[..len]);
+                self.decoded += 1;
+            }
+            Err(_) => self.errors += 1,
+        }
+        true
+    }
+
+    /// Decode until a full tick is buffered or the queue runs dry
+    fn fill(&mut self) {
+        while self.pcm.len() < FRAME_LEN && self.decode_next() {}
+    }
+
+    /// Level of the audio this tick would play, decoding only if the sender
+    /// did not report one
+    fn measure(&mut self) -> f32 {
+        if self.pcm.len() < FRAME_LEN {
+            if let Some(level) = self.packets.front().and_then(|p| p.level_db) {
+                return level;
+            }
+            self.fill();
+        }
+        let len = self.pcm.len().min(FRAME_LEN);
+        rms_db(&self.pcm[..len])
+    }
+
+    /// Advance by one tick without mixing
+    fn skip_tick(&mut self) {
+        let mut remaining = FRAME_LEN;
+        let buffered = self.pcm.len().min(remaining);
+        self.pcm.drain(..buffered);
+        remaining -= buffered;
+
+        while remaining > 0 {
+            let Some(packet) = self.packets.front() else { break };
+            let len = self
+                .decoder
+                .packet_samples(&packet.data)
+                .map(|samples| samples * CHANNELS)
+                .unwrap_or(FRAME_LEN);
+            self.packets.pop_front();
+            self.skipped += 1;
+            // Any excess is approximated as a whole packet; live speech packets
+            // are one tick long
+            remaining = remaining.saturating_sub(len);
+        }
+    }
+}
+
+struct MixerState {
+    tracks: Vec<Track>,
+    index: HashMap<u64, usize>,
+    accumulator: Vec<f32>,
+    stats: MixerStats,
+}
+
+#[cfg_attr(not(feature = "media-player"), allow(dead_code))]
+struct OutputThread {
+    stop: Arc<AtomicBool>,
+    handle: JoinHandle<()>,
+}
+
+/// Mixes the top-K active speakers of many tracks into one stereo stream
+pub struct AudioMixer {
+    config: MixerConfig,
+    state: Mutex<MixerState>,
+    inbox: Mutex<Vec<(u64, Packet)>>,
+    speakers: Mutex<Vec<(u64, f32)>>,
+    output: Mutex<Option<OutputThread>>,
+}
+
+impl AudioMixer {
+    pub fn new(config: MixerConfig) -> Self {
+        Self {
+            config: MixerConfig {
+                top_k: config.top_k.max(1),
+                workers: config.workers.max(1),
+                max_queued_packets: config.max_queued_packets.max(1),
+                ..config
+            },
+            state: Mutex::new(MixerState {
+                tracks: Vec::new(),
+                index: HashMap::new(),
+                accumulator: vec![0.0; FRAME_LEN],
+                stats: MixerStats::default(),
+            }),
+            inbox: Mutex::new(Vec::new()),
+            speakers: Mutex::new(Vec::new()),
+            output: Mutex::new(None),
+        }
+    }
+
+    pub fn add_track(&self, track_id: u64, decoder: Box<dyn FrameDecoder>) -> bool {
+        let mut state = self.state.lock().unwrap();
+        if state.index.contains_key(&track_id) {
+            return false;
+        }
+        let position = state.tracks.len();
+        state.tracks.push(Track::new(track_id, decoder));
+        state.index.insert(track_id, position);
+        true
+    }
+
+    pub fn remove_track(&self, track_id: u64) -> bool {
+        let mut state = self.state.lock().unwrap();
+        let Some(position) = state.index.remove(&track_id) else {
+            return false;
+        };
+        state.tracks.swap_remove(position);
+        if let Some(moved) = state.tracks.get(position).map(|t| t.id) {
+            state.index.insert(moved, position);
+        }
+        true
+    }
+
+    /// Queue an encoded packet; `level_db` is the sender-reported level if any
+    pub fn push_packet(&self, track_id: u64, data: &[u8], level_db: Option<f32>) {
+        self.inbox.lock().unwrap().push((
+            track_id,
+            Packet {
+                data: data.to_vec(),
+                level_db,
+            },
+        ));
+    }
+
+    /// Produce the next 20ms of interleaved stereo into `out`
+    pub fn mix_frame(&self, out: &mut [f32]) {
+        let started = Instant::now();
+        let inbox = std::mem::take(&mut *self.inbox.lock().unwrap());
+        let mut state = self.state.lock().unwrap();
+        let state = &mut *state;
+
+        for (track_id, packet) in inbox {
+            if let Some(&position) = state.index.get(&track_id) {
+                let track = &mut state.tracks[position];
+                if track.packets.len() >= self.config.max_queued_packets {
+                    track.packets.pop_front();
+                    track.skipped += 1;
+                }
+                track.packets.push_back(packet);
+            }
+        }
+
+        // Measure every track (decoding those without a reported level)
+        let frame_levels = self.for_each_track(&mut state.tracks, Track::measure);
+        for (track, frame_db) in state.tracks.iter_mut().zip(&frame_levels) {
+            track.level_db = smooth_level(track.level_db, *frame_db);
+        }
+
+        let selected = self.select_speakers(&mut state.tracks);
+
+        // Decode the speakers that were only measured from reported levels
+        self.for_each_track(&mut state.tracks, |track| {
+            if track.selected {
+                track.fill();
+            }
+        });
+
+        let accumulator = &mut state.accumulator;
+        accumulator.iter_mut().for_each(|sample| *sample = 0.0);
+        for track in state.tracks.iter_mut() {
+            if track.selected {
+                let len = track.pcm.len().min(FRAME_LEN);
+                if len < FRAME_LEN {
+                    state.stats.underruns += 1;
+                }
+                accumulate(&mut accumulator[..len], &track.pcm[..len], 1.0);
+                track.pcm.drain(..len);
+            } else {
+                track.skip_tick();
+            }
+        }
+        soft_clip(accumulator, out);
+
+        let mut decoded = 0;
+        let mut skipped = 0;
+        let mut errors = 0;
+        for track in state.tracks.iter_mut() {
+            decoded += std::mem::take(&mut track.decoded);
+            skipped += std::mem::take(&mut track.skipped);
+            errors += std::mem::take(&mut track.errors);
+        }
+        let elapsed = started.elapsed().as_micros() as u64;
+        let stats = &mut state.stats;
+        stats.ticks += 1;
+        stats.last_tick_us = elapsed;
+        stats.max_tick_us = stats.max_tick_us.max(elapsed);
+        stats.total_tick_us += elapsed;
+        stats.packets_decoded += decoded;
+        stats.packets_skipped += skipped;
+        stats.decode_errors += errors;
+
+        *self.speakers.lock().unwrap() = selected;
+    }
+
+    /// Current speakers and their smoothed levels in dBFS, loudest first
+    pub fn active_speakers(&self) -> Vec<(u64, f32)> {
+        self.speakers.lock().unwrap().clone()
+    }
+
+    pub fn stats(&self) -> MixerStats {
+        self.state.lock().unwrap().stats
+    }
+
+    // Runs `work` over every track, split across the worker pool
+    fn for_each_track<R, F>(&self, tracks: &mut [Track], work: F) -> Vec<R>
+    where
+        R: Send + Default + Clone,
+        F: Fn(&mut Track) -> R + Sync,
+    {
+        let workers = self.config.workers.min(tracks.len()).max(1);
+        if workers == 1 {
+            return tracks.iter_mut().map(work).collect();
+        }
+
+        let chunk = tracks.len().div_ceil(workers);
+        let mut results = vec![R::default(); tracks.len()];
+        std::thread::scope(|scope| {
+            for (tracks, results) in tracks.chunks_mut(chunk).zip(results.chunks_mut(chunk)) {
+                let work = &work;
+                scope.spawn(move || {
+                    for (track, result) in tracks.iter_mut().zip(results.iter_mut()) {
+                        *result = work(track);
+                    }
+                });
+            }
+        });
+        results
+    }
+
+    // Marks the top-K tracks above the gate, current speakers ranked with a bonus
+    fn select_speakers(&self, tracks: &mut [Track]) -> Vec<(u64, f32)> {
+        let score = |track: &Track| {
+            track.level_db + if track.selected { self.config.hysteresis_db } else { 0.0 }
+        };
+
+        let mut candidates: Vec<usize> = (0..tracks.len())
+            .filter(|&i| tracks[i].level_db > self.config.gate_db)
+            .collect();
+        if candidates.len() > self.config.top_k {
+            candidates.select_nth_unstable_by(self.config.top_k - 1, |&a, &b| {
+                score(&tracks[b]).total_cmp(&score(&tracks[a]))
+            });
+            candidates.truncate(self.config.top_k);
+        }
+
+        tracks.iter_mut().for_each(|track| track.selected = false);
+        let mut selected: Vec<(u64, f32)> = candidates
+            .into_iter()
+            .map(|i| {
+                tracks[i].selected = true;
+                (tracks[i].id, tracks[i].level_db)
+            })
+            .collect();
+        selected.sort_by(|a, b| b.1.total_cmp(&a.1));
+        selected
+    }
+}
+
+// Fast attack so a new speaker takes a slot within a tick, slow release so
+// pauses between words don't drop them
+fn smooth_level(previous: f32, frame: f32) -> f32 {
+    if frame >= previous {
+        frame
+    } else {
+        (previous + (frame - previous) * 0.1).max(SILENCE_DB)
+    }
+}
+
+/// RMS level of interleaved samples in dBFS
+pub fn rms_db(samples: &[f32]) -> f32 {
+    if samples.is_empty() {
+        return SILENCE_DB;
+    }
+    let mut lanes = [0.0f32; 8];
+    let mut chunks = samples.chunks_exact(8);
+    for chunk in &mut chunks {
+        for i in 0..8 {
+            lanes[i] += chunk[i] * chunk[i];
+        }
+    }
+    let mut sum: f32 = lanes.iter().sum();
+    sum += chunks.remainder().iter().map(|s| s * s).sum::<f32>();
+
+    let rms = (sum / samples.len() as f32).sqrt();
+    if rms <= 0.0 {
+        SILENCE_DB
+    } else {
+        (20.0 * rms.log10()).max(SILENCE_DB)
+    }
+}
+
+/// `dst[i] += src[i] * gain`
+pub fn accumulate(dst: &mut [f32], src: &[f32], gain: f32) {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::is_x86_feature_detected!("avx") {
+            // SAFETY: AVX support was checked at runtime
+            unsafe { accumulate_avx(dst, src, gain) };
+            return;
+        }
+    }
+    accumulate_lanes(dst, src, gain);
+}
+
+// Eight independent lanes per step, which LLVM maps onto SSE2 on x86_64 and
+// NEON on aarch64
+fn accumulate_lanes(dst: &mut [f32], src: &[f32], gain: f32) {
+    let len = dst.len().min(src.len());
+    let mut dst_chunks = dst[..len].chunks_exact_mut(8);
+    let mut src_chunks = src[..len].chunks_exact(8);
+    for (d, s) in (&mut dst_chunks).zip(&mut src_chunks) {
+        for i in 0..8 {
+            d[i] += s[i] * gain;
+        }
+    }
+    for (d, s) in dst_chunks.into_remainder().iter_mut().zip(src_chunks.remainder()) {
+        *d += *s * gain;
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx")]
+unsafe fn accumulate_avx(dst: &mut [f32], src: &[f32], gain: f32) {
+    use std::arch::x86_64::*;
+
+    let len = dst.len().min(src.len());
+    let gains = _mm256_set1_ps(gain);
+    let mut i = 0;
+    while i + 8 <= len {
+        let d = _mm256_loadu_ps(dst.as_ptr().add(i));
+        let s = _mm256_loadu_ps(src.as_ptr().add(i));
+        _mm256_storeu_ps(dst.as_mut_ptr().add(i), _mm256_add_ps(d, _mm256_mul_ps(s, gains)));
+        i += 8;
+    }
+    accumulate_lanes(&mut dst[i..len], &src[i..len], gain);
+}
+
+/// Soft-clip `input` into `out`: linear up to the knee, then compressed so
+/// the output never reaches full scale
+pub fn soft_clip(input: &[f32], out: &mut [f32]) {
+    const HEADROOM: f32 = 1.0 - CLIP_KNEE;
+    for (o, &x) in out.iter_mut().zip(input) {
+        let magnitude = x.abs();
+        *o = if magnitude <= CLIP_KNEE {
+            x
+        } else {
+            let over = (magnitude - CLIP_KNEE) / HEADROOM;
+            (CLIP_KNEE + HEADROOM * over / (1.0 + over)).copysign(x)
+        };
+    }
+}
+
+/// Convert to 16-bit little-endian PCM
+pub fn to_s16le(samples: &[f32], out: &mut Vec<u8>) {
+    out.clear();
+    out.reserve(samples.len() * 2);
+    for &sample in samples {
+        let value = (sample.clamp(-1.0, 1.0) * i16::MAX as f32) as i16;
+        out.extend_from_slice(&value.to_le_bytes());
+    }
+}
+
+// libopus bindings (only the decoder is needed here)
+mod opus {
+    use super::*;
+
+    #[link(name = "opus")]
+    extern "C" {
+        pub fn opus_decoder_create(fs: i32, channels: c_int, error: *mut c_int) -> *mut c_void;
+        pub fn opus_decode_float(
+            st: *mut c_void,
+            data: *const u8,
+            len: i32,
+            pcm: *mut f32,
+            frame_size: c_int,
+            decode_fec: c_int,
+        ) -> c_int;
+        pub fn opus_decoder_destroy(st: *mut c_void);
+        pub fn opus_packet_get_nb_samples(data: *const u8, len: i32, fs: i32) -> c_int;
+    }
+}
+
+/// Opus decoder producing 48kHz stereo (mono streams are upmixed by libopus)
+pub struct OpusDecoder {
+    decoder: *mut c_void,
+}
+
+// The decoder state is only ever used by one thread at a time
+unsafe impl Send for OpusDecoder {}
+
+impl OpusDecoder {
+    pub fn new() -> Result<Self, i32> {
+        let mut error: c_int = 0;
+        let decoder =
+            unsafe { opus::opus_decoder_create(SAMPLE_RATE as i32, CHANNELS as c_int, &mut error) };
+        if decoder.is_null() || error != 0 {
+            return Err(error);
+        }
+        Ok(Self { decoder })
+    }
+}
+
+impl FrameDecoder for OpusDecoder {
+    fn decode(&mut self, packet: &[u8], out: &mut [f32]) -> Result<usize, i32> {
+        let ret = unsafe {
+            opus::opus_decode_float(
+                self.decoder,
+                packet.as_ptr(),
+                packet.len() as i32,
+                out.as_mut_ptr(),
+                (out.len() / CHANNELS) as c_int,
+                0,
+            )
+        };
+        if ret < 0 {
+            Err(ret)
+        } else {
+            Ok(ret as usize)
+        }
+    }
+
+    fn packet_samples(&self, packet: &[u8]) -> Result<usize, i32> {
+        let ret = unsafe {
+            opus::opus_packet_get_nb_samples(packet.as_ptr(), packet.len() as i32, SAMPLE_RATE as i32)
+        };
+        if ret < 0 {
+            Err(ret)
+        } else {
+            Ok(ret as usize)
+        }
+    }
+}
+
+impl Drop for OpusDecoder {
+    fn drop(&mut self) {
+        unsafe { opus::opus_decoder_destroy(self.decoder) };
+    }
+}
+
+// Paces mixing in real time and writes each tick to a media player as s16le
+#[cfg(feature = "media-player")]
+fn spawn_player_output(mixer: Arc<AudioMixer>, player_id: u64) -> OutputThread {
+    let stop = Arc::new(AtomicBool::new(false));
+    let thread_stop = stop.clone();
+    let handle = std::thread::spawn(move || {
+        let tick = Duration::from_micros(FRAME_SAMPLES as u64 * 1_000_000 / SAMPLE_RATE as u64);
+        let mut frame = vec![0.0f32; FRAME_LEN];
+        let mut bytes = Vec::with_capacity(FRAME_LEN * 2);
+        let mut deadline = Instant::now();
+
+        while !thread_stop.load(Ordering::Relaxed) {
+            mixer.mix_frame(&mut frame);
+            to_s16le(&frame, &mut bytes);
+            crate::media_player::media_player_write(player_id, bytes.as_ptr(), bytes.len());
+
+            // Deadline pacing so sleep jitter doesn't accumulate into drift
+            deadline += tick;
+            let now = Instant::now();
+            if deadline > now {
+                std::thread::sleep(deadline - now);
+            } else if now - deadline > tick * 5 {
+                deadline = now;
+            }
+        }
+    });
+    OutputThread { stop, handle }
+}
+
+impl AudioMixer {
+    fn stop_output(&self) {
+        if let Some(output) = self.output.lock().unwrap().take() {
+            output.stop.store(true, Ordering::Relaxed);
+            let _ = output.handle.join();
+        }
+    }
+}
+
+// Global mixer registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static MIXERS: Lazy<DashMap<u64, Arc<AudioMixer>>> = Lazy::new(|| DashMap::new());
+static NEXT_MIXER_ID: AtomicU64 = AtomicU64::new(1);
+
+// FFI Functions
+
+/// Create an audio mixer
+///
+/// # Arguments
+/// * `top_k` - Number of simultaneous speakers mixed
+/// * `workers` - Decode worker threads per tick
+///
+/// # Returns
+/// Mixer ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn audio_mixer_create(top_k: c_int, workers: c_int) -> u64 {
+    if top_k <= 0 || workers <= 0 {
+        return 0;
+    }
+    let config = MixerConfig {
+        top_k: top_k as usize,
+        workers: workers as usize,
+        ..MixerConfig::default()
+    };
+    let id = NEXT_MIXER_ID.fetch_add(1, Ordering::Relaxed);
+    MIXERS.insert(id, Arc::new(AudioMixer::new(config)));
+    log::info!("Created audio mixer {} (top_k={}, workers={})", id, top_k, workers);
+    id
+}
+
+/// Destroy an audio mixer, stopping its output thread
+#[no_mangle]
+pub extern "C" fn audio_mixer_destroy(mixer_id: u64) {
+    if let Some((_, mixer)) = MIXERS.remove(&mixer_id) {
+        mixer.stop_output();
+        log::info!("Destroyed audio mixer {}", mixer_id);
+    }
+}
+
+/// Add an Opus track
+///
+/// # Returns
+/// 0 on success, -1 if the mixer does not exist, -2 if the track already
+/// exists, -3 if the decoder could not be created
+#[no_mangle]
+pub extern "C" fn audio_mixer_add_track(mixer_id: u64, track_id: u64) -> c_int {
+    let Some(mixer) = MIXERS.get(&mixer_id).map(|m| m.clone()) else {
+        return -1;
+    };
+    let decoder = match OpusDecoder::new() {
+        Ok(decoder) => decoder,
+        Err(e) => {
+            log::error!("Failed to create Opus decoder: {}", e);
+            return -3;
+        }
+    };
+    if mixer.add_track(track_id, Box::new(decoder)) {
+        0
+    } else {
+        -2
+    }
+}
+
+/// Remove a track
+///
+/// # Returns
+/// 0 on success, -1 if the mixer or track does not exist
+#[no_mangle]
+pub extern "C" fn audio_mixer_remove_track(mixer_id: u64, track_id: u64) -> c_int {
+    match MIXERS.get(&mixer_id) {
+        Some(mixer) if mixer.remove_track(track_id) => 0,
+        _ => -1,
+    }
+}
+
+/// Queue an Opus packet for a track
+///
+/// # Arguments
+/// * `mixer_id` - Mixer ID
+/// * `track_id` - Track ID
+/// * `data` - Opus packet
+/// * `len` - Packet length
+/// * `audio_level` - Sender-reported level in -dBov (0-127, RFC 6464), or
+///   negative if the packet carries none
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn audio_mixer_push_packet(
+    mixer_id: u64,
+    track_id: u64,
+    data: *const u8,
+    len: usize,
+    audio_level: c_int,
+) -> c_int {
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let packet = unsafe { std::slice::from_raw_parts(data, len) };
+    let level = (audio_level >= 0).then(|| -(audio_level.min(127) as f32));
+
+    if let Some(mixer) = MIXERS.get(&mixer_id) {
+        mixer.push_packet(track_id, packet, level);
+        0
+    } else {
+        -1
+    }
+}
+
+/// Mix the next 20ms into `out` (interleaved stereo f32 at 48kHz)
+///
+/// For callers that drive their own output device instead of attaching a
+/// player.
+///
+/// # Returns
+/// Interleaved samples written, or -1 on error
+#[no_mangle]
+pub extern "C" fn audio_mixer_mix(mixer_id: u64, out: *mut f32, len: usize) -> c_int {
+    if out.is_null() || len < FRAME_LEN {
+        return -1;
+    }
+    if let Some(mixer) = MIXERS.get(&mixer_id).map(|m| m.clone()) {
+        let out = unsafe { std::slice::from_raw_parts_mut(out, FRAME_LEN) };
+        mixer.mix_frame(out);
+        FRAME_LEN as c_int
+    } else {
+        -1
+    }
+}
+
+/// Feed the mix into a media player in real time
+///
+/// The player is switched to raw s16le input, so this must be called before
+/// the player starts.
+///
+/// # Returns
+/// 0 on success, -1 if the mixer or player does not exist, -2 if the player
+/// feature is not built in
+#[no_mangle]
+pub extern "C" fn audio_mixer_attach_player(mixer_id: u64, player_id: u64) -> c_int {
+    #[cfg(feature = "media-player")]
+    {
+        let Some(mixer) = MIXERS.get(&mixer_id).map(|m| m.clone()) else {
+            return -1;
+        };
+        if crate::media_player::media_player_set_raw_audio(
+            player_id,
+            SAMPLE_RATE as c_int,
+            CHANNELS as c_int,
+        ) != 0
+        {
+            return -1;
+        }
+        mixer.stop_output();
+        let output = spawn_player_output(mixer.clone(), player_id);
+        *mixer.output.lock().unwrap() = Some(output);
+        0
+    }
+    #[cfg(not(feature = "media-player"))]
+    {
+        let _ = (mixer_id, player_id);
+        -2
+    }
+}
+
+/// Get the current active speakers, loudest first
+///
+/// # Arguments
+/// * `out_track_ids` - Receives speaker track IDs
+/// * `out_levels` - Receives smoothed levels in dBFS (may be null)
+/// * `len` - Capacity of the output arrays
+///
+/// # Returns
+/// Number of speakers written, or -1 on error
+#[no_mangle]
+pub extern "C" fn audio_mixer_get_active_speakers(
+    mixer_id: u64,
+    out_track_ids: *mut u64,
+    out_levels: *mut f32,
+    len: usize,
+) -> c_int {
+    if out_track_ids.is_null() {
+        return -1;
+    }
+    if let Some(mixer) = MIXERS.get(&mixer_id) {
+        let speakers = mixer.active_speakers();
+        let count = speakers.len().min(len);
+        for (i, (track_id, level)) in speakers.iter().take(count).enumerate() {
+            unsafe {
+                *out_track_ids.add(i) = *track_id;
+                if !out_levels.is_null() {
+                    *out_levels.add(i) = *level;
+                }
+            }
+        }
+        count as c_int
+    } else {
+        -1
+    }
+}
+
+/// Get mixer statistics
+///
+/// # Arguments
+/// * `out_stats` - Receives ticks, last tick us, max tick us, total tick us,
+///   packets decoded, packets skipped, decode errors and underruns, in order
+/// * `len` - Capacity of `out_stats`
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn audio_mixer_get_stats(mixer_id: u64, out_stats: *mut u64, len: usize) -> c_int {
+    if out_stats.is_null() {
+        return -1;
+    }
+    if let Some(mixer) = MIXERS.get(&mixer_id) {
+        let stats = mixer.stats();
+        let values = [
+            stats.ticks,
+            stats.last_tick_us,
+            stats.max_tick_us,
+            stats.total_tick_us,
+            stats.packets_decoded,
+            stats.packets_skipped,
+            stats.decode_errors,
+            stats.underruns,
+        ];
+        let count = len.min(values.len());
+        let out = unsafe { std::slice::from_raw_parts_mut(out_stats, count) };
+        out.copy_from_slice(&values[..count]);
+        count as c_int
+    } else {
+        -1
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicUsize;
+
+    // Test decoder: packets are raw little-endian f32 stereo samples
+    struct PcmDecoder {
+        calls: Arc<AtomicUsize>,
+    }
+
+    impl FrameDecoder for PcmDecoder {
+        fn decode(&mut self, packet: &[u8], out: &mut [f32]) -> Result<usize, i32> {
+            self.calls.fetch_add(1, Ordering::Relaxed);
+            let samples = packet.len() / 4;
+            for (i, bytes) in packet.chunks_exact(4).enumerate() {
+                out[i] = f32::from_le_bytes(bytes.try_into().unwrap());
+            }
+            Ok(samples / CHANNELS)
+        }
+
+        fn packet_samples(&self, packet: &[u8]) -> Result<usize, i32> {
+            Ok(packet.len() / 4 / CHANNELS)
+        }
+    }
+
+    fn tone(amplitude: f32) -> Vec<u8> {
+        (0..FRAME_LEN)
+            .flat_map(|i| {
+                let phase = (i / CHANNELS) as f32 * 440.0 * std::f32::consts::TAU / SAMPLE_RATE as f32;
+                (amplitude * phase.sin()).to_le_bytes()
+            })
+            .collect()
+    }
+
+    fn mixer_with(amplitudes: &[f32], config: MixerConfig) -> (AudioMixer, Arc<AtomicUsize>) {
+        let mixer = AudioMixer::new(config);
+        let calls = Arc::new(AtomicUsize::new(0));
+        for track in 0..amplitudes.len() as u64 {
+            mixer.add_track(track, Box::new(PcmDecoder { calls: calls.clone() }));
+        }
+        (mixer, calls)
+    }
+
+    fn speaker_ids(mixer: &AudioMixer) -> Vec<u64> {
+        mixer.active_speakers().iter().map(|(id, _)| *id).collect()
+    }
+
+    #[test]
+    fn mixes_only_the_loudest_tracks() {
+        let amplitudes = [0.01, 0.3, 0.001, 0.2, 0.05];
+        let config = MixerConfig { top_k: 2, ..MixerConfig::default() };
+        let (mixer, _) = mixer_with(&amplitudes, config);
+        for (track, amplitude) in amplitudes.iter().enumerate() {
+            mixer.push_packet(track as u64, &tone(*amplitude), None);
+        }
+
+        let mut out = vec![0.0; FRAME_LEN];
+        mixer.mix_frame(&mut out);
+
+        assert_eq!(speaker_ids(&mixer), vec![1, 3]);
+        // Mix of the two speakers only: 0.3 + 0.2 sine peaks below the knee
+        let peak = out.iter().fold(0.0f32, |m, s| m.max(s.abs()));
+        assert!((peak - 0.5).abs() < 0.01, "peak {}", peak);
+    }
+
+    #[test]
+    fn hysteresis_keeps_current_speaker() {
+        let config = MixerConfig { top_k: 1, ..MixerConfig::default() };
+        let (mixer, _) = mixer_with(&[0.0, 0.0], config);
+        let mut out = vec![0.0; FRAME_LEN];
+
+        mixer.push_packet(0, &tone(0.2), None);
+        mixer.push_packet(1, &tone(0.1), None);
+        mixer.mix_frame(&mut out);
+        assert_eq!(speaker_ids(&mixer), vec![0]);
+
+        // Track 1 is now 1dB louder, within the 3dB hysteresis
+        mixer.push_packet(0, &tone(0.2), None);
+        mixer.push_packet(1, &tone(0.224), None);
+        mixer.mix_frame(&mut out);
+        assert_eq!(speaker_ids(&mixer), vec![0]);
+
+        // 6dB louder takes the slot
+        mixer.push_packet(0, &tone(0.2), None);
+        mixer.push_packet(1, &tone(0.4), None);
+        mixer.mix_frame(&mut out);
+        assert_eq!(speaker_ids(&mixer), vec![1]);
+    }
+
+    #[test]
+    fn reported_levels_skip_decoding_silent_tracks() {
+        let config = MixerConfig { top_k: 2, ..MixerConfig::default() };
+        let (mixer, calls) = mixer_with(&[0.0; 10], config);
+        for track in 0..10u64 {
+            let level = if track < 2 { -20.0 } else { -70.0 };
+            mixer.push_packet(track, &tone(0.1), Some(level));
+        }
+
+        let mut out = vec![0.0; FRAME_LEN];
+        mixer.mix_frame(&mut out);
+
+        assert_eq!(calls.load(Ordering::Relaxed), 2);
+        let mut speakers = speaker_ids(&mixer);
+        speakers.sort();
+        assert_eq!(speakers, vec![0, 1]);
+        let stats = mixer.stats();
+        assert_eq!(stats.packets_decoded, 2);
+        assert_eq!(stats.packets_skipped, 8);
+    }
+
+    #[test]
+    fn worker_pool_matches_single_thread() {
+        let amplitudes: Vec<f32> = (0..24).map(|i| 0.01 * (i % 7) as f32).collect();
+        let mut outputs = Vec::new();
+        for workers in [1, 4] {
+            let config = MixerConfig { top_k: 3, workers, ..MixerConfig::default() };
+            let (mixer, _) = mixer_with(&amplitudes, config);
+            for (track, amplitude) in amplitudes.iter().enumerate() {
+                mixer.push_packet(track as u64, &tone(*amplitude), None);
+            }
+            let mut out = vec![0.0; FRAME_LEN];
+            mixer.mix_frame(&mut out);
+            let mut speakers = speaker_ids(&mixer);
+            speakers.sort();
+            outputs.push((speakers, out));
+        }
+        assert_eq!(outputs[0], outputs[1]);
+    }
+
+    #[test]
+    fn simd_accumulate_matches_scalar() {
+        let src: Vec<f32> = (0..FRAME_LEN + 5).map(|i| (i as f32 * 0.37).sin()).collect();
+        let mut simd = vec![0.25f32; src.len()];
+        let mut scalar = simd.clone();
+
+        accumulate(&mut simd, &src, 0.5);
+        for (d, s) in scalar.iter_mut().zip(&src) {
+            *d += *s * 0.5;
+        }
+        assert_eq!(simd, scalar);
+    }
+
+    #[test]
+    fn soft_clip_is_bounded_and_continuous() {
+        let input: Vec<f32> = (-400..=400).map(|i| i as f32 / 100.0).collect();
+        let mut out = vec![0.0; input.len()];
+        soft_clip(&input, &mut out);
+
+        for (x, y) in input.iter().zip(&out) {
+            assert!(y.abs() < 1.0);
+            if x.abs() <= CLIP_KNEE {
+                assert_eq!(x, y);
+            }
+        }
+        for pair in out.windows(2) {
+            assert!(pair[1] >= pair[0]);
+            assert!(pair[1] - pair[0] <= 0.0101);
+        }
+    }
+
+    // Benchmark: 100 subscribed Opus tracks mixed on one core
+    //
+    // Three participants talk (harmonic bursts), the rest send low-level room
+    // noise. Measures the per-tick cost with computed levels (every track
+    // decoded) and with sender-reported levels (only speakers decoded), as a
+    // share of the 20ms real-time budget. Needs libopus.
+    mod opus_encoder {
+        use super::*;
+
+        #[link(name = "opus")]
+        extern "C" {
+            pub fn opus_encoder_create(
+                fs: i32,
+                channels: c_int,
+                application: c_int,
+                error: *mut c_int,
+            ) -> *mut c_void;
+            pub fn opus_encode_float(
+                st: *mut c_void,
+                pcm: *const f32,
+                frame_size: c_int,
+                data: *mut u8,
+                max_data_bytes: i32,
+            ) -> i32;
+            pub fn opus_encoder_destroy(st: *mut c_void);
+        }
+
+        pub const APPLICATION_VOIP: c_int = 2048;
+    }
+
+    // Packets and per-packet levels for one participant
+    fn encode_participant(talking: bool, seed: u32, frames: usize) -> Vec<(Vec<u8>, c_int)> {
+        let mut error = 0;
+        let encoder = unsafe {
+            opus_encoder::opus_encoder_create(
+                SAMPLE_RATE as i32,
+                1,
+                opus_encoder::APPLICATION_VOIP,
+                &mut error,
+            )
+        };
+        assert!(!encoder.is_null() && error == 0, "opus encoder: {}", error);
+
+        let mut noise = seed.wrapping_mul(2654435761).max(1);
+        let mut pcm = vec![0.0f32; FRAME_SAMPLES];
+        let mut packet = vec![0u8; 1500];
+        let mut packets = Vec::with_capacity(frames);
+        let pitch = 110.0 + (seed % 7) as f32 * 15.0;
+
+        for frame in 0..frames {
+            // 1s talk spurts with short pauses
+            let voiced = talking && frame % 60 < 50;
+            for (i, sample) in pcm.iter_mut().enumerate() {
+                noise ^= noise << 13;
+                noise ^= noise >> 17;
+                noise ^= noise << 5;
+                let n = (noise as f32 / u32::MAX as f32 - 0.5) * 0.002;
+                let t = (frame * FRAME_SAMPLES + i) as f32 / SAMPLE_RATE as f32;
+                let voice = if voiced {
+                    (1..6)
+                        .map(|h| (t * pitch * h as f32 * std::f32::consts::TAU).sin() / h as f32)
+                        .sum::<f32>()
+                        * 0.15
+                } else {
+                    0.0
+                };
+                *sample = voice + n;
+            }
+            let len = unsafe {
+                opus_encoder::opus_encode_float(
+                    encoder,
+                    pcm.as_ptr(),
+                    FRAME_SAMPLES as c_int,
+                    packet.as_mut_ptr(),
+                    packet.len() as i32,
+                )
+            };
+            assert!(len > 0);
+            let level = (-rms_db(&pcm)).clamp(0.0, 127.0) as c_int;
+            packets.push((packet[..len as usize].to_vec(), level));
+        }
+
+        unsafe { opus_encoder::opus_encoder_destroy(encoder) };
+        packets
+    }
+
+    #[test]
+    #[ignore]
+    fn bench_hundred_tracks_one_core() {
+        const TRACKS: usize = 100;
+        const FRAMES: usize = 500;
+        const TALKERS: [usize; 3] = [7, 42, 77];
+
+        let participants: Vec<_> = (0..TRACKS)
+            .map(|t| encode_participant(TALKERS.contains(&t), t as u32 + 1, FRAMES))
+            .collect();
+
+        for reported_levels in [false, true] {
+            let mixer = AudioMixer::new(MixerConfig { top_k: 3, workers: 1, ..MixerConfig::default() });
+            for track in 0..TRACKS as u64 {
+                mixer.add_track(track, Box::new(OpusDecoder::new().unwrap()));
+            }
+
+            let mut out = vec![0.0f32; FRAME_LEN];
+            let mut ticks = Vec::with_capacity(FRAMES);
+            for frame in 0..FRAMES {
+                for (track, packets) in participants.iter().enumerate() {
+                    let (packet, level) = &packets[frame];
+                    let level = reported_levels.then(|| -(*level as f32));
+                    mixer.push_packet(track as u64, packet, level);
+                }
+                let started = Instant::now();
+                mixer.mix_frame(&mut out);
+                ticks.push(started.elapsed());
+            }
+
+            ticks.sort();
+            let mean = ticks.iter().sum::<Duration>() / ticks.len() as u32;
+            let p99 = ticks[ticks.len() * 99 / 100];
+            let budget = Duration::from_millis(20);
+            let stats = mixer.stats();
+            let mut speakers: Vec<u64> = mixer.active_speakers().iter().map(|(id, _)| *id).collect();
+            speakers.sort();
+
+            println!(
+                "{} tracks, {}: mean {:?} ({:.1}% of one core), p99 {:?}, decoded {} skipped {}, speakers {:?}",
+                TRACKS,
+                if reported_levels { "reported levels" } else { "computed levels" },
+                mean,
+                mean.as_secs_f64() * 100.0 / budget.as_secs_f64(),
+                p99,
+                stats.packets_decoded,
+                stats.packets_skipped,
+                speakers,
+            );
+
+            assert!(mean < budget, "mixing {} tracks is not real time on one core", TRACKS);
+            assert_eq!(stats.decode_errors, 0);
+        }
+    }
+}
@@ -0,0 +1,541 @@
+// Video device registry with hot-plug monitoring (Linux)
+//
+// Listing cameras used to run `v4l2-ctl --all` once per /dev/video* node,
+// which costs hundreds of milliseconds with some drivers and lists UVC
+// metadata nodes as cameras. The registry is built once and kept current:
+//
+// - Each node is probed with a single VIDIOC_QUERYCAP; nodes without video
+//   capture capability (metadata, output, codecs) are left out
+// - An inotify watch on /dev picks up the nodes udev creates, re-permissions
+//   and removes, so only the node that changed is probed again
+// - Queries read the cached list; a generation counter lets callers skip
+//   even that when nothing changed, and change events are queued for pulling
+
+use std::collections::{BTreeMap, VecDeque};
+use std::os::raw::c_int;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::JoinHandle;
+
+// Change events kept for a caller that stops pulling
+const MAX_PENDING_EVENTS: usize = 64;
+
+/// One capture device (mirrors `NativeVideoDevice` in Dart)
+///
+/// Strings are NUL-padded UTF-8, sized like their `v4l2_capability` fields.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct VideoDeviceInfo {
+    pub path: [u8; 32],
+    pub name: [u8; 32],
+    pub driver: [u8; 16],
+    pub bus_info: [u8; 32],
+    /// V4L2 device capabilities
+    pub capabilities: u32,
+}
+
+impl VideoDeviceInfo {
+    pub fn new(path: &str, name: &str, driver: &str, bus_info: &str, capabilities: u32) -> Self {
+        fn field<const N: usize>(value: &str) -> [u8; N] {
+            let mut out = [0u8; N];
+            // Keep a terminating NUL and cut on a character boundary
+            let mut len = value.len().min(N - 1);
+            while !value.is_char_boundary(len) {
+                len -= 1;
+            }
+            out[..len].copy_from_slice(&value.as_bytes()[..len]);
+            out
+        }
+        Self {
+            path: field(path),
+            name: field(name),
+            driver: field(driver),
+            bus_info: field(bus_info),
+            capabilities,
+        }
+    }
+
+    pub fn path(&self) -> &str {
+        let len = self.path.iter().position(|&b| b == 0).unwrap_or(self.path.len());
+        std::str::from_utf8(&self.path[..len]).unwrap_or("")
+    }
+}
+
+/// What happened to a device
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(i32)]
+pub enum DeviceChange {
+    Added = 1,
+    Removed = 2,
+}
+
+/// Cached device list and its pending change events
+#[derive(Default)]
+pub struct DeviceRegistry {
+    devices: BTreeMap<String, VideoDeviceInfo>,
+    events: VecDeque<(DeviceChange, VideoDeviceInfo)>,
+}
+
+impl DeviceRegistry {
+    /// Record the probe result for `path` (None: gone or not a camera)
+    ///
+    /// Returns whether the list changed. A device whose details changed is
+    /// reported as removed and added again.
+    pub fn update(&mut self, path: &str, probed: Option<VideoDeviceInfo>) -> bool {
+        let previous = self.devices.get(path).copied();
+        if previous == probed {
+            return false;
+        }
+        if let Some(previous) = previous {
+            self.devices.remove(path);
+            self.push_event(DeviceChange::Removed, previous);
+        }
+        if let Some(device) = probed {
+            self.devices.insert(path.to_string(), device);
+            self.push_event(DeviceChange::Added, device);
+        }
+        true
+    }
+
+    /// Devices, ordered by node path
+    pub fn devices(&self) -> impl Iterator<Item = &VideoDeviceInfo> {
+        self.devices.values()
+    }
+
+    pub fn pop_event(&mut self) -> Option<(DeviceChange, VideoDeviceInfo)> {
+        self.events.pop_front()
+    }
+
+    fn push_event(&mut self, change: DeviceChange, device: VideoDeviceInfo) {
+        if self.events.len() >= MAX_PENDING_EVENTS {
+            self.events.pop_front();
+        }
+        self.events.push_back((change, device));
+    }
+}
+
+/// Probes one device node
+pub type Probe = dyn Fn(&Path) -> Option<VideoDeviceInfo> + Send + Sync;
+
+fn is_video_node(name: &str) -> bool {
+    name.strip_prefix("video").is_some_and(|n| !n.is_empty() && n.bytes().all(|b| b.is_ascii_digit()))
+}
+
+struct Shared {
+    registry: Mutex<DeviceRegistry>,
+    /// Bumped on every change, readable without the lock
+    generation: AtomicU64,
+}
+
+impl Shared {
+    fn update(&self, path: &str, probed: Option<VideoDeviceInfo>) {
+        if self.registry.lock().unwrap().update(path, probed) {
+            self.generation.fetch_add(1, Ordering::Release);
+        }
+    }
+
+    /// Probe every node in `dir`, dropping devices that disappeared
+    fn rescan(&self, dir: &Path, probe: &Probe) {
+        let mut seen = Vec::new();
+        if let Ok(entries) = std::fs::read_dir(dir) {
+            for entry in entries.flatten() {
+                let name = entry.file_name();
+                let Some(name) = name.to_str() else { continue };
+                if is_video_node(name) {
+                    let path = dir.join(name);
+                    let key = path.to_string_lossy().into_owned();
+                    self.update(&key, probe(&path));
+                    seen.push(key);
+                }
+            }
+        }
+        let stale: Vec<String> = {
+            let registry = self.registry.lock().unwrap();
+            registry.devices.keys().filter(|path| !seen.contains(path)).cloned().collect()
+        };
+        for path in stale {
+            self.update(&path, None);
+        }
+    }
+}
+
+/// Watches a device directory and keeps a [`DeviceRegistry`] current
+pub struct DeviceMonitor {
+    shared: Arc<Shared>,
+    stop_fd: c_int,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl DeviceMonitor {
+    /// Scan `dir` and start watching it
+    pub fn start(dir: PathBuf, probe: Box<Probe>) -> std::io::Result<Self> {
+        let dir_c = std::ffi::CString::new(dir.as_os_str().as_encoded_bytes())
+            .map_err(|_| std::io::Error::from(std::io::ErrorKind::InvalidInput))?;
+        let inotify_fd = unsafe { libc::inotify_init1(libc::IN_CLOEXEC | libc::IN_NONBLOCK) };
+        if inotify_fd < 0 {
+            return Err(std::io::Error::last_os_error());
+        }
+        // IN_ATTRIB catches udev fixing permissions after the node appears
+        let mask = libc::IN_CREATE | libc::IN_ATTRIB | libc::IN_DELETE | libc::IN_MOVED_TO | libc::IN_MOVED_FROM;
+        if unsafe { libc::inotify_add_watch(inotify_fd, dir_c.as_ptr(), mask) } < 0 {
+            let error = std::io::Error::last_os_error();
+            unsafe { libc::close(inotify_fd) };
+            return Err(error);
+        }
+        let stop_fd = unsafe { libc::eventfd(0, libc::EFD_CLOEXEC | libc::EFD_NONBLOCK) };
+        if stop_fd < 0 {
+            let error = std::io::Error::last_os_error();
+            unsafe { libc::close(inotify_fd) };
+            return Err(error);
+        }
+
+        let shared = Arc::new(Shared {
+            registry: Mutex::new(DeviceRegistry::default()),
+            generation: AtomicU64::new(1),
+        });
+        shared.rescan(&dir, &*probe);
+        // The initial list isn't a change
+        shared.registry.lock().unwrap().events.clear();
+
+        let worker = shared.clone();
+        let thread = std::thread::Builder::new()
+            .name("device-monitor".into())
+            .spawn(move || Self::run(worker, inotify_fd, stop_fd, dir, probe))
+            .expect("failed to spawn device monitor thread");
+        Ok(Self { shared, stop_fd, thread: Some(thread) })
+    }
+
+    /// Changes whenever the device list does
+    pub fn generation(&self) -> u64 {
+        self.shared.generation.load(Ordering::Acquire)
+    }
+
+    pub fn devices(&self) -> Vec<VideoDeviceInfo> {
+        self.shared.registry.lock().unwrap().devices().copied().collect()
+    }
+
+    pub fn pop_event(&self) -> Option<(DeviceChange, VideoDeviceInfo)> {
+        self.shared.registry.lock().unwrap().pop_event()
+    }
+
+    fn run(shared: Arc<Shared>, inotify_fd: c_int, stop_fd: c_int, dir: PathBuf, probe: Box<Probe>) {
+        // Room for several events with names (inotify_event is 16 bytes)
+        let mut buffer = [0u64; 512];
+        loop {
+            let mut fds = [
+                libc::pollfd { fd: inotify_fd, events: libc::POLLIN, revents: 0 },
+                libc::pollfd { fd: stop_fd, events: libc::POLLIN, revents: 0 },
+            ];
+            let ready = unsafe { libc::poll(fds.as_mut_ptr(), 2, -1) };
+            if ready < 0 {
+                if std::io::Error::last_os_error().raw_os_error() == Some(libc::EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if fds[1].revents != 0 {
+                break;
+            }
+
+            let len = unsafe {
+                libc::read(inotify_fd, buffer.as_mut_ptr() as *mut libc::c_void, std::mem::size_of_val(&buffer))
+            };
+            if len <= 0 {
+                continue;
+            }
+            let bytes = unsafe { std::slice::from_raw_parts(buffer.as_ptr() as *const u8, len as usize) };
+            let header = std::mem::size_of::<libc::inotify_event>();
+            let mut offset = 0;
+            while offset + header <= bytes.len() {
+                let event = unsafe { std::ptr::read_unaligned(bytes[offset..].as_ptr() as *const libc::inotify_event) };
+                let name_bytes = &bytes[offset + header..offset + header + event.len as usize];
+                offset += header + event.len as usize;
+
+                if event.mask & libc::IN_Q_OVERFLOW != 0 {
+                    shared.rescan(&dir, &*probe);
+                    continue;
+                }
+                let name_len = name_bytes.iter().position(|&b| b == 0).unwrap_or(name_bytes.len());
+                let Ok(name) = std::str::from_utf8(&name_bytes[..name_len]) else { continue };
+                if !is_video_node(name) {
+                    continue;
+                }
+                let path = dir.join(name);
+                let key = path.to_string_lossy().into_owned();
+                if event.mask & (libc::IN_DELETE | libc::IN_MOVED_FROM) != 0 {
+                    shared.update(&key, None);
+                } else {
+                    shared.update(&key, probe(&path));
+                }
+            }
+        }
+        unsafe { libc::close(inotify_fd) };
+    }
+}
+
+impl Drop for DeviceMonitor {
+    fn drop(&mut self) {
+        let one: u64 = 1;
+        unsafe { libc::write(self.stop_fd, &one as *const u64 as *const libc::c_void, 8) };
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+        unsafe { libc::close(self.stop_fd) };
+    }
+}
+
+// -----------------------------------------------------------------------------
+// V4L2 probing
+// -----------------------------------------------------------------------------
+
+const VIDIOC_QUERYCAP: libc::c_ulong = 0x8068_5600;
+const V4L2_CAP_VIDEO_CAPTURE: u32 = 0x0000_0001;
+const V4L2_CAP_VIDEO_CAPTURE_MPLANE: u32 = 0x0000_1000;
+const V4L2_CAP_DEVICE_CAPS: u32 = 0x8000_0000;
+
+#[repr(C)]
+struct Capability {
+    driver: [u8; 16],
+    card: [u8; 32],
+    bus_info: [u8; 32],
+    version: u32,
+    capabilities: u32,
+    device_caps: u32,
+    reserved: [u32; 3],
+}
+
+/// Query a V4L2 node; None unless it is a video capture device
+pub fn probe_v4l2(path: &Path) -> Option<VideoDeviceInfo> {
+    use std::os::unix::fs::OpenOptionsExt;
+    use std::os::unix::io::AsRawFd;
+
+    let file = std::fs::OpenOptions::new()
+        .read(true)
+        .custom_flags(libc::O_NONBLOCK)
+        .open(path)
+        .ok()?;
+    let mut cap: Capability = unsafe { std::mem::zeroed() };
+    if unsafe { libc::ioctl(file.as_raw_fd(), VIDIOC_QUERYCAP as _, &mut cap as *mut Capability) } != 0 {
+        return None;
+    }
+    // device_caps describes this node; capabilities the whole device
+    let caps = if cap.capabilities & V4L2_CAP_DEVICE_CAPS != 0 { cap.device_caps } else { cap.capabilities };
+    if caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE) == 0 {
+        return None;
+    }
+    fn text(bytes: &[u8]) -> String {
+        let len = bytes.iter().position(|&b| b == 0).unwrap_or(bytes.len());
+        String::from_utf8_lossy(&bytes[..len]).trim().to_string()
+    }
+    Some(VideoDeviceInfo::new(
+        &path.to_string_lossy(),
+        &text(&cap.card),
+        &text(&cap.driver),
+        &text(&cap.bus_info),
+        caps,
+    ))
+}
+
+// Global monitor for /dev
+use once_cell::sync::Lazy;
+
+static MONITOR: Lazy<Mutex<Option<DeviceMonitor>>> = Lazy::new(|| Mutex::new(None));
+
+// FFI Functions
+
+/// Build the video device list and start watching for hot-plug
+///
+/// Does nothing if the monitor is already running.
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn video_device_monitor_start() -> c_int {
+    let mut monitor = MONITOR.lock().unwrap();
+    if monitor.is_some() {
+        return 0;
+    }
+    match DeviceMonitor::start(PathBuf::from("/dev"), Box::new(probe_v4l2)) {
+        Ok(started) => {
+            log::info!("Video device monitor started ({} devices)", started.devices().len());
+            *monitor = Some(started);
+            0
+        }
+        Err(e) => {
+            log::error!("Failed to start video device monitor: {}", e);
+            -1
+        }
+    }
+}
+
+/// Stop watching for hot-plug
+#[no_mangle]
+pub extern "C" fn video_device_monitor_stop() {
+    if MONITOR.lock().unwrap().take().is_some() {
+        log::info!("Video device monitor stopped");
+    }
+}
+
+/// Current list generation; changes whenever the device list does
+///
+/// # Returns
+/// Generation (starting at 1), or 0 if the monitor is not running
+#[no_mangle]
+pub extern "C" fn video_device_generation() -> u64 {
+    MONITOR.lock().unwrap().as_ref().map_or(0, DeviceMonitor::generation)
+}
+
+/// Copy the cached device list
+///
+/// # Arguments
+/// * `out_devices` - Array for the devices
+/// * `capacity` - Length of `out_devices`
+///
+/// # Returns
+/// Number of devices (may exceed `capacity`; only `capacity` are written),
+/// or -1 if the monitor is not running
+#[no_mangle]
+pub extern "C" fn video_device_list(out_devices: *mut VideoDeviceInfo, capacity: usize) -> c_int {
+    if out_devices.is_null() && capacity > 0 {
+        return -1;
+    }
+    let monitor = MONITOR.lock().unwrap();
+    let Some(monitor) = monitor.as_ref() else { return -1 };
+    let devices = monitor.devices();
+    let count = devices.len().min(capacity);
+    if count > 0 {
+        let out = unsafe { std::slice::from_raw_parts_mut(out_devices, count) };
+        out.copy_from_slice(&devices[..count]);
+    }
+    devices.len() as c_int
+}
+
+/// Take the next queued change
+///
+/// # Arguments
+/// * `out_device` - Receives the device that changed
+///
+/// # Returns
+/// 1 if a device was added, 2 if one was removed, 0 if nothing changed,
+/// -1 on error
+#[no_mangle]
+pub extern "C" fn video_device_poll_event(out_device: *mut VideoDeviceInfo) -> c_int {
+    if out_device.is_null() {
+        return -1;
+    }
+    let monitor = MONITOR.lock().unwrap();
+    let Some(monitor) = monitor.as_ref() else { return -1 };
+    match monitor.pop_event() {
+        Some((change, device)) => {
+            unsafe { *out_device = device };
+            change as c_int
+        }
+        None => 0,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Duration;
+
+    fn device(path: &str, name: &str) -> VideoDeviceInfo {
+        VideoDeviceInfo::new(path, name, "uvcvideo", "usb-0000:00:14.0-1", V4L2_CAP_VIDEO_CAPTURE)
+    }
+
+    /// Treats a file as a camera named after its contents; empty files are
+    /// metadata nodes
+    fn file_probe(path: &Path) -> Option<VideoDeviceInfo> {
+        let name = std::fs::read_to_string(path).ok()?;
+        (!name.is_empty()).then(|| device(&path.to_string_lossy(), &name))
+    }
+
+    fn wait_for(monitor: &DeviceMonitor, generation: u64) {
+        for _ in 0..200 {
+            if monitor.generation() >= generation {
+                return;
+            }
+            std::thread::sleep(Duration::from_millis(5));
+        }
+        panic!("no change seen (generation {})", monitor.generation());
+    }
+
+    #[test]
+    fn registry_reports_only_real_changes() {
+        let mut registry = DeviceRegistry::default();
+        assert!(registry.update("/dev/video0", Some(device("/dev/video0", "Cam"))));
+        assert!(!registry.update("/dev/video0", Some(device("/dev/video0", "Cam"))));
+        assert!(!registry.update("/dev/video1", None));
+        // Renamed: removed and added again
+        assert!(registry.update("/dev/video0", Some(device("/dev/video0", "Cam 2"))));
+        assert!(registry.update("/dev/video0", None));
+
+        let events: Vec<_> = std::iter::from_fn(|| registry.pop_event()).map(|(c, _)| c).collect();
+        use DeviceChange::*;
+        assert_eq!(events, [Added, Removed, Added, Removed]);
+        assert_eq!(registry.devices().count(), 0);
+    }
+
+    #[test]
+    fn truncates_long_strings_on_char_boundaries() {
+        let info = VideoDeviceInfo::new("/dev/video0", &"é".repeat(40), "d", "b", 0);
+        let len = info.name.iter().position(|&b| b == 0).unwrap();
+        assert_eq!(len, 30);
+        assert!(std::str::from_utf8(&info.name[..len]).is_ok());
+        assert_eq!(info.path(), "/dev/video0");
+        assert!(is_video_node("video12") && !is_video_node("video") && !is_video_node("videox"));
+    }
+
+    #[test]
+    fn follows_hot_plug_in_watched_directory() {
+        let dir = std::env::temp_dir().join(format!("moq-devices-{}", std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        std::fs::create_dir_all(&dir).unwrap();
+        std::fs::write(dir.join("video0"), "Built-in").unwrap();
+        std::fs::write(dir.join("video1"), "").unwrap();
+        std::fs::write(dir.join("null"), "x").unwrap();
+
+        let monitor = DeviceMonitor::start(dir.clone(), Box::new(file_probe)).unwrap();
+        let names: Vec<String> = monitor.devices().iter().map(|d| d.path().to_string()).collect();
+        assert_eq!(names, [dir.join("video0").to_string_lossy()]);
+        assert!(monitor.pop_event().is_none());
+
+        let generation = monitor.generation();
+        // Appears whole, as device nodes do
+        std::fs::write(dir.join("staging"), "USB").unwrap();
+        std::fs::rename(dir.join("staging"), dir.join("video2")).unwrap();
+        wait_for(&monitor, generation + 1);
+        let (change, added) = monitor.pop_event().unwrap();
+        assert_eq!((change, added.path()), (DeviceChange::Added, &*dir.join("video2").to_string_lossy()));
+
+        let generation = monitor.generation();
+        std::fs::remove_file(dir.join("video0")).unwrap();
+        wait_for(&monitor, generation + 1);
+        assert_eq!(monitor.pop_event().unwrap().0, DeviceChange::Removed);
+        assert_eq!(monitor.devices().len(), 1);
+
+        drop(monitor);
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    /// Run with:
+    ///   cargo test --release --features device-monitor bench_enumerate_dev -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_enumerate_dev() {
+        let start = std::time::Instant::now();
+        let monitor = DeviceMonitor::start(PathBuf::from("/dev"), Box::new(probe_v4l2)).unwrap();
+        let scan = start.elapsed();
+        let start = std::time::Instant::now();
+        for _ in 0..1000 {
+            std::hint::black_box(monitor.devices());
+        }
+        println!(
+            "initial scan {:.2}ms ({} capture devices), cached list {:.2}us",
+            scan.as_secs_f64() * 1000.0,
+            monitor.devices().len(),
+            start.elapsed().as_secs_f64() * 1e6 / 1000.0
+        );
+    }
+}
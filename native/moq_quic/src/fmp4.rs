@@ -0,0 +1,297 @@
+// Fragmented MP4 writer for H.264 playback
+// Native counterpart of AvccFmp4Muxer (lib/moq/media/streaming_playback.dart): the
+// init segment is built from an AVC decoder configuration record, and each frame
+// becomes a single-sample moof followed by an mdat header. The frame itself is not
+// copied into the fragment; callers write the header and the payload back to back.
+
+// Timescale of the video track, matching the Dart muxer
+pub const VIDEO_TIMESCALE: u32 = 90_000;
+
+// trun sample flags
+const SAMPLE_FLAGS_SYNC: u32 = 0x0200_0000;
+const SAMPLE_FLAGS_NON_SYNC: u32 = 0x0101_0000;
+
+// Size of a fragment header: moof (mfhd + traf(tfhd + tfdt + trun)) plus mdat header
+pub const FRAGMENT_HEADER_LEN: usize = 8 + 16 + 8 + 16 + 20 + 32 + 8;
+
+// Open a box and return its start so `end_box` can fill in the size
+fn begin_box(out: &mut Vec<u8>, kind: &[u8; 4]) -> usize {
+    let start = out.len();
+    out.extend_from_slice(&[0; 4]);
+    out.extend_from_slice(kind);
+    start
+}
+
+fn begin_full_box(out: &mut Vec<u8>, kind: &[u8; 4], version: u8, flags: u32) -> usize {
+    let start = begin_box(out, kind);
+    out.extend_from_slice(&((version as u32) << 24 | flags).to_be_bytes());
+    start
+}
+
+fn end_box(out: &mut [u8], start: usize) {
+    let size = (out.len() - start) as u32;
+    out[start..start + 4].copy_from_slice(&size.to_be_bytes());
+}
+
+fn put_u16(out: &mut Vec<u8>, v: u16) {
+    out.extend_from_slice(&v.to_be_bytes());
+}
+
+fn put_u32(out: &mut Vec<u8>, v: u32) {
+    out.extend_from_slice(&v.to_be_bytes());
+}
+
+fn put_zeros(out: &mut Vec<u8>, n: usize) {
+    out.resize(out.len() + n, 0);
+}
+
+// Unity transformation matrix shared by mvhd and tkhd
+fn put_matrix(out: &mut Vec<u8>) {
+    for v in [0x0001_0000u32, 0, 0, 0, 0x0001_0000, 0, 0, 0, 0x4000_0000] {
+        put_u32(out, v);
+    }
+}
+
+/// ftyp + moov for a single H.264 track
+///
+/// `avcc` is the AVCDecoderConfigurationRecord, carried as-is in the avcC box.
+pub fn h264_init_segment(avcc: &[u8], width: u16, height: u16, track_id: u32) -> Vec<u8> {
+    let mut out = Vec::with_capacity(700 + avcc.len());
+
+    let ftyp = begin_box(&mut out, b"ftyp");
+    out.extend_from_slice(b"isom");
+    put_u32(&mut out, 512);
+    out.extend_from_slice(b"isomiso6avc1mp41");
+    end_box(&mut out, ftyp);
+
+    let moov = begin_box(&mut out, b"moov");
+
+    let mvhd = begin_full_box(&mut out, b"mvhd", 0, 0);
+    put_zeros(&mut out, 8); // creation, modification
+    put_u32(&mut out, VIDEO_TIMESCALE);
+    put_u32(&mut out, 0); // duration
+    put_u32(&mut out, 0x0001_0000); // rate 1.0
+    put_u16(&mut out, 0x0100); // volume 1.0
+    put_zeros(&mut out, 10);
+    put_matrix(&mut out);
+    put_zeros(&mut out, 24);
+    put_u32(&mut out, track_id + 1);
+    end_box(&mut out, mvhd);
+
+    let trak = begin_box(&mut out, b"trak");
+
+    // Enabled, in movie
+    let tkhd = begin_full_box(&mut out, b"tkhd", 0, 3);
+    put_zeros(&mut out, 8);
+    put_u32(&mut out, track_id);
+    put_zeros(&mut out, 4);
+    put_u32(&mut out, 0); // duration
+    put_zeros(&mut out, 8);
+    put_zeros(&mut out, 8); // layer, alternate group, volume, reserved
+    put_matrix(&mut out);
+    put_u32(&mut out, (width as u32) << 16);
+    put_u32(&mut out, (height as u32) << 16);
+    end_box(&mut out, tkhd);
+
+    let mdia = begin_box(&mut out, b"mdia");
+
+    let mdhd = begin_full_box(&mut out, b"mdhd", 0, 0);
+    put_zeros(&mut out, 8);
+    put_u32(&mut out, VIDEO_TIMESCALE);
+    put_u32(&mut out, 0);
+    put_u16(&mut out, 0x55C4); // 'und'
+    put_u16(&mut out, 0);
+    end_box(&mut out, mdhd);
+
+    let hdlr = begin_full_box(&mut out, b"hdlr", 0, 0);
+    put_u32(&mut out, 0);
+    out.extend_from_slice(b"vide");
+    put_zeros(&mut out, 12);
+    out.extend_from_slice(b"VideoHandler\0");
+    end_box(&mut out, hdlr);
+
+    let minf = begin_box(&mut out, b"minf");
+
+    let vmhd = begin_full_box(&mut out, b"vmhd", 0, 1);
+    put_zeros(&mut out, 8);
+    end_box(&mut out, vmhd);
+
+    let dinf = begin_box(&mut out, b"dinf");
+    let dref = begin_full_box(&mut out, b"dref", 0, 0);
+    put_u32(&mut out, 1);
+    // Self-contained
+    let url = begin_full_box(&mut out, b"url ", 0, 1);
+    end_box(&mut out, url);
+    end_box(&mut out, dref);
+    end_box(&mut out, dinf);
+
+    let stbl = begin_box(&mut out, b"stbl");
+
+    let stsd = begin_full_box(&mut out, b"stsd", 0, 0);
+    put_u32(&mut out, 1);
+    let avc1 = begin_box(&mut out, b"avc1");
+    put_zeros(&mut out, 6);
+    put_u16(&mut out, 1); // data reference index
+    put_zeros(&mut out, 16);
+    put_u16(&mut out, width);
+    put_u16(&mut out, height);
+    put_u32(&mut out, 0x0048_0000); // 72 dpi
+    put_u32(&mut out, 0x0048_0000);
+    put_u32(&mut out, 0);
+    put_u16(&mut out, 1); // frame count
+    put_zeros(&mut out, 32); // compressor name
+    put_u16(&mut out, 0x0018); // depth
+    put_u16(&mut out, 0xFFFF); // pre-defined -1
+    let avcc_box = begin_box(&mut out, b"avcC");
+    out.extend_from_slice(avcc);
+    end_box(&mut out, avcc_box);
+    end_box(&mut out, avc1);
+    end_box(&mut out, stsd);
+
+    // Empty sample tables; samples live in the fragments
+    for kind in [b"stts", b"stsc", b"stco"] {
+        let b = begin_full_box(&mut out, kind, 0, 0);
+        put_u32(&mut out, 0);
+        end_box(&mut out, b);
+    }
+    let stsz = begin_full_box(&mut out, b"stsz", 0, 0);
+    put_zeros(&mut out, 8);
+    end_box(&mut out, stsz);
+
+    end_box(&mut out, stbl);
+    end_box(&mut out, minf);
+    end_box(&mut out, mdia);
+    end_box(&mut out, trak);
+
+    let mvex = begin_box(&mut out, b"mvex");
+    let trex = begin_full_box(&mut out, b"trex", 0, 0);
+    put_u32(&mut out, track_id);
+    put_u32(&mut out, 1); // sample description index
+    put_zeros(&mut out, 12);
+    end_box(&mut out, trex);
+    end_box(&mut out, mvex);
+
+    end_box(&mut out, moov);
+    out
+}
+
+/// Write the moof and mdat header for one sample of `sample_size` bytes
+///
+/// The sample data must follow immediately after the written bytes.
+pub fn write_fragment_header(
+    out: &mut Vec<u8>,
+    sequence: u32,
+    track_id: u32,
+    base_decode_time: u64,
+    duration: u32,
+    sample_size: u32,
+    keyframe: bool,
+) {
+    let start = out.len();
+    let moof = begin_box(out, b"moof");
+
+    let mfhd = begin_full_box(out, b"mfhd", 0, 0);
+    put_u32(out, sequence);
+    end_box(out, mfhd);
+
+    let traf = begin_box(out, b"traf");
+    // default-base-is-moof
+    let tfhd = begin_full_box(out, b"tfhd", 0, 0x02_0000);
+    put_u32(out, track_id);
+    end_box(out, tfhd);
+
+    let tfdt = begin_full_box(out, b"tfdt", 1, 0);
+    out.extend_from_slice(&base_decode_time.to_be_bytes());
+    end_box(out, tfdt);
+
+    // data offset, sample duration, size and flags present
+    let trun = begin_full_box(out, b"trun", 0, 0x00_0701);
+    put_u32(out, 1);
+    let data_offset_at = out.len();
+    put_u32(out, 0);
+    put_u32(out, duration);
+    put_u32(out, sample_size);
+    put_u32(out, if keyframe { SAMPLE_FLAGS_SYNC } else { SAMPLE_FLAGS_NON_SYNC });
+    end_box(out, trun);
+
+    end_box(out, traf);
+    end_box(out, moof);
+
+    // Data starts right after the mdat header
+    let data_offset = (out.len() - moof + 8) as u32;
+    out[data_offset_at..data_offset_at + 4].copy_from_slice(&data_offset.to_be_bytes());
+
+    put_u32(out, sample_size + 8);
+    out.extend_from_slice(b"mdat");
+    debug_assert_eq!(out.len() - start, FRAGMENT_HEADER_LEN);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Walk a box list and return (type, payload) pairs
+    fn boxes(data: &[u8]) -> Vec<([u8; 4], &[u8])> {
+        let mut out = Vec::new();
+        let mut pos = 0;
+        while pos + 8 <= data.len() {
+            let size = u32::from_be_bytes(data[pos..pos + 4].try_into().unwrap()) as usize;
+            assert!(size >= 8 && pos + size <= data.len(), "bad box at {}", pos);
+            out.push((data[pos + 4..pos + 8].try_into().unwrap(), &data[pos + 8..pos + size]));
+            pos += size;
+        }
+        assert_eq!(pos, data.len());
+        out
+    }
+
+    #[test]
+    fn init_segment_nests_avcc() {
+        let avcc = [1, 0x64, 0, 0x1F, 0xFF, 0xE1, 0, 2, 0x67, 0x64, 1, 0, 2, 0x68, 0xEE];
+        let init = h264_init_segment(&avcc, 1280, 720, 1);
+        let top = boxes(&init);
+        assert_eq!(&top[0].0, b"ftyp");
+        assert_eq!(&top[1].0, b"moov");
+
+        let moov = boxes(top[1].1);
+        let kinds: Vec<_> = moov.iter().map(|(k, _)| k).collect();
+        assert_eq!(kinds, [b"mvhd", b"trak", b"mvex"]);
+        assert_eq!(moov[0].1.len(), 4 + 96);
+
+        let trak = boxes(moov[1].1);
+        assert_eq!(trak[0].1.len(), 4 + 80); // tkhd
+        let mdia = boxes(trak[1].1);
+        let minf = boxes(mdia[2].1);
+        let stbl = boxes(minf[2].1);
+        let stsd = stbl[0].1;
+        let avc1 = boxes(&stsd[8..]);
+        assert_eq!(&avc1[0].0, b"avc1");
+        // 78 bytes of visual sample entry, then avcC
+        let entry = avc1[0].1;
+        assert_eq!(u16::from_be_bytes([entry[24], entry[25]]), 1280);
+        assert_eq!(u16::from_be_bytes([entry[26], entry[27]]), 720);
+        let avcc_box = boxes(&entry[78..]);
+        assert_eq!(&avcc_box[0].0, b"avcC");
+        assert_eq!(avcc_box[0].1, avcc);
+    }
+
+    #[test]
+    fn fragment_points_at_sample() {
+        let mut out = Vec::new();
+        write_fragment_header(&mut out, 7, 1, 3000, 3000, 5, true);
+        assert_eq!(out.len(), FRAGMENT_HEADER_LEN);
+        out.extend_from_slice(&[9, 8, 7, 6, 5]);
+
+        let top = boxes(&out);
+        assert_eq!(&top[0].0, b"moof");
+        assert_eq!(&top[1].0, b"mdat");
+        assert_eq!(top[1].1, [9, 8, 7, 6, 5]);
+
+        let moof = boxes(top[0].1);
+        assert_eq!(u32::from_be_bytes(moof[0].1[4..8].try_into().unwrap()), 7);
+        let traf = boxes(moof[1].1);
+        let trun = traf[2].1;
+        let data_offset = u32::from_be_bytes(trun[8..12].try_into().unwrap()) as usize;
+        assert_eq!(&out[data_offset..], [9, 8, 7, 6, 5]);
+        assert_eq!(u32::from_be_bytes(trun[20..24].try_into().unwrap()), SAMPLE_FLAGS_SYNC);
+    }
+}
@@ -0,0 +1,1221 @@
+// Multi-stream video decode service for grid views
+//
+// Monitoring walls show many low-resolution streams at once. Instead of a
+// player (and its threads) per stream, all streams share one decode service.
+//
+// Architecture:
+// - Each stream owns a single-threaded H.264 decoder and a queue of access
+//   units stamped with a display deadline (arrival anchor + pts + playout delay)
+// - A fixed pool of workers, sized to the cores, runs one access unit per task;
+//   each worker keeps a deadline-ordered local queue and idle workers steal the
+//   most urgent task from a busy peer
+// - A stream is queued at most once, so its decoder is only ever used by one
+//   worker at a time, normally the one that ran it last
+// - A frame that would miss its deadline is decoded without output (non-reference
+//   frames are discarded by the decoder), or skipped entirely when a later
+//   keyframe is already queued
+// - Displayed frames are converted to RGBA straight into their tile of a
+//   shared texture atlas; readers copy only the tiles that changed
+
+use std::cmp::Ordering as CmpOrdering;
+use std::collections::{BinaryHeap, HashMap, VecDeque};
+use std::os::raw::{c_char, c_int, c_void};
+use std::ptr;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, RwLock};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+/// A decoded YUV 4:2:0 picture
+pub struct Picture<'a> {
+    pub width: usize,
+    pub height: usize,
+    pub y: &'a [u8],
+    pub u: &'a [u8],
+    pub v: &'a [u8],
+    pub y_stride: usize,
+    pub uv_stride: usize,
+}
+
+/// Decodes one stream's Annex-B access units
+pub trait VideoDecoder: Send {
+    /// Decode an access unit. When `output` is false the picture will not be
+    /// shown, so the decoder may skip work that no later frame depends on.
+    fn decode(&mut self, data: &[u8], output: bool) -> Result<Option<Picture<'_>>, i32>;
+}
+
+/// Decode service tuning
+#[derive(Debug, Clone, Copy)]
+pub struct GridConfig {
+    /// Worker threads; 0 uses one per core
+    pub workers: usize,
+    pub tile_width: usize,
+    pub tile_height: usize,
+    pub columns: usize,
+    pub rows: usize,
+    /// Delay between a stream's first frame arriving and it being displayed
+    pub playout_delay: Duration,
+}
+
+impl Default for GridConfig {
+    fn default() -> Self {
+        Self {
+            workers: 0,
+            tile_width: 640,
+            tile_height: 360,
+            columns: 4,
+            rows: 4,
+            playout_delay: Duration::from_millis(100),
+        }
+    }
+}
+
+/// Per-stream counters
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct StreamStats {
+    pub decoded: u64,
+    pub displayed: u64,
+    /// Decoded without output because the deadline had passed
+    pub dropped_late: u64,
+    /// Discarded undecoded to catch up at a later keyframe
+    pub skipped_to_keyframe: u64,
+    pub decode_errors: u64,
+}
+
+impl StreamStats {
+    fn add(&mut self, other: &StreamStats) {
+        self.decoded += other.decoded;
+        self.displayed += other.displayed;
+        self.dropped_late += other.dropped_late;
+        self.skipped_to_keyframe += other.skipped_to_keyframe;
+        self.decode_errors += other.decode_errors;
+    }
+}
+
+struct EncodedFrame {
+    data: Vec<u8>,
+    deadline: Instant,
+    keyframe: bool,
+}
+
+struct Stream {
+    tile: usize,
+    decoder: Mutex<Box<dyn VideoDecoder>>,
+    queue: Mutex<VecDeque<EncodedFrame>>,
+    scheduled: AtomicBool,
+    last_worker: AtomicUsize,
+    /// Arrival time and pts of the frame the display clock is anchored to
+    anchor: Mutex<Option<(Instant, i64)>>,
+    /// SPS/PPS in Annex-B, from the stream's avcC record
+    parameter_sets: Mutex<Option<Vec<u8>>>,
+    /// Smoothed decode + conversion time, used to predict lateness
+    cost_us: AtomicU64,
+    stats: Mutex<StreamStats>,
+}
+
+impl Stream {
+    fn new(tile: usize, decoder: Box<dyn VideoDecoder>) -> Self {
+        Self {
+            tile,
+            decoder: Mutex::new(decoder),
+            queue: Mutex::new(VecDeque::new()),
+            scheduled: AtomicBool::new(false),
+            last_worker: AtomicUsize::new(0),
+            anchor: Mutex::new(None),
+            parameter_sets: Mutex::new(None),
+            cost_us: AtomicU64::new(0),
+            stats: Mutex::new(StreamStats::default()),
+        }
+    }
+
+    fn head_deadline(&self) -> Option<Instant> {
+        self.queue.lock().unwrap().front().map(|f| f.deadline)
+    }
+
+    // Display deadline for a frame arriving now; re-anchors after a stall
+    fn deadline(&self, pts_us: i64, now: Instant, playout_delay: Duration) -> Instant {
+        let mut anchor = self.anchor.lock().unwrap();
+        if let Some((anchor_time, anchor_pts)) = *anchor {
+            let offset = pts_us - anchor_pts;
+            if offset >= 0 {
+                let deadline = anchor_time + Duration::from_micros(offset as u64);
+                if deadline + Duration::from_secs(1) > now {
+                    return deadline;
+                }
+            }
+        }
+        let deadline = now + playout_delay;
+        *anchor = Some((deadline, pts_us));
+        deadline
+    }
+
+    /// Decode the next queued frame. Returns false if the queue was empty.
+    fn step(&self, now: Instant, atlas: &TextureAtlas) -> bool {
+        let mut skipped = 0;
+        let (frame, late) = {
+            let mut queue = self.queue.lock().unwrap();
+            let Some(mut frame) = queue.pop_front() else {
+                return false;
+            };
+            let cost = Duration::from_micros(self.cost_us.load(Ordering::Relaxed));
+            let mut late = now + cost > frame.deadline;
+            if late && !frame.keyframe {
+                // Catch up at the next keyframe instead of decoding frames
+                // nobody will see
+                if let Some(position) = queue.iter().position(|f| f.keyframe) {
+                    skipped = position as u64 + 1;
+                    queue.drain(..position);
+                    frame = queue.pop_front().unwrap();
+                    late = now + cost > frame.deadline;
+                }
+            }
+            (frame, late)
+        };
+
+        let started = Instant::now();
+        let mut stats = StreamStats {
+            skipped_to_keyframe: skipped,
+            ..StreamStats::default()
+        };
+        {
+            let mut decoder = self.decoder.lock().unwrap();
+            let prefixed;
+            let mut data = &frame.data[..];
+            if frame.keyframe {
+                if let Some(parameter_sets) = self.parameter_sets.lock().unwrap().as_ref() {
+                    prefixed = [parameter_sets.as_slice(), data].concat();
+                    data = &prefixed;
+                }
+            }
+            match decoder.decode(data, !late) {
+                Ok(picture) => {
+                    stats.decoded = 1;
+                    match picture {
+                        Some(picture) if !late => {
+                            atlas.write_tile(self.tile, &picture);
+                            stats.displayed = 1;
+                        }
+                        _ if late => stats.dropped_late = 1,
+                        _ => {}
+                    }
+                }
+                Err(_) => stats.decode_errors = 1,
+            }
+        }
+
+        if !late {
+            // Only full decodes update the cost estimate
+            let elapsed = started.elapsed().as_micros() as u64;
+            let previous = self.cost_us.load(Ordering::Relaxed);
+            let smoothed = if previous == 0 { elapsed } else { (previous * 7 + elapsed) / 8 };
+            self.cost_us.store(smoothed, Ordering::Relaxed);
+        }
+        self.stats.lock().unwrap().add(&stats);
+        true
+    }
+}
+
+struct Task {
+    deadline: Instant,
+    stream: Arc<Stream>,
+}
+
+impl PartialEq for Task {
+    fn eq(&self, other: &Self) -> bool {
+        self.deadline == other.deadline
+    }
+}
+
+impl Eq for Task {}
+
+impl PartialOrd for Task {
+    fn partial_cmp(&self, other: &Self) -> Option<CmpOrdering> {
+        Some(self.cmp(other))
+    }
+}
+
+impl Ord for Task {
+    // Earliest deadline first in a max-heap
+    fn cmp(&self, other: &Self) -> CmpOrdering {
+        other.deadline.cmp(&self.deadline)
+    }
+}
+
+/// RGBA atlas of equally sized tiles, one per stream
+pub struct TextureAtlas {
+    pub tile_width: usize,
+    pub tile_height: usize,
+    pub columns: usize,
+    pub rows: usize,
+    tiles: Vec<Mutex<Vec<u8>>>,
+    dirty: Vec<AtomicBool>,
+}
+
+impl TextureAtlas {
+    pub fn new(tile_width: usize, tile_height: usize, columns: usize, rows: usize) -> Self {
+        let count = columns * rows;
+        Self {
+            tile_width,
+            tile_height,
+            columns,
+            rows,
+            tiles: (0..count)
+                .map(|_| Mutex::new(vec![0; tile_width * tile_height * 4]))
+                .collect(),
+            dirty: (0..count).map(|_| AtomicBool::new(false)).collect(),
+        }
+    }
+
+    pub fn width(&self) -> usize {
+        self.tile_width * self.columns
+    }
+
+    pub fn height(&self) -> usize {
+        self.tile_height * self.rows
+    }
+
+    /// Convert `picture` (BT.601 limited range) into tile `index`, scaling to
+    /// the tile size with nearest-neighbour sampling
+    pub fn write_tile(&self, index: usize, picture: &Picture) {
+        let Some(tile) = self.tiles.get(index) else { return };
+        if picture.width == 0 || picture.height == 0 {
+            return;
+        }
+        let (tw, th) = (self.tile_width, self.tile_height);
+        let source_x: Vec<usize> = (0..tw).map(|x| x * picture.width / tw).collect();
+
+        let mut pixels = tile.lock().unwrap();
+        for (ty, row) in pixels.chunks_exact_mut(tw * 4).enumerate() {
+            let sy = ty * picture.height / th;
+            let y_row = &picture.y[sy * picture.y_stride..];
+            let u_row = &picture.u[(sy / 2) * picture.uv_stride..];
+            let v_row = &picture.v[(sy / 2) * picture.uv_stride..];
+            for (pixel, &sx) in row.chunks_exact_mut(4).zip(&source_x) {
+                let c = 298 * (y_row[sx] as i32 - 16);
+                let d = u_row[sx / 2] as i32 - 128;
+                let e = v_row[sx / 2] as i32 - 128;
+                pixel[0] = ((c + 409 * e + 128) >> 8).clamp(0, 255) as u8;
+                pixel[1] = ((c - 100 * d - 208 * e + 128) >> 8).clamp(0, 255) as u8;
+                pixel[2] = ((c + 516 * d + 128) >> 8).clamp(0, 255) as u8;
+                pixel[3] = 255;
+            }
+        }
+        self.dirty[index].store(true, Ordering::Release);
+    }
+
+    /// Copy tiles changed since the last call into `out` (the full atlas,
+    /// RGBA rows of `width()` pixels). Returns the number of tiles copied.
+    pub fn copy_dirty(&self, out: &mut [u8]) -> usize {
+        let stride = self.width() * 4;
+        if out.len() < stride * self.height() {
+            return 0;
+        }
+        let row_len = self.tile_width * 4;
+        let mut copied = 0;
+        for (index, tile) in self.tiles.iter().enumerate() {
+            if !self.dirty[index].swap(false, Ordering::Acquire) {
+                continue;
+            }
+            let x = (index % self.columns) * row_len;
+            let y = (index / self.columns) * self.tile_height;
+            let pixels = tile.lock().unwrap();
+            for (row, source) in pixels.chunks_exact(row_len).enumerate() {
+                let start = (y + row) * stride + x;
+                out[start..start + row_len].copy_from_slice(source);
+            }
+            copied += 1;
+        }
+        copied
+    }
+}
+
+struct Shared {
+    queues: Vec<Mutex<BinaryHeap<Task>>>,
+    pending: AtomicUsize,
+    park: Mutex<()>,
+    wake: Condvar,
+    shutdown: AtomicBool,
+    atlas: TextureAtlas,
+}
+
+impl Shared {
+    fn schedule(&self, stream: &Arc<Stream>) {
+        if stream.scheduled.swap(true, Ordering::AcqRel) {
+            return;
+        }
+        let Some(deadline) = stream.head_deadline() else {
+            stream.scheduled.store(false, Ordering::Release);
+            return;
+        };
+        let worker = stream.last_worker.load(Ordering::Relaxed) % self.queues.len();
+        self.queues[worker].lock().unwrap().push(Task {
+            deadline,
+            stream: stream.clone(),
+        });
+        self.pending.fetch_add(1, Ordering::AcqRel);
+        self.wake.notify_one();
+    }
+
+    fn next_task(&self, worker: usize) -> Option<Task> {
+        if let Some(task) = self.queues[worker].lock().unwrap().pop() {
+            return Some(task);
+        }
+        // Steal the most urgent task from the busiest peer
+        let victim = (0..self.queues.len())
+            .filter(|&i| i != worker)
+            .max_by_key(|&i| self.queues[i].lock().unwrap().len())?;
+        self.queues[victim].lock().unwrap().pop()
+    }
+
+    fn run(&self, worker: usize) {
+        while !self.shutdown.load(Ordering::Acquire) {
+            let Some(task) = self.next_task(worker) else {
+                let guard = self.park.lock().unwrap();
+                if self.pending.load(Ordering::Acquire) == 0 {
+                    let _ = self.wake.wait_timeout(guard, Duration::from_millis(5));
+                }
+                continue;
+            };
+            self.pending.fetch_sub(1, Ordering::AcqRel);
+
+            let stream = task.stream;
+            stream.last_worker.store(worker, Ordering::Relaxed);
+            stream.step(Instant::now(), &self.atlas);
+
+            // One frame per task keeps scheduling earliest-deadline-first
+            // across streams; requeue if more frames arrived meanwhile
+            stream.scheduled.store(false, Ordering::Release);
+            if stream.head_deadline().is_some() {
+                self.schedule(&stream);
+            }
+        }
+    }
+}
+
+/// Shared decode service feeding a texture atlas
+pub struct GridDecoder {
+    config: GridConfig,
+    shared: Arc<Shared>,
+    streams: RwLock<HashMap<u64, Arc<Stream>>>,
+    workers: Mutex<Vec<JoinHandle<()>>>,
+}
+
+impl GridDecoder {
+    pub fn new(config: GridConfig) -> Self {
+        let workers = if config.workers == 0 {
+            std::thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+        } else {
+            config.workers
+        };
+        let shared = Arc::new(Shared {
+            queues: (0..workers).map(|_| Mutex::new(BinaryHeap::new())).collect(),
+            pending: AtomicUsize::new(0),
+            park: Mutex::new(()),
+            wake: Condvar::new(),
+            shutdown: AtomicBool::new(false),
+            atlas: TextureAtlas::new(config.tile_width, config.tile_height, config.columns, config.rows),
+        });
+        let handles = (0..workers)
+            .map(|worker| {
+                let shared = shared.clone();
+                std::thread::Builder::new()
+                    .name(format!("grid-decode-{}", worker))
+                    .spawn(move || shared.run(worker))
+                    .expect("spawn decode worker")
+            })
+            .collect();
+        Self {
+            config: GridConfig { workers, ..config },
+            shared,
+            streams: RwLock::new(HashMap::new()),
+            workers: Mutex::new(handles),
+        }
+    }
+
+    pub fn worker_count(&self) -> usize {
+        self.config.workers
+    }
+
+    pub fn atlas(&self) -> &TextureAtlas {
+        &self.shared.atlas
+    }
+
+    /// Add a stream shown in atlas tile `tile`
+    pub fn add_stream(&self, stream_id: u64, tile: usize, decoder: Box<dyn VideoDecoder>) -> bool {
+        if tile >= self.config.columns * self.config.rows {
+            return false;
+        }
+        let mut streams = self.streams.write().unwrap();
+        if streams.contains_key(&stream_id) {
+            return false;
+        }
+        let stream = Arc::new(Stream::new(tile, decoder));
+        // Spread new streams over the workers; stealing rebalances later
+        stream.last_worker.store(streams.len() % self.config.workers, Ordering::Relaxed);
+        streams.insert(stream_id, stream);
+        true
+    }
+
+    pub fn remove_stream(&self, stream_id: u64) -> bool {
+        let removed = self.streams.write().unwrap().remove(&stream_id);
+        if let Some(stream) = removed {
+            // A queued task may still hold the stream; it finds the queue empty
+            stream.queue.lock().unwrap().clear();
+            true
+        } else {
+            false
+        }
+    }
+
+    /// Set the stream's avcC record; its SPS/PPS are sent ahead of keyframes
+    pub fn set_avcc(&self, stream_id: u64, avcc: &[u8]) -> bool {
+        let Some(stream) = self.stream(stream_id) else { return false };
+        match avcc_parameter_sets(avcc) {
+            Some(parameter_sets) => {
+                *stream.parameter_sets.lock().unwrap() = Some(parameter_sets);
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Queue an access unit (Annex-B, or AVCC with 4-byte lengths)
+    pub fn push(&self, stream_id: u64, data: &[u8], pts_us: i64, keyframe: bool) -> bool {
+        let Some(stream) = self.stream(stream_id) else { return false };
+        let now = Instant::now();
+        let deadline = stream.deadline(pts_us, now, self.config.playout_delay);
+        let data = if is_annex_b(data) { data.to_vec() } else { avcc_to_annex_b(data) };
+        stream.queue.lock().unwrap().push_back(EncodedFrame {
+            data,
+            deadline,
+            keyframe,
+        });
+        self.shared.schedule(&stream);
+        true
+    }
+
+    /// Counters of one stream, or of all streams
+    pub fn stats(&self, stream_id: Option<u64>) -> Option<StreamStats> {
+        let streams = self.streams.read().unwrap();
+        match stream_id {
+            Some(id) => streams.get(&id).map(|s| *s.stats.lock().unwrap()),
+            None => {
+                let mut total = StreamStats::default();
+                for stream in streams.values() {
+                    total.add(&stream.stats.lock().unwrap());
+                }
+                Some(total)
+            }
+        }
+    }
+
+    fn stream(&self, stream_id: u64) -> Option<Arc<Stream>> {
+        self.streams.read().unwrap().get(&stream_id).cloned()
+    }
+}
+
+impl Drop for GridDecoder {
+    fn drop(&mut self) {
+        self.shared.shutdown.store(true, Ordering::Release);
+        self.shared.wake.notify_all();
+        for handle in self.workers.lock().unwrap().drain(..) {
+            let _ = handle.join();
+        }
+    }
+}
+
+fn is_annex_b(data: &[u8]) -> bool {
+    data.starts_with(&[0, 0, 1]) || data.starts_with(&[0, 0, 0, 1])
+}
+
+/// Convert 4-byte length-prefixed NAL units to Annex-B start codes
+pub fn avcc_to_annex_b(data: &[u8]) -> Vec<u8> {
+    let mut out = Vec::with_capacity(data.len() + 16);
+    let mut offset = 0;
+    while offset + 4 <= data.len() {
+        let len = u32::from_be_bytes(data[offset..offset + 4].try_into().unwrap()) as usize;
+        offset += 4;
+        if offset + len > data.len() {
+            break;
+        }
+        out.extend_from_slice(&[0, 0, 0, 1]);
+        out.extend_from_slice(&data[offset..offset + len]);
+        offset += len;
+    }
+    out
+}
+
+/// SPS and PPS of an AVCDecoderConfigurationRecord as Annex-B
+pub fn avcc_parameter_sets(avcc: &[u8]) -> Option<Vec<u8>> {
+    if avcc.len() < 7 || avcc[0] != 1 {
+        return None;
+    }
+    let mut out = Vec::new();
+    let mut offset = 5;
+    for count_mask in [0x1f, 0xff] {
+        let count = (*avcc.get(offset)? & count_mask) as usize;
+        offset += 1;
+        for _ in 0..count {
+            let len = u16::from_be_bytes([*avcc.get(offset)?, *avcc.get(offset + 1)?]) as usize;
+            offset += 2;
+            out.extend_from_slice(&[0, 0, 0, 1]);
+            out.extend_from_slice(avcc.get(offset..offset + len)?);
+            offset += len;
+        }
+    }
+    Some(out)
+}
+
+// libavcodec bindings. Only the leading fields of AVPacket and AVFrame are
+// declared; they have kept this layout across FFmpeg 4 to 7.
+mod ffi {
+    use super::*;
+
+    #[repr(C)]
+    pub struct AVPacketHead {
+        pub buf: *mut c_void,
+        pub pts: i64,
+        pub dts: i64,
+        pub data: *mut u8,
+        pub size: c_int,
+    }
+
+    #[repr(C)]
+    pub struct AVFrameHead {
+        pub data: [*mut u8; 8],
+        pub linesize: [c_int; 8],
+        pub extended_data: *mut *mut u8,
+        pub width: c_int,
+        pub height: c_int,
+        pub nb_samples: c_int,
+        pub format: c_int,
+    }
+
+    pub const AV_PIX_FMT_YUV420P: c_int = 0;
+    pub const AV_PIX_FMT_YUVJ420P: c_int = 12;
+    pub const AVDISCARD_DEFAULT: i64 = 0;
+    pub const AVDISCARD_NONREF: i64 = 8;
+    pub const AV_INPUT_BUFFER_PADDING_SIZE: usize = 64;
+
+    #[link(name = "avcodec")]
+    extern "C" {
+        pub fn avcodec_find_decoder_by_name(name: *const c_char) -> *const c_void;
+        pub fn avcodec_alloc_context3(codec: *const c_void) -> *mut c_void;
+        pub fn avcodec_open2(ctx: *mut c_void, codec: *const c_void, options: *mut *mut c_void) -> c_int;
+        pub fn avcodec_free_context(ctx: *mut *mut c_void);
+        pub fn avcodec_send_packet(ctx: *mut c_void, packet: *const c_void) -> c_int;
+        pub fn avcodec_receive_frame(ctx: *mut c_void, frame: *mut c_void) -> c_int;
+        pub fn av_packet_alloc() -> *mut c_void;
+        pub fn av_packet_free(packet: *mut *mut c_void);
+    }
+
+    #[link(name = "avutil")]
+    extern "C" {
+        pub fn av_frame_alloc() -> *mut c_void;
+        pub fn av_frame_free(frame: *mut *mut c_void);
+        pub fn av_dict_set(dict: *mut *mut c_void, key: *const c_char, value: *const c_char, flags: c_int) -> c_int;
+        pub fn av_dict_free(dict: *mut *mut c_void);
+        pub fn av_opt_set_int(obj: *mut c_void, name: *const c_char, value: i64, flags: c_int) -> c_int;
+    }
+}
+
+/// Single-threaded libavcodec H.264 decoder; parallelism comes from the pool
+pub struct AvcodecDecoder {
+    context: *mut c_void,
+    packet: *mut c_void,
+    frame: *mut c_void,
+    input: Vec<u8>,
+    discarding: bool,
+}
+
+// Each decoder is only used by one worker at a time
+unsafe impl Send for AvcodecDecoder {}
+
+impl AvcodecDecoder {
+    pub fn new() -> Result<Self, i32> {
+        unsafe {
+            let codec = ffi::avcodec_find_decoder_by_name(c"h264".as_ptr());
+            if codec.is_null() {
+                return Err(-1);
+            }
+            let mut context = ffi::avcodec_alloc_context3(codec);
+            if context.is_null() {
+                return Err(-1);
+            }
+
+            let mut options: *mut c_void = ptr::null_mut();
+            ffi::av_dict_set(&mut options, c"threads".as_ptr(), c"1".as_ptr(), 0);
+            ffi::av_dict_set(&mut options, c"flags".as_ptr(), c"low_delay".as_ptr(), 0);
+            let ret = ffi::avcodec_open2(context, codec, &mut options);
+            ffi::av_dict_free(&mut options);
+            if ret < 0 {
+                ffi::avcodec_free_context(&mut context);
+                return Err(ret);
+            }
+
+            Ok(Self {
+                context,
+                packet: ffi::av_packet_alloc(),
+                frame: ffi::av_frame_alloc(),
+                input: Vec::new(),
+                discarding: false,
+            })
+        }
+    }
+}
+
+impl VideoDecoder for AvcodecDecoder {
+    fn decode(&mut self, data: &[u8], output: bool) -> Result<Option<Picture<'_>>, i32> {
+        unsafe {
+            if self.discarding == output {
+                let mode = if output { ffi::AVDISCARD_DEFAULT } else { ffi::AVDISCARD_NONREF };
+                ffi::av_opt_set_int(self.context, c"skip_frame".as_ptr(), mode, 0);
+                self.discarding = !output;
+            }
+
+            // The bitstream reader may overread into zeroed padding
+            self.input.clear();
+            self.input.extend_from_slice(data);
+            self.input.resize(data.len() + ffi::AV_INPUT_BUFFER_PADDING_SIZE, 0);
+            let packet = &mut *(self.packet as *mut ffi::AVPacketHead);
+            packet.data = self.input.as_mut_ptr();
+            packet.size = data.len() as c_int;
+
+            let ret = ffi::avcodec_send_packet(self.context, self.packet);
+            packet.data = ptr::null_mut();
+            packet.size = 0;
+            if ret < 0 {
+                return Err(ret);
+            }
+
+            if ffi::avcodec_receive_frame(self.context, self.frame) < 0 {
+                return Ok(None);
+            }
+            let frame = &*(self.frame as *const ffi::AVFrameHead);
+            if frame.format != ffi::AV_PIX_FMT_YUV420P && frame.format != ffi::AV_PIX_FMT_YUVJ420P {
+                return Err(-2);
+            }
+            let (width, height) = (frame.width as usize, frame.height as usize);
+            let y_stride = frame.linesize[0] as usize;
+            let uv_stride = frame.linesize[1] as usize;
+            let chroma_rows = height.div_ceil(2);
+            Ok(Some(Picture {
+                width,
+                height,
+                y: std::slice::from_raw_parts(frame.data[0], y_stride * height),
+                u: std::slice::from_raw_parts(frame.data[1], uv_stride * chroma_rows),
+                v: std::slice::from_raw_parts(frame.data[2], frame.linesize[2] as usize * chroma_rows),
+                y_stride,
+                uv_stride,
+            }))
+        }
+    }
+}
+
+impl Drop for AvcodecDecoder {
+    fn drop(&mut self) {
+        unsafe {
+            ffi::av_frame_free(&mut self.frame);
+            ffi::av_packet_free(&mut self.packet);
+            ffi::avcodec_free_context(&mut self.context);
+        }
+    }
+}
+
+// Global decoder registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static GRID_DECODERS: Lazy<DashMap<u64, Arc<GridDecoder>>> = Lazy::new(|| DashMap::new());
+static NEXT_GRID_ID: AtomicU64 = AtomicU64::new(1);
+
+fn grid(grid_id: u64) -> Option<Arc<GridDecoder>> {
+    GRID_DECODERS.get(&grid_id).map(|g| g.clone())
+}
+
+// FFI Functions
+
+/// Create a grid decode service
+///
+/// # Arguments
+/// * `workers` - Decode threads (0 = one per core)
+/// * `tile_width`, `tile_height` - Size of each stream's tile in pixels
+/// * `columns`, `rows` - Atlas layout in tiles
+/// * `playout_delay_ms` - Delay from a stream's first frame to its display
+///
+/// # Returns
+/// Grid ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_create(
+    workers: c_int,
+    tile_width: c_int,
+    tile_height: c_int,
+    columns: c_int,
+    rows: c_int,
+    playout_delay_ms: c_int,
+) -> u64 {
+    if workers < 0 || tile_width <= 0 || tile_height <= 0 || columns <= 0 || rows <= 0 {
+        return 0;
+    }
+    let config = GridConfig {
+        workers: workers as usize,
+        tile_width: tile_width as usize,
+        tile_height: tile_height as usize,
+        columns: columns as usize,
+        rows: rows as usize,
+        playout_delay: Duration::from_millis(playout_delay_ms.max(0) as u64),
+    };
+    let decoder = GridDecoder::new(config);
+    let id = NEXT_GRID_ID.fetch_add(1, Ordering::Relaxed);
+    log::info!(
+        "Created grid decoder {} ({} workers, {}x{} tiles of {}x{})",
+        id,
+        decoder.worker_count(),
+        columns,
+        rows,
+        tile_width,
+        tile_height
+    );
+    GRID_DECODERS.insert(id, Arc::new(decoder));
+    id
+}
+
+/// Destroy a grid decode service and stop its workers
+#[no_mangle]
+pub extern "C" fn grid_decoder_destroy(grid_id: u64) {
+    if GRID_DECODERS.remove(&grid_id).is_some() {
+        log::info!("Destroyed grid decoder {}", grid_id);
+    }
+}
+
+/// Add an H.264 stream shown in atlas tile `tile`
+///
+/// # Returns
+/// 0 on success, -1 if the grid does not exist, -2 if the stream exists or the
+/// tile is out of range, -3 if the decoder could not be created
+#[no_mangle]
+pub extern "C" fn grid_decoder_add_stream(grid_id: u64, stream_id: u64, tile: c_int) -> c_int {
+    let Some(grid) = grid(grid_id) else { return -1 };
+    if tile < 0 {
+        return -2;
+    }
+    let decoder = match AvcodecDecoder::new() {
+        Ok(decoder) => decoder,
+        Err(e) => {
+            log::error!("Failed to create H.264 decoder: {}", e);
+            return -3;
+        }
+    };
+    if grid.add_stream(stream_id, tile as usize, Box::new(decoder)) {
+        0
+    } else {
+        -2
+    }
+}
+
+/// Remove a stream
+///
+/// # Returns
+/// 0 on success, -1 if the grid or stream does not exist
+#[no_mangle]
+pub extern "C" fn grid_decoder_remove_stream(grid_id: u64, stream_id: u64) -> c_int {
+    match grid(grid_id) {
+        Some(grid) if grid.remove_stream(stream_id) => 0,
+        _ => -1,
+    }
+}
+
+/// Set a stream's AVCDecoderConfigurationRecord
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_set_avcc(
+    grid_id: u64,
+    stream_id: u64,
+    data: *const u8,
+    len: usize,
+) -> c_int {
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let avcc = unsafe { std::slice::from_raw_parts(data, len) };
+    match grid(grid_id) {
+        Some(grid) if grid.set_avcc(stream_id, avcc) => 0,
+        _ => -1,
+    }
+}
+
+/// Queue an access unit for decoding
+///
+/// # Arguments
+/// * `grid_id` - Grid ID
+/// * `stream_id` - Stream ID
+/// * `data` - Access unit, Annex-B or AVCC with 4-byte lengths
+/// * `len` - Length of `data`
+/// * `pts_us` - Presentation time in microseconds
+/// * `keyframe` - Non-zero for IDR access units
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_push(
+    grid_id: u64,
+    stream_id: u64,
+    data: *const u8,
+    len: usize,
+    pts_us: i64,
+    keyframe: c_int,
+) -> c_int {
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let access_unit = unsafe { std::slice::from_raw_parts(data, len) };
+    match grid(grid_id) {
+        Some(grid) if grid.push(stream_id, access_unit, pts_us, keyframe != 0) => 0,
+        _ => -1,
+    }
+}
+
+/// Get the atlas size in pixels
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_atlas_size(
+    grid_id: u64,
+    out_width: *mut u32,
+    out_height: *mut u32,
+) -> c_int {
+    if out_width.is_null() || out_height.is_null() {
+        return -1;
+    }
+    let Some(grid) = grid(grid_id) else { return -1 };
+    unsafe {
+        *out_width = grid.atlas().width() as u32;
+        *out_height = grid.atlas().height() as u32;
+    }
+    0
+}
+
+/// Copy tiles that changed since the last call into the caller's atlas copy
+///
+/// # Arguments
+/// * `out` - RGBA buffer of the full atlas, kept by the caller between calls
+/// * `len` - Length of `out` (at least width * height * 4)
+///
+/// # Returns
+/// Number of tiles updated, or -1 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_read_atlas(grid_id: u64, out: *mut u8, len: usize) -> c_int {
+    if out.is_null() {
+        return -1;
+    }
+    let Some(grid) = grid(grid_id) else { return -1 };
+    let atlas = grid.atlas();
+    if len < atlas.width() * atlas.height() * 4 {
+        return -1;
+    }
+    let out = unsafe { std::slice::from_raw_parts_mut(out, len) };
+    atlas.copy_dirty(out) as c_int
+}
+
+/// Get decode counters for one stream, or all streams if `stream_id` is 0
+///
+/// # Arguments
+/// * `out_stats` - Receives decoded, displayed, dropped late, skipped to
+///   keyframe and decode errors, in order
+/// * `len` - Capacity of `out_stats`
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn grid_decoder_get_stats(
+    grid_id: u64,
+    stream_id: u64,
+    out_stats: *mut u64,
+    len: usize,
+) -> c_int {
+    if out_stats.is_null() {
+        return -1;
+    }
+    let Some(grid) = grid(grid_id) else { return -1 };
+    let Some(stats) = grid.stats((stream_id != 0).then_some(stream_id)) else {
+        return -1;
+    };
+    let values = [
+        stats.decoded,
+        stats.displayed,
+        stats.dropped_late,
+        stats.skipped_to_keyframe,
+        stats.decode_errors,
+    ];
+    let count = len.min(values.len());
+    let out = unsafe { std::slice::from_raw_parts_mut(out_stats, count) };
+    out.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::HashSet;
+    use std::process::Command;
+    use std::thread::ThreadId;
+
+    // Test decoder: spins for `cost`, records which thread and which frame
+    // (first payload byte after the start code) it decoded
+    struct FakeDecoder {
+        cost: Duration,
+        plane: Vec<u8>,
+        seen: Arc<Mutex<Vec<(ThreadId, u8)>>>,
+    }
+
+    impl FakeDecoder {
+        fn boxed(cost: Duration, luma: u8, seen: &Arc<Mutex<Vec<(ThreadId, u8)>>>) -> Box<dyn VideoDecoder> {
+            Box::new(Self {
+                cost,
+                plane: vec![luma; 16 * 16],
+                seen: seen.clone(),
+            })
+        }
+    }
+
+    impl VideoDecoder for FakeDecoder {
+        fn decode(&mut self, data: &[u8], _output: bool) -> Result<Option<Picture<'_>>, i32> {
+            let started = Instant::now();
+            while started.elapsed() < self.cost {
+                std::hint::spin_loop();
+            }
+            self.seen.lock().unwrap().push((std::thread::current().id(), data[4]));
+            Ok(Some(Picture {
+                width: 16,
+                height: 16,
+                y: &self.plane,
+                u: &self.plane[..64],
+                v: &self.plane[..64],
+                y_stride: 16,
+                uv_stride: 8,
+            }))
+        }
+    }
+
+    fn access_unit(sequence: u8) -> Vec<u8> {
+        vec![0, 0, 0, 1, sequence]
+    }
+
+    fn wait_for(condition: impl Fn() -> bool) {
+        let deadline = Instant::now() + Duration::from_secs(5);
+        while !condition() {
+            assert!(Instant::now() < deadline, "timed out");
+            std::thread::sleep(Duration::from_millis(1));
+        }
+    }
+
+    #[test]
+    fn decodes_every_stream_in_order_across_workers() {
+        let grid = GridDecoder::new(GridConfig {
+            workers: 4,
+            tile_width: 16,
+            tile_height: 16,
+            columns: 4,
+            rows: 4,
+            playout_delay: Duration::from_secs(10),
+        });
+        let logs: Vec<_> = (0..16).map(|_| Arc::new(Mutex::new(Vec::new()))).collect();
+        for (stream, log) in logs.iter().enumerate() {
+            // All streams start on worker 0, so the others must steal
+            assert!(grid.add_stream(stream as u64, stream, FakeDecoder::boxed(Duration::from_millis(1), 128, log)));
+            grid.streams.read().unwrap()[&(stream as u64)].last_worker.store(0, Ordering::Relaxed);
+        }
+        for frame in 0..10u8 {
+            for stream in 0..16u64 {
+                assert!(grid.push(stream, &access_unit(frame), frame as i64 * 33_333, frame == 0));
+            }
+        }
+
+        wait_for(|| grid.stats(None).unwrap().displayed == 160);
+        let mut threads = HashSet::new();
+        for log in &logs {
+            let log = log.lock().unwrap();
+            let order: Vec<u8> = log.iter().map(|(_, sequence)| *sequence).collect();
+            assert_eq!(order, (0..10).collect::<Vec<u8>>());
+            threads.extend(log.iter().map(|(thread, _)| *thread));
+        }
+        assert!(threads.len() > 1, "no work was stolen");
+    }
+
+    #[test]
+    fn late_frames_skip_to_next_keyframe() {
+        let seen = Arc::new(Mutex::new(Vec::new()));
+        let stream = Stream::new(0, FakeDecoder::boxed(Duration::ZERO, 128, &seen));
+        let atlas = TextureAtlas::new(16, 16, 1, 1);
+        let start = Instant::now();
+        for frame in 1..10u8 {
+            stream.queue.lock().unwrap().push_back(EncodedFrame {
+                data: access_unit(frame),
+                deadline: start + Duration::from_millis(frame as u64 * 10),
+                keyframe: frame == 6,
+            });
+        }
+
+        // 35ms in, frame 1 is late: frames 1-5 are skipped and keyframe 6
+        // is still on time
+        let now = start + Duration::from_millis(35);
+        assert!(stream.step(now, &atlas));
+        let stats = *stream.stats.lock().unwrap();
+        assert_eq!(stats.skipped_to_keyframe, 5);
+        assert_eq!(stats.dropped_late, 0);
+        assert_eq!(stats.displayed, 1);
+        assert_eq!(seen.lock().unwrap()[0].1, 6);
+
+        // Frames that are still late and have no keyframe ahead decode without output
+        let late = start + Duration::from_millis(200);
+        while stream.step(late, &atlas) {}
+        let stats = *stream.stats.lock().unwrap();
+        assert_eq!(stats.dropped_late, 3);
+        assert_eq!(stats.decoded, 4);
+    }
+
+    #[test]
+    fn atlas_places_and_converts_tiles() {
+        let atlas = TextureAtlas::new(4, 2, 2, 2);
+        let white = vec![235u8; 64];
+        let neutral = vec![128u8; 16];
+        let picture = Picture {
+            width: 8,
+            height: 4,
+            y: &white,
+            u: &neutral,
+            v: &neutral,
+            y_stride: 8,
+            uv_stride: 4,
+        };
+        atlas.write_tile(3, &picture);
+
+        let mut out = vec![0u8; atlas.width() * atlas.height() * 4];
+        assert_eq!(atlas.copy_dirty(&mut out), 1);
+        assert_eq!(atlas.copy_dirty(&mut out), 0);
+
+        let pixel = |x: usize, y: usize| &out[(y * atlas.width() + x) * 4..][..4];
+        assert_eq!(pixel(0, 0), &[0, 0, 0, 0]);
+        assert_eq!(pixel(4, 2), &[255, 255, 255, 255]);
+        assert_eq!(pixel(7, 3), &[255, 255, 255, 255]);
+        assert_eq!(pixel(3, 3), &[0, 0, 0, 0]);
+    }
+
+    #[test]
+    fn converts_avcc_to_annex_b() {
+        let avcc = [0, 0, 0, 2, 0x67, 0x42, 0, 0, 0, 1, 0x68];
+        assert_eq!(avcc_to_annex_b(&avcc), vec![0, 0, 0, 1, 0x67, 0x42, 0, 0, 0, 1, 0x68]);
+
+        let record = [1, 0x42, 0, 0x1e, 0xff, 0xe1, 0, 2, 0x67, 0x42, 1, 0, 1, 0x68];
+        assert_eq!(
+            avcc_parameter_sets(&record).unwrap(),
+            vec![0, 0, 0, 1, 0x67, 0x42, 0, 0, 0, 1, 0x68]
+        );
+    }
+
+    // Ten seconds of 360p30 H.264 split into access units (needs the ffmpeg CLI)
+    fn fixture() -> Option<Vec<(Vec<u8>, bool)>> {
+        let output = Command::new("ffmpeg")
+            .args([
+                "-hide_banner", "-loglevel", "error",
+                "-f", "lavfi", "-i", "testsrc2=size=640x360:rate=30",
+                "-t", "10", "-c:v", "libx264", "-profile:v", "baseline",
+                "-preset", "veryfast", "-b:v", "600k", "-g", "60",
+                "-x264-params", "aud=1", "-pix_fmt", "yuv420p",
+                "-f", "h264", "pipe:1",
+            ])
+            .output()
+            .ok()?;
+        if !output.status.success() {
+            return None;
+        }
+
+        // Split at access unit delimiters (NAL type 9)
+        let data = output.stdout;
+        let mut starts = Vec::new();
+        for i in 0..data.len().saturating_sub(4) {
+            if data[i..i + 4] == [0, 0, 0, 1] && data[i + 4] & 0x1f == 9 {
+                starts.push(i);
+            }
+        }
+        starts.push(data.len());
+        Some(
+            starts
+                .windows(2)
+                .map(|w| {
+                    let unit = data[w[0]..w[1]].to_vec();
+                    let keyframe = unit.windows(4).any(|n| n[..3] == [0, 0, 1] && n[3] & 0x1f == 5);
+                    (unit, keyframe)
+                })
+                .collect(),
+        )
+    }
+
+    // Benchmark: how many 360p30 streams one core decodes on time
+    //
+    // Runs N streams in real time on a single worker and counts frames that
+    // made their display deadline (100ms playout delay). The largest N with at
+    // least 99% on time is the per-core capacity. Needs libavcodec and ffmpeg.
+    #[test]
+    #[ignore]
+    fn bench_streams_per_core() {
+        let Some(units) = fixture() else {
+            eprintln!("ffmpeg not available, skipping");
+            return;
+        };
+        const SECONDS: usize = 4;
+        let frames = (SECONDS * 30).min(units.len());
+        let mut capacity = 0;
+
+        for streams in [1usize, 2, 4, 6, 8, 12, 16, 20, 24, 32, 40, 48] {
+            let columns = (streams as f64).sqrt().ceil() as usize;
+            let grid = GridDecoder::new(GridConfig {
+                workers: 1,
+                tile_width: 320,
+                tile_height: 180,
+                columns,
+                rows: streams.div_ceil(columns),
+                playout_delay: Duration::from_millis(100),
+            });
+            for stream in 0..streams {
+                grid.add_stream(stream as u64, stream, Box::new(AvcodecDecoder::new().unwrap()));
+            }
+
+            let start = Instant::now();
+            for frame in 0..frames {
+                let due = start + Duration::from_micros(frame as u64 * 33_333);
+                if let Some(wait) = due.checked_duration_since(Instant::now()) {
+                    std::thread::sleep(wait);
+                }
+                // Streams are offset so their keyframes don't align
+                for stream in 0..streams {
+                    let (unit, keyframe) = &units[(frame + stream * 7) % units.len()];
+                    grid.push(stream as u64, unit, frame as i64 * 33_333, *keyframe);
+                }
+            }
+            std::thread::sleep(Duration::from_millis(300));
+
+            let stats = grid.stats(None).unwrap();
+            let total = (streams * frames) as f64;
+            let on_time = stats.displayed as f64 / total;
+            println!(
+                "{:>3} streams: {:.1}% on time (late {}, skipped {}, errors {})",
+                streams,
+                on_time * 100.0,
+                stats.dropped_late,
+                stats.skipped_to_keyframe,
+                stats.decode_errors,
+            );
+            if on_time < 0.99 {
+                break;
+            }
+            capacity = streams;
+        }
+
+        println!("360p30 streams per core: {}", capacity);
+        assert!(capacity >= 1);
+    }
+}
@@ -0,0 +1,1120 @@
+// H.264 Annex-B bitstream toolkit
+//
+// The publish path gets Annex-B from the encoder and the fMP4 muxers want
+// AVCC, and both need to know where keyframes and resolution changes are.
+// Scanning for start codes a byte at a time and rebuilding every access
+// unit as a list of NAL copies costs more than the muxing itself at high
+// bitrates, so this does the byte work natively.
+//
+// Architecture:
+// - `find_start_code` looks for `00 00 01` 16 or 32 bytes per step (SSE2 or
+//   AVX2 on x86_64, NEON on aarch64, scalar elsewhere); emulation-prevention
+//   bytes (`00 00 03`) are found the same way
+// - Annex-B <-> AVCC conversions rewrite the buffer in place: 4-byte start
+//   codes become length prefixes without moving any payload, and mixed
+//   3-byte codes cost one compaction pass
+// - SPS, PPS and slice headers are parsed from an unescaped copy of their
+//   first bytes only, enough for keyframe and resolution detection
+
+use std::ops::Range;
+use std::os::raw::c_int;
+
+pub const NAL_SLICE: u8 = 1;
+pub const NAL_IDR: u8 = 5;
+pub const NAL_SEI: u8 = 6;
+pub const NAL_SPS: u8 = 7;
+pub const NAL_PPS: u8 = 8;
+pub const NAL_AUD: u8 = 9;
+
+// Slice headers are parsed from this many escaped bytes; the fields we read
+// sit well inside it
+const SLICE_HEADER_PREFIX: usize = 32;
+
+// -----------------------------------------------------------------------------
+// Scanning
+// -----------------------------------------------------------------------------
+
+/// Offset of the first `00 00 <third>` at or after `from`
+pub fn find_pattern(data: &[u8], from: usize, third: u8) -> Option<usize> {
+    if from >= data.len() {
+        return None;
+    }
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::is_x86_feature_detected!("avx2") {
+            // SAFETY: AVX2 support was checked at runtime
+            return unsafe { find_pattern_avx2(data, from, third) };
+        }
+        // SAFETY: SSE2 is part of the x86_64 baseline
+        unsafe { find_pattern_sse2(data, from, third) }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        // SAFETY: NEON is part of the aarch64 baseline
+        unsafe { find_pattern_neon(data, from, third) }
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        find_pattern_scalar(data, from, third)
+    }
+}
+
+/// Offset of the next `00 00 01` at or after `from`
+pub fn find_start_code(data: &[u8], from: usize) -> Option<usize> {
+    find_pattern(data, from, 1)
+}
+
+fn find_pattern_scalar(data: &[u8], from: usize, third: u8) -> Option<usize> {
+    (from..data.len().saturating_sub(2)).find(|&i| data[i] == 0 && data[i + 1] == 0 && data[i + 2] == third)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "sse2")]
+unsafe fn find_pattern_sse2(data: &[u8], from: usize, third: u8) -> Option<usize> {
+    use std::arch::x86_64::*;
+
+    let ptr = data.as_ptr();
+    let zero = _mm_setzero_si128();
+    let last = _mm_set1_epi8(third as i8);
+    let mut i = from;
+    // Byte k of the mask is set where data[i+k..i+k+3] is the pattern
+    while i + 18 <= data.len() {
+        let a = _mm_loadu_si128(ptr.add(i) as *const __m128i);
+        let b = _mm_loadu_si128(ptr.add(i + 1) as *const __m128i);
+        let c = _mm_loadu_si128(ptr.add(i + 2) as *const __m128i);
+        let hits = _mm_and_si128(
+            _mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)),
+            _mm_cmpeq_epi8(c, last),
+        );
+        let mask = _mm_movemask_epi8(hits) as u32;
+        if mask != 0 {
+            return Some(i + mask.trailing_zeros() as usize);
+        }
+        i += 16;
+    }
+    find_pattern_scalar(data, i, third)
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn find_pattern_avx2(data: &[u8], from: usize, third: u8) -> Option<usize> {
+    use std::arch::x86_64::*;
+
+    let ptr = data.as_ptr();
+    let zero = _mm256_setzero_si256();
+    let last = _mm256_set1_epi8(third as i8);
+    let mut i = from;
+    while i + 34 <= data.len() {
+        // Most 32-byte blocks of compressed video have no zero pair at all,
+        // so test the first two bytes of the pattern before the third
+        let a = _mm256_loadu_si256(ptr.add(i) as *const __m256i);
+        let b = _mm256_loadu_si256(ptr.add(i + 1) as *const __m256i);
+        let zeros = _mm256_and_si256(_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero));
+        if _mm256_testz_si256(zeros, zeros) == 0 {
+            let c = _mm256_loadu_si256(ptr.add(i + 2) as *const __m256i);
+            let mask = _mm256_movemask_epi8(_mm256_and_si256(zeros, _mm256_cmpeq_epi8(c, last))) as u32;
+            if mask != 0 {
+                return Some(i + mask.trailing_zeros() as usize);
+            }
+        }
+        i += 32;
+    }
+    find_pattern_sse2(data, i, third)
+}
+
+#[cfg(target_arch = "aarch64")]
+unsafe fn find_pattern_neon(data: &[u8], from: usize, third: u8) -> Option<usize> {
+    use std::arch::aarch64::*;
+
+    let ptr = data.as_ptr();
+    let last = vdupq_n_u8(third);
+    let mut i = from;
+    while i + 18 <= data.len() {
+        let a = vld1q_u8(ptr.add(i));
+        let b = vld1q_u8(ptr.add(i + 1));
+        let c = vld1q_u8(ptr.add(i + 2));
+        let hits = vandq_u8(vandq_u8(vceqzq_u8(a), vceqzq_u8(b)), vceqq_u8(c, last));
+        // No movemask on NEON: detect a hit, then find it in the block
+        if vmaxvq_u8(hits) != 0 {
+            return find_pattern_scalar(&data[..i + 18], i, third);
+        }
+        i += 16;
+    }
+    find_pattern_scalar(data, i, third)
+}
+
+/// NAL units of an Annex-B buffer, without start codes or trailing zeros
+pub struct NalUnits<'a> {
+    data: &'a [u8],
+    next: Option<usize>,
+}
+
+impl<'a> Iterator for NalUnits<'a> {
+    type Item = Range<usize>;
+
+    fn next(&mut self) -> Option<Range<usize>> {
+        loop {
+            let start = self.next? + 3;
+            let end = find_start_code(self.data, start);
+            self.next = end;
+            // A NAL unit never ends in a zero byte; zeros before the next
+            // start code are trailing_zero_8bits or its 4-byte form
+            let mut end = end.unwrap_or(self.data.len());
+            while end > start && self.data[end - 1] == 0 {
+                end -= 1;
+            }
+            if end > start {
+                return Some(start..end);
+            }
+        }
+    }
+}
+
+/// Iterate the NAL units of `data`; anything before the first start code
+/// is skipped
+pub fn nal_units(data: &[u8]) -> NalUnits<'_> {
+    NalUnits { data, next: find_start_code(data, 0) }
+}
+
+/// Start codes of `data` as (offset, length); a zero byte before `00 00 01`
+/// makes it the 4-byte form
+pub fn start_codes(data: &[u8]) -> impl Iterator<Item = (usize, usize)> + '_ {
+    let mut from = 0;
+    std::iter::from_fn(move || {
+        let at = find_start_code(data, from)?;
+        from = at + 3;
+        Some(if at > 0 && data[at - 1] == 0 { (at - 1, 4) } else { (at, 3) })
+    })
+}
+
+/// Whether `data` starts with a start code
+pub fn is_annex_b(data: &[u8]) -> bool {
+    data.starts_with(&[0, 0, 1]) || data.starts_with(&[0, 0, 0, 1])
+}
+
+// -----------------------------------------------------------------------------
+// Conversion
+// -----------------------------------------------------------------------------
+
+/// Rewrite the Annex-B access unit in `buf[..len]` as 4-byte
+/// length-prefixed NAL units, in place
+///
+/// `buf.len()` is the capacity: each 3-byte start code grows the output by
+/// one byte. Returns the new length, or Err(required capacity) with `buf`
+/// untouched.
+pub fn annex_b_to_avcc_in_place(buf: &mut [u8], len: usize) -> Result<usize, usize> {
+    let nals: Vec<Range<usize>> = nal_units(&buf[..len]).collect();
+    let out_len: usize = nals.iter().map(|nal| 4 + nal.len()).sum();
+    if out_len > buf.len() {
+        return Err(out_len);
+    }
+
+    // Every NAL already sits 4 bytes after the previous one ends: overwrite
+    // the start codes and leave the payload alone
+    let mut at = 0;
+    if nals.iter().all(|nal| {
+        let aligned = nal.start == at + 4;
+        at = nal.end;
+        aligned
+    }) {
+        for nal in &nals {
+            buf[nal.start - 4..nal.start].copy_from_slice(&(nal.len() as u32).to_be_bytes());
+        }
+        return Ok(out_len);
+    }
+
+    // Otherwise pack the payloads to the left (each moves left or stays),
+    // then spread them right to make room for the prefixes (each moves right
+    // or stays), so no move overwrites data that has not moved yet
+    let mut packed = Vec::with_capacity(nals.len());
+    let mut at = 0;
+    for nal in &nals {
+        buf.copy_within(nal.clone(), at);
+        packed.push(at..at + nal.len());
+        at += nal.len();
+    }
+    for (index, nal) in packed.iter().enumerate().rev() {
+        let dst = nal.start + 4 * (index + 1);
+        buf.copy_within(nal.clone(), dst);
+        buf[dst - 4..dst].copy_from_slice(&(nal.len() as u32).to_be_bytes());
+    }
+    Ok(out_len)
+}
+
+/// Convenience wrapper growing `buf` as needed
+pub fn annex_b_to_avcc(buf: &mut Vec<u8>) {
+    let len = buf.len();
+    let out_len = match annex_b_to_avcc_in_place(buf, len) {
+        Ok(out_len) => out_len,
+        Err(required) => {
+            buf.resize(required, 0);
+            annex_b_to_avcc_in_place(buf, len).unwrap_or(0)
+        }
+    };
+    buf.truncate(out_len);
+}
+
+/// Rewrite 4-byte length prefixes as 4-byte start codes, in place
+///
+/// Returns false (with any prefixes before the bad one already rewritten)
+/// if a length runs past the buffer.
+pub fn avcc_to_annex_b_in_place(buf: &mut [u8]) -> bool {
+    let mut offset = 0;
+    while offset < buf.len() {
+        let Some(prefix) = buf.get(offset..offset + 4) else { return false };
+        let len = u32::from_be_bytes(prefix.try_into().unwrap()) as usize;
+        if len > buf.len() - offset - 4 {
+            return false;
+        }
+        buf[offset..offset + 4].copy_from_slice(&[0, 0, 0, 1]);
+        offset += 4 + len;
+    }
+    true
+}
+
+/// Remove emulation-prevention bytes (`00 00 03` -> `00 00`) in place and
+/// return the new length
+pub fn remove_emulation_prevention(buf: &mut [u8]) -> usize {
+    let Some(first) = find_pattern(buf, 0, 3) else { return buf.len() };
+    let mut write = first + 2;
+    let mut read = first + 3;
+    while let Some(at) = find_pattern(buf, read, 3) {
+        // Matches are searched in the escaped bytes after the removed one,
+        // as in the spec's parsing loop
+        buf.copy_within(read..at + 2, write);
+        write += at + 2 - read;
+        read = at + 3;
+    }
+    buf.copy_within(read.., write);
+    write + buf.len() - read
+}
+
+/// Unescaped copy of the first `limit` bytes of `nal`
+fn rbsp_prefix(nal: &[u8], limit: usize) -> Vec<u8> {
+    let mut rbsp = nal[..nal.len().min(limit)].to_vec();
+    let len = remove_emulation_prevention(&mut rbsp);
+    rbsp.truncate(len);
+    rbsp
+}
+
+// -----------------------------------------------------------------------------
+// Parsing
+// -----------------------------------------------------------------------------
+
+/// Big-endian bit reader with Exp-Golomb codes
+pub struct BitReader<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> BitReader<'a> {
+    pub fn new(data: &'a [u8]) -> Self {
+        Self { data, pos: 0 }
+    }
+
+    pub fn bit(&mut self) -> Option<u32> {
+        let byte = *self.data.get(self.pos / 8)?;
+        let bit = (byte >> (7 - self.pos % 8)) & 1;
+        self.pos += 1;
+        Some(bit as u32)
+    }
+
+    pub fn bits(&mut self, count: u32) -> Option<u32> {
+        let mut value = 0;
+        for _ in 0..count {
+            value = (value << 1) | self.bit()?;
+        }
+        Some(value)
+    }
+
+    pub fn flag(&mut self) -> Option<bool> {
+        Some(self.bit()? == 1)
+    }
+
+    /// ue(v)
+    pub fn ue(&mut self) -> Option<u32> {
+        let mut zeros = 0;
+        while self.bit()? == 0 {
+            zeros += 1;
+            if zeros > 31 {
+                return None;
+            }
+        }
+        Some(((1u64 << zeros) - 1 + self.bits(zeros)? as u64) as u32)
+    }
+
+    /// se(v)
+    pub fn se(&mut self) -> Option<i32> {
+        let k = self.ue()? as i64;
+        Some(if k % 2 == 1 { (k + 1) / 2 } else { -(k / 2) } as i32)
+    }
+}
+
+/// Sequence parameter set fields used for detection
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Sps {
+    pub profile_idc: u8,
+    pub constraint_flags: u8,
+    pub level_idc: u8,
+    pub id: u32,
+    pub chroma_format_idc: u32,
+    pub separate_colour_plane: bool,
+    pub bit_depth_luma: u32,
+    pub log2_max_frame_num: u32,
+    pub frame_mbs_only: bool,
+    /// Display size after cropping
+    pub width: u32,
+    pub height: u32,
+}
+
+impl Sps {
+    /// Parse an SPS NAL unit (header byte included, still escaped)
+    pub fn parse(nal: &[u8]) -> Option<Sps> {
+        if nal.first()? & 0x1f != NAL_SPS {
+            return None;
+        }
+        // The fields we read end before any VUI, well inside this
+        let rbsp = rbsp_prefix(&nal[1..], 256);
+        let mut r = BitReader::new(&rbsp);
+        let profile_idc = r.bits(8)? as u8;
+        let constraint_flags = r.bits(8)? as u8;
+        let level_idc = r.bits(8)? as u8;
+        let id = r.ue()?;
+        if id > 31 {
+            return None;
+        }
+
+        let mut chroma_format_idc = 1;
+        let mut separate_colour_plane = false;
+        let mut bit_depth_luma = 8;
+        if matches!(profile_idc, 100 | 110 | 122 | 244 | 44 | 83 | 86 | 118 | 128 | 138 | 139 | 134 | 135) {
+            chroma_format_idc = r.ue()?;
+            if chroma_format_idc > 3 {
+                return None;
+            }
+            if chroma_format_idc == 3 {
+                separate_colour_plane = r.flag()?;
+            }
+            bit_depth_luma = r.ue()? + 8;
+            let _bit_depth_chroma = r.ue()?;
+            let _qpprime_y_zero_transform_bypass = r.flag()?;
+            if r.flag()? {
+                let lists = if chroma_format_idc == 3 { 12 } else { 8 };
+                for i in 0..lists {
+                    if r.flag()? {
+                        skip_scaling_list(&mut r, if i < 6 { 16 } else { 64 })?;
+                    }
+                }
+            }
+        }
+
+        let log2_max_frame_num = r.ue()? + 4;
+        match r.ue()? {
+            0 => {
+                let _log2_max_pic_order_cnt_lsb = r.ue()?;
+            }
+            1 => {
+                let _delta_pic_order_always_zero = r.flag()?;
+                let _offset_for_non_ref_pic = r.se()?;
+                let _offset_for_top_to_bottom_field = r.se()?;
+                let cycle = r.ue()?;
+                if cycle > 255 {
+                    return None;
+                }
+                for _ in 0..cycle {
+                    r.se()?;
+                }
+            }
+            2 => {}
+            _ => return None,
+        }
+        let _max_num_ref_frames = r.ue()?;
+        let _gaps_in_frame_num_allowed = r.flag()?;
+        let width_mbs = r.ue()? + 1;
+        let height_map_units = r.ue()? + 1;
+        let frame_mbs_only = r.flag()?;
+        if !frame_mbs_only {
+            let _mb_adaptive_frame_field = r.flag()?;
+        }
+        let _direct_8x8_inference = r.flag()?;
+
+        let field_factor = if frame_mbs_only { 1 } else { 2 };
+        let mut width = width_mbs * 16;
+        let mut height = height_map_units * 16 * field_factor;
+        if r.flag()? {
+            let (left, right, top, bottom) = (r.ue()?, r.ue()?, r.ue()?, r.ue()?);
+            // Crop units from the chroma subsampling (Table 6-1)
+            let chroma_array_type = if separate_colour_plane { 0 } else { chroma_format_idc };
+            let (crop_x, crop_y) = match chroma_array_type {
+                0 => (1, field_factor),
+                1 => (2, 2 * field_factor),
+                2 => (2, field_factor),
+                _ => (1, field_factor),
+            };
+            width = width.checked_sub(crop_x * (left + right))?;
+            height = height.checked_sub(crop_y * (top + bottom))?;
+        }
+
+        Some(Sps {
+            profile_idc,
+            constraint_flags,
+            level_idc,
+            id,
+            chroma_format_idc,
+            separate_colour_plane,
+            bit_depth_luma,
+            log2_max_frame_num,
+            frame_mbs_only,
+            width,
+            height,
+        })
+    }
+}
+
+fn skip_scaling_list(r: &mut BitReader, size: usize) -> Option<()> {
+    let mut last = 8i32;
+    let mut next = 8i32;
+    for _ in 0..size {
+        if next != 0 {
+            next = (last + r.se()? + 256) % 256;
+        }
+        if next != 0 {
+            last = next;
+        }
+    }
+    Some(())
+}
+
+/// Picture parameter set fields used for detection
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Pps {
+    pub id: u32,
+    pub sps_id: u32,
+    pub entropy_coding_mode: bool,
+}
+
+impl Pps {
+    /// Parse a PPS NAL unit (header byte included, still escaped)
+    pub fn parse(nal: &[u8]) -> Option<Pps> {
+        if nal.first()? & 0x1f != NAL_PPS {
+            return None;
+        }
+        let rbsp = rbsp_prefix(&nal[1..], 16);
+        let mut r = BitReader::new(&rbsp);
+        let id = r.ue()?;
+        let sps_id = r.ue()?;
+        if id > 255 || sps_id > 31 {
+            return None;
+        }
+        Some(Pps { id, sps_id, entropy_coding_mode: r.flag()? })
+    }
+}
+
+/// slice_type with the "all slices alike" offset of 5 removed
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SliceType {
+    P = 0,
+    B = 1,
+    I = 2,
+    Sp = 3,
+    Si = 4,
+}
+
+/// Leading fields of a slice header
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct SliceHeader {
+    pub nal_type: u8,
+    pub first_mb: u32,
+    pub slice_type: SliceType,
+    pub pps_id: u32,
+    /// Present when the SPS is known
+    pub frame_num: Option<u32>,
+}
+
+impl SliceHeader {
+    /// Parse a coded slice NAL unit; `sps` (the one its PPS refers to) is
+    /// needed for frame_num
+    pub fn parse(nal: &[u8], sps: Option<&Sps>) -> Option<SliceHeader> {
+        let nal_type = nal.first()? & 0x1f;
+        if !(NAL_SLICE..=NAL_IDR).contains(&nal_type) {
+            return None;
+        }
+        let rbsp = rbsp_prefix(&nal[1..], SLICE_HEADER_PREFIX);
+        let mut r = BitReader::new(&rbsp);
+        let first_mb = r.ue()?;
+        let slice_type = match r.ue()? % 5 {
+            0 => SliceType::P,
+            1 => SliceType::B,
+            2 => SliceType::I,
+            3 => SliceType::Sp,
+            _ => SliceType::Si,
+        };
+        let pps_id = r.ue()?;
+        let frame_num = match sps {
+            Some(sps) => {
+                if sps.separate_colour_plane {
+                    r.bits(2)?;
+                }
+                Some(r.bits(sps.log2_max_frame_num)?)
+            }
+            None => None,
+        };
+        Some(SliceHeader { nal_type, first_mb, slice_type, pps_id, frame_num })
+    }
+}
+
+/// What an access unit contains
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct AccessUnitInfo {
+    pub nal_count: u32,
+    /// Bit n set when a NAL unit of type n is present
+    pub nal_types: u32,
+    /// An IDR slice: decoding can start here
+    pub keyframe: bool,
+    /// The first slice's header
+    pub slice: Option<SliceHeader>,
+    /// The last SPS in the access unit
+    pub sps: Option<Sps>,
+    pub pps: Option<Pps>,
+}
+
+/// Inspect an Annex-B access unit
+pub fn inspect_access_unit(data: &[u8]) -> AccessUnitInfo {
+    let mut info = AccessUnitInfo::default();
+    for range in nal_units(data) {
+        let nal = &data[range];
+        let nal_type = nal[0] & 0x1f;
+        info.nal_count += 1;
+        info.nal_types |= 1 << nal_type;
+        match nal_type {
+            NAL_SPS => info.sps = Sps::parse(nal).or(info.sps.take()),
+            NAL_PPS => info.pps = Pps::parse(nal).or(info.pps.take()),
+            NAL_SLICE | NAL_IDR => {
+                info.keyframe |= nal_type == NAL_IDR;
+                if info.slice.is_none() {
+                    let sps = info.sps.as_ref().filter(|sps| {
+                        info.pps.as_ref().map_or(true, |pps| pps.sps_id == sps.id)
+                    });
+                    info.slice = SliceHeader::parse(nal, sps);
+                }
+            }
+            _ => {}
+        }
+    }
+    info
+}
+
+// ============================================================================
+// FFI
+// ============================================================================
+
+/// Find the start codes of an Annex-B buffer
+///
+/// # Arguments
+/// * `data` - Annex-B bytes
+/// * `len` - Length of `data`
+/// * `out_offsets` - Receives the offset of each start code
+/// * `out_lengths` - Receives each start code's length (3 or 4)
+/// * `capacity` - Entries available in both outputs
+///
+/// # Returns
+/// Number of start codes found (entries past `capacity` are not written),
+/// or -1 on error
+#[no_mangle]
+pub extern "C" fn h264_find_start_codes(
+    data: *const u8,
+    len: usize,
+    out_offsets: *mut u32,
+    out_lengths: *mut u8,
+    capacity: usize,
+) -> c_int {
+    if data.is_null() || (capacity > 0 && (out_offsets.is_null() || out_lengths.is_null())) {
+        return -1;
+    }
+    let data = unsafe { std::slice::from_raw_parts(data, len) };
+    let mut count = 0usize;
+    for (offset, code_len) in start_codes(data) {
+        if count < capacity {
+            unsafe {
+                *out_offsets.add(count) = offset as u32;
+                *out_lengths.add(count) = code_len as u8;
+            }
+        }
+        count += 1;
+    }
+    count as c_int
+}
+
+/// Convert an Annex-B access unit to 4-byte length prefixes in place
+///
+/// # Arguments
+/// * `buf` - Buffer holding the access unit
+/// * `len` - Length of the access unit
+/// * `capacity` - Size of `buf`; 3-byte start codes need one extra byte each
+/// * `out_len` - Receives the converted length, or the capacity required
+///
+/// # Returns
+/// 0 on success, -1 on error, -2 if `capacity` is too small (`buf` untouched)
+#[no_mangle]
+pub extern "C" fn h264_annexb_to_avcc(buf: *mut u8, len: usize, capacity: usize, out_len: *mut usize) -> c_int {
+    if buf.is_null() || out_len.is_null() || len > capacity {
+        return -1;
+    }
+    let buf = unsafe { std::slice::from_raw_parts_mut(buf, capacity) };
+    let (status, value) = match annex_b_to_avcc_in_place(buf, len) {
+        Ok(converted) => (0, converted),
+        Err(required) => (-2, required),
+    };
+    unsafe { *out_len = value };
+    status
+}
+
+/// Convert 4-byte length prefixes to start codes in place
+///
+/// # Returns
+/// 0 on success, -1 on error, -2 if a length runs past the buffer
+#[no_mangle]
+pub extern "C" fn h264_avcc_to_annexb(buf: *mut u8, len: usize) -> c_int {
+    if buf.is_null() {
+        return -1;
+    }
+    let buf = unsafe { std::slice::from_raw_parts_mut(buf, len) };
+    if avcc_to_annex_b_in_place(buf) { 0 } else { -2 }
+}
+
+/// Remove emulation-prevention bytes in place
+///
+/// # Returns
+/// The unescaped length, or -1 on error
+#[no_mangle]
+pub extern "C" fn h264_remove_emulation_prevention(buf: *mut u8, len: usize) -> isize {
+    if buf.is_null() {
+        return -1;
+    }
+    let buf = unsafe { std::slice::from_raw_parts_mut(buf, len) };
+    remove_emulation_prevention(buf) as isize
+}
+
+/// Inspect an Annex-B access unit
+///
+/// Writes up to `len` values: keyframe (0/1), width, height (0 without an
+/// SPS), profile_idc, level_idc, NAL unit count, NAL type bitmask, first
+/// slice type (-1 without a slice), frame_num (-1 if unknown).
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn h264_inspect(data: *const u8, data_len: usize, out: *mut i32, len: usize) -> c_int {
+    if data.is_null() || out.is_null() {
+        return -1;
+    }
+    let data = unsafe { std::slice::from_raw_parts(data, data_len) };
+    let info = inspect_access_unit(data);
+    let sps = info.sps.as_ref();
+    let values = [
+        info.keyframe as i32,
+        sps.map_or(0, |s| s.width as i32),
+        sps.map_or(0, |s| s.height as i32),
+        sps.map_or(0, |s| s.profile_idc as i32),
+        sps.map_or(0, |s| s.level_idc as i32),
+        info.nal_count as i32,
+        info.nal_types as i32,
+        info.slice.map_or(-1, |s| s.slice_type as i32),
+        info.slice.and_then(|s| s.frame_num).map_or(-1, |n| n as i32),
+    ];
+    let count = len.min(values.len());
+    let out = unsafe { std::slice::from_raw_parts_mut(out, count) };
+    out.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    // Deterministic noise
+    struct Rng(u32);
+
+    impl Rng {
+        fn next(&mut self) -> u32 {
+            self.0 ^= self.0 << 13;
+            self.0 ^= self.0 >> 17;
+            self.0 ^= self.0 << 5;
+            self.0
+        }
+    }
+
+    // Writes the syntax elements tests build parameter sets from
+    struct BitWriter {
+        bytes: Vec<u8>,
+        bits: usize,
+    }
+
+    impl BitWriter {
+        fn new() -> Self {
+            Self { bytes: Vec::new(), bits: 0 }
+        }
+
+        fn put(&mut self, value: u32, count: u32) -> &mut Self {
+            for i in (0..count).rev() {
+                if self.bits % 8 == 0 {
+                    self.bytes.push(0);
+                }
+                let bit = ((value >> i) & 1) as u8;
+                *self.bytes.last_mut().unwrap() |= bit << (7 - self.bits % 8);
+                self.bits += 1;
+            }
+            self
+        }
+
+        fn ue(&mut self, value: u32) -> &mut Self {
+            let code = value as u64 + 1;
+            let len = 64 - code.leading_zeros();
+            self.put(0, len - 1).put(code as u32, len)
+        }
+
+        fn se(&mut self, value: i32) -> &mut Self {
+            self.ue(if value > 0 { 2 * value as u32 - 1 } else { (-2 * value) as u32 })
+        }
+
+        // rbsp_trailing_bits, then emulation prevention
+        fn finish(&mut self, header: u8) -> Vec<u8> {
+            self.put(1, 1);
+            let mut out = vec![header];
+            let mut zeros = 0;
+            for &b in &self.bytes {
+                if zeros == 2 && b <= 3 {
+                    out.push(3);
+                    zeros = 0;
+                }
+                out.push(b);
+                zeros = if b == 0 { zeros + 1 } else { 0 };
+            }
+            out
+        }
+    }
+
+    // High profile 1920x1080 (coded as 1088 and cropped), with a scaling
+    // matrix and POC type 1 to walk the less common branches
+    fn sps_1080p() -> Vec<u8> {
+        let mut w = BitWriter::new();
+        w.put(100, 8).put(0, 8).put(40, 8).ue(0);
+        w.ue(1).ue(0).ue(0).put(0, 1);
+        w.put(1, 1); // seq_scaling_matrix_present
+        w.put(1, 1); // list 0 present: delta 0 then stop
+        for d in [0, -8] {
+            w.se(d);
+        }
+        for _ in 1..8 {
+            w.put(0, 1);
+        }
+        w.ue(4); // log2_max_frame_num 8
+        w.ue(1).put(0, 1).se(-1).se(2).ue(2).se(1).se(-3);
+        w.ue(4).put(0, 1).ue(119).ue(67).put(1, 1).put(1, 1);
+        w.put(1, 1).ue(0).ue(0).ue(0).ue(4);
+        w.put(0, 1); // no VUI
+        w.finish(0x67)
+    }
+
+    fn pps() -> Vec<u8> {
+        let mut w = BitWriter::new();
+        w.ue(0).ue(0).put(1, 1).put(0, 1).ue(0);
+        w.finish(0x68)
+    }
+
+    fn slice(nal_type: u8, slice_type: u32, frame_num: u32, payload: &[u8]) -> Vec<u8> {
+        let mut w = BitWriter::new();
+        w.ue(0).ue(slice_type).ue(0).put(frame_num, 8);
+        let mut nal = w.finish(0x60 | nal_type);
+        nal.extend_from_slice(payload);
+        nal
+    }
+
+    // Random bytes escaped as an encoder would, ending in a non-zero byte
+    fn escaped_payload(rng: &mut Rng, len: usize, zero_bias: bool) -> Vec<u8> {
+        let mut out = Vec::with_capacity(len + len / 64);
+        let mut zeros = 0;
+        while out.len() < len {
+            let mut b = rng.next() as u8;
+            if zero_bias && rng.next() % 4 == 0 {
+                b = 0;
+            }
+            if zeros == 2 && b <= 3 {
+                out.push(3);
+                zeros = 0;
+            }
+            out.push(b);
+            zeros = if b == 0 { zeros + 1 } else { 0 };
+        }
+        while out.last() == Some(&0) {
+            out.pop();
+        }
+        out.push(0x80);
+        out
+    }
+
+    fn join(nals: &[Vec<u8>], long_codes: &[bool]) -> Vec<u8> {
+        let mut out = Vec::new();
+        for (nal, &long) in nals.iter().zip(long_codes.iter().cycle()) {
+            out.extend_from_slice(if long { &[0, 0, 0, 1][..] } else { &[0, 0, 1][..] });
+            out.extend_from_slice(nal);
+        }
+        out
+    }
+
+    #[test]
+    fn simd_scan_matches_scalar() {
+        let mut rng = Rng(3);
+        for len in [0usize, 1, 2, 3, 17, 18, 33, 34, 35, 100, 4097] {
+            for third in [1u8, 3] {
+                // Sparse zeros so patterns land at every alignment
+                let data: Vec<u8> = (0..len)
+                    .map(|_| match rng.next() % 8 {
+                        0..=3 => 0,
+                        4 => third,
+                        _ => rng.next() as u8,
+                    })
+                    .collect();
+                for from in [0, 1, 5, 31] {
+                    let mut expected = Vec::new();
+                    let mut at = from;
+                    while let Some(p) = find_pattern_scalar(&data, at, third) {
+                        expected.push(p);
+                        at = p + 1;
+                    }
+                    let mut found = Vec::new();
+                    let mut at = from;
+                    while let Some(p) = find_pattern(&data, at, third) {
+                        found.push(p);
+                        at = p + 1;
+                    }
+                    let naive: Vec<usize> = (from..len.saturating_sub(2))
+                        .filter(|&i| data[i] == 0 && data[i + 1] == 0 && data[i + 2] == third)
+                        .collect();
+                    assert_eq!(expected, naive, "scalar, len {len} from {from}");
+                    assert_eq!(found, naive, "simd, len {len} from {from}");
+                    #[cfg(target_arch = "x86_64")]
+                    {
+                        // The SSE2 path only handles tails when AVX2 is present
+                        let first = unsafe { find_pattern_sse2(&data, from.min(len), third) };
+                        assert_eq!(first, naive.first().copied(), "sse2, len {len} from {from}");
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn splits_nal_units() {
+        let nals = vec![vec![0x67, 1, 2], vec![0x68, 3], vec![0x65, 0, 0, 3, 1, 9]];
+        let mut data = vec![0xff];
+        data.extend(join(&nals, &[true, false]));
+        // trailing_zero_8bits before the last start code and at the end
+        data.splice(data.len() - 9..data.len() - 9, [0, 0]);
+        data.extend([0, 0]);
+
+        let found: Vec<&[u8]> = nal_units(&data).map(|r| &data[r]).collect();
+        assert_eq!(found, nals.iter().map(|n| &n[..]).collect::<Vec<_>>());
+
+        let codes: Vec<(usize, usize)> = start_codes(&join(&nals, &[true, false])).collect();
+        assert_eq!(codes, vec![(0, 4), (7, 3), (12, 4)]);
+    }
+
+    #[test]
+    fn converts_in_place_both_ways() {
+        let mut rng = Rng(11);
+        let nals: Vec<Vec<u8>> = (0..6).map(|i| escaped_payload(&mut rng, 10 + i * 37, true)).collect();
+
+        for codes in [&[true][..], &[false], &[true, false, false], &[false, true]] {
+            let annex_b = join(&nals, codes);
+            let expected: Vec<u8> = nals
+                .iter()
+                .flat_map(|n| (n.len() as u32).to_be_bytes().into_iter().chain(n.iter().copied()))
+                .collect();
+
+            let mut buf = annex_b.clone();
+            let short_codes = nals.len() - codes.iter().cycle().take(nals.len()).filter(|&&l| l).count();
+            if short_codes > 0 {
+                assert_eq!(annex_b_to_avcc_in_place(&mut buf, annex_b.len()), Err(expected.len()));
+                assert_eq!(buf, annex_b);
+            }
+            buf.resize(expected.len().max(annex_b.len()), 0xee);
+            assert_eq!(annex_b_to_avcc_in_place(&mut buf, annex_b.len()), Ok(expected.len()));
+            assert_eq!(&buf[..expected.len()], &expected[..], "codes {codes:?}");
+
+            let mut vec = annex_b.clone();
+            annex_b_to_avcc(&mut vec);
+            assert_eq!(vec, expected);
+
+            assert!(avcc_to_annex_b_in_place(&mut vec));
+            assert_eq!(vec, join(&nals, &[true]));
+        }
+
+        let mut truncated = vec![0, 0, 0, 9, 1, 2];
+        assert!(!avcc_to_annex_b_in_place(&mut truncated));
+    }
+
+    #[test]
+    fn removes_emulation_prevention() {
+        let cases: [(&[u8], &[u8]); 5] = [
+            (&[1, 2, 3], &[1, 2, 3]),
+            (&[0, 0, 3, 1], &[0, 0, 1]),
+            (&[0, 0, 3, 0, 0, 3, 0], &[0, 0, 0, 0, 0]),
+            (&[5, 0, 0, 3], &[5, 0, 0]),
+            (&[0, 0, 3, 3, 0, 0, 3, 2, 7], &[0, 0, 3, 0, 0, 2, 7]),
+        ];
+        for (escaped, raw) in cases {
+            let mut buf = escaped.to_vec();
+            let len = remove_emulation_prevention(&mut buf);
+            assert_eq!(&buf[..len], raw, "{escaped:?}");
+        }
+
+        let mut rng = Rng(5);
+        let mut w = BitWriter::new();
+        let raw: Vec<u8> = (0..5000).map(|_| if rng.next() % 3 == 0 { 0 } else { rng.next() as u8 }).collect();
+        for &b in &raw {
+            w.put(b as u32, 8);
+        }
+        let mut escaped = w.finish(0x01);
+        let len = remove_emulation_prevention(&mut escaped);
+        assert_eq!(&escaped[1..len - 1], &raw[..]);
+    }
+
+    #[test]
+    fn parses_parameter_sets_and_slices() {
+        let sps = Sps::parse(&sps_1080p()).unwrap();
+        assert_eq!((sps.profile_idc, sps.level_idc, sps.id), (100, 40, 0));
+        assert_eq!((sps.width, sps.height), (1920, 1080));
+        assert_eq!(sps.log2_max_frame_num, 8);
+        assert!(sps.frame_mbs_only);
+
+        let parsed = Pps::parse(&pps()).unwrap();
+        assert_eq!(parsed, Pps { id: 0, sps_id: 0, entropy_coding_mode: true });
+
+        let mut rng = Rng(9);
+        let body = escaped_payload(&mut rng, 500, true);
+        let idr = join(&[sps_1080p(), pps(), slice(NAL_IDR, 7, 0, &body)], &[true]);
+        let info = inspect_access_unit(&idr);
+        assert!(info.keyframe);
+        assert_eq!(info.nal_count, 3);
+        assert_eq!(info.nal_types, 1 << 7 | 1 << 8 | 1 << 5);
+        assert_eq!(info.sps.as_ref().map(|s| (s.width, s.height)), Some((1920, 1080)));
+        let header = info.slice.unwrap();
+        assert_eq!((header.slice_type, header.frame_num), (SliceType::I, Some(0)));
+
+        let p = join(&[slice(NAL_SLICE, 5, 3, &body)], &[false]);
+        let info = inspect_access_unit(&p);
+        assert!(!info.keyframe && info.sps.is_none());
+        assert_eq!(info.slice.map(|s| (s.slice_type, s.frame_num)), Some((SliceType::P, None)));
+
+        let mut out = [0i32; 9];
+        assert_eq!(h264_inspect(idr.as_ptr(), idr.len(), out.as_mut_ptr(), out.len()), 9);
+        assert_eq!(out, [1, 1920, 1080, 100, 40, 3, 0x1a0, 2, 0]);
+    }
+
+    #[test]
+    fn rejects_malformed_parameter_sets() {
+        let sps = sps_1080p();
+        for len in 1..12 {
+            assert!(Sps::parse(&sps[..len]).is_none(), "len {len}");
+        }
+        assert!(Sps::parse(&pps()).is_none());
+        assert!(Pps::parse(&[0x68]).is_none());
+        assert!(SliceHeader::parse(&[0x67, 0x80], None).is_none());
+        assert_eq!(inspect_access_unit(&[1, 2, 3]), AccessUnitInfo::default());
+    }
+
+    // A 20 Mbps, 30 fps stream: ten seconds of ~83 KB access units, each an
+    // SPS/PPS (keyframes only) and four slices with 3-byte start codes
+    fn stream_20mbps() -> Vec<Vec<u8>> {
+        let mut rng = Rng(1);
+        let frame_bytes = 20_000_000 / 8 / 30;
+        (0..300)
+            .map(|frame| {
+                let mut nals = Vec::new();
+                let nal_type = if frame % 60 == 0 { NAL_IDR } else { NAL_SLICE };
+                if nal_type == NAL_IDR {
+                    nals.push(sps_1080p());
+                    nals.push(pps());
+                }
+                for _ in 0..4 {
+                    let body = escaped_payload(&mut rng, frame_bytes / 4, false);
+                    nals.push(slice(nal_type, 0, frame as u32 % 256, &body));
+                }
+                join(&nals, &[true, false, false, false])
+            })
+            .collect()
+    }
+
+    #[test]
+    #[ignore]
+    fn bench_20mbps_stream() {
+        let units = stream_20mbps();
+        let total: usize = units.iter().map(|u| u.len()).sum();
+        let mb = total as f64 / 1e6;
+        let rate = |label: &str, started: Instant, rounds: usize| {
+            let secs = started.elapsed().as_secs_f64();
+            println!(
+                "{label}: {:.0} MB/s ({:.0}x real time)",
+                mb * rounds as f64 / secs,
+                10.0 * rounds as f64 / secs
+            );
+        };
+        const ROUNDS: usize = 20;
+
+        // The byte-at-a-time loop the Dart parsers use
+        let started = Instant::now();
+        let mut codes = 0;
+        for _ in 0..ROUNDS {
+            for unit in &units {
+                let mut i = 0;
+                while i + 2 < unit.len() {
+                    if unit[i] == 0 && unit[i + 1] == 0 && unit[i + 2] == 1 {
+                        codes += 1;
+                        i += 3;
+                    } else {
+                        i += 1;
+                    }
+                }
+            }
+        }
+        rate("naive start-code scan", started, ROUNDS);
+
+        let started = Instant::now();
+        let mut simd_codes = 0;
+        for _ in 0..ROUNDS {
+            for unit in &units {
+                simd_codes += start_codes(unit).count();
+            }
+        }
+        rate("simd start-code scan", started, ROUNDS);
+        assert_eq!(codes, simd_codes);
+
+        let mut buffers = units.clone();
+        let started = Instant::now();
+        for (buf, unit) in buffers.iter_mut().zip(&units) {
+            let len = unit.len();
+            buf.resize(len + 8, 0);
+            annex_b_to_avcc_in_place(buf, len).unwrap();
+        }
+        rate("annex-b to avcc in place", started, 1);
+
+        let started = Instant::now();
+        let mut keyframes = 0;
+        for _ in 0..ROUNDS {
+            for unit in &units {
+                keyframes += inspect_access_unit(unit).keyframe as usize;
+            }
+        }
+        rate("access unit inspection", started, ROUNDS);
+        assert_eq!(keyframes, 5 * ROUNDS);
+
+        let mut escaped = units.clone();
+        let started = Instant::now();
+        for buf in &mut escaped {
+            remove_emulation_prevention(buf);
+        }
+        rate("emulation-prevention removal", started, 1);
+    }
+}
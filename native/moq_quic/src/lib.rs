@@ -8,9 +8,38 @@
 // - Background tasks for stream handling
 
 mod stream_writer;
+mod stream_reassembly;
+mod liveness;
+mod bandwidth;
+mod fmp4;
+pub mod playback_sink;
+pub mod replay_cache;
+pub mod redundant;
+pub mod publish_pipeline;
+pub mod object_crypto;
+pub mod vad;
+pub mod h264;
 pub mod webtransport;
 #[cfg(feature = "media-player")]
 pub mod media_player;
+#[cfg(feature = "audio-mixer")]
+pub mod audio_mixer;
+#[cfg(feature = "grid-decoder")]
+pub mod grid_decoder;
+#[cfg(feature = "mjpeg")]
+pub mod mjpeg_decoder;
+#[cfg(feature = "thumbnail")]
+pub mod thumbnail;
+#[cfg(feature = "mp4-source")]
+pub mod mp4_source;
+#[cfg(feature = "track-archive")]
+pub mod track_archive;
+#[cfg(all(target_os = "linux", feature = "screen-capture"))]
+pub mod screen_capture;
+#[cfg(all(target_os = "linux", feature = "device-monitor"))]
+pub mod device_monitor;
+#[cfg(all(target_os = "linux", feature = "io-uring"))]
+mod uring_socket;
 
 use quinn::{Endpoint, ClientConfig, Connection, SendStream, VarInt, TokioRuntime, EndpointConfig, TransportConfig};
 use quinn::crypto::rustls::QuicClientConfig;
@@ -20,8 +49,9 @@ use dashmap::DashMap;
 use once_cell::sync::OnceCell;
 use std::sync::Arc;
 use std::sync::atomic::{AtomicU64, Ordering};
-use std::time;
+use std::time::Instant;
 use std::collections::VecDeque;
+use std::borrow::Cow;
 use std::sync::Mutex;
 use tokio::runtime::Runtime;
 use std::slice;
@@ -117,6 +147,8 @@ impl ReceiveBuffer {
 // Control stream storage - only send stream needed (recv is handled by background task)
 struct ControlStream {
     send: SendStream,
+    // Bytes written before 0-RTT was confirmed, kept for replay if the server rejects it
+    early_data: Option<Vec<u8>>,
 }
 
 // Global Tokio runtime for async operations
@@ -147,6 +179,18 @@ static ACTIVE_DATA_STREAMS: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<Vec<u64
 // Global registry of datagram receive buffers (connection_id -> buffer of complete datagrams)
 static DATAGRAM_BUFFERS: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<VecDeque<Vec<u8>>>>>> = OnceCell::new();
 
+// Per-connection liveness trackers for fast loss detection
+static LIVENESS: OnceCell<DashMap<u64, liveness::LivenessTracker>> = OnceCell::new();
+
+// Per-track bandwidth estimates, fed by the data stream readers
+static BANDWIDTH: OnceCell<bandwidth::BandwidthRegistry> = OnceCell::new();
+
+// Track aliases whose subgroup streams go to a native playback sink instead of Dart
+static ROUTES: OnceCell<playback_sink::RouteTable> = OnceCell::new();
+
+// Client configs keyed by (insecure, ALPN); shared so TLS session tickets enable 0-RTT
+static CLIENT_CONFIGS: OnceCell<DashMap<(bool, Vec<u8>), ClientConfig>> = OnceCell::new();
+
 // Next connection ID counter
 static NEXT_CONNECTION_ID: AtomicU64 = AtomicU64::new(1);
 
@@ -165,11 +209,35 @@ fn set_last_error(msg: &str) {
     }
 }
 
+/// Quinn runtime for new endpoints
+///
+/// Uses io_uring for UDP I/O when built with the `io-uring` feature on Linux,
+/// and plain Tokio sockets otherwise.
+pub(crate) fn quic_runtime() -> Arc<dyn quinn::Runtime> {
+    #[cfg(all(target_os = "linux", feature = "io-uring"))]
+    return Arc::new(uring_socket::UringRuntime);
+    #[cfg(not(all(target_os = "linux", feature = "io-uring")))]
+    Arc::new(TokioRuntime)
+}
+
 /// Get the global Tokio runtime
 fn get_runtime() -> &'static Runtime {
     RUNTIME.get().expect("Runtime not initialized - call moq_quic_init first")
 }
 
+/// Create the receive buffer Dart polls for an incoming data stream
+async fn register_data_stream(connection_id: u64, stream_id: u64) -> Arc<tokio::sync::Mutex<ReceiveBuffer>> {
+    let data_stream_buffers = DATA_STREAM_BUFFERS.get().expect("Data stream buffers not initialized");
+    let active_streams = ACTIVE_DATA_STREAMS.get().expect("Active data streams not initialized");
+
+    let stream_buffer = Arc::new(tokio::sync::Mutex::new(ReceiveBuffer::new(MAX_RECV_BUFFER_SIZE)));
+    data_stream_buffers.insert((connection_id, stream_id), stream_buffer.clone());
+    if let Some(streams_list) = active_streams.get(&connection_id).map(|list| list.clone()) {
+        streams_list.lock().await.push(stream_id);
+    }
+    stream_buffer
+}
+
 /// Initialize the QUIC transport module
 ///
 /// IMPORTANT: Call this once before any other functions
@@ -230,6 +298,26 @@ pub extern "C" fn moq_quic_init() {
         log::warn!("Datagram buffers registry already initialized");
     }
 
+    // Initialize liveness trackers registry
+    if LIVENESS.set(DashMap::new()).is_err() {
+        log::warn!("Liveness registry already initialized");
+    }
+
+    // Initialize bandwidth estimator registry
+    if BANDWIDTH.set(bandwidth::BandwidthRegistry::new()).is_err() {
+        log::warn!("Bandwidth registry already initialized");
+    }
+
+    // Initialize native playback routes
+    if ROUTES.set(playback_sink::RouteTable::new()).is_err() {
+        log::warn!("Route table already initialized");
+    }
+
+    // Initialize client config cache
+    if CLIENT_CONFIGS.set(DashMap::new()).is_err() {
+        log::warn!("Client config cache already initialized");
+    }
+
     // Initialize last error buffer
     if LAST_ERROR.set(Mutex::new(Vec::new())).is_err() {
         log::warn!("Last error buffer already initialized");
@@ -238,16 +326,64 @@ pub extern "C" fn moq_quic_init() {
     log::info!("MoQ QUIC transport initialized");
 }
 
+// Build a client config for one (insecure, ALPN) combination
+fn new_client_config(insecure: bool, alpn: Vec<u8>) -> Result<ClientConfig, i32> {
+    let client_crypto = if insecure {
+        // Disable certificate verification for testing
+        let builder = rustls::ClientConfig::builder()
+            .dangerous()
+            .with_custom_certificate_verifier(Arc::new(NoVerification));
+        builder.with_no_client_auth()
+    } else {
+        // Load system root certificates for TLS validation
+        let mut certs = rustls::RootCertStore::empty();
+        let native_certs_result = rustls_native_certs::load_native_certs();
+        if let Some(ref e) = native_certs_result.errors.first() {
+            log::warn!("Error loading some native certs: {:?}", e);
+        }
+        for cert in native_certs_result.certs {
+            if let Err(e) = certs.add(cert) {
+                log::warn!("Failed to add native cert: {:?}", e);
+            }
+        }
+        log::info!("Loaded {} system root certificates", certs.len());
+
+        rustls::ClientConfig::builder()
+            .with_root_certificates(certs)
+            .with_no_client_auth()
+    };
+
+    let mut client_crypto = client_crypto;
+    client_crypto.alpn_protocols = vec![alpn];
+    // Allow 0-RTT on resumed sessions; CLIENT_SETUP is replayed if the server rejects it
+    client_crypto.enable_early_data = true;
+
+    let crypto = match QuicClientConfig::try_from(client_crypto) {
+        Ok(c) => c,
+        Err(e) => {
+            let err_msg = format!("QuicClientConfig error: {:?}", e);
+            log::error!("{}", err_msg);
+            set_last_error(&err_msg);
+            return Err(-6);
+        }
+    };
+    Ok(ClientConfig::new(Arc::new(crypto)))
+}
+
 /// Create a new QUIC connection with bidirectional control stream
 ///
 /// # Arguments
 /// * `host` - The hostname to connect to (must be null-terminated)
 /// * `port` - The port to connect to
 /// * `insecure` - If non-zero, skip certificate verification (for testing only)
+/// * `idle_timeout_ms` - QUIC idle timeout of this connection in milliseconds
+/// * `keep_alive_ms` - Keep-alive PING interval in milliseconds (must be below the idle timeout)
+/// * `loss_pto_count` - PTOs without inbound packets (on top of one keep-alive interval)
+///   before the connection is reported stalled; 0 disables stall detection
 /// * `out_connection_id` - Output parameter for the connection ID
 ///
 /// # Returns
-/// * 0 on success, negative error code on failure
+/// * 0 on success, negative error code on failure (-8 for invalid liveness values)
 #[no_mangle]
 pub extern "C" fn moq_quic_connect(
     host: *const c_char,
@@ -255,6 +391,9 @@ pub extern "C" fn moq_quic_connect(
     insecure: u8,
     moq_version: u32,
     alpn: *const c_char,
+    idle_timeout_ms: u32,
+    keep_alive_ms: u32,
+    loss_pto_count: u32,
     out_connection_id: *mut u64,
 ) -> i32 {
     let host_str = unsafe {
@@ -278,6 +417,14 @@ pub extern "C" fn moq_quic_connect(
         }
     };
 
+    let liveness_config = match liveness::LivenessConfig::from_millis(idle_timeout_ms, keep_alive_ms, loss_pto_count) {
+        Some(config) => config,
+        None => {
+            set_last_error("Invalid liveness config: keep-alive must be non-zero and below the idle timeout");
+            return -8;
+        }
+    };
+
     let runtime = get_runtime();
 
     // Perform all connection setup within the runtime
@@ -303,45 +450,7 @@ pub extern "C" fn moq_quic_connect(
             }
         };
 
-        // Create client configuration with proper transport settings
-        // Load system root certificates for TLS validation
-        let mut certs = rustls::RootCertStore::empty();
-        let native_certs_result = rustls_native_certs::load_native_certs();
-        if let Some(ref e) = native_certs_result.errors.first() {
-            log::warn!("Error loading some native certs: {:?}", e);
-        }
-        for cert in native_certs_result.certs {
-            if let Err(e) = certs.add(cert) {
-                log::warn!("Failed to add native cert: {:?}", e);
-            }
-        }
-        log::info!("Loaded {} system root certificates", certs.len());
-
-        // Build transport config with standard settings (from moq-native-ietf)
-        let mut transport = TransportConfig::default();
-        transport.max_idle_timeout(Some(time::Duration::from_secs(10).try_into().unwrap()));
-        transport.keep_alive_interval(Some(time::Duration::from_secs(4)));
-        transport.max_concurrent_bidi_streams(100u32.into());
-        transport.max_concurrent_uni_streams(100u32.into());
-        // Enable datagrams with max size (for low-latency audio)
-        transport.datagram_receive_buffer_size(Some(65536));
-        transport.datagram_send_buffer_size(65536);
-
-        // Create client configuration with ALPN protocols
-        let client_crypto = if insecure != 0 {
-            // Disable certificate verification for testing
-            let builder = rustls::ClientConfig::builder()
-                .dangerous()
-                .with_custom_certificate_verifier(Arc::new(NoVerification));
-            builder.with_no_client_auth()
-        } else {
-            rustls::ClientConfig::builder()
-                .with_root_certificates(certs)
-                .with_no_client_auth()
-        };
-
         // Set ALPN based on the requested MoQ draft version.
-        let mut client_crypto = client_crypto;
         let alpn = if let Some(alpn_override) = &alpn_override {
             alpn_override.as_bytes().to_vec()
         } else if moq_version >= 0xff00_0010 {
@@ -350,18 +459,30 @@ pub extern "C" fn moq_quic_connect(
             b"moq-00".to_vec()
         };
         log::info!("Using ALPN {:?}", String::from_utf8_lossy(&alpn));
-        client_crypto.alpn_protocols = vec![alpn];
 
-        let crypto = match QuicClientConfig::try_from(client_crypto) {
-            Ok(c) => c,
-            Err(e) => {
-                let err_msg = format!("QuicClientConfig error: {:?}", e);
-                log::error!("{}", err_msg);
-                set_last_error(&err_msg);
-                return Err(-6);
+        // Reuse the TLS config per (insecure, ALPN) so its session ticket store
+        // survives reconnects and later connections can resume with 0-RTT
+        let client_configs = CLIENT_CONFIGS.get().expect("Client config cache not initialized");
+        let config_key = (insecure != 0, alpn);
+        let cached = client_configs.get(&config_key).map(|c| c.clone());
+        let mut client_config = match cached {
+            Some(config) => config,
+            None => {
+                let config = new_client_config(config_key.0, config_key.1.clone())?;
+                client_configs.insert(config_key, config.clone());
+                config
             }
         };
-        let mut client_config = ClientConfig::new(Arc::new(crypto));
+
+        // Build transport config with standard settings (from moq-native-ietf)
+        let mut transport = TransportConfig::default();
+        transport.max_idle_timeout(Some(liveness_config.idle_timeout.try_into().unwrap()));
+        transport.keep_alive_interval(Some(liveness_config.keep_alive));
+        transport.max_concurrent_bidi_streams(100u32.into());
+        transport.max_concurrent_uni_streams(100u32.into());
+        // Enable datagrams with max size (for low-latency audio)
+        transport.datagram_receive_buffer_size(Some(65536));
+        transport.datagram_send_buffer_size(65536);
         client_config.transport_config(Arc::new(transport));
 
         // Create endpoint with a UDP socket (std::net::UdpSocket, not tokio)
@@ -379,7 +500,7 @@ pub extern "C" fn moq_quic_connect(
             EndpointConfig::default(),
             None, // No server config for client-only
             socket,
-            Arc::new(TokioRuntime),
+            quic_runtime(),
         ) {
             Ok(e) => e,
             Err(e) => {
@@ -404,21 +525,28 @@ pub extern "C" fn moq_quic_connect(
             }
         };
 
-        let connection = match connecting.await {
-            Ok(conn) => conn,
-            Err(e) => {
-                let err_msg = format!("Connection await error: {:?}", e);
-                log::error!("{}", err_msg);
-                set_last_error(&err_msg);
-                return Err(-7);
+        // Resume with 0-RTT when a session ticket from an earlier connection exists
+        let (connection, zero_rtt) = match connecting.into_0rtt() {
+            Ok((conn, accepted)) => {
+                log::info!("Resuming connection to {} with 0-RTT", addr);
+                (conn, Some(accepted))
             }
+            Err(connecting) => match connecting.await {
+                Ok(conn) => (conn, None),
+                Err(e) => {
+                    let err_msg = format!("Connection await error: {:?}", e);
+                    log::error!("{}", err_msg);
+                    set_last_error(&err_msg);
+                    return Err(-7);
+                }
+            },
         };
 
-        Ok((endpoint, connection))
+        Ok((endpoint, connection, zero_rtt))
     });
 
-    let (endpoint, connection) = match result {
-        Ok((e, c)) => (e, c),
+    let (endpoint, connection, zero_rtt) = match result {
+        Ok(r) => r,
         Err(e) => return e,
     };
 
@@ -442,6 +570,9 @@ pub extern "C" fn moq_quic_connect(
     recv_buffers.insert(connection_id, recv_buffer.clone());
     active_data_streams.insert(connection_id, Arc::new(tokio::sync::Mutex::new(Vec::new())));
 
+    let liveness_trackers = LIVENESS.get().expect("Liveness registry not initialized");
+    liveness_trackers.insert(connection_id, liveness::LivenessTracker::new(liveness_config, Instant::now()));
+
     // Log datagram capability negotiated with peer
     match connection_arc.max_datagram_size() {
         Some(size) => log::info!("Datagrams supported by peer, max size: {} bytes", size),
@@ -461,10 +592,43 @@ pub extern "C" fn moq_quic_connect(
             Ok((send, mut recv)) => {
                 log::info!("Bidirectional control stream opened for connection {}", connection_id);
                 let control_streams = CONTROL_STREAMS.get().expect("Control streams not initialized");
-
-                // Store the send stream for sending control messages
-                if let Some(ctrl_stream_mutex) = control_streams.get(&connection_id) {
-                    *ctrl_stream_mutex.lock().await = Some(ControlStream { send });
+                let ctrl_stream_mutex = match control_streams.get(&connection_id) {
+                    Some(cs) => cs.clone(),
+                    None => return,
+                };
+
+                // Store the send stream for sending control messages. While 0-RTT is
+                // unconfirmed, keep a copy of everything written so it can be replayed.
+                let early_data = zero_rtt.as_ref().map(|_| Vec::new());
+                *ctrl_stream_mutex.lock().await = Some(ControlStream { send, early_data });
+
+                if let Some(accepted) = zero_rtt {
+                    let accepted = accepted.await;
+                    let mut guard = ctrl_stream_mutex.lock().await;
+                    let ctrl = match guard.as_mut() {
+                        Some(ctrl) => ctrl,
+                        None => return,
+                    };
+                    let early_data = ctrl.early_data.take().unwrap_or_default();
+                    if accepted {
+                        log::info!("0-RTT accepted for connection {}", connection_id);
+                    } else {
+                        // Streams opened in 0-RTT are discarded; reopen and resend
+                        log::warn!("0-RTT rejected for connection {}, replaying {} control bytes", connection_id, early_data.len());
+                        match connection_for_control.open_bi().await {
+                            Ok((mut send, new_recv)) => {
+                                if let Err(e) = send.write_all(&early_data).await {
+                                    log::error!("Failed to replay control data: {:?}", e);
+                                }
+                                ctrl.send = send;
+                                recv = new_recv;
+                            }
+                            Err(e) => {
+                                log::error!("Failed to reopen control stream for connection {}: {:?}", connection_id, e);
+                                return;
+                            }
+                        }
+                    }
                 }
 
                 // Start reading from the control stream's receive side
@@ -502,8 +666,6 @@ pub extern "C" fn moq_quic_connect(
     let connection_for_streams = connection_arc.clone();
     runtime.spawn(async move {
         log::info!("Starting data stream acceptor for connection {}", connection_id);
-        let data_stream_buffers = DATA_STREAM_BUFFERS.get().expect("Data stream buffers not initialized");
-        let active_streams = ACTIVE_DATA_STREAMS.get().expect("Active data streams not initialized");
 
         loop {
             match connection_for_streams.accept_uni().await {
@@ -511,20 +673,15 @@ pub extern "C" fn moq_quic_connect(
                     let stream_id = recv_stream.id().index();
                     log::info!("*** ACCEPTED INCOMING UNI STREAM {} on connection {} ***", stream_id, connection_id);
 
-                    // Create a buffer for this specific data stream
-                    let stream_buffer = Arc::new(tokio::sync::Mutex::new(ReceiveBuffer::new(MAX_RECV_BUFFER_SIZE)));
-                    data_stream_buffers.insert((connection_id, stream_id), stream_buffer.clone());
-
-                    // Add to active streams list
-                    if let Some(streams_list) = active_streams.get(&connection_id) {
-                        let mut list = streams_list.lock().await;
-                        list.push(stream_id);
-                    }
-
                     // Spawn task to read from this stream
                     // Use larger buffer for video streaming to reduce syscalls
                     tokio::spawn(async move {
                         let mut buffer = vec![0u8; 64 * 1024]; // 64KB
+                        let mut alias_sniffer = bandwidth::TrackAliasSniffer::new();
+                        let bandwidth = BANDWIDTH.get().expect("Bandwidth registry not initialized");
+                        let mut router = ROUTES.get().expect("Route table not initialized").stream_router(connection_id);
+                        // Created once the stream turns out not to be played natively
+                        let mut stream_buffer = None;
                         loop {
                             match recv_stream.read(&mut buffer).await {
                                 Ok(None) => {
@@ -534,11 +691,22 @@ pub extern "C" fn moq_quic_connect(
                                     break;
                                 }
                                 Ok(Some(n)) => {
+                                    if let Some((track_alias, bytes)) = alias_sniffer.feed(&buffer[..n]) {
+                                        bandwidth.record(connection_id, track_alias, Instant::now(), bytes);
+                                    }
+                                    let data = match router.feed(&buffer[..n]) {
+                                        playback_sink::Delivery::Consumed => continue,
+                                        playback_sink::Delivery::Dart(data) => Cow::Borrowed(data),
+                                        playback_sink::Delivery::DartHeld(data) => Cow::Owned(data),
+                                    };
+                                    if stream_buffer.is_none() {
+                                        stream_buffer = Some(register_data_stream(connection_id, stream_id).await);
+                                    }
                                     // Add data to this stream's buffer (not the control stream buffer)
-                                    let mut recv_buf = stream_buffer.lock().await;
-                                    let pushed = recv_buf.push(&buffer[..n]);
-                                    if pushed < n {
-                                        log::warn!("Data stream {} buffer full, dropped {} bytes", stream_id, n - pushed);
+                                    let mut recv_buf = stream_buffer.as_ref().unwrap().lock().await;
+                                    let pushed = recv_buf.push(&data);
+                                    if pushed < data.len() {
+                                        log::warn!("Data stream {} buffer full, dropped {} bytes", stream_id, data.len() - pushed);
                                     }
                                     log::info!("*** STREAM DATA: {} bytes on stream {} for conn {} ***", n, stream_id, connection_id);
                                 }
@@ -548,6 +716,14 @@ pub extern "C" fn moq_quic_connect(
                                 }
                             }
                         }
+                        // A stream too short to route still belongs to Dart
+                        if let Some(held) = router.finish() {
+                            let stream_buffer = match stream_buffer {
+                                Some(buffer) => buffer,
+                                None => register_data_stream(connection_id, stream_id).await,
+                            };
+                            stream_buffer.lock().await.push(&held);
+                        }
                     });
                 }
                 Err(e) => {
@@ -656,12 +832,20 @@ pub extern "C" fn moq_quic_send(
             }
         };
 
+        if let Some(early_data) = control_stream.early_data.as_mut() {
+            early_data.extend_from_slice(&data_to_send);
+        }
+
         // Send on the bidirectional control stream
         match control_stream.send.write_all(&data_to_send).await {
             Ok(_) => {
                 log::debug!("Sent {} bytes on control stream for connection {}", len, connection_id);
                 len as i64
             }
+            Err(quinn::WriteError::ZeroRttRejected) if control_stream.early_data.is_some() => {
+                // Recorded above; the control task replays it on a fresh stream
+                len as i64
+            }
             Err(e) => {
                 log::error!("Failed to write to control stream: {:?}", e);
                 -2
@@ -729,6 +913,210 @@ pub extern "C" fn moq_quic_is_connected(connection_id: u64) -> i32 {
     }
 }
 
+/// Get the health of a connection (cheap, intended to be polled)
+///
+/// # Arguments
+/// * `connection_id` - The connection ID
+///
+/// # Returns
+/// * 0 if the connection is healthy
+/// * 1 if no packets arrived within the loss threshold (path likely dead)
+/// * 2 if the connection has been closed
+/// * -1 if the connection is not found
+#[no_mangle]
+pub extern "C" fn moq_quic_connection_state(connection_id: u64) -> i32 {
+    let connections = CONNECTIONS.get().expect("Connection registry not initialized");
+    let connection = match connections.get(&connection_id) {
+        Some(conn) => conn.clone(),
+        None => return -1,
+    };
+
+    if let Some(reason) = connection.close_reason() {
+        log::warn!("Connection {} closed: {:?}", connection_id, reason);
+        return 2;
+    }
+
+    let liveness_trackers = LIVENESS.get().expect("Liveness registry not initialized");
+    let stalled = match liveness_trackers.get_mut(&connection_id) {
+        Some(mut tracker) => tracker.observe(
+            connection.stats().udp_rx.datagrams,
+            connection.rtt(),
+            Instant::now(),
+        ),
+        None => false,
+    };
+    if stalled {
+        log::warn!("Connection {} stalled: no packets within loss threshold", connection_id);
+        1
+    } else {
+        0
+    }
+}
+
+/// Get the bandwidth estimate for a subscribed track
+///
+/// Estimates are fed by object data arriving on the track's subgroup streams.
+///
+/// # Arguments
+/// * `connection_id` - The connection ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `out_goodput_bps` - Output: bits per second delivered over the last 2 seconds
+/// * `out_capacity_bps` - Output: smoothed bits per second measured during sender bursts
+///   (0 until a large enough burst has been seen)
+///
+/// # Returns
+/// * 0 on success, -1 if nothing has been received for the track
+#[no_mangle]
+pub extern "C" fn moq_quic_bandwidth_estimate(
+    connection_id: u64,
+    track_alias: u64,
+    out_goodput_bps: *mut u64,
+    out_capacity_bps: *mut u64,
+) -> i32 {
+    let bandwidth = BANDWIDTH.get().expect("Bandwidth registry not initialized");
+    let estimate = match bandwidth.estimate(connection_id, track_alias) {
+        Some(e) => e,
+        None => return -1,
+    };
+    unsafe {
+        if !out_goodput_bps.is_null() {
+            *out_goodput_bps = estimate.goodput_bps;
+        }
+        if !out_capacity_bps.is_null() {
+            *out_capacity_bps = estimate.capacity_bps;
+        }
+    }
+    0
+}
+
+/// Play a subscribed track through a native playback sink
+///
+/// Subgroup streams of the track that start after this call are deframed and
+/// written to the sink on the reader task; they no longer show up in
+/// `moq_quic_get_data_streams`.
+///
+/// # Arguments
+/// * `connection_id` - The connection ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `sink_id` - Sink from `media_player_create_sink`
+/// * `track` - 0 for video, 1 for audio
+/// * `version` - Negotiated MoQ version
+/// * `replay_bytes` - Bound of the track's replay cache (0 = none); a sink
+///   routed to the track later starts at the newest cached group
+///
+/// # Returns
+/// * 0 on success, -1 if the sink does not exist or the track is invalid
+#[no_mangle]
+pub extern "C" fn moq_quic_route_track(
+    connection_id: u64,
+    track_alias: u64,
+    sink_id: u64,
+    track: i32,
+    version: u64,
+    replay_bytes: u64,
+) -> i32 {
+    let (sink, track) = match (playback_sink::get_sink(sink_id), playback_sink::TrackKind::from_raw(track)) {
+        (Some(sink), Some(track)) => (sink, track),
+        _ => return -1,
+    };
+    ROUTES
+        .get()
+        .expect("Route table not initialized")
+        .route(connection_id, track_alias, sink, track, version, replay_bytes as usize);
+    0
+}
+
+/// Feed a subscribed track into a redundant track, as one of its paths
+///
+/// Like `moq_quic_route_track`, but the track's objects are merged with the
+/// other paths of `redundant_id` (from `redundant_track_create`): only the
+/// first copy of each object reaches its sinks.
+///
+/// # Arguments
+/// * `connection_id` - The connection ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `redundant_id` - The redundant track
+///
+/// # Returns
+/// * Path index (for `redundant_track_get_path_stats`), or -1 if the
+///   redundant track does not exist or has no free path
+#[no_mangle]
+pub extern "C" fn moq_quic_route_redundant_path(connection_id: u64, track_alias: u64, redundant_id: u64) -> i32 {
+    let Some(route) = redundant::get_redundant_track(redundant_id) else { return -1 };
+    match ROUTES.get().expect("Route table not initialized").route_path(connection_id, track_alias, route) {
+        Some(path) => path as i32,
+        None => -1,
+    }
+}
+
+/// Stop playing a track natively; new streams go to Dart again
+///
+/// # Returns
+/// * 0 on success, -1 if the track was not routed
+#[no_mangle]
+pub extern "C" fn moq_quic_unroute_track(connection_id: u64, track_alias: u64) -> i32 {
+    if ROUTES.get().expect("Route table not initialized").unroute(connection_id, track_alias) {
+        0
+    } else {
+        -1
+    }
+}
+
+// Sends a publish pipeline's subgroup streams on a connection
+struct QuicPublishOutput {
+    connection_id: u64,
+}
+
+impl publish_pipeline::PublishOutput for QuicPublishOutput {
+    fn open_stream(&mut self) -> Result<u64, i32> {
+        open_stream_writer(self.connection_id)
+    }
+
+    fn write(&mut self, stream_id: u64, data: Vec<u8>) -> Result<(), i32> {
+        let stream_writers = STREAM_WRITERS.get().expect("Stream writers not initialized");
+        let writer = match stream_writers.get(&(self.connection_id, stream_id)) {
+            Some(w) => w.clone(),
+            None => return Err(-1),
+        };
+        // Waits for room in the writer's channel, which pushes back on the pipeline
+        writer.write_blocking(data).map_err(|_| -2)
+    }
+
+    fn finish(&mut self, stream_id: u64) {
+        moq_quic_stream_finish(self.connection_id, stream_id);
+    }
+}
+
+/// Create a native publish pipeline for a video track
+///
+/// Start it with `publish_pipeline_start`; from then on capture, encoding,
+/// moq-mi packaging and the subgroup streams are handled natively.
+///
+/// # Arguments
+/// * `connection_id` - The connection ID
+/// * `track_alias` - Track alias of the published track
+/// * `priority` - Publisher priority of its subgroups
+/// * `version` - Negotiated MoQ version
+///
+/// # Returns
+/// * Pipeline ID, or 0 if the connection does not exist
+#[no_mangle]
+pub extern "C" fn moq_quic_publish_pipeline_create(
+    connection_id: u64,
+    track_alias: u64,
+    priority: u8,
+    version: u64,
+) -> u64 {
+    let connections = CONNECTIONS.get().expect("Connection registry not initialized");
+    if !connections.contains_key(&connection_id) {
+        log::error!("Connection {} not found for publish pipeline", connection_id);
+        return 0;
+    }
+    let track = publish_pipeline::TrackConfig { track_alias, priority, version };
+    let output = Box::new(QuicPublishOutput { connection_id });
+    publish_pipeline::register_pipeline(publish_pipeline::PublishPipeline::new(track, output))
+}
+
 /// Close a QUIC connection
 #[no_mangle]
 pub extern "C" fn moq_quic_close(connection_id: u64) -> i32 {
@@ -773,6 +1161,14 @@ pub extern "C" fn moq_quic_close(connection_id: u64) -> i32 {
     let datagram_buffers = DATAGRAM_BUFFERS.get().expect("Datagram buffers not initialized");
     datagram_buffers.remove(&connection_id);
 
+    // Clean up liveness tracker
+    let liveness_trackers = LIVENESS.get().expect("Liveness registry not initialized");
+    liveness_trackers.remove(&connection_id);
+
+    // Clean up bandwidth estimates and native routes
+    BANDWIDTH.get().expect("Bandwidth registry not initialized").remove_session(connection_id);
+    ROUTES.get().expect("Route table not initialized").remove_session(connection_id);
+
     let runtime = get_runtime();
 
     // Close connection within runtime context
@@ -841,6 +1237,15 @@ pub extern "C" fn moq_quic_cleanup() {
     let datagram_buffers = DATAGRAM_BUFFERS.get().expect("Datagram buffers not initialized");
     datagram_buffers.clear();
 
+    let liveness_trackers = LIVENESS.get().expect("Liveness registry not initialized");
+    liveness_trackers.clear();
+
+    BANDWIDTH.get().expect("Bandwidth registry not initialized").clear();
+    ROUTES.get().expect("Route table not initialized").clear();
+
+    let client_configs = CLIENT_CONFIGS.get().expect("Client config cache not initialized");
+    client_configs.clear();
+
     log::info!("MoQ QUIC transport cleanup complete");
 }
 
@@ -962,6 +1367,17 @@ pub extern "C" fn moq_quic_open_stream(
     connection_id: u64,
     out_stream_id: *mut u64,
 ) -> i32 {
+    match open_stream_writer(connection_id) {
+        Ok(stream_id) => {
+            unsafe { *out_stream_id = stream_id; }
+            0
+        }
+        Err(code) => code
+    }
+}
+
+// Open a unidirectional stream with a persistent writer; returns its ID
+fn open_stream_writer(connection_id: u64) -> Result<u64, i32> {
     let connections = CONNECTIONS.get().expect("Connection registry not initialized");
     let stream_writers = STREAM_WRITERS.get().expect("Stream writers not initialized");
 
@@ -969,13 +1385,13 @@ pub extern "C" fn moq_quic_open_stream(
         Some(conn) => conn.clone(),
         None => {
             log::error!("Connection {} not found for open_stream", connection_id);
-            return -1;
+            return Err(-1);
         }
     };
 
     let runtime = get_runtime();
 
-    let result = runtime.block_on(async {
+    runtime.block_on(async {
         match connection.open_uni().await {
             Ok(send_stream) => {
                 let stream_id = NEXT_STREAM_ID.fetch_add(1, Ordering::SeqCst);
@@ -998,15 +1414,7 @@ pub extern "C" fn moq_quic_open_stream(
                 Err(-2)
             }
         }
-    });
-
-    match result {
-        Ok(stream_id) => {
-            unsafe { *out_stream_id = stream_id; }
-            0
-        }
-        Err(code) => code
-    }
+    })
 }
 
 /// Write data to an open stream
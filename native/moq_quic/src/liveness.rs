@@ -0,0 +1,123 @@
+// Connection liveness tracking for fast loss detection
+// quinn only declares a connection dead once the idle timeout expires. For live media
+// we want to notice a dead path within a few PTOs so the session can be re-established
+// while the viewer's decoder is still warm.
+
+use std::time::{Duration, Instant};
+
+// Peer max_ack_delay assumed by the PTO estimate (RFC 9000 default)
+const MAX_ACK_DELAY: Duration = Duration::from_millis(25);
+
+/// Liveness thresholds of one connection, given when it is opened
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct LivenessConfig {
+    /// QUIC max_idle_timeout
+    pub idle_timeout: Duration,
+    /// Interval between keep-alive PINGs
+    pub keep_alive: Duration,
+    /// Number of PTOs without inbound packets before the path is reported stalled
+    /// (0 disables stall detection; only the idle timeout applies)
+    pub loss_pto_count: u32,
+}
+
+impl LivenessConfig {
+    /// Build a config from milliseconds
+    ///
+    /// Returns None if the values are inconsistent (the keep-alive must fire well
+    /// within the idle timeout or a healthy but quiet connection would time out).
+    pub fn from_millis(idle_timeout_ms: u32, keep_alive_ms: u32, loss_pto_count: u32) -> Option<Self> {
+        if idle_timeout_ms == 0 || keep_alive_ms == 0 || keep_alive_ms >= idle_timeout_ms {
+            return None;
+        }
+        Some(Self {
+            idle_timeout: Duration::from_millis(idle_timeout_ms as u64),
+            keep_alive: Duration::from_millis(keep_alive_ms as u64),
+            loss_pto_count,
+        })
+    }
+}
+
+/// Estimate the probe timeout from the smoothed RTT
+///
+/// quinn does not expose rttvar, so it is approximated by its initial value of
+/// srtt/2, giving srtt + 4 * srtt/2 + max_ack_delay.
+pub fn pto(srtt: Duration) -> Duration {
+    srtt * 3 + MAX_ACK_DELAY
+}
+
+/// Tracks inbound packet progress for one connection
+///
+/// With keep-alives enabled a healthy peer acknowledges at least once per
+/// keep-alive interval, so silence for longer than one interval plus a few PTOs
+/// means the path is gone even though the idle timer has not fired yet.
+pub struct LivenessTracker {
+    last_rx_datagrams: u64,
+    last_rx_at: Instant,
+    keep_alive: Duration,
+    loss_pto_count: u32,
+}
+
+impl LivenessTracker {
+    pub fn new(config: LivenessConfig, now: Instant) -> Self {
+        Self {
+            last_rx_datagrams: 0,
+            last_rx_at: now,
+            keep_alive: config.keep_alive,
+            loss_pto_count: config.loss_pto_count,
+        }
+    }
+
+    /// Record the connection's inbound datagram counter and report whether it stalled
+    pub fn observe(&mut self, rx_datagrams: u64, srtt: Duration, now: Instant) -> bool {
+        if rx_datagrams != self.last_rx_datagrams {
+            self.last_rx_datagrams = rx_datagrams;
+            self.last_rx_at = now;
+            return false;
+        }
+        if self.loss_pto_count == 0 {
+            return false;
+        }
+        let threshold = self.keep_alive + pto(srtt) * self.loss_pto_count;
+        now.duration_since(self.last_rx_at) > threshold
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn cfg(keep_alive_ms: u64, loss_pto_count: u32) -> LivenessConfig {
+        LivenessConfig {
+            idle_timeout: Duration::from_secs(10),
+            keep_alive: Duration::from_millis(keep_alive_ms),
+            loss_pto_count,
+        }
+    }
+
+    #[test]
+    fn inbound_progress_resets_the_timer() {
+        let start = Instant::now();
+        let srtt = Duration::from_millis(50);
+        let mut t = LivenessTracker::new(cfg(200, 3), start);
+        // threshold = 200ms + 3 * (150ms + 25ms) = 725ms
+        assert!(!t.observe(0, srtt, start + Duration::from_millis(700)));
+        assert!(!t.observe(5, srtt, start + Duration::from_millis(800)));
+        assert!(!t.observe(5, srtt, start + Duration::from_millis(1500)));
+        assert!(t.observe(5, srtt, start + Duration::from_millis(1530)));
+    }
+
+    #[test]
+    fn zero_pto_count_disables_stall_detection() {
+        let start = Instant::now();
+        let mut t = LivenessTracker::new(cfg(200, 0), start);
+        assert!(!t.observe(0, Duration::from_millis(50), start + Duration::from_secs(60)));
+    }
+
+    #[test]
+    fn keep_alive_must_fit_inside_idle_timeout() {
+        assert!(LivenessConfig::from_millis(1000, 1000, 3).is_none());
+        assert!(LivenessConfig::from_millis(0, 100, 3).is_none());
+        let config = LivenessConfig::from_millis(2000, 500, 3).unwrap();
+        assert_eq!(config.keep_alive, Duration::from_millis(500));
+    }
+}
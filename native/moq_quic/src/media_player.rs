@@ -18,6 +18,7 @@ use std::os::raw::{c_void, c_char, c_int};
 use std::ptr;
 use std::sync::Arc;
 use std::sync::atomic::{AtomicBool, AtomicU64, AtomicI32, Ordering};
+use std::time::{Duration, Instant};
 
 /// Ring buffer for streaming media data
 pub struct MediaBuffer {
@@ -60,6 +61,25 @@ impl MediaBuffer {
         to_write
     }
 
+    /// Write several slices as one unit
+    ///
+    /// Either all of `parts` fit and are written, or nothing is, so a full buffer
+    /// never leaves half an fMP4 fragment behind. Returns the bytes written.
+    pub fn write_parts(&self, parts: &[&[u8]]) -> usize {
+        let total: usize = parts.iter().map(|p| p.len()).sum();
+        let mut buffer = self.data.lock();
+        if self.max_size.saturating_sub(buffer.len()) < total {
+            return 0;
+        }
+        for part in parts {
+            buffer.extend(part.iter().copied());
+        }
+
+        self.total_written.fetch_add(total as u64, Ordering::Relaxed);
+        self.condvar.notify_all();
+        total
+    }
+
     /// Read data from the buffer (blocking)
     /// Returns 0 on EOF, -1 on error
     pub fn read(&self, buf: &mut [u8]) -> i64 {
@@ -119,10 +139,67 @@ impl MediaBuffer {
     }
 }
 
+/// Startup milestones, in the order they normally occur
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StartupPhase {
+    /// mpv_initialize() returned
+    MpvReady = 0,
+    /// loadfile issued for moqbuffer://stream
+    LoadRequested = 1,
+    /// First bytes written to the ring buffer
+    FirstWrite = 2,
+    /// First bytes handed to the demuxer
+    FirstRead = 3,
+    /// Demuxer opened and tracks selected (MPV_EVENT_FILE_LOADED)
+    FileLoaded = 4,
+    /// First frame presented (MPV_EVENT_PLAYBACK_RESTART)
+    FirstFrame = 5,
+}
+
+pub const STARTUP_PHASE_COUNT: usize = 6;
+
+/// Time-to-first-frame breakdown for one player
+///
+/// Each phase is recorded once, relative to player creation. FileLoaded and
+/// FirstFrame come from mpv events, so they are only as precise as the rate at
+/// which process_events() is called.
+pub struct StartupTiming {
+    created: Instant,
+    marks: Mutex<[Option<Instant>; STARTUP_PHASE_COUNT]>,
+}
+
+impl StartupTiming {
+    fn new() -> Self {
+        Self {
+            created: Instant::now(),
+            marks: Mutex::new([None; STARTUP_PHASE_COUNT]),
+        }
+    }
+
+    fn mark(&self, phase: StartupPhase) {
+        let mut marks = self.marks.lock();
+        let slot = &mut marks[phase as usize];
+        if slot.is_none() {
+            *slot = Some(Instant::now());
+        }
+    }
+
+    /// Time from creation to each phase (None if not reached yet)
+    pub fn elapsed(&self) -> [Option<Duration>; STARTUP_PHASE_COUNT] {
+        let marks = self.marks.lock();
+        let mut out = [None; STARTUP_PHASE_COUNT];
+        for (i, mark) in marks.iter().enumerate() {
+            out[i] = mark.map(|at| at.duration_since(self.created));
+        }
+        out
+    }
+}
+
 /// Stream context for mpv callbacks
 struct StreamContext {
     buffer: Arc<MediaBuffer>,
     position: AtomicU64,
+    timing: Arc<StartupTiming>,
 }
 
 /// Video output mode
@@ -145,6 +222,24 @@ pub struct MediaPlayer {
     video_output: VideoOutput,
     video_width: AtomicI32,
     video_height: AtomicI32,
+    timing: Arc<StartupTiming>,
+}
+
+/// Native playback sinks write straight into the player's ring buffer
+struct SinkOutput {
+    buffer: Arc<MediaBuffer>,
+    timing: Arc<StartupTiming>,
+}
+
+impl crate::playback_sink::PlaybackOutput for SinkOutput {
+    fn write(&self, parts: &[&[u8]]) -> usize {
+        self.timing.mark(StartupPhase::FirstWrite);
+        self.buffer.write_parts(parts)
+    }
+
+    fn end(&self) {
+        self.buffer.set_eof();
+    }
 }
 
 // Safety: MediaPlayer is Send because mpv_handle access is synchronized
@@ -159,6 +254,7 @@ impl MediaPlayer {
 
     /// Create a new media player with specific video output mode
     pub fn with_video_output(video_output: VideoOutput) -> Result<Self, String> {
+        let timing = Arc::new(StartupTiming::new());
         unsafe {
             eprintln!("[mpv] Creating mpv instance with {:?} output", video_output);
 
@@ -200,6 +296,7 @@ impl MediaPlayer {
                 return Err(format!("Failed to initialize mpv: {}", ret));
             }
             eprintln!("[mpv] mpv_initialize() succeeded");
+            timing.mark(StartupPhase::MpvReady);
 
             let buffer = Arc::new(MediaBuffer::new(16 * 1024 * 1024)); // 16MB buffer
 
@@ -211,6 +308,7 @@ impl MediaPlayer {
                 video_output,
                 video_width: AtomicI32::new(0),
                 video_height: AtomicI32::new(0),
+                timing,
             })
         }
     }
@@ -239,6 +337,38 @@ impl MediaPlayer {
         Ok(())
     }
 
+    /// Tell the demuxer what it is going to be fed so it can skip probing
+    ///
+    /// By default lavf probes the container and then reads frames until it has
+    /// analyzed every stream, which on a live stream means waiting for network
+    /// data well past the first keyframe. When the catalog already says what the
+    /// tracks are, the format is forced and stream info is taken from the init
+    /// segment's moov alone, so the decoder opens as soon as the first fragment
+    /// is readable. Must be called before play().
+    pub fn set_stream_hints(&self, format: &str) -> Result<(), String> {
+        unsafe {
+            Self::set_option_string(self.mpv, "demuxer-lavf-format", format)?;
+            Self::set_option_string(self.mpv, "demuxer-lavf-probe-info", "nostreams")?;
+            Self::set_option_string(self.mpv, "demuxer-lavf-analyzeduration", "0.1")?;
+        }
+        log::info!("Stream hints set: format={}", format);
+        Ok(())
+    }
+
+    /// Switch input to raw interleaved s16le PCM, e.g. from the audio mixer
+    ///
+    /// Must be called before play().
+    pub fn set_raw_audio(&self, rate: u32, channels: u32) -> Result<(), String> {
+        unsafe {
+            Self::set_option_string(self.mpv, "demuxer", "rawaudio")?;
+            Self::set_option_string(self.mpv, "demuxer-rawaudio-format", "s16le")?;
+            Self::set_option_string(self.mpv, "demuxer-rawaudio-rate", &rate.to_string())?;
+            Self::set_option_string(self.mpv, "demuxer-rawaudio-channels", &channels.to_string())?;
+        }
+        log::info!("Raw audio input: {}Hz, {} channels", rate, channels);
+        Ok(())
+    }
+
     unsafe fn set_option_string(mpv: *mut mpv_handle, name: &str, value: &str) -> Result<(), String> {
         let name_cstr = CString::new(name).map_err(|e| e.to_string())?;
         let value_cstr = CString::new(value).map_err(|e| e.to_string())?;
@@ -259,6 +389,7 @@ impl MediaPlayer {
             let ctx = Box::new(StreamContext {
                 buffer: Arc::clone(&self.buffer),
                 position: AtomicU64::new(0),
+                timing: Arc::clone(&self.timing),
             });
 
             let ctx_ptr = Box::into_raw(ctx) as *mut c_void;
@@ -302,6 +433,7 @@ impl MediaPlayer {
                 ptr::null(),
             ];
 
+            self.timing.mark(StartupPhase::LoadRequested);
             let ret = mpv_command(self.mpv, args.as_mut_ptr());
             if ret < 0 {
                 eprintln!("[mpv] loadfile failed with error: {}", ret);
@@ -357,6 +489,7 @@ impl MediaPlayer {
 
     /// Write media data to the buffer
     pub fn write_data(&self, data: &[u8]) -> usize {
+        self.timing.mark(StartupPhase::FirstWrite);
         self.buffer.write(data)
     }
 
@@ -370,6 +503,11 @@ impl MediaPlayer {
         self.buffer.stats()
     }
 
+    /// Time-to-first-frame breakdown
+    pub fn startup_timing(&self) -> &StartupTiming {
+        &self.timing
+    }
+
     /// Check if playing
     pub fn is_playing(&self) -> bool {
         self.is_playing.load(Ordering::Relaxed)
@@ -396,7 +534,12 @@ impl MediaPlayer {
                         log::info!("mpv: End of file");
                         self.is_playing.store(false, Ordering::Relaxed);
                     }
+                    mpv_event_id_MPV_EVENT_FILE_LOADED => {
+                        self.timing.mark(StartupPhase::FileLoaded);
+                        log::info!("mpv: File loaded");
+                    }
                     mpv_event_id_MPV_EVENT_PLAYBACK_RESTART => {
+                        self.timing.mark(StartupPhase::FirstFrame);
                         log::info!("mpv: Playback restarted");
                     }
                     _ => {}
@@ -461,6 +604,7 @@ unsafe extern "C" fn stream_read_callback(
     let bytes_read = ctx.buffer.read(slice);
 
     if bytes_read > 0 {
+        ctx.timing.mark(StartupPhase::FirstRead);
         let pos = ctx.position.fetch_add(bytes_read as u64, Ordering::Relaxed);
         if pos == 0 || pos % 100000 < (bytes_read as u64) {
             eprintln!("[mpv] Read {} bytes, total position: {}", bytes_read, pos + bytes_read as u64);
@@ -572,6 +716,40 @@ pub extern "C" fn media_player_write(
     }
 }
 
+/// Create a native playback sink that writes into the player's buffer
+///
+/// Route subscribed tracks to the sink with moq_quic_route_track or
+/// moq_webtransport_route_track; release it with playback_sink_destroy.
+///
+/// # Arguments
+/// * `player_id` - Player ID
+/// * `packaging` - 0 for moq-mi (muxed to fMP4 natively), 1 for CMAF
+/// * `width`, `height` - Video size for the moq-mi init segment
+///
+/// # Returns
+/// Sink ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn media_player_create_sink(player_id: u64, packaging: c_int, width: c_int, height: c_int) -> u64 {
+    use crate::playback_sink::{self, Packaging, PlaybackSink};
+
+    let packaging = match packaging {
+        0 => Packaging::MoqMi,
+        1 => Packaging::Cmaf,
+        _ => return 0,
+    };
+    let output = match PLAYERS.get(&player_id) {
+        Some(player) => SinkOutput {
+            buffer: player.buffer.clone(),
+            timing: player.timing.clone(),
+        },
+        None => return 0,
+    };
+    let (width, height) = (width.clamp(0, u16::MAX as c_int) as u16, height.clamp(0, u16::MAX as c_int) as u16);
+    let sink_id = playback_sink::register_sink(PlaybackSink::new(packaging, width, height, Box::new(output)));
+    log::info!("Created playback sink {} for media player {}", sink_id, player_id);
+    sink_id
+}
+
 /// Start playback
 /// Returns 0 on success, -1 on error
 #[no_mangle]
@@ -672,6 +850,96 @@ pub extern "C" fn media_player_get_stats(
     }
 }
 
+/// Set demuxer hints from catalog metadata so playback skips probing
+///
+/// # Arguments
+/// * `player_id` - Player ID
+/// * `format` - lavf container name (e.g. "mp4"), null-terminated
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn media_player_set_stream_hints(player_id: u64, format: *const c_char) -> c_int {
+    if format.is_null() {
+        return -1;
+    }
+    let format = match unsafe { CStr::from_ptr(format) }.to_str() {
+        Ok(s) => s,
+        Err(_) => return -1,
+    };
+
+    if let Some(player) = PLAYERS.get(&player_id) {
+        match player.set_stream_hints(format) {
+            Ok(()) => 0,
+            Err(e) => {
+                log::error!("Set stream hints failed: {}", e);
+                -1
+            }
+        }
+    } else {
+        -1
+    }
+}
+
+/// Switch the player to raw s16le PCM input
+///
+/// # Arguments
+/// * `player_id` - Player ID
+/// * `rate` - Sample rate in Hz
+/// * `channels` - Interleaved channel count
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn media_player_set_raw_audio(player_id: u64, rate: c_int, channels: c_int) -> c_int {
+    if rate <= 0 || channels <= 0 {
+        return -1;
+    }
+    if let Some(player) = PLAYERS.get(&player_id) {
+        match player.set_raw_audio(rate as u32, channels as u32) {
+            Ok(()) => 0,
+            Err(e) => {
+                log::error!("Set raw audio failed: {}", e);
+                -1
+            }
+        }
+    } else {
+        -1
+    }
+}
+
+/// Get the time-to-first-frame breakdown
+///
+/// # Arguments
+/// * `player_id` - Player ID
+/// * `out_us` - Receives microseconds from player creation to each phase, in
+///   StartupPhase order (0 if the phase has not been reached)
+/// * `len` - Capacity of `out_us`
+///
+/// # Returns
+/// Number of phases written, or -1 if the player does not exist
+#[no_mangle]
+pub extern "C" fn media_player_get_startup_timing(
+    player_id: u64,
+    out_us: *mut u64,
+    len: usize,
+) -> c_int {
+    if out_us.is_null() {
+        return -1;
+    }
+    if let Some(player) = PLAYERS.get(&player_id) {
+        let elapsed = player.startup_timing().elapsed();
+        let count = len.min(STARTUP_PHASE_COUNT);
+        let out = unsafe { std::slice::from_raw_parts_mut(out_us, count) };
+        for (slot, phase) in out.iter_mut().zip(elapsed.iter()) {
+            *slot = phase.map(|d| d.as_micros() as u64).unwrap_or(0);
+        }
+        count as c_int
+    } else {
+        -1
+    }
+}
+
 /// Check if player is currently playing
 #[no_mangle]
 pub extern "C" fn media_player_is_playing(player_id: u64) -> c_int {
@@ -681,3 +949,119 @@ pub extern "C" fn media_player_is_playing(player_id: u64) -> c_int {
         0
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::process::Command;
+
+    // Time from SUBSCRIBE to the first object arriving
+    const SUBSCRIBE_RTT: Duration = Duration::from_millis(80);
+
+    // Two seconds of 720p30 H.264 as fragmented MP4, split into the init segment
+    // and the media fragments that follow it
+    fn fixture() -> Option<(Vec<u8>, Vec<u8>)> {
+        let output = Command::new("ffmpeg")
+            .args([
+                "-hide_banner", "-loglevel", "error",
+                "-f", "lavfi", "-i", "testsrc=size=1280x720:rate=30",
+                "-t", "2", "-c:v", "libx264", "-g", "30", "-pix_fmt", "yuv420p",
+                "-movflags", "frag_keyframe+empty_moov+default_base_moof",
+                "-f", "mp4", "pipe:1",
+            ])
+            .output()
+            .ok()?;
+        if !output.status.success() {
+            return None;
+        }
+
+        let data = output.stdout;
+        let mut offset = 0;
+        while offset + 8 <= data.len() {
+            let size = u32::from_be_bytes(data[offset..offset + 4].try_into().unwrap()) as usize;
+            if &data[offset + 4..offset + 8] == b"moof" {
+                return Some((data[..offset].to_vec(), data[offset..].to_vec()));
+            }
+            if size < 8 {
+                return None;
+            }
+            offset += size;
+        }
+        None
+    }
+
+    // Runs one startup and returns each phase relative to the first object arriving
+    fn startup(prepared: bool, init: &[u8], media: &[u8]) -> Vec<Option<f64>> {
+        let mut player = MediaPlayer::with_video_output(VideoOutput::Null).expect("libmpv");
+        player.register_protocol().unwrap();
+
+        if prepared {
+            // Catalog path: player, demuxer hints and init segment ready before SUBSCRIBE_OK
+            player.set_stream_hints("mp4").unwrap();
+            player.write_data(init);
+            player.play().unwrap();
+        }
+
+        let arrival = Instant::now() + SUBSCRIBE_RTT;
+        while Instant::now() < arrival {
+            player.process_events();
+            std::thread::sleep(Duration::from_millis(1));
+        }
+        let arrival = arrival.duration_since(player.timing.created);
+
+        if !prepared {
+            // Current path: init comes from the first keyframe, then playback starts
+            player.write_data(init);
+        }
+        player.write_data(media);
+        if !prepared {
+            player.play().unwrap();
+        }
+
+        let deadline = Instant::now() + Duration::from_secs(10);
+        while player.timing.elapsed()[StartupPhase::FirstFrame as usize].is_none()
+            && Instant::now() < deadline
+        {
+            player.process_events();
+            std::thread::sleep(Duration::from_millis(1));
+        }
+
+        player
+            .timing
+            .elapsed()
+            .iter()
+            .map(|phase| phase.map(|d| (d.as_secs_f64() - arrival.as_secs_f64()) * 1000.0))
+            .collect()
+    }
+
+    // Time-to-first-frame breakdown, cold start vs catalog pre-initialization.
+    // Needs libmpv and the ffmpeg CLI:
+    //   cargo test --release startup_breakdown -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn startup_breakdown() {
+        let (init, media) = match fixture() {
+            Some(f) => f,
+            None => {
+                eprintln!("ffmpeg with libx264 not available, skipping");
+                return;
+            }
+        };
+
+        let names = ["mpv ready", "loadfile", "first write", "first read", "file loaded", "first frame"];
+        println!("ms relative to first object arrival (SUBSCRIBE RTT {:?})", SUBSCRIBE_RTT);
+        println!("{:<12} {:>10} {:>10}", "phase", "cold", "catalog");
+        let cold = startup(false, &init, &media);
+        let prepared = startup(true, &init, &media);
+        for (i, name) in names.iter().enumerate() {
+            let fmt = |v: Option<f64>| v.map(|ms| format!("{:.1}", ms)).unwrap_or_else(|| "-".into());
+            println!("{:<12} {:>10} {:>10}", name, fmt(cold[i]), fmt(prepared[i]));
+        }
+
+        let first_frame = StartupPhase::FirstFrame as usize;
+        assert!(prepared[first_frame].is_some(), "pre-initialized player never showed a frame");
+        if let (Some(c), Some(p)) = (cold[first_frame], prepared[first_frame]) {
+            println!("first frame after arrival: cold {:.1} ms, catalog {:.1} ms", c, p);
+        }
+    }
+}
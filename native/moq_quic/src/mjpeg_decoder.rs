@@ -0,0 +1,967 @@
+// MJPEG camera frame decoding
+//
+// Many USB cameras only reach 1080p30/60 when sending MJPEG; their raw YUYV
+// modes are limited by USB 2.0 bandwidth to 5-10 fps at that size. Letting a
+// general-purpose decoder (ffmpeg's, or the OS's) turn the JPEGs into RGB and
+// then converting RGB back to YUV for the encoder wastes most of the work.
+//
+// Architecture:
+// - Compressed frames are pushed via FFI; only the newest undecoded frame is
+//   kept, so a slow decode drops frames instead of building latency
+// - A worker thread decodes with libjpeg-turbo (SIMD IDCT) straight into YUV
+//   planes, skipping colour conversion and upsampling entirely
+// - Chroma is resampled to 4:2:0 when the camera sends 4:2:2 (most do), and
+//   JPEG's full-range levels are mapped to the limited range encoders expect
+// - Decoded I420 frames are pulled via FFI; buffers are recycled
+// - On Linux, V4L2 modes are enumerated (VIDIOC_ENUM_FMT and friends) so the
+//   capture layer can tell when MJPEG is the only way to the requested rate
+
+use std::collections::VecDeque;
+use std::os::raw::{c_char, c_int};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::JoinHandle;
+use std::time::Instant;
+
+// Decoded frames waiting to be pulled before the oldest is dropped
+const MAX_READY_FRAMES: usize = 3;
+
+/// Decodes one JPEG into a packed I420 frame
+pub trait JpegDecoder: Send {
+    /// Decode `jpeg` into `out` (resized as needed), returning its size
+    fn decode(&mut self, jpeg: &[u8], out: &mut Vec<u8>) -> Result<(usize, usize), i32>;
+}
+
+/// A decoded frame
+pub struct DecodedFrame {
+    pub i420: Vec<u8>,
+    pub width: usize,
+    pub height: usize,
+    pub timestamp_ms: i64,
+}
+
+/// Decoder counters
+#[derive(Debug, Clone, Copy, Default)]
+pub struct MjpegStats {
+    pub decoded: u64,
+    /// Frames replaced before they were decoded, or decoded but never pulled
+    pub dropped: u64,
+    pub errors: u64,
+    /// Time spent decoding
+    pub decode_us: u64,
+}
+
+// -----------------------------------------------------------------------------
+// Chroma resampling
+// -----------------------------------------------------------------------------
+
+/// Chroma subsampling factors of a JPEG, horizontally and vertically
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Subsampling {
+    pub x: usize,
+    pub y: usize,
+}
+
+/// Size of an I420 frame
+pub fn i420_len(width: usize, height: usize) -> usize {
+    width * height + 2 * width.div_ceil(2) * height.div_ceil(2)
+}
+
+/// Resample a chroma plane of `width` x `height` luma pixels, subsampled by
+/// `from`, into a 4:2:0 plane
+pub fn chroma_to_420(src: &[u8], from: Subsampling, width: usize, height: usize, dst: &mut [u8]) {
+    let src_width = width.div_ceil(from.x);
+    let src_height = height.div_ceil(from.y);
+    let dst_width = width.div_ceil(2);
+    let dst_height = height.div_ceil(2);
+    let mut row = vec![0u8; src_width];
+
+    for y in 0..dst_height {
+        // Vertical: average the two rows of 1-line chroma, or take the row
+        match from.y {
+            1 => {
+                let top = &src[(2 * y) * src_width..][..src_width];
+                let bottom = &src[(2 * y + 1).min(src_height - 1) * src_width..][..src_width];
+                average_rows(top, bottom, &mut row);
+            }
+            _ => row.copy_from_slice(&src[y.min(src_height - 1) * src_width..][..src_width]),
+        }
+
+        // Horizontal: average pairs, copy, or repeat (4:1:1)
+        let out = &mut dst[y * dst_width..(y + 1) * dst_width];
+        match from.x {
+            1 => {
+                for (x, o) in out.iter_mut().enumerate() {
+                    let a = row[2 * x] as u16;
+                    let b = row[(2 * x + 1).min(src_width - 1)] as u16;
+                    *o = ((a + b + 1) >> 1) as u8;
+                }
+            }
+            2 => out.copy_from_slice(&row[..dst_width]),
+            _ => {
+                for (x, o) in out.iter_mut().enumerate() {
+                    *o = row[(x / 2).min(src_width - 1)];
+                }
+            }
+        }
+    }
+}
+
+/// Map full-range (JFIF) luma and chroma planes to BT.601 limited range
+pub fn compress_range(luma: &mut [u8], chroma: &mut [u8]) {
+    // (v * scale + offset) / 255 with rounding; the division by a constant
+    // vectorizes to a multiply
+    fn map(plane: &mut [u8], scale: u16, offset: u16) {
+        let mut chunks = plane.chunks_exact_mut(16);
+        for chunk in &mut chunks {
+            for v in chunk.iter_mut() {
+                *v = ((*v as u16 * scale + offset) / 255) as u8;
+            }
+        }
+        for v in chunks.into_remainder() {
+            *v = ((*v as u16 * scale + offset) / 255) as u8;
+        }
+    }
+    map(luma, 219, 16 * 255 + 127);
+    map(chroma, 224, 128 * 31 + 127);
+}
+
+// Sixteen lanes per step, which LLVM maps onto SSE2 on x86_64 and NEON on
+// aarch64 (pavgb / urhadd)
+fn average_rows(top: &[u8], bottom: &[u8], out: &mut [u8]) {
+    let mut out_chunks = out.chunks_exact_mut(16);
+    let mut top_chunks = top.chunks_exact(16);
+    let mut bottom_chunks = bottom.chunks_exact(16);
+    for ((o, t), b) in (&mut out_chunks).zip(&mut top_chunks).zip(&mut bottom_chunks) {
+        for i in 0..16 {
+            o[i] = ((t[i] as u16 + b[i] as u16 + 1) >> 1) as u8;
+        }
+    }
+    for ((o, t), b) in out_chunks
+        .into_remainder()
+        .iter_mut()
+        .zip(top_chunks.remainder())
+        .zip(bottom_chunks.remainder())
+    {
+        *o = ((*t as u16 + *b as u16 + 1) >> 1) as u8;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// libjpeg-turbo
+// -----------------------------------------------------------------------------
+
+// Also used by the thumbnail encoder
+pub(crate) mod tj {
+    use std::os::raw::{c_char, c_int, c_uchar, c_ulong, c_void};
+
+    pub type Handle = *mut c_void;
+
+    pub const TJSAMP_444: c_int = 0;
+    pub const TJSAMP_422: c_int = 1;
+    pub const TJSAMP_420: c_int = 2;
+    pub const TJSAMP_GRAY: c_int = 3;
+    pub const TJSAMP_440: c_int = 4;
+    pub const TJSAMP_411: c_int = 5;
+    #[cfg(test)]
+    pub const TJPF_RGB: c_int = 0;
+    pub const TJFLAG_FASTDCT: c_int = 2048;
+
+    #[link(name = "turbojpeg")]
+    extern "C" {
+        pub fn tjInitDecompress() -> Handle;
+        pub fn tjDestroy(handle: Handle) -> c_int;
+        pub fn tjDecompressHeader3(
+            handle: Handle,
+            jpeg: *const c_uchar,
+            size: c_ulong,
+            width: *mut c_int,
+            height: *mut c_int,
+            subsamp: *mut c_int,
+            colorspace: *mut c_int,
+        ) -> c_int;
+        pub fn tjDecompressToYUVPlanes(
+            handle: Handle,
+            jpeg: *const c_uchar,
+            size: c_ulong,
+            planes: *mut *mut c_uchar,
+            width: c_int,
+            strides: *mut c_int,
+            height: c_int,
+            flags: c_int,
+        ) -> c_int;
+        pub fn tjGetErrorStr2(handle: Handle) -> *mut c_char;
+        pub fn tjInitCompress() -> Handle;
+        pub fn tjCompressFromYUVPlanes(
+            handle: Handle,
+            planes: *const *const c_uchar,
+            width: c_int,
+            strides: *const c_int,
+            height: c_int,
+            subsamp: c_int,
+            jpeg: *mut *mut c_uchar,
+            size: *mut c_ulong,
+            quality: c_int,
+            flags: c_int,
+        ) -> c_int;
+        #[cfg(test)]
+        pub fn tjCompress2(
+            handle: Handle,
+            src: *const c_uchar,
+            width: c_int,
+            pitch: c_int,
+            height: c_int,
+            pixel_format: c_int,
+            jpeg: *mut *mut c_uchar,
+            size: *mut c_ulong,
+            subsamp: c_int,
+            quality: c_int,
+            flags: c_int,
+        ) -> c_int;
+        pub fn tjFree(buffer: *mut c_uchar);
+    }
+}
+
+/// libjpeg-turbo decoder writing YUV planes without colour conversion
+pub struct TurboJpegDecoder {
+    handle: tj::Handle,
+    // Chroma planes at the JPEG's own subsampling, when not 4:2:0
+    chroma: Vec<u8>,
+    fast_dct: bool,
+    full_range: bool,
+}
+
+// The handle is only used by the worker that owns it
+unsafe impl Send for TurboJpegDecoder {}
+
+impl TurboJpegDecoder {
+    /// `fast_dct` trades a little accuracy for a faster inverse DCT;
+    /// `full_range` keeps JPEG levels instead of mapping them to limited range
+    pub fn new(fast_dct: bool, full_range: bool) -> Result<Self, i32> {
+        let handle = unsafe { tj::tjInitDecompress() };
+        if handle.is_null() {
+            return Err(-1);
+        }
+        Ok(Self { handle, chroma: Vec::new(), fast_dct, full_range })
+    }
+
+    fn error(&self) -> String {
+        unsafe { std::ffi::CStr::from_ptr(tj::tjGetErrorStr2(self.handle)) }
+            .to_string_lossy()
+            .into_owned()
+    }
+}
+
+impl JpegDecoder for TurboJpegDecoder {
+    fn decode(&mut self, jpeg: &[u8], out: &mut Vec<u8>) -> Result<(usize, usize), i32> {
+        let (mut width, mut height, mut subsamp, mut colorspace) = (0, 0, 0, 0);
+        let ok = unsafe {
+            tj::tjDecompressHeader3(
+                self.handle,
+                jpeg.as_ptr(),
+                jpeg.len() as _,
+                &mut width,
+                &mut height,
+                &mut subsamp,
+                &mut colorspace,
+            )
+        };
+        if ok != 0 {
+            log::debug!("Bad JPEG header: {}", self.error());
+            return Err(-3);
+        }
+        let (w, h) = (width as usize, height as usize);
+        let from = match subsamp {
+            tj::TJSAMP_444 => Subsampling { x: 1, y: 1 },
+            tj::TJSAMP_422 => Subsampling { x: 2, y: 1 },
+            tj::TJSAMP_420 | tj::TJSAMP_GRAY => Subsampling { x: 2, y: 2 },
+            tj::TJSAMP_440 => Subsampling { x: 1, y: 2 },
+            tj::TJSAMP_411 => Subsampling { x: 4, y: 1 },
+            _ => return Err(-3),
+        };
+
+        let luma = w * h;
+        let (cw, ch) = (w.div_ceil(2), h.div_ceil(2));
+        out.resize(i420_len(w, h), 0);
+
+        // 4:2:0 decodes straight into the output; other layouts decode their
+        // chroma into scratch planes first
+        let direct = subsamp == tj::TJSAMP_420 || subsamp == tj::TJSAMP_GRAY;
+        let (src_cw, src_ch) = (w.div_ceil(from.x), h.div_ceil(from.y));
+        if !direct {
+            self.chroma.resize(2 * src_cw * src_ch, 0);
+        }
+        let (y_plane, chroma_out) = out.split_at_mut(luma);
+        let (mut planes, mut strides) = if direct {
+            let (u, v) = chroma_out.split_at_mut(cw * ch);
+            ([y_plane.as_mut_ptr(), u.as_mut_ptr(), v.as_mut_ptr()], [w as c_int, cw as c_int, cw as c_int])
+        } else {
+            let (u, v) = self.chroma.split_at_mut(src_cw * src_ch);
+            ([y_plane.as_mut_ptr(), u.as_mut_ptr(), v.as_mut_ptr()], [w as c_int, src_cw as c_int, src_cw as c_int])
+        };
+        let flags = if self.fast_dct { tj::TJFLAG_FASTDCT } else { 0 };
+        let ok = unsafe {
+            tj::tjDecompressToYUVPlanes(
+                self.handle,
+                jpeg.as_ptr(),
+                jpeg.len() as _,
+                planes.as_mut_ptr(),
+                width,
+                strides.as_mut_ptr(),
+                height,
+                flags,
+            )
+        };
+        if ok != 0 {
+            log::debug!("JPEG decode failed: {}", self.error());
+            return Err(-4);
+        }
+
+        if subsamp == tj::TJSAMP_GRAY {
+            chroma_out.fill(128);
+        } else if !direct {
+            let (u_out, v_out) = chroma_out.split_at_mut(cw * ch);
+            let (u, v) = self.chroma.split_at(src_cw * src_ch);
+            chroma_to_420(u, from, w, h, u_out);
+            chroma_to_420(v, from, w, h, v_out);
+        }
+        if !self.full_range {
+            compress_range(y_plane, chroma_out);
+        }
+        Ok((w, h))
+    }
+}
+
+impl Drop for TurboJpegDecoder {
+    fn drop(&mut self) {
+        unsafe { tj::tjDestroy(self.handle) };
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Decode worker
+// -----------------------------------------------------------------------------
+
+struct State {
+    // Newest frame not yet decoded
+    pending: Option<(Vec<u8>, i64)>,
+    ready: VecDeque<DecodedFrame>,
+    spare: Vec<Vec<u8>>,
+    stats: MjpegStats,
+    closed: bool,
+}
+
+struct Shared {
+    state: Mutex<State>,
+    wake: Condvar,
+}
+
+/// Decodes pushed JPEGs on a dedicated thread
+pub struct MjpegWorker {
+    shared: Arc<Shared>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl MjpegWorker {
+    pub fn new(decoder: Box<dyn JpegDecoder>) -> Self {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                pending: None,
+                ready: VecDeque::new(),
+                spare: Vec::new(),
+                stats: MjpegStats::default(),
+                closed: false,
+            }),
+            wake: Condvar::new(),
+        });
+        let worker = shared.clone();
+        let thread = std::thread::Builder::new()
+            .name("mjpeg-decode".into())
+            .spawn(move || Self::run(worker, decoder))
+            .expect("failed to spawn MJPEG decode thread");
+        Self { shared, thread: Some(thread) }
+    }
+
+    /// Queue a frame, replacing one still waiting to be decoded
+    pub fn push(&self, jpeg: &[u8], timestamp_ms: i64) {
+        let mut state = self.shared.state.lock().unwrap();
+        let mut buffer = match state.pending.take() {
+            Some((buffer, _)) => {
+                state.stats.dropped += 1;
+                buffer
+            }
+            None => Vec::new(),
+        };
+        buffer.clear();
+        buffer.extend_from_slice(jpeg);
+        state.pending = Some((buffer, timestamp_ms));
+        drop(state);
+        self.shared.wake.notify_one();
+    }
+
+    /// Size of the next decoded frame, if any
+    pub fn peek(&self) -> Option<(usize, usize, i64)> {
+        let state = self.shared.state.lock().unwrap();
+        state.ready.front().map(|f| (f.width, f.height, f.timestamp_ms))
+    }
+
+    /// Take the next decoded frame; hand its buffer back with `recycle`
+    pub fn pop(&self) -> Option<DecodedFrame> {
+        self.shared.state.lock().unwrap().ready.pop_front()
+    }
+
+    pub fn recycle(&self, buffer: Vec<u8>) {
+        let mut state = self.shared.state.lock().unwrap();
+        if state.spare.len() < MAX_READY_FRAMES {
+            state.spare.push(buffer);
+        }
+    }
+
+    pub fn stats(&self) -> MjpegStats {
+        self.shared.state.lock().unwrap().stats
+    }
+
+    fn run(shared: Arc<Shared>, mut decoder: Box<dyn JpegDecoder>) {
+        let mut jpeg;
+        loop {
+            let (timestamp_ms, mut out) = {
+                let mut state = shared.state.lock().unwrap();
+                loop {
+                    if state.closed {
+                        return;
+                    }
+                    if let Some((buffer, timestamp_ms)) = state.pending.take() {
+                        jpeg = buffer;
+                        break (timestamp_ms, state.spare.pop().unwrap_or_default());
+                    }
+                    state = shared.wake.wait(state).unwrap();
+                }
+            };
+
+            let start = Instant::now();
+            let result = decoder.decode(&jpeg, &mut out);
+            let elapsed = start.elapsed().as_micros() as u64;
+
+            let mut state = shared.state.lock().unwrap();
+            state.stats.decode_us += elapsed;
+            match result {
+                Ok((width, height)) => {
+                    state.stats.decoded += 1;
+                    if state.ready.len() >= MAX_READY_FRAMES {
+                        if let Some(stale) = state.ready.pop_front() {
+                            state.stats.dropped += 1;
+                            state.spare.push(stale.i420);
+                        }
+                    }
+                    state.ready.push_back(DecodedFrame { i420: out, width, height, timestamp_ms });
+                }
+                Err(_) => {
+                    state.stats.errors += 1;
+                    state.spare.push(out);
+                }
+            }
+        }
+    }
+}
+
+impl Drop for MjpegWorker {
+    fn drop(&mut self) {
+        self.shared.state.lock().unwrap().closed = true;
+        self.shared.wake.notify_all();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// V4L2 mode enumeration
+// -----------------------------------------------------------------------------
+
+/// One capture mode of a camera (mirrors `CameraMode` in Dart)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CameraMode {
+    /// FourCC, e.g. `MJPG` or `YUYV`
+    pub fourcc: u32,
+    pub width: u32,
+    pub height: u32,
+    /// Frame interval in seconds, as a fraction (1/30 = 30 fps)
+    pub interval_num: u32,
+    pub interval_den: u32,
+    /// Non-zero for compressed formats
+    pub compressed: u32,
+}
+
+#[cfg(target_os = "linux")]
+pub mod v4l2 {
+    use super::CameraMode;
+    use std::os::unix::io::AsRawFd;
+
+    const VIDIOC_ENUM_FMT: libc::c_ulong = 0xc040_5602;
+    const VIDIOC_ENUM_FRAMESIZES: libc::c_ulong = 0xc02c_564a;
+    const VIDIOC_ENUM_FRAMEINTERVALS: libc::c_ulong = 0xc034_564b;
+    const V4L2_BUF_TYPE_VIDEO_CAPTURE: u32 = 1;
+    const V4L2_FMT_FLAG_COMPRESSED: u32 = 1;
+    const V4L2_FRMSIZE_TYPE_DISCRETE: u32 = 1;
+    const V4L2_FRMIVAL_TYPE_DISCRETE: u32 = 1;
+
+    #[repr(C)]
+    struct FmtDesc {
+        index: u32,
+        kind: u32,
+        flags: u32,
+        description: [u8; 32],
+        pixel_format: u32,
+        mbus_code: u32,
+        reserved: [u32; 3],
+    }
+
+    #[repr(C)]
+    struct FrmSizeEnum {
+        index: u32,
+        pixel_format: u32,
+        kind: u32,
+        // Discrete: width, height. Stepwise: min/max/step width, min/max/step height
+        size: [u32; 6],
+        reserved: [u32; 2],
+    }
+
+    #[repr(C)]
+    struct FrmIvalEnum {
+        index: u32,
+        pixel_format: u32,
+        width: u32,
+        height: u32,
+        kind: u32,
+        // Discrete: num, den. Stepwise: min, max, step as num/den pairs
+        interval: [u32; 6],
+        reserved: [u32; 2],
+    }
+
+    fn ioctl<T>(fd: i32, request: libc::c_ulong, arg: &mut T) -> bool {
+        loop {
+            let result = unsafe { libc::ioctl(fd, request as _, arg as *mut T) };
+            if result == 0 {
+                return true;
+            }
+            if std::io::Error::last_os_error().raw_os_error() != Some(libc::EINTR) {
+                return false;
+            }
+        }
+    }
+
+    /// Every format, size and frame rate `device` offers
+    ///
+    /// Stepwise sizes report their largest size; stepwise intervals their
+    /// shortest interval.
+    pub fn enumerate(device: &str) -> std::io::Result<Vec<CameraMode>> {
+        let file = std::fs::OpenOptions::new().read(true).write(true).open(device)?;
+        let fd = file.as_raw_fd();
+        let mut modes = Vec::new();
+
+        for format_index in 0.. {
+            let mut format: FmtDesc = unsafe { std::mem::zeroed() };
+            format.index = format_index;
+            format.kind = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            if !ioctl(fd, VIDIOC_ENUM_FMT, &mut format) {
+                break;
+            }
+            let compressed = (format.flags & V4L2_FMT_FLAG_COMPRESSED != 0) as u32;
+
+            for size_index in 0.. {
+                let mut size: FrmSizeEnum = unsafe { std::mem::zeroed() };
+                size.index = size_index;
+                size.pixel_format = format.pixel_format;
+                if !ioctl(fd, VIDIOC_ENUM_FRAMESIZES, &mut size) {
+                    break;
+                }
+                let (width, height) = if size.kind == V4L2_FRMSIZE_TYPE_DISCRETE {
+                    (size.size[0], size.size[1])
+                } else {
+                    (size.size[1], size.size[4])
+                };
+
+                for interval_index in 0.. {
+                    let mut interval: FrmIvalEnum = unsafe { std::mem::zeroed() };
+                    interval.index = interval_index;
+                    interval.pixel_format = format.pixel_format;
+                    interval.width = width;
+                    interval.height = height;
+                    if !ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &mut interval) {
+                        break;
+                    }
+                    modes.push(CameraMode {
+                        fourcc: format.pixel_format,
+                        width,
+                        height,
+                        interval_num: interval.interval[0],
+                        interval_den: interval.interval[1],
+                        compressed,
+                    });
+                    if interval.kind != V4L2_FRMIVAL_TYPE_DISCRETE {
+                        break;
+                    }
+                }
+                if size.kind != V4L2_FRMSIZE_TYPE_DISCRETE {
+                    break;
+                }
+            }
+        }
+        Ok(modes)
+    }
+}
+
+// Global decoder registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static MJPEG_DECODERS: Lazy<DashMap<u64, Arc<MjpegWorker>>> = Lazy::new(|| DashMap::new());
+static NEXT_DECODER_ID: AtomicU64 = AtomicU64::new(1);
+
+fn decoder(decoder_id: u64) -> Option<Arc<MjpegWorker>> {
+    MJPEG_DECODERS.get(&decoder_id).map(|d| d.clone())
+}
+
+// FFI Functions
+
+/// Create an MJPEG decoder with its worker thread
+///
+/// # Arguments
+/// * `fast_dct` - Non-zero to use the faster, slightly less accurate IDCT
+/// * `full_range` - Non-zero to output JPEG's full-range levels unchanged
+///   (0 maps them to the BT.601 limited range encoders expect)
+///
+/// # Returns
+/// Decoder ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn mjpeg_decoder_create(fast_dct: c_int, full_range: c_int) -> u64 {
+    let decoder = match TurboJpegDecoder::new(fast_dct != 0, full_range != 0) {
+        Ok(decoder) => decoder,
+        Err(_) => {
+            log::error!("Failed to initialize libjpeg-turbo");
+            return 0;
+        }
+    };
+    let id = NEXT_DECODER_ID.fetch_add(1, Ordering::Relaxed);
+    MJPEG_DECODERS.insert(id, Arc::new(MjpegWorker::new(Box::new(decoder))));
+    log::info!("Created MJPEG decoder {}", id);
+    id
+}
+
+/// Destroy an MJPEG decoder
+#[no_mangle]
+pub extern "C" fn mjpeg_decoder_destroy(decoder_id: u64) {
+    if MJPEG_DECODERS.remove(&decoder_id).is_some() {
+        log::info!("Destroyed MJPEG decoder {}", decoder_id);
+    }
+}
+
+/// Queue a JPEG frame for decoding
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn mjpeg_decoder_push(
+    decoder_id: u64,
+    data: *const u8,
+    len: usize,
+    timestamp_ms: i64,
+) -> c_int {
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let Some(decoder) = decoder(decoder_id) else { return -1 };
+    let jpeg = unsafe { std::slice::from_raw_parts(data, len) };
+    decoder.push(jpeg, timestamp_ms);
+    0
+}
+
+/// Take the next decoded I420 frame
+///
+/// # Arguments
+/// * `decoder_id` - Decoder ID
+/// * `out` - Buffer for the frame (may be null when `len` is 0)
+/// * `len` - Length of `out`
+/// * `out_info` - Receives width, height and timestamp (3 values)
+///
+/// # Returns
+/// 1 if a frame was written, 0 if none is ready, -2 if `out` is too small
+/// (`out_info` holds the frame's size and the frame stays queued), -1 on error
+#[no_mangle]
+pub extern "C" fn mjpeg_decoder_pull(
+    decoder_id: u64,
+    out: *mut u8,
+    len: usize,
+    out_info: *mut i64,
+) -> c_int {
+    if out_info.is_null() || (out.is_null() && len > 0) {
+        return -1;
+    }
+    let Some(decoder) = decoder(decoder_id) else { return -1 };
+    let Some((width, height, timestamp_ms)) = decoder.peek() else { return 0 };
+    let info = unsafe { std::slice::from_raw_parts_mut(out_info, 3) };
+    info.copy_from_slice(&[width as i64, height as i64, timestamp_ms]);
+    if len < i420_len(width, height) {
+        return -2;
+    }
+    let Some(frame) = decoder.pop() else { return 0 };
+    let dst = unsafe { std::slice::from_raw_parts_mut(out, frame.i420.len()) };
+    dst.copy_from_slice(&frame.i420);
+    decoder.recycle(frame.i420);
+    1
+}
+
+/// Get decoder counters
+///
+/// Writes up to `len` values: decoded, dropped, errors, decode microseconds.
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn mjpeg_decoder_get_stats(decoder_id: u64, out_stats: *mut u64, len: usize) -> c_int {
+    if out_stats.is_null() {
+        return -1;
+    }
+    let Some(decoder) = decoder(decoder_id) else { return -1 };
+    let stats = decoder.stats();
+    let values = [stats.decoded, stats.dropped, stats.errors, stats.decode_us];
+    let count = len.min(values.len());
+    let out = unsafe { std::slice::from_raw_parts_mut(out_stats, count) };
+    out.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+/// Enumerate the capture modes of a V4L2 device
+///
+/// # Arguments
+/// * `device` - Device path, e.g. /dev/video0
+/// * `out_modes` - Array receiving up to `capacity` modes
+/// * `capacity` - Length of `out_modes`
+///
+/// # Returns
+/// Total number of modes (may exceed `capacity`), or -1 on error
+#[no_mangle]
+pub extern "C" fn camera_enumerate_modes(
+    device: *const c_char,
+    out_modes: *mut CameraMode,
+    capacity: usize,
+) -> c_int {
+    if device.is_null() || (out_modes.is_null() && capacity > 0) {
+        return -1;
+    }
+    #[cfg(target_os = "linux")]
+    {
+        let device = unsafe { std::ffi::CStr::from_ptr(device) }.to_string_lossy();
+        match v4l2::enumerate(&device) {
+            Ok(modes) => {
+                let count = modes.len().min(capacity);
+                if count > 0 {
+                    let out = unsafe { std::slice::from_raw_parts_mut(out_modes, count) };
+                    out.copy_from_slice(&modes[..count]);
+                }
+                modes.len() as c_int
+            }
+            Err(e) => {
+                log::warn!("Failed to enumerate {}: {}", device, e);
+                -1
+            }
+        }
+    }
+    #[cfg(not(target_os = "linux"))]
+    {
+        -1
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Duration;
+
+    /// Decoder that "decodes" a 2-byte header into a frame of that size
+    struct FakeDecoder {
+        delay: Duration,
+    }
+
+    impl JpegDecoder for FakeDecoder {
+        fn decode(&mut self, jpeg: &[u8], out: &mut Vec<u8>) -> Result<(usize, usize), i32> {
+            std::thread::sleep(self.delay);
+            if jpeg.len() < 2 {
+                return Err(-3);
+            }
+            let (width, height) = (jpeg[0] as usize, jpeg[1] as usize);
+            out.clear();
+            out.resize(i420_len(width, height), jpeg.get(2).copied().unwrap_or(0));
+            Ok((width, height))
+        }
+    }
+
+    fn wait_for(worker: &MjpegWorker, decoded: u64) {
+        for _ in 0..200 {
+            let stats = worker.stats();
+            if stats.decoded + stats.errors >= decoded {
+                return;
+            }
+            std::thread::sleep(Duration::from_millis(2));
+        }
+        panic!("worker stalled: {:?}", worker.stats());
+    }
+
+    #[test]
+    fn resamples_422_and_444_to_420() {
+        // 4x2 luma: 4:2:2 chroma is 2x2, 4:4:4 is 4x2
+        let mut out = [0u8; 2];
+        chroma_to_420(&[10, 20, 30, 40], Subsampling { x: 2, y: 1 }, 4, 2, &mut out);
+        assert_eq!(out, [20, 30]);
+        chroma_to_420(&[0, 2, 4, 6, 2, 4, 6, 8], Subsampling { x: 1, y: 1 }, 4, 2, &mut out);
+        assert_eq!(out, [2, 6]);
+
+        // Odd sizes repeat the last row / column
+        let mut out = [0u8; 4];
+        chroma_to_420(&[10, 20, 30, 40, 50, 60], Subsampling { x: 2, y: 1 }, 3, 3, &mut out);
+        assert_eq!(out, [20, 30, 50, 60]);
+
+        // Long rows go through the lane path and its remainder
+        let top: Vec<u8> = (0..40).collect();
+        let bottom: Vec<u8> = (0..40).map(|i| i + 3).collect();
+        let mut row = vec![0u8; 40];
+        average_rows(&top, &bottom, &mut row);
+        assert!(row.iter().enumerate().all(|(i, &v)| v as usize == i + 2));
+    }
+
+    #[test]
+    fn keeps_only_the_newest_pending_frame() {
+        let worker = MjpegWorker::new(Box::new(FakeDecoder { delay: Duration::from_millis(30) }));
+        worker.push(&[4, 2, 1], 0);
+        std::thread::sleep(Duration::from_millis(5));
+        // Frame 0 is decoding; 1 and 2 queue behind it and 1 is replaced
+        worker.push(&[4, 2, 2], 33);
+        worker.push(&[4, 2, 3], 66);
+        wait_for(&worker, 2);
+
+        let timestamps: Vec<i64> = std::iter::from_fn(|| worker.pop()).map(|f| f.timestamp_ms).collect();
+        assert_eq!(timestamps, [0, 66]);
+        assert_eq!(worker.stats().dropped, 1);
+    }
+
+    #[test]
+    fn drops_oldest_unpulled_frames_and_counts_errors() {
+        let worker = MjpegWorker::new(Box::new(FakeDecoder { delay: Duration::ZERO }));
+        for i in 0..5 {
+            worker.push(&[2, 2, i as u8], i);
+            wait_for(&worker, i as u64 + 1);
+        }
+        worker.push(&[1], 99);
+        wait_for(&worker, 6);
+
+        let stats = worker.stats();
+        assert_eq!((stats.decoded, stats.errors, stats.dropped), (5, 1, 2));
+        let first = worker.pop().unwrap();
+        assert_eq!((first.width, first.height, first.timestamp_ms), (2, 2, 2));
+        assert_eq!(first.i420, vec![2u8; 6]);
+        worker.recycle(first.i420);
+    }
+
+    #[test]
+    fn decodes_to_limited_range_i420() {
+        let (width, height) = (64, 48);
+        let red: Vec<u8> = [255u8, 0, 0].repeat(width * height);
+        let mut decoder = TurboJpegDecoder::new(false, false).unwrap();
+        let mut out = Vec::new();
+        for subsamp in [tj::TJSAMP_422, tj::TJSAMP_420, tj::TJSAMP_444] {
+            let jpeg = encode(&red, width, height, subsamp);
+            assert_eq!(decoder.decode(&jpeg, &mut out).unwrap(), (width, height));
+            assert_eq!(out.len(), i420_len(width, height));
+            let luma = width * height;
+            for (value, expected) in [(out[luma / 2], 81), (out[luma + 100], 90), (out[luma + luma / 4 + 100], 240)] {
+                assert!((value as i32 - expected).abs() <= 2, "{} vs {}", value, expected);
+            }
+        }
+        assert!(decoder.decode(&[0xff, 0xd8, 0, 0], &mut out).is_err());
+    }
+
+    /// Synthetic camera picture: smooth gradients, some edges and a little
+    /// sensor noise, compressing to roughly what webcams send
+    fn camera_frame(width: usize, height: usize, frame: usize) -> Vec<u8> {
+        let mut rgb = vec![0u8; width * height * 3];
+        let mut noise = 0x9e37_79b9u32 ^ frame as u32;
+        for y in 0..height {
+            for x in 0..width {
+                noise ^= noise << 13;
+                noise ^= noise >> 17;
+                noise ^= noise << 5;
+                let grain = (noise & 3) as u8;
+                let edge = if ((x + frame * 4) / 96 + y / 96) % 2 == 0 { 40 } else { 0 };
+                let p = (y * width + x) * 3;
+                rgb[p] = (x * 200 / width) as u8 + edge + grain;
+                rgb[p + 1] = (y * 200 / height) as u8 + grain;
+                rgb[p + 2] = 120 + edge / 2 + grain;
+            }
+        }
+        rgb
+    }
+
+    fn encode(rgb: &[u8], width: usize, height: usize, subsamp: c_int) -> Vec<u8> {
+        unsafe {
+            let handle = tj::tjInitCompress();
+            let mut jpeg: *mut u8 = std::ptr::null_mut();
+            let mut size = 0;
+            let ok = tj::tjCompress2(
+                handle,
+                rgb.as_ptr(),
+                width as c_int,
+                0,
+                height as c_int,
+                tj::TJPF_RGB,
+                &mut jpeg,
+                &mut size,
+                subsamp,
+                85,
+                0,
+            );
+            assert_eq!(ok, 0);
+            let out = std::slice::from_raw_parts(jpeg, size as usize).to_vec();
+            tj::tjFree(jpeg);
+            tj::tjDestroy(handle);
+            out
+        }
+    }
+
+    /// Run with:
+    ///   cargo test --release --features mjpeg bench_decode_per_frame -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_decode_per_frame() {
+        const FRAMES: usize = 60;
+        for (width, height) in [(1280, 720), (1920, 1080)] {
+            for (name, subsamp) in [("4:2:2", tj::TJSAMP_422), ("4:2:0", tj::TJSAMP_420)] {
+                let jpegs: Vec<Vec<u8>> = (0..FRAMES)
+                    .map(|i| encode(&camera_frame(width, height, i), width, height, subsamp))
+                    .collect();
+                let average_kb = jpegs.iter().map(Vec::len).sum::<usize>() / FRAMES / 1024;
+
+                for fast_dct in [false, true] {
+                    let mut decoder = TurboJpegDecoder::new(fast_dct, false).unwrap();
+                    let mut out = Vec::new();
+                    decoder.decode(&jpegs[0], &mut out).unwrap();
+                    let start = Instant::now();
+                    for jpeg in &jpegs {
+                        assert_eq!(decoder.decode(jpeg, &mut out).unwrap(), (width, height));
+                    }
+                    let per_frame = start.elapsed() / FRAMES as u32;
+                    println!(
+                        "{}x{} {} ({} KB/frame){}: {:.2}ms/frame to I420, {:.0} fps per core",
+                        width,
+                        height,
+                        name,
+                        average_kb,
+                        if fast_dct { " fast IDCT" } else { "" },
+                        per_frame.as_secs_f64() * 1000.0,
+                        1.0 / per_frame.as_secs_f64()
+                    );
+                }
+            }
+        }
+    }
+}
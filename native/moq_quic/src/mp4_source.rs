@@ -0,0 +1,994 @@
+// MP4 file source for the file publisher
+//
+// Opens a progressive (non-fragmented) MP4, maps it read-only and builds a
+// flat sample table per track from the `stbl` boxes. Sample payloads are
+// never copied: callers get the mapping's base address and each sample's
+// offset and size, and read the bytes straight out of the page cache.
+//
+// - Only the `moov` box is parsed up front; `mdat` is touched when a sample
+//   is read
+// - Timestamps are converted to microseconds, with the first edit list
+//   entry's media time removed so presentation starts at zero
+// - Fragmented files (`moof`) are rejected; remux them with
+//   `ffmpeg -movflags +faststart` first
+
+use std::fs::File;
+use std::os::raw::{c_char, c_int};
+use std::path::Path;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+
+/// Sample flag: sync sample (keyframe)
+pub const SAMPLE_SYNC: u32 = 1;
+
+/// One sample of a track (mirrors the 32-byte records read in Dart)
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct Mp4Sample {
+    /// Byte offset in the file
+    pub offset: u64,
+    pub size: u32,
+    /// `SAMPLE_SYNC` when the sample is a keyframe
+    pub flags: u32,
+    /// Decode timestamp in microseconds
+    pub dts: i64,
+    /// Presentation timestamp in microseconds
+    pub pts: i64,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(i32)]
+pub enum TrackKind {
+    Video = 0,
+    Audio = 1,
+    Other = 2,
+}
+
+/// A track's sample description and sample table
+#[derive(Debug, Clone)]
+pub struct Mp4Track {
+    pub track_id: u32,
+    pub kind: TrackKind,
+    /// Sample entry type, e.g. `avc1`, `mp4a`, `Opus`
+    pub fourcc: [u8; 4],
+    pub timescale: u32,
+    /// Media duration in microseconds
+    pub duration_us: i64,
+    pub width: u16,
+    pub height: u16,
+    pub sample_rate: u32,
+    pub channels: u16,
+    /// `avcC` body, AudioSpecificConfig from `esds`, or `dOps` body
+    pub codec_config: Vec<u8>,
+    pub samples: Vec<Mp4Sample>,
+}
+
+/// Backing bytes of an opened file
+enum Mapping {
+    #[cfg(target_os = "linux")]
+    Mapped { ptr: *mut libc::c_void, len: usize },
+    Owned(Vec<u8>),
+}
+
+// The mapping is read-only and never remapped
+unsafe impl Send for Mapping {}
+unsafe impl Sync for Mapping {}
+
+impl Mapping {
+    fn open(path: &Path) -> std::io::Result<Self> {
+        #[cfg(target_os = "linux")]
+        {
+            use std::os::unix::io::AsRawFd;
+            let file = File::open(path)?;
+            let len = file.metadata()?.len() as usize;
+            if len == 0 {
+                return Ok(Mapping::Owned(Vec::new()));
+            }
+            let ptr = unsafe {
+                libc::mmap(
+                    std::ptr::null_mut(),
+                    len,
+                    libc::PROT_READ,
+                    libc::MAP_PRIVATE,
+                    file.as_raw_fd(),
+                    0,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return Err(std::io::Error::last_os_error());
+            }
+            Ok(Mapping::Mapped { ptr, len })
+        }
+        #[cfg(not(target_os = "linux"))]
+        {
+            Ok(Mapping::Owned(std::fs::read(path)?))
+        }
+    }
+
+    fn bytes(&self) -> &[u8] {
+        match self {
+            #[cfg(target_os = "linux")]
+            Mapping::Mapped { ptr, len } => unsafe {
+                std::slice::from_raw_parts(*ptr as *const u8, *len)
+            },
+            Mapping::Owned(data) => data,
+        }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        #[cfg(target_os = "linux")]
+        if let Mapping::Mapped { ptr, len } = self {
+            unsafe {
+                libc::munmap(*ptr, *len);
+            }
+        }
+    }
+}
+
+/// An opened MP4 file
+pub struct Mp4File {
+    mapping: Mapping,
+    pub tracks: Vec<Mp4Track>,
+}
+
+impl Mp4File {
+    /// Map `path` and parse its sample tables
+    pub fn open(path: &Path) -> Result<Self, String> {
+        let mapping = Mapping::open(path).map_err(|e| format!("{}: {}", path.display(), e))?;
+        let tracks = parse(mapping.bytes())?;
+        Ok(Self { mapping, tracks })
+    }
+
+    /// Parse an in-memory file
+    pub fn from_bytes(data: Vec<u8>) -> Result<Self, String> {
+        let tracks = parse(&data)?;
+        Ok(Self { mapping: Mapping::Owned(data), tracks })
+    }
+
+    /// The whole file; samples are `data()[offset..offset + size]`
+    pub fn data(&self) -> &[u8] {
+        self.mapping.bytes()
+    }
+
+    /// Payload of one sample
+    pub fn sample_data(&self, sample: &Mp4Sample) -> &[u8] {
+        let start = sample.offset as usize;
+        &self.data()[start..start + sample.size as usize]
+    }
+}
+
+// Box reading
+
+fn be16(b: &[u8], at: usize) -> Result<u16, String> {
+    b.get(at..at + 2)
+        .map(|s| u16::from_be_bytes([s[0], s[1]]))
+        .ok_or_else(|| "truncated box".to_string())
+}
+
+fn be32(b: &[u8], at: usize) -> Result<u32, String> {
+    b.get(at..at + 4)
+        .map(|s| u32::from_be_bytes([s[0], s[1], s[2], s[3]]))
+        .ok_or_else(|| "truncated box".to_string())
+}
+
+fn be64(b: &[u8], at: usize) -> Result<u64, String> {
+    b.get(at..at + 8)
+        .map(|s| u64::from_be_bytes(s.try_into().unwrap()))
+        .ok_or_else(|| "truncated box".to_string())
+}
+
+/// Child boxes of `data` as (type, body)
+fn boxes(data: &[u8]) -> Result<Vec<([u8; 4], &[u8])>, String> {
+    let mut out = Vec::new();
+    let mut pos = 0;
+    while pos + 8 <= data.len() {
+        let size32 = be32(data, pos)? as u64;
+        let kind: [u8; 4] = data[pos + 4..pos + 8].try_into().unwrap();
+        let (header, size) = match size32 {
+            0 => (8, (data.len() - pos) as u64),
+            1 => (16, be64(data, pos + 8)?),
+            n => (8, n),
+        };
+        if size < header as u64 || size > (data.len() - pos) as u64 {
+            return Err(format!("bad size for box {}", String::from_utf8_lossy(&kind)));
+        }
+        out.push((kind, &data[pos + header..pos + size as usize]));
+        pos += size as usize;
+    }
+    Ok(out)
+}
+
+fn child<'a>(data: &'a [u8], kind: &[u8; 4]) -> Result<Option<&'a [u8]>, String> {
+    Ok(boxes(data)?.into_iter().find(|(k, _)| k == kind).map(|(_, body)| body))
+}
+
+fn require<'a>(data: &'a [u8], kind: &[u8; 4]) -> Result<&'a [u8], String> {
+    child(data, kind)?.ok_or_else(|| format!("missing {} box", String::from_utf8_lossy(kind)))
+}
+
+fn parse(data: &[u8]) -> Result<Vec<Mp4Track>, String> {
+    let top = boxes(data)?;
+    if top.iter().any(|(k, _)| k == b"moof") {
+        return Err("fragmented MP4 is not supported".into());
+    }
+    let moov = top
+        .iter()
+        .find(|(k, _)| k == b"moov")
+        .map(|(_, body)| *body)
+        .ok_or("missing moov box")?;
+
+    let mut tracks = Vec::new();
+    for (kind, trak) in boxes(moov)? {
+        if &kind == b"trak" {
+            let track = parse_trak(trak, data.len() as u64)?;
+            let end = track.samples.iter().map(|s| s.offset + s.size as u64).max().unwrap_or(0);
+            if end > data.len() as u64 {
+                return Err(format!("track {} samples run past the end of the file", track.track_id));
+            }
+            tracks.push(track);
+        }
+    }
+    if tracks.is_empty() {
+        return Err("no tracks".into());
+    }
+    Ok(tracks)
+}
+
+fn parse_trak(trak: &[u8], file_len: u64) -> Result<Mp4Track, String> {
+    let tkhd = require(trak, b"tkhd")?;
+    let track_id = be32(tkhd, if tkhd.first() == Some(&1) { 20 } else { 12 })?;
+
+    let mdia = require(trak, b"mdia")?;
+    let mdhd = require(mdia, b"mdhd")?;
+    let (timescale, duration) = if mdhd.first() == Some(&1) {
+        (be32(mdhd, 20)?, be64(mdhd, 24)?)
+    } else {
+        (be32(mdhd, 12)?, be32(mdhd, 16)? as u64)
+    };
+    if timescale == 0 {
+        return Err(format!("track {} has a zero timescale", track_id));
+    }
+
+    let hdlr = require(mdia, b"hdlr")?;
+    let kind = match hdlr.get(8..12) {
+        Some(b"vide") => TrackKind::Video,
+        Some(b"soun") => TrackKind::Audio,
+        _ => TrackKind::Other,
+    };
+
+    let stbl = require(require(mdia, b"minf")?, b"stbl")?;
+    let mut track = Mp4Track {
+        track_id,
+        kind,
+        fourcc: [0; 4],
+        timescale,
+        duration_us: to_us(duration as i64, timescale),
+        width: 0,
+        height: 0,
+        sample_rate: 0,
+        channels: 0,
+        codec_config: Vec::new(),
+        samples: Vec::new(),
+    };
+    parse_stsd(require(stbl, b"stsd")?, &mut track)?;
+
+    let media_time = child(trak, b"edts")?
+        .map(|edts| first_media_time(edts))
+        .transpose()?
+        .flatten()
+        .unwrap_or(0);
+    track.samples = sample_table(stbl, timescale, media_time, file_len)?;
+    Ok(track)
+}
+
+fn to_us(value: i64, timescale: u32) -> i64 {
+    (value as i128 * 1_000_000 / timescale as i128) as i64
+}
+
+fn parse_stsd(stsd: &[u8], track: &mut Mp4Track) -> Result<(), String> {
+    // Version/flags and entry count, then the first sample entry
+    let entries = boxes(stsd.get(8..).ok_or("truncated stsd")?)?;
+    let (fourcc, entry) = *entries.first().ok_or("empty stsd")?;
+    track.fourcc = fourcc;
+
+    match track.kind {
+        TrackKind::Video => {
+            // SampleEntry (8) + VisualSampleEntry fields (70)
+            track.width = be16(entry, 24)?;
+            track.height = be16(entry, 26)?;
+            let children = entry.get(78..).ok_or("truncated visual sample entry")?;
+            if let Some(config) = child(children, b"avcC")?.or(child(children, b"hvcC")?) {
+                track.codec_config = config.to_vec();
+            }
+        }
+        TrackKind::Audio => {
+            // QuickTime sound description versions 1 and 2 add fields
+            let extra = match be16(entry, 8)? {
+                1 => 16,
+                2 => 36,
+                _ => 0,
+            };
+            track.channels = be16(entry, 16)?;
+            track.sample_rate = be32(entry, 24)? >> 16;
+            let children = entry.get(28 + extra..).ok_or("truncated audio sample entry")?;
+            if let Some(esds) = child(children, b"esds")? {
+                track.codec_config = audio_specific_config(esds)?;
+            } else if let Some(dops) = child(children, b"dOps")? {
+                track.codec_config = dops.to_vec();
+                // The Opus decoder always runs at 48kHz
+                track.sample_rate = 48000;
+            }
+        }
+        TrackKind::Other => {}
+    }
+    Ok(())
+}
+
+/// DecoderSpecificInfo (the AudioSpecificConfig for AAC) from an `esds` body
+fn audio_specific_config(esds: &[u8]) -> Result<Vec<u8>, String> {
+    // Descriptor: tag byte, then a length of up to four 7-bit groups
+    fn descriptor(b: &[u8], pos: usize) -> Result<(u8, usize, usize), String> {
+        let tag = *b.get(pos).ok_or("truncated esds")?;
+        let mut len = 0usize;
+        let mut at = pos + 1;
+        for _ in 0..4 {
+            let byte = *b.get(at).ok_or("truncated esds")?;
+            at += 1;
+            len = (len << 7) | (byte & 0x7F) as usize;
+            if byte & 0x80 == 0 {
+                break;
+            }
+        }
+        Ok((tag, at, len))
+    }
+
+    let (tag, mut pos, _) = descriptor(esds, 4)?;
+    if tag != 0x03 {
+        return Err("esds without ES_Descriptor".into());
+    }
+    let flags = *esds.get(pos + 2).ok_or("truncated esds")?;
+    pos += 3;
+    if flags & 0x80 != 0 {
+        pos += 2;
+    }
+    if flags & 0x40 != 0 {
+        pos += 1 + *esds.get(pos).ok_or("truncated esds")? as usize;
+    }
+    if flags & 0x20 != 0 {
+        pos += 2;
+    }
+    let (tag, pos, _) = descriptor(esds, pos)?;
+    if tag != 0x04 {
+        return Err("esds without DecoderConfigDescriptor".into());
+    }
+    let (tag, pos, len) = descriptor(esds, pos + 13)?;
+    if tag != 0x05 {
+        return Ok(Vec::new());
+    }
+    esds.get(pos..pos + len).map(<[u8]>::to_vec).ok_or_else(|| "truncated esds".into())
+}
+
+/// Media time of the first non-empty edit, in track timescale
+fn first_media_time(edts: &[u8]) -> Result<Option<i64>, String> {
+    let Some(elst) = child(edts, b"elst")? else { return Ok(None) };
+    let version = elst.first().copied().unwrap_or(0);
+    let count = be32(elst, 4)? as usize;
+    let entry_size = if version == 1 { 20 } else { 12 };
+    for i in 0..count {
+        let at = 8 + i * entry_size;
+        let media_time = if version == 1 {
+            be64(elst, at + 8)? as i64
+        } else {
+            be32(elst, at + 4)? as i32 as i64
+        };
+        // -1 marks an empty edit (a presentation gap)
+        if media_time >= 0 {
+            return Ok(Some(media_time));
+        }
+    }
+    Ok(None)
+}
+
+/// Flatten stsz/stco/stsc/stts/ctts/stss into one record per sample
+///
+/// Counts come from the file, so every allocation is bounded by the box or
+/// file size they describe.
+fn sample_table(stbl: &[u8], timescale: u32, media_time: i64, file_len: u64) -> Result<Vec<Mp4Sample>, String> {
+    let stsz = require(stbl, b"stsz")?;
+    let constant_size = be32(stsz, 4)?;
+    let count = be32(stsz, 8)? as usize;
+    if constant_size == 0 && (stsz.len() as u64) < 12 + count as u64 * 4 {
+        return Err("truncated stsz".into());
+    }
+    // Samples of a constant size must all fit in the file
+    if constant_size != 0 && count as u64 * constant_size as u64 > file_len {
+        return Err("stsz sample count exceeds the file".into());
+    }
+    let mut samples = Vec::new();
+    samples.try_reserve_exact(count).map_err(|_| "too many samples".to_string())?;
+    for i in 0..count {
+        let size = if constant_size != 0 { constant_size } else { be32(stsz, 12 + i * 4)? };
+        samples.push(Mp4Sample { size, ..Default::default() });
+    }
+    if count == 0 {
+        return Ok(samples);
+    }
+
+    // Chunk offsets
+    let chunk_offsets: Vec<u64> = if let Some(stco) = child(stbl, b"stco")? {
+        (0..be32(stco, 4)? as usize)
+            .map(|i| be32(stco, 8 + i * 4).map(u64::from))
+            .collect::<Result<_, _>>()?
+    } else {
+        let co64 = require(stbl, b"co64")?;
+        (0..be32(co64, 4)? as usize)
+            .map(|i| be64(co64, 8 + i * 8))
+            .collect::<Result<_, _>>()?
+    };
+
+    // Samples per chunk: runs of (first chunk, samples per chunk)
+    let stsc = require(stbl, b"stsc")?;
+    let runs = be32(stsc, 4)? as usize;
+    let mut sample = 0;
+    for run in 0..runs {
+        let first = be32(stsc, 8 + run * 12)? as usize;
+        let per_chunk = be32(stsc, 12 + run * 12)? as usize;
+        let end = if run + 1 < runs {
+            be32(stsc, 8 + (run + 1) * 12)? as usize
+        } else {
+            chunk_offsets.len() + 1
+        };
+        if first == 0 || end < first || end > chunk_offsets.len() + 1 {
+            return Err("bad stsc".into());
+        }
+        for chunk in first..end {
+            let mut offset = chunk_offsets[chunk - 1];
+            for _ in 0..per_chunk {
+                let Some(s) = samples.get_mut(sample) else { break };
+                s.offset = offset;
+                offset = offset.checked_add(s.size as u64).ok_or("bad chunk offset")?;
+                sample += 1;
+            }
+        }
+    }
+    if sample != count {
+        return Err(format!("stsc covers {} of {} samples", sample, count));
+    }
+
+    // Decode times
+    let stts = require(stbl, b"stts")?;
+    let mut dts = 0i64;
+    let mut dts_list = Vec::with_capacity(count);
+    for run in 0..be32(stts, 4)? as usize {
+        if dts_list.len() == count {
+            break;
+        }
+        let run_count = be32(stts, 8 + run * 8)? as usize;
+        let delta = be32(stts, 12 + run * 8)? as i64;
+        for _ in 0..run_count.min(count - dts_list.len()) {
+            dts_list.push(dts);
+            dts += delta;
+        }
+    }
+    if dts_list.len() < count {
+        return Err(format!("stts covers {} of {} samples", dts_list.len(), count));
+    }
+
+    // Composition offsets (signed in version 1, and in practice in version 0)
+    let mut cts_offsets = vec![0i64; count];
+    if let Some(ctts) = child(stbl, b"ctts")? {
+        let mut i = 0;
+        for run in 0..be32(ctts, 4)? as usize {
+            if i == count {
+                break;
+            }
+            let run_count = be32(ctts, 8 + run * 8)? as usize;
+            let offset = be32(ctts, 12 + run * 8)? as i32 as i64;
+            for _ in 0..run_count.min(count - i) {
+                cts_offsets[i] = offset;
+                i += 1;
+            }
+        }
+    }
+
+    for (i, s) in samples.iter_mut().enumerate() {
+        s.dts = to_us(dts_list[i] - media_time, timescale);
+        s.pts = to_us(dts_list[i] + cts_offsets[i] - media_time, timescale);
+    }
+
+    // Sync samples; every sample is sync without an stss box
+    match child(stbl, b"stss")? {
+        Some(stss) => {
+            for i in 0..be32(stss, 4)? as usize {
+                let number = be32(stss, 8 + i * 4)? as usize;
+                if let Some(s) = number.checked_sub(1).and_then(|n| samples.get_mut(n)) {
+                    s.flags |= SAMPLE_SYNC;
+                }
+            }
+        }
+        None => samples.iter_mut().for_each(|s| s.flags |= SAMPLE_SYNC),
+    }
+    Ok(samples)
+}
+
+// Global file registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static MP4_SOURCES: Lazy<DashMap<u64, Arc<Mp4File>>> = Lazy::new(|| DashMap::new());
+static NEXT_MP4_ID: AtomicU64 = AtomicU64::new(1);
+
+fn track(source_id: u64, index: c_int) -> Option<(Arc<Mp4File>, usize)> {
+    let file = MP4_SOURCES.get(&source_id)?.clone();
+    let index = usize::try_from(index).ok().filter(|&i| i < file.tracks.len())?;
+    Some((file, index))
+}
+
+// FFI Functions
+
+/// Number of values written by `mp4_source_track_info`
+pub const TRACK_INFO_VALUES: usize = 11;
+
+/// Open and map an MP4 file
+///
+/// # Returns
+/// Source ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn mp4_source_open(path: *const c_char) -> u64 {
+    if path.is_null() {
+        return 0;
+    }
+    let path = unsafe { std::ffi::CStr::from_ptr(path) }.to_string_lossy().into_owned();
+    match Mp4File::open(Path::new(&path)) {
+        Ok(file) => {
+            let id = NEXT_MP4_ID.fetch_add(1, Ordering::Relaxed);
+            log::info!(
+                "Opened MP4 source {} ({}, {} tracks, {} bytes)",
+                id,
+                path,
+                file.tracks.len(),
+                file.data().len()
+            );
+            MP4_SOURCES.insert(id, Arc::new(file));
+            id
+        }
+        Err(e) => {
+            log::error!("Failed to open MP4 source {}: {}", path, e);
+            0
+        }
+    }
+}
+
+/// Close a source and unmap its file
+///
+/// Pointers returned for the source are invalid afterwards.
+#[no_mangle]
+pub extern "C" fn mp4_source_close(source_id: u64) {
+    if MP4_SOURCES.remove(&source_id).is_some() {
+        log::info!("Closed MP4 source {}", source_id);
+    }
+}
+
+/// Base address and length of the file's bytes
+///
+/// # Returns
+/// Pointer valid until `mp4_source_close`, or null if the source does not
+/// exist
+#[no_mangle]
+pub extern "C" fn mp4_source_data(source_id: u64, out_len: *mut usize) -> *const u8 {
+    let Some(file) = MP4_SOURCES.get(&source_id) else { return std::ptr::null() };
+    if !out_len.is_null() {
+        unsafe { *out_len = file.data().len() };
+    }
+    file.data().as_ptr()
+}
+
+/// Number of tracks, or -1 if the source does not exist
+#[no_mangle]
+pub extern "C" fn mp4_source_track_count(source_id: u64) -> c_int {
+    MP4_SOURCES.get(&source_id).map_or(-1, |file| file.tracks.len() as c_int)
+}
+
+/// Describe a track
+///
+/// Values, in order: track ID, kind (0 video, 1 audio, 2 other), sample
+/// entry fourcc (big-endian), timescale, duration (µs), sample count, width,
+/// height, sample rate, channels, codec config length.
+///
+/// # Returns
+/// Number of values written, or -1 if the track does not exist
+#[no_mangle]
+pub extern "C" fn mp4_source_track_info(
+    source_id: u64,
+    index: c_int,
+    out: *mut i64,
+    len: usize,
+) -> c_int {
+    if out.is_null() {
+        return -1;
+    }
+    let Some((file, index)) = track(source_id, index) else { return -1 };
+    let t = &file.tracks[index];
+    let values = [
+        t.track_id as i64,
+        t.kind as i64,
+        u32::from_be_bytes(t.fourcc) as i64,
+        t.timescale as i64,
+        t.duration_us,
+        t.samples.len() as i64,
+        t.width as i64,
+        t.height as i64,
+        t.sample_rate as i64,
+        t.channels as i64,
+        t.codec_config.len() as i64,
+    ];
+    let count = values.len().min(len);
+    unsafe { std::slice::from_raw_parts_mut(out, count) }.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+/// A track's codec configuration (`avcC`, AudioSpecificConfig or `dOps`)
+///
+/// # Returns
+/// Pointer valid until `mp4_source_close`, or null if the track does not
+/// exist
+#[no_mangle]
+pub extern "C" fn mp4_source_codec_config(
+    source_id: u64,
+    index: c_int,
+    out_len: *mut usize,
+) -> *const u8 {
+    let Some((file, index)) = track(source_id, index) else { return std::ptr::null() };
+    let config = &file.tracks[index].codec_config;
+    if !out_len.is_null() {
+        unsafe { *out_len = config.len() };
+    }
+    config.as_ptr()
+}
+
+/// A track's sample table as `Mp4Sample` records
+///
+/// # Returns
+/// Pointer valid until `mp4_source_close`, or null if the track does not
+/// exist
+#[no_mangle]
+pub extern "C" fn mp4_source_samples(
+    source_id: u64,
+    index: c_int,
+    out_count: *mut usize,
+) -> *const Mp4Sample {
+    let Some((file, index)) = track(source_id, index) else { return std::ptr::null() };
+    let samples = &file.tracks[index].samples;
+    if !out_count.is_null() {
+        unsafe { *out_count = samples.len() };
+    }
+    samples.as_ptr()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    fn bx(kind: &[u8; 4], body: &[u8]) -> Vec<u8> {
+        let mut out = ((body.len() + 8) as u32).to_be_bytes().to_vec();
+        out.extend_from_slice(kind);
+        out.extend_from_slice(body);
+        out
+    }
+
+    fn full(kind: &[u8; 4], version: u8, body: &[u8]) -> Vec<u8> {
+        let mut b = vec![version, 0, 0, 0];
+        b.extend_from_slice(body);
+        bx(kind, &b)
+    }
+
+    fn table(kind: &[u8; 4], entries: &[&[u32]]) -> Vec<u8> {
+        let mut b = (entries.len() as u32).to_be_bytes().to_vec();
+        for entry in entries {
+            for v in *entry {
+                b.extend_from_slice(&v.to_be_bytes());
+            }
+        }
+        full(kind, 0, &b)
+    }
+
+    fn trak(track_id: u32, handler: &[u8; 4], timescale: u32, stsd_entry: Vec<u8>, stbl: Vec<u8>, edts: Option<Vec<u8>>) -> Vec<u8> {
+        let mut tkhd = vec![0u8; 80];
+        tkhd[8..12].copy_from_slice(&track_id.to_be_bytes());
+        let mut mdhd = vec![0u8; 20];
+        mdhd[8..12].copy_from_slice(&timescale.to_be_bytes());
+        mdhd[12..16].copy_from_slice(&(timescale * 10).to_be_bytes());
+        let mut hdlr = vec![0u8; 20];
+        hdlr[4..8].copy_from_slice(handler);
+
+        let mut stsd = 1u32.to_be_bytes().to_vec();
+        stsd.extend_from_slice(&stsd_entry);
+        let mut stbl_body = full(b"stsd", 0, &stsd);
+        stbl_body.extend_from_slice(&stbl);
+
+        let minf = bx(b"minf", &bx(b"stbl", &stbl_body));
+        let mdia = bx(b"mdia", &[full(b"mdhd", 0, &mdhd), full(b"hdlr", 0, &hdlr), minf].concat());
+        let mut body = full(b"tkhd", 0, &tkhd);
+        if let Some(edts) = edts {
+            body.extend_from_slice(&edts);
+        }
+        body.extend_from_slice(&mdia);
+        bx(b"trak", &body)
+    }
+
+    fn avc1(width: u16, height: u16, avcc: &[u8]) -> Vec<u8> {
+        let mut entry = vec![0u8; 78];
+        entry[24..26].copy_from_slice(&width.to_be_bytes());
+        entry[26..28].copy_from_slice(&height.to_be_bytes());
+        entry.extend_from_slice(&bx(b"avcC", avcc));
+        bx(b"avc1", &entry)
+    }
+
+    fn mp4a(sample_rate: u32, channels: u16, asc: &[u8]) -> Vec<u8> {
+        let mut entry = vec![0u8; 28];
+        entry[16..18].copy_from_slice(&channels.to_be_bytes());
+        entry[18..20].copy_from_slice(&16u16.to_be_bytes());
+        entry[24..28].copy_from_slice(&(sample_rate << 16).to_be_bytes());
+        // ES_Descriptor > DecoderConfigDescriptor > DecoderSpecificInfo,
+        // lengths in the 4-byte form some muxers write
+        let mut dsi = vec![0x05, 0x80, 0x80, 0x80, asc.len() as u8];
+        dsi.extend_from_slice(asc);
+        let mut dcd = vec![0x04, 0x80, 0x80, 0x80, (13 + dsi.len()) as u8, 0x40, 0x15];
+        dcd.extend_from_slice(&[0; 11]);
+        dcd.extend_from_slice(&dsi);
+        let mut es = vec![0x03, (3 + dcd.len()) as u8, 0x00, 0x01, 0x00];
+        es.extend_from_slice(&dcd);
+        entry.extend_from_slice(&full(b"esds", 0, &es));
+        bx(b"mp4a", &entry)
+    }
+
+    const AVCC: [u8; 7] = [1, 0x64, 0x00, 0x1F, 0xFF, 0xE0, 0x00];
+    const ASC: [u8; 2] = [0x12, 0x10];
+
+    /// ftyp + mdat + moov with a 4-frame video track (IPBB-style ctts, edit
+    /// list) and a 3-frame audio track using co64
+    fn sample_file() -> (Vec<u8>, Vec<Vec<u8>>, Vec<Vec<u8>>) {
+        let video: Vec<Vec<u8>> = (0..4).map(|i| vec![0x10 + i as u8; 100 + i * 10]).collect();
+        let audio: Vec<Vec<u8>> = (0..3).map(|i| vec![0xA0 + i as u8; 20 + i]).collect();
+
+        let ftyp = bx(b"ftyp", b"isom\0\0\0\0isomavc1");
+        // Chunks: video [0, 1], audio [0, 1, 2], video [2, 3]
+        let mut mdat = Vec::new();
+        let mdat_start = (ftyp.len() + 8) as u32;
+        let chunk = |mdat: &mut Vec<u8>, samples: &[Vec<u8>]| {
+            let at = mdat_start + mdat.len() as u32;
+            for s in samples {
+                mdat.extend_from_slice(s);
+            }
+            at
+        };
+        let v0 = chunk(&mut mdat, &video[..2]);
+        let a0 = chunk(&mut mdat, &audio);
+        let v1 = chunk(&mut mdat, &video[2..]);
+
+        let video_stbl = [
+            table(b"stts", &[&[4, 3000]]),
+            table(b"ctts", &[&[1, 6000], &[1, 0], &[2, 3000]]),
+            table(b"stss", &[&[1]]),
+            table(b"stsc", &[&[1, 2, 1]]),
+            {
+                let mut b = vec![0u8; 4];
+                b.extend_from_slice(&4u32.to_be_bytes());
+                for s in &video {
+                    b.extend_from_slice(&(s.len() as u32).to_be_bytes());
+                }
+                full(b"stsz", 0, &b)
+            },
+            table(b"stco", &[&[v0], &[v1]]),
+        ]
+        .concat();
+        let mut elst = 1u32.to_be_bytes().to_vec();
+        elst.extend_from_slice(&30000u32.to_be_bytes());
+        elst.extend_from_slice(&3000u32.to_be_bytes());
+        elst.extend_from_slice(&[0, 1, 0, 0]);
+        let edts = bx(b"edts", &full(b"elst", 0, &elst));
+
+        let mut co64 = 1u32.to_be_bytes().to_vec();
+        co64.extend_from_slice(&(a0 as u64).to_be_bytes());
+        let audio_stbl = [
+            table(b"stts", &[&[3, 1024]]),
+            table(b"stsc", &[&[1, 3, 1]]),
+            {
+                let mut b = vec![0u8; 4];
+                b.extend_from_slice(&3u32.to_be_bytes());
+                for s in &audio {
+                    b.extend_from_slice(&(s.len() as u32).to_be_bytes());
+                }
+                full(b"stsz", 0, &b)
+            },
+            full(b"co64", 0, &co64),
+        ]
+        .concat();
+
+        let moov = bx(
+            b"moov",
+            &[
+                trak(1, b"vide", 90000, avc1(1280, 720, &AVCC), video_stbl, Some(edts)),
+                trak(2, b"soun", 48000, mp4a(48000, 2, &ASC), audio_stbl, None),
+            ]
+            .concat(),
+        );
+
+        let file = [ftyp, bx(b"mdat", &mdat), moov].concat();
+        (file, video, audio)
+    }
+
+    #[test]
+    fn parses_tracks_and_samples() {
+        let (data, video, audio) = sample_file();
+        let file = Mp4File::from_bytes(data).unwrap();
+        assert_eq!(file.tracks.len(), 2);
+
+        let v = &file.tracks[0];
+        assert_eq!(v.kind, TrackKind::Video);
+        assert_eq!(&v.fourcc, b"avc1");
+        assert_eq!((v.width, v.height), (1280, 720));
+        assert_eq!(v.codec_config, AVCC);
+        assert_eq!(v.duration_us, 10_000_000);
+        assert_eq!(v.samples.len(), 4);
+        for (sample, expected) in v.samples.iter().zip(&video) {
+            assert_eq!(file.sample_data(sample), &expected[..]);
+        }
+        // 3000 ticks at 90kHz = 33333µs; the edit list removes one frame
+        let dts: Vec<i64> = v.samples.iter().map(|s| s.dts).collect();
+        let pts: Vec<i64> = v.samples.iter().map(|s| s.pts).collect();
+        assert_eq!(dts, [-33333, 0, 33333, 66666]);
+        assert_eq!(pts, [33333, 0, 66666, 100000]);
+        let sync: Vec<bool> = v.samples.iter().map(|s| s.flags & SAMPLE_SYNC != 0).collect();
+        assert_eq!(sync, [true, false, false, false]);
+
+        let a = &file.tracks[1];
+        assert_eq!(a.kind, TrackKind::Audio);
+        assert_eq!(&a.fourcc, b"mp4a");
+        assert_eq!((a.sample_rate, a.channels), (48000, 2));
+        assert_eq!(a.codec_config, ASC);
+        for (sample, expected) in a.samples.iter().zip(&audio) {
+            assert_eq!(file.sample_data(sample), &expected[..]);
+            assert_ne!(sample.flags & SAMPLE_SYNC, 0);
+        }
+        let dts: Vec<i64> = a.samples.iter().map(|s| s.dts).collect();
+        assert_eq!(dts, [0, 21333, 42666]);
+    }
+
+    #[test]
+    fn ffi_exposes_mapped_file() {
+        let (data, video, _) = sample_file();
+        let path = std::env::temp_dir().join(format!("mp4_source_{}.mp4", std::process::id()));
+        std::fs::write(&path, &data).unwrap();
+        let c_path = std::ffi::CString::new(path.to_str().unwrap()).unwrap();
+
+        let id = mp4_source_open(c_path.as_ptr());
+        std::fs::remove_file(&path).unwrap();
+        assert_ne!(id, 0);
+        assert_eq!(mp4_source_track_count(id), 2);
+
+        let mut info = [0i64; TRACK_INFO_VALUES];
+        assert_eq!(mp4_source_track_info(id, 0, info.as_mut_ptr(), info.len()), 11);
+        assert_eq!(info[2], u32::from_be_bytes(*b"avc1") as i64);
+        assert_eq!(info[5], 4);
+        assert_eq!(mp4_source_track_info(id, 2, info.as_mut_ptr(), info.len()), -1);
+
+        let mut len = 0usize;
+        let base = mp4_source_data(id, &mut len);
+        assert_eq!(len, data.len());
+        let mut count = 0usize;
+        let samples = mp4_source_samples(id, 0, &mut count);
+        let samples = unsafe { std::slice::from_raw_parts(samples, count) };
+        let first = unsafe { std::slice::from_raw_parts(base.add(samples[0].offset as usize), samples[0].size as usize) };
+        assert_eq!(first, &video[0][..]);
+        assert_eq!(std::mem::size_of::<Mp4Sample>(), 32);
+
+        mp4_source_close(id);
+        assert_eq!(mp4_source_track_count(id), -1);
+    }
+
+    #[test]
+    fn rejects_bad_files() {
+        let (data, _, _) = sample_file();
+        // Missing moov
+        assert!(Mp4File::from_bytes(data[..data.len() / 2].to_vec()).is_err());
+        // Fragmented
+        let mut fragmented = data.clone();
+        fragmented.extend_from_slice(&bx(b"moof", &[]));
+        assert!(Mp4File::from_bytes(fragmented).is_err());
+        // A chunk offset past the end of the file
+        let mut truncated = data.clone();
+        let stco = truncated.windows(4).position(|w| w == b"stco").unwrap();
+        truncated[stco + 12..stco + 16].copy_from_slice(&0x00FF_0000u32.to_be_bytes());
+        assert!(Mp4File::from_bytes(truncated).is_err());
+        assert_eq!(mp4_source_open(std::ptr::null()), 0);
+    }
+
+    #[test]
+    fn bounds_hostile_sample_counts() {
+        let stbl = |count: u32, stts_run: u32| {
+            let stsz = [1u32.to_be_bytes(), count.to_be_bytes()].concat();
+            [
+                table(b"stts", &[&[stts_run, 1]]),
+                table(b"stsc", &[&[1, count, 1]]),
+                full(b"stsz", 0, &stsz),
+                table(b"stco", &[&[0]]),
+            ]
+            .concat()
+        };
+        // Four billion 1-byte samples cannot fit in a 1 MB file
+        assert!(sample_table(&stbl(u32::MAX, u32::MAX), 1000, 0, 1 << 20).is_err());
+        // A huge stts run only fills the samples that exist
+        let samples = sample_table(&stbl(4, u32::MAX), 1000, 0, 1 << 20).unwrap();
+        assert_eq!(samples.len(), 4);
+        assert_eq!(samples[3].dts, 3000);
+    }
+
+    // Time to open a two-hour 30fps + AAC file's sample tables; run with
+    // `cargo test --release --features mp4-source bench_open_two_hours -- --ignored --nocapture`
+    #[test]
+    #[ignore]
+    fn bench_open_two_hours() {
+        let frames = 2 * 3600 * 30u32;
+        let audio_frames = 2 * 3600 * 48000 / 1024u32;
+        let mut stsz = vec![0u8; 4];
+        stsz.extend_from_slice(&frames.to_be_bytes());
+        for i in 0..frames {
+            stsz.extend_from_slice(&(1000 + i % 500).to_be_bytes());
+        }
+        let mut stss_body = (frames / 60).to_be_bytes().to_vec();
+        for i in 0..frames / 60 {
+            stss_body.extend_from_slice(&(i * 60 + 1).to_be_bytes());
+        }
+        let video_chunks: Vec<u32> = (0..frames).map(|i| i * 1500).collect();
+        let mut stco = frames.to_be_bytes().to_vec();
+        for c in &video_chunks {
+            stco.extend_from_slice(&c.to_be_bytes());
+        }
+        let video_stbl = [
+            table(b"stts", &[&[frames, 3000]]),
+            full(b"stss", 0, &stss_body),
+            table(b"stsc", &[&[1, 1, 1]]),
+            full(b"stsz", 0, &stsz),
+            full(b"stco", 0, &stco),
+        ]
+        .concat();
+        let mut astsz = 400u32.to_be_bytes().to_vec();
+        astsz.extend_from_slice(&audio_frames.to_be_bytes());
+        let audio_stbl = [
+            table(b"stts", &[&[audio_frames, 1024]]),
+            table(b"stsc", &[&[1, audio_frames, 1]]),
+            full(b"stsz", 0, &astsz),
+            table(b"stco", &[&[0]]),
+        ]
+        .concat();
+        let moov = bx(
+            b"moov",
+            &[
+                trak(1, b"vide", 90000, avc1(1920, 1080, &AVCC), video_stbl, None),
+                trak(2, b"soun", 48000, mp4a(48000, 2, &ASC), audio_stbl, None),
+            ]
+            .concat(),
+        );
+        // Samples point into a sparse mdat sized to cover them
+        let mdat_len = frames as usize * 1500 + 1500;
+        let mut data = moov;
+        data.extend_from_slice(&((mdat_len + 8) as u32).to_be_bytes());
+        data.extend_from_slice(b"mdat");
+        data.resize(data.len() + mdat_len, 0);
+
+        let start = Instant::now();
+        let file = Mp4File::from_bytes(data).unwrap();
+        let elapsed = start.elapsed();
+        let samples: usize = file.tracks.iter().map(|t| t.samples.len()).sum();
+        println!(
+            "open: {} samples in {:.1}ms ({:.0} ns/sample)",
+            samples,
+            elapsed.as_secs_f64() * 1e3,
+            elapsed.as_nanos() as f64 / samples as f64
+        );
+    }
+}
@@ -0,0 +1,612 @@
+// End-to-end object encryption (SFrame-style, RFC 9605)
+//
+// Payloads are sealed with AES-128-GCM before they are packetized, so relays
+// only ever see ciphertext. ring picks the AES-NI/CLMUL or ARMv8 crypto
+// extension code paths at runtime.
+//
+// Protected payload: SFrame header | ciphertext | 16-byte tag
+// - The header carries the key ID and a counter, and is authenticated as AAD
+// - Each key ID is bound to one track: key and salt are derived from a base
+//   key with HKDF-SHA256 as in RFC 9605 section 4.4.2, with the full track
+//   name appended to the info, and a context refuses to bind a key ID to a
+//   second track. Receivers open a track's objects only with the key ID
+//   they expect for it, so a relay cannot move an object to another track
+// - The counter is derived from the object's location (group << 24 | object),
+//   so nonces never repeat within a track and a relay cannot move an object
+//   to another group/object without failing authentication
+//
+// Group IDs start over when a publisher restarts, so a base key must only
+// ever be used by one publishing session: rotate it (new base key, or a new
+// key ID) whenever a publisher starts, or nonces repeat.
+//
+// Objects are processed in place and in batches, so one FFI call covers all
+// objects packetized or parsed from a stream chunk.
+
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+use ring::aead::{Aad, LessSafeKey, Nonce, UnboundKey, AES_128_GCM, NONCE_LEN};
+use ring::hkdf::{KeyType, Salt, HKDF_SHA256};
+use std::collections::HashMap;
+use std::os::raw::c_int;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, RwLock};
+
+/// AES_128_GCM_SHA256_128
+const CIPHER_SUITE: u16 = 0x0004;
+const KEY_LEN: usize = 16;
+const TAG_LEN: usize = 16;
+
+/// Largest SFrame header: config byte, 8-byte key ID, 8-byte counter
+const MAX_HEADER_LEN: usize = 17;
+
+/// Most bytes protection adds to a payload
+pub const MAX_OVERHEAD: usize = MAX_HEADER_LEN + TAG_LEN;
+
+// Counter layout: objects per group and groups that fit in 64 bits
+const OBJECT_BITS: u32 = 24;
+const MAX_GROUP_ID: u64 = (1 << (64 - OBJECT_BITS)) - 1;
+
+/// Protection errors, as returned over FFI
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CryptoError {
+    UnknownKey = -2,
+    BufferTooSmall = -3,
+    AuthenticationFailed = -4,
+    /// Object location does not fit the counter, or does not match it
+    BadCounter = -5,
+    BadHeader = -6,
+    /// Header key ID is not the one expected for the track
+    WrongKey = -7,
+}
+
+/// Counter of the object at `group_id`/`object_id`
+pub fn object_counter(group_id: u64, object_id: u64) -> Result<u64, CryptoError> {
+    if group_id > MAX_GROUP_ID || object_id >= 1 << OBJECT_BITS {
+        return Err(CryptoError::BadCounter);
+    }
+    Ok(group_id << OBJECT_BITS | object_id)
+}
+
+// Big-endian value in the fewest bytes (at least one)
+fn min_len(value: u64) -> usize {
+    (8 - value.leading_zeros() as usize / 8).max(1)
+}
+
+/// Write the SFrame header for `key_id` and `counter`; returns its length
+fn write_header(out: &mut [u8], key_id: u64, counter: u64) -> usize {
+    let mut len = 1;
+    let mut config = 0u8;
+    if key_id < 8 {
+        config |= (key_id as u8) << 4;
+    } else {
+        let n = min_len(key_id);
+        config |= 0x80 | ((n as u8 - 1) << 4);
+        out[len..len + n].copy_from_slice(&key_id.to_be_bytes()[8 - n..]);
+        len += n;
+    }
+    if counter < 8 {
+        config |= counter as u8;
+    } else {
+        let n = min_len(counter);
+        config |= 0x08 | (n as u8 - 1);
+        out[len..len + n].copy_from_slice(&counter.to_be_bytes()[8 - n..]);
+        len += n;
+    }
+    out[0] = config;
+    len
+}
+
+/// Parse an SFrame header into (key ID, counter, header length)
+fn read_header(data: &[u8]) -> Result<(u64, u64, usize), CryptoError> {
+    let config = *data.first().ok_or(CryptoError::BadHeader)?;
+    let mut offset = 1;
+    let mut field = |extended: bool, value: u8| -> Result<u64, CryptoError> {
+        if !extended {
+            return Ok(value as u64);
+        }
+        let n = value as usize + 1;
+        let bytes = data.get(offset..offset + n).ok_or(CryptoError::BadHeader)?;
+        offset += n;
+        Ok(bytes.iter().fold(0u64, |acc, &b| acc << 8 | b as u64))
+    };
+    let key_id = field(config & 0x80 != 0, (config >> 4) & 0x07)?;
+    let counter = field(config & 0x08 != 0, config & 0x07)?;
+    Ok((key_id, counter, offset))
+}
+
+struct Len(usize);
+
+impl KeyType for Len {
+    fn len(&self) -> usize {
+        self.0
+    }
+}
+
+/// AEAD key and nonce salt of one key ID, and the track it is bound to
+struct TrackKey {
+    key: LessSafeKey,
+    salt: [u8; NONCE_LEN],
+    track: Vec<u8>,
+}
+
+impl TrackKey {
+    fn derive(key_id: u64, track: &[u8], base_key: &[u8]) -> Option<Self> {
+        let secret = Salt::new(HKDF_SHA256, &[]).extract(base_key);
+        let suffix = [&key_id.to_be_bytes()[..], &CIPHER_SUITE.to_be_bytes()[..], track].concat();
+
+        let mut key = [0u8; KEY_LEN];
+        secret
+            .expand(&[b"SFrame 1.0 Secret key ", &suffix], Len(KEY_LEN))
+            .ok()?
+            .fill(&mut key)
+            .ok()?;
+        let mut salt = [0u8; NONCE_LEN];
+        secret
+            .expand(&[b"SFrame 1.0 Secret salt ", &suffix], Len(NONCE_LEN))
+            .ok()?
+            .fill(&mut salt)
+            .ok()?;
+
+        Some(Self {
+            key: LessSafeKey::new(UnboundKey::new(&AES_128_GCM, &key).ok()?),
+            salt,
+            track: track.to_vec(),
+        })
+    }
+
+    fn nonce(&self, counter: u64) -> Nonce {
+        let mut nonce = self.salt;
+        for (n, c) in nonce[NONCE_LEN - 8..].iter_mut().zip(counter.to_be_bytes()) {
+            *n ^= c;
+        }
+        Nonce::assume_unique_for_key(nonce)
+    }
+}
+
+/// One object in a batch, processed in place
+pub struct ObjectBuffer<'a> {
+    pub group_id: u64,
+    pub object_id: u64,
+    /// Key to seal with, or the key the track expects when opening
+    pub key_id: u64,
+    /// Payload plus room for [`MAX_OVERHEAD`] when sealing
+    pub buf: &'a mut [u8],
+    /// Bytes of `buf` in use; updated on success
+    pub len: usize,
+}
+
+/// Key store and batch sealing/opening
+pub struct ObjectCrypto {
+    keys: RwLock<HashMap<u64, TrackKey>>,
+}
+
+impl ObjectCrypto {
+    pub fn new() -> Self {
+        Self {
+            keys: RwLock::new(HashMap::new()),
+        }
+    }
+
+    /// Install (or rotate) the base key of `key_id` for the full track name
+    /// `track`
+    ///
+    /// Fails if `key_id` is already bound to another track.
+    pub fn set_key(&self, key_id: u64, track: &[u8], base_key: &[u8]) -> bool {
+        let mut keys = self.keys.write().unwrap();
+        if keys.get(&key_id).is_some_and(|key| key.track != track) {
+            return false;
+        }
+        match TrackKey::derive(key_id, track, base_key) {
+            Some(key) => {
+                keys.insert(key_id, key);
+                true
+            }
+            None => false,
+        }
+    }
+
+    pub fn remove_key(&self, key_id: u64) -> bool {
+        self.keys.write().unwrap().remove(&key_id).is_some()
+    }
+
+    /// Encrypt every object in place. Returns one result per object.
+    pub fn seal_batch(&self, objects: &mut [ObjectBuffer]) -> Vec<Result<(), CryptoError>> {
+        let keys = self.keys.read().unwrap();
+        objects
+            .iter_mut()
+            .map(|object| {
+                let key = keys.get(&object.key_id).ok_or(CryptoError::UnknownKey)?;
+                seal(key, object)
+            })
+            .collect()
+    }
+
+    /// Decrypt every object in place, leaving the plaintext at the start of
+    /// its buffer. Each object's header must name its `key_id`. Returns one
+    /// result per object.
+    pub fn open_batch(&self, objects: &mut [ObjectBuffer]) -> Vec<Result<(), CryptoError>> {
+        let keys = self.keys.read().unwrap();
+        objects
+            .iter_mut()
+            .map(|object| {
+                let (key_id, counter, header_len) = read_header(&object.buf[..object.len])?;
+                if key_id != object.key_id {
+                    return Err(CryptoError::WrongKey);
+                }
+                let key = keys.get(&key_id).ok_or(CryptoError::UnknownKey)?;
+                open(key, counter, header_len, object)
+            })
+            .collect()
+    }
+}
+
+fn seal(key: &TrackKey, object: &mut ObjectBuffer) -> Result<(), CryptoError> {
+    let counter = object_counter(object.group_id, object.object_id)?;
+    let mut header = [0u8; MAX_HEADER_LEN];
+    let header_len = write_header(&mut header, object.key_id, counter);
+    let sealed_len = header_len + object.len + TAG_LEN;
+    if object.buf.len() < sealed_len {
+        return Err(CryptoError::BufferTooSmall);
+    }
+
+    object.buf.copy_within(..object.len, header_len);
+    object.buf[..header_len].copy_from_slice(&header[..header_len]);
+    let (aad, rest) = object.buf.split_at_mut(header_len);
+    let tag = key
+        .key
+        .seal_in_place_separate_tag(key.nonce(counter), Aad::from(&*aad), &mut rest[..object.len])
+        .map_err(|_| CryptoError::AuthenticationFailed)?;
+    rest[object.len..object.len + TAG_LEN].copy_from_slice(tag.as_ref());
+    object.len = sealed_len;
+    Ok(())
+}
+
+fn open(key: &TrackKey, counter: u64, header_len: usize, object: &mut ObjectBuffer) -> Result<(), CryptoError> {
+    // The counter must match where the object was received
+    if object_counter(object.group_id, object.object_id)? != counter {
+        return Err(CryptoError::BadCounter);
+    }
+    if object.len < header_len + TAG_LEN {
+        return Err(CryptoError::BadHeader);
+    }
+
+    let (aad, rest) = object.buf[..object.len].split_at_mut(header_len);
+    let plaintext_len = key
+        .key
+        .open_in_place(key.nonce(counter), Aad::from(&*aad), rest)
+        .map_err(|_| CryptoError::AuthenticationFailed)?
+        .len();
+    object.buf.copy_within(header_len..header_len + plaintext_len, 0);
+    object.len = plaintext_len;
+    Ok(())
+}
+
+// Global context registry
+static OBJECT_CRYPTO: Lazy<DashMap<u64, Arc<ObjectCrypto>>> = Lazy::new(|| DashMap::new());
+static NEXT_CRYPTO_ID: AtomicU64 = AtomicU64::new(1);
+
+fn context(crypto_id: u64) -> Option<Arc<ObjectCrypto>> {
+    OBJECT_CRYPTO.get(&crypto_id).map(|c| c.clone())
+}
+
+/// One object of an FFI batch
+#[repr(C)]
+pub struct CryptoObject {
+    pub group_id: u64,
+    pub object_id: u64,
+    /// Key to seal with, or the key the track expects when opening
+    pub key_id: u64,
+    pub data: *mut u8,
+    /// Bytes in use; updated on success
+    pub len: usize,
+    /// Size of `data`
+    pub capacity: usize,
+    /// 0 on success, or a negative error code
+    pub status: i32,
+}
+
+// Run `f` over an FFI batch; returns the number of objects that succeeded
+fn run_batch(
+    crypto_id: u64,
+    objects: *mut CryptoObject,
+    count: usize,
+    f: impl Fn(&ObjectCrypto, &mut [ObjectBuffer]) -> Vec<Result<(), CryptoError>>,
+) -> c_int {
+    if objects.is_null() {
+        return -1;
+    }
+    let Some(crypto) = context(crypto_id) else { return -1 };
+    let objects = unsafe { std::slice::from_raw_parts_mut(objects, count) };
+    if objects.iter().any(|o| o.data.is_null() || o.len > o.capacity) {
+        return -1;
+    }
+
+    let mut buffers: Vec<ObjectBuffer> = objects
+        .iter()
+        .map(|o| ObjectBuffer {
+            group_id: o.group_id,
+            object_id: o.object_id,
+            key_id: o.key_id,
+            buf: unsafe { std::slice::from_raw_parts_mut(o.data, o.capacity) },
+            len: o.len,
+        })
+        .collect();
+    let results = f(&crypto, &mut buffers);
+
+    let mut succeeded = 0;
+    for ((object, buffer), result) in objects.iter_mut().zip(&buffers).zip(results) {
+        match result {
+            Ok(()) => {
+                object.len = buffer.len;
+                object.key_id = buffer.key_id;
+                object.status = 0;
+                succeeded += 1;
+            }
+            Err(e) => object.status = e as i32,
+        }
+    }
+    succeeded
+}
+
+// FFI Functions
+
+/// Create an object encryption context
+///
+/// # Returns
+/// Context ID
+#[no_mangle]
+pub extern "C" fn object_crypto_create() -> u64 {
+    let id = NEXT_CRYPTO_ID.fetch_add(1, Ordering::Relaxed);
+    OBJECT_CRYPTO.insert(id, Arc::new(ObjectCrypto::new()));
+    log::info!("Created object crypto context {}", id);
+    id
+}
+
+/// Destroy an object encryption context and its keys
+#[no_mangle]
+pub extern "C" fn object_crypto_destroy(crypto_id: u64) {
+    if OBJECT_CRYPTO.remove(&crypto_id).is_some() {
+        log::info!("Destroyed object crypto context {}", crypto_id);
+    }
+}
+
+/// Most bytes sealing adds to a payload
+#[no_mangle]
+pub extern "C" fn object_crypto_max_overhead() -> usize {
+    MAX_OVERHEAD
+}
+
+/// Install or rotate the base key of a key ID
+///
+/// A base key must not be reused across publishing sessions: counters start
+/// over with the group IDs.
+///
+/// # Arguments
+/// * `crypto_id` - Context ID
+/// * `key_id` - SFrame key ID (one per track)
+/// * `track` - Full track name the key is bound to
+/// * `track_len` - Length of `track`
+/// * `base_key` - Base key material
+/// * `len` - Length of `base_key`
+///
+/// # Returns
+/// 0 on success, -1 on error or if `key_id` is bound to another track
+#[no_mangle]
+pub extern "C" fn object_crypto_set_key(
+    crypto_id: u64,
+    key_id: u64,
+    track: *const u8,
+    track_len: usize,
+    base_key: *const u8,
+    len: usize,
+) -> c_int {
+    if track.is_null() || track_len == 0 || base_key.is_null() || len == 0 {
+        return -1;
+    }
+    let track = unsafe { std::slice::from_raw_parts(track, track_len) };
+    let base_key = unsafe { std::slice::from_raw_parts(base_key, len) };
+    match context(crypto_id) {
+        Some(crypto) if crypto.set_key(key_id, track, base_key) => 0,
+        _ => -1,
+    }
+}
+
+/// Remove a key ID
+///
+/// # Returns
+/// 0 on success, -1 if the context or key does not exist
+#[no_mangle]
+pub extern "C" fn object_crypto_remove_key(crypto_id: u64, key_id: u64) -> c_int {
+    match context(crypto_id) {
+        Some(crypto) if crypto.remove_key(key_id) => 0,
+        _ => -1,
+    }
+}
+
+/// Encrypt a batch of objects in place
+///
+/// Each object's `capacity` must leave room for `object_crypto_max_overhead()`
+/// bytes past `len`; `len` is updated to the protected size.
+///
+/// # Returns
+/// Number of objects sealed (see each object's `status`), or -1 on error
+#[no_mangle]
+pub extern "C" fn object_crypto_seal_batch(crypto_id: u64, objects: *mut CryptoObject, count: usize) -> c_int {
+    run_batch(crypto_id, objects, count, ObjectCrypto::seal_batch)
+}
+
+/// Decrypt a batch of objects in place
+///
+/// The plaintext is left at the start of `data` and `len` is updated. Each
+/// object's `key_id` is the key its track expects; objects sealed with any
+/// other key fail with `WrongKey`.
+///
+/// # Returns
+/// Number of objects opened (see each object's `status`), or -1 on error
+#[no_mangle]
+pub extern "C" fn object_crypto_open_batch(crypto_id: u64, objects: *mut CryptoObject, count: usize) -> c_int {
+    run_batch(crypto_id, objects, count, ObjectCrypto::open_batch)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    fn sealed(crypto: &ObjectCrypto, key_id: u64, group_id: u64, object_id: u64, payload: &[u8]) -> Vec<u8> {
+        let mut buf = payload.to_vec();
+        buf.resize(payload.len() + MAX_OVERHEAD, 0);
+        let mut objects = [ObjectBuffer { group_id, object_id, key_id, buf: &mut buf, len: payload.len() }];
+        assert_eq!(crypto.seal_batch(&mut objects), vec![Ok(())]);
+        let len = objects[0].len;
+        buf.truncate(len);
+        buf
+    }
+
+    fn opened(
+        crypto: &ObjectCrypto,
+        key_id: u64,
+        group_id: u64,
+        object_id: u64,
+        data: &[u8],
+    ) -> Result<Vec<u8>, CryptoError> {
+        let mut buf = data.to_vec();
+        let mut objects = [ObjectBuffer { group_id, object_id, key_id, buf: &mut buf, len: data.len() }];
+        let result = crypto.open_batch(&mut objects).remove(0);
+        let len = objects[0].len;
+        result.map(|_| buf[..len].to_vec())
+    }
+
+    #[test]
+    fn header_round_trip() {
+        for (key_id, counter) in [(0, 0), (7, 7), (8, 8), (300, 1 << 24 | 5), (u64::MAX, u64::MAX)] {
+            let mut header = [0u8; MAX_HEADER_LEN];
+            let len = write_header(&mut header, key_id, counter);
+            assert_eq!(read_header(&header[..len]), Ok((key_id, counter, len)));
+        }
+        // Short values live in the config byte
+        let mut header = [0u8; MAX_HEADER_LEN];
+        assert_eq!(write_header(&mut header, 3, 5), 1);
+        assert_eq!(header[0], 0x35);
+    }
+
+    #[test]
+    fn seal_and_open_in_place() {
+        let crypto = ObjectCrypto::new();
+        assert!(crypto.set_key(42, b"room/video", b"track base key"));
+        let payload = b"hello relay, you cannot read this";
+
+        let protected = sealed(&crypto, 42, 1000, 3, payload);
+        assert!(protected.len() <= payload.len() + MAX_OVERHEAD);
+        assert!(!protected.windows(5).any(|w| w == b"hello"));
+        assert_eq!(opened(&crypto, 42, 1000, 3, &protected).unwrap(), payload);
+    }
+
+    #[test]
+    fn rejects_tampering_and_moved_objects() {
+        let crypto = ObjectCrypto::new();
+        crypto.set_key(1, b"room/video", b"key one");
+        let protected = sealed(&crypto, 1, 7, 2, b"payload");
+
+        let mut flipped = protected.clone();
+        *flipped.last_mut().unwrap() ^= 1;
+        assert_eq!(opened(&crypto, 1, 7, 2, &flipped), Err(CryptoError::AuthenticationFailed));
+
+        // A relay replaying the object at another location
+        assert_eq!(opened(&crypto, 1, 7, 3, &protected), Err(CryptoError::BadCounter));
+
+        // A rotated base key cannot open it
+        assert!(crypto.set_key(1, b"room/video", b"rotated"));
+        assert_eq!(opened(&crypto, 1, 7, 2, &protected), Err(CryptoError::AuthenticationFailed));
+        crypto.remove_key(1);
+        assert_eq!(opened(&crypto, 1, 7, 2, &protected), Err(CryptoError::UnknownKey));
+    }
+
+    #[test]
+    fn keys_are_bound_to_one_track() {
+        let crypto = ObjectCrypto::new();
+        assert!(crypto.set_key(1, b"room/video", b"shared base key"));
+        assert!(!crypto.set_key(1, b"room/audio", b"shared base key"));
+        assert!(crypto.set_key(2, b"room/audio", b"shared base key"));
+        let video = sealed(&crypto, 1, 7, 2, b"payload");
+
+        // A relay moving a video object onto the audio track
+        assert_eq!(opened(&crypto, 2, 7, 2, &video), Err(CryptoError::WrongKey));
+
+        // The same key ID and base key on another track derive another key
+        let other = ObjectCrypto::new();
+        other.set_key(1, b"room/screen", b"shared base key");
+        assert_eq!(opened(&other, 1, 7, 2, &video), Err(CryptoError::AuthenticationFailed));
+    }
+
+    #[test]
+    fn batch_reports_each_object() {
+        let crypto = ObjectCrypto::new();
+        crypto.set_key(5, b"room/video", b"key");
+        let mut a = vec![1u8; 10 + MAX_OVERHEAD];
+        let mut b = vec![2u8; 10];
+        let mut objects = [
+            ObjectBuffer { group_id: 1, object_id: 0, key_id: 5, buf: &mut a, len: 10 },
+            ObjectBuffer { group_id: 1, object_id: 1, key_id: 5, buf: &mut b, len: 10 },
+        ];
+        assert_eq!(
+            crypto.seal_batch(&mut objects),
+            vec![Ok(()), Err(CryptoError::BufferTooSmall)]
+        );
+        assert_eq!(object_counter(MAX_GROUP_ID + 1, 0), Err(CryptoError::BadCounter));
+        assert_eq!(object_counter(0, 1 << 24), Err(CryptoError::BadCounter));
+    }
+
+    // Benchmark: single-core throughput and per-object latency
+    //
+    // Seals and opens batches of objects at typical MoQ sizes (audio frame,
+    // delta frame, keyframe) on one thread.
+    #[test]
+    #[ignore]
+    fn bench_throughput_per_core() {
+        let crypto = ObjectCrypto::new();
+        crypto.set_key(1, b"room/video", b"benchmark key");
+        const BATCH: usize = 32;
+
+        for size in [160usize, 1200, 16 * 1024, 256 * 1024] {
+            let iterations = (512 * 1024 * 1024 / (size * BATCH)).max(4);
+            let mut buffers: Vec<Vec<u8>> = (0..BATCH).map(|_| vec![0xA5; size + MAX_OVERHEAD]).collect();
+
+            let mut seal_time = 0f64;
+            let mut open_time = 0f64;
+            for i in 0..iterations {
+                let mut objects: Vec<ObjectBuffer> = buffers
+                    .iter_mut()
+                    .enumerate()
+                    .map(|(n, buf)| ObjectBuffer {
+                        group_id: i as u64,
+                        object_id: n as u64,
+                        key_id: 1,
+                        buf,
+                        len: size,
+                    })
+                    .collect();
+                let started = Instant::now();
+                let results = crypto.seal_batch(&mut objects);
+                seal_time += started.elapsed().as_secs_f64();
+                assert!(results.iter().all(|r| r.is_ok()));
+
+                let started = Instant::now();
+                let results = crypto.open_batch(&mut objects);
+                open_time += started.elapsed().as_secs_f64();
+                assert!(results.iter().all(|r| r.is_ok()));
+            }
+
+            let objects = (iterations * BATCH) as f64;
+            let bytes = objects * size as f64;
+            println!(
+                "{:>7} B objects: seal {:.2} GB/s ({:.2} us/object), open {:.2} GB/s ({:.2} us/object)",
+                size,
+                bytes / seal_time / 1e9,
+                seal_time / objects * 1e6,
+                bytes / open_time / 1e9,
+                open_time / objects * 1e6,
+            );
+        }
+    }
+}
@@ -0,0 +1,1810 @@
+// Native subscriber data plane: transport -> deframer -> muxer -> player
+//
+// On the Dart subscribe path every media byte is copied out of the receive
+// buffers, parsed, muxed to fMP4 and copied back into the player. A playback
+// sink keeps all of that on the transport reader tasks instead:
+// - Dart creates a sink on a player (media_player_create_sink) and, after
+//   SUBSCRIBE_OK, routes the track's alias to it (moq_quic_route_track /
+//   moq_webtransport_route_track)
+// - Each incoming subgroup stream is checked once, when its header arrives;
+//   streams of routed tracks never reach the Dart receive buffers
+// - `SubgroupDeframer` cuts objects out of the reads, handing payloads that
+//   arrived in one read to the sink without copying them
+// - moq-mi video is muxed to fMP4 (crate::fmp4) and CMAF fragments get their
+//   moof sequence number rewritten, then both go straight into the player buffer
+// - Dart polls events and counters only
+//
+// Objects that reached Dart before the route existed (the first stream after
+// SUBSCRIBE_OK, or a session being recovered) are handed over with
+// `playback_sink_push_frame` and pass through the same join logic.
+//
+// Several sinks can play one routed track. A track routed with a replay cache
+// (crate::replay_cache) keeps its newest group, so a sink attached later
+// starts at that group's keyframe instead of waiting for the next one.
+
+use crate::bandwidth::decode_varint;
+use crate::fmp4;
+use crate::h264;
+use crate::redundant::{MergerConfig, MergerEvent, PathMerger, PATH_STATS_LEN};
+use crate::replay_cache::{CachedObject, ReplayCache};
+use bytes::Bytes;
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
+
+// moq-mi extension header types (draft-cenzano-moq-media-interop-03)
+pub(crate) const EXT_MEDIA_TYPE: u64 = 0x0A;
+pub(crate) const EXT_VIDEO_H264_AVCC_EXTRADATA: u64 = 0x0D;
+pub(crate) const EXT_VIDEO_H264_AVCC_METADATA: u64 = 0x15;
+
+// moq-mi media type values
+pub(crate) const MEDIA_TYPE_VIDEO_H264_AVCC: u64 = 0x00;
+
+// Object status for end of track (draft-14)
+const STATUS_END_OF_TRACK: u64 = 0x4;
+
+// First version whose extension header types are delta-coded
+pub(crate) const DELTA_KVP_VERSION: u64 = 0xff00_000f;
+
+// Events kept for Dart between polls
+const MAX_PENDING_EVENTS: usize = 256;
+
+// fMP4 track id of moq-mi video, matching the Dart muxer
+const VIDEO_TRACK_ID: u32 = 1;
+
+/// How objects on the routed tracks are packaged
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Packaging {
+    /// moq-mi / LOC: one AVCC frame per object, metadata in extension headers
+    MoqMi = 0,
+    /// CMAF: each object is a moof + mdat fragment of a shared init segment
+    Cmaf = 1,
+}
+
+/// Role of a routed track in the sink
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum TrackKind {
+    Video = 0,
+    Audio = 1,
+}
+
+impl TrackKind {
+    pub fn from_raw(raw: i32) -> Option<Self> {
+        match raw {
+            0 => Some(TrackKind::Video),
+            1 => Some(TrackKind::Audio),
+            _ => None,
+        }
+    }
+}
+
+/// Something happened that Dart may want to react to
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SinkEvent {
+    /// An init segment was written; the player can start
+    InitWritten,
+    /// The first keyframe was written, from this group
+    FirstKeyframe(u64),
+    /// The publisher ended a track
+    EndOfTrack(TrackKind),
+    /// A routed stream ended in the middle of an object or had a bad header
+    StreamError,
+    /// The player buffer was full and this many bytes were dropped
+    BufferOverflow(u64),
+}
+
+impl SinkEvent {
+    /// (kind, value) as reported over FFI
+    pub fn to_raw(self) -> (i32, u64) {
+        match self {
+            SinkEvent::InitWritten => (1, 0),
+            SinkEvent::FirstKeyframe(group) => (2, group),
+            SinkEvent::EndOfTrack(track) => (3, track as u64),
+            SinkEvent::StreamError => (4, 0),
+            SinkEvent::BufferOverflow(bytes) => (5, bytes),
+        }
+    }
+}
+
+/// Where a sink's muxed output goes
+pub trait PlaybackOutput: Send + Sync {
+    /// Append `parts` back to back; returns the number of bytes taken
+    fn write(&self, parts: &[&[u8]]) -> usize;
+    /// No more data will follow
+    fn end(&self);
+}
+
+/// Counters, in the order returned by `playback_sink_get_stats`
+#[derive(Default)]
+struct SinkStats {
+    objects: AtomicU64,
+    payload_bytes: AtomicU64,
+    video_frames: AtomicU64,
+    audio_frames: AtomicU64,
+    skipped_frames: AtomicU64,
+    late_objects: AtomicU64,
+    bytes_written: AtomicU64,
+    bytes_dropped: AtomicU64,
+    native_streams: AtomicU64,
+    handed_over: AtomicU64,
+    stream_errors: AtomicU64,
+    replayed: AtomicU64,
+}
+
+pub const SINK_STATS_LEN: usize = 12;
+
+impl SinkStats {
+    fn snapshot(&self) -> [u64; SINK_STATS_LEN] {
+        [
+            &self.objects,
+            &self.payload_bytes,
+            &self.video_frames,
+            &self.audio_frames,
+            &self.skipped_frames,
+            &self.late_objects,
+            &self.bytes_written,
+            &self.bytes_dropped,
+            &self.native_streams,
+            &self.handed_over,
+            &self.stream_errors,
+            &self.replayed,
+        ]
+        .map(|c| c.load(Ordering::Relaxed))
+    }
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Admit {
+    Play,
+    Skip,
+    Late,
+}
+
+// Mid-group join handling: a group can only be decoded from its first object
+#[derive(Default)]
+struct GroupTracker {
+    current: Option<u64>,
+    playable: bool,
+}
+
+impl GroupTracker {
+    fn admit(&mut self, group: u64, object: u64) -> Admit {
+        match self.current {
+            Some(current) if group < current => Admit::Late,
+            Some(current) if group == current => {
+                if self.playable {
+                    Admit::Play
+                } else {
+                    Admit::Skip
+                }
+            }
+            _ => {
+                self.current = Some(group);
+                self.playable = object == 0;
+                if self.playable {
+                    Admit::Play
+                } else {
+                    Admit::Skip
+                }
+            }
+        }
+    }
+}
+
+/// A media frame as handed to the sink
+pub struct Frame<'a> {
+    pub group: u64,
+    pub object: u64,
+    /// Known keyframe flag, or None to detect it (moq-mi video)
+    pub keyframe: Option<bool>,
+    /// Duration in `timebase` units (moq-mi)
+    pub duration: u64,
+    pub timebase: u64,
+    /// AVC decoder configuration carried with this frame (moq-mi)
+    pub config: Option<&'a [u8]>,
+    pub data: &'a [u8],
+}
+
+struct SinkState {
+    init_written: bool,
+    width: u16,
+    height: u16,
+    // moq-mi video muxing
+    avc_config: Option<Vec<u8>>,
+    sequence: u32,
+    decode_time: u64,
+    keyframe_written: bool,
+    video_groups: GroupTracker,
+    header: Vec<u8>,
+}
+
+/// Muxes routed tracks into one player
+pub struct PlaybackSink {
+    packaging: Packaging,
+    output: Box<dyn PlaybackOutput>,
+    state: Mutex<SinkState>,
+    stats: SinkStats,
+    events: Mutex<VecDeque<SinkEvent>>,
+    closed: AtomicBool,
+}
+
+impl PlaybackSink {
+    pub fn new(packaging: Packaging, width: u16, height: u16, output: Box<dyn PlaybackOutput>) -> Self {
+        Self {
+            packaging,
+            output,
+            state: Mutex::new(SinkState {
+                init_written: false,
+                width,
+                height,
+                avc_config: None,
+                sequence: 0,
+                decode_time: 0,
+                keyframe_written: false,
+                video_groups: GroupTracker::default(),
+                header: Vec::with_capacity(fmp4::FRAGMENT_HEADER_LEN),
+            }),
+            stats: SinkStats::default(),
+            events: Mutex::new(VecDeque::new()),
+            closed: AtomicBool::new(false),
+        }
+    }
+
+    pub fn packaging(&self) -> Packaging {
+        self.packaging
+    }
+
+    /// Write a ready-made init segment (CMAF: the combined init of all tracks)
+    pub fn set_init_segment(&self, init: &[u8]) {
+        let mut state = self.state.lock().unwrap();
+        self.write(&[init]);
+        state.init_written = true;
+        self.emit(SinkEvent::InitWritten);
+    }
+
+    /// Set the AVC decoder configuration ahead of the first keyframe (moq-mi),
+    /// e.g. from the catalog, and write the init segment built from it
+    pub fn set_codec_config(&self, avcc: &[u8]) {
+        let mut state = self.state.lock().unwrap();
+        self.write_video_init(&mut state, avcc);
+    }
+
+    /// Stop writing to the player; routed streams still in flight drain into nothing
+    pub fn close(&self) {
+        self.closed.store(true, Ordering::Relaxed);
+    }
+
+    pub fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::Relaxed)
+    }
+
+    /// Counters, see `SinkStats`
+    pub fn stats(&self) -> [u64; SINK_STATS_LEN] {
+        self.stats.snapshot()
+    }
+
+    pub fn poll_event(&self) -> Option<SinkEvent> {
+        self.events.lock().unwrap().pop_front()
+    }
+
+    fn emit(&self, event: SinkEvent) {
+        let mut events = self.events.lock().unwrap();
+        if events.len() < MAX_PENDING_EVENTS {
+            events.push_back(event);
+        }
+    }
+
+    fn write(&self, parts: &[&[u8]]) {
+        let len: usize = parts.iter().map(|p| p.len()).sum();
+        let written = self.output.write(parts);
+        self.stats.bytes_written.fetch_add(written as u64, Ordering::Relaxed);
+        if written < len {
+            let dropped = (len - written) as u64;
+            self.stats.bytes_dropped.fetch_add(dropped, Ordering::Relaxed);
+            self.emit(SinkEvent::BufferOverflow(dropped));
+        }
+    }
+
+    fn write_video_init(&self, state: &mut SinkState, avcc: &[u8]) {
+        if state.avc_config.is_some() {
+            return;
+        }
+        let init = fmp4::h264_init_segment(avcc, state.width, state.height, VIDEO_TRACK_ID);
+        self.write(&[&init]);
+        state.avc_config = Some(avcc.to_vec());
+        state.init_written = true;
+        self.emit(SinkEvent::InitWritten);
+    }
+
+    /// Handle one deframed object of a routed stream
+    pub fn on_object(&self, track: TrackKind, object: &ObjectRef<'_>, delta_kvp: bool) {
+        if self.is_closed() {
+            return;
+        }
+        if object.payload.is_empty() {
+            if object.status == STATUS_END_OF_TRACK {
+                self.emit(SinkEvent::EndOfTrack(track));
+                if track == TrackKind::Video {
+                    self.output.end();
+                }
+            }
+            return;
+        }
+
+        let mut frame = Frame {
+            group: object.group_id,
+            object: object.object_id,
+            keyframe: None,
+            duration: 0,
+            timebase: 0,
+            config: None,
+            data: object.payload,
+        };
+        if self.packaging == Packaging::MoqMi && track == TrackKind::Video {
+            match parse_video_extensions(object.extensions, delta_kvp) {
+                Some(meta) => {
+                    frame.duration = meta.duration;
+                    frame.timebase = meta.timebase;
+                    frame.config = meta.config;
+                }
+                None => {
+                    self.stats.objects.fetch_add(1, Ordering::Relaxed);
+                    self.stats.skipped_frames.fetch_add(1, Ordering::Relaxed);
+                    return;
+                }
+            }
+        }
+        self.push_frame(track, &frame);
+    }
+
+    /// Handle a frame, either deframed natively or handed over from Dart
+    pub fn push_frame(&self, track: TrackKind, frame: &Frame<'_>) {
+        if self.is_closed() {
+            return;
+        }
+        self.stats.objects.fetch_add(1, Ordering::Relaxed);
+        self.stats.payload_bytes.fetch_add(frame.data.len() as u64, Ordering::Relaxed);
+
+        let mut state = self.state.lock().unwrap();
+        if track == TrackKind::Video {
+            match state.video_groups.admit(frame.group, frame.object) {
+                Admit::Play => {}
+                Admit::Skip => {
+                    self.stats.skipped_frames.fetch_add(1, Ordering::Relaxed);
+                    return;
+                }
+                Admit::Late => {
+                    self.stats.late_objects.fetch_add(1, Ordering::Relaxed);
+                    return;
+                }
+            }
+        }
+
+        match (self.packaging, track) {
+            (Packaging::Cmaf, _) => self.write_cmaf(&mut state, track, frame),
+            (Packaging::MoqMi, TrackKind::Video) => self.write_moq_mi_video(&mut state, frame),
+            // Audio needs a combined init segment, which moq-mi does not carry;
+            // counted like the Dart player, which plays video only
+            (Packaging::MoqMi, TrackKind::Audio) => {
+                self.stats.audio_frames.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    }
+
+    fn write_cmaf(&self, state: &mut SinkState, track: TrackKind, frame: &Frame<'_>) {
+        if !state.init_written {
+            self.stats.skipped_frames.fetch_add(1, Ordering::Relaxed);
+            return;
+        }
+        match track {
+            TrackKind::Video => {
+                self.stats.video_frames.fetch_add(1, Ordering::Relaxed);
+                if !state.keyframe_written {
+                    state.keyframe_written = true;
+                    self.emit(SinkEvent::FirstKeyframe(frame.group));
+                }
+            }
+            TrackKind::Audio => {
+                self.stats.audio_frames.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+
+        // Fragments of all tracks share one mfhd sequence once interleaved;
+        // it sits at bytes 20..24 (moof header, then mfhd header and flags)
+        state.sequence += 1;
+        let data = frame.data;
+        if data.len() >= 24 {
+            let sequence = state.sequence.to_be_bytes();
+            self.write(&[&data[..20], &sequence, &data[24..]]);
+        } else {
+            self.write(&[data]);
+        }
+    }
+
+    fn write_moq_mi_video(&self, state: &mut SinkState, frame: &Frame<'_>) {
+        if let Some(config) = frame.config {
+            self.write_video_init(state, config);
+        }
+        if state.avc_config.is_none() {
+            self.stats.skipped_frames.fetch_add(1, Ordering::Relaxed);
+            return;
+        }
+
+        let keyframe = frame
+            .keyframe
+            .unwrap_or_else(|| frame.config.is_some() || is_h264_keyframe(frame.data));
+        if !state.keyframe_written {
+            if !keyframe {
+                self.stats.skipped_frames.fetch_add(1, Ordering::Relaxed);
+                return;
+            }
+            state.keyframe_written = true;
+            self.emit(SinkEvent::FirstKeyframe(frame.group));
+        }
+        self.stats.video_frames.fetch_add(1, Ordering::Relaxed);
+
+        let duration = if frame.timebase == 0 {
+            0
+        } else {
+            (frame.duration as u128 * fmp4::VIDEO_TIMESCALE as u128 / frame.timebase as u128) as u32
+        };
+        state.sequence += 1;
+        let mut header = std::mem::take(&mut state.header);
+        header.clear();
+        fmp4::write_fragment_header(
+            &mut header,
+            state.sequence,
+            VIDEO_TRACK_ID,
+            state.decode_time,
+            duration,
+            frame.data.len() as u32,
+            keyframe,
+        );
+        self.write(&[&header, frame.data]);
+        state.header = header;
+        state.decode_time += duration as u64;
+    }
+}
+
+// Whether an AVCC (or, failing that, Annex-B) access unit contains an IDR slice
+fn is_h264_keyframe(data: &[u8]) -> bool {
+    let mut pos = 0;
+    while pos + 4 < data.len() {
+        let len = u32::from_be_bytes(data[pos..pos + 4].try_into().unwrap()) as usize;
+        if len == 0 || len > data.len() - pos - 4 {
+            break;
+        }
+        if data[pos + 4] & 0x1f == h264::NAL_IDR {
+            return true;
+        }
+        pos += 4 + len;
+    }
+    h264::is_annex_b(data) && h264::nal_units(data).any(|nal| data[nal.start] & 0x1f == h264::NAL_IDR)
+}
+
+// -----------------------------------------------------------------------------
+// Extension headers
+// -----------------------------------------------------------------------------
+
+struct VideoMeta<'a> {
+    timebase: u64,
+    duration: u64,
+    config: Option<&'a [u8]>,
+}
+
+// moq-mi video fields from an object's extension headers, or None if the object
+// is not moq-mi H.264
+fn parse_video_extensions(ext: &[u8], delta_kvp: bool) -> Option<VideoMeta<'_>> {
+    let mut media_type = None;
+    let mut metadata = None;
+    let mut config = None;
+
+    let mut pos = 0;
+    let mut last_type = 0;
+    while pos < ext.len() {
+        let (raw_type, n) = decode_varint(&ext[pos..])?;
+        pos += n;
+        let kind = if delta_kvp { last_type + raw_type } else { raw_type };
+        last_type = kind;
+        if kind % 2 == 0 {
+            let (value, n) = decode_varint(&ext[pos..])?;
+            pos += n;
+            if kind == EXT_MEDIA_TYPE {
+                media_type = Some(value);
+            }
+        } else {
+            let (len, n) = decode_varint(&ext[pos..])?;
+            pos += n;
+            let end = pos.checked_add(len as usize).filter(|&end| end <= ext.len())?;
+            let value = &ext[pos..end];
+            pos = end;
+            match kind {
+                // Some publishers send the media type as a one-byte buffer
+                EXT_MEDIA_TYPE => media_type = value.first().map(|&b| b as u64),
+                EXT_VIDEO_H264_AVCC_METADATA => metadata = Some(value),
+                EXT_VIDEO_H264_AVCC_EXTRADATA if !value.is_empty() => config = Some(value),
+                _ => {}
+            }
+        }
+    }
+
+    if media_type? != MEDIA_TYPE_VIDEO_H264_AVCC {
+        return None;
+    }
+    // seqId, pts, dts, timebase, duration, wallclock
+    let mut fields = [0u64; 5];
+    let mut at = 0;
+    let metadata = metadata?;
+    for field in fields.iter_mut() {
+        let (value, n) = decode_varint(&metadata[at..])?;
+        *field = value;
+        at += n;
+    }
+    Some(VideoMeta {
+        timebase: fields[3],
+        duration: fields[4],
+        config,
+    })
+}
+
+// -----------------------------------------------------------------------------
+// Deframing
+// -----------------------------------------------------------------------------
+
+/// An object cut out of a subgroup stream
+pub struct ObjectRef<'a> {
+    pub group_id: u64,
+    pub object_id: u64,
+    /// Object status; only meaningful when the payload is empty
+    pub status: u64,
+    pub extensions: &'a [u8],
+    pub payload: &'a [u8],
+    /// The payload's own buffer, when it was assembled across reads and can
+    /// be kept without copying
+    pub shared: Option<&'a Bytes>,
+}
+
+#[derive(Debug, Clone, Copy)]
+struct SubgroupHeader {
+    group_id: u64,
+    extensions: bool,
+}
+
+// Object whose fields are parsed but whose payload spans several reads
+struct PartialObject {
+    object_id: u64,
+    extensions: Vec<u8>,
+    payload: Vec<u8>,
+    remaining: usize,
+}
+
+enum Parsed<'a> {
+    Object(ObjectRef<'a>, usize),
+    // Fields complete, payload continues in later reads
+    Partial(PartialObject),
+    NeedMore,
+}
+
+/// Splits one subgroup stream (draft-14, and draft-16 default-priority headers)
+/// into objects
+pub struct SubgroupDeframer {
+    header: Option<SubgroupHeader>,
+    pending: Vec<u8>,
+    partial: Option<PartialObject>,
+    last_object: Option<u64>,
+}
+
+impl SubgroupDeframer {
+    pub fn new() -> Self {
+        Self {
+            header: None,
+            pending: Vec::new(),
+            partial: None,
+            last_object: None,
+        }
+    }
+
+    /// Feed the next read; complete objects are passed to `on_object`
+    pub fn push(&mut self, mut data: &[u8], on_object: &mut dyn FnMut(&ObjectRef<'_>)) -> Result<(), String> {
+        // Finish an object whose payload spans reads
+        if let Some(partial) = self.partial.as_mut() {
+            let n = partial.remaining.min(data.len());
+            partial.payload.extend_from_slice(&data[..n]);
+            partial.remaining -= n;
+            data = &data[n..];
+            if partial.remaining > 0 {
+                return Ok(());
+            }
+            let partial = self.partial.take().unwrap();
+            let payload = Bytes::from(partial.payload);
+            on_object(&ObjectRef {
+                group_id: self.header.unwrap().group_id,
+                object_id: partial.object_id,
+                status: 0,
+                extensions: &partial.extensions,
+                payload: &payload,
+                shared: Some(&payload),
+            });
+        }
+
+        // Bytes left over from the last read hold an incomplete header or object
+        // prefix; parse them together with the new data
+        let mut joined = std::mem::take(&mut self.pending);
+        let buf: &[u8] = if joined.is_empty() {
+            data
+        } else {
+            joined.extend_from_slice(data);
+            &joined
+        };
+
+        let mut pos = 0;
+        if self.header.is_none() {
+            match self.parse_header(buf)? {
+                Some((header, n)) => {
+                    self.header = Some(header);
+                    pos = n;
+                }
+                None => {
+                    self.pending = buf.to_vec();
+                    return Ok(());
+                }
+            }
+        }
+
+        while pos < buf.len() {
+            match self.parse_object(&buf[pos..]) {
+                Parsed::Object(object, n) => {
+                    on_object(&object);
+                    pos += n;
+                }
+                Parsed::Partial(partial) => {
+                    self.partial = Some(partial);
+                    pos = buf.len();
+                }
+                Parsed::NeedMore => break,
+            }
+        }
+
+        if pos < buf.len() {
+            self.pending = buf[pos..].to_vec();
+        }
+        Ok(())
+    }
+
+    /// The stream ended; an error if it stopped inside a header or object
+    pub fn finish(&self) -> Result<(), String> {
+        if self.partial.is_some() || !self.pending.is_empty() {
+            return Err("stream ended inside an object".to_string());
+        }
+        if self.header.is_none() {
+            return Err("stream ended before its subgroup header".to_string());
+        }
+        Ok(())
+    }
+
+    fn parse_header(&self, buf: &[u8]) -> Result<Option<(SubgroupHeader, usize)>, String> {
+        let mut pos = 0;
+        let next = |pos: &mut usize| -> Option<u64> {
+            let (v, n) = decode_varint(&buf[*pos..])?;
+            *pos += n;
+            Some(v)
+        };
+        let stream_type = match next(&mut pos) {
+            Some(v) => v,
+            None => return Ok(None),
+        };
+        let normalized = stream_type & !0x20;
+        if !(0x10..=0x1D).contains(&normalized) {
+            return Err(format!("not a subgroup stream (type 0x{:x})", stream_type));
+        }
+        let (_alias, group_id) = match (next(&mut pos), next(&mut pos)) {
+            (Some(a), Some(g)) => (a, g),
+            _ => return Ok(None),
+        };
+        if matches!(normalized, 0x14 | 0x15 | 0x1C | 0x1D) && next(&mut pos).is_none() {
+            return Ok(None);
+        }
+        // Draft-16 DEFAULT_PRIORITY omits the publisher priority byte
+        if stream_type & 0x20 == 0 {
+            if pos >= buf.len() {
+                return Ok(None);
+            }
+            pos += 1;
+        }
+        Ok(Some((
+            SubgroupHeader {
+                group_id,
+                extensions: stream_type & 0x01 != 0,
+            },
+            pos,
+        )))
+    }
+
+    fn parse_object<'a>(&mut self, buf: &'a [u8]) -> Parsed<'a> {
+        let header = self.header.unwrap();
+        let mut pos = 0;
+        macro_rules! varint {
+            () => {
+                match decode_varint(&buf[pos..]) {
+                    Some((v, n)) => {
+                        pos += n;
+                        v
+                    }
+                    None => return Parsed::NeedMore,
+                }
+            };
+        }
+
+        let delta = varint!();
+        let object_id = match self.last_object {
+            None => delta,
+            Some(last) => last + delta + 1,
+        };
+
+        let mut extensions: &[u8] = &[];
+        if header.extensions {
+            let len = varint!() as usize;
+            if buf.len() - pos < len {
+                return Parsed::NeedMore;
+            }
+            extensions = &buf[pos..pos + len];
+            pos += len;
+        }
+
+        let payload_len = varint!() as usize;
+        if payload_len == 0 {
+            let status = varint!();
+            self.last_object = Some(object_id);
+            return Parsed::Object(
+                ObjectRef { group_id: header.group_id, object_id, status, extensions, payload: &[], shared: None },
+                pos,
+            );
+        }
+
+        self.last_object = Some(object_id);
+        let available = buf.len() - pos;
+        if available >= payload_len {
+            let payload = &buf[pos..pos + payload_len];
+            return Parsed::Object(
+                ObjectRef { group_id: header.group_id, object_id, status: 0, extensions, payload, shared: None },
+                pos + payload_len,
+            );
+        }
+
+        let mut payload = Vec::with_capacity(payload_len);
+        payload.extend_from_slice(&buf[pos..]);
+        Parsed::Partial(PartialObject {
+            object_id,
+            extensions: extensions.to_vec(),
+            payload,
+            remaining: payload_len - available,
+        })
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Routing
+// -----------------------------------------------------------------------------
+
+// A routed track, shared with its streams in flight so that a sink attached
+// later receives the rest of the current group too
+//
+// A redundant route (crate::redundant) is fed by several sessions at once;
+// its merger passes on the first copy of each object.
+pub struct Route {
+    track: TrackKind,
+    delta_kvp: bool,
+    state: Mutex<RouteState>,
+}
+
+struct RouteState {
+    sinks: Vec<Arc<PlaybackSink>>,
+    cache: Option<ReplayCache>,
+    merger: Option<PathMerger>,
+}
+
+impl Route {
+    fn new(track: TrackKind, delta_kvp: bool, replay_bytes: usize) -> Self {
+        Self {
+            track,
+            delta_kvp,
+            state: Mutex::new(RouteState {
+                sinks: Vec::new(),
+                cache: (replay_bytes > 0).then(|| ReplayCache::new(replay_bytes)),
+                merger: None,
+            }),
+        }
+    }
+
+    /// A route merged from the paths added with `RouteTable::route_path`
+    pub fn redundant(track: TrackKind, version: u64, replay_bytes: usize, config: MergerConfig) -> Arc<Self> {
+        let route = Self::new(track, version >= DELTA_KVP_VERSION, replay_bytes);
+        route.state.lock().unwrap().merger = Some(PathMerger::new(config));
+        Arc::new(route)
+    }
+
+    fn on_object(&self, path: usize, object: &ObjectRef<'_>) {
+        let mut state = self.state.lock().unwrap();
+        if let Some(merger) = state.merger.as_mut() {
+            if !merger.admit(path, object.group_id, object.object_id, Instant::now()) {
+                return;
+            }
+        }
+        if let Some(cache) = state.cache.as_mut() {
+            cache.push(CachedObject::from_ref(object));
+        }
+        for sink in &state.sinks {
+            sink.on_object(self.track, object, self.delta_kvp);
+        }
+    }
+
+    /// Add a sink, first replaying the cached group into it; objects are
+    /// delivered under the same lock, so none is missed or repeated
+    pub fn attach(&self, sink: Arc<PlaybackSink>) {
+        let mut state = self.state.lock().unwrap();
+        state.sinks.retain(|s| !s.is_closed());
+        if state.sinks.iter().any(|s| Arc::ptr_eq(s, &sink)) {
+            return;
+        }
+        if let Some(cache) = &state.cache {
+            for object in cache.objects() {
+                sink.on_object(self.track, &object.as_ref(), self.delta_kvp);
+            }
+            sink.stats.replayed.fetch_add(cache.len() as u64, Ordering::Relaxed);
+        }
+        state.sinks.push(sink);
+    }
+
+    fn for_each_sink(&self, f: impl Fn(&PlaybackSink)) {
+        for sink in &self.state.lock().unwrap().sinks {
+            f(sink);
+        }
+    }
+
+    fn remove_path(&self, path: usize) {
+        if let Some(merger) = self.state.lock().unwrap().merger.as_mut() {
+            merger.remove_path(path);
+        }
+    }
+
+    /// Counters of one path of a redundant route
+    pub fn path_stats(&self, path: usize) -> Option<[u64; PATH_STATS_LEN]> {
+        self.state.lock().unwrap().merger.as_ref()?.path_stats(path)
+    }
+
+    /// Next demotion or promotion of a path of a redundant route
+    pub fn poll_event(&self) -> Option<MergerEvent> {
+        self.state.lock().unwrap().merger.as_mut()?.poll_event()
+    }
+}
+
+// A routed alias: the route, and the path it feeds if the route is redundant
+struct RouteEntry {
+    route: Arc<Route>,
+    path: usize,
+}
+
+impl Drop for RouteEntry {
+    fn drop(&mut self) {
+        self.route.remove_path(self.path);
+    }
+}
+
+/// Track aliases of one transport that are played natively
+///
+/// Keyed by (session, track alias); QUIC connections and WebTransport sessions
+/// each have their own table.
+pub struct RouteTable {
+    routes: DashMap<(u64, u64), RouteEntry>,
+}
+
+impl RouteTable {
+    pub fn new() -> Self {
+        Self { routes: DashMap::new() }
+    }
+
+    /// Play `track_alias` through `sink`; `version` is the negotiated MoQ version
+    ///
+    /// A sink routed to a track that is already routed joins the other sinks
+    /// on it. If the track keeps a replay cache (`replay_bytes` > 0 when it was
+    /// first routed), the sink starts at the cached group instead of waiting
+    /// for the next one.
+    pub fn route(
+        &self,
+        session_id: u64,
+        track_alias: u64,
+        sink: Arc<PlaybackSink>,
+        track: TrackKind,
+        version: u64,
+        replay_bytes: usize,
+    ) {
+        let delta_kvp = version >= DELTA_KVP_VERSION;
+        let new_entry = || RouteEntry { route: Arc::new(Route::new(track, delta_kvp, replay_bytes)), path: 0 };
+        let mut entry = self.routes.entry((session_id, track_alias)).or_insert_with(new_entry);
+        if entry.route.track != track || entry.route.delta_kvp != delta_kvp {
+            *entry = new_entry();
+        }
+        entry.route.attach(sink);
+    }
+
+    /// Feed `track_alias` into a redundant route as one more path
+    ///
+    /// Returns the path index, or None if the route has no free path.
+    pub fn route_path(&self, session_id: u64, track_alias: u64, route: Arc<Route>) -> Option<usize> {
+        // Unroute first, so a re-routed alias frees its old path
+        self.routes.remove(&(session_id, track_alias));
+        let path = route.state.lock().unwrap().merger.as_mut()?.add_path(Instant::now())?;
+        self.routes.insert((session_id, track_alias), RouteEntry { route, path });
+        Some(path)
+    }
+
+    /// Send new streams of `track_alias` back to Dart; returns whether it was routed
+    pub fn unroute(&self, session_id: u64, track_alias: u64) -> bool {
+        self.routes.remove(&(session_id, track_alias)).is_some()
+    }
+
+    pub fn remove_session(&self, session_id: u64) {
+        self.routes.retain(|key, _| key.0 != session_id);
+    }
+
+    pub fn clear(&self) {
+        self.routes.clear();
+    }
+
+    /// Bytes held by a routed track's replay cache, if it has one
+    pub fn replay_cache_bytes(&self, session_id: u64, track_alias: u64) -> Option<usize> {
+        let entry = self.routes.get(&(session_id, track_alias))?;
+        let state = entry.route.state.lock().unwrap();
+        state.cache.as_ref().map(|c| c.bytes())
+    }
+
+    /// Router for a newly accepted stream of `session_id`
+    pub fn stream_router(&self, session_id: u64) -> StreamRouter<'_> {
+        StreamRouter {
+            table: self,
+            session_id,
+            state: RouterState::Deciding(Vec::new()),
+        }
+    }
+}
+
+/// What the reader should do with the bytes it just read
+pub enum Delivery<'a> {
+    /// Consumed natively (or held until the stream header is complete)
+    Consumed,
+    /// Queue for Dart as usual
+    Dart(&'a [u8]),
+    /// Queue for Dart, including earlier reads that were held back
+    DartHeld(Vec<u8>),
+}
+
+enum RouterState {
+    Deciding(Vec<u8>),
+    Dart,
+    Native(Arc<Route>, usize, SubgroupDeframer),
+    // Routed stream that failed to deframe; the rest is discarded
+    Failed,
+}
+
+/// Decides, from its header, whether an incoming stream is played natively
+pub struct StreamRouter<'t> {
+    table: &'t RouteTable,
+    session_id: u64,
+    state: RouterState,
+}
+
+impl<'t> StreamRouter<'t> {
+    /// Route the next read of the stream
+    pub fn feed<'a>(&mut self, data: &'a [u8]) -> Delivery<'a> {
+        match &mut self.state {
+            RouterState::Dart => return Delivery::Dart(data),
+            RouterState::Failed => return Delivery::Consumed,
+            RouterState::Native(route, path, deframer) => {
+                // Keeps draining after the sink closes, so flow control does
+                // not stall the publisher
+                if !Self::deframe(route, *path, deframer, data) {
+                    self.state = RouterState::Failed;
+                }
+                return Delivery::Consumed;
+            }
+            RouterState::Deciding(held) => {
+                let alias = {
+                    let prefix: &[u8] = if held.is_empty() { data } else { held.extend_from_slice(data); held };
+                    match Self::track_alias(prefix) {
+                        Ok(Some(alias)) => Some(alias),
+                        Ok(None) => {
+                            if held.is_empty() {
+                                held.extend_from_slice(data);
+                            }
+                            return Delivery::Consumed;
+                        }
+                        Err(()) => None,
+                    }
+                };
+                let route = alias.and_then(|alias| {
+                    let entry = self.table.routes.get(&(self.session_id, alias))?;
+                    Some((entry.route.clone(), entry.path))
+                });
+                let held = match std::mem::replace(&mut self.state, RouterState::Dart) {
+                    RouterState::Deciding(held) => held,
+                    _ => unreachable!(),
+                };
+                match route {
+                    None if held.is_empty() => Delivery::Dart(data),
+                    None => Delivery::DartHeld(held),
+                    Some((route, path)) => {
+                        route.for_each_sink(|sink| {
+                            sink.stats.native_streams.fetch_add(1, Ordering::Relaxed);
+                        });
+                        let mut deframer = SubgroupDeframer::new();
+                        let bytes: &[u8] = if held.is_empty() { data } else { &held };
+                        self.state = if Self::deframe(&route, path, &mut deframer, bytes) {
+                            RouterState::Native(route, path, deframer)
+                        } else {
+                            RouterState::Failed
+                        };
+                        Delivery::Consumed
+                    }
+                }
+            }
+        }
+    }
+
+    /// The stream ended; returns held bytes that still belong to Dart
+    pub fn finish(&mut self) -> Option<Vec<u8>> {
+        match std::mem::replace(&mut self.state, RouterState::Dart) {
+            RouterState::Deciding(held) if !held.is_empty() => Some(held),
+            RouterState::Native(route, _, deframer) => {
+                if let Err(e) = deframer.finish() {
+                    log::warn!("Routed stream ended early: {}", e);
+                    route.for_each_sink(|sink| {
+                        sink.stats.stream_errors.fetch_add(1, Ordering::Relaxed);
+                        sink.emit(SinkEvent::StreamError);
+                    });
+                }
+                None
+            }
+            _ => None,
+        }
+    }
+
+    // Returns false if the stream cannot be deframed any further
+    fn deframe(route: &Route, path: usize, deframer: &mut SubgroupDeframer, data: &[u8]) -> bool {
+        let result = deframer.push(data, &mut |object| route.on_object(path, object));
+        if let Err(e) = result {
+            log::warn!("Dropping routed stream: {}", e);
+            route.for_each_sink(|sink| {
+                sink.stats.stream_errors.fetch_add(1, Ordering::Relaxed);
+                sink.emit(SinkEvent::StreamError);
+            });
+            return false;
+        }
+        true
+    }
+
+    // Track alias of a subgroup stream, Ok(None) if more bytes are needed and
+    // Err for other stream types
+    fn track_alias(prefix: &[u8]) -> Result<Option<u64>, ()> {
+        let (stream_type, n) = match decode_varint(prefix) {
+            Some(v) => v,
+            None => return Ok(None),
+        };
+        if !(0x10..=0x1D).contains(&(stream_type & !0x20)) {
+            return Err(());
+        }
+        Ok(decode_varint(&prefix[n..]).map(|(alias, _)| alias))
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FFI
+// -----------------------------------------------------------------------------
+
+static SINKS: Lazy<DashMap<u64, Arc<PlaybackSink>>> = Lazy::new(DashMap::new);
+static NEXT_SINK_ID: AtomicU64 = AtomicU64::new(1);
+
+/// Register a sink and return its ID
+pub fn register_sink(sink: PlaybackSink) -> u64 {
+    let id = NEXT_SINK_ID.fetch_add(1, Ordering::Relaxed);
+    SINKS.insert(id, Arc::new(sink));
+    id
+}
+
+/// Look up a sink for routing
+pub fn get_sink(sink_id: u64) -> Option<Arc<PlaybackSink>> {
+    SINKS.get(&sink_id).map(|s| s.clone())
+}
+
+/// Destroy a playback sink
+///
+/// Streams still routed to it are drained and discarded; unroute its tracks
+/// first to send new streams back to Dart.
+#[no_mangle]
+pub extern "C" fn playback_sink_destroy(sink_id: u64) {
+    if let Some((_, sink)) = SINKS.remove(&sink_id) {
+        sink.close();
+        log::info!("Destroyed playback sink {}", sink_id);
+    }
+}
+
+/// Write a ready-made init segment to the player (CMAF packaging)
+///
+/// # Arguments
+/// * `sink_id` - Sink from `media_player_create_sink`
+/// * `data` - Init segment covering every routed track
+/// * `len` - Length of data
+///
+/// # Returns
+/// * 0 on success, -1 if the sink does not exist
+#[no_mangle]
+pub extern "C" fn playback_sink_set_init_segment(sink_id: u64, data: *const u8, len: usize) -> i32 {
+    let sink = match get_sink(sink_id) {
+        Some(s) => s,
+        None => return -1,
+    };
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let init = unsafe { std::slice::from_raw_parts(data, len) };
+    sink.set_init_segment(init);
+    0
+}
+
+/// Set the AVC decoder configuration record before the first keyframe
+/// (moq-mi packaging), e.g. from the catalog
+///
+/// The init segment is built from it and written right away; configurations
+/// carried by later keyframes are ignored.
+///
+/// # Returns
+/// * 0 on success, -1 if the sink does not exist
+#[no_mangle]
+pub extern "C" fn playback_sink_set_codec_config(sink_id: u64, data: *const u8, len: usize) -> i32 {
+    let sink = match get_sink(sink_id) {
+        Some(s) => s,
+        None => return -1,
+    };
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let avcc = unsafe { std::slice::from_raw_parts(data, len) };
+    sink.set_codec_config(avcc);
+    0
+}
+
+/// Hand over a frame that was received through Dart before its track was routed
+///
+/// # Arguments
+/// * `sink_id` - The sink
+/// * `track` - 0 = video, 1 = audio
+/// * `group_id`, `object_id` - Location of the object
+/// * `keyframe` - 1 or 0, or -1 to detect it from the data
+/// * `duration`, `timebase` - moq-mi frame duration (ignored for CMAF)
+/// * `config`, `config_len` - AVC decoder configuration carried by the frame, if any
+/// * `data`, `len` - Object payload
+///
+/// # Returns
+/// * 0 on success, -1 on invalid arguments
+#[no_mangle]
+pub extern "C" fn playback_sink_push_frame(
+    sink_id: u64,
+    track: i32,
+    group_id: u64,
+    object_id: u64,
+    keyframe: i32,
+    duration: u64,
+    timebase: u64,
+    config: *const u8,
+    config_len: usize,
+    data: *const u8,
+    len: usize,
+) -> i32 {
+    let (sink, track) = match (get_sink(sink_id), TrackKind::from_raw(track)) {
+        (Some(s), Some(t)) => (s, t),
+        _ => return -1,
+    };
+    if data.is_null() || len == 0 {
+        return -1;
+    }
+    let frame = Frame {
+        group: group_id,
+        object: object_id,
+        keyframe: if keyframe < 0 { None } else { Some(keyframe != 0) },
+        duration,
+        timebase,
+        config: if config.is_null() || config_len == 0 {
+            None
+        } else {
+            Some(unsafe { std::slice::from_raw_parts(config, config_len) })
+        },
+        data: unsafe { std::slice::from_raw_parts(data, len) },
+    };
+    sink.stats.handed_over.fetch_add(1, Ordering::Relaxed);
+    sink.push_frame(track, &frame);
+    0
+}
+
+/// Get sink counters
+///
+/// # Arguments
+/// * `sink_id` - The sink
+/// * `out` - Output array: objects, payload bytes, video frames, audio frames,
+///   skipped frames, late objects, bytes written, bytes dropped, native streams,
+///   handed-over objects, stream errors, objects replayed from a replay cache
+/// * `len` - Capacity of `out`
+///
+/// # Returns
+/// * Number of values written, -1 if the sink does not exist
+#[no_mangle]
+pub extern "C" fn playback_sink_get_stats(sink_id: u64, out: *mut u64, len: usize) -> i32 {
+    let sink = match get_sink(sink_id) {
+        Some(s) => s,
+        None => return -1,
+    };
+    if out.is_null() {
+        return 0;
+    }
+    let stats = sink.stats();
+    let n = len.min(SINK_STATS_LEN);
+    let out = unsafe { std::slice::from_raw_parts_mut(out, n) };
+    out.copy_from_slice(&stats[..n]);
+    n as i32
+}
+
+/// Take the next pending event
+///
+/// # Arguments
+/// * `sink_id` - The sink
+/// * `out_kind` - Output: 1 = init written, 2 = first keyframe (value: group),
+///   3 = end of track (value: track), 4 = stream error, 5 = buffer overflow
+///   (value: bytes dropped)
+/// * `out_value` - Output: event value
+///
+/// # Returns
+/// * 1 if an event was returned, 0 if none is pending, -1 if the sink does not exist
+#[no_mangle]
+pub extern "C" fn playback_sink_poll_event(sink_id: u64, out_kind: *mut i32, out_value: *mut u64) -> i32 {
+    let sink = match get_sink(sink_id) {
+        Some(s) => s,
+        None => return -1,
+    };
+    let (kind, value) = match sink.poll_event() {
+        Some(event) => event.to_raw(),
+        None => return 0,
+    };
+    unsafe {
+        if !out_kind.is_null() {
+            *out_kind = kind;
+        }
+        if !out_value.is_null() {
+            *out_value = value;
+        }
+    }
+    1
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Duration;
+
+    #[derive(Default)]
+    struct CaptureOutput {
+        data: Mutex<Vec<u8>>,
+        ended: AtomicBool,
+        limit: Option<usize>,
+    }
+
+    impl PlaybackOutput for Arc<CaptureOutput> {
+        fn write(&self, parts: &[&[u8]]) -> usize {
+            let mut data = self.data.lock().unwrap();
+            let mut written = 0;
+            for part in parts {
+                let room = self.limit.map_or(part.len(), |l| l.saturating_sub(data.len()).min(part.len()));
+                data.extend_from_slice(&part[..room]);
+                written += room;
+            }
+            written
+        }
+
+        fn end(&self) {
+            self.ended.store(true, Ordering::Relaxed);
+        }
+    }
+
+    fn sink(packaging: Packaging) -> (Arc<PlaybackSink>, Arc<CaptureOutput>) {
+        let output = Arc::new(CaptureOutput::default());
+        let sink = PlaybackSink::new(packaging, 1280, 720, Box::new(output.clone()));
+        (Arc::new(sink), output)
+    }
+
+    fn varint(v: u64) -> Vec<u8> {
+        match v {
+            0..=0x3f => vec![v as u8],
+            0x40..=0x3fff => (0x4000 | v as u16).to_be_bytes().to_vec(),
+            0x4000..=0x3fff_ffff => (0x8000_0000 | v as u32).to_be_bytes().to_vec(),
+            _ => (0xc000_0000_0000_0000 | v).to_be_bytes().to_vec(),
+        }
+    }
+
+    // Subgroup header type 0x11 (extensions, subgroup 0) for alias 3
+    fn header(group: u64) -> Vec<u8> {
+        [vec![0x11], varint(3), varint(group), vec![128]].concat()
+    }
+
+    fn object(delta: u64, ext: &[u8], payload: &[u8]) -> Vec<u8> {
+        [varint(delta), varint(ext.len() as u64), ext.to_vec(), varint(payload.len() as u64), payload.to_vec()].concat()
+    }
+
+    const AVCC: [u8; 15] = [1, 0x64, 0, 0x1F, 0xFF, 0xE1, 0, 2, 0x67, 0x64, 1, 0, 2, 0x68, 0xEE];
+
+    // moq-mi video extensions: media type, metadata (30fps at 90kHz), optional extradata
+    fn mi_video(seq: u64, config: bool) -> Vec<u8> {
+        let meta = [varint(seq), varint(seq * 3000), varint(seq * 3000), varint(90000), varint(3000), varint(0)].concat();
+        let mut ext = [varint(EXT_MEDIA_TYPE), varint(MEDIA_TYPE_VIDEO_H264_AVCC)].concat();
+        ext.extend([varint(EXT_VIDEO_H264_AVCC_METADATA), varint(meta.len() as u64), meta].concat());
+        if config {
+            ext.extend([varint(EXT_VIDEO_H264_AVCC_EXTRADATA), varint(AVCC.len() as u64), AVCC.to_vec()].concat());
+        }
+        ext
+    }
+
+    // AVCC access unit with one NAL of `size` bytes
+    fn frame(idr: bool, size: usize) -> Vec<u8> {
+        let mut f = (size as u32).to_be_bytes().to_vec();
+        f.push(if idr { 0x65 } else { 0x41 });
+        f.resize(4 + size, 0xAB);
+        f
+    }
+
+    // One group: keyframe with extradata, then `frames - 1` P-frames
+    fn group_stream(group: u64, frames: u64, size: usize) -> Vec<u8> {
+        let mut s = header(group);
+        for i in 0..frames {
+            s.extend(object(0, &mi_video(group * frames + i, i == 0), &frame(i == 0, size)));
+        }
+        s
+    }
+
+    // (type, payload length) of each top-level box
+    fn top_boxes(data: &[u8]) -> Vec<([u8; 4], usize)> {
+        let mut out = Vec::new();
+        let mut pos = 0;
+        while pos + 8 <= data.len() {
+            let size = u32::from_be_bytes(data[pos..pos + 4].try_into().unwrap()) as usize;
+            out.push((data[pos + 4..pos + 8].try_into().unwrap(), size - 8));
+            pos += size;
+        }
+        assert_eq!(pos, data.len(), "output is not a sequence of whole boxes");
+        out
+    }
+
+    #[test]
+    fn deframes_across_any_read_split() {
+        let mut stream = [vec![0x15], varint(3), varint(9), varint(2), vec![7]].concat();
+        stream.extend(object(0, &[0x0A, 0x00], b"first"));
+        stream.extend(object(1, &[], &vec![0x5A; 3000]));
+        // End of group status
+        stream.extend([varint(0), varint(0), varint(0), varint(0x3)].concat());
+
+        for chunk in [1, 2, 7, 100, stream.len()] {
+            let mut deframer = SubgroupDeframer::new();
+            let mut seen = Vec::new();
+            for part in stream.chunks(chunk) {
+                deframer
+                    .push(part, &mut |o| seen.push((o.group_id, o.object_id, o.status, o.extensions.to_vec(), o.payload.len())))
+                    .unwrap();
+            }
+            deframer.finish().unwrap();
+            assert_eq!(
+                seen,
+                vec![
+                    (9, 0, 0, vec![0x0A, 0x00], 5),
+                    (9, 2, 0, vec![], 3000),
+                    (9, 3, 0x3, vec![], 0),
+                ],
+                "chunk size {}",
+                chunk
+            );
+        }
+    }
+
+    #[test]
+    fn deframes_draft16_default_priority_header() {
+        // 0x30: DEFAULT_PRIORITY set, no extensions, so no priority byte
+        let stream = [vec![0x30], varint(3), varint(4), varint(0), varint(2), b"hi".to_vec()].concat();
+        let mut deframer = SubgroupDeframer::new();
+        let mut payloads = Vec::new();
+        deframer.push(&stream, &mut |o| payloads.push(o.payload.to_vec())).unwrap();
+        assert_eq!(payloads, vec![b"hi".to_vec()]);
+
+        let mut truncated = SubgroupDeframer::new();
+        truncated.push(&stream[..stream.len() - 1], &mut |_| {}).unwrap();
+        assert!(truncated.finish().is_err());
+        assert!(SubgroupDeframer::new().push(&[0x05, 1, 2], &mut |_| {}).is_err());
+    }
+
+    #[test]
+    fn moq_mi_video_is_muxed_from_group_start() {
+        let (sink, output) = sink(Packaging::MoqMi);
+        let routes = RouteTable::new();
+        routes.route(1, 3, sink.clone(), TrackKind::Video, 0xff00_000e, 0);
+
+        // Joined mid-group: the tail of group 4 is skipped
+        let mut partial = header(4);
+        partial.extend(object(5, &mi_video(5, false), &frame(false, 100)));
+        partial.extend(object(0, &mi_video(6, false), &frame(false, 100)));
+        for stream in [partial, group_stream(5, 3, 1000), group_stream(6, 3, 1000)] {
+            let mut router = routes.stream_router(1);
+            for part in stream.chunks(700) {
+                assert!(matches!(router.feed(part), Delivery::Consumed));
+            }
+            assert!(router.finish().is_none());
+        }
+
+        let stats = sink.stats();
+        assert_eq!(stats[0], 8); // objects
+        assert_eq!(stats[2], 6); // video frames
+        assert_eq!(stats[4], 2); // skipped
+        assert_eq!(stats[8], 3); // native streams
+        assert_eq!(sink.poll_event(), Some(SinkEvent::InitWritten));
+        assert_eq!(sink.poll_event(), Some(SinkEvent::FirstKeyframe(5)));
+        assert_eq!(sink.poll_event(), None);
+
+        let data = output.data.lock().unwrap();
+        let boxes = top_boxes(&data);
+        let kinds: Vec<_> = boxes.iter().map(|(k, _)| k).collect();
+        assert_eq!(kinds[..4], [b"ftyp", b"moov", b"moof", b"mdat"]);
+        assert_eq!(boxes.iter().filter(|(k, _)| k == b"mdat").count(), 6);
+        assert_eq!(boxes[3].1, 1004);
+
+        // A frame of an older group arriving late through Dart is dropped
+        sink.push_frame(
+            TrackKind::Video,
+            &Frame { group: 5, object: 2, keyframe: None, duration: 3000, timebase: 90000, config: None, data: &frame(false, 10) },
+        );
+        assert_eq!(sink.stats()[5], 1);
+    }
+
+    #[test]
+    fn cmaf_fragments_share_one_sequence() {
+        let (sink, output) = sink(Packaging::Cmaf);
+        // A fragment before the init segment cannot be played
+        let mut fragment = vec![0, 0, 0, 24, b'm', b'o', b'o', b'f', 0, 0, 0, 16, b'm', b'f', b'h', b'd', 0, 0, 0, 0, 0, 0, 0, 1];
+        fragment.extend_from_slice(&[0, 0, 0, 9, b'm', b'd', b'a', b't', 0xEE]);
+        let push = |track, group, object| {
+            sink.push_frame(track, &Frame { group, object, keyframe: None, duration: 0, timebase: 0, config: None, data: &fragment });
+        };
+        push(TrackKind::Video, 0, 0);
+        assert_eq!(sink.stats()[4], 1);
+
+        sink.set_init_segment(b"init");
+        push(TrackKind::Video, 0, 0);
+        push(TrackKind::Audio, 0, 0);
+        push(TrackKind::Video, 0, 1);
+
+        let data = output.data.lock().unwrap();
+        assert_eq!(&data[..4], b"init");
+        let sequences: Vec<u32> = data[4..]
+            .chunks(fragment.len())
+            .map(|f| u32::from_be_bytes(f[20..24].try_into().unwrap()))
+            .collect();
+        assert_eq!(sequences, [1, 2, 3]);
+    }
+
+    #[test]
+    fn unrouted_streams_go_to_dart_intact() {
+        let (sink, output) = sink(Packaging::MoqMi);
+        let routes = RouteTable::new();
+        routes.route(1, 3, sink, TrackKind::Video, 0, 0);
+
+        // Another alias, with the header split over two reads
+        let stream = [vec![0x10], varint(200), varint(1), vec![0], object(0, &[], b"x")].concat();
+        let mut router = routes.stream_router(1);
+        assert!(matches!(router.feed(&stream[..2]), Delivery::Consumed));
+        match router.feed(&stream[2..]) {
+            Delivery::DartHeld(held) => assert_eq!(held, stream),
+            _ => panic!("expected held bytes for Dart"),
+        }
+        assert!(matches!(router.feed(b"more"), Delivery::Dart(b"more")));
+
+        // Same alias on another session, and a stream too short to decide
+        let mut other = routes.stream_router(2);
+        assert!(matches!(other.feed(&header(1)), Delivery::Dart(_)));
+        let mut short = routes.stream_router(1);
+        assert!(matches!(short.feed(&[0x10]), Delivery::Consumed));
+        assert_eq!(short.finish(), Some(vec![0x10]));
+
+        routes.remove_session(1);
+        assert!(matches!(routes.stream_router(1).feed(&group_stream(1, 1, 10)), Delivery::Dart(_)));
+        assert!(output.data.lock().unwrap().is_empty());
+    }
+
+    #[test]
+    fn reports_end_of_track_and_overflow() {
+        let output = Arc::new(CaptureOutput { limit: Some(200), ..Default::default() });
+        let sink = Arc::new(PlaybackSink::new(Packaging::MoqMi, 640, 360, Box::new(output.clone())));
+        let routes = RouteTable::new();
+        routes.route(1, 3, sink.clone(), TrackKind::Video, 0, 0);
+
+        let mut stream = group_stream(0, 2, 500);
+        stream.extend([varint(0), varint(0), varint(0), varint(STATUS_END_OF_TRACK)].concat());
+        let mut router = routes.stream_router(1);
+        router.feed(&stream);
+        router.finish();
+
+        let mut events = Vec::new();
+        while let Some(e) = sink.poll_event() {
+            events.push(e);
+        }
+        assert!(events.contains(&SinkEvent::EndOfTrack(TrackKind::Video)));
+        assert!(events.iter().any(|e| matches!(e, SinkEvent::BufferOverflow(_))));
+        assert!(output.ended.load(Ordering::Relaxed));
+        assert!(sink.stats()[7] > 0);
+    }
+
+    #[test]
+    fn redundant_paths_feed_each_object_once() {
+        let (sink, _) = sink(Packaging::MoqMi);
+        let route = Route::redundant(TrackKind::Video, 0, 0, MergerConfig::default());
+        route.attach(sink.clone());
+        let quic = RouteTable::new();
+        let webtransport = RouteTable::new();
+        assert_eq!(quic.route_path(1, 3, route.clone()), Some(0));
+        assert_eq!(webtransport.route_path(9, 7, route.clone()), Some(1));
+
+        let alias = |stream: Vec<u8>, alias: u64| [vec![stream[0]], varint(alias), stream[2..].to_vec()].concat();
+        // Both relays carry group 0; group 1 only arrives through the second
+        for (table, session, track_alias, groups) in [(&quic, 1, 3, 0..1), (&webtransport, 9, 7, 0..2)] {
+            for g in groups {
+                let mut router = table.stream_router(session);
+                assert!(matches!(router.feed(&alias(group_stream(g, 3, 200), track_alias)), Delivery::Consumed));
+                router.finish();
+            }
+        }
+        let stats = sink.stats();
+        assert_eq!((stats[0], stats[2]), (6, 6));
+        assert_eq!(route.path_stats(0).unwrap()[..3], [3, 3, 0]);
+        assert_eq!(route.path_stats(1).unwrap()[..3], [6, 3, 3]);
+
+        // Unrouting frees the path for the next one
+        assert!(quic.unroute(1, 3));
+        assert_eq!(quic.route_path(2, 3, route.clone()), Some(0));
+        // An ordinary route has no paths
+        quic.route(1, 4, sink, TrackKind::Video, 0, 0);
+        let plain = quic.routes.get(&(1, 4)).unwrap().route.clone();
+        assert_eq!(quic.route_path(1, 5, plain), None);
+    }
+
+    #[test]
+    fn late_sink_starts_at_cached_group() {
+        let (first, _) = sink(Packaging::MoqMi);
+        let routes = RouteTable::new();
+        routes.route(1, 3, first.clone(), TrackKind::Video, 0, 1 << 20);
+
+        let mut router = routes.stream_router(1);
+        router.feed(&group_stream(5, 3, 1000));
+        router.finish();
+
+        // Group 6 is in flight when the second sink attaches
+        let mut head = header(6);
+        for i in 0..2 {
+            head.extend(object(0, &mi_video(18 + i, i == 0), &frame(i == 0, 1000)));
+        }
+        let tail = object(0, &mi_video(20, false), &frame(false, 1000));
+        let mut router = routes.stream_router(1);
+        router.feed(&head);
+        assert_eq!(routes.replay_cache_bytes(1, 3), Some(2 * 1004 + mi_video(18, true).len() + mi_video(19, false).len()));
+
+        let (late, output) = sink(Packaging::MoqMi);
+        routes.route(1, 3, late.clone(), TrackKind::Video, 0, 1 << 20);
+        assert_eq!(late.poll_event(), Some(SinkEvent::InitWritten));
+        assert_eq!(late.poll_event(), Some(SinkEvent::FirstKeyframe(6)));
+        assert_eq!(late.stats()[11], 2); // replayed
+        assert_eq!(late.stats()[2], 2);
+
+        // The rest of the in-flight stream reaches both sinks
+        router.feed(&tail);
+        router.finish();
+        assert_eq!(late.stats()[2], 3);
+        assert_eq!(first.stats()[2], 6);
+        let mdats = top_boxes(&output.data.lock().unwrap()).iter().filter(|(k, _)| k == b"mdat").count();
+        assert_eq!(mdats, 3);
+
+        // Routing the same sink again replays nothing twice
+        routes.route(1, 3, late.clone(), TrackKind::Video, 0, 1 << 20);
+        assert_eq!(late.stats()[2], 3);
+
+        // Without a cache a late sink waits for the next group
+        routes.route(1, 4, first.clone(), TrackKind::Video, 0, 0);
+        let (waiting, _) = sink(Packaging::MoqMi);
+        routes.route(1, 4, waiting.clone(), TrackKind::Video, 0, 0);
+        assert_eq!(routes.replay_cache_bytes(1, 4), None);
+        assert_eq!(waiting.stats()[2], 0);
+    }
+
+    // Startup of a player attaching to a 4K-like stream (400 KB keyframes,
+    // 60 KB P-frames, 2s groups at 30fps) with the replay cache, against
+    // waiting for the next group, and the memory each replay holds compared
+    // with the Dart subscription's 60-object replay:
+    //   cargo test --release bench_late_join_replay_cache -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_late_join_replay_cache() {
+        const GROUPS: u64 = 60;
+        const GOP: u64 = 60;
+        const READ: usize = 64 * 1024;
+        let (live, _) = sink(Packaging::MoqMi);
+        let routes = RouteTable::new();
+        routes.route(1, 3, live, TrackKind::Video, 0, 16 << 20);
+
+        let mut attach = Vec::new();
+        let mut wait_frames = Vec::new();
+        let mut cache_bytes = Vec::new();
+        let mut ring_bytes = Vec::new();
+        let mut ring_lead = Vec::new();
+        let mut ring = std::collections::VecDeque::new();
+        let mut attaches = 0u64;
+        for g in 0..GROUPS {
+            let mut router = routes.stream_router(1);
+            router.feed(&header(g));
+            for i in 0..GOP {
+                let size = if i == 0 { 400_000 } else { 60_000 };
+                let obj = object(0, &mi_video(g * GOP + i, i == 0), &frame(i == 0, size));
+                for read in obj.chunks(READ) {
+                    router.feed(read);
+                }
+                ring.push_back((i, size + 4));
+                if ring.len() > 60 {
+                    ring.pop_front();
+                }
+
+                // A player attaches every 0.7s of media
+                attaches += 1;
+                if attaches % 21 != 0 || g == 0 {
+                    continue;
+                }
+                let (late, _) = sink(Packaging::MoqMi);
+                let t = Instant::now();
+                routes.route(1, 3, late.clone(), TrackKind::Video, 0, 16 << 20);
+                attach.push(t.elapsed());
+                assert_eq!(late.stats()[2], i + 1);
+                late.close();
+                wait_frames.push(GOP - i);
+                cache_bytes.push(routes.replay_cache_bytes(1, 3).unwrap());
+                ring_bytes.push(ring.iter().map(|(_, s)| s).sum::<usize>());
+                // Objects the 60-object replay holds ahead of its first keyframe
+                ring_lead.push(ring.iter().position(|(i, _)| *i == 0).unwrap_or(ring.len()));
+            }
+            router.finish();
+        }
+
+        attach.sort();
+        wait_frames.sort();
+        let n = attach.len();
+        let avg = |v: &[usize]| v.iter().sum::<usize>() as f64 / v.len() as f64;
+        println!(
+            "replay cache: attach to first keyframe p50 {:.0} us, p99 {:.0} us; holds avg {:.1} MB, max {:.1} MB",
+            attach[n / 2].as_secs_f64() * 1e6,
+            attach[n * 99 / 100].as_secs_f64() * 1e6,
+            avg(&cache_bytes) / 1e6,
+            *cache_bytes.iter().max().unwrap() as f64 / 1e6
+        );
+        println!(
+            "no cache:     wait for next group p50 {:.0} ms, p99 {:.0} ms",
+            wait_frames[n / 2] as f64 * 1000.0 / 30.0,
+            wait_frames[n * 99 / 100] as f64 * 1000.0 / 30.0
+        );
+        println!(
+            "60 objects:   holds avg {:.1} MB, avg {:.0} objects before its first keyframe",
+            avg(&ring_bytes) / 1e6,
+            avg(&ring_lead)
+        );
+    }
+
+    // Native data plane against the copies the Dart subscribe path makes, for
+    // a 6 Mbps 30fps stream with 1s groups. The Dart path is replayed natively
+    // stage by stage (receive buffer pop, FFI copy, parser buffer, payload
+    // sublist, muxer moof/mdat/concat, player write), so its numbers leave out
+    // the VM's own overhead and GC pauses, which only widen the gap:
+    //   cargo test --release bench_subscribe_data_plane -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_subscribe_data_plane() {
+        const SECONDS: u64 = 60;
+        const FPS: u64 = 30;
+        const FRAME: usize = 6_000_000 / 8 / FPS as usize;
+        const READ: usize = 64 * 1024;
+        let streams: Vec<Vec<u8>> = (0..SECONDS).map(|g| group_stream(g, FPS, FRAME)).collect();
+        let total: usize = streams.iter().map(|s| s.len()).sum();
+        let frames = (SECONDS * FPS) as f64;
+
+        let report = |label: &str, elapsed: Duration, latencies: &mut Vec<Duration>, allocs: usize| {
+            latencies.sort();
+            let pct = |p: f64| latencies[((latencies.len() - 1) as f64 * p) as usize].as_secs_f64() * 1e6;
+            println!(
+                "{:<8} {:>8.2} us/frame  {:>7.0} MB/s  read->buffer p50 {:>6.1} us  p99 {:>6.1} us  {:>5.1} allocs/frame",
+                label,
+                elapsed.as_secs_f64() * 1e6 / frames,
+                total as f64 / 1e6 / elapsed.as_secs_f64(),
+                pct(0.5),
+                pct(0.99),
+                allocs as f64 / frames,
+            );
+        };
+
+        // Native: reads go through the router into the sink
+        let (sink, output) = sink(Packaging::MoqMi);
+        let routes = RouteTable::new();
+        routes.route(1, 3, sink.clone(), TrackKind::Video, 0, 0);
+        let mut latencies = Vec::new();
+        let started = Instant::now();
+        for stream in &streams {
+            let mut router = routes.stream_router(1);
+            for read in stream.chunks(READ) {
+                let t = Instant::now();
+                router.feed(read);
+                latencies.push(t.elapsed());
+            }
+            router.finish();
+            output.data.lock().unwrap().clear();
+        }
+        let native = started.elapsed();
+        assert_eq!(sink.stats()[2], SECONDS * FPS);
+        // Partial payloads are assembled once per frame that spans reads
+        report("native", native, &mut latencies, (SECONDS * FPS) as usize);
+
+        // Dart path, copy for copy
+        let mut latencies = Vec::new();
+        let mut allocs = 0;
+        let started = Instant::now();
+        let mut player = Vec::new();
+        for stream in &streams {
+            // ReceiveBuffer push/pop is a byte-at-a-time VecDeque
+            let mut recv = std::collections::VecDeque::new();
+            let mut parser: Vec<u8> = Vec::new();
+            let mut deframer = SubgroupDeframer::new();
+            for read in stream.chunks(READ) {
+                let t = Instant::now();
+                recv.extend(read.iter().copied());
+                let mut ffi = vec![0u8; recv.len()];
+                for b in ffi.iter_mut() {
+                    *b = recv.pop_front().unwrap();
+                }
+                // calloc buffer -> Uint8List, then _buffer.addAll
+                let dart = ffi.clone();
+                parser.extend_from_slice(&dart);
+                allocs += 2;
+                // Each parse attempt copies the whole buffer (Uint8List.fromList)
+                let attempt = parser.clone();
+                allocs += 1;
+                deframer
+                    .push(&attempt, &mut |o| {
+                        if o.payload.is_empty() {
+                            return;
+                        }
+                        let payload = o.payload.to_vec(); // sublist
+                        let mut moof = Vec::new();
+                        fmp4::write_fragment_header(&mut moof, 1, 1, 0, 3000, payload.len() as u32, false);
+                        let moof = moof.clone(); // _updateTrunDataOffset
+                        let mut mdat = moof[moof.len() - 8..].to_vec();
+                        mdat.extend_from_slice(&payload); // writeMdat
+                        let mut segment = moof[..moof.len() - 8].to_vec();
+                        segment.extend_from_slice(&mdat); // moof + mdat
+                        player.extend_from_slice(&segment); // writeData
+                        allocs += 5;
+                    })
+                    .unwrap();
+                parser.clear();
+                latencies.push(t.elapsed());
+            }
+            player.clear();
+        }
+        let dart = started.elapsed();
+        report("dart", dart, &mut latencies, allocs);
+        println!("native path: {:.1}x less CPU per frame", dart.as_secs_f64() / native.as_secs_f64());
+    }
+}
@@ -0,0 +1,1443 @@
+// Native publisher data plane: capture -> encode -> package -> send
+//
+// On the Dart publish path every frame crosses the FFI boundary several times:
+// capture frames arrive over the event channel, are piped to ffmpeg, the
+// Annex-B output is parsed and packaged in Dart and copied back into native
+// for `moq_quic_stream_write`. A publish pipeline keeps all of that on native
+// threads; Dart only configures it and polls counters:
+// - Frames come from a native screen capture (publish_pipeline_attach_screen_capture)
+//   or are pushed as I420 (publish_pipeline_push_frame), and wait in a short
+//   queue that drops the oldest frame when the encoder falls behind
+// - One thread feeds the encoder; ffmpeg/libx264 runs with the same low-latency
+//   settings as the Dart `H264Encoder` but writes FLV, whose length-prefixed
+//   tags let a second thread cut each access unit (already AVCC) as soon as its
+//   last byte arrives instead of waiting for the next start code
+// - That thread packages the frame as a moq-mi object (one subgroup stream per
+//   group, a new group at every keyframe) and queues it for sending
+// - A sender thread opens, writes and finishes the streams; when the transport
+//   cannot keep up the queue fills, and frames are dropped until the next
+//   keyframe so subscribers never see a group with holes
+//
+// Every stage records its latency, so Dart can report p50/p99 from capture to
+// the transport.
+
+use crate::bandwidth::encode_varint;
+use crate::playback_sink::{
+    DELTA_KVP_VERSION, EXT_MEDIA_TYPE, EXT_VIDEO_H264_AVCC_EXTRADATA, EXT_VIDEO_H264_AVCC_METADATA,
+    MEDIA_TYPE_VIDEO_H264_AVCC,
+};
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+use std::collections::VecDeque;
+use std::io::{self, Read, Write};
+use std::process::{Child, Command, Stdio};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+// Raw frames waiting for the encoder; each one in the queue adds a frame of latency
+const RAW_QUEUE_DEPTH: usize = 2;
+
+// Packaged objects waiting for the transport
+const PACKET_QUEUE_DEPTH: usize = 64;
+
+// moq-mi timestamps are in microseconds, like the Dart publisher's
+const TIMEBASE_US: u64 = 1_000_000;
+
+// Subgroup header with extensions and subgroup ID 0 (draft-14)
+const SUBGROUP_HEADER_WITH_EXTENSIONS: u64 = 0x11;
+
+// How long the encoder gets to flush after its input is closed
+const ENCODER_EXIT_TIMEOUT: Duration = Duration::from_secs(2);
+
+/// Where a pipeline's subgroup streams go
+pub trait PublishOutput: Send {
+    /// Open a unidirectional stream; returns its ID or a negative error code
+    fn open_stream(&mut self) -> Result<u64, i32>;
+    /// Write to a stream, waiting while the transport is congested
+    fn write(&mut self, stream_id: u64, data: Vec<u8>) -> Result<(), i32>;
+    /// Finish a stream
+    fn finish(&mut self, stream_id: u64);
+}
+
+/// The track a pipeline publishes
+#[derive(Debug, Clone, Copy)]
+pub struct TrackConfig {
+    pub track_alias: u64,
+    pub priority: u8,
+    /// Negotiated MoQT version, selects the extension header encoding
+    pub version: u64,
+}
+
+/// Video settings of a pipeline
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct EncoderConfig {
+    pub width: u32,
+    pub height: u32,
+    pub fps: u32,
+    /// Target bitrate in bits per second
+    pub bitrate: u32,
+    /// Frames per group
+    pub gop: u32,
+}
+
+impl EncoderConfig {
+    fn is_valid(&self) -> bool {
+        self.width >= 2
+            && self.height >= 2
+            && self.width % 2 == 0
+            && self.height % 2 == 0
+            && (1..=240).contains(&self.fps)
+            && self.bitrate > 0
+            && self.gop > 0
+    }
+
+    /// Size of one I420 frame
+    pub fn frame_len(&self) -> usize {
+        let luma = self.width as usize * self.height as usize;
+        luma + luma / 2
+    }
+
+    fn frame_duration_us(&self) -> u64 {
+        TIMEBASE_US / self.fps as u64
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Encoder
+// -----------------------------------------------------------------------------
+
+/// A running encoder: I420 frames in, FLV out
+pub struct EncoderProcess {
+    pub input: Box<dyn Write + Send>,
+    pub output: Box<dyn Read + Send>,
+    child: Option<Child>,
+}
+
+impl EncoderProcess {
+    /// Encoder reading and writing through in-process pipes
+    pub fn from_pipes(input: Box<dyn Write + Send>, output: Box<dyn Read + Send>) -> Self {
+        Self { input, output, child: None }
+    }
+
+    /// Start ffmpeg with libx264, tuned like the Dart `H264Encoder`
+    pub fn spawn_ffmpeg(config: &EncoderConfig) -> io::Result<Self> {
+        let bitrate = config.bitrate.to_string();
+        let gop = config.gop.to_string();
+        let mut child = Command::new("ffmpeg")
+            .args(["-hide_banner", "-loglevel", "error"])
+            .args(["-f", "rawvideo", "-pixel_format", "yuv420p"])
+            .args(["-video_size", &format!("{}x{}", config.width, config.height)])
+            .args(["-framerate", &config.fps.to_string()])
+            .args(["-i", "pipe:0"])
+            .args(["-c:v", "libx264", "-preset", "ultrafast", "-tune", "zerolatency"])
+            .args(["-profile:v", "baseline"])
+            .args(["-b:v", &bitrate, "-maxrate", &bitrate])
+            .args(["-bufsize", &(config.bitrate / 2).to_string()])
+            .args(["-g", &gop, "-keyint_min", &gop, "-sc_threshold", "0"])
+            .args(["-bf", "0", "-refs", "1", "-rc-lookahead", "0", "-forced-idr", "1"])
+            // SPS/PPS go into the FLV sequence header, frames are AVCC
+            .args(["-flush_packets", "1", "-flvflags", "no_duration_filesize"])
+            .args(["-f", "flv", "pipe:1"])
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .stderr(Stdio::inherit())
+            .spawn()?;
+        let input = child.stdin.take().expect("piped stdin");
+        let output = child.stdout.take().expect("piped stdout");
+        Ok(Self {
+            input: Box::new(input),
+            output: Box::new(output),
+            child: Some(child),
+        })
+    }
+}
+
+/// A unit read from the encoder
+#[derive(Debug, PartialEq, Eq)]
+pub enum Encoded<'a> {
+    /// AVC decoder configuration record
+    Config(&'a [u8]),
+    /// One AVCC access unit
+    Frame { keyframe: bool, data: &'a [u8] },
+}
+
+/// Cuts AVC packets out of an FLV byte stream
+pub struct FlvReader<R> {
+    input: R,
+    header_read: bool,
+    tag: Vec<u8>,
+}
+
+impl<R: Read> FlvReader<R> {
+    pub fn new(input: R) -> Self {
+        Self {
+            input,
+            header_read: false,
+            tag: Vec::new(),
+        }
+    }
+
+    /// Read up to the next AVC packet; None at the end of the stream
+    pub fn next(&mut self) -> io::Result<Option<Encoded<'_>>> {
+        if !self.header_read {
+            let mut header = [0u8; 9];
+            if !self.fill(&mut header)? {
+                return Ok(None);
+            }
+            if &header[..3] != b"FLV" {
+                return Err(io::Error::new(io::ErrorKind::InvalidData, "encoder output is not FLV"));
+            }
+            // Anything between the header and the first tag, then PreviousTagSize0
+            let offset = u32::from_be_bytes(header[5..9].try_into().unwrap()) as usize;
+            let mut skip = vec![0u8; offset.saturating_sub(9) + 4];
+            if !self.fill(&mut skip)? {
+                return Ok(None);
+            }
+            self.header_read = true;
+        }
+
+        // Video tags: frame type and codec ID, AVC packet type, composition time
+        const TAG_VIDEO: u8 = 9;
+        const CODEC_AVC: u8 = 7;
+        let size = loop {
+            // Tag type, data size (24 bits), timestamp, stream ID
+            let mut header = [0u8; 11];
+            if !self.fill(&mut header)? {
+                return Ok(None);
+            }
+            let size = u32::from_be_bytes([0, header[1], header[2], header[3]]) as usize;
+            // Data and the trailing PreviousTagSize
+            let mut tag = std::mem::take(&mut self.tag);
+            tag.resize(size + 4, 0);
+            let complete = self.fill(&mut tag)?;
+            self.tag = tag;
+            if !complete {
+                return Ok(None);
+            }
+            // Skip other tags, empty packets and end of sequence
+            if header[0] == TAG_VIDEO
+                && size > 5
+                && self.tag[0] & 0x0f == CODEC_AVC
+                && matches!(self.tag[1], 0 | 1)
+            {
+                break size;
+            }
+        };
+
+        let data = &self.tag[5..size];
+        Ok(Some(match self.tag[1] {
+            0 => Encoded::Config(data),
+            _ => Encoded::Frame {
+                keyframe: self.tag[0] >> 4 == 1,
+                data,
+            },
+        }))
+    }
+
+    // read_exact that reports a clean end of stream as false
+    fn fill(&mut self, buf: &mut [u8]) -> io::Result<bool> {
+        match self.input.read_exact(buf) {
+            Ok(()) => Ok(true),
+            Err(e) if e.kind() == io::ErrorKind::UnexpectedEof => Ok(false),
+            Err(e) => Err(e),
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Packaging
+// -----------------------------------------------------------------------------
+
+/// Bytes for the sender; `new_group` starts a new subgroup stream
+struct Packet {
+    new_group: bool,
+    data: Vec<u8>,
+    captured: Instant,
+    queued: Instant,
+}
+
+/// Turns encoded frames into moq-mi objects on subgroup streams
+pub struct ObjectPackager {
+    track: TrackConfig,
+    frame_duration_us: u64,
+    config: Vec<u8>,
+    group_id: u64,
+    sequence: u64,
+    waiting_for_keyframe: bool,
+    extensions: Vec<u8>,
+    metadata: Vec<u8>,
+}
+
+impl ObjectPackager {
+    pub fn new(track: TrackConfig, frame_duration_us: u64) -> Self {
+        Self {
+            track,
+            frame_duration_us,
+            config: Vec::new(),
+            // Group IDs start at 1, like the Dart publisher's
+            group_id: 0,
+            sequence: 0,
+            waiting_for_keyframe: true,
+            extensions: Vec::new(),
+            metadata: Vec::new(),
+        }
+    }
+
+    /// Set the AVC decoder configuration record sent with every keyframe
+    pub fn set_config(&mut self, avcc: &[u8]) {
+        self.config.clear();
+        self.config.extend_from_slice(avcc);
+    }
+
+    /// Drop frames until the next keyframe, e.g. after one could not be sent
+    pub fn resync(&mut self) {
+        self.waiting_for_keyframe = true;
+    }
+
+    /// Package an AVCC frame; returns whether it starts a new group and the
+    /// bytes to write, or None while waiting for a keyframe
+    pub fn package(&mut self, keyframe: bool, frame: &[u8], pts_us: u64, wallclock_ms: u64) -> Option<(bool, Vec<u8>)> {
+        if keyframe {
+            self.group_id += 1;
+            self.waiting_for_keyframe = false;
+        } else if self.waiting_for_keyframe {
+            return None;
+        }
+
+        // seqId, pts, dts, timebase, duration, wallclock
+        self.metadata.clear();
+        for value in [self.sequence, pts_us, pts_us, TIMEBASE_US, self.frame_duration_us, wallclock_ms] {
+            encode_varint(&mut self.metadata, value);
+        }
+        self.sequence += 1;
+
+        // Types in ascending order, delta-coded from the first delta-KVP version
+        let delta_kvp = self.track.version >= DELTA_KVP_VERSION;
+        let mut last_type = 0;
+        let mut put_type = |out: &mut Vec<u8>, kind: u64| {
+            encode_varint(out, if delta_kvp { kind - last_type } else { kind });
+            last_type = kind;
+        };
+        self.extensions.clear();
+        put_type(&mut self.extensions, EXT_MEDIA_TYPE);
+        encode_varint(&mut self.extensions, MEDIA_TYPE_VIDEO_H264_AVCC);
+        if keyframe && !self.config.is_empty() {
+            put_type(&mut self.extensions, EXT_VIDEO_H264_AVCC_EXTRADATA);
+            encode_varint(&mut self.extensions, self.config.len() as u64);
+            self.extensions.extend_from_slice(&self.config);
+        }
+        put_type(&mut self.extensions, EXT_VIDEO_H264_AVCC_METADATA);
+        encode_varint(&mut self.extensions, self.metadata.len() as u64);
+        self.extensions.extend_from_slice(&self.metadata);
+
+        let mut out = Vec::with_capacity(frame.len() + self.extensions.len() + 32);
+        if keyframe {
+            encode_varint(&mut out, SUBGROUP_HEADER_WITH_EXTENSIONS);
+            encode_varint(&mut out, self.track.track_alias);
+            encode_varint(&mut out, self.group_id);
+            out.push(self.track.priority);
+        }
+        // Object IDs are consecutive: the first is sent as is, then delta 0
+        encode_varint(&mut out, 0);
+        encode_varint(&mut out, self.extensions.len() as u64);
+        out.extend_from_slice(&self.extensions);
+        encode_varint(&mut out, frame.len() as u64);
+        out.extend_from_slice(frame);
+        Some((keyframe, out))
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Queues and counters
+// -----------------------------------------------------------------------------
+
+struct QueueState<T> {
+    items: VecDeque<T>,
+    closed: bool,
+}
+
+// Fixed-size handoff between two stage threads
+struct BoundedQueue<T> {
+    state: Mutex<QueueState<T>>,
+    ready: Condvar,
+    capacity: usize,
+}
+
+impl<T> BoundedQueue<T> {
+    fn new(capacity: usize) -> Self {
+        Self {
+            state: Mutex::new(QueueState {
+                items: VecDeque::with_capacity(capacity),
+                closed: false,
+            }),
+            ready: Condvar::new(),
+            capacity,
+        }
+    }
+
+    // Add an item, evicting the oldest one when full
+    fn push_evict(&self, item: T) -> Option<T> {
+        let mut state = self.state.lock().unwrap();
+        let evicted = if state.items.len() >= self.capacity {
+            state.items.pop_front()
+        } else {
+            None
+        };
+        state.items.push_back(item);
+        self.ready.notify_one();
+        evicted
+    }
+
+    // Add an item unless full; hands it back when full
+    fn try_push(&self, item: T) -> Result<(), T> {
+        let mut state = self.state.lock().unwrap();
+        if state.items.len() >= self.capacity {
+            return Err(item);
+        }
+        state.items.push_back(item);
+        self.ready.notify_one();
+        Ok(())
+    }
+
+    // Wait for the next item; None once closed and drained
+    fn pop(&self) -> Option<T> {
+        let mut state = self.state.lock().unwrap();
+        loop {
+            if let Some(item) = state.items.pop_front() {
+                return Some(item);
+            }
+            if state.closed {
+                return None;
+            }
+            state = self.ready.wait(state).unwrap();
+        }
+    }
+
+    fn close(&self) {
+        self.state.lock().unwrap().closed = true;
+        self.ready.notify_all();
+    }
+}
+
+/// Pipeline stages whose latency is recorded
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Stage {
+    /// Capture until the encoder takes the frame
+    Queue = 0,
+    /// Into the encoder until its access unit is read back
+    Encode = 1,
+    /// Access unit to packaged object
+    Package = 2,
+    /// Packaged until the transport accepted it
+    Send = 3,
+    /// Capture until the transport accepted the frame
+    Total = 4,
+}
+
+const STAGE_COUNT: usize = 5;
+
+// Eight buckets per power of two, exact below 8 us; up to about a minute
+const SUB_BUCKETS: usize = 8;
+const LATENCY_BUCKETS: usize = SUB_BUCKETS * 24;
+
+// Latency histogram with lock-free recording
+pub(crate) struct LatencyHistogram {
+    buckets: [AtomicU64; LATENCY_BUCKETS],
+}
+
+impl LatencyHistogram {
+    pub(crate) fn new() -> Self {
+        Self {
+            buckets: std::array::from_fn(|_| AtomicU64::new(0)),
+        }
+    }
+
+    fn bucket(us: u64) -> usize {
+        if us < SUB_BUCKETS as u64 {
+            return us as usize;
+        }
+        let octave = 63 - us.leading_zeros() as usize;
+        let sub = (us >> (octave - 3)) as usize & (SUB_BUCKETS - 1);
+        ((octave - 2) * SUB_BUCKETS + sub).min(LATENCY_BUCKETS - 1)
+    }
+
+    // Smallest value of the next bucket, so percentiles never understate
+    fn upper_bound(bucket: usize) -> u64 {
+        let next = bucket + 1;
+        if next < SUB_BUCKETS {
+            return next as u64;
+        }
+        let octave = next / SUB_BUCKETS + 2;
+        ((SUB_BUCKETS + next % SUB_BUCKETS) as u64) << (octave - 3)
+    }
+
+    pub(crate) fn record(&self, elapsed: Duration) {
+        let us = elapsed.as_micros().min(u64::MAX as u128) as u64;
+        self.buckets[Self::bucket(us)].fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub(crate) fn percentile(&self, fraction: f64) -> u64 {
+        let counts: Vec<u64> = self.buckets.iter().map(|b| b.load(Ordering::Relaxed)).collect();
+        let total: u64 = counts.iter().sum();
+        if total == 0 {
+            return 0;
+        }
+        let target = ((total as f64 * fraction).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (bucket, count) in counts.iter().enumerate() {
+            seen += count;
+            if seen >= target {
+                return Self::upper_bound(bucket);
+            }
+        }
+        Self::upper_bound(LATENCY_BUCKETS - 1)
+    }
+}
+
+/// Counters, in the order returned by `publish_pipeline_get_stats`
+struct PipelineStats {
+    frames_captured: AtomicU64,
+    capture_dropped: AtomicU64,
+    frames_encoded: AtomicU64,
+    frames_sent: AtomicU64,
+    send_dropped: AtomicU64,
+    bytes_sent: AtomicU64,
+    groups: AtomicU64,
+    errors: AtomicU64,
+    latency: [LatencyHistogram; STAGE_COUNT],
+}
+
+const COUNTER_LEN: usize = 8;
+
+/// Counters followed by p50 and p99 of each stage in microseconds
+pub const PIPELINE_STATS_LEN: usize = COUNTER_LEN + 2 * STAGE_COUNT;
+
+impl PipelineStats {
+    fn new() -> Self {
+        Self {
+            frames_captured: AtomicU64::new(0),
+            capture_dropped: AtomicU64::new(0),
+            frames_encoded: AtomicU64::new(0),
+            frames_sent: AtomicU64::new(0),
+            send_dropped: AtomicU64::new(0),
+            bytes_sent: AtomicU64::new(0),
+            groups: AtomicU64::new(0),
+            errors: AtomicU64::new(0),
+            latency: std::array::from_fn(|_| LatencyHistogram::new()),
+        }
+    }
+
+    fn record(&self, stage: Stage, elapsed: Duration) {
+        self.latency[stage as usize].record(elapsed);
+    }
+
+    fn snapshot(&self) -> [u64; PIPELINE_STATS_LEN] {
+        let counters = [
+            &self.frames_captured,
+            &self.capture_dropped,
+            &self.frames_encoded,
+            &self.frames_sent,
+            &self.send_dropped,
+            &self.bytes_sent,
+            &self.groups,
+            &self.errors,
+        ];
+        let mut out = [0u64; PIPELINE_STATS_LEN];
+        for (slot, counter) in out.iter_mut().zip(counters) {
+            *slot = counter.load(Ordering::Relaxed);
+        }
+        for (stage, histogram) in self.latency.iter().enumerate() {
+            out[COUNTER_LEN + 2 * stage] = histogram.percentile(0.50);
+            out[COUNTER_LEN + 2 * stage + 1] = histogram.percentile(0.99);
+        }
+        out
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Pipeline
+// -----------------------------------------------------------------------------
+
+struct RawFrame {
+    data: Vec<u8>,
+    captured: Instant,
+}
+
+// When a frame entered the encoder; x264 without B-frames or lookahead emits
+// access units in input order, so these are matched first in, first out
+struct InFlight {
+    captured: Instant,
+    encoding: Instant,
+}
+
+// State shared by the stage threads of a running pipeline
+struct Shared {
+    config: EncoderConfig,
+    started: Instant,
+    started_wallclock_ms: u64,
+    running: AtomicBool,
+    raw: BoundedQueue<RawFrame>,
+    packets: BoundedQueue<Packet>,
+    in_flight: Mutex<VecDeque<InFlight>>,
+    // Frame buffers recycled between capture and the encoder
+    pool: Mutex<Vec<Vec<u8>>>,
+    stats: Arc<PipelineStats>,
+}
+
+impl Shared {
+    // Copy a frame into a pooled buffer and queue it for the encoder
+    fn push_frame(&self, fill: impl FnOnce(&mut [u8])) {
+        let mut data = self.pool.lock().unwrap().pop().unwrap_or_default();
+        data.resize(self.config.frame_len(), 0);
+        fill(&mut data);
+        self.stats.frames_captured.fetch_add(1, Ordering::Relaxed);
+        let frame = RawFrame {
+            data,
+            captured: Instant::now(),
+        };
+        if let Some(evicted) = self.raw.push_evict(frame) {
+            self.stats.capture_dropped.fetch_add(1, Ordering::Relaxed);
+            self.pool.lock().unwrap().push(evicted.data);
+        }
+    }
+}
+
+struct Running {
+    shared: Arc<Shared>,
+    threads: Vec<JoinHandle<()>>,
+    encoder_input: Option<JoinHandle<()>>,
+    child: Option<Child>,
+}
+
+/// A native publisher for one video track
+pub struct PublishPipeline {
+    track: TrackConfig,
+    output: Mutex<Option<Box<dyn PublishOutput>>>,
+    running: Mutex<Option<Running>>,
+    stats: Arc<PipelineStats>,
+}
+
+impl PublishPipeline {
+    pub fn new(track: TrackConfig, output: Box<dyn PublishOutput>) -> Self {
+        Self {
+            track,
+            output: Mutex::new(Some(output)),
+            running: Mutex::new(None),
+            stats: Arc::new(PipelineStats::new()),
+        }
+    }
+
+    /// Start the stage threads around `encoder`; a pipeline runs only once
+    pub fn start(&self, config: EncoderConfig, encoder: EncoderProcess) -> Result<(), i32> {
+        if !config.is_valid() {
+            return Err(-3);
+        }
+        let mut running = self.running.lock().unwrap();
+        if running.is_some() {
+            return Err(-2);
+        }
+        let mut output = self.output.lock().unwrap().take().ok_or(-2)?;
+
+        let shared = Arc::new(Shared {
+            config,
+            started: Instant::now(),
+            started_wallclock_ms: SystemTime::now()
+                .duration_since(UNIX_EPOCH)
+                .map_or(0, |d| d.as_millis() as u64),
+            running: AtomicBool::new(true),
+            raw: BoundedQueue::new(RAW_QUEUE_DEPTH),
+            packets: BoundedQueue::new(PACKET_QUEUE_DEPTH),
+            in_flight: Mutex::new(VecDeque::new()),
+            pool: Mutex::new(Vec::new()),
+            stats: self.stats.clone(),
+        });
+        let EncoderProcess { input, output: encoded, child } = encoder;
+
+        let feeder = {
+            let shared = shared.clone();
+            std::thread::Builder::new()
+                .name("publish-encode-in".into())
+                .spawn(move || feed_encoder(&shared, input))
+                .map_err(|_| -4)?
+        };
+        let packager = {
+            let shared = shared.clone();
+            let mut packager = ObjectPackager::new(self.track, config.frame_duration_us());
+            std::thread::Builder::new()
+                .name("publish-package".into())
+                .spawn(move || read_encoder(&shared, encoded, &mut packager))
+                .map_err(|_| -4)?
+        };
+        let sender = {
+            let shared = shared.clone();
+            std::thread::Builder::new()
+                .name("publish-send".into())
+                .spawn(move || send_packets(&shared, output.as_mut()))
+                .map_err(|_| -4)?
+        };
+
+        log::info!(
+            "Started publish pipeline for track {}: {}x{} @ {} fps, {} bps, gop {}",
+            self.track.track_alias,
+            config.width,
+            config.height,
+            config.fps,
+            config.bitrate,
+            config.gop
+        );
+        *running = Some(Running {
+            shared,
+            threads: vec![packager, sender],
+            encoder_input: Some(feeder),
+            child,
+        });
+        Ok(())
+    }
+
+    fn shared(&self) -> Option<Arc<Shared>> {
+        let running = self.running.lock().unwrap();
+        running.as_ref().map(|r| r.shared.clone()).filter(|s| s.running.load(Ordering::Relaxed))
+    }
+
+    /// Queue an I420 frame of the configured size
+    pub fn push_frame(&self, data: &[u8]) -> Result<(), i32> {
+        let shared = self.shared().ok_or(-2)?;
+        if data.len() != shared.config.frame_len() {
+            return Err(-3);
+        }
+        shared.push_frame(|frame| frame.copy_from_slice(data));
+        Ok(())
+    }
+
+    /// Counters followed by per-stage latency percentiles
+    pub fn stats(&self) -> [u64; PIPELINE_STATS_LEN] {
+        self.stats.snapshot()
+    }
+
+    /// Stop capturing, flush the encoder and finish the open stream
+    pub fn stop(&self) {
+        let Some(mut running) = self.running.lock().unwrap().take() else {
+            return;
+        };
+        running.shared.running.store(false, Ordering::Relaxed);
+        running.shared.raw.close();
+        if let Some(feeder) = running.encoder_input.take() {
+            let _ = feeder.join();
+        }
+        // The encoder exits once it has flushed; one that does not is killed
+        // so the packaging thread sees the end of its output
+        if let Some(child) = running.child.as_mut() {
+            let deadline = Instant::now() + ENCODER_EXIT_TIMEOUT;
+            while matches!(child.try_wait(), Ok(None)) && Instant::now() < deadline {
+                std::thread::sleep(Duration::from_millis(10));
+            }
+            if matches!(child.try_wait(), Ok(None)) {
+                log::warn!("Encoder did not exit, killing it");
+                let _ = child.kill();
+                let _ = child.wait();
+            }
+        }
+        for thread in running.threads.drain(..) {
+            let _ = thread.join();
+        }
+        log::info!("Stopped publish pipeline for track {}", self.track.track_alias);
+    }
+
+    /// Grab frames from a screen capture at the configured frame rate
+    #[cfg(all(target_os = "linux", feature = "screen-capture"))]
+    pub fn attach_screen_capture(
+        &self,
+        capture: Arc<Mutex<crate::screen_capture::ScreenCapture>>,
+    ) -> Result<(), i32> {
+        let shared = self.shared().ok_or(-2)?;
+        let (width, height) = capture.lock().unwrap().output_size();
+        if (width as u32, height as u32) != (shared.config.width, shared.config.height) {
+            return Err(-3);
+        }
+        let thread = std::thread::Builder::new()
+            .name("publish-capture".into())
+            .spawn({
+                let shared = shared.clone();
+                move || capture_screen(&shared, &capture)
+            })
+            .map_err(|_| -4)?;
+        if let Some(running) = self.running.lock().unwrap().as_mut() {
+            running.threads.push(thread);
+        }
+        Ok(())
+    }
+}
+
+impl Drop for PublishPipeline {
+    fn drop(&mut self) {
+        self.stop();
+    }
+}
+
+#[cfg(all(target_os = "linux", feature = "screen-capture"))]
+fn capture_screen(shared: &Shared, capture: &Mutex<crate::screen_capture::ScreenCapture>) {
+    let interval = Duration::from_secs(1) / shared.config.fps;
+    let mut next = Instant::now();
+    while shared.running.load(Ordering::Relaxed) {
+        let grabbed = {
+            let mut capture = capture.lock().unwrap();
+            match capture.grab() {
+                Ok(_) => {
+                    shared.push_frame(|frame| frame.copy_from_slice(capture.i420()));
+                    true
+                }
+                Err(code) => {
+                    log::warn!("Screen capture for publishing failed: {}", code);
+                    false
+                }
+            }
+        };
+        if !grabbed {
+            shared.stats.errors.fetch_add(1, Ordering::Relaxed);
+        }
+        next += interval;
+        let now = Instant::now();
+        if next > now {
+            std::thread::sleep(next - now);
+        } else {
+            // Fell behind; skip the missed ticks rather than bursting
+            next = now;
+        }
+    }
+}
+
+fn feed_encoder(shared: &Shared, mut input: Box<dyn Write + Send>) {
+    while let Some(frame) = shared.raw.pop() {
+        let encoding = Instant::now();
+        shared.stats.record(Stage::Queue, encoding - frame.captured);
+        shared.in_flight.lock().unwrap().push_back(InFlight {
+            captured: frame.captured,
+            encoding,
+        });
+        let written = input.write_all(&frame.data).and_then(|_| input.flush());
+        shared.pool.lock().unwrap().push(frame.data);
+        if let Err(e) = written {
+            log::error!("Failed to write to encoder: {}", e);
+            shared.stats.errors.fetch_add(1, Ordering::Relaxed);
+            shared.running.store(false, Ordering::Relaxed);
+            break;
+        }
+    }
+    // Dropping the input lets the encoder flush and exit
+}
+
+fn read_encoder(shared: &Shared, output: Box<dyn Read + Send>, packager: &mut ObjectPackager) {
+    let mut reader = FlvReader::new(output);
+    loop {
+        let (keyframe, frame) = match reader.next() {
+            Ok(Some(Encoded::Config(avcc))) => {
+                packager.set_config(avcc);
+                continue;
+            }
+            Ok(Some(Encoded::Frame { keyframe, data })) => (keyframe, data),
+            Ok(None) => break,
+            Err(e) => {
+                log::error!("Failed to read encoder output: {}", e);
+                shared.stats.errors.fetch_add(1, Ordering::Relaxed);
+                break;
+            }
+        };
+        let encoded = Instant::now();
+        shared.stats.frames_encoded.fetch_add(1, Ordering::Relaxed);
+        let timing = shared.in_flight.lock().unwrap().pop_front();
+        let (captured, encoding) = timing.map_or((encoded, encoded), |t| (t.captured, t.encoding));
+        shared.stats.record(Stage::Encode, encoded - encoding);
+
+        let pts_us = (captured - shared.started).as_micros() as u64;
+        let wallclock_ms = shared.started_wallclock_ms + pts_us / 1000;
+        let Some((new_group, data)) = packager.package(keyframe, frame, pts_us, wallclock_ms) else {
+            shared.stats.send_dropped.fetch_add(1, Ordering::Relaxed);
+            continue;
+        };
+        let queued = Instant::now();
+        shared.stats.record(Stage::Package, queued - encoded);
+        let packet = Packet {
+            new_group,
+            data,
+            captured,
+            queued,
+        };
+        if shared.packets.try_push(packet).is_err() {
+            // The transport is behind: the rest of this group would not decode
+            shared.stats.send_dropped.fetch_add(1, Ordering::Relaxed);
+            packager.resync();
+        }
+    }
+    shared.packets.close();
+}
+
+fn send_packets(shared: &Shared, output: &mut dyn PublishOutput) {
+    let mut stream = None;
+    while let Some(packet) = shared.packets.pop() {
+        if packet.new_group {
+            if let Some(previous) = stream.take() {
+                output.finish(previous);
+            }
+            match output.open_stream() {
+                Ok(id) => {
+                    stream = Some(id);
+                    shared.stats.groups.fetch_add(1, Ordering::Relaxed);
+                }
+                Err(code) => {
+                    log::error!("Failed to open stream for publishing: {}", code);
+                    shared.stats.errors.fetch_add(1, Ordering::Relaxed);
+                }
+            }
+        }
+        // Without a stream the rest of the group is dropped
+        let Some(id) = stream else {
+            shared.stats.send_dropped.fetch_add(1, Ordering::Relaxed);
+            continue;
+        };
+        let len = packet.data.len() as u64;
+        if let Err(code) = output.write(id, packet.data) {
+            log::error!("Failed to write published frame: {}", code);
+            shared.stats.errors.fetch_add(1, Ordering::Relaxed);
+            shared.stats.send_dropped.fetch_add(1, Ordering::Relaxed);
+            output.finish(id);
+            stream = None;
+            continue;
+        }
+        let sent = Instant::now();
+        shared.stats.record(Stage::Send, sent - packet.queued);
+        shared.stats.record(Stage::Total, sent - packet.captured);
+        shared.stats.frames_sent.fetch_add(1, Ordering::Relaxed);
+        shared.stats.bytes_sent.fetch_add(len, Ordering::Relaxed);
+    }
+    if let Some(id) = stream {
+        output.finish(id);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FFI
+// -----------------------------------------------------------------------------
+
+static PIPELINES: Lazy<DashMap<u64, Arc<PublishPipeline>>> = Lazy::new(DashMap::new);
+static NEXT_PIPELINE_ID: AtomicU64 = AtomicU64::new(1);
+
+/// Register a pipeline and return its ID
+pub fn register_pipeline(pipeline: PublishPipeline) -> u64 {
+    let id = NEXT_PIPELINE_ID.fetch_add(1, Ordering::Relaxed);
+    PIPELINES.insert(id, Arc::new(pipeline));
+    id
+}
+
+fn pipeline(pipeline_id: u64) -> Option<Arc<PublishPipeline>> {
+    PIPELINES.get(&pipeline_id).map(|p| p.clone())
+}
+
+/// Start encoding and sending
+///
+/// # Arguments
+/// * `pipeline_id` - Pipeline from `moq_quic_publish_pipeline_create` or
+///   `moq_webtransport_publish_pipeline_create`
+/// * `width`, `height` - Frame size, even
+/// * `fps` - Frame rate
+/// * `bitrate` - Target bitrate in bits per second
+/// * `gop` - Frames per group
+///
+/// # Returns
+/// * 0 on success, -1 if the pipeline does not exist, -2 if it was already
+///   started, -3 for invalid settings, -4 if the encoder could not be started
+#[no_mangle]
+pub extern "C" fn publish_pipeline_start(
+    pipeline_id: u64,
+    width: u32,
+    height: u32,
+    fps: u32,
+    bitrate: u32,
+    gop: u32,
+) -> i32 {
+    let pipeline = match pipeline(pipeline_id) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let config = EncoderConfig { width, height, fps, bitrate, gop };
+    if !config.is_valid() {
+        return -3;
+    }
+    let encoder = match EncoderProcess::spawn_ffmpeg(&config) {
+        Ok(encoder) => encoder,
+        Err(e) => {
+            log::error!("Failed to start encoder: {}", e);
+            return -4;
+        }
+    };
+    match pipeline.start(config, encoder) {
+        Ok(()) => 0,
+        Err(code) => code,
+    }
+}
+
+/// Queue an I420 frame for encoding
+///
+/// The oldest queued frame is dropped when the encoder falls behind.
+///
+/// # Returns
+/// * 0 on success, -1 if the pipeline does not exist, -2 if it is not running,
+///   -3 if `len` is not the configured frame size
+#[no_mangle]
+pub extern "C" fn publish_pipeline_push_frame(pipeline_id: u64, data: *const u8, len: usize) -> i32 {
+    let pipeline = match pipeline(pipeline_id) {
+        Some(p) => p,
+        None => return -1,
+    };
+    if data.is_null() {
+        return -3;
+    }
+    let frame = unsafe { std::slice::from_raw_parts(data, len) };
+    match pipeline.push_frame(frame) {
+        Ok(()) => 0,
+        Err(code) => code,
+    }
+}
+
+/// Feed a running pipeline from a screen capture
+///
+/// # Arguments
+/// * `pipeline_id` - A started pipeline
+/// * `capture_id` - Capture from `screen_capture_open`, with an output size
+///   equal to the pipeline's frame size
+///
+/// # Returns
+/// * 0 on success, -1 if either does not exist, -2 if the pipeline is not
+///   running, -3 if the sizes differ
+#[cfg(all(target_os = "linux", feature = "screen-capture"))]
+#[no_mangle]
+pub extern "C" fn publish_pipeline_attach_screen_capture(pipeline_id: u64, capture_id: u64) -> i32 {
+    let (pipeline, capture) = match (pipeline(pipeline_id), crate::screen_capture::capture(capture_id)) {
+        (Some(p), Some(c)) => (p, c),
+        _ => return -1,
+    };
+    match pipeline.attach_screen_capture(capture) {
+        Ok(()) => 0,
+        Err(code) => code,
+    }
+}
+
+/// Get a pipeline's counters
+///
+/// # Arguments
+/// * `pipeline_id` - The pipeline
+/// * `out` - Output array: frames captured, frames dropped before encoding,
+///   frames encoded, frames sent, frames dropped before sending, bytes sent,
+///   groups, errors, then p50 and p99 in microseconds of the queue, encode,
+///   package, send and capture-to-send latencies
+/// * `len` - Capacity of `out`
+///
+/// # Returns
+/// * Number of values written, -1 if the pipeline does not exist
+#[no_mangle]
+pub extern "C" fn publish_pipeline_get_stats(pipeline_id: u64, out: *mut u64, len: usize) -> i32 {
+    let pipeline = match pipeline(pipeline_id) {
+        Some(p) => p,
+        None => return -1,
+    };
+    if out.is_null() {
+        return 0;
+    }
+    let stats = pipeline.stats();
+    let n = len.min(PIPELINE_STATS_LEN);
+    let out = unsafe { std::slice::from_raw_parts_mut(out, n) };
+    out.copy_from_slice(&stats[..n]);
+    n as i32
+}
+
+/// Stop a pipeline and release it
+///
+/// Flushes the encoder and finishes the open stream; blocks until the stage
+/// threads have exited.
+#[no_mangle]
+pub extern "C" fn publish_pipeline_destroy(pipeline_id: u64) {
+    if let Some((_, pipeline)) = PIPELINES.remove(&pipeline_id) {
+        pipeline.stop();
+        log::info!("Destroyed publish pipeline {}", pipeline_id);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::playback_sink::{Packaging, PlaybackOutput, PlaybackSink, SubgroupDeframer, TrackKind};
+
+    const TRACK: TrackConfig = TrackConfig {
+        track_alias: 3,
+        priority: 100,
+        version: 0xff00_000e,
+    };
+
+    // Baseline 1080p SPS and a PPS, as libx264 writes them
+    const SPS: &[u8] = &[0x67, 0x42, 0xc0, 0x28, 0xda, 0x01, 0xe0, 0x08, 0x9f, 0x96, 0x10, 0x00, 0x00];
+    const PPS: &[u8] = &[0x68, 0xce, 0x0f, 0xc8];
+
+    fn avc_config() -> Vec<u8> {
+        let mut avcc = vec![1, SPS[1], SPS[2], SPS[3], 0xff, 0xe1];
+        avcc.extend_from_slice(&(SPS.len() as u16).to_be_bytes());
+        avcc.extend_from_slice(SPS);
+        avcc.push(1);
+        avcc.extend_from_slice(&(PPS.len() as u16).to_be_bytes());
+        avcc.extend_from_slice(PPS);
+        avcc
+    }
+
+    // One AVCC NAL unit of `len` bytes
+    fn access_unit(keyframe: bool, len: usize) -> Vec<u8> {
+        let mut au = (len as u32).to_be_bytes().to_vec();
+        au.push(if keyframe { 0x65 } else { 0x41 });
+        au.resize(4 + len, 0xab);
+        au
+    }
+
+    fn flv_header() -> Vec<u8> {
+        [b"FLV".as_slice(), &[1, 0x01, 0, 0, 0, 9], &[0, 0, 0, 0]].concat()
+    }
+
+    fn flv_tag(kind: u8, body: &[u8]) -> Vec<u8> {
+        let size = (body.len() as u32).to_be_bytes();
+        let mut tag = vec![kind, size[1], size[2], size[3], 0, 0, 0, 0, 0, 0, 0];
+        tag.extend_from_slice(body);
+        tag.extend_from_slice(&(11 + body.len() as u32).to_be_bytes());
+        tag
+    }
+
+    fn flv_video(keyframe: bool, packet_type: u8, data: &[u8]) -> Vec<u8> {
+        let first = if keyframe { 0x17 } else { 0x27 };
+        flv_tag(9, &[&[first, packet_type, 0, 0, 0], data].concat())
+    }
+
+    // Returns a few bytes per read, like a pipe under load
+    struct Trickle<R>(R);
+
+    impl<R: Read> Read for Trickle<R> {
+        fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+            let n = buf.len().min(7);
+            self.0.read(&mut buf[..n])
+        }
+    }
+
+    /// Stands in for ffmpeg: reads whole I420 frames and answers each one with
+    /// an FLV tag, a keyframe every `gop` frames
+    fn stand_in_encoder(config: EncoderConfig, key_len: usize, delta_len: usize) -> EncoderProcess {
+        let (mut frames_in, frames) = std::io::pipe().unwrap();
+        let (flv, mut flv_out) = std::io::pipe().unwrap();
+        std::thread::spawn(move || {
+            let mut out = flv_header();
+            out.extend(flv_tag(18, b"onMetaData"));
+            out.extend(flv_video(true, 0, &avc_config()));
+            flv_out.write_all(&out).unwrap();
+            let mut frame = vec![0u8; config.frame_len()];
+            let mut index = 0u32;
+            while frames_in.read_exact(&mut frame).is_ok() {
+                let keyframe = index % config.gop == 0;
+                let au = access_unit(keyframe, if keyframe { key_len } else { delta_len });
+                if flv_out.write_all(&flv_video(keyframe, 1, &au)).is_err() {
+                    break;
+                }
+                index += 1;
+            }
+            let _ = flv_out.write_all(&flv_video(false, 2, &[]));
+        });
+        EncoderProcess::from_pipes(Box::new(frames), Box::new(flv))
+    }
+
+    #[derive(Clone, Default)]
+    struct Recorded {
+        streams: Arc<Mutex<Vec<(Vec<u8>, bool)>>>,
+    }
+
+    impl PublishOutput for Recorded {
+        fn open_stream(&mut self) -> Result<u64, i32> {
+            let mut streams = self.streams.lock().unwrap();
+            streams.push((Vec::new(), false));
+            Ok(streams.len() as u64 - 1)
+        }
+
+        fn write(&mut self, stream_id: u64, data: Vec<u8>) -> Result<(), i32> {
+            self.streams.lock().unwrap()[stream_id as usize].0.extend(data);
+            Ok(())
+        }
+
+        fn finish(&mut self, stream_id: u64) {
+            self.streams.lock().unwrap()[stream_id as usize].1 = true;
+        }
+    }
+
+    #[derive(Clone, Default)]
+    struct PlayerBuffer(Arc<Mutex<Vec<u8>>>);
+
+    impl PlaybackOutput for PlayerBuffer {
+        fn write(&self, parts: &[&[u8]]) -> usize {
+            let mut buffer = self.0.lock().unwrap();
+            parts.iter().map(|p| {
+                buffer.extend_from_slice(p);
+                p.len()
+            }).sum()
+        }
+
+        fn end(&self) {}
+    }
+
+    #[test]
+    fn flv_reader_cuts_avc_packets_across_reads() {
+        let key = access_unit(true, 300);
+        let delta = access_unit(false, 40);
+        let stream = [
+            flv_header(),
+            flv_tag(18, b"onMetaData"),
+            flv_video(true, 0, &avc_config()),
+            flv_tag(8, &[0xaf, 1, 2, 3]),
+            flv_video(true, 1, &key),
+            flv_video(false, 1, &delta),
+            flv_video(false, 2, &[]),
+        ]
+        .concat();
+
+        let mut reader = FlvReader::new(Trickle(stream.as_slice()));
+        assert_eq!(reader.next().unwrap(), Some(Encoded::Config(&avc_config())));
+        assert_eq!(reader.next().unwrap(), Some(Encoded::Frame { keyframe: true, data: &key }));
+        assert_eq!(reader.next().unwrap(), Some(Encoded::Frame { keyframe: false, data: &delta }));
+        assert_eq!(reader.next().unwrap(), None);
+
+        let mut reader = FlvReader::new(&b"\x00\x00\x00\x09not an flv stream"[..]);
+        assert!(reader.next().is_err());
+    }
+
+    // The packaged streams are what the native subscriber expects
+    fn play_packaged(version: u64) {
+        let track = TrackConfig { version, ..TRACK };
+        let mut packager = ObjectPackager::new(track, 16_666);
+        packager.set_config(&avc_config());
+        let mut streams: Vec<Vec<u8>> = Vec::new();
+        for index in 0..12u64 {
+            let keyframe = index % 5 == 0;
+            let au = access_unit(keyframe, 100 + index as usize);
+            let (new_group, data) = packager.package(keyframe, &au, index * 16_666, 1_700_000_000_000).unwrap();
+            assert_eq!(new_group, keyframe);
+            if new_group {
+                streams.push(Vec::new());
+            }
+            streams.last_mut().unwrap().extend(data);
+        }
+        assert_eq!(streams.len(), 3);
+
+        let buffer = PlayerBuffer::default();
+        let sink = PlaybackSink::new(Packaging::MoqMi, 1920, 1080, Box::new(buffer.clone()));
+        let mut objects = Vec::new();
+        for stream in &streams {
+            let mut deframer = SubgroupDeframer::new();
+            deframer
+                .push(stream, &mut |object| {
+                    objects.push((object.group_id, object.object_id));
+                    sink.on_object(TrackKind::Video, object, version >= DELTA_KVP_VERSION);
+                })
+                .unwrap();
+            deframer.finish().unwrap();
+        }
+        assert_eq!(objects[..6], [(1, 0), (1, 1), (1, 2), (1, 3), (1, 4), (2, 0)]);
+        assert_eq!(objects.last(), Some(&(3, 1)));
+        let stats = sink.stats();
+        assert_eq!(stats[2], 12, "video frames");
+        assert_eq!(stats[4], 0, "skipped frames");
+        assert_eq!(&buffer.0.lock().unwrap()[4..8], b"ftyp");
+    }
+
+    #[test]
+    fn packaged_objects_play_through_the_native_sink() {
+        play_packaged(0xff00_000e);
+        play_packaged(DELTA_KVP_VERSION);
+    }
+
+    #[test]
+    fn packager_drops_to_the_next_keyframe_after_a_resync() {
+        let mut packager = ObjectPackager::new(TRACK, 16_666);
+        assert!(packager.package(false, &access_unit(false, 10), 0, 0).is_none());
+        assert!(packager.package(true, &access_unit(true, 10), 0, 0).is_some());
+        assert!(packager.package(false, &access_unit(false, 10), 0, 0).is_some());
+        packager.resync();
+        assert!(packager.package(false, &access_unit(false, 10), 0, 0).is_none());
+        let (new_group, data) = packager.package(true, &access_unit(true, 10), 0, 0).unwrap();
+        assert!(new_group);
+        // Header type, alias 3, group 2, priority
+        assert_eq!(&data[..4], &[0x11, 3, 2, 100]);
+    }
+
+    #[test]
+    fn latency_percentiles_round_up_to_their_bucket() {
+        let histogram = LatencyHistogram::new();
+        for us in 1..=100u64 {
+            histogram.record(Duration::from_micros(us * 100));
+        }
+        let p50 = histogram.percentile(0.50);
+        let p99 = histogram.percentile(0.99);
+        assert!((5_000..=5_000 * 9 / 8 + 1).contains(&p50), "p50 {}", p50);
+        assert!((9_900..=9_900 * 9 / 8 + 1).contains(&p99), "p99 {}", p99);
+        for us in [0, 1, 7, 8, 9, 15, 16, 1000, 123_456] {
+            let bucket = LatencyHistogram::bucket(us);
+            assert!(LatencyHistogram::upper_bound(bucket) > us);
+            assert!(bucket == 0 || LatencyHistogram::upper_bound(bucket - 1) <= us);
+        }
+    }
+
+    #[test]
+    fn pipeline_publishes_one_stream_per_group() {
+        let config = EncoderConfig { width: 64, height: 48, fps: 30, bitrate: 500_000, gop: 10 };
+        let output = Recorded::default();
+        let pipeline = PublishPipeline::new(TRACK, Box::new(output.clone()));
+        assert_eq!(pipeline.push_frame(&[0; 16]), Err(-2));
+        pipeline.start(config, stand_in_encoder(config, 500, 50)).unwrap();
+        assert_eq!(pipeline.start(config, stand_in_encoder(config, 500, 50)), Err(-2));
+        assert_eq!(pipeline.push_frame(&[0; 16]), Err(-3));
+
+        let frame = vec![0x80u8; config.frame_len()];
+        let mut pushed = 0;
+        while pushed < 25 {
+            // Stay under the queue depth so no frame is dropped
+            if pipeline.stats.frames_encoded.load(Ordering::Relaxed) + 1 >= pushed {
+                pipeline.push_frame(&frame).unwrap();
+                pushed += 1;
+            } else {
+                std::thread::sleep(Duration::from_millis(1));
+            }
+        }
+        pipeline.stop();
+
+        let stats = pipeline.stats();
+        assert_eq!(stats[..8], [25, 0, 25, 25, 0, stats[5], 3, 0]);
+        let streams = output.streams.lock().unwrap();
+        assert_eq!(streams.len(), 3);
+        assert!(streams.iter().all(|(_, finished)| *finished));
+        assert_eq!(streams[2].0[..4], [0x11, 3, 3, 100]);
+        assert_eq!(stats[5], streams.iter().map(|(data, _)| data.len() as u64).sum::<u64>());
+        // Every stage recorded a latency
+        assert!(stats[COUNTER_LEN + 2 * Stage::Total as usize + 1] > 0);
+    }
+
+    // Sends at most one frame per call, blocking like a congested transport
+    struct Congested {
+        delay: Duration,
+        frames: Arc<AtomicU64>,
+    }
+
+    impl PublishOutput for Congested {
+        fn open_stream(&mut self) -> Result<u64, i32> {
+            Ok(0)
+        }
+
+        fn write(&mut self, _stream_id: u64, _data: Vec<u8>) -> Result<(), i32> {
+            std::thread::sleep(self.delay);
+            self.frames.fetch_add(1, Ordering::Relaxed);
+            Ok(())
+        }
+
+        fn finish(&mut self, _stream_id: u64) {}
+    }
+
+    #[test]
+    fn congestion_drops_whole_groups_instead_of_blocking_capture() {
+        let config = EncoderConfig { width: 16, height: 16, fps: 60, bitrate: 100_000, gop: 8 };
+        let frames = Arc::new(AtomicU64::new(0));
+        let output = Congested { delay: Duration::from_millis(5), frames: frames.clone() };
+        let pipeline = PublishPipeline::new(TRACK, Box::new(output));
+        pipeline.start(config, stand_in_encoder(config, 64, 16)).unwrap();
+
+        let frame = vec![0u8; config.frame_len()];
+        let start = Instant::now();
+        for _ in 0..400 {
+            pipeline.push_frame(&frame).unwrap();
+            std::thread::sleep(Duration::from_micros(100));
+        }
+        // Capture never waits for the transport
+        assert!(start.elapsed() < Duration::from_millis(400 * 5 / 2));
+        pipeline.stop();
+
+        let stats = pipeline.stats();
+        let dropped = stats[1] + stats[4];
+        assert!(dropped > 0, "stats {:?}", stats);
+        assert_eq!(stats[0], 400);
+        assert_eq!(stats[3], frames.load(Ordering::Relaxed));
+    }
+
+    /// Benchmark: 1080p60 capture to transport
+    ///
+    /// Pushes a moving test pattern at 60 fps for ten seconds and reports the
+    /// latency of each stage. The first run uses a stand-in encoder to measure
+    /// the pipeline itself (frame copies, pipes, packaging, queues); the second
+    /// uses ffmpeg/libx264 when it is installed. The budget is one frame interval
+    /// (16.7 ms) at p99 from capture to the transport.
+    ///
+    /// Run with: cargo test --release bench_publish_pipeline_1080p60 -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_publish_pipeline_1080p60() {
+        let config = EncoderConfig { width: 1920, height: 1080, fps: 60, bitrate: 6_000_000, gop: 120 };
+        let frames = 600u64;
+
+        let run = |name: &str, encoder: EncoderProcess| {
+            let sent = Arc::new(AtomicU64::new(0));
+            let output = Congested { delay: Duration::ZERO, frames: sent.clone() };
+            let pipeline = PublishPipeline::new(TRACK, Box::new(output));
+            pipeline.start(config, encoder).unwrap();
+
+            let mut pattern = vec![0u8; config.frame_len()];
+            let interval = Duration::from_secs(1) / config.fps;
+            let start = Instant::now();
+            for index in 0..frames {
+                // A diagonal gradient moving two pixels per frame
+                let (width, height) = (config.width as usize, config.height as usize);
+                for (y, row) in pattern[..width * height].chunks_mut(width).enumerate() {
+                    for (x, pixel) in row.iter_mut().enumerate() {
+                        *pixel = (x + y + 2 * index as usize) as u8;
+                    }
+                }
+                pipeline.push_frame(&pattern).unwrap();
+                let next = start + interval * (index as u32 + 1);
+                if let Some(wait) = next.checked_duration_since(Instant::now()) {
+                    std::thread::sleep(wait);
+                }
+            }
+            pipeline.stop();
+
+            let stats = pipeline.stats();
+            let latency = |stage: Stage| {
+                let at = COUNTER_LEN + 2 * stage as usize;
+                (stats[at] as f64 / 1000.0, stats[at + 1] as f64 / 1000.0)
+            };
+            println!("{}", name);
+            println!(
+                "  frames {} captured, {} dropped before encoding, {} sent, {} dropped before sending, {:.1} Mbit/s",
+                stats[0],
+                stats[1],
+                stats[3],
+                stats[4],
+                stats[5] as f64 * 8.0 / 1e6 / (frames as f64 / config.fps as f64)
+            );
+            for stage in [Stage::Queue, Stage::Encode, Stage::Package, Stage::Send, Stage::Total] {
+                let (p50, p99) = latency(stage);
+                println!("  {:<8} p50 {:>7.2} ms  p99 {:>7.2} ms", format!("{:?}", stage), p50, p99);
+            }
+            let (_, p99) = latency(Stage::Total);
+            println!(
+                "  capture to transport p99 {:.2} ms: {} the {:.1} ms budget",
+                p99,
+                if p99 <= 1000.0 / config.fps as f64 { "within" } else { "OVER" },
+                1000.0 / config.fps as f64
+            );
+        };
+
+        run("stand-in encoder", stand_in_encoder(config, 120_000, 12_000));
+        match Command::new("ffmpeg").arg("-version").output() {
+            Ok(out) if out.status.success() => {
+                run("ffmpeg libx264 ultrafast/zerolatency", EncoderProcess::spawn_ffmpeg(&config).unwrap())
+            }
+            _ => println!("ffmpeg not found, skipping the libx264 run"),
+        }
+    }
+}
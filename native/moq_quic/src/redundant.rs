@@ -0,0 +1,567 @@
+// Redundant multi-relay subscriptions
+//
+// One track is subscribed through several relay sessions at once (each a
+// "path"), and every path's subgroup streams are routed to the same native
+// track (crate::playback_sink). A `PathMerger` in front of the track's sinks
+// lets the first copy of each (group, object) through and drops the rest, so
+// a stall on one relay costs nothing as long as another one delivers.
+//
+// - Each copy after the first is timed against the first arrival; that lag
+//   is the path's arrival delay (0 when the path won)
+// - Objects a path has not delivered when they leave the dedup window count
+//   as missing and are sampled as a full window of lag
+// - A path whose smoothed lag stays `demote_lag` above the best active path
+//   is demoted, and promoted again once its lag drops below half of that.
+//   Demotion is reported as an event; the subscriber lowers the path's
+//   subscriber priority, so its relay only spends spare capacity on it,
+//   while its copies still fill any gap of the other paths
+// - At least one path always stays active
+
+use crate::playback_sink::{self, Route, TrackKind};
+use crate::publish_pipeline::LatencyHistogram;
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+use std::collections::{BTreeMap, HashMap, VecDeque};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+
+/// Paths one track can be merged from
+pub const MAX_PATHS: usize = 8;
+
+/// Number of values reported by `redundant_track_get_path_stats`
+pub const PATH_STATS_LEN: usize = 9;
+
+// Weight of a new lag sample in the smoothed lag
+const LAG_EWMA_WEIGHT: f64 = 1.0 / 32.0;
+
+/// Merger tuning
+#[derive(Debug, Clone, Copy)]
+pub struct MergerConfig {
+    /// How long an object is remembered for deduplication
+    pub window: Duration,
+    /// Smoothed lag behind the best path that demotes a path
+    pub demote_lag: Duration,
+    /// Lag samples a path needs before it is judged
+    pub min_samples: u64,
+}
+
+impl Default for MergerConfig {
+    fn default() -> Self {
+        Self {
+            window: Duration::from_secs(3),
+            demote_lag: Duration::from_millis(40),
+            min_samples: 90,
+        }
+    }
+}
+
+/// A path changed role
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MergerEvent {
+    Demoted(usize),
+    Promoted(usize),
+}
+
+impl MergerEvent {
+    /// (kind, path) as reported over FFI
+    pub fn to_raw(self) -> (i32, u32) {
+        match self {
+            MergerEvent::Demoted(path) => (1, path as u32),
+            MergerEvent::Promoted(path) => (2, path as u32),
+        }
+    }
+}
+
+struct PathState {
+    added: Instant,
+    active: bool,
+    demoted: bool,
+    objects: u64,
+    wins: u64,
+    duplicates: u64,
+    missing: u64,
+    late: u64,
+    samples: u64,
+    lag_ewma_us: f64,
+    lag: LatencyHistogram,
+}
+
+impl PathState {
+    fn new(now: Instant) -> Self {
+        Self {
+            added: now,
+            active: true,
+            demoted: false,
+            objects: 0,
+            wins: 0,
+            duplicates: 0,
+            missing: 0,
+            late: 0,
+            samples: 0,
+            lag_ewma_us: 0.0,
+            lag: LatencyHistogram::new(),
+        }
+    }
+}
+
+struct Arrival {
+    first: Instant,
+    /// Bit per path that delivered the object
+    delivered: u32,
+}
+
+/// First-arrival deduplication across paths, with per-path lag
+pub struct PathMerger {
+    config: MergerConfig,
+    paths: Vec<PathState>,
+    groups: BTreeMap<u64, HashMap<u64, Arrival>>,
+    /// Groups by first arrival, for expiry
+    order: VecDeque<(Instant, u64)>,
+    /// Groups below this have expired; their objects are late
+    expired_below: u64,
+    events: VecDeque<MergerEvent>,
+}
+
+impl PathMerger {
+    pub fn new(config: MergerConfig) -> Self {
+        Self {
+            config,
+            paths: Vec::new(),
+            groups: BTreeMap::new(),
+            order: VecDeque::new(),
+            expired_below: 0,
+            events: VecDeque::new(),
+        }
+    }
+
+    /// Add a path; None if `MAX_PATHS` are in use
+    pub fn add_path(&mut self, now: Instant) -> Option<usize> {
+        if let Some(index) = self.paths.iter().position(|p| !p.active) {
+            self.paths[index] = PathState::new(now);
+            return Some(index);
+        }
+        if self.paths.len() == MAX_PATHS {
+            return None;
+        }
+        self.paths.push(PathState::new(now));
+        Some(self.paths.len() - 1)
+    }
+
+    /// Stop expecting objects from a path
+    pub fn remove_path(&mut self, path: usize) {
+        let Some(state) = self.paths.get_mut(path) else { return };
+        state.active = false;
+        if state.demoted {
+            state.demoted = false;
+        } else {
+            // Its role passes to the best demoted path, if it was the last active one
+            self.promote_if_alone();
+        }
+    }
+
+    /// An object arrived on `path`; returns whether it is the first copy
+    pub fn admit(&mut self, path: usize, group: u64, object: u64, now: Instant) -> bool {
+        self.expire(now);
+        if path >= self.paths.len() {
+            return false;
+        }
+        self.paths[path].objects += 1;
+        if group < self.expired_below {
+            self.paths[path].late += 1;
+            return false;
+        }
+
+        if !self.groups.contains_key(&group) {
+            self.order.push_back((now, group));
+        }
+        let bit = 1u32 << path;
+        let lag = match self.groups.entry(group).or_default().entry(object) {
+            std::collections::hash_map::Entry::Vacant(entry) => {
+                entry.insert(Arrival { first: now, delivered: bit });
+                self.paths[path].wins += 1;
+                None
+            }
+            std::collections::hash_map::Entry::Occupied(mut entry) => {
+                let arrival = entry.get_mut();
+                self.paths[path].duplicates += 1;
+                if arrival.delivered & bit != 0 {
+                    return false;
+                }
+                arrival.delivered |= bit;
+                Some(now.saturating_duration_since(arrival.first))
+            }
+        };
+        self.sample(path, lag.unwrap_or(Duration::ZERO));
+        lag.is_none()
+    }
+
+    // Forget groups older than the window, charging paths that missed objects
+    fn expire(&mut self, now: Instant) {
+        while let Some(&(first, group)) = self.order.front() {
+            if now.saturating_duration_since(first) < self.config.window {
+                break;
+            }
+            self.order.pop_front();
+            self.expired_below = self.expired_below.max(group + 1);
+            let Some(objects) = self.groups.remove(&group) else { continue };
+            for arrival in objects.values() {
+                for path in 0..self.paths.len() {
+                    let state = &self.paths[path];
+                    if state.active && state.added <= arrival.first && arrival.delivered & (1 << path) == 0 {
+                        self.paths[path].missing += 1;
+                        self.sample(path, self.config.window);
+                    }
+                }
+            }
+        }
+    }
+
+    fn sample(&mut self, path: usize, lag: Duration) {
+        let state = &mut self.paths[path];
+        state.lag.record(lag);
+        let us = lag.as_micros() as f64;
+        state.lag_ewma_us = if state.samples == 0 { us } else { state.lag_ewma_us + (us - state.lag_ewma_us) * LAG_EWMA_WEIGHT };
+        state.samples += 1;
+        self.update_role(path);
+    }
+
+    fn judged(&self, path: usize) -> bool {
+        self.paths[path].active && self.paths[path].samples >= self.config.min_samples
+    }
+
+    fn update_role(&mut self, path: usize) {
+        if !self.judged(path) {
+            return;
+        }
+        let threshold = self.config.demote_lag.as_micros() as f64;
+        let lag = self.paths[path].lag_ewma_us;
+        if self.paths[path].demoted {
+            if lag < threshold / 2.0 {
+                self.paths[path].demoted = false;
+                self.events.push_back(MergerEvent::Promoted(path));
+            }
+            return;
+        }
+        let best_other = (0..self.paths.len())
+            .filter(|&i| i != path && self.judged(i) && !self.paths[i].demoted)
+            .map(|i| self.paths[i].lag_ewma_us)
+            .fold(None, |best: Option<f64>, l| Some(best.map_or(l, |b| b.min(l))));
+        if best_other.is_some_and(|best| lag > best + threshold) {
+            self.paths[path].demoted = true;
+            self.events.push_back(MergerEvent::Demoted(path));
+        }
+    }
+
+    fn promote_if_alone(&mut self) {
+        if self.paths.iter().any(|p| p.active && !p.demoted) {
+            return;
+        }
+        let best = (0..self.paths.len())
+            .filter(|&i| self.paths[i].active)
+            .min_by(|&a, &b| self.paths[a].lag_ewma_us.total_cmp(&self.paths[b].lag_ewma_us));
+        if let Some(path) = best {
+            self.paths[path].demoted = false;
+            self.events.push_back(MergerEvent::Promoted(path));
+        }
+    }
+
+    pub fn is_demoted(&self, path: usize) -> bool {
+        self.paths.get(path).is_some_and(|p| p.demoted)
+    }
+
+    pub fn poll_event(&mut self) -> Option<MergerEvent> {
+        self.events.pop_front()
+    }
+
+    /// Objects, wins, duplicates, missing, late, lag p50 (µs), lag p99 (µs),
+    /// smoothed lag (µs), demoted
+    pub fn path_stats(&self, path: usize) -> Option<[u64; PATH_STATS_LEN]> {
+        let p = self.paths.get(path)?;
+        Some([
+            p.objects,
+            p.wins,
+            p.duplicates,
+            p.missing,
+            p.late,
+            p.lag.percentile(0.5),
+            p.lag.percentile(0.99),
+            p.lag_ewma_us as u64,
+            p.demoted as u64,
+        ])
+    }
+}
+
+// -----------------------------------------------------------------------------
+// FFI
+// -----------------------------------------------------------------------------
+
+static REDUNDANT_TRACKS: Lazy<DashMap<u64, Arc<Route>>> = Lazy::new(DashMap::new);
+static NEXT_REDUNDANT_ID: AtomicU64 = AtomicU64::new(1);
+
+/// A redundant track, for routing its paths
+pub fn get_redundant_track(track_id: u64) -> Option<Arc<Route>> {
+    REDUNDANT_TRACKS.get(&track_id).map(|t| t.clone())
+}
+
+/// Create a track that merges the paths routed to it
+/// (`moq_quic_route_redundant_path` / `moq_webtransport_route_redundant_path`)
+///
+/// # Arguments
+/// * `track` - 0 for video, 1 for audio
+/// * `version` - Negotiated MoQ version (the same on every path)
+/// * `replay_bytes` - Bound of the track's replay cache (0 = none)
+/// * `demote_lag_ms` - Smoothed lag behind the best path that demotes a path
+///   (0 = 40 ms)
+///
+/// # Returns
+/// Track ID, or 0 if the track kind is invalid
+#[no_mangle]
+pub extern "C" fn redundant_track_create(track: i32, version: u64, replay_bytes: u64, demote_lag_ms: u32) -> u64 {
+    let Some(track) = TrackKind::from_raw(track) else { return 0 };
+    let mut config = MergerConfig::default();
+    if demote_lag_ms > 0 {
+        config.demote_lag = Duration::from_millis(demote_lag_ms as u64);
+    }
+    let route = Route::redundant(track, version, replay_bytes as usize, config);
+    let id = NEXT_REDUNDANT_ID.fetch_add(1, Ordering::Relaxed);
+    REDUNDANT_TRACKS.insert(id, route);
+    log::info!("Created redundant track {}", id);
+    id
+}
+
+/// Play the merged track through a playback sink
+///
+/// # Returns
+/// 0 on success, -1 if the track or sink does not exist
+#[no_mangle]
+pub extern "C" fn redundant_track_attach_sink(track_id: u64, sink_id: u64) -> i32 {
+    match (get_redundant_track(track_id), playback_sink::get_sink(sink_id)) {
+        (Some(track), Some(sink)) => {
+            track.attach(sink);
+            0
+        }
+        _ => -1,
+    }
+}
+
+/// Get one path's counters
+///
+/// Values, in order: objects, wins, duplicates, missing, late, lag p50 (µs),
+/// lag p99 (µs), smoothed lag (µs), demoted (0/1).
+///
+/// # Returns
+/// Number of values written, or -1 if the track or path does not exist
+#[no_mangle]
+pub extern "C" fn redundant_track_get_path_stats(track_id: u64, path: u32, out: *mut u64, len: usize) -> i32 {
+    if out.is_null() {
+        return -1;
+    }
+    let Some(track) = get_redundant_track(track_id) else { return -1 };
+    let Some(values) = track.path_stats(path as usize) else { return -1 };
+    let count = values.len().min(len);
+    unsafe { std::slice::from_raw_parts_mut(out, count) }.copy_from_slice(&values[..count]);
+    count as i32
+}
+
+/// Take the next path event: kind 1 = demoted, 2 = promoted
+///
+/// # Returns
+/// 1 if an event was written, 0 if none is pending, -1 if the track does not
+/// exist
+#[no_mangle]
+pub extern "C" fn redundant_track_poll_event(track_id: u64, out_kind: *mut i32, out_path: *mut u32) -> i32 {
+    let Some(track) = get_redundant_track(track_id) else { return -1 };
+    let Some(event) = track.poll_event() else { return 0 };
+    let (kind, path) = event.to_raw();
+    unsafe {
+        if !out_kind.is_null() {
+            *out_kind = kind;
+        }
+        if !out_path.is_null() {
+            *out_path = path;
+        }
+    }
+    1
+}
+
+/// Destroy a redundant track; unroute its paths first
+#[no_mangle]
+pub extern "C" fn redundant_track_destroy(track_id: u64) {
+    if REDUNDANT_TRACKS.remove(&track_id).is_some() {
+        log::info!("Destroyed redundant track {}", track_id);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Impairment applied to one path: a base one-way delay, and packet loss
+    // that QUIC repairs by retransmission. A lost packet delays its object by
+    // a retransmission timeout, and every later object of the same subgroup
+    // stream waits behind it (head-of-line blocking). With `blackhole` the
+    // path stops delivering altogether.
+    struct Impairment {
+        delay: Duration,
+        loss: f64,
+        rto: Duration,
+        blackhole: bool,
+        rng: u64,
+    }
+
+    impl Impairment {
+        fn clean(delay_ms: u64) -> Self {
+            Self { delay: Duration::from_millis(delay_ms), loss: 0.0, rto: Duration::ZERO, blackhole: false, rng: 0x2545_F491_4F6C_DD1D }
+        }
+
+        fn lossy(delay_ms: u64, loss: f64) -> Self {
+            Self { loss, rto: Duration::from_millis(3 * delay_ms.max(20)), ..Self::clean(delay_ms) }
+        }
+
+        fn random(&mut self) -> f64 {
+            self.rng ^= self.rng << 13;
+            self.rng ^= self.rng >> 7;
+            self.rng ^= self.rng << 17;
+            (self.rng >> 11) as f64 / (1u64 << 53) as f64
+        }
+
+        // Arrival of an object of `packets` packets sent at `sent`, on a
+        // stream whose previous object arrived at `stream_ready`
+        fn arrival(&mut self, sent: Duration, packets: usize, stream_ready: Duration) -> Option<Duration> {
+            if self.blackhole {
+                return None;
+            }
+            let mut arrival = sent + self.delay;
+            for _ in 0..packets {
+                if self.random() < self.loss {
+                    arrival = arrival.max(sent + self.delay + self.rto);
+                }
+            }
+            Some(arrival.max(stream_ready))
+        }
+    }
+
+    // Send `groups` 1s groups of 30 objects (keyframe 40 packets, others 5)
+    // over each path; returns (first arrivals in order, events)
+    fn run(merger: &mut PathMerger, paths: &mut [Impairment], start: Instant, first_group: u64, groups: u64) -> (Vec<(u64, u64)>, Vec<MergerEvent>) {
+        let mut arrivals = Vec::new();
+        for g in first_group..first_group + groups {
+            let mut ready = vec![Duration::ZERO; paths.len()];
+            for o in 0..30u64 {
+                let sent = Duration::from_millis(g * 1000 + o * 33);
+                let packets = if o == 0 { 40 } else { 5 };
+                for (path, impairment) in paths.iter_mut().enumerate() {
+                    if let Some(at) = impairment.arrival(sent, packets, ready[path]) {
+                        ready[path] = at;
+                        arrivals.push((at, path, g, o));
+                    }
+                }
+            }
+        }
+        arrivals.sort_by_key(|a| a.0);
+        let mut delivered = Vec::new();
+        for (at, path, g, o) in arrivals {
+            if merger.admit(path, g, o, start + at) {
+                delivered.push((g, o));
+            }
+        }
+        let mut events = Vec::new();
+        while let Some(e) = merger.poll_event() {
+            events.push(e);
+        }
+        (delivered, events)
+    }
+
+    #[test]
+    fn first_arrival_wins_and_duplicates_are_dropped() {
+        let start = Instant::now();
+        let mut merger = PathMerger::new(MergerConfig::default());
+        let a = merger.add_path(start).unwrap();
+        let b = merger.add_path(start).unwrap();
+        assert!(merger.admit(b, 1, 0, start + Duration::from_millis(10)));
+        assert!(!merger.admit(a, 1, 0, start + Duration::from_millis(25)));
+        assert!(merger.admit(a, 1, 1, start + Duration::from_millis(30)));
+        assert!(!merger.admit(b, 1, 1, start + Duration::from_millis(31)));
+        // A repeat on the same path is not a second lag sample
+        assert!(!merger.admit(b, 1, 1, start + Duration::from_millis(40)));
+
+        let a_stats = merger.path_stats(a).unwrap();
+        assert_eq!(&a_stats[..5], &[2, 1, 1, 0, 0]);
+        assert!((15_000..=16_384).contains(&a_stats[6]), "p99 {}", a_stats[6]);
+        let b_stats = merger.path_stats(b).unwrap();
+        assert_eq!(&b_stats[..3], &[3, 1, 2]);
+
+        // After the window, group 1 is forgotten and its stragglers are late
+        assert!(!merger.admit(a, 1, 2, start + Duration::from_secs(4)));
+        assert_eq!(merger.path_stats(a).unwrap()[4], 1);
+        assert!(merger.admit(a, 2, 0, start + Duration::from_secs(4)));
+    }
+
+    #[test]
+    fn lossy_path_is_demoted_and_promoted_when_it_recovers() {
+        let start = Instant::now();
+        let mut merger = PathMerger::new(MergerConfig::default());
+        let mut paths = [Impairment::clean(30), Impairment::lossy(25, 0.15)];
+        for _ in 0..2 {
+            merger.add_path(start).unwrap();
+        }
+
+        let (delivered, events) = run(&mut merger, &mut paths, start, 0, 20);
+        // Every object exactly once, despite the loss
+        assert_eq!(delivered.len(), 20 * 30);
+        let mut unique = delivered.clone();
+        unique.sort();
+        unique.dedup();
+        assert_eq!(unique.len(), delivered.len());
+        assert_eq!(events, vec![MergerEvent::Demoted(1)]);
+        assert!(merger.is_demoted(1));
+        let lossy = merger.path_stats(1).unwrap();
+        let clean = merger.path_stats(0).unwrap();
+        assert!(lossy[5] > clean[6], "lossy {:?} clean {:?}", lossy, clean);
+
+        // The impairment moves to the other path: roles swap
+        paths[0] = Impairment::lossy(30, 0.15);
+        paths[1] = Impairment::clean(25);
+        let (delivered, events) = run(&mut merger, &mut paths, start, 20, 20);
+        assert_eq!(delivered.len(), 20 * 30);
+        assert_eq!(events, vec![MergerEvent::Promoted(1), MergerEvent::Demoted(0)]);
+    }
+
+    #[test]
+    fn blackholed_path_is_charged_for_missing_objects() {
+        let start = Instant::now();
+        let mut merger = PathMerger::new(MergerConfig::default());
+        let mut paths = [Impairment::clean(20), Impairment::clean(20)];
+        merger.add_path(start).unwrap();
+        merger.add_path(start).unwrap();
+        run(&mut merger, &mut paths, start, 0, 5);
+        assert!(merger.poll_event().is_none());
+
+        paths[1].blackhole = true;
+        let (delivered, events) = run(&mut merger, &mut paths, start, 5, 10);
+        assert_eq!(delivered.len(), 10 * 30);
+        assert_eq!(events, vec![MergerEvent::Demoted(1)]);
+        assert!(merger.path_stats(1).unwrap()[3] > 0);
+
+        // Removing the only active path hands its role to the demoted one
+        merger.remove_path(0);
+        assert_eq!(merger.poll_event(), Some(MergerEvent::Promoted(1)));
+        assert!(!merger.is_demoted(1));
+        assert_eq!(merger.add_path(start), Some(0));
+    }
+
+    #[test]
+    fn ffi_round_trip() {
+        assert_eq!(redundant_track_create(7, 0, 0, 0), 0);
+        let id = redundant_track_create(0, 0, 0, 0);
+        assert_ne!(id, 0);
+        assert_eq!(redundant_track_attach_sink(id, u64::MAX), -1);
+        let mut stats = [0u64; PATH_STATS_LEN];
+        assert_eq!(redundant_track_get_path_stats(id, 0, stats.as_mut_ptr(), stats.len()), -1);
+        let (mut kind, mut path) = (0, 0);
+        assert_eq!(redundant_track_poll_event(id, &mut kind, &mut path), 0);
+        redundant_track_destroy(id);
+        assert_eq!(redundant_track_poll_event(id, &mut kind, &mut path), -1);
+    }
+}
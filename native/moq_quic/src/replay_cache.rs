@@ -0,0 +1,262 @@
+// GOP-aware replay cache for late-attaching consumers
+//
+// The Dart subscription replays its last 60 objects to new listeners,
+// whatever they are: often a partial group that cannot be decoded, or many
+// MB of 4K frames. A replay cache keeps exactly what a decoder needs to
+// start: the newest group, from its first object on, and nothing older.
+//
+// - Caching starts at the first object 0 seen; a new group's object 0
+//   drops every older group
+// - Objects are kept sorted by (group, object), so a subgroup that arrives
+//   ahead of the group's first object still replays after it
+// - The cache is bounded in payload bytes; a group that outgrows the bound
+//   is dropped whole, since its tail is useless without its start, and
+//   caching resumes at the next group
+// - Payloads are `Bytes`: objects that were assembled across reads are
+//   moved in without copying, and every consumer replays the same buffers
+
+use crate::playback_sink::ObjectRef;
+use bytes::Bytes;
+use std::collections::VecDeque;
+
+/// An object held by the cache
+#[derive(Clone)]
+pub struct CachedObject {
+    pub group: u64,
+    pub object: u64,
+    pub status: u64,
+    pub extensions: Bytes,
+    pub payload: Bytes,
+}
+
+impl CachedObject {
+    /// Take an object, sharing its payload when it is reference counted
+    pub fn from_ref(object: &ObjectRef<'_>) -> Self {
+        Self {
+            group: object.group_id,
+            object: object.object_id,
+            status: object.status,
+            extensions: Bytes::copy_from_slice(object.extensions),
+            payload: object.shared.cloned().unwrap_or_else(|| Bytes::copy_from_slice(object.payload)),
+        }
+    }
+
+    /// View as a deframed object, to hand to a sink
+    pub fn as_ref(&self) -> ObjectRef<'_> {
+        ObjectRef {
+            group_id: self.group,
+            object_id: self.object,
+            status: self.status,
+            extensions: &self.extensions,
+            payload: &self.payload,
+            shared: Some(&self.payload),
+        }
+    }
+
+    fn size(&self) -> usize {
+        self.extensions.len() + self.payload.len()
+    }
+}
+
+/// Cache counters
+#[derive(Debug, Default, Clone, Copy)]
+pub struct ReplayCacheStats {
+    /// Groups replaced by a newer group
+    pub groups: u64,
+    /// Groups dropped for outgrowing the byte bound
+    pub overflowed: u64,
+    /// Objects older than the cached group, or before any group start
+    pub ignored: u64,
+}
+
+/// The newest decodable group of one track
+pub struct ReplayCache {
+    max_bytes: usize,
+    /// Group whose object 0 starts the cache
+    group: Option<u64>,
+    /// Sorted by (group, object)
+    objects: VecDeque<CachedObject>,
+    bytes: usize,
+    stats: ReplayCacheStats,
+}
+
+impl ReplayCache {
+    pub fn new(max_bytes: usize) -> Self {
+        Self {
+            max_bytes,
+            group: None,
+            objects: VecDeque::new(),
+            bytes: 0,
+            stats: ReplayCacheStats::default(),
+        }
+    }
+
+    /// Add an object of the live stream
+    pub fn push(&mut self, object: CachedObject) {
+        let key = (object.group, object.object);
+        match self.group {
+            _ if object.object == 0 && self.group.map_or(true, |g| object.group > g) => {
+                // A newer group start; keep only objects of this group and later
+                if self.group.is_some() {
+                    self.stats.groups += 1;
+                }
+                while self.objects.front().is_some_and(|o| o.group < object.group) {
+                    let dropped = self.objects.pop_front().unwrap();
+                    self.bytes -= dropped.size();
+                }
+                self.group = Some(object.group);
+            }
+            Some(g) if object.group >= g => {}
+            _ => {
+                self.stats.ignored += 1;
+                return;
+            }
+        }
+
+        self.bytes += object.size();
+        match self.objects.back() {
+            Some(last) if (last.group, last.object) >= key => {
+                match self.objects.binary_search_by(|o| (o.group, o.object).cmp(&key)) {
+                    Ok(i) => {
+                        self.bytes -= self.objects[i].size();
+                        self.objects[i] = object;
+                    }
+                    Err(i) => self.objects.insert(i, object),
+                }
+            }
+            _ => self.objects.push_back(object),
+        }
+
+        if self.bytes > self.max_bytes {
+            self.stats.overflowed += 1;
+            self.clear();
+        }
+    }
+
+    /// Objects to replay, starting at the cached group's first object
+    pub fn objects(&self) -> impl Iterator<Item = &CachedObject> {
+        self.objects.iter()
+    }
+
+    /// Payload and extension bytes held
+    pub fn bytes(&self) -> usize {
+        self.bytes
+    }
+
+    pub fn len(&self) -> usize {
+        self.objects.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.objects.is_empty()
+    }
+
+    /// The group a replay starts at, if a group start is cached
+    pub fn start_group(&self) -> Option<u64> {
+        self.group
+    }
+
+    pub fn stats(&self) -> ReplayCacheStats {
+        self.stats
+    }
+
+    /// Forget everything and wait for the next group start
+    pub fn clear(&mut self) {
+        self.objects.clear();
+        self.bytes = 0;
+        self.group = None;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn obj(group: u64, object: u64, len: usize) -> CachedObject {
+        CachedObject {
+            group,
+            object,
+            status: 0,
+            extensions: Bytes::new(),
+            payload: Bytes::from(vec![group as u8; len]),
+        }
+    }
+
+    fn keys(cache: &ReplayCache) -> Vec<(u64, u64)> {
+        cache.objects().map(|o| (o.group, o.object)).collect()
+    }
+
+    #[test]
+    fn starts_at_latest_group() {
+        let mut cache = ReplayCache::new(1 << 20);
+        // Joined mid-group: nothing is decodable yet
+        cache.push(obj(4, 7, 10));
+        assert!(cache.is_empty());
+        assert_eq!(cache.start_group(), None);
+
+        for g in 5..8 {
+            for o in 0..3 {
+                cache.push(obj(g, o, 100));
+            }
+        }
+        assert_eq!(keys(&cache), vec![(7, 0), (7, 1), (7, 2)]);
+        assert_eq!(cache.bytes(), 300);
+        assert_eq!(cache.stats().groups, 2);
+
+        // A late object of an older group is not cached
+        cache.push(obj(6, 3, 100));
+        assert_eq!(cache.len(), 3);
+        assert_eq!(cache.stats().ignored, 2);
+    }
+
+    #[test]
+    fn next_group_ahead_of_its_start() {
+        let mut cache = ReplayCache::new(1 << 20);
+        cache.push(obj(1, 0, 10));
+        // Group 2's second subgroup arrives before its first object
+        cache.push(obj(2, 5, 10));
+        cache.push(obj(1, 1, 10));
+        assert_eq!(keys(&cache), vec![(1, 0), (1, 1), (2, 5)]);
+        cache.push(obj(2, 0, 10));
+        assert_eq!(keys(&cache), vec![(2, 0), (2, 5)]);
+        assert_eq!(cache.bytes(), 20);
+
+        // A duplicate replaces the earlier copy
+        cache.push(obj(2, 5, 30));
+        assert_eq!(cache.len(), 2);
+        assert_eq!(cache.bytes(), 40);
+    }
+
+    #[test]
+    fn oversized_group_is_dropped_whole() {
+        let mut cache = ReplayCache::new(1000);
+        cache.push(obj(1, 0, 600));
+        cache.push(obj(1, 1, 600));
+        assert!(cache.is_empty());
+        assert_eq!(cache.stats().overflowed, 1);
+        // The rest of that group is not cached either
+        cache.push(obj(1, 2, 10));
+        assert!(cache.is_empty());
+        cache.push(obj(2, 0, 500));
+        assert_eq!(keys(&cache), vec![(2, 0)]);
+    }
+
+    #[test]
+    fn shares_assembled_payloads() {
+        let payload = Bytes::from(vec![7u8; 4096]);
+        let object = ObjectRef {
+            group_id: 3,
+            object_id: 0,
+            status: 0,
+            extensions: &[1, 2],
+            payload: &payload,
+            shared: Some(&payload),
+        };
+        let cached = CachedObject::from_ref(&object);
+        assert_eq!(cached.payload.as_ptr(), payload.as_ptr());
+        assert_eq!(cached.as_ref().payload.as_ptr(), payload.as_ptr());
+
+        let borrowed = ObjectRef { shared: None, ..object };
+        assert_ne!(CachedObject::from_ref(&borrowed).payload.as_ptr(), payload.as_ptr());
+    }
+}
@@ -0,0 +1,1150 @@
+// Linux screen capture with damage-aware conversion
+//
+// Desktop content is mostly static: a slide or an editor changes a few tiles
+// a second, if at all. Converting and encoding every captured frame anyway
+// costs a full BGRA -> I420 pass and an encoder run each tick.
+//
+// Architecture:
+// - A frame source grabs the root window (or one window) into shared memory
+//   with XShmGetImage, so the X server writes straight into our buffer
+// - The frame is compared against the previous one in 32x32 tiles with SIMD
+//   compares; identical frames stop here
+// - Only the dirty tiles are converted and scaled into a persistent I420
+//   frame, so a moving cursor converts a handful of tiles, not 2M pixels
+// - Dart only receives (and encodes) frames that changed; repeated frames of
+//   a static screen are sent at a low rate and become skip frames
+
+use std::os::raw::{c_char, c_int};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::Instant;
+
+/// Edge of a damage tile in source pixels
+pub const TILE: usize = 32;
+
+// Bytes per source pixel (BGRA / BGRX)
+const BPP: usize = 4;
+
+/// A captured BGRA frame borrowed from its source
+pub struct Frame<'a> {
+    pub data: &'a [u8],
+    pub width: usize,
+    pub height: usize,
+    /// Bytes per row
+    pub stride: usize,
+}
+
+impl Frame<'_> {
+    fn row(&self, y: usize, x: usize, pixels: usize) -> &[u8] {
+        let start = y * self.stride + x * BPP;
+        &self.data[start..start + pixels * BPP]
+    }
+}
+
+/// Something that produces BGRA frames of a fixed size
+pub trait FrameSource: Send {
+    fn size(&self) -> (usize, usize);
+
+    /// Capture the current contents
+    fn grab(&mut self) -> Result<Frame<'_>, i32>;
+}
+
+// -----------------------------------------------------------------------------
+// Damage detection
+// -----------------------------------------------------------------------------
+
+/// Finds the tiles that changed since the previous frame
+pub struct DamageDetector {
+    width: usize,
+    height: usize,
+    columns: usize,
+    rows: usize,
+    // Packed copy of the previous frame (stride = width * BPP)
+    previous: Vec<u8>,
+    dirty: Vec<bool>,
+    primed: bool,
+}
+
+impl DamageDetector {
+    pub fn new(width: usize, height: usize) -> Self {
+        let columns = width.div_ceil(TILE);
+        let rows = height.div_ceil(TILE);
+        Self {
+            width,
+            height,
+            columns,
+            rows,
+            previous: vec![0; width * height * BPP],
+            dirty: vec![true; columns * rows],
+            primed: false,
+        }
+    }
+
+    /// Tiles per row and per column
+    pub fn grid(&self) -> (usize, usize) {
+        (self.columns, self.rows)
+    }
+
+    /// Dirty flag per tile, row-major, as of the last `detect`
+    pub fn dirty(&self) -> &[bool] {
+        &self.dirty
+    }
+
+    /// Forget the previous frame, so the next one is entirely dirty
+    pub fn reset(&mut self) {
+        self.primed = false;
+    }
+
+    /// Mark the tiles of `frame` that differ from the previous frame and
+    /// remember them; returns the number of dirty tiles
+    pub fn detect(&mut self, frame: &Frame) -> usize {
+        debug_assert!(frame.width == self.width && frame.height == self.height);
+        let row_bytes = self.width * BPP;
+
+        if !self.primed {
+            for y in 0..self.height {
+                self.previous[y * row_bytes..(y + 1) * row_bytes]
+                    .copy_from_slice(frame.row(y, 0, self.width));
+            }
+            self.dirty.fill(true);
+            self.primed = true;
+            return self.dirty.len();
+        }
+
+        self.dirty.fill(false);
+        let mut count = 0;
+        for ty in 0..self.rows {
+            let y0 = ty * TILE;
+            let y1 = (y0 + TILE).min(self.height);
+            let band = &mut self.dirty[ty * self.columns..(ty + 1) * self.columns];
+
+            // Walk the band row by row so both frames are read sequentially;
+            // tiles already known dirty are not compared again
+            let mut band_dirty = 0;
+            for y in y0..y1 {
+                if band_dirty == self.columns {
+                    break;
+                }
+                let current = frame.row(y, 0, self.width);
+                let previous = &self.previous[y * row_bytes..(y + 1) * row_bytes];
+                for (tx, dirty) in band.iter_mut().enumerate() {
+                    if *dirty {
+                        continue;
+                    }
+                    let start = tx * TILE * BPP;
+                    let end = ((tx + 1) * TILE).min(self.width) * BPP;
+                    if !bytes_equal(&current[start..end], &previous[start..end]) {
+                        *dirty = true;
+                        band_dirty += 1;
+                    }
+                }
+            }
+            if band_dirty == 0 {
+                continue;
+            }
+            count += band_dirty;
+
+            for y in y0..y1 {
+                let current = frame.row(y, 0, self.width);
+                let previous = &mut self.previous[y * row_bytes..(y + 1) * row_bytes];
+                for (tx, _) in band.iter().enumerate().filter(|(_, d)| **d) {
+                    let start = tx * TILE * BPP;
+                    let end = ((tx + 1) * TILE).min(self.width) * BPP;
+                    previous[start..end].copy_from_slice(&current[start..end]);
+                }
+            }
+        }
+        count
+    }
+}
+
+/// Whether two byte slices of equal length are identical
+pub fn bytes_equal(a: &[u8], b: &[u8]) -> bool {
+    if a.len() != b.len() {
+        return false;
+    }
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::is_x86_feature_detected!("avx2") {
+            // SAFETY: AVX2 support was checked at runtime
+            return unsafe { bytes_equal_avx2(a, b) };
+        }
+    }
+    bytes_equal_lanes(a, b)
+}
+
+// Four u64 lanes (32 bytes) per step, XOR-accumulated without early exit,
+// which LLVM maps onto SSE2 on x86_64 and NEON on aarch64
+fn bytes_equal_lanes(a: &[u8], b: &[u8]) -> bool {
+    let mut a_chunks = a.chunks_exact(32);
+    let mut b_chunks = b.chunks_exact(32);
+    let mut diff = 0u64;
+    for (x, y) in (&mut a_chunks).zip(&mut b_chunks) {
+        for i in 0..4 {
+            let xa = u64::from_ne_bytes(x[i * 8..i * 8 + 8].try_into().unwrap());
+            let ya = u64::from_ne_bytes(y[i * 8..i * 8 + 8].try_into().unwrap());
+            diff |= xa ^ ya;
+        }
+    }
+    diff == 0 && a_chunks.remainder() == b_chunks.remainder()
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn bytes_equal_avx2(a: &[u8], b: &[u8]) -> bool {
+    use std::arch::x86_64::*;
+
+    let len = a.len();
+    let mut diff = _mm256_setzero_si256();
+    let mut i = 0;
+    while i + 32 <= len {
+        let x = _mm256_loadu_si256(a.as_ptr().add(i) as *const __m256i);
+        let y = _mm256_loadu_si256(b.as_ptr().add(i) as *const __m256i);
+        diff = _mm256_or_si256(diff, _mm256_xor_si256(x, y));
+        i += 32;
+    }
+    _mm256_testz_si256(diff, diff) == 1 && a[i..] == b[i..]
+}
+
+// -----------------------------------------------------------------------------
+// Conversion
+// -----------------------------------------------------------------------------
+
+/// Scales BGRA into a persistent I420 frame, a region at a time
+///
+/// Pixels are sampled nearest-neighbour; chroma averages the four samples of
+/// each 2x2 block. Coefficients are BT.601 limited range, matching what the
+/// encoders in this project signal.
+pub struct I420Scaler {
+    out_width: usize,
+    out_height: usize,
+    // Source column / row sampled by each output column / row
+    x_map: Vec<usize>,
+    y_map: Vec<usize>,
+    // First output column / row sampling each source tile (plus an end entry)
+    tile_x: Vec<usize>,
+    tile_y: Vec<usize>,
+    i420: Vec<u8>,
+}
+
+impl I420Scaler {
+    /// `out_width` and `out_height` must be even
+    pub fn new(width: usize, height: usize, out_width: usize, out_height: usize) -> Self {
+        let map = |out: usize, src: usize| -> Vec<usize> {
+            (0..out).map(|o| ((2 * o + 1) * src / (2 * out)).min(src - 1)).collect()
+        };
+        let starts = |mapping: &[usize], tiles: usize| -> Vec<usize> {
+            (0..=tiles)
+                .map(|t| mapping.partition_point(|&s| s < t * TILE))
+                .collect()
+        };
+        let x_map = map(out_width, width);
+        let y_map = map(out_height, height);
+        let tile_x = starts(&x_map, width.div_ceil(TILE));
+        let tile_y = starts(&y_map, height.div_ceil(TILE));
+        let luma = out_width * out_height;
+        Self {
+            out_width,
+            out_height,
+            x_map,
+            y_map,
+            tile_x,
+            tile_y,
+            i420: vec![0; luma + luma / 2],
+        }
+    }
+
+    pub fn output_size(&self) -> (usize, usize) {
+        (self.out_width, self.out_height)
+    }
+
+    /// The I420 frame as of the last conversion
+    pub fn i420(&self) -> &[u8] {
+        &self.i420
+    }
+
+    /// Convert everything
+    pub fn convert_all(&mut self, frame: &Frame) {
+        self.convert_region(frame, 0, 0, self.out_width, self.out_height);
+    }
+
+    /// Convert the output pixels sampling the dirty tiles of `dirty`
+    pub fn convert_dirty(&mut self, frame: &Frame, dirty: &[bool], columns: usize) {
+        for (ty, band) in dirty.chunks(columns).enumerate() {
+            let y0 = self.tile_y[ty] & !1;
+            let y1 = round_even(self.tile_y[ty + 1]).min(self.out_height);
+            if y0 >= y1 {
+                continue;
+            }
+            // Merge runs of dirty tiles into one region
+            let mut tx = 0;
+            while tx < columns {
+                if !band[tx] {
+                    tx += 1;
+                    continue;
+                }
+                let run = tx;
+                while tx < columns && band[tx] {
+                    tx += 1;
+                }
+                let x0 = self.tile_x[run] & !1;
+                let x1 = round_even(self.tile_x[tx]).min(self.out_width);
+                if x0 < x1 {
+                    self.convert_region(frame, x0, y0, x1, y1);
+                }
+            }
+        }
+    }
+
+    // Convert output columns x0..x1 and rows y0..y1 (all even)
+    fn convert_region(&mut self, frame: &Frame, x0: usize, y0: usize, x1: usize, y1: usize) {
+        let width = self.out_width;
+        let luma = width * self.out_height;
+        let (y_plane, chroma) = self.i420.split_at_mut(luma);
+        let (u_plane, v_plane) = chroma.split_at_mut(luma / 4);
+
+        for oy in (y0..y1).step_by(2) {
+            let top = &frame.data[self.y_map[oy] * frame.stride..];
+            let bottom = &frame.data[self.y_map[oy + 1] * frame.stride..];
+            for ox in (x0..x1).step_by(2) {
+                let (left, right) = (self.x_map[ox] * BPP, self.x_map[ox + 1] * BPP);
+                let pixels = [
+                    &top[left..left + 3],
+                    &top[right..right + 3],
+                    &bottom[left..left + 3],
+                    &bottom[right..right + 3],
+                ];
+                let (mut b, mut g, mut r) = (0i32, 0i32, 0i32);
+                for (i, p) in pixels.iter().enumerate() {
+                    let (pb, pg, pr) = (p[0] as i32, p[1] as i32, p[2] as i32);
+                    let index = (oy + i / 2) * width + ox + i % 2;
+                    y_plane[index] = (((66 * pr + 129 * pg + 25 * pb + 128) >> 8) + 16) as u8;
+                    b += pb;
+                    g += pg;
+                    r += pr;
+                }
+                let (b, g, r) = ((b + 2) >> 2, (g + 2) >> 2, (r + 2) >> 2);
+                let index = (oy / 2) * (width / 2) + ox / 2;
+                u_plane[index] = (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128) as u8;
+                v_plane[index] = (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128) as u8;
+            }
+        }
+    }
+}
+
+fn round_even(value: usize) -> usize {
+    (value + 1) & !1
+}
+
+// -----------------------------------------------------------------------------
+// Capture pipeline
+// -----------------------------------------------------------------------------
+
+/// Counters of a capture session
+#[derive(Debug, Clone, Copy, Default)]
+pub struct CaptureStats {
+    pub frames: u64,
+    pub changed_frames: u64,
+    /// Dirty tiles summed over all frames
+    pub dirty_tiles: u64,
+    /// Tiles per frame
+    pub tiles_per_frame: u64,
+    /// Time spent grabbing from the source
+    pub grab_us: u64,
+    /// Time spent detecting damage and converting
+    pub process_us: u64,
+}
+
+/// Grabs frames and keeps an I420 copy of the screen up to date
+pub struct ScreenCapture {
+    source: Box<dyn FrameSource>,
+    detector: DamageDetector,
+    scaler: I420Scaler,
+    stats: CaptureStats,
+}
+
+impl ScreenCapture {
+    /// Capture `source`, scaled to `out_width` x `out_height` (0 = source
+    /// size); odd sizes are rounded down to even
+    pub fn new(source: Box<dyn FrameSource>, out_width: usize, out_height: usize) -> Self {
+        let (width, height) = source.size();
+        let out_width = if out_width == 0 { width } else { out_width } & !1;
+        let out_height = if out_height == 0 { height } else { out_height } & !1;
+        let detector = DamageDetector::new(width, height);
+        let (columns, rows) = detector.grid();
+        Self {
+            source,
+            detector,
+            scaler: I420Scaler::new(width, height, out_width.max(2), out_height.max(2)),
+            stats: CaptureStats {
+                tiles_per_frame: (columns * rows) as u64,
+                ..Default::default()
+            },
+        }
+    }
+
+    pub fn output_size(&self) -> (usize, usize) {
+        self.scaler.output_size()
+    }
+
+    /// Grab a frame; returns whether the screen changed since the last one
+    pub fn grab(&mut self) -> Result<bool, i32> {
+        let start = Instant::now();
+        let frame = self.source.grab()?;
+        let grabbed = Instant::now();
+
+        let dirty = self.detector.detect(&frame);
+        if dirty > 0 {
+            let (columns, _) = self.detector.grid();
+            self.scaler.convert_dirty(&frame, self.detector.dirty(), columns);
+        }
+
+        self.stats.frames += 1;
+        self.stats.dirty_tiles += dirty as u64;
+        if dirty > 0 {
+            self.stats.changed_frames += 1;
+        }
+        self.stats.grab_us += (grabbed - start).as_micros() as u64;
+        self.stats.process_us += grabbed.elapsed().as_micros() as u64;
+        Ok(dirty > 0)
+    }
+
+    /// The current screen contents
+    pub fn i420(&self) -> &[u8] {
+        self.scaler.i420()
+    }
+
+    /// Treat the next frame as entirely changed
+    pub fn invalidate(&mut self) {
+        self.detector.reset();
+    }
+
+    pub fn stats(&self) -> CaptureStats {
+        self.stats
+    }
+}
+
+// -----------------------------------------------------------------------------
+// X11 shared-memory source
+// -----------------------------------------------------------------------------
+
+mod x11 {
+    use std::os::raw::{c_char, c_int, c_long, c_uint, c_ulong, c_void};
+
+    pub type Display = c_void;
+    pub type Window = c_ulong;
+
+    pub const ZPIXMAP: c_int = 2;
+    pub const ALL_PLANES: c_ulong = !0;
+
+    /// Leading fields of `XImage`
+    #[repr(C)]
+    pub struct XImage {
+        pub width: c_int,
+        pub height: c_int,
+        pub xoffset: c_int,
+        pub format: c_int,
+        pub data: *mut c_char,
+        pub byte_order: c_int,
+        pub bitmap_unit: c_int,
+        pub bitmap_bit_order: c_int,
+        pub bitmap_pad: c_int,
+        pub depth: c_int,
+        pub bytes_per_line: c_int,
+        pub bits_per_pixel: c_int,
+    }
+
+    #[repr(C)]
+    pub struct XErrorEvent {
+        pub kind: c_int,
+        pub display: *mut Display,
+        pub resourceid: c_ulong,
+        pub serial: c_ulong,
+        pub error_code: u8,
+        pub request_code: u8,
+        pub minor_code: u8,
+    }
+
+    pub type ErrorHandler = Option<unsafe extern "C" fn(*mut Display, *mut XErrorEvent) -> c_int>;
+
+    #[repr(C)]
+    pub struct XShmSegmentInfo {
+        pub shmseg: c_ulong,
+        pub shmid: c_int,
+        pub shmaddr: *mut c_char,
+        pub read_only: c_int,
+    }
+
+    #[repr(C)]
+    pub struct XWindowAttributes {
+        pub x: c_int,
+        pub y: c_int,
+        pub width: c_int,
+        pub height: c_int,
+        pub border_width: c_int,
+        pub depth: c_int,
+        pub visual: *mut c_void,
+        pub root: Window,
+        pub class: c_int,
+        pub bit_gravity: c_int,
+        pub win_gravity: c_int,
+        pub backing_store: c_int,
+        pub backing_planes: c_ulong,
+        pub backing_pixel: c_ulong,
+        pub save_under: c_int,
+        pub colormap: c_ulong,
+        pub map_installed: c_int,
+        pub map_state: c_int,
+        pub all_event_masks: c_long,
+        pub your_event_mask: c_long,
+        pub do_not_propagate_mask: c_long,
+        pub override_redirect: c_int,
+        pub screen: *mut c_void,
+    }
+
+    #[link(name = "X11")]
+    extern "C" {
+        pub fn XOpenDisplay(name: *const c_char) -> *mut Display;
+        pub fn XCloseDisplay(display: *mut Display) -> c_int;
+        pub fn XDefaultRootWindow(display: *mut Display) -> Window;
+        pub fn XGetWindowAttributes(
+            display: *mut Display,
+            window: Window,
+            attributes: *mut XWindowAttributes,
+        ) -> c_int;
+        pub fn XSync(display: *mut Display, discard: c_int) -> c_int;
+        pub fn XFree(data: *mut c_void) -> c_int;
+        pub fn XSetErrorHandler(handler: ErrorHandler) -> ErrorHandler;
+    }
+
+    #[link(name = "Xext")]
+    extern "C" {
+        pub fn XShmQueryExtension(display: *mut Display) -> c_int;
+        pub fn XShmCreateImage(
+            display: *mut Display,
+            visual: *mut c_void,
+            depth: c_uint,
+            format: c_int,
+            data: *mut c_char,
+            shminfo: *mut XShmSegmentInfo,
+            width: c_uint,
+            height: c_uint,
+        ) -> *mut XImage;
+        pub fn XShmAttach(display: *mut Display, shminfo: *mut XShmSegmentInfo) -> c_int;
+        pub fn XShmDetach(display: *mut Display, shminfo: *mut XShmSegmentInfo) -> c_int;
+        pub fn XShmGetImage(
+            display: *mut Display,
+            drawable: Window,
+            image: *mut XImage,
+            x: c_int,
+            y: c_int,
+            plane_mask: c_ulong,
+        ) -> c_int;
+    }
+}
+
+thread_local! {
+    // Error code of the last X error trapped on this thread (0 = none)
+    static X_ERROR: std::cell::Cell<u8> = const { std::cell::Cell::new(0) };
+}
+
+unsafe extern "C" fn record_x_error(_display: *mut x11::Display, event: *mut x11::XErrorEvent) -> c_int {
+    X_ERROR.with(|e| e.set((*event).error_code));
+    0
+}
+
+/// Turns X errors raised while it is held into an `Err` instead of Xlib's
+/// default handler, which exits the process
+///
+/// Xlib calls the handler on the thread that reads the error, so the code is
+/// kept per thread.
+struct XErrorTrap {
+    display: *mut x11::Display,
+    previous: x11::ErrorHandler,
+}
+
+impl XErrorTrap {
+    unsafe fn new(display: *mut x11::Display) -> Self {
+        X_ERROR.with(|e| e.set(0));
+        Self {
+            display,
+            previous: x11::XSetErrorHandler(Some(record_x_error)),
+        }
+    }
+
+    /// Wait for the server to process the requests sent so far, and fail
+    /// with `code` if any of them raised an error
+    unsafe fn sync(&self, code: i32) -> Result<(), i32> {
+        x11::XSync(self.display, 0);
+        match X_ERROR.with(|e| e.replace(0)) {
+            0 => Ok(()),
+            _ => Err(code),
+        }
+    }
+}
+
+impl Drop for XErrorTrap {
+    fn drop(&mut self) {
+        unsafe {
+            x11::XSetErrorHandler(self.previous);
+        }
+    }
+}
+
+/// Captures an X11 window (or the whole screen) through MIT-SHM
+///
+/// Works on X11 sessions and, for X11 windows, under XWayland.
+pub struct XShmSource {
+    display: *mut x11::Display,
+    window: x11::Window,
+    image: *mut x11::XImage,
+    // Boxed: Xlib keeps a pointer to it for the lifetime of the image
+    shminfo: Box<x11::XShmSegmentInfo>,
+    // The server attached the segment and must detach it
+    attached: bool,
+    width: usize,
+    height: usize,
+}
+
+// The display connection is only used by the capture that owns it
+unsafe impl Send for XShmSource {}
+
+impl XShmSource {
+    /// Open `display` (None = $DISPLAY) and capture `window` (0 = root)
+    pub fn open(display: Option<&std::ffi::CStr>, window: u64) -> Result<Self, i32> {
+        unsafe {
+            let display = x11::XOpenDisplay(display.map_or(std::ptr::null(), |d| d.as_ptr()));
+            if display.is_null() {
+                return Err(-2);
+            }
+            let mut source = Self {
+                display,
+                window: 0,
+                image: std::ptr::null_mut(),
+                shminfo: Box::new(std::mem::zeroed()),
+                attached: false,
+                width: 0,
+                height: 0,
+            };
+            if x11::XShmQueryExtension(display) == 0 {
+                return Err(-3);
+            }
+            source.window = if window == 0 {
+                x11::XDefaultRootWindow(display)
+            } else {
+                window as x11::Window
+            };
+            // A bad window ID raises BadWindow
+            let trap = XErrorTrap::new(display);
+            let mut attributes: x11::XWindowAttributes = std::mem::zeroed();
+            if x11::XGetWindowAttributes(display, source.window, &mut attributes) == 0 {
+                return Err(-4);
+            }
+            trap.sync(-4)?;
+            source.width = attributes.width as usize;
+            source.height = attributes.height as usize;
+
+            source.image = x11::XShmCreateImage(
+                display,
+                attributes.visual,
+                attributes.depth as u32,
+                x11::ZPIXMAP,
+                std::ptr::null_mut(),
+                &mut *source.shminfo,
+                attributes.width as u32,
+                attributes.height as u32,
+            );
+            if source.image.is_null() {
+                return Err(-3);
+            }
+            let image = &*source.image;
+            if image.bits_per_pixel != 32 {
+                return Err(-3);
+            }
+
+            let size = image.bytes_per_line as usize * image.height as usize;
+            let shmid = libc::shmget(libc::IPC_PRIVATE, size, libc::IPC_CREAT | 0o600);
+            if shmid < 0 {
+                return Err(-5);
+            }
+            let address = libc::shmat(shmid, std::ptr::null(), 0);
+            // Marked for removal right away; it lives until both sides detach
+            if address as isize == -1 {
+                libc::shmctl(shmid, libc::IPC_RMID, std::ptr::null_mut());
+                return Err(-5);
+            }
+            source.shminfo.shmid = shmid;
+            source.shminfo.shmaddr = address as *mut c_char;
+            source.shminfo.read_only = 0;
+            (*source.image).data = address as *mut c_char;
+
+            // Fails asynchronously, e.g. for a remote X server
+            let attached = x11::XShmAttach(display, &mut *source.shminfo);
+            let synced = trap.sync(-5);
+            libc::shmctl(shmid, libc::IPC_RMID, std::ptr::null_mut());
+            if attached == 0 {
+                return Err(-5);
+            }
+            synced?;
+            source.attached = true;
+            Ok(source)
+        }
+    }
+}
+
+impl FrameSource for XShmSource {
+    fn size(&self) -> (usize, usize) {
+        (self.width, self.height)
+    }
+
+    fn grab(&mut self) -> Result<Frame<'_>, i32> {
+        unsafe {
+            // Fails with BadMatch or BadWindow when the window was resized,
+            // unmapped or destroyed
+            // (a round trip, so any error was handled before it returns)
+            let _trap = XErrorTrap::new(self.display);
+            if x11::XShmGetImage(self.display, self.window, self.image, 0, 0, x11::ALL_PLANES) == 0 {
+                return Err(-6);
+            }
+            let image = &*self.image;
+            let stride = image.bytes_per_line as usize;
+            Ok(Frame {
+                data: std::slice::from_raw_parts(image.data as *const u8, stride * self.height),
+                width: self.width,
+                height: self.height,
+                stride,
+            })
+        }
+    }
+}
+
+impl Drop for XShmSource {
+    fn drop(&mut self) {
+        unsafe {
+            if self.attached {
+                let trap = XErrorTrap::new(self.display);
+                x11::XShmDetach(self.display, &mut *self.shminfo);
+                let _ = trap.sync(0);
+            }
+            if !self.shminfo.shmaddr.is_null() {
+                libc::shmdt(self.shminfo.shmaddr as *const _);
+            }
+            if !self.image.is_null() {
+                // The pixels were ours (shared memory), so only free the header
+                (*self.image).data = std::ptr::null_mut();
+                x11::XFree(self.image as *mut _);
+            }
+            x11::XCloseDisplay(self.display);
+        }
+    }
+}
+
+// Global capture registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static SCREEN_CAPTURES: Lazy<DashMap<u64, Arc<Mutex<ScreenCapture>>>> = Lazy::new(|| DashMap::new());
+static NEXT_CAPTURE_ID: AtomicU64 = AtomicU64::new(1);
+
+pub(crate) fn capture(capture_id: u64) -> Option<Arc<Mutex<ScreenCapture>>> {
+    SCREEN_CAPTURES.get(&capture_id).map(|c| c.clone())
+}
+
+// FFI Functions
+
+/// Open an X11 screen capture
+///
+/// # Arguments
+/// * `display` - X display name, or null for $DISPLAY
+/// * `window` - Window ID to capture, or 0 for the whole screen
+/// * `out_width`, `out_height` - Size of the I420 output (0 = capture size)
+///
+/// # Returns
+/// Capture ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn screen_capture_open(
+    display: *const c_char,
+    window: u64,
+    out_width: c_int,
+    out_height: c_int,
+) -> u64 {
+    let display = (!display.is_null()).then(|| unsafe { std::ffi::CStr::from_ptr(display) });
+    let source = match XShmSource::open(display, window) {
+        Ok(source) => source,
+        Err(code) => {
+            log::error!("Failed to open screen capture: {}", code);
+            return 0;
+        }
+    };
+    let (width, height) = source.size();
+    let capture = ScreenCapture::new(
+        Box::new(source),
+        out_width.max(0) as usize,
+        out_height.max(0) as usize,
+    );
+    let (out_width, out_height) = capture.output_size();
+    let id = NEXT_CAPTURE_ID.fetch_add(1, Ordering::Relaxed);
+    log::info!(
+        "Opened screen capture {} ({}x{} -> {}x{})",
+        id,
+        width,
+        height,
+        out_width,
+        out_height
+    );
+    SCREEN_CAPTURES.insert(id, Arc::new(Mutex::new(capture)));
+    id
+}
+
+/// Close a screen capture
+#[no_mangle]
+pub extern "C" fn screen_capture_close(capture_id: u64) {
+    if SCREEN_CAPTURES.remove(&capture_id).is_some() {
+        log::info!("Closed screen capture {}", capture_id);
+    }
+}
+
+/// Get the size of the I420 output
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn screen_capture_size(
+    capture_id: u64,
+    out_width: *mut c_int,
+    out_height: *mut c_int,
+) -> c_int {
+    if out_width.is_null() || out_height.is_null() {
+        return -1;
+    }
+    let Some(capture) = capture(capture_id) else { return -1 };
+    let (width, height) = capture.lock().unwrap().output_size();
+    unsafe {
+        *out_width = width as c_int;
+        *out_height = height as c_int;
+    }
+    0
+}
+
+/// Grab a frame
+///
+/// The output is only written when the screen changed.
+///
+/// # Arguments
+/// * `capture_id` - Capture ID
+/// * `out` - Buffer for the I420 frame (width * height * 3 / 2 bytes)
+/// * `len` - Length of `out`
+///
+/// # Returns
+/// 1 if the screen changed and `out` holds the new frame, 0 if nothing
+/// changed, negative on error (-6 when the captured window changed size or
+/// went away; reopen the capture)
+#[no_mangle]
+pub extern "C" fn screen_capture_grab(capture_id: u64, out: *mut u8, len: usize) -> c_int {
+    if out.is_null() {
+        return -1;
+    }
+    let Some(capture) = capture(capture_id) else { return -1 };
+    let mut capture = capture.lock().unwrap();
+    if len < capture.i420().len() {
+        return -1;
+    }
+    match capture.grab() {
+        Ok(true) => {
+            let frame = capture.i420();
+            let out = unsafe { std::slice::from_raw_parts_mut(out, frame.len()) };
+            out.copy_from_slice(frame);
+            1
+        }
+        Ok(false) => 0,
+        Err(code) => code,
+    }
+}
+
+/// Get capture counters
+///
+/// Writes up to `len` values: frames, changed frames, dirty tiles, tiles per
+/// frame, grab microseconds, processing microseconds.
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn screen_capture_get_stats(capture_id: u64, out_stats: *mut u64, len: usize) -> c_int {
+    if out_stats.is_null() {
+        return -1;
+    }
+    let Some(capture) = capture(capture_id) else { return -1 };
+    let stats = capture.lock().unwrap().stats();
+    let values = [
+        stats.frames,
+        stats.changed_frames,
+        stats.dirty_tiles,
+        stats.tiles_per_frame,
+        stats.grab_us,
+        stats.process_us,
+    ];
+    let count = len.min(values.len());
+    let out = unsafe { std::slice::from_raw_parts_mut(out_stats, count) };
+    out.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::io::{Read, Write};
+    use std::process::{Command, Stdio};
+
+    /// Synthetic desktop: a static slide, a clock that ticks once a second
+    /// and a cursor that moves for a while every few seconds
+    struct SyntheticDesktop {
+        width: usize,
+        height: usize,
+        pixels: Vec<u8>,
+        background: Vec<u8>,
+        frame: usize,
+    }
+
+    impl SyntheticDesktop {
+        fn new(width: usize, height: usize) -> Self {
+            let mut background = vec![0u8; width * height * BPP];
+            for y in 0..height {
+                for x in 0..width {
+                    let p = (y * width + x) * BPP;
+                    // Gradient with "text" lines on it
+                    let text = (y / 24) % 3 == 1 && (x / 7 + y / 24) % 5 != 0 && (x + y) % 3 == 0;
+                    let shade = if text { 20 } else { 200 + (x * 40 / width) as u8 };
+                    background[p..p + 4].copy_from_slice(&[shade, shade, (shade as usize * 9 / 10) as u8, 255]);
+                }
+            }
+            Self { width, height, pixels: background.clone(), background, frame: 0 }
+        }
+
+        fn fill(&mut self, x0: usize, y0: usize, w: usize, h: usize, color: [u8; 4]) {
+            for y in y0..(y0 + h).min(self.height) {
+                for x in x0..(x0 + w).min(self.width) {
+                    let p = (y * self.width + x) * BPP;
+                    self.pixels[p..p + 4].copy_from_slice(&color);
+                }
+            }
+        }
+
+        fn restore(&mut self, x0: usize, y0: usize, w: usize, h: usize) {
+            for y in y0..(y0 + h).min(self.height) {
+                let start = (y * self.width + x0) * BPP;
+                let end = (y * self.width + (x0 + w).min(self.width)) * BPP;
+                self.pixels[start..end].copy_from_slice(&self.background[start..end]);
+            }
+        }
+
+        fn cursor(frame: usize) -> Option<(usize, usize)> {
+            // Moves during the first second of every five
+            (frame % 150 < 30).then(|| (400 + (frame % 150) * 12, 300 + (frame % 150) * 5))
+        }
+    }
+
+    impl FrameSource for SyntheticDesktop {
+        fn size(&self) -> (usize, usize) {
+            (self.width, self.height)
+        }
+
+        fn grab(&mut self) -> Result<Frame<'_>, i32> {
+            let frame = self.frame;
+            self.frame += 1;
+            if let Some((x, y)) = frame.checked_sub(1).and_then(Self::cursor) {
+                self.restore(x, y, 16, 24);
+            }
+            // Clock digits change once a second
+            let second = (frame / 30) as u8;
+            self.fill(self.width - 120, 8, 100, 20, [second.wrapping_mul(37), 40, 40, 255]);
+            if let Some((x, y)) = Self::cursor(frame) {
+                self.fill(x, y, 16, 24, [0, 0, 0, 255]);
+            }
+            Ok(Frame { data: &self.pixels, width: self.width, height: self.height, stride: self.width * BPP })
+        }
+    }
+
+    fn solid(width: usize, height: usize, bgr: [u8; 3]) -> Vec<u8> {
+        let mut data = vec![255u8; width * height * BPP];
+        for p in data.chunks_exact_mut(BPP) {
+            p[..3].copy_from_slice(&bgr);
+        }
+        data
+    }
+
+    #[test]
+    fn simd_compare_matches_scalar() {
+        let a: Vec<u8> = (0..1000).map(|i| (i * 7 % 251) as u8).collect();
+        for len in [0usize, 5, 32, 100, 128, 1000] {
+            for flip in [None, Some(0), Some(len / 2), Some(len.saturating_sub(1))] {
+                let mut b = a[..len].to_vec();
+                if let (Some(i), true) = (flip, len > 0) {
+                    b[i] ^= 1;
+                }
+                let expected = a[..len] == b[..];
+                assert_eq!(bytes_equal(&a[..len], &b), expected);
+                assert_eq!(bytes_equal_lanes(&a[..len], &b), expected);
+            }
+        }
+    }
+
+    #[test]
+    fn detects_only_changed_tiles() {
+        let (width, height) = (100, 70);
+        let mut data = solid(width, height, [10, 20, 30]);
+        let mut detector = DamageDetector::new(width, height);
+        let grab = |detector: &mut DamageDetector, data: &[u8]| {
+            detector.detect(&Frame { data, width, height, stride: width * BPP })
+        };
+        assert_eq!(grab(&mut detector, &data), 4 * 3);
+        assert_eq!(grab(&mut detector, &data), 0);
+
+        // One pixel in the partial tile at the bottom right
+        let p = ((height - 1) * width + width - 1) * BPP;
+        data[p] = 99;
+        assert_eq!(grab(&mut detector, &data), 1);
+        assert!(detector.dirty()[2 * 4 + 3]);
+        assert_eq!(grab(&mut detector, &data), 0);
+
+        // A change spanning two tiles of the first row
+        let p = (5 * width + 31) * BPP;
+        data[p..p + 2 * BPP].fill(0);
+        assert_eq!(grab(&mut detector, &data), 2);
+        assert!(detector.dirty()[0] && detector.dirty()[1]);
+
+        detector.reset();
+        assert_eq!(grab(&mut detector, &data), 12);
+    }
+
+    #[test]
+    fn dirty_conversion_matches_full_conversion() {
+        let (width, height) = (200, 120);
+        let mut desktop = SyntheticDesktop::new(width, height);
+        let mut reference = I420Scaler::new(width, height, 128, 72);
+        let mut incremental = ScreenCapture::new(Box::new(SyntheticDesktop::new(width, height)), 128, 72);
+
+        for _ in 0..40 {
+            let changed = incremental.grab().unwrap();
+            let frame = desktop.grab().unwrap();
+            reference.convert_all(&frame);
+            if changed {
+                assert_eq!(incremental.i420(), reference.i420());
+            }
+        }
+        assert_eq!(incremental.i420(), reference.i420());
+    }
+
+    #[test]
+    fn converts_bt601_limited_range() {
+        let (width, height) = (64, 32);
+        let mut scaler = I420Scaler::new(width, height, 32, 16);
+        for (bgr, yuv) in [
+            ([255, 255, 255], [235, 128, 128]),
+            ([0, 0, 0], [16, 128, 128]),
+            ([0, 0, 255], [82, 90, 240]),
+        ] {
+            let data = solid(width, height, bgr);
+            scaler.convert_all(&Frame { data: &data, width, height, stride: width * BPP });
+            let i420 = scaler.i420();
+            assert_eq!([i420[0], i420[32 * 16], i420[32 * 16 + 16 * 8]], yuv);
+        }
+    }
+
+    #[test]
+    fn static_screen_skips_frames() {
+        let mut capture = ScreenCapture::new(Box::new(SyntheticDesktop::new(640, 360)), 0, 0);
+        for _ in 0..300 {
+            capture.grab().unwrap();
+        }
+        let stats = capture.stats();
+        // The first frame, clock ticks and cursor movement
+        assert!(stats.changed_frames < 80, "{:?}", stats);
+        assert!(stats.dirty_tiles < stats.changed_frames * 10 + stats.tiles_per_frame, "{:?}", stats);
+    }
+
+    fn encoded_bytes(frames: &[Vec<u8>], width: usize, height: usize) -> Option<usize> {
+        let mut child = Command::new("ffmpeg")
+            .args([
+                "-hide_banner", "-loglevel", "error",
+                "-f", "rawvideo", "-pix_fmt", "yuv420p",
+                "-s", &format!("{}x{}", width, height), "-r", "30", "-i", "pipe:0",
+                "-c:v", "libx264", "-preset", "ultrafast", "-tune", "zerolatency",
+                "-g", "60", "-f", "h264", "pipe:1",
+            ])
+            .stdin(Stdio::piped())
+            .stdout(Stdio::piped())
+            .spawn()
+            .ok()?;
+        let mut stdin = child.stdin.take()?;
+        let mut stdout = child.stdout.take()?;
+        let reader = std::thread::spawn(move || {
+            let mut out = Vec::new();
+            stdout.read_to_end(&mut out).map(|_| out.len())
+        });
+        for frame in frames {
+            stdin.write_all(frame).ok()?;
+        }
+        drop(stdin);
+        child.wait().ok()?.success().then_some(())?;
+        reader.join().ok()?.ok()
+    }
+
+    /// Run with:
+    ///   cargo test --release --features screen-capture bench_static_desktop -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_static_desktop() {
+        const FRAMES: usize = 300;
+        let (width, height, out_width, out_height) = (1920, 1080, 1280, 720);
+
+        // Baseline: convert every frame in full
+        let mut desktop = SyntheticDesktop::new(width, height);
+        let mut scaler = I420Scaler::new(width, height, out_width, out_height);
+        let mut every_frame = Vec::with_capacity(FRAMES);
+        let start = Instant::now();
+        for _ in 0..FRAMES {
+            let frame = desktop.grab().unwrap();
+            scaler.convert_all(&frame);
+            every_frame.push(scaler.i420().to_vec());
+        }
+        let full_us = start.elapsed().as_micros() as f64 / FRAMES as f64;
+
+        // Damage-aware: only changed frames leave the capture
+        let mut capture = ScreenCapture::new(Box::new(SyntheticDesktop::new(width, height)), out_width, out_height);
+        let mut changed_only = Vec::new();
+        for _ in 0..FRAMES {
+            if capture.grab().unwrap() {
+                changed_only.push(capture.i420().to_vec());
+            }
+        }
+        let stats = capture.stats();
+        let damage_us = stats.process_us as f64 / FRAMES as f64;
+        println!(
+            "{}x{} -> {}x{}, {} frames: full conversion {:.0}us/frame, damage-aware {:.0}us/frame \
+             ({} changed frames, {:.1}% of tiles dirty)",
+            width,
+            height,
+            out_width,
+            out_height,
+            FRAMES,
+            full_us,
+            damage_us,
+            stats.changed_frames,
+            100.0 * stats.dirty_tiles as f64 / (stats.tiles_per_frame * FRAMES as u64) as f64
+        );
+
+        let seconds = FRAMES as f64 / 30.0;
+        let encode = |frames: &[Vec<u8>]| {
+            let start = Instant::now();
+            let bytes = encoded_bytes(frames, out_width, out_height)?;
+            Some((bytes as f64 * 8.0 / seconds / 1000.0, start.elapsed().as_secs_f64() * 1000.0))
+        };
+        match (encode(&every_frame), encode(&changed_only)) {
+            (Some((all_kbps, all_ms)), Some((changed_kbps, changed_ms))) => println!(
+                "x264 ultrafast: every frame {:.0} kbps ({:.0}ms encode), changed frames only {:.0} kbps ({:.0}ms encode)",
+                all_kbps, all_ms, changed_kbps, changed_ms
+            ),
+            _ => println!("ffmpeg not available, skipping bitrate comparison"),
+        }
+    }
+}
@@ -0,0 +1,330 @@
+// Per-stream reassembly queues for incoming unidirectional data streams
+// Each stream keeps its own bounded byte queue so partial reads never lose data
+// and a slow consumer stalls the sender via QUIC flow control instead of drops.
+
+use std::collections::{HashMap, VecDeque};
+use std::sync::Arc;
+use tokio::sync::{Mutex, Notify};
+
+/// Result of a peek or read on the reassembly queues
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct StreamRead {
+    /// Stream the bytes belong to
+    pub stream_id: u64,
+    /// Bytes available (peek) or bytes copied (read)
+    pub len: usize,
+    /// True if the stream is finished once these bytes are consumed
+    pub is_complete: bool,
+}
+
+// Buffered state for one incoming stream
+struct StreamState {
+    chunks: VecDeque<Vec<u8>>,
+    head_offset: usize, // bytes already consumed from chunks.front()
+    buffered: usize,
+    finished: bool,
+    queued: bool, // present in the ready list
+    space: Arc<Notify>,
+}
+
+impl StreamState {
+    fn new() -> Self {
+        Self {
+            chunks: VecDeque::new(),
+            head_offset: 0,
+            buffered: 0,
+            finished: false,
+            queued: false,
+            space: Arc::new(Notify::new()),
+        }
+    }
+
+    fn copy_out(&mut self, buf: &mut [u8]) -> usize {
+        let mut copied = 0;
+        while copied < buf.len() {
+            let front = match self.chunks.front() {
+                Some(chunk) => chunk,
+                None => break,
+            };
+            let remaining = &front[self.head_offset..];
+            let n = remaining.len().min(buf.len() - copied);
+            buf[copied..copied + n].copy_from_slice(&remaining[..n]);
+            copied += n;
+            self.head_offset += n;
+            if self.head_offset == front.len() {
+                self.chunks.pop_front();
+                self.head_offset = 0;
+            }
+        }
+        self.buffered -= copied;
+        copied
+    }
+}
+
+/// Reassembly queues for all incoming data streams of one session
+///
+/// Streams with pending bytes (or a pending FIN) are served round-robin, so one
+/// busy stream cannot starve the others.
+pub struct StreamReassembly {
+    streams: HashMap<u64, StreamState>,
+    ready: VecDeque<u64>,
+    max_stream_buffer: usize,
+}
+
+impl StreamReassembly {
+    pub fn new(max_stream_buffer: usize) -> Self {
+        Self {
+            streams: HashMap::new(),
+            ready: VecDeque::with_capacity(32),
+            max_stream_buffer,
+        }
+    }
+
+    /// Register a newly accepted stream
+    pub fn open_stream(&mut self, stream_id: u64) {
+        self.streams.entry(stream_id).or_insert_with(StreamState::new);
+    }
+
+    /// Append bytes received on a stream
+    ///
+    /// The producer is expected to call `wait_for_space` before reading more from
+    /// the network, so the per-stream buffer can exceed its limit by at most one read.
+    pub fn push(&mut self, stream_id: u64, data: Vec<u8>) {
+        if data.is_empty() {
+            return;
+        }
+        let state = match self.streams.get_mut(&stream_id) {
+            Some(s) => s,
+            None => return, // Session closed underneath the reader
+        };
+        state.buffered += data.len();
+        state.chunks.push_back(data);
+        if !state.queued {
+            state.queued = true;
+            self.ready.push_back(stream_id);
+        }
+    }
+
+    /// Mark a stream as finished (FIN received or read error)
+    pub fn finish(&mut self, stream_id: u64) {
+        if let Some(state) = self.streams.get_mut(&stream_id) {
+            state.finished = true;
+            if !state.queued {
+                state.queued = true;
+                self.ready.push_back(stream_id);
+            }
+        }
+    }
+
+    /// Describe the next read without consuming anything
+    pub fn peek(&self) -> Option<StreamRead> {
+        let stream_id = *self.ready.front()?;
+        let state = self.streams.get(&stream_id)?;
+        Some(StreamRead {
+            stream_id,
+            len: state.buffered,
+            is_complete: state.finished,
+        })
+    }
+
+    /// Copy up to `buf.len()` bytes from the next ready stream
+    ///
+    /// Bytes that do not fit stay queued for the next call. A finished stream is
+    /// reported exactly once with `is_complete` set, possibly with `len == 0`.
+    pub fn read(&mut self, buf: &mut [u8]) -> Option<StreamRead> {
+        let stream_id = self.ready.pop_front()?;
+        let state = self.streams.get_mut(&stream_id)?;
+
+        let copied = state.copy_out(buf);
+        if copied > 0 {
+            state.space.notify_one();
+        }
+
+        let is_complete = state.finished && state.buffered == 0;
+        if is_complete {
+            self.streams.remove(&stream_id);
+        } else if state.buffered > 0 {
+            self.ready.push_back(stream_id);
+        } else {
+            state.queued = false;
+        }
+
+        Some(StreamRead {
+            stream_id,
+            len: copied,
+            is_complete,
+        })
+    }
+
+    /// Total bytes buffered across all streams
+    #[allow(dead_code)]
+    pub fn buffered_bytes(&self) -> usize {
+        self.streams.values().map(|s| s.buffered).sum()
+    }
+
+    /// Drop all streams and wake any blocked producers so they can exit
+    pub fn close(&mut self) {
+        for state in self.streams.values() {
+            state.space.notify_one();
+        }
+        self.streams.clear();
+        self.ready.clear();
+    }
+}
+
+/// Wait until a stream has room for more data
+///
+/// Returns false if the stream no longer exists (session closed), in which case the
+/// producer should stop reading.
+pub async fn wait_for_space(queue: &Mutex<StreamReassembly>, stream_id: u64) -> bool {
+    loop {
+        let space = {
+            let q = queue.lock().await;
+            match q.streams.get(&stream_id) {
+                Some(state) if state.buffered < q.max_stream_buffer => return true,
+                Some(state) => state.space.clone(),
+                None => return false,
+            }
+        };
+        // notify_one stores a permit, so a drain between unlock and await is not lost
+        space.notified().await;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::{Duration, Instant};
+
+    fn pattern(stream_id: u64, offset: usize) -> u8 {
+        (stream_id as usize).wrapping_mul(31).wrapping_add(offset) as u8
+    }
+
+    #[test]
+    fn partial_reads_keep_remainder() {
+        let mut q = StreamReassembly::new(1024);
+        q.open_stream(7);
+        q.push(7, vec![1, 2, 3, 4, 5]);
+        q.finish(7);
+
+        assert_eq!(q.peek(), Some(StreamRead { stream_id: 7, len: 5, is_complete: true }));
+
+        let mut buf = [0u8; 2];
+        assert_eq!(q.read(&mut buf), Some(StreamRead { stream_id: 7, len: 2, is_complete: false }));
+        assert_eq!(buf, [1, 2]);
+        assert_eq!(q.read(&mut buf), Some(StreamRead { stream_id: 7, len: 2, is_complete: false }));
+        assert_eq!(buf, [3, 4]);
+        assert_eq!(q.read(&mut buf), Some(StreamRead { stream_id: 7, len: 1, is_complete: true }));
+        assert_eq!(buf[0], 5);
+        assert_eq!(q.read(&mut buf), None);
+    }
+
+    #[test]
+    fn empty_fin_is_reported_once() {
+        let mut q = StreamReassembly::new(1024);
+        q.open_stream(1);
+        q.push(1, vec![9; 4]);
+        let mut buf = [0u8; 16];
+        assert_eq!(q.read(&mut buf).unwrap().len, 4);
+        assert_eq!(q.peek(), None);
+
+        q.finish(1);
+        assert_eq!(q.read(&mut buf), Some(StreamRead { stream_id: 1, len: 0, is_complete: true }));
+        assert_eq!(q.read(&mut buf), None);
+    }
+
+    #[test]
+    fn streams_are_served_round_robin() {
+        let mut q = StreamReassembly::new(1024);
+        q.open_stream(1);
+        q.open_stream(2);
+        q.push(1, vec![1; 8]);
+        q.push(2, vec![2; 8]);
+
+        let mut buf = [0u8; 4];
+        let order: Vec<u64> = (0..4).map(|_| q.read(&mut buf).unwrap().stream_id).collect();
+        assert_eq!(order, vec![1, 2, 1, 2]);
+    }
+
+    // 100 concurrent streams at 5 MB/s each against a consumer draining with a
+    // small buffer. Every byte must arrive in order and no stream may exceed its
+    // buffer limit by more than one producer read.
+    #[tokio::test(flavor = "multi_thread", worker_threads = 4)]
+    async fn stress_100_streams_at_5mbps() {
+        const STREAMS: u64 = 100;
+        const RATE: usize = 5 * 1024 * 1024; // bytes per second per stream
+        const DURATION: Duration = Duration::from_secs(2);
+        const TICK: Duration = Duration::from_millis(10);
+        const READ_SIZE: usize = 16 * 1024;
+        const MAX_BUFFER: usize = 256 * 1024;
+
+        let queue = Arc::new(Mutex::new(StreamReassembly::new(MAX_BUFFER)));
+        let per_tick = RATE * TICK.as_millis() as usize / 1000;
+        let total_per_stream = per_tick * (DURATION.as_millis() / TICK.as_millis()) as usize;
+
+        let mut producers = Vec::new();
+        for stream_id in 0..STREAMS {
+            queue.lock().await.open_stream(stream_id);
+            let queue = queue.clone();
+            producers.push(tokio::spawn(async move {
+                let mut ticker = tokio::time::interval(TICK);
+                let mut offset = 0;
+                while offset < total_per_stream {
+                    ticker.tick().await;
+                    // Emulate several network reads per tick, honouring backpressure
+                    let tick_end = (offset + per_tick).min(total_per_stream);
+                    while offset < tick_end {
+                        assert!(wait_for_space(&queue, stream_id).await);
+                        let n = READ_SIZE.min(tick_end - offset);
+                        let chunk: Vec<u8> = (offset..offset + n).map(|i| pattern(stream_id, i)).collect();
+                        queue.lock().await.push(stream_id, chunk);
+                        offset += n;
+                    }
+                }
+                queue.lock().await.finish(stream_id);
+            }));
+        }
+
+        let start = Instant::now();
+        let mut received = vec![0usize; STREAMS as usize];
+        let mut completed = 0;
+        let mut buf = vec![0u8; READ_SIZE];
+        while completed < STREAMS {
+            let read = {
+                let mut q = queue.lock().await;
+                for state in q.streams.values() {
+                    assert!(state.buffered <= MAX_BUFFER + READ_SIZE, "buffer limit exceeded");
+                }
+                q.read(&mut buf)
+            };
+            match read {
+                Some(r) => {
+                    let got = &mut received[r.stream_id as usize];
+                    for (i, &b) in buf[..r.len].iter().enumerate() {
+                        assert_eq!(b, pattern(r.stream_id, *got + i), "corrupt byte on stream {}", r.stream_id);
+                    }
+                    *got += r.len;
+                    if r.is_complete {
+                        assert_eq!(*got, total_per_stream, "stream {} completed early", r.stream_id);
+                        completed += 1;
+                    }
+                }
+                None => tokio::task::yield_now().await,
+            }
+        }
+        let elapsed = start.elapsed();
+
+        for p in producers {
+            p.await.unwrap();
+        }
+        let total: usize = received.iter().sum();
+        println!(
+            "reassembled {} MB over {} streams in {:?} ({:.1} MB/s)",
+            total / (1024 * 1024),
+            STREAMS,
+            elapsed,
+            total as f64 / elapsed.as_secs_f64() / (1024.0 * 1024.0)
+        );
+        assert_eq!(total, total_per_stream * STREAMS as usize);
+    }
+}
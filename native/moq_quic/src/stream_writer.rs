@@ -66,6 +66,12 @@ impl StreamWriter {
         self.tx.try_send(StreamCommand::Write(data))
     }
 
+    /// Write data, waiting while the channel is full
+    /// Must not be called from inside the runtime
+    pub fn write_blocking(&self, data: Vec<u8>) -> Result<(), mpsc::error::SendError<StreamCommand>> {
+        self.tx.blocking_send(StreamCommand::Write(data))
+    }
+
     /// Try to finish the stream
     #[allow(dead_code)]
     pub fn try_finish(&self) -> Result<(), mpsc::error::TrySendError<StreamCommand>> {
@@ -0,0 +1,739 @@
+// Thumbnail track encoding
+//
+// A grid of 50 previews subscribed to full video tracks pulls tens of Mb/s
+// and runs 50 decoders just to draw postage stamps. Publishers can instead
+// emit a companion track carrying one small JPEG every few seconds (or per
+// keyframe), which costs the grid a few kB/s per stream.
+//
+// Architecture:
+// - Capture frames (I420) are pushed via FFI; only the newest pending frame
+//   is kept, so the capture thread only pays for one copy
+// - A worker thread box-filters the frame down to thumbnail size (AVX2 row
+//   accumulation, lane fallback elsewhere) and compresses the planes with
+//   libjpeg-turbo without any colour conversion
+// - The newest finished JPEG is pulled via FFI
+
+use std::os::raw::{c_int, c_ulong};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Condvar, Mutex};
+use std::thread::JoinHandle;
+use std::time::Instant;
+
+use crate::mjpeg_decoder::{i420_len, tj};
+
+// Rows summed into the u16 accumulator before it could overflow
+const MAX_ROWS_PER_SUM: usize = 256;
+
+/// Compresses a scaled frame
+pub trait ThumbnailCodec: Send {
+    /// Encode `frame` into `out` (replacing its contents)
+    fn encode(&mut self, frame: &ScaledFrame, out: &mut Vec<u8>) -> Result<(), i32>;
+}
+
+/// A downscaled frame: three planes with padded strides
+#[derive(Default)]
+pub struct ScaledFrame {
+    pub data: Vec<u8>,
+    pub width: usize,
+    pub height: usize,
+    pub strides: [usize; 3],
+    pub offsets: [usize; 3],
+}
+
+impl ScaledFrame {
+    /// Reallocate for `width` x `height`; strides are padded to whole JPEG
+    /// MCUs (16 luma, 8 chroma samples) and so are the row counts
+    fn resize(&mut self, width: usize, height: usize) {
+        let (cw, ch) = (width.div_ceil(2), height.div_ceil(2));
+        let luma_stride = width.next_multiple_of(16);
+        let chroma_stride = cw.next_multiple_of(8);
+        let luma_rows = height.next_multiple_of(16);
+        let chroma_rows = ch.next_multiple_of(8);
+        self.width = width;
+        self.height = height;
+        self.strides = [luma_stride, chroma_stride, chroma_stride];
+        self.offsets = [0, luma_stride * luma_rows, luma_stride * luma_rows + chroma_stride * chroma_rows];
+        self.data.resize(self.offsets[2] + chroma_stride * chroma_rows, 0);
+    }
+
+    pub fn plane(&self, index: usize) -> &[u8] {
+        &self.data[self.offsets[index]..]
+    }
+}
+
+/// Thumbnail counters
+#[derive(Debug, Clone, Copy, Default)]
+pub struct ThumbnailStats {
+    pub encoded: u64,
+    /// Frames replaced before they were encoded, or encoded but never pulled
+    pub dropped: u64,
+    pub errors: u64,
+    pub scale_us: u64,
+    pub encode_us: u64,
+    /// JPEG bytes produced
+    pub bytes: u64,
+}
+
+// -----------------------------------------------------------------------------
+// Downscaling
+// -----------------------------------------------------------------------------
+
+/// Largest even size within `max_width` x `max_height` that keeps the
+/// source's aspect ratio, never upscaling
+pub fn fit_size(width: usize, height: usize, max_width: usize, max_height: usize) -> (usize, usize) {
+    if width == 0 || height == 0 {
+        return (0, 0);
+    }
+    let (max_width, max_height) = (max_width.min(width), max_height.min(height));
+    let (w, h) = if width * max_height > height * max_width {
+        (max_width, (height * max_width + width / 2) / width)
+    } else {
+        ((width * max_height + height / 2) / height, max_height)
+    };
+    ((w & !1).max(2), (h & !1).max(2))
+}
+
+/// Box-filter one plane down to `dst_width` x `dst_height`
+///
+/// Each output sample is the mean of the source samples it covers. Very tall
+/// boxes are sampled every few rows so the u16 row sums cannot overflow.
+#[allow(clippy::too_many_arguments)]
+pub fn downscale_plane(
+    src: &[u8],
+    src_width: usize,
+    src_height: usize,
+    src_stride: usize,
+    dst: &mut [u8],
+    dst_width: usize,
+    dst_height: usize,
+    dst_stride: usize,
+    sums: &mut Vec<u16>,
+) {
+    sums.resize(src_width, 0);
+    for oy in 0..dst_height {
+        let y0 = oy * src_height / dst_height;
+        let y1 = ((oy + 1) * src_height / dst_height).max(y0 + 1);
+        let step = (y1 - y0).div_ceil(MAX_ROWS_PER_SUM);
+
+        sums.fill(0);
+        let mut rows = 0;
+        for y in (y0..y1).step_by(step) {
+            accumulate_row(&src[y * src_stride..][..src_width], sums);
+            rows += 1;
+        }
+
+        let out = &mut dst[oy * dst_stride..][..dst_width];
+        for (ox, o) in out.iter_mut().enumerate() {
+            let x0 = ox * src_width / dst_width;
+            let x1 = ((ox + 1) * src_width / dst_width).max(x0 + 1);
+            let sum: u32 = sums[x0..x1].iter().map(|&s| s as u32).sum();
+            let count = (rows * (x1 - x0)) as u32;
+            *o = ((sum + count / 2) / count) as u8;
+        }
+    }
+}
+
+/// Downscale a packed I420 frame into `out`
+pub fn downscale_i420(
+    i420: &[u8],
+    width: usize,
+    height: usize,
+    out: &mut ScaledFrame,
+    out_width: usize,
+    out_height: usize,
+    sums: &mut Vec<u16>,
+) {
+    out.resize(out_width, out_height);
+    let (cw, ch) = (width.div_ceil(2), height.div_ceil(2));
+    let (ocw, och) = (out_width.div_ceil(2), out_height.div_ceil(2));
+    let sources = [(0, width, height), (width * height, cw, ch), (width * height + cw * ch, cw, ch)];
+    for (plane, (offset, w, h)) in sources.into_iter().enumerate() {
+        let (dw, dh) = if plane == 0 { (out_width, out_height) } else { (ocw, och) };
+        let stride = out.strides[plane];
+        let dst = &mut out.data[out.offsets[plane]..];
+        downscale_plane(&i420[offset..], w, h, w, dst, dw, dh, stride, sums);
+    }
+}
+
+/// Add a row of samples into the running column sums
+pub fn accumulate_row(row: &[u8], sums: &mut [u16]) {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if std::is_x86_feature_detected!("avx2") {
+            // SAFETY: AVX2 support was checked at runtime
+            return unsafe { accumulate_row_avx2(row, sums) };
+        }
+    }
+    accumulate_row_lanes(row, sums)
+}
+
+// Sixteen lanes per step, which LLVM maps onto SSE2 on x86_64 and NEON on
+// aarch64 (widen and add)
+fn accumulate_row_lanes(row: &[u8], sums: &mut [u16]) {
+    let mut sum_chunks = sums.chunks_exact_mut(16);
+    let mut row_chunks = row.chunks_exact(16);
+    for (s, r) in (&mut sum_chunks).zip(&mut row_chunks) {
+        for i in 0..16 {
+            s[i] += r[i] as u16;
+        }
+    }
+    for (s, r) in sum_chunks.into_remainder().iter_mut().zip(row_chunks.remainder()) {
+        *s += *r as u16;
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn accumulate_row_avx2(row: &[u8], sums: &mut [u16]) {
+    use std::arch::x86_64::*;
+
+    let len = row.len().min(sums.len());
+    let mut i = 0;
+    while i + 16 <= len {
+        let samples = _mm256_cvtepu8_epi16(_mm_loadu_si128(row.as_ptr().add(i) as *const __m128i));
+        let ptr = sums.as_mut_ptr().add(i) as *mut __m256i;
+        _mm256_storeu_si256(ptr, _mm256_add_epi16(_mm256_loadu_si256(ptr), samples));
+        i += 16;
+    }
+    accumulate_row_lanes(&row[i..len], &mut sums[i..len]);
+}
+
+// -----------------------------------------------------------------------------
+// libjpeg-turbo
+// -----------------------------------------------------------------------------
+
+/// libjpeg-turbo encoder compressing 4:2:0 planes directly
+pub struct TurboJpegEncoder {
+    handle: tj::Handle,
+    quality: c_int,
+}
+
+// The handle is only used by the worker that owns it
+unsafe impl Send for TurboJpegEncoder {}
+
+impl TurboJpegEncoder {
+    pub fn new(quality: i32) -> Result<Self, i32> {
+        let handle = unsafe { tj::tjInitCompress() };
+        if handle.is_null() {
+            return Err(-1);
+        }
+        Ok(Self { handle, quality: quality.clamp(1, 100) })
+    }
+}
+
+impl ThumbnailCodec for TurboJpegEncoder {
+    fn encode(&mut self, frame: &ScaledFrame, out: &mut Vec<u8>) -> Result<(), i32> {
+        let planes = [0, 1, 2].map(|i| frame.plane(i).as_ptr());
+        let strides = frame.strides.map(|s| s as c_int);
+        let mut jpeg: *mut u8 = std::ptr::null_mut();
+        let mut size: c_ulong = 0;
+        let ok = unsafe {
+            tj::tjCompressFromYUVPlanes(
+                self.handle,
+                planes.as_ptr(),
+                frame.width as c_int,
+                strides.as_ptr(),
+                frame.height as c_int,
+                tj::TJSAMP_420,
+                &mut jpeg,
+                &mut size,
+                self.quality,
+                tj::TJFLAG_FASTDCT,
+            )
+        };
+        if ok != 0 || jpeg.is_null() {
+            if !jpeg.is_null() {
+                unsafe { tj::tjFree(jpeg) };
+            }
+            let error = unsafe { std::ffi::CStr::from_ptr(tj::tjGetErrorStr2(self.handle)) };
+            log::debug!("Thumbnail encode failed: {}", error.to_string_lossy());
+            return Err(-4);
+        }
+        out.clear();
+        out.extend_from_slice(unsafe { std::slice::from_raw_parts(jpeg, size as usize) });
+        unsafe { tj::tjFree(jpeg) };
+        Ok(())
+    }
+}
+
+impl Drop for TurboJpegEncoder {
+    fn drop(&mut self) {
+        unsafe { tj::tjDestroy(self.handle) };
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Encode worker
+// -----------------------------------------------------------------------------
+
+/// A finished thumbnail
+pub struct Thumbnail {
+    pub jpeg: Vec<u8>,
+    pub width: usize,
+    pub height: usize,
+    pub timestamp_ms: i64,
+}
+
+struct Pending {
+    i420: Vec<u8>,
+    width: usize,
+    height: usize,
+    timestamp_ms: i64,
+}
+
+struct State {
+    pending: Option<Pending>,
+    ready: Option<Thumbnail>,
+    // Buffers handed back for reuse
+    spare_frame: Vec<u8>,
+    spare_jpeg: Vec<u8>,
+    stats: ThumbnailStats,
+    closed: bool,
+}
+
+struct Shared {
+    state: Mutex<State>,
+    wake: Condvar,
+}
+
+/// Scales and encodes pushed frames on a dedicated thread
+pub struct ThumbnailWorker {
+    shared: Arc<Shared>,
+    thread: Option<JoinHandle<()>>,
+}
+
+impl ThumbnailWorker {
+    /// Thumbnails fit within `max_width` x `max_height`
+    pub fn new(codec: Box<dyn ThumbnailCodec>, max_width: usize, max_height: usize) -> Self {
+        let shared = Arc::new(Shared {
+            state: Mutex::new(State {
+                pending: None,
+                ready: None,
+                spare_frame: Vec::new(),
+                spare_jpeg: Vec::new(),
+                stats: ThumbnailStats::default(),
+                closed: false,
+            }),
+            wake: Condvar::new(),
+        });
+        let worker = shared.clone();
+        let thread = std::thread::Builder::new()
+            .name("thumbnail-encode".into())
+            .spawn(move || Self::run(worker, codec, max_width, max_height))
+            .expect("failed to spawn thumbnail encode thread");
+        Self { shared, thread: Some(thread) }
+    }
+
+    /// Queue an I420 frame, replacing one still waiting to be encoded
+    pub fn push(&self, i420: &[u8], width: usize, height: usize, timestamp_ms: i64) {
+        let mut state = self.shared.state.lock().unwrap();
+        let mut buffer = match state.pending.take() {
+            Some(pending) => {
+                state.stats.dropped += 1;
+                pending.i420
+            }
+            None => std::mem::take(&mut state.spare_frame),
+        };
+        buffer.clear();
+        buffer.extend_from_slice(&i420[..i420_len(width, height)]);
+        state.pending = Some(Pending { i420: buffer, width, height, timestamp_ms });
+        drop(state);
+        self.shared.wake.notify_one();
+    }
+
+    /// Size and timestamp of the finished thumbnail, if any
+    pub fn peek(&self) -> Option<(usize, usize, i64, usize)> {
+        let state = self.shared.state.lock().unwrap();
+        state.ready.as_ref().map(|t| (t.width, t.height, t.timestamp_ms, t.jpeg.len()))
+    }
+
+    /// Take the finished thumbnail; hand its buffer back with `recycle`
+    pub fn pop(&self) -> Option<Thumbnail> {
+        self.shared.state.lock().unwrap().ready.take()
+    }
+
+    pub fn recycle(&self, jpeg: Vec<u8>) {
+        self.shared.state.lock().unwrap().spare_jpeg = jpeg;
+    }
+
+    pub fn stats(&self) -> ThumbnailStats {
+        self.shared.state.lock().unwrap().stats
+    }
+
+    fn run(shared: Arc<Shared>, mut codec: Box<dyn ThumbnailCodec>, max_width: usize, max_height: usize) {
+        let mut scaled = ScaledFrame::default();
+        let mut sums = Vec::new();
+        loop {
+            let (frame, mut jpeg) = {
+                let mut state = shared.state.lock().unwrap();
+                loop {
+                    if state.closed {
+                        return;
+                    }
+                    if let Some(pending) = state.pending.take() {
+                        break (pending, std::mem::take(&mut state.spare_jpeg));
+                    }
+                    state = shared.wake.wait(state).unwrap();
+                }
+            };
+
+            let (width, height) = fit_size(frame.width, frame.height, max_width, max_height);
+            let start = Instant::now();
+            downscale_i420(&frame.i420, frame.width, frame.height, &mut scaled, width, height, &mut sums);
+            let scaled_at = Instant::now();
+            let result = codec.encode(&scaled, &mut jpeg);
+            let encode_us = scaled_at.elapsed().as_micros() as u64;
+
+            let mut state = shared.state.lock().unwrap();
+            state.stats.scale_us += (scaled_at - start).as_micros() as u64;
+            state.stats.encode_us += encode_us;
+            state.spare_frame = frame.i420;
+            match result {
+                Ok(()) => {
+                    state.stats.encoded += 1;
+                    state.stats.bytes += jpeg.len() as u64;
+                    let thumbnail = Thumbnail { jpeg, width, height, timestamp_ms: frame.timestamp_ms };
+                    if let Some(stale) = state.ready.replace(thumbnail) {
+                        state.stats.dropped += 1;
+                        state.spare_jpeg = stale.jpeg;
+                    }
+                }
+                Err(_) => {
+                    state.stats.errors += 1;
+                    state.spare_jpeg = jpeg;
+                }
+            }
+        }
+    }
+}
+
+impl Drop for ThumbnailWorker {
+    fn drop(&mut self) {
+        self.shared.state.lock().unwrap().closed = true;
+        self.shared.wake.notify_all();
+        if let Some(thread) = self.thread.take() {
+            let _ = thread.join();
+        }
+    }
+}
+
+// Global encoder registry
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+
+static THUMBNAIL_ENCODERS: Lazy<DashMap<u64, Arc<ThumbnailWorker>>> = Lazy::new(|| DashMap::new());
+static NEXT_ENCODER_ID: AtomicU64 = AtomicU64::new(1);
+
+fn encoder(encoder_id: u64) -> Option<Arc<ThumbnailWorker>> {
+    THUMBNAIL_ENCODERS.get(&encoder_id).map(|e| e.clone())
+}
+
+// FFI Functions
+
+/// Create a thumbnail encoder with its worker thread
+///
+/// # Arguments
+/// * `max_width` - Largest thumbnail width (the aspect ratio is kept)
+/// * `max_height` - Largest thumbnail height
+/// * `quality` - JPEG quality, 1-100
+///
+/// # Returns
+/// Encoder ID, or 0 on error
+#[no_mangle]
+pub extern "C" fn thumbnail_encoder_create(max_width: u32, max_height: u32, quality: c_int) -> u64 {
+    if max_width < 2 || max_height < 2 {
+        return 0;
+    }
+    let codec = match TurboJpegEncoder::new(quality) {
+        Ok(codec) => codec,
+        Err(_) => {
+            log::error!("Failed to initialize libjpeg-turbo");
+            return 0;
+        }
+    };
+    let id = NEXT_ENCODER_ID.fetch_add(1, Ordering::Relaxed);
+    let worker = ThumbnailWorker::new(Box::new(codec), max_width as usize, max_height as usize);
+    THUMBNAIL_ENCODERS.insert(id, Arc::new(worker));
+    log::info!("Created thumbnail encoder {} ({}x{})", id, max_width, max_height);
+    id
+}
+
+/// Destroy a thumbnail encoder
+#[no_mangle]
+pub extern "C" fn thumbnail_encoder_destroy(encoder_id: u64) {
+    if THUMBNAIL_ENCODERS.remove(&encoder_id).is_some() {
+        log::info!("Destroyed thumbnail encoder {}", encoder_id);
+    }
+}
+
+/// Queue a capture frame for thumbnailing
+///
+/// # Arguments
+/// * `encoder_id` - Encoder ID
+/// * `i420` - Packed I420 frame
+/// * `len` - Length of `i420`
+/// * `width` - Frame width
+/// * `height` - Frame height
+/// * `timestamp_ms` - Capture timestamp, returned with the thumbnail
+///
+/// # Returns
+/// 0 on success, -1 on error
+#[no_mangle]
+pub extern "C" fn thumbnail_encoder_push(
+    encoder_id: u64,
+    i420: *const u8,
+    len: usize,
+    width: u32,
+    height: u32,
+    timestamp_ms: i64,
+) -> c_int {
+    let (width, height) = (width as usize, height as usize);
+    if i420.is_null() || width < 2 || height < 2 || len < i420_len(width, height) {
+        return -1;
+    }
+    let Some(encoder) = encoder(encoder_id) else { return -1 };
+    let frame = unsafe { std::slice::from_raw_parts(i420, len) };
+    encoder.push(frame, width, height, timestamp_ms);
+    0
+}
+
+/// Take the finished thumbnail
+///
+/// # Arguments
+/// * `encoder_id` - Encoder ID
+/// * `out` - Buffer for the JPEG (may be null when `len` is 0)
+/// * `len` - Length of `out`
+/// * `out_info` - Receives width, height, timestamp and JPEG size (4 values)
+///
+/// # Returns
+/// 1 if a thumbnail was written, 0 if none is ready, -2 if `out` is too small
+/// (`out_info` holds the JPEG size and the thumbnail stays queued), -1 on error
+#[no_mangle]
+pub extern "C" fn thumbnail_encoder_pull(
+    encoder_id: u64,
+    out: *mut u8,
+    len: usize,
+    out_info: *mut i64,
+) -> c_int {
+    if out_info.is_null() || (out.is_null() && len > 0) {
+        return -1;
+    }
+    let Some(encoder) = encoder(encoder_id) else { return -1 };
+    let Some((width, height, timestamp_ms, size)) = encoder.peek() else { return 0 };
+    let info = unsafe { std::slice::from_raw_parts_mut(out_info, 4) };
+    info.copy_from_slice(&[width as i64, height as i64, timestamp_ms, size as i64]);
+    if len < size {
+        return -2;
+    }
+    let Some(thumbnail) = encoder.pop() else { return 0 };
+    let dst = unsafe { std::slice::from_raw_parts_mut(out, thumbnail.jpeg.len()) };
+    dst.copy_from_slice(&thumbnail.jpeg);
+    info[3] = thumbnail.jpeg.len() as i64;
+    encoder.recycle(thumbnail.jpeg);
+    1
+}
+
+/// Get encoder counters
+///
+/// Writes up to `len` values: encoded, dropped, errors, scale microseconds,
+/// encode microseconds, JPEG bytes.
+///
+/// # Returns
+/// Number of values written, or -1 on error
+#[no_mangle]
+pub extern "C" fn thumbnail_encoder_get_stats(encoder_id: u64, out_stats: *mut u64, len: usize) -> c_int {
+    if out_stats.is_null() {
+        return -1;
+    }
+    let Some(encoder) = encoder(encoder_id) else { return -1 };
+    let stats = encoder.stats();
+    let values = [stats.encoded, stats.dropped, stats.errors, stats.scale_us, stats.encode_us, stats.bytes];
+    let count = len.min(values.len());
+    let out = unsafe { std::slice::from_raw_parts_mut(out_stats, count) };
+    out.copy_from_slice(&values[..count]);
+    count as c_int
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::mjpeg_decoder::{JpegDecoder, TurboJpegDecoder};
+    use std::time::Duration;
+
+    /// Codec that "encodes" the size and first luma sample
+    struct FakeCodec {
+        delay: Duration,
+    }
+
+    impl ThumbnailCodec for FakeCodec {
+        fn encode(&mut self, frame: &ScaledFrame, out: &mut Vec<u8>) -> Result<(), i32> {
+            std::thread::sleep(self.delay);
+            out.clear();
+            out.extend_from_slice(&[frame.width as u8, frame.height as u8, frame.plane(0)[0]]);
+            Ok(())
+        }
+    }
+
+    fn wait_for(worker: &ThumbnailWorker, encoded: u64) {
+        for _ in 0..200 {
+            if worker.stats().encoded >= encoded {
+                return;
+            }
+            std::thread::sleep(Duration::from_millis(2));
+        }
+        panic!("worker stalled: {:?}", worker.stats());
+    }
+
+    fn gradient_i420(width: usize, height: usize) -> Vec<u8> {
+        let mut frame = vec![128u8; i420_len(width, height)];
+        for y in 0..height {
+            for x in 0..width {
+                frame[y * width + x] = ((x + y) * 255 / (width + height)) as u8;
+            }
+        }
+        frame
+    }
+
+    #[test]
+    fn fits_within_bounds_keeping_aspect() {
+        assert_eq!(fit_size(1920, 1080, 160, 160), (160, 90));
+        assert_eq!(fit_size(1080, 1920, 160, 160), (90, 160));
+        assert_eq!(fit_size(640, 480, 160, 90), (120, 90));
+        // Never upscales, and stays even
+        assert_eq!(fit_size(100, 51, 160, 90), (100, 50));
+        assert_eq!(fit_size(0, 480, 160, 90), (0, 0));
+    }
+
+    #[test]
+    fn box_filters_planes() {
+        // 4x2 -> 2x1: means of 2x2 boxes
+        let src = [0, 10, 100, 110, 20, 30, 120, 130];
+        let mut dst = [0u8; 2];
+        let mut sums = Vec::new();
+        downscale_plane(&src, 4, 2, 4, &mut dst, 2, 1, 2, &mut sums);
+        assert_eq!(dst, [15, 115]);
+
+        // Non-integer ratio: 3 -> 2 columns take boxes of 1 and 2
+        let mut dst = [0u8; 2];
+        downscale_plane(&[10, 20, 40], 3, 1, 3, &mut dst, 2, 1, 2, &mut sums);
+        assert_eq!(dst, [10, 30]);
+
+        // Tall boxes: a 1000-row column of 255 stays 255 without overflow
+        let column = vec![255u8; 1000];
+        let mut dst = [0u8; 1];
+        downscale_plane(&column, 1, 1000, 1, &mut dst, 1, 1, 1, &mut sums);
+        assert_eq!(dst, [255]);
+    }
+
+    #[test]
+    fn simd_and_lane_accumulation_agree() {
+        let row: Vec<u8> = (0..77).map(|i| (i * 37 % 256) as u8).collect();
+        let mut lanes = vec![1000u16; 77];
+        let mut best = lanes.clone();
+        accumulate_row_lanes(&row, &mut lanes);
+        accumulate_row(&row, &mut best);
+        assert_eq!(lanes, best);
+        assert_eq!(lanes[76], 1000 + (76 * 37 % 256) as u16);
+    }
+
+    #[test]
+    fn keeps_only_the_newest_pending_frame() {
+        let worker = ThumbnailWorker::new(Box::new(FakeCodec { delay: Duration::from_millis(30) }), 16, 16);
+        let frame = gradient_i420(64, 36);
+        worker.push(&frame, 64, 36, 0);
+        std::thread::sleep(Duration::from_millis(5));
+        // Frame 0 is encoding; 1 and 2 queue behind it and 1 is replaced
+        worker.push(&frame, 64, 36, 1000);
+        worker.push(&frame, 64, 36, 2000);
+        wait_for(&worker, 2);
+
+        // Only the newest finished thumbnail is kept
+        let thumbnail = worker.pop().unwrap();
+        assert_eq!((thumbnail.width, thumbnail.height, thumbnail.timestamp_ms), (16, 8, 2000));
+        assert_eq!(&thumbnail.jpeg[..2], &[16, 8]);
+        assert!(worker.pop().is_none());
+        assert_eq!(worker.stats().dropped, 2);
+    }
+
+    #[test]
+    fn encodes_jpeg_that_decodes_at_thumbnail_size() {
+        let (width, height) = (640, 360);
+        let frame = gradient_i420(width, height);
+        let mut scaled = ScaledFrame::default();
+        let mut sums = Vec::new();
+        downscale_i420(&frame, width, height, &mut scaled, 160, 90, &mut sums);
+
+        let mut jpeg = Vec::new();
+        TurboJpegEncoder::new(70).unwrap().encode(&scaled, &mut jpeg).unwrap();
+        assert_eq!(&jpeg[..2], &[0xff, 0xd8]);
+
+        let mut decoded = Vec::new();
+        let mut decoder = TurboJpegDecoder::new(false, true).unwrap();
+        assert_eq!(decoder.decode(&jpeg, &mut decoded).unwrap(), (160, 90));
+        // Mid-frame luma survives scaling and compression
+        let expected = scaled.plane(0)[45 * scaled.strides[0] + 80];
+        assert!((decoded[45 * 160 + 80] as i32 - expected as i32).abs() <= 4);
+    }
+
+    /// Run with:
+    ///   cargo test --release --features thumbnail bench_thumbnail_bandwidth -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn bench_thumbnail_bandwidth() {
+        const FRAMES: usize = 30;
+        const STREAMS: f64 = 50.0;
+        // What a grid tile would otherwise subscribe to
+        const VIDEO_KBPS: f64 = 2500.0;
+        let (width, height) = (1920, 1080);
+        let frames: Vec<Vec<u8>> = (0..FRAMES)
+            .map(|i| {
+                let mut frame = gradient_i420(width, height);
+                let mut noise = 0x9e37_79b9u32 ^ i as u32;
+                for v in frame[..width * height].iter_mut() {
+                    noise ^= noise << 13;
+                    noise ^= noise >> 17;
+                    noise ^= noise << 5;
+                    *v = v.saturating_add((noise & 7) as u8);
+                }
+                frame
+            })
+            .collect();
+
+        for (max_width, max_height) in [(160, 90), (320, 180)] {
+            let (tw, th) = fit_size(width, height, max_width, max_height);
+            let mut scaled = ScaledFrame::default();
+            let mut sums = Vec::new();
+            let mut encoder = TurboJpegEncoder::new(70).unwrap();
+            let mut jpeg = Vec::new();
+            let (mut scale, mut encode, mut bytes) = (Duration::ZERO, Duration::ZERO, 0);
+            for frame in &frames {
+                let start = Instant::now();
+                downscale_i420(frame, width, height, &mut scaled, tw, th, &mut sums);
+                let scaled_at = Instant::now();
+                encoder.encode(&scaled, &mut jpeg).unwrap();
+                scale += scaled_at - start;
+                encode += scaled_at.elapsed();
+                bytes += jpeg.len();
+            }
+            let average = bytes / FRAMES;
+            for interval_s in [1.0, 2.0] {
+                let kbps = average as f64 * 8.0 / 1000.0 / interval_s;
+                println!(
+                    "{}x{} -> {}x{} every {}s: {:.2}ms scale + {:.2}ms encode, {} B/thumbnail, \
+                     {:.1} kb/s per stream, 50-tile grid {:.0} kb/s vs {:.0} kb/s of video",
+                    width,
+                    height,
+                    tw,
+                    th,
+                    interval_s,
+                    scale.as_secs_f64() * 1000.0 / FRAMES as f64,
+                    encode.as_secs_f64() * 1000.0 / FRAMES as f64,
+                    average,
+                    kbps,
+                    kbps * STREAMS,
+                    VIDEO_KBPS * STREAMS
+                );
+            }
+        }
+    }
+}
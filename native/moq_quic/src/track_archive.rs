@@ -0,0 +1,1099 @@
+// Persistent track archive for DVR and local FETCH
+//
+// Each archived track is a directory of append-only segment files. Objects
+// and SAP time marks are appended as records through a large write buffer,
+// so the disk sees long sequential writes, and are read back through a
+// read-only shared mapping of the segment, so a seek is an index lookup and
+// a page-cache read.
+//
+// - Segments are preallocated to the segment size and truncated to their
+//   used length when sealed; the directory is the archive's only state, the
+//   in-memory index is rebuilt by scanning record headers on open
+// - Every record ends with a CRC-32C of its header and payload, so a record
+//   cut short by a crash or corrupted on disk is detected and the scan stops
+//   there
+// - A failed write seals the active segment at its last complete record;
+//   the next append starts a new segment
+// - Retention removes whole sealed segments, oldest first, once the archive
+//   exceeds its byte budget or a segment's newest record is older than the
+//   maximum age; the segment being written is never removed
+// - Objects may arrive out of order (several subgroups, several paths); the
+//   index is kept sorted by (group, object) and a later copy of an object
+//   replaces the earlier one
+
+use dashmap::DashMap;
+use once_cell::sync::Lazy;
+use std::fs::{File, OpenOptions};
+use std::io::{BufWriter, Seek, Write};
+use std::os::raw::c_char;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::{SystemTime, UNIX_EPOCH};
+
+/// Default segment size
+pub const DEFAULT_SEGMENT_BYTES: u64 = 64 << 20;
+
+/// Write buffer in front of the active segment
+const WRITE_BUFFER_BYTES: usize = 1 << 20;
+
+/// Record header: kind, flags, 2 reserved bytes, payload length, group, object
+const HEADER_LEN: usize = 24;
+/// Record trailer: CRC-32C of the header and payload
+const TRAILER_LEN: usize = 4;
+
+const RECORD_OBJECT: u8 = 1;
+const RECORD_TIME_MARK: u8 = 2;
+
+/// Object flag: the object starts a group or holds a keyframe
+pub const OBJECT_FLAG_KEY: u8 = 1;
+
+/// Number of values reported by `track_archive_get_stats`
+pub const ARCHIVE_STATS_LEN: usize = 9;
+
+const SEGMENT_EXTENSION: &str = "seg";
+
+// CRC-32C (Castagnoli), reflected
+const CRC_TABLE: [u32; 256] = {
+    let mut table = [0u32; 256];
+    let mut i = 0;
+    while i < 256 {
+        let mut crc = i as u32;
+        let mut bit = 0;
+        while bit < 8 {
+            crc = if crc & 1 != 0 { (crc >> 1) ^ 0x82F6_3B78 } else { crc >> 1 };
+            bit += 1;
+        }
+        table[i] = crc;
+        i += 1;
+    }
+    table
+};
+
+/// Continue the CRC-32C `crc` (0 to start) over `data`
+fn crc32c(crc: u32, data: &[u8]) -> u32 {
+    let mut crc = !crc;
+    for &b in data {
+        crc = CRC_TABLE[((crc ^ b as u32) & 0xFF) as usize] ^ (crc >> 8);
+    }
+    !crc
+}
+
+fn now_ms() -> u64 {
+    SystemTime::now().duration_since(UNIX_EPOCH).map_or(0, |d| d.as_millis() as u64)
+}
+
+/// Archive limits
+#[derive(Debug, Clone, Copy)]
+pub struct ArchiveConfig {
+    pub segment_bytes: u64,
+    /// Total bytes kept on disk (0 = unbounded)
+    pub max_bytes: u64,
+    /// Age of the newest record in a segment before it is removed (0 = unbounded)
+    pub max_age_ms: u64,
+}
+
+impl Default for ArchiveConfig {
+    fn default() -> Self {
+        Self { segment_bytes: DEFAULT_SEGMENT_BYTES, max_bytes: 0, max_age_ms: 0 }
+    }
+}
+
+/// Where an archived object lives
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ObjectEntry {
+    pub group: u64,
+    pub object: u64,
+    pub len: u32,
+    pub flags: u8,
+    segment: u32,
+    /// Payload offset in the segment
+    offset: u64,
+}
+
+impl ObjectEntry {
+    fn key(&self) -> (u64, u64) {
+        (self.group, self.object)
+    }
+}
+
+/// A media time pointing at an object, from a SAP timeline entry
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct TimeMark {
+    pub time_ms: u64,
+    pub group: u64,
+    pub object: u64,
+    /// SAP type; 0 marks a plain object, 1 and up a random access point
+    pub sap_type: u8,
+    segment: u32,
+}
+
+/// Read-only view of a segment file
+enum SegmentMap {
+    #[cfg(target_os = "linux")]
+    Mapped { ptr: *mut libc::c_void, len: usize },
+    Unmapped(File),
+}
+
+// The mapping is read-only; the active segment's pages are filled by writes
+// to the same file, which a shared mapping observes once flushed
+unsafe impl Send for SegmentMap {}
+
+impl SegmentMap {
+    fn open(path: &Path, len: u64) -> std::io::Result<Self> {
+        let file = File::open(path)?;
+        #[cfg(target_os = "linux")]
+        if len > 0 {
+            use std::os::unix::io::AsRawFd;
+            let ptr = unsafe {
+                libc::mmap(
+                    std::ptr::null_mut(),
+                    len as usize,
+                    libc::PROT_READ,
+                    libc::MAP_SHARED,
+                    file.as_raw_fd(),
+                    0,
+                )
+            };
+            if ptr == libc::MAP_FAILED {
+                return Err(std::io::Error::last_os_error());
+            }
+            return Ok(SegmentMap::Mapped { ptr, len: len as usize });
+        }
+        let _ = len;
+        Ok(SegmentMap::Unmapped(file))
+    }
+
+    /// Call `f` with `len` bytes at `offset`, which the caller has flushed
+    fn with_bytes<R>(&mut self, offset: u64, len: usize, f: impl FnOnce(&[u8]) -> R) -> std::io::Result<R> {
+        match self {
+            #[cfg(target_os = "linux")]
+            SegmentMap::Mapped { ptr, len: mapped } => {
+                if offset as usize + len > *mapped {
+                    return Err(std::io::ErrorKind::UnexpectedEof.into());
+                }
+                let bytes = unsafe { std::slice::from_raw_parts((*ptr as *const u8).add(offset as usize), len) };
+                Ok(f(bytes))
+            }
+            SegmentMap::Unmapped(file) => {
+                use std::io::{Read, Seek, SeekFrom};
+                let mut buf = vec![0u8; len];
+                file.seek(SeekFrom::Start(offset))?;
+                file.read_exact(&mut buf)?;
+                Ok(f(&buf))
+            }
+        }
+    }
+}
+
+impl Drop for SegmentMap {
+    fn drop(&mut self) {
+        #[cfg(target_os = "linux")]
+        if let SegmentMap::Mapped { ptr, len } = self {
+            unsafe {
+                libc::munmap(*ptr, *len);
+            }
+        }
+    }
+}
+
+struct Segment {
+    id: u32,
+    path: PathBuf,
+    map: SegmentMap,
+    /// Bytes holding records
+    end: u64,
+    /// Wall clock of the newest record (file mtime for scanned segments)
+    newest_ms: u64,
+}
+
+/// The segment being appended to
+struct ActiveWriter {
+    writer: BufWriter<File>,
+    /// Preallocated length
+    capacity: u64,
+    /// Bytes that reached the file (readable through the mapping)
+    flushed: u64,
+}
+
+/// Archive counters
+#[derive(Debug, Default, Clone, Copy)]
+pub struct ArchiveStats {
+    pub appends: u64,
+    pub appended_bytes: u64,
+    pub removed_segments: u64,
+}
+
+/// One track's archive directory
+pub struct TrackArchive {
+    dir: PathBuf,
+    config: ArchiveConfig,
+    /// Oldest first; the last one is active
+    segments: Vec<Segment>,
+    active: Option<ActiveWriter>,
+    objects: Vec<ObjectEntry>,
+    times: Vec<TimeMark>,
+    disk_bytes: u64,
+    stats: ArchiveStats,
+}
+
+fn segment_path(dir: &Path, id: u32) -> PathBuf {
+    dir.join(format!("{:010}.{}", id, SEGMENT_EXTENSION))
+}
+
+/// Insert keeping `items` sorted by `key`, replacing an equal key
+fn insert_sorted<T, K: Ord>(items: &mut Vec<T>, item: T, key: impl Fn(&T) -> K) {
+    let k = key(&item);
+    match items.last() {
+        Some(last) if key(last) < k => items.push(item),
+        None => items.push(item),
+        _ => match items.binary_search_by(|probe| key(probe).cmp(&k)) {
+            Ok(i) => items[i] = item,
+            Err(i) => items.insert(i, item),
+        },
+    }
+}
+
+impl TrackArchive {
+    /// Open the archive in `dir`, creating it if needed, and index what it holds
+    pub fn open(dir: &Path, config: ArchiveConfig) -> std::io::Result<Self> {
+        std::fs::create_dir_all(dir)?;
+        let config = ArchiveConfig {
+            segment_bytes: if config.segment_bytes == 0 { DEFAULT_SEGMENT_BYTES } else { config.segment_bytes },
+            ..config
+        };
+
+        let mut ids: Vec<u32> = std::fs::read_dir(dir)?
+            .filter_map(|entry| {
+                let path = entry.ok()?.path();
+                if path.extension()? != SEGMENT_EXTENSION {
+                    return None;
+                }
+                path.file_stem()?.to_str()?.parse().ok()
+            })
+            .collect();
+        ids.sort_unstable();
+
+        let mut archive = Self {
+            dir: dir.to_path_buf(),
+            config,
+            segments: Vec::with_capacity(ids.len()),
+            active: None,
+            objects: Vec::new(),
+            times: Vec::new(),
+            disk_bytes: 0,
+            stats: ArchiveStats::default(),
+        };
+        for (i, &id) in ids.iter().enumerate() {
+            archive.scan_segment(id, i + 1 == ids.len())?;
+        }
+        Ok(archive)
+    }
+
+    /// Index one segment's records; the last segment is reopened for appending
+    fn scan_segment(&mut self, id: u32, last: bool) -> std::io::Result<()> {
+        let path = segment_path(&self.dir, id);
+        let metadata = std::fs::metadata(&path)?;
+        let file_len = metadata.len();
+        let newest_ms = metadata
+            .modified()
+            .ok()
+            .and_then(|t| t.duration_since(UNIX_EPOCH).ok())
+            .map_or(0, |d| d.as_millis() as u64);
+        let mut map = SegmentMap::open(&path, file_len)?;
+
+        let mut end = 0u64;
+        let mut objects = Vec::new();
+        let mut times = Vec::new();
+        while end + (HEADER_LEN + TRAILER_LEN) as u64 <= file_len {
+            let header = map.with_bytes(end, HEADER_LEN, |h| {
+                let mut b = [0u8; HEADER_LEN];
+                b.copy_from_slice(h);
+                b
+            })?;
+            let kind = header[0];
+            let len = u32::from_le_bytes(header[4..8].try_into().unwrap());
+            let record_len = (HEADER_LEN + len as usize + TRAILER_LEN) as u64;
+            if (kind != RECORD_OBJECT && kind != RECORD_TIME_MARK) || end + record_len > file_len {
+                break;
+            }
+            let payload = end + HEADER_LEN as u64;
+            let trailer = map.with_bytes(payload + len as u64, TRAILER_LEN, |t| {
+                u32::from_le_bytes(t.try_into().unwrap())
+            })?;
+            let crc = map.with_bytes(payload, len as usize, |p| crc32c(crc32c(0, &header), p))?;
+            if trailer != crc {
+                break;
+            }
+            let group = u64::from_le_bytes(header[8..16].try_into().unwrap());
+            let object = u64::from_le_bytes(header[16..24].try_into().unwrap());
+            if kind == RECORD_OBJECT {
+                objects.push(ObjectEntry { group, object, len, flags: header[1], segment: id, offset: payload });
+            } else if len == 8 {
+                let time_ms = map.with_bytes(payload, 8, |t| u64::from_le_bytes(t.try_into().unwrap()))?;
+                times.push(TimeMark { time_ms, group, object, sap_type: header[1], segment: id });
+            }
+            end += record_len;
+        }
+
+        for entry in objects {
+            insert_sorted(&mut self.objects, entry, ObjectEntry::key);
+        }
+        for mark in times {
+            insert_sorted(&mut self.times, mark, |m| (m.time_ms, m.group, m.object));
+        }
+
+        if last && end < file_len {
+            // Resume after the last complete record; anything past it is
+            // preallocated space or a torn write
+            let file = OpenOptions::new().write(true).open(&path)?;
+            use std::io::SeekFrom;
+            let mut writer = BufWriter::with_capacity(WRITE_BUFFER_BYTES, file);
+            writer.seek(SeekFrom::Start(end))?;
+            self.active = Some(ActiveWriter { writer, capacity: file_len, flushed: end });
+        } else if end < file_len {
+            // A sealed segment with a torn tail
+            OpenOptions::new().write(true).open(&path)?.set_len(end)?;
+            map = SegmentMap::open(&path, end)?;
+        }
+
+        self.disk_bytes += end;
+        self.segments.push(Segment { id, path, map, end, newest_ms });
+        Ok(())
+    }
+
+    /// Flush the active segment's buffer and truncate it to its records
+    fn seal(&mut self) -> std::io::Result<()> {
+        let Some(mut active) = self.active.take() else { return Ok(()) };
+        active.writer.flush()?;
+        let segment = self.segments.last_mut().expect("active segment");
+        let file = active.writer.into_inner().map_err(|e| e.into_error())?;
+        file.set_len(segment.end)?;
+        segment.map = SegmentMap::open(&segment.path, segment.end)?;
+        Ok(())
+    }
+
+    /// Seal the active segment after a failed write
+    ///
+    /// The record being written is dropped: complete records still in the
+    /// buffer are written out and the file is truncated after them. If even
+    /// they cannot be written, the segment ends at the last byte that reached
+    /// the file; reading the objects lost with it fails, and a rescan stops at
+    /// the torn record.
+    fn seal_after_error(&mut self) {
+        let Some(active) = self.active.take() else { return };
+        let segment = self.segments.last_mut().expect("active segment");
+        // Drops the buffered bytes instead of flushing them
+        let (mut file, buffered) = active.writer.into_parts();
+        let buffered = buffered.unwrap_or_default();
+
+        let mut end = segment.end;
+        let written = file.stream_position().unwrap_or(active.flushed);
+        if written < end {
+            let missing = (end - written) as usize;
+            if buffered.len() < missing || file.write_all(&buffered[..missing]).is_err() {
+                end = written;
+            }
+        }
+        if let Err(e) = file.set_len(end) {
+            log::warn!("Failed to truncate archive segment {}: {}", segment.path.display(), e);
+        }
+        match SegmentMap::open(&segment.path, end) {
+            Ok(map) => segment.map = map,
+            Err(e) => log::warn!("Failed to map archive segment {}: {}", segment.path.display(), e),
+        }
+        self.disk_bytes -= segment.end - end;
+        segment.end = end;
+    }
+
+    /// Make sure the active segment has room for a record of `record_len`
+    fn ensure_room(&mut self, record_len: u64) -> std::io::Result<()> {
+        if let Some(active) = &self.active {
+            let end = self.segments.last().map_or(0, |s| s.end);
+            if end + record_len <= active.capacity {
+                return Ok(());
+            }
+            self.seal()?;
+        }
+        let id = self.segments.last().map_or(0, |s| s.id + 1);
+        let path = segment_path(&self.dir, id);
+        let capacity = self.config.segment_bytes.max(record_len);
+        let file = OpenOptions::new().write(true).create(true).truncate(true).open(&path)?;
+        file.set_len(capacity)?;
+        let map = SegmentMap::open(&path, capacity)?;
+        self.segments.push(Segment { id, path, map, end: 0, newest_ms: now_ms() });
+        self.active = Some(ActiveWriter {
+            writer: BufWriter::with_capacity(WRITE_BUFFER_BYTES, file),
+            capacity,
+            flushed: 0,
+        });
+        Ok(())
+    }
+
+    /// Append one record; returns its segment and payload offset
+    fn append_record(&mut self, kind: u8, flags: u8, group: u64, object: u64, payload: &[u8]) -> std::io::Result<(u32, u64)> {
+        let len = u32::try_from(payload.len()).map_err(|_| std::io::Error::from(std::io::ErrorKind::InvalidInput))?;
+        let record_len = (HEADER_LEN + payload.len() + TRAILER_LEN) as u64;
+        self.ensure_room(record_len)?;
+
+        let mut header = [0u8; HEADER_LEN];
+        header[0] = kind;
+        header[1] = flags;
+        header[4..8].copy_from_slice(&len.to_le_bytes());
+        header[8..16].copy_from_slice(&group.to_le_bytes());
+        header[16..24].copy_from_slice(&object.to_le_bytes());
+
+        let crc = crc32c(crc32c(0, &header), payload);
+        let writer = &mut self.active.as_mut().expect("active segment").writer;
+        let written = writer
+            .write_all(&header)
+            .and_then(|_| writer.write_all(payload))
+            .and_then(|_| writer.write_all(&crc.to_le_bytes()));
+        if let Err(e) = written {
+            self.seal_after_error();
+            return Err(e);
+        }
+
+        let segment = self.segments.last_mut().expect("active segment");
+        let offset = segment.end + HEADER_LEN as u64;
+        segment.end += record_len;
+        segment.newest_ms = now_ms();
+        self.disk_bytes += record_len;
+        self.stats.appends += 1;
+        self.stats.appended_bytes += record_len;
+        Ok((segment.id, offset))
+    }
+
+    /// Append an object
+    pub fn append(&mut self, group: u64, object: u64, flags: u8, payload: &[u8]) -> std::io::Result<()> {
+        let (segment, offset) = self.append_record(RECORD_OBJECT, flags, group, object, payload)?;
+        let entry = ObjectEntry { group, object, len: payload.len() as u32, flags, segment, offset };
+        insert_sorted(&mut self.objects, entry, ObjectEntry::key);
+        self.enforce_retention()
+    }
+
+    /// Record that `(group, object)` is presented at `time_ms`
+    pub fn mark_time(&mut self, group: u64, object: u64, time_ms: u64, sap_type: u8) -> std::io::Result<()> {
+        let (segment, _) = self.append_record(RECORD_TIME_MARK, sap_type, group, object, &time_ms.to_le_bytes())?;
+        let mark = TimeMark { time_ms, group, object, sap_type, segment };
+        insert_sorted(&mut self.times, mark, |m| (m.time_ms, m.group, m.object));
+        Ok(())
+    }
+
+    /// Write buffered records to the segment file
+    pub fn flush(&mut self) -> std::io::Result<()> {
+        if let Some(active) = &mut self.active {
+            active.writer.flush()?;
+            active.flushed = self.segments.last().map_or(0, |s| s.end);
+        }
+        Ok(())
+    }
+
+    /// Remove sealed segments over the byte budget or past the maximum age
+    fn enforce_retention(&mut self) -> std::io::Result<()> {
+        let cutoff = if self.config.max_age_ms > 0 { now_ms().saturating_sub(self.config.max_age_ms) } else { 0 };
+        let mut removed = Vec::new();
+        while self.segments.len() > 1 {
+            let oldest = &self.segments[0];
+            let over_budget = self.config.max_bytes > 0 && self.disk_bytes > self.config.max_bytes;
+            if !over_budget && oldest.newest_ms >= cutoff {
+                break;
+            }
+            let oldest = self.segments.remove(0);
+            self.disk_bytes -= oldest.end;
+            self.stats.removed_segments += 1;
+            removed.push(oldest.id);
+            drop(oldest.map);
+            if let Err(e) = std::fs::remove_file(&oldest.path) {
+                log::warn!("Failed to remove archive segment {}: {}", oldest.path.display(), e);
+            }
+        }
+        if !removed.is_empty() {
+            self.objects.retain(|e| !removed.contains(&e.segment));
+            self.times.retain(|m| !removed.contains(&m.segment));
+        }
+        Ok(())
+    }
+
+    fn find(&self, group: u64, object: u64) -> Option<ObjectEntry> {
+        self.objects.binary_search_by(|e| e.key().cmp(&(group, object))).ok().map(|i| self.objects[i])
+    }
+
+    /// Call `f` with an object's payload, read from the segment mapping
+    pub fn with_object<R>(&mut self, group: u64, object: u64, f: impl FnOnce(&[u8]) -> R) -> std::io::Result<Option<R>> {
+        let Some(entry) = self.find(group, object) else { return Ok(None) };
+        let index = self.segments.partition_point(|s| s.id < entry.segment);
+        let active = index + 1 == self.segments.len() && self.active.is_some();
+        if active && entry.offset + entry.len as u64 > self.active.as_ref().unwrap().flushed {
+            self.flush()?;
+        }
+        self.segments[index].map.with_bytes(entry.offset, entry.len as usize, f).map(Some)
+    }
+
+    /// Copy of an object's payload
+    pub fn get(&mut self, group: u64, object: u64) -> std::io::Result<Option<Vec<u8>>> {
+        self.with_object(group, object, |bytes| bytes.to_vec())
+    }
+
+    /// Objects from `start` to `end` inclusive, in (group, object) order
+    pub fn range(&self, start: (u64, u64), end: (u64, u64)) -> &[ObjectEntry] {
+        let from = self.objects.partition_point(|e| e.key() < start);
+        let to = self.objects.partition_point(|e| e.key() <= end);
+        &self.objects[from..to.max(from)]
+    }
+
+    /// The latest random access point presented at or before `time_ms`
+    pub fn seek_time(&self, time_ms: u64) -> Option<TimeMark> {
+        let to = self.times.partition_point(|m| m.time_ms <= time_ms);
+        self.times[..to].iter().rev().find(|m| m.sap_type >= 1).copied()
+    }
+
+    /// Oldest and newest archived object
+    pub fn bounds(&self) -> Option<((u64, u64), (u64, u64))> {
+        Some((self.objects.first()?.key(), self.objects.last()?.key()))
+    }
+
+    pub fn object_count(&self) -> usize {
+        self.objects.len()
+    }
+
+    pub fn disk_bytes(&self) -> u64 {
+        self.disk_bytes
+    }
+
+    pub fn stats(&self) -> ArchiveStats {
+        self.stats
+    }
+
+    fn stat_values(&self) -> [u64; ARCHIVE_STATS_LEN] {
+        let ((first_group, _), (last_group, _)) = self.bounds().unwrap_or(((0, 0), (0, 0)));
+        [
+            self.objects.len() as u64,
+            self.times.len() as u64,
+            self.segments.len() as u64,
+            self.disk_bytes,
+            self.stats.appends,
+            self.stats.appended_bytes,
+            self.stats.removed_segments,
+            first_group,
+            last_group,
+        ]
+    }
+}
+
+impl Drop for TrackArchive {
+    fn drop(&mut self) {
+        if let Err(e) = self.seal() {
+            log::warn!("Failed to seal archive {}: {}", self.dir.display(), e);
+        }
+    }
+}
+
+static ARCHIVES: Lazy<DashMap<u64, Arc<Mutex<TrackArchive>>>> = Lazy::new(DashMap::new);
+static NEXT_ARCHIVE_ID: AtomicU64 = AtomicU64::new(1);
+
+fn archive(archive_id: u64) -> Option<Arc<Mutex<TrackArchive>>> {
+    ARCHIVES.get(&archive_id).map(|a| a.clone())
+}
+
+/// Open (or create) the archive in directory `dir`
+///
+/// # Arguments
+/// * `segment_bytes` - Segment file size (0 = 64 MB)
+/// * `max_bytes` - Bytes kept on disk (0 = unbounded)
+/// * `max_age_ms` - Age after which whole segments are removed (0 = unbounded)
+///
+/// # Returns
+/// Archive ID, or 0 on failure
+#[no_mangle]
+pub extern "C" fn track_archive_open(
+    dir: *const c_char,
+    segment_bytes: u64,
+    max_bytes: u64,
+    max_age_ms: u64,
+) -> u64 {
+    if dir.is_null() {
+        return 0;
+    }
+    let dir = unsafe { std::ffi::CStr::from_ptr(dir) }.to_string_lossy().into_owned();
+    let config = ArchiveConfig { segment_bytes, max_bytes, max_age_ms };
+    match TrackArchive::open(Path::new(&dir), config) {
+        Ok(archive) => {
+            let id = NEXT_ARCHIVE_ID.fetch_add(1, Ordering::Relaxed);
+            log::info!(
+                "Opened track archive {} ({}, {} objects, {} bytes)",
+                id,
+                dir,
+                archive.object_count(),
+                archive.disk_bytes()
+            );
+            ARCHIVES.insert(id, Arc::new(Mutex::new(archive)));
+            id
+        }
+        Err(e) => {
+            log::error!("Failed to open track archive {}: {}", dir, e);
+            0
+        }
+    }
+}
+
+/// Append an object
+///
+/// # Arguments
+/// * `flags` - `OBJECT_FLAG_KEY` when the object starts a group
+///
+/// # Returns
+/// 0 on success, -1 if the archive does not exist, -2 on an I/O error
+#[no_mangle]
+pub extern "C" fn track_archive_append(
+    archive_id: u64,
+    group: u64,
+    object: u64,
+    flags: u8,
+    data: *const u8,
+    len: usize,
+) -> i32 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let payload = if data.is_null() || len == 0 { &[][..] } else { unsafe { std::slice::from_raw_parts(data, len) } };
+    let mut archive = archive.lock().unwrap();
+    match archive.append(group, object, flags, payload) {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Track archive {} append failed: {}", archive_id, e);
+            -2
+        }
+    }
+}
+
+/// Record a SAP timeline entry: `(group, object)` is presented at `time_ms`
+///
+/// # Returns
+/// 0 on success, -1 if the archive does not exist, -2 on an I/O error
+#[no_mangle]
+pub extern "C" fn track_archive_mark_time(
+    archive_id: u64,
+    group: u64,
+    object: u64,
+    time_ms: u64,
+    sap_type: u8,
+) -> i32 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let mut archive = archive.lock().unwrap();
+    match archive.mark_time(group, object, time_ms, sap_type) {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Track archive {} time mark failed: {}", archive_id, e);
+            -2
+        }
+    }
+}
+
+/// Copy an object's payload into `out`
+///
+/// # Returns
+/// Payload length (nothing is copied if it exceeds `cap`), -1 if the archive
+/// does not exist, -2 on an I/O error, -3 if the object is not archived
+#[no_mangle]
+pub extern "C" fn track_archive_read(
+    archive_id: u64,
+    group: u64,
+    object: u64,
+    out: *mut u8,
+    cap: usize,
+) -> i64 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let mut archive = archive.lock().unwrap();
+    let result = archive.with_object(group, object, |bytes| {
+        if !out.is_null() && bytes.len() <= cap {
+            unsafe { std::ptr::copy_nonoverlapping(bytes.as_ptr(), out, bytes.len()) };
+        }
+        bytes.len() as i64
+    });
+    match result {
+        Ok(Some(len)) => len,
+        Ok(None) => -3,
+        Err(e) => {
+            log::error!("Track archive {} read failed: {}", archive_id, e);
+            -2
+        }
+    }
+}
+
+/// List the objects from `(start_group, start_object)` to
+/// `(end_group, end_object)` inclusive, as a FETCH would return them
+///
+/// Writes up to `cap` entries of four values: group, object, payload length
+/// and flags.
+///
+/// # Returns
+/// Number of entries in the range (may exceed `cap`), or -1 if the archive
+/// does not exist
+#[no_mangle]
+pub extern "C" fn track_archive_locate(
+    archive_id: u64,
+    start_group: u64,
+    start_object: u64,
+    end_group: u64,
+    end_object: u64,
+    out: *mut u64,
+    cap: usize,
+) -> i64 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let archive = archive.lock().unwrap();
+    let entries = archive.range((start_group, start_object), (end_group, end_object));
+    if !out.is_null() {
+        let out = unsafe { std::slice::from_raw_parts_mut(out, cap.min(entries.len()) * 4) };
+        for (chunk, entry) in out.chunks_exact_mut(4).zip(entries) {
+            chunk.copy_from_slice(&[entry.group, entry.object, entry.len as u64, entry.flags as u64]);
+        }
+    }
+    entries.len() as i64
+}
+
+/// Find the random access point to start playback at `time_ms`
+///
+/// Writes group, object and the mark's time to `out`.
+///
+/// # Returns
+/// 0 on success, -1 if the archive does not exist, -3 if no random access
+/// point is at or before `time_ms`
+#[no_mangle]
+pub extern "C" fn track_archive_seek_time(archive_id: u64, time_ms: u64, out: *mut u64) -> i32 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let archive = archive.lock().unwrap();
+    let Some(mark) = archive.seek_time(time_ms) else { return -3 };
+    if !out.is_null() {
+        unsafe { std::slice::from_raw_parts_mut(out, 3) }.copy_from_slice(&[mark.group, mark.object, mark.time_ms]);
+    }
+    0
+}
+
+/// Write buffered records to disk
+///
+/// # Returns
+/// 0 on success, -1 if the archive does not exist, -2 on an I/O error
+#[no_mangle]
+pub extern "C" fn track_archive_flush(archive_id: u64) -> i32 {
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let mut archive = archive.lock().unwrap();
+    match archive.flush() {
+        Ok(()) => 0,
+        Err(e) => {
+            log::error!("Track archive {} flush failed: {}", archive_id, e);
+            -2
+        }
+    }
+}
+
+/// Get archive counters
+///
+/// Values, in order: objects, time marks, segments, bytes on disk, appends,
+/// appended bytes, removed segments, oldest group, newest group.
+///
+/// # Returns
+/// Number of values written, or -1 if the archive does not exist
+#[no_mangle]
+pub extern "C" fn track_archive_get_stats(archive_id: u64, out: *mut u64, len: usize) -> i32 {
+    if out.is_null() {
+        return -1;
+    }
+    let Some(archive) = archive(archive_id) else { return -1 };
+    let values = archive.lock().unwrap().stat_values();
+    let count = values.len().min(len);
+    unsafe { std::slice::from_raw_parts_mut(out, count) }.copy_from_slice(&values[..count]);
+    count as i32
+}
+
+/// Seal the active segment and close the archive; its files stay on disk
+#[no_mangle]
+pub extern "C" fn track_archive_close(archive_id: u64) {
+    if ARCHIVES.remove(&archive_id).is_some() {
+        log::info!("Closed track archive {}", archive_id);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    fn temp_dir(name: &str) -> PathBuf {
+        let dir = std::env::temp_dir().join(format!("track_archive_{}_{}", name, std::process::id()));
+        let _ = std::fs::remove_dir_all(&dir);
+        dir
+    }
+
+    fn payload(group: u64, object: u64, len: usize) -> Vec<u8> {
+        (0..len).map(|i| (group as usize * 31 + object as usize * 7 + i) as u8).collect()
+    }
+
+    #[test]
+    fn append_and_read_back() {
+        let dir = temp_dir("read");
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        for g in 0..5u64 {
+            for o in 0..10u64 {
+                let flags = if o == 0 { OBJECT_FLAG_KEY } else { 0 };
+                archive.append(g, o, flags, &payload(g, o, 100 + o as usize * 50)).unwrap();
+            }
+        }
+        // Unflushed records are flushed on read
+        assert_eq!(archive.get(4, 9).unwrap().unwrap(), payload(4, 9, 550));
+        assert_eq!(archive.get(0, 0).unwrap().unwrap(), payload(0, 0, 100));
+        assert_eq!(archive.get(5, 0).unwrap(), None);
+        assert_eq!(archive.bounds(), Some(((0, 0), (4, 9))));
+
+        let range = archive.range((1, 5), (2, u64::MAX));
+        assert_eq!(range.len(), 15);
+        assert_eq!((range[0].group, range[0].object), (1, 5));
+        assert_eq!(range[5].flags, OBJECT_FLAG_KEY);
+        assert!(archive.range((3, 0), (2, 0)).is_empty());
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn reopen_rebuilds_index() {
+        let dir = temp_dir("reopen");
+        let config = ArchiveConfig { segment_bytes: 4096, ..Default::default() };
+        {
+            let mut archive = TrackArchive::open(&dir, config).unwrap();
+            for g in 0..20u64 {
+                archive.append(g, 0, OBJECT_FLAG_KEY, &payload(g, 0, 700)).unwrap();
+                archive.mark_time(g, 0, 1_000 + g * 2_000, 1).unwrap();
+            }
+            assert!(archive.segments.len() > 1);
+        }
+        let mut archive = TrackArchive::open(&dir, config).unwrap();
+        assert_eq!(archive.object_count(), 20);
+        assert_eq!(archive.get(13, 0).unwrap().unwrap(), payload(13, 0, 700));
+        assert_eq!(archive.seek_time(10_500).map(|m| m.group), Some(4));
+
+        // Appending resumes in the last segment
+        archive.append(20, 0, OBJECT_FLAG_KEY, &payload(20, 0, 10)).unwrap();
+        drop(archive);
+        let mut archive = TrackArchive::open(&dir, config).unwrap();
+        assert_eq!(archive.object_count(), 21);
+        assert_eq!(archive.get(20, 0).unwrap().unwrap(), payload(20, 0, 10));
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn torn_record_is_dropped() {
+        let dir = temp_dir("torn");
+        {
+            let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+            archive.append(0, 0, OBJECT_FLAG_KEY, &payload(0, 0, 300)).unwrap();
+            archive.append(0, 1, 0, &payload(0, 1, 300)).unwrap();
+            archive.flush().unwrap();
+            // Leak the archive so it is never sealed, as after a crash
+            std::mem::forget(archive);
+        }
+        // Clobber the second record's trailer
+        let path = segment_path(&dir, 0);
+        let mut data = std::fs::read(&path).unwrap();
+        let trailer = 2 * (HEADER_LEN + 300) + TRAILER_LEN;
+        data[trailer..trailer + TRAILER_LEN].fill(0);
+        std::fs::write(&path, &data).unwrap();
+
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        assert_eq!(archive.object_count(), 1);
+        // The torn record is overwritten by the next append
+        archive.append(0, 1, 0, &payload(0, 1, 20)).unwrap();
+        assert_eq!(archive.get(0, 1).unwrap().unwrap(), payload(0, 1, 20));
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn corrupted_payload_is_dropped() {
+        let dir = temp_dir("corrupt");
+        {
+            let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+            for o in 0..3u64 {
+                archive.append(0, o, 0, &payload(0, o, 300)).unwrap();
+            }
+        }
+        // Flip a payload byte of the second record; its length still matches
+        let path = segment_path(&dir, 0);
+        let mut data = std::fs::read(&path).unwrap();
+        data[HEADER_LEN + 300 + TRAILER_LEN + HEADER_LEN + 10] ^= 1;
+        std::fs::write(&path, &data).unwrap();
+
+        let archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        assert_eq!(archive.object_count(), 1);
+        assert_eq!(crc32c(0, b"123456789"), 0xE306_9283);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn failed_write_seals_segment() {
+        let dir = temp_dir("failed");
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        archive.append(0, 0, OBJECT_FLAG_KEY, &payload(0, 0, 300)).unwrap();
+        archive.flush().unwrap();
+        archive.append(0, 1, 0, &payload(0, 1, 300)).unwrap();
+        // As after a write error: buffered complete records are kept
+        archive.seal_after_error();
+        let record = (HEADER_LEN + 300 + TRAILER_LEN) as u64;
+        assert_eq!(std::fs::metadata(segment_path(&dir, 0)).unwrap().len(), 2 * record);
+        assert_eq!(archive.get(0, 1).unwrap().unwrap(), payload(0, 1, 300));
+
+        // The next append starts a new segment
+        archive.append(0, 2, 0, &payload(0, 2, 10)).unwrap();
+        assert_eq!(archive.segments.len(), 2);
+        drop(archive);
+        let archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        assert_eq!(archive.object_count(), 3);
+        assert_eq!(archive.disk_bytes(), 2 * record + (HEADER_LEN + 10 + TRAILER_LEN) as u64);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn seek_time_finds_random_access_point() {
+        let dir = temp_dir("seek");
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        for g in 0..4u64 {
+            for o in 0..3u64 {
+                archive.append(g, o, (o == 0) as u8, b"x").unwrap();
+                archive.mark_time(g, o, g * 3_000 + o * 1_000, (o == 0) as u8).unwrap();
+            }
+        }
+        assert_eq!(archive.seek_time(7_500).map(|m| (m.group, m.object)), Some((2, 0)));
+        assert_eq!(archive.seek_time(6_000).map(|m| (m.group, m.object)), Some((2, 0)));
+        assert_eq!(archive.seek_time(5_999).map(|m| (m.group, m.object)), Some((1, 0)));
+        assert_eq!(archive.seek_time(u64::MAX).map(|m| m.group), Some(3));
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn retention_removes_oldest_segments() {
+        let dir = temp_dir("retention");
+        let config = ArchiveConfig { segment_bytes: 8192, max_bytes: 32 * 1024, max_age_ms: 0 };
+        let mut archive = TrackArchive::open(&dir, config).unwrap();
+        for g in 0..200u64 {
+            archive.append(g, 0, OBJECT_FLAG_KEY, &payload(g, 0, 1000)).unwrap();
+            archive.mark_time(g, 0, g * 1_000, 1).unwrap();
+        }
+        assert!(archive.disk_bytes() <= 32 * 1024);
+        assert!(archive.stats().removed_segments > 0);
+        let ((first, _), (last, _)) = archive.bounds().unwrap();
+        assert_eq!(last, 199);
+        assert!(first > 150);
+        assert_eq!(archive.get(0, 0).unwrap(), None);
+        assert_eq!(archive.get(first, 0).unwrap().unwrap(), payload(first, 0, 1000));
+        // Time marks of removed segments go with them
+        assert_eq!(archive.seek_time(1_000), None);
+        let files = std::fs::read_dir(&dir).unwrap().count();
+        assert_eq!(files, archive.segments.len());
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn out_of_order_and_duplicate_objects() {
+        let dir = temp_dir("order");
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        for (g, o) in [(2, 0), (0, 0), (1, 1), (1, 0), (2, 1)] {
+            archive.append(g, o, 0, &payload(g, o, 8)).unwrap();
+        }
+        archive.append(1, 1, 0, b"again").unwrap();
+        let keys: Vec<_> = archive.range((0, 0), (u64::MAX, u64::MAX)).iter().map(|e| e.key()).collect();
+        assert_eq!(keys, vec![(0, 0), (1, 0), (1, 1), (2, 0), (2, 1)]);
+        assert_eq!(archive.get(1, 1).unwrap().unwrap(), b"again");
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    #[test]
+    fn ffi_round_trip() {
+        let dir = temp_dir("ffi");
+        let path = std::ffi::CString::new(dir.to_str().unwrap()).unwrap();
+        let id = track_archive_open(path.as_ptr(), 0, 0, 0);
+        assert_ne!(id, 0);
+        let data = payload(3, 1, 64);
+        assert_eq!(track_archive_append(id, 3, 0, OBJECT_FLAG_KEY, data.as_ptr(), 10), 0);
+        assert_eq!(track_archive_append(id, 3, 1, 0, data.as_ptr(), data.len()), 0);
+        assert_eq!(track_archive_mark_time(id, 3, 0, 5_000, 1), 0);
+
+        assert_eq!(track_archive_read(id, 3, 1, std::ptr::null_mut(), 0), 64);
+        let mut out = vec![0u8; 64];
+        assert_eq!(track_archive_read(id, 3, 1, out.as_mut_ptr(), out.len()), 64);
+        assert_eq!(out, data);
+        assert_eq!(track_archive_read(id, 9, 9, out.as_mut_ptr(), out.len()), -3);
+
+        let mut entries = [0u64; 8];
+        assert_eq!(track_archive_locate(id, 3, 0, 3, u64::MAX, entries.as_mut_ptr(), 2), 2);
+        assert_eq!(entries, [3, 0, 10, 1, 3, 1, 64, 0]);
+
+        let mut mark = [0u64; 3];
+        assert_eq!(track_archive_seek_time(id, 6_000, mark.as_mut_ptr()), 0);
+        assert_eq!(mark, [3, 0, 5_000]);
+        assert_eq!(track_archive_seek_time(id, 4_000, mark.as_mut_ptr()), -3);
+
+        let mut stats = [0u64; ARCHIVE_STATS_LEN];
+        assert_eq!(track_archive_get_stats(id, stats.as_mut_ptr(), stats.len()), ARCHIVE_STATS_LEN as i32);
+        assert_eq!(&stats[..3], &[2, 1, 1]);
+        track_archive_close(id);
+        assert_eq!(track_archive_flush(id), -1);
+        assert_eq!(track_archive_open(std::ptr::null(), 0, 0, 0), 0);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+
+    // Append throughput and random-seek latency over a 1 GB archive of
+    // 1080p60-sized groups; run with
+    // `cargo test --release --features track-archive bench_append_and_seek -- --ignored --nocapture`
+    #[test]
+    #[ignore]
+    fn bench_append_and_seek() {
+        let dir = temp_dir("bench");
+        let mut archive = TrackArchive::open(&dir, ArchiveConfig::default()).unwrap();
+        let keyframe = vec![0x5Au8; 250_000];
+        let delta = vec![0xA5u8; 14_000];
+        let mut bytes = 0usize;
+        let mut groups = 0u64;
+        let start = Instant::now();
+        while bytes < 1 << 30 {
+            for o in 0..60u64 {
+                let data = if o == 0 { &keyframe } else { &delta };
+                archive.append(groups, o, (o == 0) as u8, data).unwrap();
+                bytes += data.len();
+            }
+            archive.mark_time(groups, 0, groups * 1_000, 1).unwrap();
+            groups += 1;
+        }
+        archive.flush().unwrap();
+        let elapsed = start.elapsed();
+        println!(
+            "append: {} objects, {:.0} MB in {:.2}s ({:.0} MB/s)",
+            archive.object_count(),
+            bytes as f64 / 1e6,
+            elapsed.as_secs_f64(),
+            bytes as f64 / 1e6 / elapsed.as_secs_f64()
+        );
+
+        // xorshift so the bench needs no rand crate
+        let mut state = 0x9E37_79B9_7F4A_7C15u64;
+        let mut next = || {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state
+        };
+        let mut seek = Vec::with_capacity(100_000);
+        let mut sum = 0u64;
+        for _ in 0..100_000 {
+            let time = next() % (groups * 1_000);
+            let t0 = Instant::now();
+            let mark = archive.seek_time(time).unwrap();
+            let first = archive.with_object(mark.group, mark.object, |b| b[0] as u64 + b[b.len() - 1] as u64).unwrap();
+            seek.push(t0.elapsed());
+            sum += first.unwrap();
+        }
+        seek.sort();
+        println!(
+            "seek to time and read keyframe: p50 {:.2}us, p99 {:.2}us (checksum {})",
+            seek[seek.len() / 2].as_secs_f64() * 1e6,
+            seek[seek.len() * 99 / 100].as_secs_f64() * 1e6,
+            sum
+        );
+        drop(archive);
+        let _ = std::fs::remove_dir_all(&dir);
+    }
+}
@@ -3,14 +3,20 @@
 
 use web_transport_quinn::{Session, Client as WebTransportClient, SendStream};
 use web_transport_quinn::proto::ConnectRequest;
-use quinn::{Endpoint, ClientConfig, TokioRuntime, EndpointConfig, TransportConfig};
+use quinn::{Endpoint, ClientConfig, EndpointConfig, TransportConfig};
 use quinn::crypto::rustls::QuicClientConfig;
 use rustls::pki_types::{ServerName, CertificateDer, UnixTime};
 use dashmap::DashMap;
 use once_cell::sync::OnceCell;
 use std::sync::Arc;
-use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
 use tokio::runtime::Runtime;
+use crate::stream_reassembly::{self, StreamReassembly};
+use crate::bandwidth::{BandwidthRegistry, TrackAliasSniffer};
+use crate::playback_sink::{self, Delivery, RouteTable};
+use crate::publish_pipeline;
+use crate::redundant;
+use std::time::Instant;
 use std::slice;
 use std::ffi::c_char;
 use std::collections::VecDeque;
@@ -32,6 +38,9 @@ fn debug_log(msg: &str) {
 
 // Maximum receive buffer size per session
 const MAX_RECV_BUFFER_SIZE: usize = 64 * 1024; // 64KB
+// Maximum bytes buffered per incoming data stream before the reader stops
+// pulling from the network (QUIC flow control then stalls the sender)
+const MAX_DATA_STREAM_BUFFER_SIZE: usize = 1024 * 1024; // 1MB
 // Maximum error message length
 const MAX_ERROR_LEN: usize = 512;
 
@@ -96,45 +105,33 @@ pub struct DataStreamChunk {
     pub is_complete: bool,  // true if stream was closed after this data
 }
 
-// Queue of received data stream chunks (each entry is stream_id + data)
-struct DataStreamQueue {
-    chunks: VecDeque<(u64, Vec<u8>, bool)>,  // (stream_id, data, is_complete)
-    max_chunks: usize,
-}
-
-impl DataStreamQueue {
-    fn new(max_chunks: usize) -> Self {
-        Self {
-            chunks: VecDeque::with_capacity(32),
-            max_chunks,
-        }
-    }
-
-    fn push(&mut self, stream_id: u64, data: Vec<u8>, is_complete: bool) -> bool {
-        if self.chunks.len() >= self.max_chunks {
-            return false;
-        }
-        self.chunks.push_back((stream_id, data, is_complete));
-        true
-    }
-
-    fn pop(&mut self) -> Option<(u64, Vec<u8>, bool)> {
-        self.chunks.pop_front()
-    }
-
-    fn is_empty(&self) -> bool {
-        self.chunks.is_empty()
-    }
+// Shared QUIC endpoint for WebTransport sessions
+//
+// Sessions with the same verification mode reuse one endpoint (UDP socket) and
+// crypto config instead of building a fresh one per session. This is endpoint
+// reuse only: web-transport-quinn runs one session per HTTP/3 connection, so
+// each session still has its own QUIC connection and handshake, but it skips
+// the socket setup and root certificate load and resumes TLS from the shared
+// session ticket cache. The endpoint is closed with its last session.
+struct PooledClient {
+    insecure: bool,
+    endpoint: Endpoint,
+    client: WebTransportClient,
+    // Sessions connected or connecting through this endpoint
+    sessions: AtomicUsize,
 }
 
 // Global registry for WebTransport sessions
 static WT_SESSIONS: OnceCell<DashMap<u64, Arc<Session>>> = OnceCell::new();
-static WT_ENDPOINTS: OnceCell<DashMap<u64, Arc<Endpoint>>> = OnceCell::new();
+static WT_ENDPOINTS: OnceCell<DashMap<u64, Arc<PooledClient>>> = OnceCell::new();
 static WT_RECV_BUFFERS: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<ReceiveBuffer>>>> = OnceCell::new();
-static WT_DATA_QUEUES: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<DataStreamQueue>>>> = OnceCell::new();
+static WT_DATA_QUEUES: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<StreamReassembly>>>> = OnceCell::new();
 static WT_CONTROL_STREAMS: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<Option<ControlStream>>>>> = OnceCell::new();
 // Global registry of datagram receive buffers (session_id -> buffer of complete datagrams)
 static WT_DATAGRAM_BUFFERS: OnceCell<DashMap<u64, Arc<tokio::sync::Mutex<VecDeque<Vec<u8>>>>>> = OnceCell::new();
+static WT_BANDWIDTH: OnceCell<BandwidthRegistry> = OnceCell::new();
+static WT_ROUTES: OnceCell<RouteTable> = OnceCell::new();
+static WT_CLIENT_POOL: OnceCell<DashMap<bool, Arc<PooledClient>>> = OnceCell::new();
 static WT_RUNTIME: OnceCell<Runtime> = OnceCell::new();
 static WT_NEXT_SESSION_ID: AtomicU64 = AtomicU64::new(1);
 static WT_NEXT_INCOMING_STREAM_ID: AtomicU64 = AtomicU64::new(1);
@@ -215,6 +212,15 @@ pub extern "C" fn moq_webtransport_init() {
     if WT_DATAGRAM_BUFFERS.set(DashMap::new()).is_err() {
         log::warn!("WebTransport datagram buffers registry already initialized");
     }
+    if WT_CLIENT_POOL.set(DashMap::new()).is_err() {
+        log::warn!("WebTransport client pool already initialized");
+    }
+    if WT_BANDWIDTH.set(BandwidthRegistry::new()).is_err() {
+        log::warn!("WebTransport bandwidth registry already initialized");
+    }
+    if WT_ROUTES.set(RouteTable::new()).is_err() {
+        log::warn!("WebTransport route table already initialized");
+    }
     if LAST_ERROR.set(Mutex::new(Vec::new())).is_err() {
         log::warn!("WebTransport last error buffer already initialized");
     }
@@ -243,6 +249,118 @@ pub extern "C" fn moq_webtransport_set_runtime(runtime_ptr: *const Runtime) {
     }
 }
 
+/// Build the shared endpoint and client for sessions with the given verification mode
+///
+/// Must be called within the WebTransport runtime (the endpoint driver is spawned on it).
+fn new_pooled_client(insecure: bool) -> Result<PooledClient, i32> {
+    // Create client configuration with cert verification.
+    // WebTransport itself negotiates via its ALPN, while MoQ draft
+    // selection is carried as a WebTransport subprotocol.
+    // The config is shared by all pooled sessions, so its TLS session ticket
+    // cache lets later connections to the same relay resume.
+    let mut crypto = if insecure {
+        rustls::ClientConfig::builder()
+            .dangerous()
+            .with_custom_certificate_verifier(Arc::new(NoVerification))
+            .with_no_client_auth()
+    } else {
+        // Load system root certificates for TLS validation
+        let mut certs = rustls::RootCertStore::empty();
+        let native_certs_result = rustls_native_certs::load_native_certs();
+        if let Some(ref e) = native_certs_result.errors.first() {
+            log::warn!("Error loading some native certs: {:?}", e);
+        }
+        for cert in native_certs_result.certs {
+            if let Err(e) = certs.add(cert) {
+                log::warn!("Failed to add native cert: {:?}", e);
+            }
+        }
+        log::info!("Loaded {} system root certificates for WebTransport", certs.len());
+        rustls::ClientConfig::builder()
+            .with_root_certificates(certs)
+            .with_no_client_auth()
+    };
+    crypto.alpn_protocols = vec![web_transport_quinn::ALPN.as_bytes().to_vec()];
+
+    let quic_crypto = match QuicClientConfig::try_from(crypto.clone()) {
+        Ok(c) => c,
+        Err(e) => {
+            let err_msg = format!("QuicClientConfig error: {}", e);
+            log::error!("{}", err_msg);
+            set_last_error(&err_msg);
+            return Err(-6);
+        }
+    };
+
+    // Build transport config with datagram support (RFC 9221)
+    let mut transport = TransportConfig::default();
+    transport.datagram_receive_buffer_size(Some(65536));
+    transport.datagram_send_buffer_size(65536);
+
+    let mut client_config = ClientConfig::new(Arc::new(quic_crypto));
+    client_config.transport_config(Arc::new(transport));
+
+    // Create endpoint
+    let socket = match std::net::UdpSocket::bind("0.0.0.0:0") {
+        Ok(s) => s,
+        Err(e) => {
+            let err_msg = format!("UDP bind error: {}", e);
+            log::error!("{}", err_msg);
+            set_last_error(&err_msg);
+            return Err(-5);
+        }
+    };
+
+    let mut endpoint = match Endpoint::new(
+        EndpointConfig::default(),
+        None,
+        socket,
+        crate::quic_runtime(),
+    ) {
+        Ok(e) => e,
+        Err(e) => {
+            let err_msg = format!("Endpoint creation error: {}", e);
+            log::error!("{}", err_msg);
+            set_last_error(&err_msg);
+            return Err(-6);
+        }
+    };
+
+    endpoint.set_default_client_config(client_config.clone());
+
+    let client = WebTransportClient::new(endpoint.clone(), client_config);
+    Ok(PooledClient { insecure, endpoint, client, sessions: AtomicUsize::new(0) })
+}
+
+/// Take a pooled endpoint for a new session, creating it if needed
+///
+/// Returns the client and whether its endpoint already existed.
+fn acquire_pooled_client(insecure: bool) -> Result<(Arc<PooledClient>, bool), i32> {
+    let pool = WT_CLIENT_POOL.get().expect("Client pool not initialized");
+    // Counted under the entry lock, so release_pooled_client cannot close an
+    // endpoint that is being handed out
+    let entry = pool
+        .entry(insecure)
+        .or_try_insert_with(|| new_pooled_client(insecure).map(Arc::new))?;
+    let reused = entry.sessions.fetch_add(1, Ordering::AcqRel) > 0;
+    Ok((entry.clone(), reused))
+}
+
+/// Release a session's hold on its pooled endpoint; the last one closes it
+fn release_pooled_client(pooled: &Arc<PooledClient>) {
+    if pooled.sessions.fetch_sub(1, Ordering::AcqRel) != 1 {
+        return;
+    }
+    let pool = WT_CLIENT_POOL.get().expect("Client pool not initialized");
+    let removed = pool.remove_if(&pooled.insecure, |_, p| {
+        Arc::ptr_eq(p, pooled) && p.sessions.load(Ordering::Acquire) == 0
+    });
+    if removed.is_some() {
+        pooled.endpoint.close(0u32.into(), b"");
+        log::info!("Closed pooled WebTransport endpoint (insecure: {})", pooled.insecure);
+    }
+}
+
 /// Connect to a WebTransport server
 ///
 /// # Arguments
@@ -314,93 +432,23 @@ pub extern "C" fn moq_webtransport_connect(
             }
         };
 
-        // Create client configuration with cert verification.
-        // WebTransport itself negotiates via its ALPN, while MoQ draft
-        // selection is carried as a WebTransport subprotocol.
-        let mut crypto = if insecure != 0 {
-            rustls::ClientConfig::builder()
-                .dangerous()
-                .with_custom_certificate_verifier(Arc::new(NoVerification))
-                .with_no_client_auth()
-        } else {
-            // Load system root certificates for TLS validation
-            let mut certs = rustls::RootCertStore::empty();
-            let native_certs_result = rustls_native_certs::load_native_certs();
-            if let Some(ref e) = native_certs_result.errors.first() {
-                log::warn!("Error loading some native certs: {:?}", e);
-            }
-            for cert in native_certs_result.certs {
-                if let Err(e) = certs.add(cert) {
-                    log::warn!("Failed to add native cert: {:?}", e);
-                }
-            }
-            log::info!("Loaded {} system root certificates for WebTransport", certs.len());
-            rustls::ClientConfig::builder()
-                .with_root_certificates(certs)
-                .with_no_client_auth()
-        };
-        crypto.alpn_protocols = vec![web_transport_quinn::ALPN.as_bytes().to_vec()];
-
-        let quic_crypto = match QuicClientConfig::try_from(crypto.clone()) {
-            Ok(c) => c,
-            Err(e) => {
-                let err_msg = format!("QuicClientConfig error: {}", e);
-                log::error!("{}", err_msg);
-                set_last_error(&err_msg);
-                return Err(-6);
-            }
-        };
-
-        // Build transport config with datagram support (RFC 9221)
-        let mut transport = TransportConfig::default();
-        transport.datagram_receive_buffer_size(Some(65536));
-        transport.datagram_send_buffer_size(65536);
-
-        let mut client_config = ClientConfig::new(Arc::new(quic_crypto));
-        client_config.transport_config(Arc::new(transport));
-
-        // Create endpoint
-        let socket = match std::net::UdpSocket::bind("0.0.0.0:0") {
-            Ok(s) => s,
-            Err(e) => {
-                let err_msg = format!("UDP bind error: {}", e);
-                log::error!("{}", err_msg);
-                set_last_error(&err_msg);
-                return Err(-5);
-            }
-        };
-
-        let mut endpoint = match Endpoint::new(
-            EndpointConfig::default(),
-            None,
-            socket,
-            Arc::new(TokioRuntime),
-        ) {
-            Ok(e) => e,
-            Err(e) => {
-                let err_msg = format!("Endpoint creation error: {}", e);
-                log::error!("{}", err_msg);
-                set_last_error(&err_msg);
-                return Err(-6);
-            }
-        };
-
-        endpoint.set_default_client_config(client_config.clone());
-
-        // Connect using WebTransport
-        let client = WebTransportClient::new(endpoint.clone(), client_config);
+        // Reuse the pooled endpoint and crypto config for this verification mode
+        let (pooled, reused) = acquire_pooled_client(insecure != 0)?;
 
         let request = ConnectRequest::new(parsed_url).with_protocol(protocol_str);
 
-        match client.connect(request).await {
+        let started = std::time::Instant::now();
+        match pooled.client.connect(request).await {
             Ok(session) => {
-                log::info!("WebTransport session established");
-                Ok((session, endpoint))
+                log::info!("WebTransport session established in {:?} (reused endpoint: {})",
+                    started.elapsed(), reused);
+                Ok((session, pooled))
             }
             Err(e) => {
                 let err_msg = format!("WebTransport connection failed: {} (URL: {})", e, url);
                 log::error!("{}", err_msg);
                 set_last_error(&err_msg);
+                release_pooled_client(&pooled);
                 Err(-7)
             }
         }
@@ -422,12 +470,11 @@ pub extern "C" fn moq_webtransport_connect(
     let control_streams = WT_CONTROL_STREAMS.get().expect("Control streams not initialized");
 
     let session_arc = Arc::new(session);
-    let endpoint_arc = Arc::new(endpoint);
     let recv_buffer = Arc::new(tokio::sync::Mutex::new(ReceiveBuffer::new(MAX_RECV_BUFFER_SIZE)));
-    let data_queue = Arc::new(tokio::sync::Mutex::new(DataStreamQueue::new(1024)));  // Queue up to 1024 chunks
+    let data_queue = Arc::new(tokio::sync::Mutex::new(StreamReassembly::new(MAX_DATA_STREAM_BUFFER_SIZE)));
 
     sessions.insert(session_id, session_arc.clone());
-    endpoints.insert(session_id, endpoint_arc);
+    endpoints.insert(session_id, endpoint);
     recv_buffers.insert(session_id, recv_buffer.clone());
     data_queues.insert(session_id, data_queue.clone());
     control_streams.insert(session_id, Arc::new(tokio::sync::Mutex::new(None)));
@@ -531,51 +578,68 @@ pub extern "C" fn moq_webtransport_connect(
                     let stream_id = WT_NEXT_INCOMING_STREAM_ID.fetch_add(1, Ordering::SeqCst);
                     log::debug!("Accepted incoming unidirectional stream {} on session {}", stream_id, session_id);
 
-                    // Collect all data from this stream, then push as a complete chunk
-                    let mut stream_data = Vec::new();
-                    let mut buffer = vec![0u8; 8192];  // Larger buffer for data streams
-                    let mut is_complete = false;
-
-                    loop {
-                        match recv_stream.read(&mut buffer).await {
-                            Ok(None) => {
-                                // Stream closed - mark as complete
-                                is_complete = true;
-                                log::debug!("Incoming stream {} closed on session {} ({} bytes total)",
-                                    stream_id, session_id, stream_data.len());
-                                break;
+                    // Read each stream on its own task so a stalled stream does not
+                    // hold up accepting or draining the others
+                    let data_queue = data_queue_for_task.clone();
+                    tokio::spawn(async move {
+                        let mut buffer = vec![0u8; 64 * 1024]; // 64KB
+                        let mut total = 0usize;
+                        let mut alias_sniffer = TrackAliasSniffer::new();
+                        let bandwidth = WT_BANDWIDTH.get().expect("Bandwidth registry not initialized");
+                        let mut router = WT_ROUTES.get().expect("Route table not initialized").stream_router(session_id);
+                        // Opened in the queue once the stream turns out not to be played natively
+                        let mut opened = false;
+                        loop {
+                            // Backpressure: stop reading while the consumer is behind
+                            if opened && !stream_reassembly::wait_for_space(&data_queue, stream_id).await {
+                                log::debug!("Incoming stream {} dropped, session {} closed", stream_id, session_id);
+                                return;
                             }
-                            Ok(Some(n)) => {
-                                // Accumulate data from this stream
-                                stream_data.extend_from_slice(&buffer[..n]);
-                                log::trace!("Received {} bytes on stream {} session {} (total: {})",
-                                    n, stream_id, session_id, stream_data.len());
-
-                                // Push intermediate chunks if we have enough data
-                                // This allows processing to start while stream is still open
-                                if stream_data.len() >= 4096 {
-                                    let mut queue = data_queue_for_task.lock().await;
-                                    let chunk = std::mem::take(&mut stream_data);
-                                    if !queue.push(stream_id, chunk, false) {
-                                        log::warn!("Data queue full for session {}, dropping chunk", session_id);
+                            match recv_stream.read(&mut buffer).await {
+                                Ok(None) => {
+                                    log::debug!("Incoming stream {} closed on session {} ({} bytes total)",
+                                        stream_id, session_id, total);
+                                    break;
+                                }
+                                Ok(Some(n)) => {
+                                    total += n;
+                                    if let Some((track_alias, bytes)) = alias_sniffer.feed(&buffer[..n]) {
+                                        bandwidth.record(session_id, track_alias, Instant::now(), bytes);
+                                    }
+                                    let data = match router.feed(&buffer[..n]) {
+                                        Delivery::Consumed => continue,
+                                        Delivery::Dart(data) => data.to_vec(),
+                                        Delivery::DartHeld(data) => data,
+                                    };
+                                    let mut queue = data_queue.lock().await;
+                                    if !opened {
+                                        queue.open_stream(stream_id);
+                                        opened = true;
                                     }
+                                    queue.push(stream_id, data);
+                                    drop(queue);
+                                    log::trace!("Received {} bytes on stream {} session {} (total: {})",
+                                        n, stream_id, session_id, total);
+                                }
+                                Err(e) => {
+                                    log::error!("Error reading from stream {}: {:?}", stream_id, e);
+                                    break;  // Consider stream done on error
                                 }
-                            }
-                            Err(e) => {
-                                log::error!("Error reading from stream {}: {:?}", stream_id, e);
-                                is_complete = true;  // Consider stream done on error
-                                break;
                             }
                         }
-                    }
-
-                    // Push final chunk with remaining data
-                    if !stream_data.is_empty() || is_complete {
-                        let mut queue = data_queue_for_task.lock().await;
-                        if !queue.push(stream_id, stream_data, is_complete) {
-                            log::warn!("Data queue full for session {}, dropping final chunk", session_id);
+                        // A stream too short to route still belongs to Dart
+                        let held = router.finish();
+                        let mut queue = data_queue.lock().await;
+                        if let Some(held) = held {
+                            if !opened {
+                                queue.open_stream(stream_id);
+                            }
+                            queue.push(stream_id, held);
+                            queue.finish(stream_id);
+                        } else if opened {
+                            queue.finish(stream_id);
                         }
-                    }
+                    });
                 }
                 Err(e) => {
                     log::error!("Error accepting incoming stream: {:?}", e);
@@ -724,10 +788,62 @@ pub extern "C" fn moq_webtransport_recv(
     result
 }
 
+/// Peek at the next pending data stream read (non-blocking poll)
+///
+/// Reports how many bytes are buffered for the stream that the next call to
+/// `moq_webtransport_recv_data` will read from, without consuming anything.
+/// Use it to size the receive buffer so a whole chunk can be read in one call.
+///
+/// # Arguments
+/// * `session_id` - The session ID
+/// * `out_stream_id` - Output parameter for the stream ID of the pending data
+/// * `out_is_complete` - Output parameter: 1 if the stream is finished once these bytes are read
+///
+/// # Returns
+/// * Number of bytes buffered for that stream (may be 0 with `out_is_complete` = 1 for a
+///   bare FIN), 0 if nothing is pending, negative error code on failure
+#[no_mangle]
+pub extern "C" fn moq_webtransport_peek_data(
+    session_id: u64,
+    out_stream_id: *mut u64,
+    out_is_complete: *mut i32,
+) -> i64 {
+    let data_queues = WT_DATA_QUEUES.get().expect("Data queues not initialized");
+
+    let data_queue = match data_queues.get(&session_id) {
+        Some(dq) => dq.clone(),
+        None => {
+            log::error!("Session {} not found for peek_data", session_id);
+            return -1;
+        }
+    };
+
+    let runtime = get_runtime();
+
+    let pending = runtime.block_on(async {
+        data_queue.lock().await.peek()
+    });
+
+    let (stream_id, len, is_complete) = match pending {
+        Some(p) => (p.stream_id, p.len, p.is_complete),
+        None => (0, 0, false),
+    };
+    if !out_stream_id.is_null() {
+        unsafe { *out_stream_id = stream_id; }
+    }
+    if !out_is_complete.is_null() {
+        unsafe { *out_is_complete = if is_complete { 1 } else { 0 }; }
+    }
+    len as i64
+}
+
 /// Receive data from incoming unidirectional data streams (non-blocking poll)
 ///
 /// This returns data from incoming unidirectional streams, separate from the
-/// bidirectional control stream. Each chunk includes the stream ID and completion status.
+/// bidirectional control stream. Each call reads from one stream; streams with
+/// pending data are served round-robin. If the buffer is smaller than the pending
+/// data, the remainder stays queued for the next call. The completion flag is set
+/// on the read that drains a finished stream, which may carry zero bytes.
 ///
 /// # Arguments
 /// * `session_id` - The session ID
@@ -737,7 +853,8 @@ pub extern "C" fn moq_webtransport_recv(
 /// * `out_is_complete` - Output parameter: 1 if stream is complete, 0 otherwise
 ///
 /// # Returns
-/// * Number of bytes received on success, 0 if no data available, negative error code on failure
+/// * Number of bytes received on success, 0 if no data available (check `out_is_complete`
+///   for a bare FIN), negative error code on failure
 #[no_mangle]
 pub extern "C" fn moq_webtransport_recv_data(
     session_id: u64,
@@ -756,6 +873,10 @@ pub extern "C" fn moq_webtransport_recv_data(
         }
     };
 
+    if !out_is_complete.is_null() {
+        unsafe { *out_is_complete = 0; }
+    }
+
     if buffer.is_null() || buffer_len == 0 {
         return 0;
     }
@@ -764,37 +885,21 @@ pub extern "C" fn moq_webtransport_recv_data(
 
     let result = runtime.block_on(async {
         let mut queue = data_queue.lock().await;
+        let output_buf = unsafe { slice::from_raw_parts_mut(buffer, buffer_len) };
 
-        match queue.pop() {
-            Some((stream_id, data, is_complete)) => {
-                // Set output stream ID
+        match queue.read(output_buf) {
+            Some(read) => {
                 if !out_stream_id.is_null() {
-                    unsafe { *out_stream_id = stream_id; }
+                    unsafe { *out_stream_id = read.stream_id; }
                 }
-
-                // Set completion flag
                 if !out_is_complete.is_null() {
-                    unsafe { *out_is_complete = if is_complete { 1 } else { 0 }; }
-                }
-
-                // Copy data to output buffer
-                let to_copy = data.len().min(buffer_len);
-                if to_copy > 0 {
-                    unsafe {
-                        let dst = slice::from_raw_parts_mut(buffer, to_copy);
-                        dst.copy_from_slice(&data[..to_copy]);
-                    }
-                }
-
-                if to_copy < data.len() {
-                    log::warn!("Data truncated: {} bytes available but only {} buffer space",
-                        data.len(), buffer_len);
+                    unsafe { *out_is_complete = if read.is_complete { 1 } else { 0 }; }
                 }
 
                 log::trace!("recv_data: stream {} returned {} bytes (complete: {})",
-                    stream_id, to_copy, is_complete);
+                    read.stream_id, read.len, read.is_complete);
 
-                to_copy as i64
+                read.len as i64
             }
             None => 0,
         }
@@ -1050,6 +1155,176 @@ pub extern "C" fn moq_webtransport_recv_datagram(
     result
 }
 
+/// Get the bandwidth estimate for a subscribed track
+///
+/// # Arguments
+/// * `session_id` - The session ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `out_goodput_bps` - Output: bits per second delivered over the last 2 seconds
+/// * `out_capacity_bps` - Output: smoothed bits per second measured during sender bursts
+///   (0 until a large enough burst has been seen)
+///
+/// # Returns
+/// * 0 on success, -1 if nothing has been received for the track
+#[no_mangle]
+pub extern "C" fn moq_webtransport_bandwidth_estimate(
+    session_id: u64,
+    track_alias: u64,
+    out_goodput_bps: *mut u64,
+    out_capacity_bps: *mut u64,
+) -> i32 {
+    let bandwidth = WT_BANDWIDTH.get().expect("Bandwidth registry not initialized");
+    let estimate = match bandwidth.estimate(session_id, track_alias) {
+        Some(e) => e,
+        None => return -1,
+    };
+    unsafe {
+        if !out_goodput_bps.is_null() {
+            *out_goodput_bps = estimate.goodput_bps;
+        }
+        if !out_capacity_bps.is_null() {
+            *out_capacity_bps = estimate.capacity_bps;
+        }
+    }
+    0
+}
+
+/// Play a subscribed track through a native playback sink
+///
+/// Subgroup streams of the track that start after this call are deframed and
+/// written to the sink on the reader task instead of the session's data queue.
+///
+/// # Arguments
+/// * `session_id` - The session ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `sink_id` - Sink from `media_player_create_sink`
+/// * `track` - 0 for video, 1 for audio
+/// * `version` - Negotiated MoQ version
+/// * `replay_bytes` - Bound of the track's replay cache (0 = none); a sink
+///   routed to the track later starts at the newest cached group
+///
+/// # Returns
+/// * 0 on success, -1 if the sink does not exist or the track is invalid
+#[no_mangle]
+pub extern "C" fn moq_webtransport_route_track(
+    session_id: u64,
+    track_alias: u64,
+    sink_id: u64,
+    track: i32,
+    version: u64,
+    replay_bytes: u64,
+) -> i32 {
+    let (sink, track) = match (playback_sink::get_sink(sink_id), playback_sink::TrackKind::from_raw(track)) {
+        (Some(sink), Some(track)) => (sink, track),
+        _ => return -1,
+    };
+    WT_ROUTES
+        .get()
+        .expect("Route table not initialized")
+        .route(session_id, track_alias, sink, track, version, replay_bytes as usize);
+    0
+}
+
+/// Feed a subscribed track into a redundant track, as one of its paths
+///
+/// Like `moq_webtransport_route_track`, but the track's objects are merged with the
+/// other paths of `redundant_id` (from `redundant_track_create`): only the
+/// first copy of each object reaches its sinks.
+///
+/// # Arguments
+/// * `session_id` - The session ID
+/// * `track_alias` - Track alias from SUBSCRIBE_OK
+/// * `redundant_id` - The redundant track
+///
+/// # Returns
+/// * Path index (for `redundant_track_get_path_stats`), or -1 if the
+///   redundant track does not exist or has no free path
+#[no_mangle]
+pub extern "C" fn moq_webtransport_route_redundant_path(session_id: u64, track_alias: u64, redundant_id: u64) -> i32 {
+    let Some(route) = redundant::get_redundant_track(redundant_id) else { return -1 };
+    match WT_ROUTES.get().expect("Route table not initialized").route_path(session_id, track_alias, route) {
+        Some(path) => path as i32,
+        None => -1,
+    }
+}
+
+/// Stop playing a track natively; new streams go to the data queue again
+///
+/// # Returns
+/// * 0 on success, -1 if the track was not routed
+#[no_mangle]
+pub extern "C" fn moq_webtransport_unroute_track(session_id: u64, track_alias: u64) -> i32 {
+    if WT_ROUTES.get().expect("Route table not initialized").unroute(session_id, track_alias) {
+        0
+    } else {
+        -1
+    }
+}
+
+// Sends a publish pipeline's subgroup streams on a session
+struct WebTransportPublishOutput {
+    session_id: u64,
+}
+
+impl publish_pipeline::PublishOutput for WebTransportPublishOutput {
+    fn open_stream(&mut self) -> Result<u64, i32> {
+        let mut stream_id = 0;
+        match moq_webtransport_open_uni_stream(self.session_id, &mut stream_id) {
+            0 => Ok(stream_id),
+            code => Err(code),
+        }
+    }
+
+    fn write(&mut self, stream_id: u64, data: Vec<u8>) -> Result<(), i32> {
+        let data_streams = WT_DATA_STREAMS.get().expect("Data streams not initialized");
+        let stream_mutex = match data_streams.get(&(self.session_id, stream_id)) {
+            Some(s) => s.clone(),
+            None => return Err(-1),
+        };
+        get_runtime().block_on(async {
+            let mut stream = stream_mutex.lock().await;
+            stream.write_all(&data).await.map_err(|e| {
+                log::error!("Failed to write to stream {}: {:?}", stream_id, e);
+                -2
+            })
+        })
+    }
+
+    fn finish(&mut self, stream_id: u64) {
+        moq_webtransport_stream_finish(self.session_id, stream_id);
+    }
+}
+
+/// Create a native publish pipeline for a video track
+///
+/// Start it with `publish_pipeline_start`; from then on capture, encoding,
+/// moq-mi packaging and the subgroup streams are handled natively.
+///
+/// # Arguments
+/// * `session_id` - The session ID
+/// * `track_alias` - Track alias of the published track
+/// * `priority` - Publisher priority of its subgroups
+/// * `version` - Negotiated MoQ version
+///
+/// # Returns
+/// * Pipeline ID, or 0 if the session does not exist
+#[no_mangle]
+pub extern "C" fn moq_webtransport_publish_pipeline_create(
+    session_id: u64,
+    track_alias: u64,
+    priority: u8,
+    version: u64,
+) -> u64 {
+    let sessions = WT_SESSIONS.get().expect("Sessions not initialized");
+    if !sessions.contains_key(&session_id) {
+        log::error!("Session {} not found for publish pipeline", session_id);
+        return 0;
+    }
+    let track = publish_pipeline::TrackConfig { track_alias, priority, version };
+    let output = Box::new(WebTransportPublishOutput { session_id });
+    publish_pipeline::register_pipeline(publish_pipeline::PublishPipeline::new(track, output))
+}
+
 /// Close a WebTransport session
 #[no_mangle]
 pub extern "C" fn moq_webtransport_close(session_id: u64) -> i32 {
@@ -1068,18 +1343,25 @@ pub extern "C" fn moq_webtransport_close(session_id: u64) -> i32 {
         }
     };
 
-    let (_, _) = match endpoints.remove(&session_id) {
+    let (_, pooled) = match endpoints.remove(&session_id) {
         Some(e) => e,
         None => {
             log::warn!("Endpoint {} not found for close", session_id);
             return -1;
         }
     };
+    release_pooled_client(&pooled);
 
     recv_buffers.remove(&session_id);
-    data_queues.remove(&session_id);
     control_streams.remove(&session_id);
 
+    // Wake any stream readers blocked on backpressure so their tasks exit
+    if let Some((_, data_queue)) = data_queues.remove(&session_id) {
+        get_runtime().block_on(async {
+            data_queue.lock().await.close();
+        });
+    }
+
     // Clean up datagram buffer
     let datagram_buffers = WT_DATAGRAM_BUFFERS.get().expect("Datagram buffers not initialized");
     datagram_buffers.remove(&session_id);
@@ -1087,6 +1369,9 @@ pub extern "C" fn moq_webtransport_close(session_id: u64) -> i32 {
     // Clean up any data streams for this session
     data_streams.retain(|(sid, _), _| *sid != session_id);
 
+    WT_BANDWIDTH.get().expect("Bandwidth registry not initialized").remove_session(session_id);
+    WT_ROUTES.get().expect("Route table not initialized").remove_session(session_id);
+
     log::info!("WebTransport session {} closed", session_id);
     0
 }
@@ -1102,6 +1387,13 @@ pub extern "C" fn moq_webtransport_cleanup() {
     let data_streams = WT_DATA_STREAMS.get().expect("Data streams not initialized");
 
     sessions.clear();
+    if let Some(runtime) = WT_RUNTIME.get() {
+        runtime.block_on(async {
+            for entry in data_queues.iter() {
+                entry.value().lock().await.close();
+            }
+        });
+    }
     data_queues.clear();
     endpoints.clear();
     recv_buffers.clear();
@@ -1111,6 +1403,16 @@ pub extern "C" fn moq_webtransport_cleanup() {
     let datagram_buffers = WT_DATAGRAM_BUFFERS.get().expect("Datagram buffers not initialized");
     datagram_buffers.clear();
 
+    // Close the pooled endpoints and their UDP sockets
+    let client_pool = WT_CLIENT_POOL.get().expect("Client pool not initialized");
+    for pooled in client_pool.iter() {
+        pooled.endpoint.close(0u32.into(), b"");
+    }
+    client_pool.clear();
+
+    WT_BANDWIDTH.get().expect("Bandwidth registry not initialized").clear();
+    WT_ROUTES.get().expect("Route table not initialized").clear();
+
     log::info!("MoQ WebTransport cleanup complete");
 }
 
@@ -1172,3 +1474,92 @@ pub extern "C" fn moq_webtransport_max_datagram_size(
 
     session.max_datagram_size() as i64
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::ffi::CString;
+    use std::time::Instant;
+
+    // Resident set size in bytes (Linux only, 0 elsewhere)
+    fn rss_bytes() -> usize {
+        std::fs::read_to_string("/proc/self/statm")
+            .ok()
+            .and_then(|s| s.split_whitespace().nth(1).and_then(|v| v.parse::<usize>().ok()))
+            .map(|pages| pages * 4096)
+            .unwrap_or(0)
+    }
+
+    #[test]
+    fn pooled_endpoint_closes_with_last_session() {
+        let _ = WT_CLIENT_POOL.set(DashMap::new());
+        let runtime = Runtime::new().unwrap();
+        let _guard = runtime.enter();
+
+        let (first, reused) = acquire_pooled_client(true).unwrap();
+        assert!(!reused);
+        let (second, reused) = acquire_pooled_client(true).unwrap();
+        assert!(reused);
+        assert!(Arc::ptr_eq(&first, &second));
+
+        release_pooled_client(&first);
+        assert!(WT_CLIENT_POOL.get().unwrap().contains_key(&true));
+        release_pooled_client(&second);
+        assert!(!WT_CLIENT_POOL.get().unwrap().contains_key(&true));
+
+        // The next session gets a fresh endpoint
+        let (third, reused) = acquire_pooled_client(true).unwrap();
+        assert!(!reused);
+        assert!(!Arc::ptr_eq(&first, &third));
+        release_pooled_client(&third);
+    }
+
+    // Connect time and memory per additional session against a live relay:
+    //   MOQ_WT_BENCH_HOST=relay.example.com MOQ_WT_BENCH_PORT=4443 \
+    //     cargo test --release wt_session_pool -- --ignored --nocapture
+    #[test]
+    #[ignore]
+    fn wt_session_pool_connect_benchmark() {
+        const SESSIONS: usize = 8;
+        let host = std::env::var("MOQ_WT_BENCH_HOST").unwrap_or_else(|_| "localhost".into());
+        let port: u16 = std::env::var("MOQ_WT_BENCH_PORT").ok().and_then(|p| p.parse().ok()).unwrap_or(4443);
+        let insecure = std::env::var("MOQ_WT_BENCH_INSECURE").map(|v| v == "1").unwrap_or(true);
+
+        crate::moq_quic_init();
+        moq_webtransport_init();
+
+        let host_c = CString::new(host.clone()).unwrap();
+        let path_c = CString::new("/moq").unwrap();
+        let protocol_c = CString::new("moq-00").unwrap();
+
+        let mut session_ids = Vec::new();
+        let mut last_rss = rss_bytes();
+        for i in 0..SESSIONS {
+            let mut session_id = 0u64;
+            let started = Instant::now();
+            let rc = moq_webtransport_connect(
+                host_c.as_ptr(),
+                port,
+                path_c.as_ptr(),
+                protocol_c.as_ptr(),
+                insecure as u8,
+                &mut session_id,
+            );
+            assert_eq!(rc, 0, "connect to {}:{} failed", host, port);
+            let elapsed = started.elapsed();
+            let rss = rss_bytes();
+            println!(
+                "session {}: connect {:?}, +{} KB RSS",
+                i + 1,
+                elapsed,
+                rss.saturating_sub(last_rss) / 1024
+            );
+            last_rss = rss;
+            session_ids.push(session_id);
+        }
+
+        for id in session_ids {
+            moq_webtransport_close(id);
+        }
+    }
+}
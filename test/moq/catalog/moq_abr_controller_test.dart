@@ -0,0 +1,244 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/catalog/moq_abr_controller.dart';
+import 'package:moq_flutter/moq/catalog/moq_catalog.dart';
+import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/protocol/moq_messages.dart';
+import 'package:moq_flutter/moq/transport/moq_transport.dart';
+
+import '../client/mock_transport.dart';
+
+void main() {
+  late MockMoQTransport transport;
+  late MoQClient client;
+  late List<String> subscribedTracks;
+  late List<Int64> unsubscribedIds;
+  final aliasByTrack = <String, Int64>{
+    'video-low': Int64(2),
+    'video-mid': Int64(3),
+    'video-high': Int64(4),
+  };
+  final namespace = [Uint8List.fromList('live'.codeUnits)];
+
+  CatalogTrack rendition(String name, int bitrate, {int altGroup = 1}) =>
+      CatalogTrack(
+        name: name,
+        namespace: 'live',
+        packaging: 'loc',
+        role: 'video',
+        altGroup: altGroup,
+        selectionParams: SelectionParams(bitrate: bitrate),
+      );
+
+  final renditions = [
+    rendition('video-high', 6000000),
+    rendition('video-low', 800000),
+    rendition('video-mid', 2500000),
+  ];
+
+  // Fast timings so decisions happen within a test
+  const fastOptions = AbrOptions(
+    pollInterval: Duration(milliseconds: 10),
+    warmup: Duration.zero,
+    downSwitchHold: Duration.zero,
+    upSwitchHold: Duration.zero,
+    cutoverTimeout: Duration(milliseconds: 100),
+  );
+
+  setUp(() {
+    transport = MockMoQTransport();
+    client = MoQClient(transport: transport);
+    subscribedTracks = [];
+    unsubscribedIds = [];
+    transport.onControlMessageSent = (data) {
+      if (data.isNotEmpty && data[0] == 0x20) {
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            ServerSetupMessage(selectedVersion: MoQVersion.draft14).serialize(),
+          );
+        });
+      } else if (data.isNotEmpty && data[0] == 0x03) {
+        final payloadLength = (data[1] << 8) | data[2];
+        final payload = data.sublist(3, 3 + payloadLength);
+        final subscribe = SubscribeMessage.deserialize(payload);
+        final trackName = String.fromCharCodes(subscribe.trackName);
+        subscribedTracks.add(trackName);
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            SubscribeOkMessage(
+              requestId: subscribe.requestId,
+              trackAlias: aliasByTrack[trackName] ?? Int64(99),
+              expires: Int64.ZERO,
+              groupOrder: GroupOrder.ascending,
+              contentExists: 1,
+              largestLocation: Location.zero(),
+            ).serialize(),
+          );
+        });
+      } else if (data.isNotEmpty && data[0] == 0x0A) {
+        final payloadLength = (data[1] << 8) | data[2];
+        final payload = data.sublist(3, 3 + payloadLength);
+        unsubscribedIds.add(UnsubscribeMessage.deserialize(payload).requestId);
+      }
+    };
+  });
+
+  tearDown(() async {
+    client.dispose();
+    transport.dispose();
+  });
+
+  group('MoQAbrController', () {
+    test('selects video renditions of one alt group by bitrate', () {
+      final catalog = MoQCatalog.loc(
+        namespace: 'live',
+        tracks: [
+          ...renditions,
+          rendition('video-other', 1000000, altGroup: 2),
+          CatalogTrack(name: 'audio', packaging: 'loc', role: 'audio'),
+        ],
+      );
+
+      expect(
+        MoQAbrController.videoRenditions(
+          catalog,
+          altGroup: 1,
+        ).map((track) => track.name),
+        equals(['video-low', 'video-mid', 'video-high']),
+      );
+      expect(
+        MoQAbrController.videoRenditions(
+          catalog,
+          altGroup: 2,
+        ).map((track) => track.name),
+        equals(['video-other']),
+      );
+    });
+
+    test(
+      'switches down on low goodput and cuts over at the new group',
+      () async {
+        await client.connect('localhost', 4443);
+        final controller = MoQAbrController(
+          client: client,
+          trackNamespace: namespace,
+          renditions: renditions,
+          options: fastOptions,
+        );
+        final received = <String>[];
+        controller.objectStream.listen((object) {
+          received.add(
+            '${String.fromCharCodes(object.trackName)}@${object.groupId}',
+          );
+        });
+        final decision = controller.decisions.first;
+
+        await controller.start(initialTrackName: 'video-high');
+        final highId = client.subscriptions.keys.single;
+
+        // The link only delivers 1.5 Mbps of a 6 Mbps rendition
+        transport.bandwidthEstimates[4] = const BandwidthEstimate(
+          goodputBps: 1500000,
+          capacityBps: 1600000,
+        );
+        await _waitFor(() => subscribedTracks.length == 2);
+        // 1.5 Mbps * 0.8 headroom only fits the lowest rendition
+        expect(subscribedTracks.last, equals('video-low'));
+        expect(controller.metrics.pending?.name, equals('video-low'));
+
+        // New rendition starts at group 5 while the old one finishes group 4
+        await _pushObject(client, transport, 21, aliasByTrack['video-low']!, 5);
+        await _pushObject(client, transport, 22, aliasByTrack['video-high']!, 4);
+        expect(controller.currentRendition.name, equals('video-high'));
+
+        // Old rendition reaching group 5 triggers the cutover
+        await _pushObject(client, transport, 23, aliasByTrack['video-high']!, 5);
+        final switched = await decision;
+
+        expect(switched.from.name, equals('video-high'));
+        expect(switched.to.name, equals('video-low'));
+        expect(switched.reason, equals(AbrSwitchReason.congestion));
+        expect(switched.switchGroup, equals(Int64(5)));
+        expect(received, equals(['video-high@4', 'video-low@5']));
+        await _waitFor(() => unsubscribedIds.contains(highId));
+        expect(controller.metrics.downSwitches, equals(1));
+
+        await controller.close();
+      },
+    );
+
+    test('switches up one step when capacity leaves headroom', () async {
+      await client.connect('localhost', 4443);
+      final controller = MoQAbrController(
+        client: client,
+        trackNamespace: namespace,
+        renditions: renditions,
+        options: fastOptions,
+      );
+      final decision = controller.decisions.first;
+
+      await controller.start();
+      expect(controller.currentRendition.name, equals('video-low'));
+
+      // App-limited goodput, but bursts show 20 Mbps of capacity
+      transport.bandwidthEstimates[2] = const BandwidthEstimate(
+        goodputBps: 800000,
+        capacityBps: 20000000,
+      );
+      await _waitFor(() => subscribedTracks.length == 2);
+      expect(subscribedTracks.last, equals('video-mid'));
+
+      // The old rendition never reaches the new group: the timeout cuts over
+      await _pushObject(client, transport, 31, aliasByTrack['video-mid']!, 9);
+      final switched = await decision;
+
+      expect(switched.to.name, equals('video-mid'));
+      expect(switched.reason, equals(AbrSwitchReason.headroom));
+      expect(controller.metrics.upSwitches, equals(1));
+
+      await controller.close();
+    });
+  });
+}
+
+Future<void> _waitFor(bool Function() condition) async {
+  final deadline = DateTime.now().add(const Duration(seconds: 2));
+  while (!condition()) {
+    if (DateTime.now().isAfter(deadline)) {
+      throw TimeoutException('Condition not met');
+    }
+    await Future<void>.delayed(const Duration(milliseconds: 5));
+  }
+}
+
+Future<void> _pushObject(
+  MoQClient client,
+  MockMoQTransport transport,
+  int streamId,
+  Int64 trackAlias,
+  int groupId,
+) async {
+  final encodedStreamId = await client.openDataStream();
+  await client.writeSubgroupHeader(
+    encodedStreamId,
+    trackAlias: trackAlias,
+    groupId: Int64(groupId),
+    subgroupId: Int64.ZERO,
+    publisherPriority: 128,
+  );
+  await client.writeObject(
+    encodedStreamId,
+    objectId: Int64.ZERO,
+    payload: Uint8List.fromList([1, 2, 3]),
+  );
+
+  final writes = transport.sentStreamData[encodedStreamId]!;
+  transport.sentStreamData.remove(encodedStreamId);
+
+  transport.simulateIncomingDataStream(streamId, writes[0]);
+  transport.simulateIncomingDataStream(streamId, writes[1], isComplete: true);
+  await Future<void>.delayed(const Duration(milliseconds: 5));
+}
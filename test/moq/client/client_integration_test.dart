@@ -463,6 +463,121 @@ void main() {
     });
   });
 
+  group('Session Recovery', () {
+    late MoQClient recoveringClient;
+    late List<SubscribeMessage> sentSubscribes;
+
+    setUp(() async {
+      recoveringClient = MoQClient(
+        transport: transport,
+        recovery: const SessionRecoveryOptions(
+          initialBackoff: Duration(milliseconds: 10),
+        ),
+      );
+      sentSubscribes = [];
+      transport.onControlMessageSent = (data) {
+        if (data.isNotEmpty && data[0] == 0x20) {
+          Future.microtask(() {
+            transport.simulateIncomingControlData(
+              ServerSetupMessage(selectedVersion: 0xff00000e).serialize(),
+            );
+          });
+        } else if (data.isNotEmpty && data[0] == 0x03) {
+          final payloadLength = (data[1] << 8) | data[2];
+          final subscribe = SubscribeMessage.deserialize(
+            data.sublist(3, 3 + payloadLength),
+          );
+          sentSubscribes.add(subscribe);
+          Future.microtask(() {
+            transport.simulateIncomingControlData(
+              SubscribeOkMessage(
+                requestId: subscribe.requestId,
+                trackAlias: Int64(sentSubscribes.length),
+                expires: Int64(0),
+                groupOrder: GroupOrder.ascending,
+                contentExists: 1,
+              ).serialize(),
+            );
+          });
+        }
+      };
+      await recoveringClient.connect('localhost', 4443);
+    });
+
+    tearDown(() {
+      recoveringClient.dispose();
+    });
+
+    test('connect passes loss detection thresholds to transport', () {
+      expect(transport.lastConnectOptions?['keep_alive_ms'], equals('500'));
+      expect(transport.lastConnectOptions?['loss_pto_count'], equals('3'));
+    });
+
+    test('replays SUBSCRIBE and keeps the object stream open', () async {
+      final namespace = [Uint8List.fromList('test'.codeUnits)];
+      final trackName = Uint8List.fromList('track1'.codeUnits);
+
+      await recoveringClient.subscribe(namespace, trackName);
+      final subscription = recoveringClient.subscriptions.values.single;
+      final objects = <MoQObject>[];
+      subscription.objectStream.listen(objects.add);
+
+      final events = <SessionRecoveryEvent>[];
+      recoveringClient.recoveryEvents.listen(events.add);
+      final resumed = recoveringClient.recoveryEvents.firstWhere(
+        (e) => e.phase == SessionRecoveryPhase.trackResumed,
+      );
+
+      transport.simulateConnectionLoss();
+      await recoveringClient.recoveryEvents.firstWhere(
+        (e) => e.phase == SessionRecoveryPhase.reconnected,
+      );
+      await Future<void>.delayed(Duration.zero);
+
+      // Request IDs restart on the new session and the track is re-subscribed
+      // from the next group boundary
+      expect(recoveringClient.isConnected, isTrue);
+      expect(sentSubscribes.length, equals(2));
+      expect(sentSubscribes.last.requestId, equals(Int64(0)));
+      expect(sentSubscribes.last.filterType, equals(FilterType.nextGroupStart));
+      expect(subscription.isActive, isTrue);
+      expect(subscription.assignedTrackAlias, equals(Int64(2)));
+
+      transport.simulateIncomingDatagram(
+        ObjectDatagram(
+          trackAlias: Int64(2),
+          groupId: Int64(42),
+          objectId: Int64(0),
+          publisherPriority: 128,
+          payload: Uint8List.fromList([1, 2, 3]),
+        ).serialize(),
+      );
+
+      final event = await resumed;
+      expect(event.outage, isNotNull);
+      expect(objects.single.groupId, equals(Int64(42)));
+      expect(
+        events.map((e) => e.phase),
+        equals([
+          SessionRecoveryPhase.connectionLost,
+          SessionRecoveryPhase.reconnected,
+          SessionRecoveryPhase.trackResumed,
+        ]),
+      );
+    });
+
+    test('disconnect does not trigger recovery', () async {
+      final events = <SessionRecoveryEvent>[];
+      recoveringClient.recoveryEvents.listen(events.add);
+
+      await recoveringClient.disconnect();
+      await Future<void>.delayed(const Duration(milliseconds: 20));
+
+      expect(recoveringClient.isConnected, isFalse);
+      expect(events, isEmpty);
+    });
+  });
+
   group('GOAWAY Handling', () {
     setUp(() async {
       transport.onControlMessageSent = (data) {
@@ -23,6 +23,15 @@ class MockMoQTransport implements MoQTransport {
   int _bytesSent = 0;
   int _bytesReceived = 0;
 
+  // Bandwidth estimates per track alias, set by tests
+  final Map<int, BandwidthEstimate> bandwidthEstimates = {};
+
+  // Track alias -> sink ID of tracks routed to native playback
+  final Map<int, int> nativeRoutes = {};
+
+  // Redundant track ID -> track aliases routed into it, in path order
+  final Map<int, List<int>> redundantPaths = {};
+
   // Callbacks for custom response handling
   void Function(Uint8List data)? onControlMessageSent;
   Map<String, String>? lastConnectOptions;
@@ -52,6 +61,40 @@ class MockMoQTransport implements MoQTransport {
     lastActivity: DateTime.now(),
   );
 
+  @override
+  BandwidthEstimate? bandwidthEstimate(int trackAlias) =>
+      bandwidthEstimates[trackAlias];
+
+  @override
+  bool routeTrackToNative(
+    int trackAlias,
+    int sinkId, {
+    required int track,
+    required int version,
+    int replayCacheBytes = 0,
+  }) {
+    nativeRoutes[trackAlias] = sinkId;
+    return true;
+  }
+
+  @override
+  int? routeTrackToRedundant(int trackAlias, int redundantId) {
+    final paths = redundantPaths.putIfAbsent(redundantId, () => []);
+    paths.add(trackAlias);
+    return paths.length - 1;
+  }
+
+  @override
+  void unrouteTrack(int trackAlias) => nativeRoutes.remove(trackAlias);
+
+  @override
+  int? createPublishPipeline(
+    int trackAlias, {
+    required int priority,
+    required int version,
+  }) =>
+      null;
+
   @override
   Future<void> connect(
     String host,
@@ -149,6 +192,12 @@ class MockMoQTransport implements MoQTransport {
     _incomingDatagramsController.add(data);
   }
 
+  /// Simulate the connection dropping without a local disconnect
+  void simulateConnectionLoss() {
+    _isConnected = false;
+    _connectionStateController.add(false);
+  }
+
   /// Clear sent messages (for test isolation)
   void clearSentMessages() {
     sentControlMessages.clear();
@@ -0,0 +1,205 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/client/moq_object_encryption.dart';
+import 'package:moq_flutter/moq/protocol/moq_messages.dart';
+
+import 'mock_transport.dart';
+
+void main() {
+  late MockMoQTransport transport;
+  late MoQClient client;
+  late _FakeCipher cipher;
+  late MoQObjectEncryption encryption;
+
+  setUp(() {
+    transport = MockMoQTransport();
+    client = MoQClient(transport: transport);
+    cipher = _FakeCipher();
+    encryption = MoQObjectEncryption(cipher: cipher);
+    client.objectEncryption = encryption;
+    transport.onControlMessageSent = (data) {
+      if (data.isEmpty) return;
+      if (data[0] == 0x20) {
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            ServerSetupMessage(selectedVersion: MoQVersion.draft14).serialize(),
+          );
+        });
+      } else if (data[0] == 0x03) {
+        final payloadLength = (data[1] << 8) | data[2];
+        final subscribe = SubscribeMessage.deserialize(
+          data.sublist(3, 3 + payloadLength),
+        );
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            SubscribeOkMessage(
+              requestId: subscribe.requestId,
+              trackAlias: Int64(7),
+              expires: Int64.ZERO,
+              groupOrder: GroupOrder.ascending,
+              contentExists: 0,
+            ).serialize(),
+          );
+        });
+      }
+    };
+  });
+
+  tearDown(() async {
+    client.dispose();
+    transport.dispose();
+  });
+
+  group('MoQObjectEncryption', () {
+    test('seals payloads of protected tracks only', () async {
+      await client.connect('localhost', 4443);
+      encryption.protectOutgoing(Int64(5), 9);
+      final payload = Uint8List.fromList([1, 2, 3]);
+
+      final protectedStream = await _writeObject(client, Int64(5), payload);
+      final clearStream = await _writeObject(client, Int64(6), payload);
+
+      final sealed = _FakeCipher.seal(9, Int64(3), Int64(1), payload);
+      expect(_endsWith(transport.sentStreamData[protectedStream]![1], sealed),
+          isTrue);
+      expect(_endsWith(transport.sentStreamData[clearStream]![1], payload),
+          isTrue);
+      expect(encryption.sealedCount, equals(1));
+    });
+
+    test('refuses a key ID already protecting another track', () {
+      encryption.protectOutgoing(Int64(5), 9);
+      encryption.protectOutgoing(Int64(5), 9);
+      expect(
+        () => encryption.protectOutgoing(Int64(6), 9),
+        throwsArgumentError,
+      );
+      expect(encryption.keyIdFor(Int64(6)), isNull);
+    });
+
+    test('opens a chunk in one batch and drops objects that fail', () async {
+      await client.connect('localhost', 4443);
+      final namespace = [Uint8List.fromList('room'.codeUnits)];
+      final trackName = Uint8List.fromList('video'.codeUnits);
+      encryption.expectProtected(namespace, trackName, 4);
+      await client.subscribe(namespace, trackName);
+      final subscription = client.subscriptions.values.single;
+      final received = <String>[];
+      subscription.objectStream.listen((object) {
+        received.add('${object.objectId}:${object.payload!.join(',')}');
+      });
+
+      // Four objects arrive in one chunk; the second was not encrypted and
+      // the last was sealed with another track's key
+      final streamId = await client.openDataStream();
+      await client.writeSubgroupHeader(
+        streamId,
+        trackAlias: Int64(7),
+        groupId: Int64(3),
+        subgroupId: Int64.ZERO,
+        publisherPriority: 128,
+      );
+      for (var objectId = 0; objectId < 4; objectId++) {
+        final plain = Uint8List.fromList([objectId, 10 + objectId]);
+        await client.writeObject(
+          streamId,
+          objectId: Int64(objectId),
+          payload: objectId == 1
+              ? plain
+              : _FakeCipher.seal(
+                  objectId == 3 ? 5 : 4,
+                  Int64(3),
+                  Int64(objectId),
+                  plain,
+                ),
+        );
+      }
+      final chunk = <int>[
+        for (final write in transport.sentStreamData.remove(streamId)!)
+          ...write,
+      ];
+      transport.simulateIncomingDataStream(
+        900,
+        Uint8List.fromList(chunk),
+        isComplete: true,
+      );
+      await Future<void>.delayed(const Duration(milliseconds: 10));
+
+      expect(received, equals(['0:0,10', '2:2,12']));
+      expect(cipher.openCalls, equals(1));
+      expect(encryption.openedCount, equals(2));
+      expect(encryption.failureCount, equals(2));
+    });
+  });
+}
+
+Future<int> _writeObject(
+  MoQClient client,
+  Int64 trackAlias,
+  Uint8List payload,
+) async {
+  final streamId = await client.openDataStream();
+  await client.writeSubgroupHeader(
+    streamId,
+    trackAlias: trackAlias,
+    groupId: Int64(3),
+    subgroupId: Int64.ZERO,
+    publisherPriority: 128,
+  );
+  await client.writeObject(streamId, objectId: Int64(1), payload: payload);
+  return streamId;
+}
+
+bool _endsWith(Uint8List data, Uint8List suffix) {
+  if (data.length < suffix.length) return false;
+  final offset = data.length - suffix.length;
+  for (var i = 0; i < suffix.length; i++) {
+    if (data[offset + i] != suffix[i]) return false;
+  }
+  return true;
+}
+
+/// Location-bound XOR "cipher" standing in for the native AES-GCM backend
+class _FakeCipher implements ObjectCipher {
+  int openCalls = 0;
+
+  static Uint8List seal(
+    int keyId,
+    Int64 groupId,
+    Int64 objectId,
+    Uint8List payload,
+  ) => Uint8List.fromList([
+    0xE0,
+    keyId,
+    groupId.toInt() & 0xFF,
+    objectId.toInt() & 0xFF,
+    ...payload.map((b) => b ^ 0x5A),
+  ]);
+
+  @override
+  List<Uint8List?> sealBatch(int keyId, List<ObjectPayload> objects) => [
+    for (final object in objects)
+      seal(keyId, object.groupId, object.objectId, object.payload),
+  ];
+
+  @override
+  List<Uint8List?> openBatch(List<ObjectPayload> objects) {
+    openCalls++;
+    return [
+      for (final object in objects)
+        object.payload.length >= 4 &&
+                object.payload[0] == 0xE0 &&
+                object.payload[1] == object.keyId &&
+                object.payload[2] == object.groupId.toInt() & 0xFF &&
+                object.payload[3] == object.objectId.toInt() & 0xFF
+            ? Uint8List.fromList(
+                object.payload.sublist(4).map((b) => b ^ 0x5A).toList(),
+              )
+            : null,
+    ];
+  }
+}
@@ -0,0 +1,354 @@
+import 'dart:async';
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/client/moq_zapping.dart';
+import 'package:moq_flutter/moq/protocol/moq_messages.dart';
+
+import 'mock_transport.dart';
+
+// Simulated relay round trip and stream shape: 10 objects per group, one
+// object every 10ms per channel, so a cold join waits up to 100ms for a keyframe
+const _rtt = Duration(milliseconds: 30);
+const _objectInterval = Duration(milliseconds: 10);
+const _groupSize = 10;
+const _payloadSize = 1000;
+
+void main() {
+  late MockMoQTransport transport;
+  late MoQClient client;
+  late List<String> subscribedNamespaces;
+  late int subscribeUpdates;
+  late Set<Int64> liveAliases;
+  late Map<Int64, Int64> aliasByRequest;
+  final aliasByNamespace = <String, Int64>{
+    'news': Int64(1),
+    'sport': Int64(2),
+    'music': Int64(3),
+  };
+
+  setUp(() {
+    transport = MockMoQTransport();
+    client = MoQClient(transport: transport);
+    subscribedNamespaces = [];
+    subscribeUpdates = 0;
+    liveAliases = {};
+    aliasByRequest = {};
+    transport.onControlMessageSent = (data) {
+      if (data.isEmpty) return;
+      if (data[0] == 0x20) {
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            ServerSetupMessage(selectedVersion: MoQVersion.draft14).serialize(),
+          );
+        });
+      } else if (data[0] == 0x03) {
+        final payloadLength = (data[1] << 8) | data[2];
+        final payload = data.sublist(3, 3 + payloadLength);
+        final subscribe = SubscribeMessage.deserialize(payload);
+        final namespace = String.fromCharCodes(subscribe.trackNamespace.first);
+        final alias = aliasByNamespace[namespace]!;
+        subscribedNamespaces.add(namespace);
+        aliasByRequest[subscribe.requestId] = alias;
+        Future<void>.delayed(_rtt, () {
+          liveAliases.add(alias);
+          transport.simulateIncomingControlData(
+            SubscribeOkMessage(
+              requestId: subscribe.requestId,
+              trackAlias: alias,
+              expires: Int64.ZERO,
+              groupOrder: GroupOrder.descending,
+              contentExists: 1,
+              largestLocation: Location.zero(),
+            ).serialize(),
+          );
+        });
+      } else if (data[0] == 0x02) {
+        subscribeUpdates++;
+      } else if (data[0] == 0x0A) {
+        final payloadLength = (data[1] << 8) | data[2];
+        final payload = data.sublist(3, 3 + payloadLength);
+        final requestId = UnsubscribeMessage.deserialize(payload).requestId;
+        liveAliases.remove(aliasByRequest[requestId]);
+      }
+    };
+  });
+
+  tearDown(() async {
+    client.dispose();
+    transport.dispose();
+  });
+
+  group('MoQZappingController', () {
+    test('warm switch is a priority flip without a new SUBSCRIBE', () async {
+      await client.connect('localhost', 4443);
+      final zapping = MoQZappingController(client: client);
+      final news = ZapChannel.named('news', ['video']);
+      final sport = ZapChannel.named('sport', ['video']);
+
+      final publisher = _LivePublisher(client, transport, liveAliases)..start();
+
+      final cold = await zapping.tune(news);
+      expect(cold.isActive, isTrue);
+      await zapping.setStandby([sport]);
+      expect(zapping.standby.single.channel.id, equals('sport'));
+      final standbySubscription = zapping.standby.single.subscriptions.single;
+      expect(standbySubscription.priority, equals(224));
+
+      // Let the standby channel receive a group start
+      await Future<void>.delayed(_objectInterval * (_groupSize + 2));
+      final subscribesBefore = subscribedNamespaces.length;
+      final updatesBefore = subscribeUpdates;
+
+      final warm = await zapping.tune(sport);
+
+      expect(subscribedNamespaces.length, equals(subscribesBefore));
+      // One update promotes the new channel, one demotes the old one
+      expect(subscribeUpdates - updatesBefore, equals(2));
+      expect(standbySubscription.priority, equals(32));
+      expect(warm.isActive, isTrue);
+      expect(cold.isActive, isFalse);
+      expect(zapping.metrics.warmSwitches, equals(1));
+      expect(zapping.metrics.coldSwitches, equals(1));
+
+      publisher.stop();
+      await zapping.close();
+    });
+
+    test('drops objects of older groups while on standby', () async {
+      await client.connect('localhost', 4443);
+      final zapping = MoQZappingController(client: client);
+      final tuned = zapping.tune(ZapChannel.named('news', ['video']));
+      final newsAlias = aliasByNamespace['news']!;
+      await _waitFor(() => liveAliases.contains(newsAlias));
+      await _pushObject(client, transport, 40, newsAlias, 0, 0);
+      await tuned;
+      await zapping.setStandby([ZapChannel.named('sport', ['video'])]);
+      final standby = zapping.standby.single;
+      final received = <String>[];
+      standby.objectStream.listen((object) {
+        received.add('${object.groupId}/${object.objectId}');
+      });
+
+      final alias = aliasByNamespace['sport']!;
+      // Newest-first delivery: group 8 arrives before the tail of group 7
+      await _pushObject(client, transport, 41, alias, 8, 0);
+      await _pushObject(client, transport, 42, alias, 7, 9);
+      await _pushObject(client, transport, 43, alias, 8, 1);
+
+      expect(received, equals(['8/0', '8/1']));
+      expect(standby.hasGroupStart, isTrue);
+      expect(zapping.metrics.staleObjectsDropped, equals(1));
+
+      await zapping.close();
+    });
+
+    test('replays only the latest group to a late standby listener', () async {
+      await client.connect('localhost', 4443);
+      final zapping = MoQZappingController(client: client);
+      final tuned = zapping.tune(ZapChannel.named('news', ['video']));
+      final newsAlias = aliasByNamespace['news']!;
+      await _waitFor(() => liveAliases.contains(newsAlias));
+      await _pushObject(client, transport, 40, newsAlias, 0, 0);
+      await tuned;
+      await zapping.setStandby([ZapChannel.named('sport', ['video'])]);
+      final standby = zapping.standby.single;
+
+      final alias = aliasByNamespace['sport']!;
+      await _pushObject(client, transport, 41, alias, 3, 0);
+      await _pushObject(client, transport, 42, alias, 3, 1);
+      await _pushObject(client, transport, 43, alias, 4, 0);
+
+      final received = <String>[];
+      standby.objectStream.listen((object) {
+        received.add('${object.groupId}/${object.objectId}');
+      });
+      expect(received, equals(['4/0']));
+
+      await zapping.close();
+    });
+
+    test('replays a long standby group from its start', () async {
+      await client.connect('localhost', 4443);
+      final zapping = MoQZappingController(client: client);
+      final tuned = zapping.tune(ZapChannel.named('news', ['video']));
+      final newsAlias = aliasByNamespace['news']!;
+      await _waitFor(() => liveAliases.contains(newsAlias));
+      await _pushObject(client, transport, 40, newsAlias, 0, 0);
+      await tuned;
+      await zapping.setStandby([ZapChannel.named('sport', ['video'])]);
+      final standby = zapping.standby.single;
+
+      final alias = aliasByNamespace['sport']!;
+      await _pushObject(client, transport, 41, alias, 4, 0);
+      for (var i = 0; i < 90; i++) {
+        await _pushObject(client, transport, 42 + i, alias, 5, i);
+      }
+
+      final received = <String>[];
+      standby.objectStream.listen((object) {
+        received.add('${object.groupId}/${object.objectId}');
+      });
+      expect(received.length, equals(90));
+      expect(received.first, equals('5/0'));
+
+      await zapping.close();
+    });
+
+    test(
+      'benchmark: switch latency and standby bandwidth',
+      () async {
+        await client.connect('localhost', 4443);
+        final zapping = MoQZappingController(
+          client: client,
+          options: const ZappingOptions(standbyCount: 2),
+        );
+        final channels = [
+          for (final name in aliasByNamespace.keys)
+            ZapChannel.named(name, ['video']),
+        ];
+        final publisher = _LivePublisher(client, transport, liveAliases)
+          ..start();
+
+        // Cold: every switch subscribes afresh and waits for a keyframe
+        final coldLatencies = <Duration>[];
+        final coldZapping = MoQZappingController(client: client);
+        for (var i = 0; i < 6; i++) {
+          final handle = await coldZapping.tune(channels[i % channels.length]);
+          coldLatencies.add(coldZapping.metrics.lastSwitch!.latency);
+          await coldZapping.setStandby(const []);
+          expect(handle.isActive, isTrue);
+        }
+        await coldZapping.close();
+
+        // Warm: neighbours are kept subscribed at standby priority
+        final warmLatencies = <Duration>[];
+        await zapping.tune(channels[0]);
+        for (var i = 1; i <= 6; i++) {
+          final next = channels[i % channels.length];
+          await zapping.setStandby([
+            next,
+            channels[(i + 1) % channels.length],
+          ]);
+          await Future<void>.delayed(_objectInterval * (_groupSize + 2));
+          await zapping.tune(next);
+          warmLatencies.add(zapping.metrics.lastSwitch!.latency);
+          expect(zapping.metrics.lastSwitch!.warm, isTrue);
+        }
+
+        publisher.stop();
+        final metrics = zapping.metrics;
+        final activeBitrate =
+            _payloadSize * 8 * Duration.microsecondsPerSecond ~/
+            _objectInterval.inMicroseconds;
+        final coldMedian = _median(coldLatencies);
+        final warmMedian = _median(warmLatencies);
+
+        // ignore: avoid_print
+        print(
+          'zapping: cold median ${coldMedian.inMicroseconds / 1000}ms, '
+          'warm median ${warmMedian.inMicroseconds / 1000}ms, '
+          'standby ${metrics.standbyBitrate ~/ 1000} kbps per channel-second '
+          '(active stream ${activeBitrate ~/ 1000} kbps), '
+          'stale dropped ${metrics.staleObjectsDropped}',
+        );
+
+        expect(warmMedian, lessThan(coldMedian));
+        expect(coldMedian, greaterThanOrEqualTo(_rtt));
+        expect(metrics.standbyBytes, greaterThan(0));
+
+        await zapping.close();
+      },
+      timeout: const Timeout(Duration(seconds: 30)),
+    );
+  });
+}
+
+Future<void> _waitFor(bool Function() condition) async {
+  final deadline = DateTime.now().add(const Duration(seconds: 2));
+  while (!condition()) {
+    if (DateTime.now().isAfter(deadline)) {
+      throw TimeoutException('Condition not met');
+    }
+    await Future<void>.delayed(const Duration(milliseconds: 5));
+  }
+}
+
+Duration _median(List<Duration> values) {
+  final sorted = [...values]..sort();
+  return sorted[sorted.length ~/ 2];
+}
+
+/// Pushes one object per interval on every subscribed alias
+class _LivePublisher {
+  final MoQClient client;
+  final MockMoQTransport transport;
+  final Set<Int64> liveAliases;
+  bool _running = false;
+  int _tick = 0;
+  int _streamId = 1000;
+
+  _LivePublisher(this.client, this.transport, this.liveAliases);
+
+  void start() {
+    _running = true;
+    _run();
+  }
+
+  void stop() => _running = false;
+
+  Future<void> _run() async {
+    while (_running) {
+      final groupId = _tick ~/ _groupSize;
+      final objectId = _tick % _groupSize;
+      for (final alias in liveAliases.toList()) {
+        await _pushObject(
+          client,
+          transport,
+          _streamId++,
+          alias,
+          groupId,
+          objectId,
+          settle: false,
+        );
+      }
+      _tick++;
+      await Future<void>.delayed(_objectInterval);
+    }
+  }
+}
+
+Future<void> _pushObject(
+  MoQClient client,
+  MockMoQTransport transport,
+  int streamId,
+  Int64 trackAlias,
+  int groupId,
+  int objectId, {
+  bool settle = true,
+}) async {
+  final encodedStreamId = await client.openDataStream();
+  await client.writeSubgroupHeader(
+    encodedStreamId,
+    trackAlias: trackAlias,
+    groupId: Int64(groupId),
+    subgroupId: Int64.ZERO,
+    publisherPriority: 128,
+  );
+  await client.writeObject(
+    encodedStreamId,
+    objectId: Int64(objectId),
+    payload: Uint8List(_payloadSize),
+  );
+
+  final writes = transport.sentStreamData[encodedStreamId]!;
+  transport.sentStreamData.remove(encodedStreamId);
+
+  transport.simulateIncomingDataStream(streamId, writes[0]);
+  transport.simulateIncomingDataStream(streamId, writes[1], isComplete: true);
+  if (settle) {
+    await Future<void>.delayed(const Duration(milliseconds: 5));
+  }
+}
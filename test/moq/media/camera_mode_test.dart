@@ -0,0 +1,102 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/media/camera_mode.dart';
+
+CameraMode _mode(String fourcc, int width, int height, double frameRate) =>
+    CameraMode(
+      fourcc: fourcc,
+      width: width,
+      height: height,
+      frameRate: frameRate,
+      compressed: fourcc == 'MJPG',
+    );
+
+void main() {
+  group('CameraModeSelector', () {
+    // Typical USB 2.0 webcam: raw YUYV is bandwidth-limited above 480p
+    final webcam = [
+      _mode('YUYV', 640, 480, 30),
+      _mode('YUYV', 1280, 720, 10),
+      _mode('YUYV', 1920, 1080, 5),
+      _mode('MJPG', 640, 480, 30),
+      _mode('MJPG', 1280, 720, 30),
+      _mode('MJPG', 1280, 720, 60),
+      _mode('MJPG', 1920, 1080, 30),
+    ];
+
+    test('prefers a raw mode that reaches the rate', () {
+      final mode = CameraModeSelector.select(
+        webcam,
+        width: 640,
+        height: 480,
+        frameRate: 30,
+      );
+      expect(mode!.fourcc, 'YUYV');
+    });
+
+    test('switches to MJPEG when raw is too slow', () {
+      final mode = CameraModeSelector.select(
+        webcam,
+        width: 1280,
+        height: 720,
+        frameRate: 30,
+      );
+      expect(mode!.fourcc, 'MJPG');
+      expect(mode.frameRate, 60);
+    });
+
+    test('treats 29.97 as reaching 30', () {
+      final mode = CameraModeSelector.select(
+        [_mode('YUYV', 1280, 720, 29.97), _mode('MJPG', 1280, 720, 30)],
+        width: 1280,
+        height: 720,
+        frameRate: 30,
+      );
+      expect(mode!.fourcc, 'YUYV');
+    });
+
+    test('falls back to the smallest covering size', () {
+      final mode = CameraModeSelector.select(
+        webcam,
+        width: 800,
+        height: 600,
+        frameRate: 30,
+      );
+      expect((mode!.width, mode.height), (1280, 720));
+    });
+
+    test('takes the fastest mode when nothing reaches the rate', () {
+      final mode = CameraModeSelector.select(
+        [_mode('YUYV', 1920, 1080, 5), _mode('MJPG', 1920, 1080, 15)],
+        width: 1920,
+        height: 1080,
+        frameRate: 30,
+      );
+      expect(mode!.fourcc, 'MJPG');
+    });
+
+    test('ignores formats ffmpeg cannot read', () {
+      expect(
+        CameraModeSelector.select(
+          [_mode('H264', 1280, 720, 30)],
+          width: 1280,
+          height: 720,
+          frameRate: 30,
+        ),
+        isNull,
+      );
+    });
+  });
+
+  test('CameraMode.fromFourccCode decodes little-endian FourCC', () {
+    final mode = CameraMode.fromFourccCode(
+      code: 0x47504A4D, // 'MJPG'
+      width: 1280,
+      height: 720,
+      frameRate: 30,
+      compressed: true,
+    );
+    expect(mode.fourcc, 'MJPG');
+    expect(mode.isMjpeg, isTrue);
+    expect(mode.ffmpegInputFormat, 'mjpeg');
+  });
+}
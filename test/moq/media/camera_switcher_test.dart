@@ -0,0 +1,214 @@
+import 'dart:async';
+import 'dart:typed_data';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/media/camera_capture.dart' show VideoFrame;
+import 'package:moq_flutter/moq/media/camera_switcher.dart';
+
+const _frameInterval = Duration(milliseconds: 33);
+
+/// Synthetic camera: frames at 30fps after an open delay, stamped on its
+/// own clock, with the camera's id in the first byte
+class _SyntheticFeed implements CameraFeed {
+  final int id;
+  final _frames = StreamController<VideoFrame>.broadcast();
+  final int _clockBaseMs;
+  final Stopwatch _clock = Stopwatch();
+  late final Timer _openTimer;
+  Timer? _timer;
+  bool stopped = false;
+
+  _SyntheticFeed(this.id, {required Duration openDelay, int clockBaseMs = 0})
+    : _clockBaseMs = clockBaseMs {
+    _openTimer = Timer(openDelay, () {
+      _clock.start();
+      _timer = Timer.periodic(_frameInterval, (_) {
+        _frames.add(
+          VideoFrame(
+            data: Uint8List.fromList([id]),
+            width: 2,
+            height: 2,
+            timestampMs: _clockBaseMs + _clock.elapsedMilliseconds,
+            format: 'yuv420p',
+          ),
+        );
+      });
+    });
+  }
+
+  @override
+  Stream<VideoFrame> get frames => _frames.stream;
+
+  @override
+  Future<void> stop() async {
+    stopped = true;
+    _openTimer.cancel();
+    _timer?.cancel();
+    await _frames.close();
+  }
+}
+
+/// Frames as received, with arrival times
+class _Recorder {
+  final frames = <VideoFrame>[];
+  final arrivals = <int>[];
+  final _clock = Stopwatch()..start();
+
+  void add(VideoFrame frame) {
+    frames.add(frame);
+    arrivals.add(_clock.elapsedMilliseconds);
+  }
+
+  /// Longest wait between two frames
+  int get maxGapMs {
+    var gap = 0;
+    for (var i = 1; i < arrivals.length; i++) {
+      final d = arrivals[i] - arrivals[i - 1];
+      if (d > gap) gap = d;
+    }
+    return gap;
+  }
+}
+
+void main() {
+  group('CameraSwitcher', () {
+    const openDelay = Duration(milliseconds: 300);
+    late Map<String, _SyntheticFeed> feeds;
+
+    Future<CameraFeed> open(String device) async {
+      final feed = _SyntheticFeed(
+        int.parse(device),
+        openDelay: openDelay,
+        // Each camera has an unrelated clock
+        clockBaseMs: int.parse(device) * 100000,
+      );
+      feeds[device] = feed;
+      return feed;
+    }
+
+    setUp(() => feeds = {});
+
+    test('switches without a capture gap', () async {
+      final switcher = CameraSwitcher(open);
+      final recorder = _Recorder();
+      switcher.frames.listen(recorder.add);
+
+      await switcher.start('1');
+      await Future<void>.delayed(const Duration(milliseconds: 500));
+      await switcher.switchTo('2');
+      await Future<void>.delayed(const Duration(milliseconds: 200));
+      await switcher.dispose();
+
+      final gap = switcher.lastSwitchGap!;
+      // ignore: avoid_print
+      print(
+        'make-before-break: switch gap ${gap.inMilliseconds}ms, '
+        'longest frame gap ${recorder.maxGapMs}ms '
+        '(camera open takes ${openDelay.inMilliseconds}ms)',
+      );
+      expect(gap, lessThan(openDelay ~/ 2));
+      expect(switcher.device, isNull);
+      expect(feeds['1']!.stopped, isTrue);
+
+      // Camera 1 then camera 2, never interleaved
+      final ids = recorder.frames.map((f) => f.data[0]).toList();
+      final cut = ids.indexOf(2);
+      expect(cut, greaterThan(0));
+      expect(ids.sublist(0, cut), everyElement(1));
+      expect(ids.sublist(cut), everyElement(2));
+    });
+
+    test('break-before-make baseline stalls for the camera open', () async {
+      final recorder = _Recorder();
+      var feed = await open('1');
+      var subscription = feed.frames.listen(recorder.add);
+      await Future<void>.delayed(const Duration(milliseconds: 500));
+
+      await subscription.cancel();
+      await feed.stop();
+      feed = await open('2');
+      subscription = feed.frames.listen(recorder.add);
+      await Future<void>.delayed(const Duration(milliseconds: 500));
+      await subscription.cancel();
+      await feed.stop();
+
+      // ignore: avoid_print
+      print('break-before-make: longest frame gap ${recorder.maxGapMs}ms');
+      expect(recorder.maxGapMs, greaterThanOrEqualTo(openDelay.inMilliseconds));
+    });
+
+    test('keeps timestamps continuous across clocks', () async {
+      final switcher = CameraSwitcher(open, frameRate: 30);
+      final timestamps = <int>[];
+      final ids = <int>[];
+      switcher.frames.listen((frame) {
+        timestamps.add(frame.timestampMs);
+        ids.add(frame.data[0]);
+      });
+
+      await switcher.start('1');
+      await Future<void>.delayed(const Duration(milliseconds: 400));
+      await switcher.switchTo('2');
+      await Future<void>.delayed(const Duration(milliseconds: 150));
+      await switcher.dispose();
+
+      for (var i = 1; i < timestamps.length; i++) {
+        expect(timestamps[i], greaterThan(timestamps[i - 1]));
+      }
+      final cut = ids.indexOf(2);
+      // One frame interval across the switch, although camera 2's clock is
+      // 100 s ahead
+      expect(timestamps[cut] - timestamps[cut - 1], 1000 ~/ 30);
+      expect(timestamps.last - timestamps[cut], lessThan(1000));
+    });
+
+    test('keeps the current camera when the new one fails', () async {
+      final switcher = CameraSwitcher(
+        (device) async {
+          if (device == 'broken') throw StateError('no such camera');
+          if (device == '9') {
+            // Opens but never delivers
+            final feed = _SyntheticFeed(9, openDelay: const Duration(hours: 1));
+            feeds[device] = feed;
+            return feed;
+          }
+          return open(device);
+        },
+        switchTimeout: const Duration(milliseconds: 200),
+      );
+      final ids = <int>[];
+      switcher.frames.listen((frame) => ids.add(frame.data[0]));
+
+      await switcher.start('1');
+      await expectLater(switcher.switchTo('broken'), throwsStateError);
+      await expectLater(
+        switcher.switchTo('9'),
+        throwsA(isA<TimeoutException>()),
+      );
+      expect(feeds['9']!.stopped, isTrue);
+      expect(switcher.isSwitching, isFalse);
+      expect(switcher.device, '1');
+
+      final before = ids.length;
+      await Future<void>.delayed(const Duration(milliseconds: 200));
+      expect(ids.length, greaterThan(before));
+      expect(ids, everyElement(1));
+      await switcher.dispose();
+    });
+
+    test('refuses a second switch while the camera opens', () async {
+      final switcher = CameraSwitcher(
+        open,
+        switchTimeout: const Duration(seconds: 2),
+      );
+      await switcher.start('1');
+
+      final first = switcher.switchTo('2');
+      expect(switcher.isSwitching, isTrue);
+      await expectLater(switcher.switchTo('3'), throwsStateError);
+      await first;
+      expect(switcher.device, '2');
+      expect(feeds.containsKey('3'), isFalse);
+      await switcher.dispose();
+    });
+  });
+}
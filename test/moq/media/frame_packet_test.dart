@@ -0,0 +1,184 @@
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/media/frame_packet.dart';
+import 'package:moq_flutter/moq/media/native_capture_channel.dart';
+
+/// Same bytes as windows/runner/test/frame_packet_test.cpp
+final _golden = Uint8List.fromList([
+  0x01, 0x00, 0x01, 0x00, // version, kind, format
+  0x00, 0x05, 0x00, 0x00, // width 1280
+  0xD0, 0x02, 0x00, 0x00, // height 720
+  0x00, 0x14, 0x00, 0x00, // stride 5120
+  0x05, 0x04, 0x03, 0x02, 0x01, 0x00, 0x00, 0x00, // timestamp
+  0x07, 0x00, 0x00, 0x00, // sequence
+  0x03, 0x00, 0x00, 0x00, // payload size
+  0xAA, 0xBB, 0xCC,
+]);
+
+/// Messages per second and payload bytes copied on the Dart side for one
+/// way of getting a frame from the platform
+class _Result {
+  final double messagesPerSecond;
+  final int bytesCopied;
+  _Result(this.messagesPerSecond, this.bytesCopied);
+}
+
+_Result _measure(int iterations, int Function() receiveOne) {
+  var copied = 0;
+  final watch = Stopwatch()..start();
+  for (var i = 0; i < iterations; i++) {
+    copied += receiveOne();
+  }
+  watch.stop();
+  return _Result(
+    iterations * 1e6 / watch.elapsedMicroseconds,
+    copied ~/ iterations,
+  );
+}
+
+void main() {
+  group('FramePacket', () {
+    test('matches the native layout', () {
+      final packet = FramePacket.encode(
+        kind: FramePacket.kindVideo,
+        format: FramePacket.formatBgra,
+        width: 1280,
+        height: 720,
+        stride: 5120,
+        timestampMs: 0x0102030405,
+        sequence: 7,
+        payload: Uint8List.fromList([0xAA, 0xBB, 0xCC]),
+      );
+      expect(packet, _golden);
+
+      final parsed = FramePacket.parse(ByteData.sublistView(_golden))!;
+      expect(parsed.kind, FramePacket.kindVideo);
+      expect(parsed.format, 'bgra');
+      expect(parsed.width, 1280);
+      expect(parsed.height, 720);
+      expect(parsed.stride, 5120);
+      expect(parsed.timestampMs, 0x0102030405);
+      expect(parsed.sequence, 7);
+      expect(parsed.payload, [0xAA, 0xBB, 0xCC]);
+    });
+
+    test('payload is a view, not a copy', () {
+      final message = Uint8List.fromList(_golden);
+      final parsed = FramePacket.parse(ByteData.sublistView(message))!;
+      message[FramePacket.headerSize] = 0x11;
+      expect(parsed.payload.first, 0x11);
+    });
+
+    test('reads audio fields', () {
+      final packet = FramePacket.encode(
+        kind: FramePacket.kindAudio,
+        format: FramePacket.formatPcm,
+        width: 48000,
+        height: 2,
+        stride: 16,
+        timestampMs: -5,
+        sequence: 0xFFFFFFFF,
+        payload: Uint8List(1920),
+      );
+      final parsed = FramePacket.parse(ByteData.sublistView(packet))!;
+      expect(parsed.format, 'pcm');
+      expect(parsed.sampleRate, 48000);
+      expect(parsed.channels, 2);
+      expect(parsed.bitsPerSample, 16);
+      expect(parsed.timestampMs, -5);
+      expect(parsed.sequence, 0xFFFFFFFF);
+      expect(parsed.payloadLength, 1920);
+    });
+
+    test('rejects truncated and unknown packets', () {
+      ByteData view(List<int> bytes) =>
+          ByteData.sublistView(Uint8List.fromList(bytes));
+      expect(FramePacket.parse(view(_golden.sublist(0, 31))), isNull);
+      expect(FramePacket.parse(view(_golden.sublist(0, 34))), isNull);
+      expect(FramePacket.parse(view([2, ..._golden.skip(1)])), isNull);
+    });
+  });
+
+  // Receiving side of each transport: the event channel decodes a
+  // StandardMethodCodec envelope into a map, then NativeVideoFrame.fromMap;
+  // the binary channel wraps the message. Native copies are not counted
+  // here (four per frame for the map, two for the packet).
+  test('binary packets vs codec maps', () {
+    const codec = StandardMethodCodec();
+
+    void compare(String label, int kind, int format, int w, int h, int size) {
+      final payload = Uint8List(size);
+      final map = {
+        'data': payload,
+        'width': w,
+        'height': h,
+        'format': 'bgra',
+        'bytesPerRow': w * 4,
+        'timestampMs': 1234,
+      };
+      final envelope = codec.encodeSuccessEnvelope(map);
+      final packet = ByteData.sublistView(
+        FramePacket.encode(
+          kind: kind,
+          format: format,
+          width: w,
+          height: h,
+          stride: w * 4,
+          timestampMs: 1234,
+          sequence: 1,
+          payload: payload,
+        ),
+      );
+
+      final iterations = size > 100000 ? 100 : 5000;
+      final viaCodec = _measure(iterations, () {
+        final decoded = codec.decodeEnvelope(envelope) as Map;
+        final frame = NativeVideoFrame.fromMap(
+          Map<String, dynamic>.from(decoded),
+        );
+        // The codec hands back a fresh Uint8List per frame
+        return frame.data.length;
+      });
+      final viaPacket = _measure(iterations, () {
+        final parsed = FramePacket.parse(packet)!;
+        final frame = NativeVideoFrame(
+          data: parsed.payload,
+          width: parsed.width,
+          height: parsed.height,
+          format: parsed.format,
+          timestampMs: parsed.timestampMs,
+          bytesPerRow: parsed.stride,
+        );
+        return frame.data.length == size ? 0 : -1;
+      });
+
+      print(
+        '$label: codec ${viaCodec.messagesPerSecond.toStringAsFixed(0)} msg/s '
+        '(${viaCodec.bytesCopied} bytes copied), binary '
+        '${viaPacket.messagesPerSecond.toStringAsFixed(0)} msg/s '
+        '(${viaPacket.bytesCopied} bytes copied)',
+      );
+      expect(viaPacket.bytesCopied, 0);
+      expect(viaCodec.bytesCopied, size);
+    }
+
+    compare(
+      '720p BGRA',
+      FramePacket.kindVideo,
+      FramePacket.formatBgra,
+      1280,
+      720,
+      1280 * 720 * 4,
+    );
+    // 10ms of 48kHz stereo s16
+    compare(
+      '10ms audio',
+      FramePacket.kindAudio,
+      FramePacket.formatPcm,
+      48000,
+      2,
+      1920,
+    );
+  });
+}
@@ -0,0 +1,195 @@
+import 'dart:typed_data';
+
+import 'package:fixnum/fixnum.dart';
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/protocol/moq_messages.dart';
+import 'package:moq_flutter/moq/publisher/file_publisher.dart';
+
+import '../client/mock_transport.dart';
+
+const _sps = [0x67, 0x64, 0x00, 0x1F];
+const _pps = [0x68, 0xEE];
+
+/// Three H.264 frames (IDR, P, P) at 30fps and two AAC frames
+class _FakeSource implements FileMediaSource {
+  @override
+  final List<FileMediaTrack> tracks = [
+    FileMediaTrack(
+      index: 0,
+      kind: FileTrackKind.video,
+      fourcc: 'avc1',
+      width: 640,
+      height: 360,
+      codecConfig: Uint8List.fromList([
+        1, 0x64, 0x00, 0x1F, 0xFF, 0xE1, 0x00, 0x04, ..._sps,
+        0x01, 0x00, 0x02, ..._pps,
+      ]),
+      sampleCount: 3,
+      durationUs: 100000,
+    ),
+    FileMediaTrack(
+      index: 1,
+      kind: FileTrackKind.audio,
+      fourcc: 'mp4a',
+      sampleRate: 48000,
+      channels: 2,
+      codecConfig: Uint8List.fromList([0x11, 0x90]),
+      sampleCount: 2,
+      durationUs: 42666,
+    ),
+  ];
+
+  @override
+  FileMediaSample sample(int track, int index) {
+    if (track == 0) {
+      return FileMediaSample(
+        dtsUs: index * 33333,
+        ptsUs: index * 33333,
+        isKeyframe: index == 0,
+        // One length-prefixed NAL unit
+        data: Uint8List.fromList([
+          0, 0, 0, 3, index == 0 ? 0x65 : 0x41, 0xB0, index, //
+        ]),
+      );
+    }
+    return FileMediaSample(
+      dtsUs: index * 21333,
+      ptsUs: index * 21333,
+      isKeyframe: true,
+      data: Uint8List.fromList([0xFF, 0xF1, 0xA0 + index]),
+    );
+  }
+}
+
+bool _contains(Uint8List haystack, List<int> needle) {
+  outer:
+  for (var i = 0; i + needle.length <= haystack.length; i++) {
+    for (var j = 0; j < needle.length; j++) {
+      if (haystack[i + j] != needle[j]) continue outer;
+    }
+    return true;
+  }
+  return false;
+}
+
+void main() {
+  late MockMoQTransport transport;
+  late MoQClient client;
+
+  setUp(() {
+    transport = MockMoQTransport();
+    client = MoQClient(transport: transport);
+    transport.onControlMessageSent = (data) {
+      if (data.isNotEmpty && data[0] == 0x20) {
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            ServerSetupMessage(selectedVersion: MoQVersion.draft14).serialize(),
+          );
+        });
+      } else if (data.isNotEmpty && data[0] == 0x06) {
+        Future.microtask(() {
+          transport.simulateIncomingControlData(
+            PublishNamespaceOkMessage(requestId: Int64(0)).serialize(),
+          );
+        });
+      }
+    };
+  });
+
+  tearDown(() {
+    client.dispose();
+    transport.dispose();
+  });
+
+  group('FilePublisher', () {
+    test('sends LOC video as Annex-B with in-band parameter sets', () async {
+      await client.connect('localhost', 4443);
+      final publisher = FilePublisher(
+        client: client,
+        source: _FakeSource(),
+        packaging: FilePackaging.loc,
+        speed: 0,
+      );
+
+      final summary = await publisher.run(['vod']);
+      expect(summary.objects, 5);
+      expect(summary.loops, 0);
+
+      final writes = transport.sentStreamData.values.expand((w) => w).toList();
+      // Keyframe: SPS, PPS and the IDR slice, each behind a start code
+      expect(
+        writes.any(
+          (w) => _contains(w, [
+            0, 0, 0, 1, ..._sps, 0, 0, 0, 1, ..._pps, 0, 0, 0, 1, 0x65, 0xB0, 0,
+          ]),
+        ),
+        isTrue,
+      );
+      // Other frames carry only their slice
+      expect(
+        writes.any((w) => _contains(w, [0, 0, 0, 1, 0x41, 0xB0, 1])),
+        isTrue,
+      );
+      expect(
+        writes.where((w) => _contains(w, [0, 0, 0, 1, ..._sps])).length,
+        1,
+      );
+      // Audio goes out untouched
+      expect(writes.any((w) => _contains(w, [0xFF, 0xF1, 0xA1])), isTrue);
+    });
+
+    test('paces samples by decode time', () async {
+      await client.connect('localhost', 4443);
+      final publisher = FilePublisher(
+        client: client,
+        source: _FakeSource(),
+        packaging: FilePackaging.loc,
+        speed: 2,
+      );
+
+      final summary = await publisher.run(['vod']);
+      // Last video frame decodes at 66.7ms, sent at 33.3ms at double speed
+      expect(summary.elapsed.inMicroseconds, greaterThanOrEqualTo(33333));
+      expect(summary.objects, 5);
+    });
+
+    test('loops until the duration passes', () async {
+      await client.connect('localhost', 4443);
+      final publisher = FilePublisher(
+        client: client,
+        source: _FakeSource(),
+        packaging: FilePackaging.loc,
+        loop: true,
+        duration: const Duration(milliseconds: 250),
+        reportInterval: const Duration(milliseconds: 50),
+      );
+      final reports = <FilePublisherStats>[];
+      publisher.stats.listen(reports.add);
+
+      final summary = await publisher.run(['vod']);
+      // One pass lasts 100ms of media
+      expect(summary.loops, greaterThanOrEqualTo(2));
+      expect(summary.objects, greaterThanOrEqualTo(10));
+      expect(reports.length, greaterThanOrEqualTo(3));
+      expect(reports.last.objects, summary.objects);
+      expect(
+        summary.sendLatencyP99Us,
+        lessThanOrEqualTo(summary.sendLatencyMaxUs),
+      );
+    });
+
+    test('CMAF skips audio that is not Opus', () async {
+      await client.connect('localhost', 4443);
+      final publisher = FilePublisher(
+        client: client,
+        source: _FakeSource(),
+        packaging: FilePackaging.cmaf,
+        speed: 0,
+      );
+
+      final summary = await publisher.run(['vod']);
+      expect(summary.objects, 3);
+    });
+  });
+}
@@ -3,6 +3,8 @@ import 'dart:typed_data';
 import 'package:fixnum/fixnum.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/packager/moq_mi_packager.dart';
+import 'package:moq_flutter/moq/protocol/moq_data_parser.dart';
 import 'package:moq_flutter/moq/publisher/cmaf_publisher.dart';
 import 'package:moq_flutter/moq/publisher/moq_publisher.dart';
 import 'package:moq_flutter/moq/protocol/moq_messages.dart';
@@ -66,6 +68,59 @@ void main() {
         expect(writes.length, equals(2));
       }
     });
+
+    test('attaches the LOC audio level extension to audio objects', () async {
+      await client.connect('localhost', 4443);
+      final publisher = MoQPublisher(client: client);
+
+      await publisher.announce(['live']);
+      await publisher.addAudioTrack('audio0');
+      transport.clearSentMessages();
+
+      await publisher.publishFrame(
+        'audio0',
+        Uint8List.fromList([0xF8, 0xFF, 0xFE]),
+        newGroup: true,
+        extensionHeaders: [locAudioLevelHeader(23, voiceActivity: true)],
+      );
+
+      final parsed = transport.sentStreamData.values
+          .map((writes) => MoQDataStreamParser().parseChunk(
+                Uint8List.fromList(writes.expand((w) => w).toList()),
+              ))
+          .expand((objects) => objects)
+          .where((object) => object.payload?.length == 3)
+          .single;
+      final level = parsed.extensionHeaders.singleWhere(
+        (header) => header.type == locAudioLevelExtension,
+      );
+      expect(level.intValue, equals(0x80 | 23));
+    });
+
+    test('lists thumbnail tracks without a timeline', () async {
+      await client.connect('localhost', 4443);
+      final publisher = MoQPublisher(client: client);
+
+      await publisher.announce(['live']);
+      await publisher.addVideoTrack('video0');
+      await publisher.addThumbnailTrack(
+        'video0.thumbnail',
+        videoTrackName: 'video0',
+        width: 160,
+        height: 90,
+      );
+
+      final catalog = publisher.catalog!;
+      final thumbnail = catalog.thumbnailTrackFor('video0')!;
+      expect(thumbnail.name, equals('video0.thumbnail'));
+      expect(thumbnail.selectionParams?.mimeType, equals('image/jpeg'));
+      expect(thumbnail.depends, equals(['video0']));
+      expect(catalog.thumbnailTrackFor('video1'), isNull);
+      expect(
+        catalog.tracks.where((track) => track.name.endsWith('.timeline')),
+        hasLength(1),
+      );
+    });
   });
 
   group('PUBLISH_DONE on stop', () {
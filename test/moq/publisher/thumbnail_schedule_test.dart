@@ -0,0 +1,47 @@
+import 'package:flutter_test/flutter_test.dart';
+import 'package:moq_flutter/moq/publisher/thumbnail_publisher.dart';
+
+void main() {
+  group('ThumbnailSchedule', () {
+    test('takes the first frame and then one per interval', () {
+      final schedule = ThumbnailSchedule(
+        const ThumbnailTrackConfig(interval: Duration(seconds: 2)),
+      );
+      final taken = [
+        for (var t = 0; t <= 5000; t += 33)
+          if (schedule.shouldCapture(t)) t,
+      ];
+      expect(taken, [0, 2013, 4026]);
+    });
+
+    test('keyframes trigger early thumbnails when enabled', () {
+      final schedule = ThumbnailSchedule(
+        const ThumbnailTrackConfig(
+          interval: Duration(seconds: 10),
+          onKeyframe: true,
+          minKeyframeInterval: Duration(milliseconds: 500),
+        ),
+      );
+      expect(schedule.shouldCapture(0), isTrue);
+
+      // Too soon after the last thumbnail: stays pending
+      schedule.keyframe();
+      expect(schedule.shouldCapture(100), isFalse);
+      expect(schedule.shouldCapture(600), isTrue);
+      expect(schedule.shouldCapture(1200), isFalse);
+    });
+
+    test('ignores keyframes unless enabled', () {
+      final schedule = ThumbnailSchedule(const ThumbnailTrackConfig());
+      schedule.shouldCapture(0);
+      schedule.keyframe();
+      expect(schedule.shouldCapture(1000), isFalse);
+    });
+
+    test('treats a clock going backwards as due', () {
+      final schedule = ThumbnailSchedule(const ThumbnailTrackConfig());
+      schedule.shouldCapture(50000);
+      expect(schedule.shouldCapture(10), isTrue);
+    });
+  });
+}
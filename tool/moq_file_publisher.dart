@@ -0,0 +1,128 @@
+import 'dart:io';
+
+import 'package:logger/logger.dart';
+import 'package:moq_flutter/moq/client/moq_client.dart';
+import 'package:moq_flutter/moq/publisher/file_publisher.dart';
+import 'package:moq_flutter/moq/transport/moq_transport.dart';
+import 'package:moq_flutter/services/native_mp4_source.dart';
+import 'package:moq_flutter/services/quic_transport.dart';
+import 'package:moq_flutter/services/webtransport_quinn_transport.dart';
+
+const _usage = '''
+Publish an MP4 file to a MoQ relay as a live source
+
+Usage: dart run tool/moq_file_publisher.dart [options] <file.mp4>
+
+  --url=<url>          https://host:port/path (WebTransport) or
+                       moqt://host:port (raw QUIC)
+                       [https://localhost:4443/moq]
+  --namespace=<ns>     Namespace to announce, '/'-separated   [vod]
+  --format=cmaf|loc    Packaging   [cmaf]
+  --speed=<x>          Playback speed; 0 sends as fast as possible   [1]
+  --loop               Restart at the end of the file
+  --duration=<time>    Stop after e.g. 90s, 30m or 24h
+  --report=<time>      Stats interval   [10s]
+  --insecure           Skip certificate verification
+
+Needs libmoq_quic built with `--features mp4-source` on the library path.
+''';
+
+/// Publish an MP4 file for VOD ingest or relay soak tests
+void main(List<String> args) async {
+  final options = <String, String>{};
+  final files = <String>[];
+  for (final arg in args) {
+    if (arg.startsWith('--')) {
+      final eq = arg.indexOf('=');
+      if (eq < 0) {
+        options[arg.substring(2)] = 'true';
+      } else {
+        options[arg.substring(2, eq)] = arg.substring(eq + 1);
+      }
+    } else {
+      files.add(arg);
+    }
+  }
+  if (files.length != 1 || options.containsKey('help')) {
+    stderr.write(_usage);
+    exit(64);
+  }
+
+  final url = Uri.parse(options['url'] ?? 'https://localhost:4443/moq');
+  final packaging = switch (options['format'] ?? 'cmaf') {
+    'cmaf' => FilePackaging.cmaf,
+    'loc' => FilePackaging.loc,
+    final other => _fail('Unknown format: $other'),
+  };
+  final speed = double.tryParse(options['speed'] ?? '1') ??
+      _fail('Bad speed: ${options['speed']}');
+  final duration = options['duration'] == null
+      ? null
+      : _parseDuration(options['duration']!);
+  final report = _parseDuration(options['report'] ?? '10s');
+
+  final logger = Logger(level: Level.info);
+  final source = NativeMp4Source.open(files.single) ??
+      _fail('Cannot open ${files.single} (is libmoq_quic built with '
+          'the mp4-source feature?)');
+
+  final MoQTransport transport = url.scheme == 'moqt'
+      ? QuicTransport(logger: logger)
+      : WebTransportQuinnTransport(logger: logger, path: url.path);
+  final client = MoQClient(transport: transport, logger: logger);
+  await client.connect(
+    url.host,
+    url.port,
+    options: {
+      'insecure': '${options.containsKey('insecure')}',
+      if (url.scheme != 'moqt') 'path': url.path,
+    },
+  );
+
+  final publisher = FilePublisher(
+    client: client,
+    source: source,
+    packaging: packaging,
+    speed: speed,
+    loop: options.containsKey('loop'),
+    duration: duration,
+    reportInterval: report,
+    logger: logger,
+  );
+  final interrupt = ProcessSignal.sigint.watch().listen((_) {
+    stdout.writeln('Stopping...');
+    publisher.stop();
+  });
+  publisher.stats.listen(stdout.writeln);
+
+  var status = 0;
+  try {
+    await publisher.run(options['namespace']?.split('/') ?? ['vod']);
+  } catch (e) {
+    stderr.writeln('Publishing failed: $e');
+    status = 1;
+  } finally {
+    await interrupt.cancel();
+    await client.disconnect();
+    source.close();
+  }
+  exit(status);
+}
+
+Never _fail(String message) {
+  stderr.writeln(message);
+  stderr.write(_usage);
+  exit(64);
+}
+
+Duration _parseDuration(String text) {
+  final match = RegExp(r'^(\d+)(ms|s|m|h)?$').firstMatch(text);
+  if (match == null) _fail('Bad duration: $text');
+  final value = int.parse(match.group(1)!);
+  return switch (match.group(2)) {
+    'ms' => Duration(milliseconds: value),
+    'm' => Duration(minutes: value),
+    'h' => Duration(hours: value),
+    _ => Duration(seconds: value),
+  };
+}
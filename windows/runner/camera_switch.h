@@ -0,0 +1,49 @@
+#ifndef CAMERA_SWITCH_H_
+#define CAMERA_SWITCH_H_
+
+// Warm-up of the camera being switched to while capture runs.
+//
+// Standard C++ only, so it builds and is tested on Linux too (see
+// test/camera_switch_test.cpp).
+
+#include <functional>
+
+namespace moq_flutter {
+
+// How a camera switch ended
+enum class CameraSwitchStatus {
+  // The new camera delivered a frame; capture cuts over to it
+  kOk,
+  // The new camera could not be opened or stopped delivering
+  kFailed,
+  // Capture stopped before the new camera delivered a frame; the next
+  // start opens the new camera
+  kCancelled,
+};
+
+// Open a camera and read from it until its first frame.
+//
+// `open` and `read` return false on a device error; `read` sets
+// `got_frame` once it produced a sample. `capturing` is checked between
+// steps, so a capture stopped during the warm-up ends it as kCancelled,
+// not as a device failure.
+inline CameraSwitchStatus WarmUpCamera(const std::function<bool()>& open,
+                                       const std::function<bool(bool& got_frame)>& read,
+                                       const std::function<bool()>& capturing) {
+  auto failed = [&capturing] {
+    return capturing() ? CameraSwitchStatus::kFailed : CameraSwitchStatus::kCancelled;
+  };
+  if (!capturing()) return CameraSwitchStatus::kCancelled;
+  if (!open()) return failed();
+
+  bool got_frame = false;
+  while (!got_frame) {
+    if (!capturing()) return CameraSwitchStatus::kCancelled;
+    if (!read(got_frame)) return failed();
+  }
+  return CameraSwitchStatus::kOk;
+}
+
+}  // namespace moq_flutter
+
+#endif  // CAMERA_SWITCH_H_
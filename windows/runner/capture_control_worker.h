@@ -0,0 +1,241 @@
+#ifndef CAPTURE_CONTROL_WORKER_H_
+#define CAPTURE_CONTROL_WORKER_H_
+
+// Runs capture start/stop off the platform thread.
+//
+// Standard C++ only, so it builds and is tested on Linux too (see
+// test/capture_control_worker_test.cpp).
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace moq_flutter {
+
+// How a start or stop request ended
+enum class CaptureRequestStatus {
+  // The capture is in the requested state
+  kOk,
+  // The start or stop action failed; the capture is in its previous state
+  kFailed,
+  // A later request for the same target asked for the opposite state
+  kSuperseded,
+  // The worker shut down before the request ran
+  kCancelled,
+};
+
+// Per-target counters
+struct CaptureTargetStats {
+  uint64_t starts = 0;
+  uint64_t stops = 0;
+  uint64_t failures = 0;
+  // Requests answered without running an action
+  uint64_t coalesced = 0;
+  double last_start_ms = 0.0;
+  double last_stop_ms = 0.0;
+};
+
+// Executes capture lifecycle commands on one background thread.
+//
+// Each target (audio, video) has a desired running state. Requests update
+// it and queue one reconcile pass; requests that arrive before the pass
+// runs are coalesced, so start+stop+start runs at most one action and a
+// start while running runs none. Every request is answered exactly once,
+// on the worker thread, with its status and the time the action took.
+class CaptureControlWorker {
+ public:
+  using Action = std::function<bool()>;
+  using Done = std::function<void(CaptureRequestStatus status, double elapsed_ms)>;
+  using Task = std::function<void()>;
+
+  CaptureControlWorker() : thread_(&CaptureControlWorker::Run, this) {}
+
+  // Answers requests that have not run with kCancelled; an action already
+  // running finishes first
+  ~CaptureControlWorker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+  }
+
+  CaptureControlWorker(const CaptureControlWorker&) = delete;
+  CaptureControlWorker& operator=(const CaptureControlWorker&) = delete;
+
+  // Register a target; the returned id is used with Request. Call before
+  // the first Request.
+  int AddTarget(Action start, Action stop) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto target = std::make_unique<Target>();
+    target->start = std::move(start);
+    target->stop = std::move(stop);
+    targets_.push_back(std::move(target));
+    return static_cast<int>(targets_.size()) - 1;
+  }
+
+  // Ask for target `id` to be running or stopped
+  void Request(int id, bool running, Done done) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stopping_ || id < 0 || id >= static_cast<int>(targets_.size())) {
+        lock.unlock();
+        if (done) done(CaptureRequestStatus::kCancelled, 0.0);
+        return;
+      }
+      Target& target = *targets_[id];
+      target.pending.push_back(Pending{running, std::move(done)});
+      target.desired = running;
+      if (!target.queued) {
+        target.queued = true;
+        queue_.push_back(Item{id, nullptr});
+      }
+    }
+    cv_.notify_one();
+  }
+
+  // Run `task` on the worker, in order with start and stop requests
+  void Post(Task task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) return;
+      queue_.push_back(Item{-1, std::move(task)});
+    }
+    cv_.notify_one();
+  }
+
+  // Whether target `id` is running, as of the last action
+  bool IsRunning(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return targets_[id]->running;
+  }
+
+  CaptureTargetStats GetStats(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return targets_[id]->stats;
+  }
+
+ private:
+  struct Pending {
+    bool running;
+    Done done;
+  };
+
+  struct Target {
+    Action start;
+    Action stop;
+    bool running = false;
+    bool desired = false;
+    bool queued = false;
+    std::vector<Pending> pending;
+    CaptureTargetStats stats;
+  };
+
+  // A reconcile pass for a target, or a posted task (target -1)
+  struct Item {
+    int target;
+    Task task;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (stopping_) break;
+
+      Item item = std::move(queue_.front());
+      queue_.pop_front();
+      if (item.target < 0) {
+        lock.unlock();
+        item.task();
+        lock.lock();
+      } else {
+        Reconcile(*targets_[item.target], lock);
+      }
+    }
+
+    // Answer whatever did not run
+    std::vector<Pending> cancelled;
+    for (auto& target : targets_) {
+      for (auto& pending : target->pending) cancelled.push_back(std::move(pending));
+      target->pending.clear();
+    }
+    queue_.clear();
+    lock.unlock();
+    for (auto& pending : cancelled) {
+      if (pending.done) pending.done(CaptureRequestStatus::kCancelled, 0.0);
+    }
+  }
+
+  // Called with the lock held; runs the action without it
+  void Reconcile(Target& target, std::unique_lock<std::mutex>& lock) {
+    target.queued = false;
+    std::vector<Pending> pending = std::move(target.pending);
+    target.pending.clear();
+    bool desired = target.desired;
+
+    bool ok = true;
+    double elapsed_ms = 0.0;
+    if (desired != target.running) {
+      Action& action = desired ? target.start : target.stop;
+      lock.unlock();
+      auto begin = std::chrono::steady_clock::now();
+      ok = action ? action() : false;
+      elapsed_ms = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+      lock.lock();
+
+      if (desired) {
+        target.stats.starts++;
+        target.stats.last_start_ms = elapsed_ms;
+      } else {
+        target.stats.stops++;
+        target.stats.last_stop_ms = elapsed_ms;
+      }
+      if (ok) {
+        target.running = desired;
+      } else {
+        target.stats.failures++;
+      }
+      target.stats.coalesced += pending.size() - 1;
+    } else {
+      target.stats.coalesced += pending.size();
+    }
+    bool running = target.running;
+
+    lock.unlock();
+    for (auto& request : pending) {
+      if (!request.done) continue;
+      CaptureRequestStatus status;
+      if (request.running != desired) {
+        status = CaptureRequestStatus::kSuperseded;
+      } else if (running == desired) {
+        status = CaptureRequestStatus::kOk;
+      } else {
+        status = CaptureRequestStatus::kFailed;
+      }
+      request.done(status, elapsed_ms);
+    }
+    lock.lock();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Item> queue_;
+  std::vector<std::unique_ptr<Target>> targets_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+}  // namespace moq_flutter
+
+#endif  // CAPTURE_CONTROL_WORKER_H_
@@ -0,0 +1,119 @@
+#ifndef FRAME_PACKET_H_
+#define FRAME_PACKET_H_
+
+// Capture frames on the binary channels: a packed 32-byte little-endian
+// header followed by the payload. Dart reads the fields in place
+// (lib/moq/media/frame_packet.dart), so nothing is parsed or re-encoded
+// per frame.
+//
+//   0  u8   version (kFramePacketVersion)
+//   1  u8   kind (FramePacketKind)
+//   2  u8   format (FramePacketFormat)
+//   3  u8   reserved, 0
+//   4  u32  width; sample rate for audio
+//   8  u32  height; channels for audio
+//  12  u32  stride in bytes; bits per sample for audio
+//  16  i64  timestamp in ms
+//  24  u32  sequence number, per channel
+//  28  u32  payload size
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace moq_flutter {
+
+constexpr uint8_t kFramePacketVersion = 1;
+constexpr size_t kFramePacketHeaderSize = 32;
+
+enum class FramePacketKind : uint8_t {
+  kVideo = 0,
+  kAudio = 1,
+};
+
+enum class FramePacketFormat : uint8_t {
+  kUnknown = 0,
+  kBgra = 1,
+  kMjpeg = 2,
+  kI420 = 3,
+  kPcm = 4,
+};
+
+struct FramePacketHeader {
+  FramePacketKind kind = FramePacketKind::kVideo;
+  FramePacketFormat format = FramePacketFormat::kUnknown;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t stride = 0;
+  int64_t timestamp_ms = 0;
+  uint32_t sequence = 0;
+  uint32_t payload_size = 0;
+};
+
+namespace frame_packet_detail {
+
+inline void Put32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+inline void Put64(uint8_t* out, uint64_t value) {
+  for (int i = 0; i < 8; i++) out[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+inline uint32_t Get32(const uint8_t* in) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(in[i]) << (8 * i);
+  return value;
+}
+
+inline uint64_t Get64(const uint8_t* in) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(in[i]) << (8 * i);
+  return value;
+}
+
+}  // namespace frame_packet_detail
+
+// Write the header into the first kFramePacketHeaderSize bytes of `out`
+inline void WriteFramePacketHeader(const FramePacketHeader& header, uint8_t* out) {
+  using namespace frame_packet_detail;
+  out[0] = kFramePacketVersion;
+  out[1] = static_cast<uint8_t>(header.kind);
+  out[2] = static_cast<uint8_t>(header.format);
+  out[3] = 0;
+  Put32(out + 4, header.width);
+  Put32(out + 8, header.height);
+  Put32(out + 12, header.stride);
+  Put64(out + 16, static_cast<uint64_t>(header.timestamp_ms));
+  Put32(out + 24, header.sequence);
+  Put32(out + 28, header.payload_size);
+}
+
+// Read a header; false if `data` is not a complete packet of this version
+inline bool ReadFramePacketHeader(const uint8_t* data, size_t size, FramePacketHeader* header) {
+  using namespace frame_packet_detail;
+  if (size < kFramePacketHeaderSize || data[0] != kFramePacketVersion) return false;
+  header->kind = static_cast<FramePacketKind>(data[1]);
+  header->format = static_cast<FramePacketFormat>(data[2]);
+  header->width = Get32(data + 4);
+  header->height = Get32(data + 8);
+  header->stride = Get32(data + 12);
+  header->timestamp_ms = static_cast<int64_t>(Get64(data + 16));
+  header->sequence = Get32(data + 24);
+  header->payload_size = Get32(data + 28);
+  return header->payload_size <= size - kFramePacketHeaderSize;
+}
+
+// Header plus payload in one buffer; the payload is copied exactly once
+inline void BuildFramePacket(FramePacketHeader header, const uint8_t* payload, size_t size,
+                             std::vector<uint8_t>& out) {
+  header.payload_size = static_cast<uint32_t>(size);
+  out.resize(kFramePacketHeaderSize + size);
+  WriteFramePacketHeader(header, out.data());
+  if (size > 0) std::memcpy(out.data() + kFramePacketHeaderSize, payload, size);
+}
+
+}  // namespace moq_flutter
+
+#endif  // FRAME_PACKET_H_
@@ -5,6 +5,7 @@
 #include <functiondiscoverykeys_devpkey.h>
 #include <ks.h>
 #include <ksmedia.h>
+#include <dbt.h>
 
 #pragma comment(lib, "mf.lib")
 #pragma comment(lib, "mfplat.lib")
@@ -14,6 +15,18 @@
 
 namespace moq_flutter {
 
+// Posted to the top-level window when a device rescan finished, so the
+// change event is sent from the platform thread
+constexpr UINT kDevicesChangedMessage = WM_APP + 0x4D;
+// Posted to the task window when work queued by RunOnPlatformThread is
+// waiting
+constexpr UINT kPlatformTaskMessage = WM_APP + 0x4E;
+constexpr wchar_t kTaskWindowClass[] = L"MoqNativeCapturePlatformTasks";
+
+// Binary frame channels, used once Dart asks for them with setFrameTransport
+constexpr char kAudioPacketChannel[] = "com.moq_flutter/audio_packets";
+constexpr char kVideoPacketChannel[] = "com.moq_flutter/video_packets";
+
 // Helper to convert wide string to UTF-8
 static std::string WideToUtf8(const std::wstring& wide) {
   if (wide.empty()) return std::string();
@@ -110,6 +123,50 @@ void VideoStreamHandler::SendVideoFrame(const std::vector<uint8_t>& data,
   event_sink_->Success(flutter::EncodableValue(event_data));
 }
 
+// DeviceStreamHandler implementation
+std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>>
+DeviceStreamHandler::OnListenInternal(
+    const flutter::EncodableValue* arguments,
+    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events) {
+  std::lock_guard<std::mutex> lock(event_sink_mutex_);
+  event_sink_ = std::move(events);
+  return nullptr;
+}
+
+std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>>
+DeviceStreamHandler::OnCancelInternal(const flutter::EncodableValue* arguments) {
+  std::lock_guard<std::mutex> lock(event_sink_mutex_);
+  event_sink_ = nullptr;
+  return nullptr;
+}
+
+void DeviceStreamHandler::SendDeviceChange(const std::vector<CameraInfo>& cameras,
+                                           const std::vector<std::string>& added,
+                                           const std::vector<std::string>& removed,
+                                           bool has_microphone) {
+  std::lock_guard<std::mutex> lock(event_sink_mutex_);
+  if (!event_sink_) return;
+
+  flutter::EncodableList camera_list;
+  for (const auto& camera : cameras) {
+    flutter::EncodableMap camera_map;
+    camera_map[flutter::EncodableValue("id")] = flutter::EncodableValue(camera.id);
+    camera_map[flutter::EncodableValue("name")] = flutter::EncodableValue(camera.name);
+    camera_map[flutter::EncodableValue("position")] = flutter::EncodableValue(camera.position);
+    camera_list.push_back(flutter::EncodableValue(camera_map));
+  }
+  flutter::EncodableList added_list(added.begin(), added.end());
+  flutter::EncodableList removed_list(removed.begin(), removed.end());
+
+  flutter::EncodableMap event_data;
+  event_data[flutter::EncodableValue("cameras")] = flutter::EncodableValue(camera_list);
+  event_data[flutter::EncodableValue("added")] = flutter::EncodableValue(added_list);
+  event_data[flutter::EncodableValue("removed")] = flutter::EncodableValue(removed_list);
+  event_data[flutter::EncodableValue("hasMicrophone")] = flutter::EncodableValue(has_microphone);
+
+  event_sink_->Success(flutter::EncodableValue(event_data));
+}
+
 // NativeCapturePlugin implementation
 void NativeCapturePlugin::RegisterWithRegistrar(
     flutter::PluginRegistrarWindows* registrar) {
@@ -117,7 +174,8 @@ void NativeCapturePlugin::RegisterWithRegistrar(
   registrar->AddPlugin(std::move(plugin));
 }
 
-NativeCapturePlugin::NativeCapturePlugin(flutter::PluginRegistrarWindows* registrar) {
+NativeCapturePlugin::NativeCapturePlugin(flutter::PluginRegistrarWindows* registrar)
+    : registrar_(registrar), messenger_(registrar->messenger()) {
   // Initialize COM
   HRESULT hr = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
   if (SUCCEEDED(hr) || hr == S_FALSE || hr == RPC_E_CHANGED_MODE) {
@@ -131,6 +189,7 @@ NativeCapturePlugin::NativeCapturePlugin(flutter::PluginRegistrarWindows* regist
   // Create stream handlers
   audio_stream_handler_ = std::make_shared<AudioStreamHandler>();
   video_stream_handler_ = std::make_shared<VideoStreamHandler>();
+  device_stream_handler_ = std::make_shared<DeviceStreamHandler>();
 
   // Method channel
   auto method_channel = std::make_unique<flutter::MethodChannel<flutter::EncodableValue>>(
@@ -174,9 +233,50 @@ NativeCapturePlugin::NativeCapturePlugin(flutter::PluginRegistrarWindows* regist
               -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
             return video_stream_handler_->OnCancelInternal(arguments);
           }));
+
+  // Device change event channel
+  auto device_event_channel = std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+      registrar->messenger(), "com.moq_flutter/device_changes",
+      &flutter::StandardMethodCodec::GetInstance());
+  device_event_channel->SetStreamHandler(
+      std::make_unique<flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+          [this](const flutter::EncodableValue* arguments,
+                 std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            return device_stream_handler_->OnListenInternal(arguments, std::move(events));
+          },
+          [this](const flutter::EncodableValue* arguments)
+              -> std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> {
+            return device_stream_handler_->OnCancelInternal(arguments);
+          }));
+
+  // Before anything that answers from another thread
+  CreateTaskWindow();
+
+  // Build the device registry in the background and keep it current
+  RegisterDeviceNotifications();
+  StartDeviceRefresh();
+
+  // Capture start/stop runs on the control worker, never on this thread
+  control_worker_ = std::make_unique<CaptureControlWorker>();
+  audio_target_ = control_worker_->AddTarget([this] { return StartAudioAction(); },
+                                             [this] { return StopAudioAction(); });
+  video_target_ = control_worker_->AddTarget([this] { return StartVideoAction(); },
+                                             [this] { return StopVideoAction(); });
 }
 
 NativeCapturePlugin::~NativeCapturePlugin() {
+  // Lets a start or stop in progress finish; queued ones are cancelled
+  control_worker_.reset();
+
+  // Stop hot-plug handling before anything it touches goes away
+  if (camera_notification_) UnregisterDeviceNotification(camera_notification_);
+  if (audio_notification_) UnregisterDeviceNotification(audio_notification_);
+  device_refresh_again_ = false;
+  if (device_thread_ && device_thread_->joinable()) {
+    device_thread_->join();
+  }
+
   // Stop capture if running
   if (audio_capturing_) {
     audio_capturing_ = false;
@@ -190,8 +290,20 @@ NativeCapturePlugin::~NativeCapturePlugin() {
       video_thread_->join();
     }
   }
+  if (switch_thread_ && switch_thread_->joinable()) {
+    switch_thread_->join();
+  }
+
+  // Every thread that queues results is gone: answer what is still
+  // waiting here, as posted messages no longer reach the plugin
+  DrainPlatformTasks();
+  if (task_window_) DestroyWindow(task_window_);
+  if (window_proc_id_ >= 0) {
+    registrar_->UnregisterTopLevelWindowProcDelegate(window_proc_id_);
+  }
 
   TeardownAudioCapture();
+  DiscardPendingVideoSource();
   TeardownVideoCapture();
 
   if (mf_initialized_) {
@@ -236,6 +348,13 @@ void NativeCapturePlugin::HandleMethodCall(
     } else {
       result->Error("INVALID_ARGS", "Invalid arguments");
     }
+  } else if (method == "setFrameTransport") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (args) {
+      SetFrameTransport(*args, std::move(result));
+    } else {
+      result->Error("INVALID_ARGS", "Invalid arguments");
+    }
   } else if (method == "hasCameraPermission") {
     HasCameraPermission(std::move(result));
   } else if (method == "hasMicrophonePermission") {
@@ -252,53 +371,55 @@ void NativeCapturePlugin::HandleMethodCall(
 void NativeCapturePlugin::InitializeAudio(
     const flutter::EncodableMap& args,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  // Applied on the control worker, which is where capture reads it
+  control_worker_->Post([this, args] {
+    auto sample_rate_it = args.find(flutter::EncodableValue("sampleRate"));
+    if (sample_rate_it != args.end()) {
+      audio_sample_rate_ = std::get<int>(sample_rate_it->second);
+    }
 
-  auto sample_rate_it = args.find(flutter::EncodableValue("sampleRate"));
-  if (sample_rate_it != args.end()) {
-    audio_sample_rate_ = std::get<int>(sample_rate_it->second);
-  }
-
-  auto channels_it = args.find(flutter::EncodableValue("channels"));
-  if (channels_it != args.end()) {
-    audio_channels_ = std::get<int>(channels_it->second);
-  }
+    auto channels_it = args.find(flutter::EncodableValue("channels"));
+    if (channels_it != args.end()) {
+      audio_channels_ = std::get<int>(channels_it->second);
+    }
 
-  auto bits_it = args.find(flutter::EncodableValue("bitsPerSample"));
-  if (bits_it != args.end()) {
-    audio_bits_per_sample_ = std::get<int>(bits_it->second);
-  }
+    auto bits_it = args.find(flutter::EncodableValue("bitsPerSample"));
+    if (bits_it != args.end()) {
+      audio_bits_per_sample_ = std::get<int>(bits_it->second);
+    }
+  });
 
   result->Success();
 }
 
 void NativeCapturePlugin::StartAudioCapture(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  if (audio_capturing_) {
-    result->Success();
-    return;
-  }
+  RequestCapture(audio_target_, true, std::move(result),
+                 "AUDIO_ERROR", "Failed to setup audio capture");
+}
+
+void NativeCapturePlugin::StopAudioCapture(
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RequestCapture(audio_target_, false, std::move(result),
+                 "AUDIO_ERROR", "Failed to stop audio capture");
+}
 
+bool NativeCapturePlugin::StartAudioAction() {
   std::lock_guard<std::mutex> lock(audio_mutex_);
 
   if (!SetupAudioCapture()) {
-    result->Error("AUDIO_ERROR", "Failed to setup audio capture");
-    return;
+    TeardownAudioCapture();
+    return false;
   }
 
   audio_capturing_ = true;
   audio_start_timestamp_ = -1;
+  audio_sequence_ = 0;
   audio_thread_ = std::make_unique<std::thread>(&NativeCapturePlugin::AudioCaptureLoop, this);
-
-  result->Success();
+  return true;
 }
 
-void NativeCapturePlugin::StopAudioCapture(
-    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  if (!audio_capturing_) {
-    result->Success();
-    return;
-  }
-
+bool NativeCapturePlugin::StopAudioAction() {
   audio_capturing_ = false;
 
   if (audio_thread_ && audio_thread_->joinable()) {
@@ -310,162 +431,339 @@ void NativeCapturePlugin::StopAudioCapture(
     std::lock_guard<std::mutex> lock(audio_mutex_);
     TeardownAudioCapture();
   }
+  return true;
+}
 
-  result->Success();
+void NativeCapturePlugin::RequestCapture(
+    int target, bool running,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+    const std::string& error_code, const std::string& error_message) {
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> shared_result(
+      std::move(result));
+  control_worker_->Request(
+      target, running,
+      [this, shared_result, error_code, error_message](CaptureRequestStatus status,
+                                                        double elapsed_ms) {
+        RunOnPlatformThread([shared_result, status, elapsed_ms, error_code, error_message] {
+          if (status == CaptureRequestStatus::kFailed) {
+            shared_result->Error(error_code, error_message);
+          } else if (status == CaptureRequestStatus::kCancelled) {
+            shared_result->Error("CANCELLED", "Capture control shut down");
+          } else {
+            // A request overtaken by a later opposite one still succeeded
+            // from the caller's point of view
+            flutter::EncodableMap timing;
+            timing[flutter::EncodableValue("elapsedMs")] = flutter::EncodableValue(elapsed_ms);
+            timing[flutter::EncodableValue("superseded")] =
+                flutter::EncodableValue(status == CaptureRequestStatus::kSuperseded);
+            shared_result->Success(flutter::EncodableValue(timing));
+          }
+        });
+      });
 }
 
-void NativeCapturePlugin::InitializeVideo(
-    const flutter::EncodableMap& args,
-    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+void NativeCapturePlugin::RunOnPlatformThread(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+    platform_tasks_.push_back(std::move(task));
+  }
+  PostMessage(task_window_, kPlatformTaskMessage, 0, 0);
+}
 
-  auto width_it = args.find(flutter::EncodableValue("width"));
-  if (width_it != args.end()) {
-    video_width_ = std::get<int>(width_it->second);
+void NativeCapturePlugin::DrainPlatformTasks() {
+  std::vector<std::function<void()>> tasks;
+  {
+    std::lock_guard<std::mutex> lock(platform_tasks_mutex_);
+    tasks.swap(platform_tasks_);
   }
+  for (auto& task : tasks) task();
+}
 
-  auto height_it = args.find(flutter::EncodableValue("height"));
-  if (height_it != args.end()) {
-    video_height_ = std::get<int>(height_it->second);
+void NativeCapturePlugin::CreateTaskWindow() {
+  HINSTANCE instance = GetModuleHandle(nullptr);
+  WNDCLASSEXW window_class = {};
+  window_class.cbSize = sizeof(window_class);
+  window_class.lpfnWndProc = &NativeCapturePlugin::TaskWindowProc;
+  window_class.hInstance = instance;
+  window_class.lpszClassName = kTaskWindowClass;
+  // Fails once the class exists, which is fine
+  RegisterClassExW(&window_class);
+
+  // Created on the platform thread, so its messages are dispatched there
+  task_window_ = CreateWindowExW(0, kTaskWindowClass, L"", 0, 0, 0, 0, 0,
+                                 HWND_MESSAGE, nullptr, instance, nullptr);
+  if (task_window_) {
+    SetWindowLongPtr(task_window_, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
   }
+}
 
-  auto fps_it = args.find(flutter::EncodableValue("frameRate"));
-  if (fps_it != args.end()) {
-    video_frame_rate_ = std::get<int>(fps_it->second);
+LRESULT CALLBACK NativeCapturePlugin::TaskWindowProc(HWND hwnd, UINT message,
+                                                     WPARAM wparam, LPARAM lparam) {
+  if (message == kPlatformTaskMessage) {
+    auto* plugin =
+        reinterpret_cast<NativeCapturePlugin*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+    if (plugin) plugin->DrainPlatformTasks();
+    return 0;
   }
+  return DefWindowProc(hwnd, message, wparam, lparam);
+}
 
-  auto camera_it = args.find(flutter::EncodableValue("cameraId"));
-  if (camera_it != args.end()) {
-    const auto* camera_id = std::get_if<std::string>(&camera_it->second);
-    if (camera_id) {
-      selected_camera_id_ = *camera_id;
+void NativeCapturePlugin::InitializeVideo(
+    const flutter::EncodableMap& args,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  // Applied on the control worker, which is where capture reads it
+  control_worker_->Post([this, args] {
+    auto width_it = args.find(flutter::EncodableValue("width"));
+    if (width_it != args.end()) {
+      video_width_ = std::get<int>(width_it->second);
+    }
+
+    auto height_it = args.find(flutter::EncodableValue("height"));
+    if (height_it != args.end()) {
+      video_height_ = std::get<int>(height_it->second);
+    }
+
+    auto fps_it = args.find(flutter::EncodableValue("frameRate"));
+    if (fps_it != args.end()) {
+      video_frame_rate_ = std::get<int>(fps_it->second);
     }
-  }
+
+    auto camera_it = args.find(flutter::EncodableValue("cameraId"));
+    if (camera_it != args.end()) {
+      const auto* camera_id = std::get_if<std::string>(&camera_it->second);
+      if (camera_id) {
+        std::lock_guard<std::mutex> lock(switch_mutex_);
+        selected_camera_id_ = *camera_id;
+      }
+    }
+  });
 
   result->Success();
 }
 
 void NativeCapturePlugin::StartVideoCapture(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  if (video_capturing_) {
-    result->Success();
-    return;
-  }
+  // Opening a camera can take hundreds of milliseconds
+  RequestCapture(video_target_, true, std::move(result),
+                 "VIDEO_ERROR", "Failed to setup video capture");
+}
+
+void NativeCapturePlugin::StopVideoCapture(
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  RequestCapture(video_target_, false, std::move(result),
+                 "VIDEO_ERROR", "Failed to stop video capture");
+}
 
+bool NativeCapturePlugin::StartVideoAction() {
   std::lock_guard<std::mutex> lock(video_mutex_);
 
   if (!SetupVideoCapture()) {
-    result->Error("VIDEO_ERROR", "Failed to setup video capture");
-    return;
+    TeardownVideoCapture();
+    return false;
   }
 
   video_capturing_ = true;
   video_start_timestamp_ = -1;
+  video_last_timestamp_ms_ = -1;
+  video_sequence_ = 0;
   video_thread_ = std::make_unique<std::thread>(&NativeCapturePlugin::VideoCaptureLoop, this);
-
-  result->Success();
+  return true;
 }
 
-void NativeCapturePlugin::StopVideoCapture(
-    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  if (!video_capturing_) {
-    result->Success();
-    return;
-  }
-
+bool NativeCapturePlugin::StopVideoAction() {
   video_capturing_ = false;
 
   if (video_thread_ && video_thread_->joinable()) {
     video_thread_->join();
     video_thread_.reset();
   }
+  // A switch still warming up gives up once capture stops
+  if (switch_thread_ && switch_thread_->joinable()) {
+    switch_thread_->join();
+    switch_thread_.reset();
+  }
 
   {
     std::lock_guard<std::mutex> lock(video_mutex_);
+    DiscardPendingVideoSource();
     TeardownVideoCapture();
   }
-
-  result->Success();
+  return true;
 }
 
 void NativeCapturePlugin::GetAvailableCameras(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  auto cameras = EnumerateCameras();
-
-  flutter::EncodableList camera_list;
-  for (const auto& camera : cameras) {
-    flutter::EncodableMap camera_map;
-    camera_map[flutter::EncodableValue("id")] = flutter::EncodableValue(camera.id);
-    camera_map[flutter::EncodableValue("name")] = flutter::EncodableValue(camera.name);
-    camera_map[flutter::EncodableValue("position")] = flutter::EncodableValue(camera.position);
-    camera_list.push_back(flutter::EncodableValue(camera_map));
-  }
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> shared_result(
+      std::move(result));
+  WhenDevicesReady([this, shared_result] {
+    auto cameras = CachedCameras();
+
+    flutter::EncodableList camera_list;
+    for (const auto& camera : cameras) {
+      flutter::EncodableMap camera_map;
+      camera_map[flutter::EncodableValue("id")] = flutter::EncodableValue(camera.id);
+      camera_map[flutter::EncodableValue("name")] = flutter::EncodableValue(camera.name);
+      camera_map[flutter::EncodableValue("position")] = flutter::EncodableValue(camera.position);
+      camera_list.push_back(flutter::EncodableValue(camera_map));
+    }
 
-  result->Success(flutter::EncodableValue(camera_list));
+    shared_result->Success(flutter::EncodableValue(camera_list));
+  });
 }
 
 void NativeCapturePlugin::SelectCamera(
     const flutter::EncodableMap& args,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
   auto camera_it = args.find(flutter::EncodableValue("cameraId"));
-  if (camera_it != args.end()) {
-    const auto* camera_id = std::get_if<std::string>(&camera_it->second);
-    if (camera_id) {
-      selected_camera_id_ = *camera_id;
-
-      // If currently capturing, restart with new camera
-      if (video_capturing_) {
-        video_capturing_ = false;
-        if (video_thread_ && video_thread_->joinable()) {
-          video_thread_->join();
-          video_thread_.reset();
-        }
+  if (camera_it == args.end()) {
+    result->Success();
+    return;
+  }
+  const auto* camera_id = std::get_if<std::string>(&camera_it->second);
+  if (!camera_id) {
+    result->Success();
+    return;
+  }
 
-        {
-          std::lock_guard<std::mutex> lock(video_mutex_);
-          TeardownVideoCapture();
-          if (!SetupVideoCapture()) {
-            result->Error("CAMERA_ERROR", "Failed to switch camera");
-            return;
-          }
-        }
+  // Ordered with start and stop on the control worker, so a switch never
+  // races a capture being opened or torn down
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> shared_result(
+      std::move(result));
+  control_worker_->Post([this, id = *camera_id, shared_result] {
+    if (switch_running_) {
+      RunOnPlatformThread([shared_result] {
+        shared_result->Error("CAMERA_BUSY", "A camera switch is already in progress");
+      });
+      return;
+    }
 
-        video_capturing_ = true;
-        video_thread_ = std::make_unique<std::thread>(&NativeCapturePlugin::VideoCaptureLoop, this);
+    // Not capturing: the camera is opened by the next StartVideoCapture
+    if (!video_capturing_) {
+      {
+        std::lock_guard<std::mutex> lock(switch_mutex_);
+        selected_camera_id_ = id;
       }
+      RunOnPlatformThread([shared_result] { shared_result->Success(); });
+      return;
+    }
+
+    // Make before break: the current camera keeps capturing while the new
+    // one is opened and warmed up on the switch thread. The result is
+    // answered, and the camera selected, once it has delivered a frame.
+    if (switch_thread_ && switch_thread_->joinable()) {
+      switch_thread_->join();
     }
+    switch_result_ = shared_result;
+    switch_running_ = true;
+    VideoConfig config{video_width_, video_height_, video_frame_rate_};
+    switch_thread_ = std::make_unique<std::thread>(&NativeCapturePlugin::CameraSwitchLoop,
+                                                   this, id, config);
+  });
+}
+
+void NativeCapturePlugin::CameraSwitchLoop(std::string device_id, VideoConfig config) {
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  auto pending = std::make_unique<PendingVideoSource>();
+  // Cameras take a while from open to first frame; that wait happens here,
+  // not in the capture loop
+  CameraSwitchStatus status = WarmUpCamera(
+      [&] {
+        return OpenVideoReader(device_id, config, pending->source, pending->reader,
+                               pending->mjpeg);
+      },
+      [&](bool& got_frame) {
+        DWORD streamFlags = 0;
+        HRESULT hr = pending->reader->ReadSample(
+            static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
+            0,
+            nullptr,
+            &streamFlags,
+            &pending->first_timestamp,
+            &pending->first_sample);
+        if (FAILED(hr) || (streamFlags & MF_SOURCE_READERF_ENDOFSTREAM)) return false;
+        got_frame = pending->first_sample != nullptr;
+        return true;
+      },
+      [this] { return video_capturing_.load(); });
+
+  {
+    std::lock_guard<std::mutex> lock(switch_mutex_);
+    // Stopped during the warm-up: the next start opens the new camera
+    if (status != CameraSwitchStatus::kFailed) selected_camera_id_ = device_id;
+    if (status == CameraSwitchStatus::kOk) pending_video_ = std::move(pending);
+  }
+  if (pending && pending->source) pending->source->Shutdown();
+
+  auto result = std::move(switch_result_);
+  switch_running_ = false;
+  if (result) {
+    RunOnPlatformThread([result, status] {
+      if (status == CameraSwitchStatus::kFailed) {
+        result->Error("CAMERA_ERROR", "Failed to switch camera");
+      } else {
+        result->Success();
+      }
+    });
   }
 
-  result->Success();
+  CoUninitialize();
+}
+
+void NativeCapturePlugin::DiscardPendingVideoSource() {
+  std::unique_ptr<PendingVideoSource> pending;
+  {
+    std::lock_guard<std::mutex> lock(switch_mutex_);
+    pending = std::move(pending_video_);
+  }
+  if (pending && pending->source) {
+    pending->source->Shutdown();
+  }
+}
+
+void NativeCapturePlugin::SetFrameTransport(
+    const flutter::EncodableMap& args,
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
+  auto binary_it = args.find(flutter::EncodableValue("binary"));
+  if (binary_it != args.end()) {
+    const auto* binary = std::get_if<bool>(&binary_it->second);
+    if (binary) binary_frames_ = *binary;
+  }
+  result->Success(flutter::EncodableValue(binary_frames_.load()));
 }
 
 // Windows doesn't require explicit permission requests like macOS/iOS
 void NativeCapturePlugin::HasCameraPermission(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  // On Windows, we just check if we can enumerate video devices
-  auto cameras = EnumerateCameras();
-  result->Success(flutter::EncodableValue(!cameras.empty()));
+  // On Windows, we just check if there is a video device
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> shared_result(
+      std::move(result));
+  WhenDevicesReady([this, shared_result] {
+    shared_result->Success(flutter::EncodableValue(!CachedCameras().empty()));
+  });
 }
 
 void NativeCapturePlugin::HasMicrophonePermission(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
-  // On Windows, check if we can find an audio device
-  auto device = FindAudioDevice();
-  result->Success(flutter::EncodableValue(device != nullptr));
+  // On Windows, check if there is an audio device
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> shared_result(
+      std::move(result));
+  WhenDevicesReady([this, shared_result] {
+    shared_result->Success(flutter::EncodableValue(!CachedAudioEndpoint().empty()));
+  });
 }
 
 void NativeCapturePlugin::RequestCameraPermission(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
   // Windows doesn't have a permission dialog like macOS/iOS
   // The permission is implicitly granted when the app accesses the camera
-  auto cameras = EnumerateCameras();
-  result->Success(flutter::EncodableValue(!cameras.empty()));
+  HasCameraPermission(std::move(result));
 }
 
 void NativeCapturePlugin::RequestMicrophonePermission(
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
   // Windows doesn't have a permission dialog like macOS/iOS
-  auto device = FindAudioDevice();
-  result->Success(flutter::EncodableValue(device != nullptr));
+  HasMicrophonePermission(std::move(result));
 }
 
 bool NativeCapturePlugin::SetupAudioCapture() {
@@ -473,13 +771,9 @@ bool NativeCapturePlugin::SetupAudioCapture() {
 
   HRESULT hr;
 
-  // Find audio device
-  auto activate = FindAudioDevice();
-  if (!activate) return false;
-
-  // Activate the media source
-  hr = activate->ActivateObject(IID_PPV_ARGS(&audio_source_));
-  if (FAILED(hr)) return false;
+  // Open the cached audio device
+  audio_source_ = CreateAudioSource();
+  if (!audio_source_) return false;
 
   // Create source reader
   ComPtr<IMFAttributes> attributes;
@@ -533,26 +827,48 @@ void NativeCapturePlugin::TeardownAudioCapture() {
 }
 
 bool NativeCapturePlugin::SetupVideoCapture() {
+  // Open the selected camera without enumerating devices again
+  VideoConfig config{video_width_, video_height_, video_frame_rate_};
+  std::string device_id;
+  {
+    std::lock_guard<std::mutex> lock(switch_mutex_);
+    device_id = selected_camera_id_;
+  }
+  return OpenVideoReader(device_id, config, video_source_, video_reader_, video_mjpeg_);
+}
+
+bool NativeCapturePlugin::OpenVideoReader(const std::string& device_id,
+                                          const VideoConfig& config,
+                                          ComPtr<IMFMediaSource>& source,
+                                          ComPtr<IMFSourceReader>& reader,
+                                          bool& mjpeg) {
   if (!mf_initialized_) return false;
 
   HRESULT hr;
 
-  // Find video device
-  auto activate = FindVideoDevice(selected_camera_id_);
-  if (!activate) return false;
-
-  // Activate the media source
-  hr = activate->ActivateObject(IID_PPV_ARGS(&video_source_));
-  if (FAILED(hr)) return false;
+  source = CreateVideoSource(device_id);
+  if (!source) return false;
 
   // Create source reader
   ComPtr<IMFAttributes> attributes;
   hr = MFCreateAttributes(&attributes, 1);
   if (FAILED(hr)) return false;
 
-  hr = MFCreateSourceReaderFromMediaSource(video_source_.Get(), attributes.Get(), &video_reader_);
+  hr = MFCreateSourceReaderFromMediaSource(source.Get(), attributes.Get(), &reader);
   if (FAILED(hr)) return false;
 
+  // Take the camera's MJPEG as-is when only the compressed mode reaches the
+  // frame rate; Dart decodes it with the native libjpeg-turbo worker
+  mjpeg = false;
+  if (auto mjpegType = FindMjpegNativeType(reader.Get(), config)) {
+    hr = reader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
+                                     nullptr, mjpegType.Get());
+    if (SUCCEEDED(hr)) {
+      mjpeg = true;
+      return true;
+    }
+  }
+
   // Configure output format (RGB32/BGRA)
   ComPtr<IMFMediaType> outputType;
   hr = MFCreateMediaType(&outputType);
@@ -565,19 +881,63 @@ bool NativeCapturePlugin::SetupVideoCapture() {
   hr = outputType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_RGB32);
   if (FAILED(hr)) return false;
 
-  hr = MFSetAttributeSize(outputType.Get(), MF_MT_FRAME_SIZE, video_width_, video_height_);
+  hr = MFSetAttributeSize(outputType.Get(), MF_MT_FRAME_SIZE, config.width, config.height);
   if (FAILED(hr)) return false;
 
-  hr = MFSetAttributeRatio(outputType.Get(), MF_MT_FRAME_RATE, video_frame_rate_, 1);
+  hr = MFSetAttributeRatio(outputType.Get(), MF_MT_FRAME_RATE, config.frame_rate, 1);
   if (FAILED(hr)) return false;
 
-  hr = video_reader_->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
-                                           nullptr, outputType.Get());
+  hr = reader->SetCurrentMediaType(static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM),
+                                   nullptr, outputType.Get());
   if (FAILED(hr)) return false;
 
   return true;
 }
 
+ComPtr<IMFMediaType> NativeCapturePlugin::FindMjpegNativeType(IMFSourceReader* reader,
+                                                              const VideoConfig& config) {
+  // Rates within this margin count as reaching the target (29.97 vs 30)
+  const double tolerance = 0.5;
+  double bestRawRate = 0.0;
+  double bestMjpegRate = 0.0;
+  ComPtr<IMFMediaType> bestMjpeg;
+
+  for (DWORD i = 0;; i++) {
+    ComPtr<IMFMediaType> type;
+    HRESULT hr = reader->GetNativeMediaType(
+        static_cast<DWORD>(MF_SOURCE_READER_FIRST_VIDEO_STREAM), i, &type);
+    if (FAILED(hr)) break;  // MF_E_NO_MORE_TYPES
+
+    GUID subtype = GUID_NULL;
+    UINT32 width = 0, height = 0, rateNum = 0, rateDen = 0;
+    if (FAILED(type->GetGUID(MF_MT_SUBTYPE, &subtype)) ||
+        FAILED(MFGetAttributeSize(type.Get(), MF_MT_FRAME_SIZE, &width, &height)) ||
+        FAILED(MFGetAttributeRatio(type.Get(), MF_MT_FRAME_RATE, &rateNum, &rateDen)) ||
+        rateDen == 0) {
+      continue;
+    }
+    if (static_cast<int>(width) != config.width || static_cast<int>(height) != config.height) {
+      continue;
+    }
+
+    double rate = static_cast<double>(rateNum) / rateDen;
+    if (subtype == MFVideoFormat_MJPG) {
+      if (rate > bestMjpegRate) {
+        bestMjpegRate = rate;
+        bestMjpeg = type;
+      }
+    } else if (subtype == MFVideoFormat_YUY2 || subtype == MFVideoFormat_NV12 ||
+               subtype == MFVideoFormat_RGB24 || subtype == MFVideoFormat_RGB32) {
+      if (rate > bestRawRate) bestRawRate = rate;
+    }
+  }
+
+  // Raw modes need no decode, so they win whenever they reach the rate
+  if (bestRawRate >= config.frame_rate - tolerance) return nullptr;
+  if (bestMjpegRate <= bestRawRate) return nullptr;
+  return bestMjpeg;
+}
+
 void NativeCapturePlugin::TeardownVideoCapture() {
   video_reader_.Reset();
   if (video_source_) {
@@ -628,7 +988,20 @@ void NativeCapturePlugin::AudioCaptureLoop() {
         DWORD length = 0;
 
         hr = buffer->Lock(&data, nullptr, &length);
-        if (SUCCEEDED(hr)) {
+        if (SUCCEEDED(hr) && binary_frames_) {
+          // One copy into the packet, no per-frame map or codec pass
+          FramePacketHeader header;
+          header.kind = FramePacketKind::kAudio;
+          header.format = FramePacketFormat::kPcm;
+          header.width = static_cast<uint32_t>(audio_sample_rate_);
+          header.height = static_cast<uint32_t>(audio_channels_);
+          header.stride = static_cast<uint32_t>(audio_bits_per_sample_);
+          header.timestamp_ms = relativeTimestamp;
+          header.sequence = audio_sequence_++;
+          BuildFramePacket(header, data, length, audio_packet_);
+          buffer->Unlock();
+          messenger_->Send(kAudioPacketChannel, audio_packet_.data(), audio_packet_.size());
+        } else if (SUCCEEDED(hr)) {
           std::vector<uint8_t> audioData(data, data + length);
           buffer->Unlock();
 
@@ -649,6 +1022,35 @@ void NativeCapturePlugin::VideoCaptureLoop() {
   CoInitializeEx(nullptr, COINIT_MULTITHREADED);
 
   while (video_capturing_) {
+    // Cut over to a switched-to camera between two frames
+    std::unique_ptr<PendingVideoSource> pending;
+    {
+      std::lock_guard<std::mutex> lock(switch_mutex_);
+      pending = std::move(pending_video_);
+    }
+    if (pending) {
+      ComPtr<IMFMediaSource> old_source;
+      {
+        std::lock_guard<std::mutex> lock(video_mutex_);
+        old_source = std::move(video_source_);
+        video_source_ = std::move(pending->source);
+        video_reader_ = std::move(pending->reader);
+        video_mjpeg_ = pending->mjpeg;
+      }
+      if (old_source) old_source->Shutdown();
+
+      // The new camera has its own clock: continue one frame after the
+      // last timestamp sent so the encoder's timeline has no jump
+      if (video_last_timestamp_ms_ >= 0) {
+        int64_t next_ms = video_last_timestamp_ms_ + 1000 / std::max(video_frame_rate_, 1);
+        video_start_timestamp_ = pending->first_timestamp - next_ms * 10000;
+      } else {
+        video_start_timestamp_ = -1;
+      }
+      SendVideoSample(pending->first_sample.Get(), pending->first_timestamp);
+      continue;
+    }
+
     ComPtr<IMFSample> sample;
     DWORD streamFlags = 0;
     LONGLONG timestamp = 0;
@@ -672,38 +1074,64 @@ void NativeCapturePlugin::VideoCaptureLoop() {
     }
 
     if (sample) {
-      // Calculate relative timestamp
-      if (video_start_timestamp_ < 0) {
-        video_start_timestamp_ = timestamp;
-      }
-      int64_t relativeTimestamp = (timestamp - video_start_timestamp_) / 10000; // Convert to ms
-
-      // Get buffer from sample
-      ComPtr<IMFMediaBuffer> buffer;
-      hr = sample->ConvertToContiguousBuffer(&buffer);
-      if (SUCCEEDED(hr)) {
-        BYTE* data = nullptr;
-        DWORD length = 0;
-
-        hr = buffer->Lock(&data, nullptr, &length);
-        if (SUCCEEDED(hr)) {
-          std::vector<uint8_t> videoData(data, data + length);
-          buffer->Unlock();
-
-          int bytesPerRow = video_width_ * 4; // BGRA = 4 bytes per pixel
-
-          // Send to Flutter
-          video_stream_handler_->SendVideoFrame(
-              videoData, video_width_, video_height_,
-              "bgra", bytesPerRow, relativeTimestamp);
-        }
-      }
+      SendVideoSample(sample.Get(), timestamp);
     }
   }
 
   CoUninitialize();
 }
 
+void NativeCapturePlugin::SendVideoSample(IMFSample* sample, LONGLONG timestamp) {
+  // Calculate relative timestamp
+  if (video_start_timestamp_ < 0) {
+    video_start_timestamp_ = timestamp;
+  }
+  int64_t relativeTimestamp = (timestamp - video_start_timestamp_) / 10000; // Convert to ms
+  // Never go backwards, whatever the camera's clock does
+  if (relativeTimestamp <= video_last_timestamp_ms_) {
+    relativeTimestamp = video_last_timestamp_ms_ + 1;
+  }
+  video_last_timestamp_ms_ = relativeTimestamp;
+
+  // Get buffer from sample
+  ComPtr<IMFMediaBuffer> buffer;
+  HRESULT hr = sample->ConvertToContiguousBuffer(&buffer);
+  if (FAILED(hr)) return;
+
+  BYTE* data = nullptr;
+  DWORD length = 0;
+
+  hr = buffer->Lock(&data, nullptr, &length);
+  if (FAILED(hr)) return;
+
+  // MJPEG frames are whole JPEGs, decoded to I420 on the Dart side
+  int bytesPerRow = video_mjpeg_ ? 0 : video_width_ * 4; // BGRA = 4 bytes per pixel
+
+  if (binary_frames_) {
+    // One copy into the packet, no per-frame map or codec pass
+    FramePacketHeader header;
+    header.kind = FramePacketKind::kVideo;
+    header.format = video_mjpeg_ ? FramePacketFormat::kMjpeg : FramePacketFormat::kBgra;
+    header.width = static_cast<uint32_t>(video_width_);
+    header.height = static_cast<uint32_t>(video_height_);
+    header.stride = static_cast<uint32_t>(bytesPerRow);
+    header.timestamp_ms = relativeTimestamp;
+    header.sequence = video_sequence_++;
+    BuildFramePacket(header, data, length, video_packet_);
+    buffer->Unlock();
+    messenger_->Send(kVideoPacketChannel, video_packet_.data(), video_packet_.size());
+    return;
+  }
+
+  std::vector<uint8_t> videoData(data, data + length);
+  buffer->Unlock();
+
+  // Send to Flutter
+  video_stream_handler_->SendVideoFrame(
+      videoData, video_width_, video_height_,
+      video_mjpeg_ ? "mjpeg" : "bgra", bytesPerRow, relativeTimestamp);
+}
+
 std::vector<CameraInfo> NativeCapturePlugin::EnumerateCameras() {
   std::vector<CameraInfo> cameras;
 
@@ -769,91 +1197,247 @@ std::vector<CameraInfo> NativeCapturePlugin::EnumerateCameras() {
   return cameras;
 }
 
-ComPtr<IMFActivate> NativeCapturePlugin::FindAudioDevice() {
-  if (!mf_initialized_) return nullptr;
+std::wstring NativeCapturePlugin::EnumerateAudioEndpoint() {
+  if (!mf_initialized_) return std::wstring();
 
   ComPtr<IMFAttributes> attributes;
   HRESULT hr = MFCreateAttributes(&attributes, 1);
-  if (FAILED(hr)) return nullptr;
+  if (FAILED(hr)) return std::wstring();
 
   hr = attributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
                            MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_GUID);
-  if (FAILED(hr)) return nullptr;
+  if (FAILED(hr)) return std::wstring();
 
   IMFActivate** devices = nullptr;
   UINT32 deviceCount = 0;
 
   hr = MFEnumDeviceSources(attributes.Get(), &devices, &deviceCount);
-  if (FAILED(hr) || deviceCount == 0) return nullptr;
-
-  ComPtr<IMFActivate> result;
-  result.Attach(devices[0]);
+  if (FAILED(hr)) return std::wstring();
+
+  // First device, as before
+  std::wstring endpoint;
+  if (deviceCount > 0) {
+    WCHAR* endpointId = nullptr;
+    UINT32 endpointIdLength = 0;
+    hr = devices[0]->GetAllocatedString(
+        MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_ENDPOINT_ID,
+        &endpointId, &endpointIdLength);
+    if (SUCCEEDED(hr)) {
+      endpoint = endpointId;
+      CoTaskMemFree(endpointId);
+    }
+  }
 
-  // Release other devices
-  for (UINT32 i = 1; i < deviceCount; i++) {
+  for (UINT32 i = 0; i < deviceCount; i++) {
     devices[i]->Release();
   }
   CoTaskMemFree(devices);
+  return endpoint;
+}
 
-  return result;
+void NativeCapturePlugin::StartDeviceRefresh() {
+  // A rescan already running picks the request up when it finishes
+  device_refresh_again_ = true;
+  if (device_refresh_running_.exchange(true)) return;
+
+  if (device_thread_ && device_thread_->joinable()) {
+    device_thread_->join();
+  }
+  device_thread_ = std::make_unique<std::thread>(&NativeCapturePlugin::DeviceRefreshLoop, this);
+}
+
+void NativeCapturePlugin::DeviceRefreshLoop() {
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+  std::vector<std::function<void()>> waiters;
+  while (device_refresh_again_.exchange(false)) {
+    auto cameras = EnumerateCameras();
+    auto audio_endpoint = EnumerateAudioEndpoint();
+
+    bool changed = false;
+    {
+      std::lock_guard<std::mutex> lock(devices_mutex_);
+      auto contains = [](const std::vector<CameraInfo>& list, const std::string& id) {
+        return std::any_of(list.begin(), list.end(),
+                           [&id](const CameraInfo& camera) { return camera.id == id; });
+      };
+      // The first scan builds the registry; it isn't a change
+      if (devices_ready_) {
+        for (const auto& camera : cameras) {
+          if (!contains(cameras_, camera.id)) pending_added_.push_back(camera.id);
+        }
+        for (const auto& camera : cameras_) {
+          if (!contains(cameras, camera.id)) pending_removed_.push_back(camera.id);
+        }
+        if (audio_endpoint != audio_endpoint_id_) pending_microphone_change_ = true;
+        changed = !pending_added_.empty() || !pending_removed_.empty() ||
+                  pending_microphone_change_;
+      }
+      cameras_ = std::move(cameras);
+      audio_endpoint_id_ = std::move(audio_endpoint);
+      devices_ready_ = true;
+      waiters.swap(devices_waiters_);
+    }
+    devices_ready_cv_.notify_all();
+    for (auto& waiter : waiters) RunOnPlatformThread(std::move(waiter));
+    waiters.clear();
+
+    if (changed && device_window_) {
+      PostMessage(device_window_, kDevicesChangedMessage, 0, 0);
+    }
+  }
+
+  device_refresh_running_ = false;
+  // A request that raced the exit above found the thread still running;
+  // have the platform thread start another one
+  if (device_refresh_again_ && device_window_) {
+    PostMessage(device_window_, kDevicesChangedMessage, 1, 0);
+  }
+
+  CoUninitialize();
+}
+
+std::vector<CameraInfo> NativeCapturePlugin::CachedCameras() {
+  std::unique_lock<std::mutex> lock(devices_mutex_);
+  devices_ready_cv_.wait(lock, [this] { return devices_ready_ || !mf_initialized_; });
+  return cameras_;
+}
+
+std::wstring NativeCapturePlugin::CachedAudioEndpoint() {
+  std::unique_lock<std::mutex> lock(devices_mutex_);
+  devices_ready_cv_.wait(lock, [this] { return devices_ready_ || !mf_initialized_; });
+  return audio_endpoint_id_;
+}
+
+void NativeCapturePlugin::WhenDevicesReady(std::function<void()> reply) {
+  {
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    if (!devices_ready_ && mf_initialized_) {
+      // Answered by the scan thread through the task window
+      devices_waiters_.push_back(std::move(reply));
+      return;
+    }
+  }
+  reply();
+}
+
+void NativeCapturePlugin::RegisterDeviceNotifications() {
+  auto* view = registrar_->GetView();
+  if (!view) return;
+  device_window_ = GetAncestor(view->GetNativeWindow(), GA_ROOT);
+  if (!device_window_) return;
+
+  window_proc_id_ = registrar_->RegisterTopLevelWindowProcDelegate(
+      [this](HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+        return HandleWindowMessage(hwnd, message, wparam, lparam);
+      });
+
+  DEV_BROADCAST_DEVICEINTERFACE_W filter = {};
+  filter.dbcc_size = sizeof(filter);
+  filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+  filter.dbcc_classguid = KSCATEGORY_VIDEO_CAMERA;
+  camera_notification_ = RegisterDeviceNotificationW(device_window_, &filter,
+                                                     DEVICE_NOTIFY_WINDOW_HANDLE);
+  filter.dbcc_classguid = KSCATEGORY_AUDIO;
+  audio_notification_ = RegisterDeviceNotificationW(device_window_, &filter,
+                                                    DEVICE_NOTIFY_WINDOW_HANDLE);
+}
+
+std::optional<LRESULT> NativeCapturePlugin::HandleWindowMessage(
+    HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam) {
+  if (message == WM_DEVICECHANGE &&
+      (wparam == DBT_DEVICEARRIVAL || wparam == DBT_DEVICEREMOVECOMPLETE)) {
+    auto* header = reinterpret_cast<DEV_BROADCAST_HDR*>(lparam);
+    if (header && header->dbch_devicetype == DBT_DEVTYP_DEVICEINTERFACE) {
+      StartDeviceRefresh();
+    }
+  } else if (message == kDevicesChangedMessage) {
+    if (wparam == 1) {
+      StartDeviceRefresh();
+    } else {
+      PublishDeviceChanges();
+    }
+    return 0;
+  }
+  return std::nullopt;
+}
+
+void NativeCapturePlugin::PublishDeviceChanges() {
+  std::vector<CameraInfo> cameras;
+  std::vector<std::string> added;
+  std::vector<std::string> removed;
+  bool has_microphone;
+  {
+    std::lock_guard<std::mutex> lock(devices_mutex_);
+    if (pending_added_.empty() && pending_removed_.empty() &&
+        !pending_microphone_change_) {
+      return;
+    }
+    cameras = cameras_;
+    added.swap(pending_added_);
+    removed.swap(pending_removed_);
+    pending_microphone_change_ = false;
+    has_microphone = !audio_endpoint_id_.empty();
+  }
+  device_stream_handler_->SendDeviceChange(cameras, added, removed, has_microphone);
 }
 
-ComPtr<IMFActivate> NativeCapturePlugin::FindVideoDevice(const std::string& device_id) {
+ComPtr<IMFMediaSource> NativeCapturePlugin::CreateAudioSource() {
   if (!mf_initialized_) return nullptr;
 
+  auto endpoint = CachedAudioEndpoint();
+  if (endpoint.empty()) return nullptr;
+
   ComPtr<IMFAttributes> attributes;
-  HRESULT hr = MFCreateAttributes(&attributes, 1);
+  HRESULT hr = MFCreateAttributes(&attributes, 2);
   if (FAILED(hr)) return nullptr;
 
   hr = attributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
-                           MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
+                           MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_GUID);
   if (FAILED(hr)) return nullptr;
 
-  IMFActivate** devices = nullptr;
-  UINT32 deviceCount = 0;
+  hr = attributes->SetString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_AUDCAP_ENDPOINT_ID,
+                             endpoint.c_str());
+  if (FAILED(hr)) return nullptr;
 
-  hr = MFEnumDeviceSources(attributes.Get(), &devices, &deviceCount);
-  if (FAILED(hr) || deviceCount == 0) return nullptr;
+  ComPtr<IMFMediaSource> source;
+  hr = MFCreateDeviceSource(attributes.Get(), &source);
+  if (FAILED(hr)) return nullptr;
 
-  ComPtr<IMFActivate> result;
+  return source;
+}
 
-  if (device_id.empty()) {
-    // Use first device
-    result.Attach(devices[0]);
-    for (UINT32 i = 1; i < deviceCount; i++) {
-      devices[i]->Release();
+ComPtr<IMFMediaSource> NativeCapturePlugin::CreateVideoSource(const std::string& device_id) {
+  if (!mf_initialized_) return nullptr;
+
+  // Requested camera, or the first one when it is unset or gone
+  auto cameras = CachedCameras();
+  if (cameras.empty()) return nullptr;
+  std::string id = cameras.front().id;
+  for (const auto& camera : cameras) {
+    if (camera.id == device_id) {
+      id = camera.id;
+      break;
     }
-  } else {
-    // Find specific device by ID
-    for (UINT32 i = 0; i < deviceCount; i++) {
-      WCHAR* symbolicLink = nullptr;
-      UINT32 symbolicLinkLength = 0;
-      hr = devices[i]->GetAllocatedString(
-          MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK,
-          &symbolicLink, &symbolicLinkLength);
+  }
 
-      if (SUCCEEDED(hr)) {
-        std::string currentId = WideToUtf8(symbolicLink);
-        CoTaskMemFree(symbolicLink);
+  ComPtr<IMFAttributes> attributes;
+  HRESULT hr = MFCreateAttributes(&attributes, 2);
+  if (FAILED(hr)) return nullptr;
 
-        if (currentId == device_id) {
-          result.Attach(devices[i]);
-        } else {
-          devices[i]->Release();
-        }
-      } else {
-        devices[i]->Release();
-      }
-    }
+  hr = attributes->SetGUID(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE,
+                           MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_GUID);
+  if (FAILED(hr)) return nullptr;
 
-    // If not found, use first device
-    if (!result && deviceCount > 0) {
-      result.Attach(devices[0]);
-    }
-  }
+  hr = attributes->SetString(MF_DEVSOURCE_ATTRIBUTE_SOURCE_TYPE_VIDCAP_SYMBOLIC_LINK,
+                             Utf8ToWide(id).c_str());
+  if (FAILED(hr)) return nullptr;
 
-  CoTaskMemFree(devices);
-  return result;
+  ComPtr<IMFMediaSource> source;
+  hr = MFCreateDeviceSource(attributes.Get(), &source);
+  if (FAILED(hr)) return nullptr;
+
+  return source;
 }
 
 }  // namespace moq_flutter
@@ -25,6 +25,12 @@
 #include <functional>
 #include <algorithm>
 #include <cctype>
+#include <condition_variable>
+#include <optional>
+
+#include "camera_switch.h"
+#include "capture_control_worker.h"
+#include "frame_packet.h"
 
 namespace moq_flutter {
 
@@ -82,6 +88,29 @@ class VideoStreamHandler : public flutter::StreamHandler<flutter::EncodableValue
   std::mutex event_sink_mutex_;
 };
 
+// Device change stream handler for event channel
+class DeviceStreamHandler : public flutter::StreamHandler<flutter::EncodableValue> {
+ public:
+  DeviceStreamHandler() = default;
+  virtual ~DeviceStreamHandler() = default;
+
+  std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnListenInternal(
+      const flutter::EncodableValue* arguments,
+      std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&& events) override;
+
+  std::unique_ptr<flutter::StreamHandlerError<flutter::EncodableValue>> OnCancelInternal(
+      const flutter::EncodableValue* arguments) override;
+
+  void SendDeviceChange(const std::vector<CameraInfo>& cameras,
+                        const std::vector<std::string>& added,
+                        const std::vector<std::string>& removed,
+                        bool has_microphone);
+
+ private:
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> event_sink_;
+  std::mutex event_sink_mutex_;
+};
+
 // Main plugin class
 class NativeCapturePlugin : public flutter::Plugin {
  public:
@@ -115,30 +144,155 @@ class NativeCapturePlugin : public flutter::Plugin {
   void SelectCamera(const flutter::EncodableMap& args,
                     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  // Send frames as packed binary messages instead of EncodableMap events
+  void SetFrameTransport(const flutter::EncodableMap& args,
+                         std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
+
   // Permission methods (Windows doesn't require explicit permissions like macOS/iOS)
   void HasCameraPermission(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void HasMicrophonePermission(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void RequestCameraPermission(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
   void RequestMicrophonePermission(std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  // Requested video format, owned by the control worker
+  struct VideoConfig {
+    int width;
+    int height;
+    int frame_rate;
+  };
+
   // Internal capture methods
   bool SetupAudioCapture();
   void TeardownAudioCapture();
   bool SetupVideoCapture();
   void TeardownVideoCapture();
+  // Open a camera and configure its reader, without touching capture state
+  bool OpenVideoReader(const std::string& device_id, const VideoConfig& config,
+                       ComPtr<IMFMediaSource>& source,
+                       ComPtr<IMFSourceReader>& reader, bool& mjpeg);
+  // Native MJPEG type to capture in, or null when a raw type reaches the rate
+  ComPtr<IMFMediaType> FindMjpegNativeType(IMFSourceReader* reader,
+                                           const VideoConfig& config);
+
+  // Camera switching: the new camera is opened and warmed up on its own
+  // thread while the old one keeps capturing, then the capture loop cuts
+  // over between two frames. The format is snapshotted by the control
+  // worker, which may change it meanwhile. A capture stopped during the
+  // warm-up is not a failure: the switch is answered with success and the
+  // new camera is opened by the next start.
+  void CameraSwitchLoop(std::string device_id, VideoConfig config);
+  void DiscardPendingVideoSource();
+
+  // Capture lifecycle, run by the control worker
+  bool StartAudioAction();
+  bool StopAudioAction();
+  bool StartVideoAction();
+  bool StopVideoAction();
+  // Queue a start or stop and answer `result` when the worker is done
+  void RequestCapture(int target, bool running,
+                      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+                      const std::string& error_code, const std::string& error_message);
+
+  // Run `task` on the platform thread (method results must be answered
+  // there), through a message-only window of the plugin's own so it works
+  // without a view too
+  void RunOnPlatformThread(std::function<void()> task);
+  void DrainPlatformTasks();
+  void CreateTaskWindow();
+  static LRESULT CALLBACK TaskWindowProc(HWND hwnd, UINT message,
+                                         WPARAM wparam, LPARAM lparam);
 
   // Capture thread functions
   void AudioCaptureLoop();
   void VideoCaptureLoop();
+  void SendVideoSample(IMFSample* sample, LONGLONG timestamp);
 
-  // Enumerate devices
+  // Enumerate devices (slow with some drivers: only the refresh thread
+  // calls these)
   std::vector<CameraInfo> EnumerateCameras();
-  ComPtr<IMFActivate> FindAudioDevice();
-  ComPtr<IMFActivate> FindVideoDevice(const std::string& device_id = "");
+  std::wstring EnumerateAudioEndpoint();
+
+  // Device registry: scanned once on a background thread, rescanned on
+  // hot-plug, and read from the cache everywhere else
+  void StartDeviceRefresh();
+  void DeviceRefreshLoop();
+  // Block until the first scan is done; not for the platform thread
+  std::vector<CameraInfo> CachedCameras();
+  std::wstring CachedAudioEndpoint();
+  // Run `reply` on the platform thread once the first scan is done
+  void WhenDevicesReady(std::function<void()> reply);
+  void RegisterDeviceNotifications();
+  std::optional<LRESULT> HandleWindowMessage(HWND hwnd, UINT message,
+                                             WPARAM wparam, LPARAM lparam);
+  void PublishDeviceChanges();
+
+  // Create capture sources straight from cached device IDs
+  ComPtr<IMFMediaSource> CreateAudioSource();
+  ComPtr<IMFMediaSource> CreateVideoSource(const std::string& device_id);
+
+  flutter::PluginRegistrarWindows* registrar_;
+  flutter::BinaryMessenger* messenger_;
+
+  // Binary frame channels (see frame_packet.h); packet buffers are reused
+  // by the capture threads
+  std::atomic<bool> binary_frames_{false};
+  uint32_t audio_sequence_ = 0;
+  uint32_t video_sequence_ = 0;
+  std::vector<uint8_t> audio_packet_;
+  std::vector<uint8_t> video_packet_;
 
   // Stream handlers
   std::shared_ptr<AudioStreamHandler> audio_stream_handler_;
   std::shared_ptr<VideoStreamHandler> video_stream_handler_;
+  std::shared_ptr<DeviceStreamHandler> device_stream_handler_;
+
+  // Device registry
+  std::mutex devices_mutex_;
+  std::condition_variable devices_ready_cv_;
+  bool devices_ready_ = false;
+  std::vector<CameraInfo> cameras_;
+  std::wstring audio_endpoint_id_;
+  // Replies waiting for the first scan
+  std::vector<std::function<void()>> devices_waiters_;
+  // Changes not yet sent to Dart
+  std::vector<std::string> pending_added_;
+  std::vector<std::string> pending_removed_;
+  bool pending_microphone_change_ = false;
+  std::unique_ptr<std::thread> device_thread_;
+  std::atomic<bool> device_refresh_running_{false};
+  std::atomic<bool> device_refresh_again_{false};
+
+  // Hot-plug notifications
+  HWND device_window_ = nullptr;
+  int window_proc_id_ = -1;
+  HDEVNOTIFY camera_notification_ = nullptr;
+  HDEVNOTIFY audio_notification_ = nullptr;
+
+  // Camera opened by SelectCamera with its first frame already read
+  struct PendingVideoSource {
+    ComPtr<IMFMediaSource> source;
+    ComPtr<IMFSourceReader> reader;
+    bool mjpeg = false;
+    ComPtr<IMFSample> first_sample;
+    LONGLONG first_timestamp = 0;
+  };
+
+  // Camera switch in progress
+  std::mutex switch_mutex_;
+  std::unique_ptr<PendingVideoSource> pending_video_;
+  std::unique_ptr<std::thread> switch_thread_;
+  std::atomic<bool> switch_running_{false};
+  std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>> switch_result_;
+
+  // Capture control worker and its audio and video targets
+  std::unique_ptr<CaptureControlWorker> control_worker_;
+  int audio_target_ = -1;
+  int video_target_ = -1;
+
+  // Work waiting for the platform thread
+  HWND task_window_ = nullptr;
+  std::mutex platform_tasks_mutex_;
+  std::vector<std::function<void()>> platform_tasks_;
 
   // Media Foundation objects
   ComPtr<IMFMediaSource> audio_source_;
@@ -153,6 +307,9 @@ class NativeCapturePlugin : public flutter::Plugin {
   int video_width_ = 1280;
   int video_height_ = 720;
   int video_frame_rate_ = 30;
+  bool video_mjpeg_ = false;
+  // Guarded by switch_mutex_; a switch only changes it once the new camera
+  // works, so a failed one leaves the camera the next start opens alone
   std::string selected_camera_id_;
 
   // State
@@ -167,6 +324,7 @@ class NativeCapturePlugin : public flutter::Plugin {
   // Timestamps
   int64_t audio_start_timestamp_ = -1;
   int64_t video_start_timestamp_ = -1;
+  int64_t video_last_timestamp_ms_ = -1;
 
   // Mutex for thread safety
   std::mutex audio_mutex_;
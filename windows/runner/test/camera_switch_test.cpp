@@ -0,0 +1,152 @@
+// Tests for WarmUpCamera; no test framework so it builds anywhere
+
+#include "camera_switch.h"
+#include "capture_control_worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <thread>
+
+using moq_flutter::CameraSwitchStatus;
+using moq_flutter::CaptureControlWorker;
+using moq_flutter::CaptureRequestStatus;
+using moq_flutter::WarmUpCamera;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,     \
+                   __LINE__, #cond);                                  \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+void TestFirstFrameCompletesSwitch() {
+  int reads = 0;
+  auto status = WarmUpCamera(
+      [] { return true; },
+      [&](bool& got_frame) {
+        got_frame = ++reads == 3;
+        return true;
+      },
+      [] { return true; });
+  CHECK(status == CameraSwitchStatus::kOk);
+  CHECK(reads == 3);
+}
+
+void TestDeviceErrorsFail() {
+  int reads = 0;
+  auto open_failed = WarmUpCamera(
+      [] { return false; },
+      [&](bool&) {
+        reads++;
+        return true;
+      },
+      [] { return true; });
+  CHECK(open_failed == CameraSwitchStatus::kFailed);
+  CHECK(reads == 0);
+
+  auto read_failed = WarmUpCamera(
+      [] { return true; },
+      [](bool&) { return false; },
+      [] { return true; });
+  CHECK(read_failed == CameraSwitchStatus::kFailed);
+}
+
+void TestNotCapturingIsCancelled() {
+  bool opened = false;
+  auto status = WarmUpCamera(
+      [&] {
+        opened = true;
+        return true;
+      },
+      [](bool&) { return true; },
+      [] { return false; });
+  CHECK(status == CameraSwitchStatus::kCancelled);
+  CHECK(!opened);
+}
+
+// A read that fails because the camera went away with the capture is a
+// cancellation too
+void TestReadErrorAfterStopIsCancelled() {
+  bool capturing = true;
+  auto status = WarmUpCamera(
+      [] { return true; },
+      [&](bool&) {
+        capturing = false;
+        return false;
+      },
+      [&] { return capturing; });
+  CHECK(status == CameraSwitchStatus::kCancelled);
+}
+
+// The plugin's shape: the switch runs on its own thread while capture is on,
+// and the worker's stop action clears the flag and joins it
+void TestStopDuringSwitch() {
+  std::atomic<bool> capturing{false};
+  std::unique_ptr<std::thread> switch_thread;
+  std::promise<CameraSwitchStatus> switched;
+  std::promise<void> warming;
+
+  CaptureControlWorker worker;
+  int video = worker.AddTarget(
+      [&] {
+        capturing = true;
+        return true;
+      },
+      [&] {
+        capturing = false;
+        if (switch_thread && switch_thread->joinable()) switch_thread->join();
+        return true;
+      });
+
+  std::promise<CaptureRequestStatus> started;
+  worker.Request(video, true, [&](CaptureRequestStatus status, double) {
+    started.set_value(status);
+  });
+  CHECK(started.get_future().get() == CaptureRequestStatus::kOk);
+
+  // A camera that never delivers a frame
+  worker.Post([&] {
+    switch_thread = std::make_unique<std::thread>([&] {
+      bool first = true;
+      switched.set_value(WarmUpCamera(
+          [] { return true; },
+          [&](bool&) {
+            if (first) warming.set_value();
+            first = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            return true;
+          },
+          [&] { return capturing.load(); }));
+    });
+  });
+  warming.get_future().wait();
+
+  std::promise<CaptureRequestStatus> stopped;
+  worker.Request(video, false, [&](CaptureRequestStatus status, double) {
+    stopped.set_value(status);
+  });
+  CHECK(stopped.get_future().get() == CaptureRequestStatus::kOk);
+  CHECK(switched.get_future().get() == CameraSwitchStatus::kCancelled);
+}
+
+}  // namespace
+
+int main() {
+  TestFirstFrameCompletesSwitch();
+  TestDeviceErrorsFail();
+  TestNotCapturingIsCancelled();
+  TestReadErrorAfterStopIsCancelled();
+  TestStopDuringSwitch();
+
+  if (failures == 0) std::printf("camera_switch_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
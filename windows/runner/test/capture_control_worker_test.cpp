@@ -0,0 +1,225 @@
+// Tests for CaptureControlWorker; no test framework so it builds anywhere
+
+#include "capture_control_worker.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <vector>
+
+using moq_flutter::CaptureControlWorker;
+using moq_flutter::CaptureRequestStatus;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,     \
+                   __LINE__, #cond);                                  \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+// Request whose outcome can be waited for
+struct Outcome {
+  std::promise<std::pair<CaptureRequestStatus, double>> promise;
+  std::future<std::pair<CaptureRequestStatus, double>> future = promise.get_future();
+
+  CaptureControlWorker::Done Callback() {
+    return [this](CaptureRequestStatus status, double elapsed_ms) {
+      promise.set_value({status, elapsed_ms});
+    };
+  }
+
+  CaptureRequestStatus Status() { return future.get().first; }
+};
+
+// Blocks the worker until released, so requests pile up behind it
+struct Gate {
+  std::promise<void> entered;
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+
+  CaptureControlWorker::Task Task() {
+    return [this] {
+      entered.set_value();
+      released.wait();
+    };
+  }
+};
+
+void TestStartStop() {
+  std::atomic<int> starts{0}, stops{0};
+  std::atomic<bool> on_worker{true};
+  auto caller = std::this_thread::get_id();
+  CaptureControlWorker worker;
+  int video = worker.AddTarget(
+      [&] {
+        if (std::this_thread::get_id() == caller) on_worker = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        starts++;
+        return true;
+      },
+      [&] {
+        stops++;
+        return true;
+      });
+
+  Outcome start;
+  worker.Request(video, true, start.Callback());
+  auto [status, elapsed_ms] = start.future.get();
+  CHECK(status == CaptureRequestStatus::kOk);
+  CHECK(elapsed_ms >= 15.0);
+  CHECK(on_worker);
+  CHECK(worker.IsRunning(video));
+
+  Outcome stop;
+  worker.Request(video, false, stop.Callback());
+  CHECK(stop.Status() == CaptureRequestStatus::kOk);
+  CHECK(!worker.IsRunning(video));
+  CHECK(starts == 1 && stops == 1);
+
+  auto stats = worker.GetStats(video);
+  CHECK(stats.starts == 1 && stats.stops == 1);
+  CHECK(stats.last_start_ms >= 15.0);
+}
+
+void TestRedundantStartRunsNothing() {
+  std::atomic<int> starts{0};
+  CaptureControlWorker worker;
+  int video = worker.AddTarget([&] { starts++; return true; }, [] { return true; });
+
+  Outcome first, second;
+  worker.Request(video, true, first.Callback());
+  CHECK(first.Status() == CaptureRequestStatus::kOk);
+  worker.Request(video, true, second.Callback());
+  CHECK(second.Status() == CaptureRequestStatus::kOk);
+  CHECK(starts == 1);
+  CHECK(worker.GetStats(video).coalesced == 1);
+}
+
+void TestQueuedRequestsCoalesce() {
+  std::atomic<int> starts{0}, stops{0};
+  CaptureControlWorker worker;
+  int video = worker.AddTarget([&] { starts++; return true; },
+                               [&] { stops++; return true; });
+
+  // start, stop, start while the worker is busy: one start runs
+  Gate gate;
+  worker.Post(gate.Task());
+  gate.entered.get_future().wait();
+  Outcome a, b, c;
+  worker.Request(video, true, a.Callback());
+  worker.Request(video, false, b.Callback());
+  worker.Request(video, true, c.Callback());
+  gate.release.set_value();
+
+  CHECK(a.Status() == CaptureRequestStatus::kOk);
+  CHECK(b.Status() == CaptureRequestStatus::kSuperseded);
+  CHECK(c.Status() == CaptureRequestStatus::kOk);
+  CHECK(starts == 1 && stops == 0);
+  CHECK(worker.GetStats(video).coalesced == 2);
+
+  // stop then start while running: nothing runs at all
+  Gate gate2;
+  worker.Post(gate2.Task());
+  gate2.entered.get_future().wait();
+  Outcome d, e;
+  worker.Request(video, false, d.Callback());
+  worker.Request(video, true, e.Callback());
+  gate2.release.set_value();
+  CHECK(d.Status() == CaptureRequestStatus::kSuperseded);
+  CHECK(e.Status() == CaptureRequestStatus::kOk);
+  CHECK(starts == 1 && stops == 0);
+}
+
+void TestFailureKeepsState() {
+  CaptureControlWorker worker;
+  int video = worker.AddTarget([] { return false; }, [] { return true; });
+
+  Outcome start;
+  worker.Request(video, true, start.Callback());
+  CHECK(start.Status() == CaptureRequestStatus::kFailed);
+  CHECK(!worker.IsRunning(video));
+  CHECK(worker.GetStats(video).failures == 1);
+
+  // A retry runs the action again
+  Outcome retry;
+  worker.Request(video, true, retry.Callback());
+  CHECK(retry.Status() == CaptureRequestStatus::kFailed);
+  CHECK(worker.GetStats(video).starts == 2);
+}
+
+void TestTargetsAndTasksRunInOrder() {
+  std::vector<std::string> log;
+  std::mutex log_mutex;
+  auto note = [&](const char* entry) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log.emplace_back(entry);
+  };
+
+  CaptureControlWorker worker;
+  int audio = worker.AddTarget([&] { note("audio start"); return true; },
+                               [&] { note("audio stop"); return true; });
+  int video = worker.AddTarget([&] { note("video start"); return true; },
+                               [&] { note("video stop"); return true; });
+
+  // Queued behind a busy worker, in submission order
+  Gate gate;
+  worker.Post(gate.Task());
+  gate.entered.get_future().wait();
+  Outcome a, v, s;
+  worker.Request(video, true, v.Callback());
+  worker.Post([&] { note("select"); });
+  worker.Request(audio, true, a.Callback());
+  gate.release.set_value();
+  CHECK(v.Status() == CaptureRequestStatus::kOk);
+  CHECK(a.Status() == CaptureRequestStatus::kOk);
+  worker.Request(video, false, s.Callback());
+  CHECK(s.Status() == CaptureRequestStatus::kOk);
+
+  std::lock_guard<std::mutex> lock(log_mutex);
+  CHECK(log == std::vector<std::string>({"video start", "select", "audio start", "video stop"}));
+}
+
+void TestShutdownCancelsQueuedRequests() {
+  Outcome queued;
+  Gate gate;
+  std::atomic<int> starts{0};
+  std::thread releaser;
+  {
+    CaptureControlWorker worker;
+    int video = worker.AddTarget([&] { starts++; return true; }, [] { return true; });
+    worker.Post(gate.Task());
+    gate.entered.get_future().wait();
+    worker.Request(video, true, queued.Callback());
+
+    // Let the worker go once the destructor has flagged shutdown
+    releaser = std::thread([&] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      gate.release.set_value();
+    });
+  }
+  releaser.join();
+  CHECK(queued.Status() == CaptureRequestStatus::kCancelled);
+  CHECK(starts == 0);
+}
+
+}  // namespace
+
+int main() {
+  TestStartStop();
+  TestRedundantStartRunsNothing();
+  TestQueuedRequestsCoalesce();
+  TestFailureKeepsState();
+  TestTargetsAndTasksRunInOrder();
+  TestShutdownCancelsQueuedRequests();
+
+  if (failures == 0) std::printf("capture_control_worker_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// Tests for the binary frame packet layout; the golden bytes are shared
+// with test/moq/media/frame_packet_test.dart
+
+#include "frame_packet.h"
+
+#include <cstdio>
+#include <vector>
+
+using moq_flutter::BuildFramePacket;
+using moq_flutter::FramePacketFormat;
+using moq_flutter::FramePacketHeader;
+using moq_flutter::FramePacketKind;
+using moq_flutter::kFramePacketHeaderSize;
+using moq_flutter::ReadFramePacketHeader;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__,     \
+                   __LINE__, #cond);                                  \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+FramePacketHeader SampleHeader() {
+  FramePacketHeader header;
+  header.kind = FramePacketKind::kVideo;
+  header.format = FramePacketFormat::kBgra;
+  header.width = 1280;
+  header.height = 720;
+  header.stride = 5120;
+  header.timestamp_ms = 0x0102030405LL;
+  header.sequence = 7;
+  return header;
+}
+
+void TestGoldenLayout() {
+  const uint8_t payload[] = {0xAA, 0xBB, 0xCC};
+  std::vector<uint8_t> packet;
+  BuildFramePacket(SampleHeader(), payload, sizeof(payload), packet);
+
+  const std::vector<uint8_t> expected = {
+      0x01, 0x00, 0x01, 0x00,                          // version, kind, format
+      0x00, 0x05, 0x00, 0x00,                          // width 1280
+      0xD0, 0x02, 0x00, 0x00,                          // height 720
+      0x00, 0x14, 0x00, 0x00,                          // stride 5120
+      0x05, 0x04, 0x03, 0x02, 0x01, 0x00, 0x00, 0x00,  // timestamp
+      0x07, 0x00, 0x00, 0x00,                          // sequence
+      0x03, 0x00, 0x00, 0x00,                          // payload size
+      0xAA, 0xBB, 0xCC,
+  };
+  CHECK(packet == expected);
+}
+
+void TestRoundTrip() {
+  std::vector<uint8_t> payload(1000);
+  for (size_t i = 0; i < payload.size(); i++) payload[i] = static_cast<uint8_t>(i);
+  FramePacketHeader header = SampleHeader();
+  header.kind = FramePacketKind::kAudio;
+  header.format = FramePacketFormat::kPcm;
+  header.timestamp_ms = -5;
+
+  std::vector<uint8_t> packet;
+  BuildFramePacket(header, payload.data(), payload.size(), packet);
+
+  FramePacketHeader read;
+  CHECK(ReadFramePacketHeader(packet.data(), packet.size(), &read));
+  CHECK(read.kind == FramePacketKind::kAudio);
+  CHECK(read.format == FramePacketFormat::kPcm);
+  CHECK(read.width == 1280 && read.height == 720 && read.stride == 5120);
+  CHECK(read.timestamp_ms == -5);
+  CHECK(read.sequence == 7);
+  CHECK(read.payload_size == payload.size());
+  CHECK(std::vector<uint8_t>(packet.begin() + kFramePacketHeaderSize, packet.end()) == payload);
+}
+
+void TestRejectsBadPackets() {
+  std::vector<uint8_t> packet;
+  const uint8_t payload[16] = {};
+  BuildFramePacket(SampleHeader(), payload, sizeof(payload), packet);
+
+  FramePacketHeader read;
+  // Truncated header, truncated payload, unknown version
+  CHECK(!ReadFramePacketHeader(packet.data(), kFramePacketHeaderSize - 1, &read));
+  CHECK(!ReadFramePacketHeader(packet.data(), packet.size() - 1, &read));
+  packet[0] = 2;
+  CHECK(!ReadFramePacketHeader(packet.data(), packet.size(), &read));
+}
+
+}  // namespace
+
+int main() {
+  TestGoldenLayout();
+  TestRoundTrip();
+  TestRejectsBadPackets();
+
+  if (failures == 0) std::printf("frame_packet_test: all passed\n");
+  return failures == 0 ? 0 : 1;
+}